@@ -12,12 +12,16 @@
 #include "flash_mt25ql.h"
 
 // OBC
-#include "tms_mibspi.h"
+#include "tms_mibspi_async.h"
 #include "obc_hardwaredefs.h"
+#include "obc_utils.h"
 
 // HAL
 #include "gio.h"
 
+// Standard Library
+#include <string.h>
+
 /******************************************************************************/
 /*                               D E F I N E S                                */
 /******************************************************************************/
@@ -28,14 +32,20 @@
 #define FLASH_ADDR_MAX 0x01FFFFFF
 
 /**
- * @brief Number of bytes of flash data per read or write transaction
+ * @brief The size in bytes of the maximum programmable page
  */
-#define READ_WRITE_DATA_LEN 64
+#define FLASH_PAGE_SIZE_BYTES 0x100
 
 /**
- * @brief The size in bytes of the maximum programmable page
+ * @brief Number of bytes in a command byte followed by a 32-bit address
  */
-#define FLASH_PAGE_SIZE_BYTES 0x100
+#define CMD_ADDR_LEN 5
+
+/**
+ * @brief Maximum number of bytes read while the chip select is held. Longer reads are split
+ * into multiple read commands so that other devices on the MIBSPI port are not starved.
+ */
+#define FLASH_MAX_READ_CHUNK_BYTES 1024
 
 /**
  * @brief MIBSPI timeout for MT25QL flash driver
@@ -43,28 +53,46 @@
 #define FLASH_MIBSPI_TIMEOUT_MS 30
 
 /**
- * @brief Maximum time an erase operation could take. See max bulk erase
- * time in datasheet on page 90.
+ * @brief Maximum number of segments in a request: a command/address segment followed by one
+ * segment per stream transfer group.
+ */
+#define FLASH_MAX_SEGS 6U
+
+/**
+ * @brief While an operation has been running for less than this long, the status register is
+ * polled continuously instead of sleeping for a full RTOS tick. This covers a typical page
+ * program, and is kept short because lower priority tasks can't run during the spin.
  */
-#define MAX_ERASE_TIMEOUT_MS (231 * 1000)
+#define FLASH_SPIN_BUDGET_US 200U
 
 /**
- * @brief The time to allow for other tasks to run between checks for erase
- * completion.
+ * @brief Additional time allowed beyond the datasheet maximum before an operation is considered
+ * timed out, to account for the calling task being pre-empted.
  */
-#define FLASH_ERASE_INCREMENT_MS 10
+#define FLASH_TIMEOUT_MARGIN_US 20000U
 
 /**
- * @brief The time to allow for other tasks to run between checks for write
- * completion.
+ * @brief Once an operation has run for more than this many ticks, elapsed time is measured in
+ * ticks rather than with the microsecond counter (which can wrap during long erases).
  */
-#define FLASH_WRITE_INCREMENT_MS 10
+#define FLASH_FINE_TIMING_MAX_TICKS 2U
 
 /**
- * @brief Maximum time a write operation could take for 256 bytes. See max
- * page program time in datasheet on page 90.
+ * @brief Weight of a new sample in the calibrated expected busy time (1 / 2^N).
  */
-#define MAX_WRITE_TIMEOUT_MS 2
+#define FLASH_CALIBRATION_SHIFT 3U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Datasheet timing of an operation that leaves the flash busy (see page 90).
+ */
+typedef struct {
+    uint32_t typ_us; // Typical duration, used as the initial expected busy time
+    uint32_t max_us; // Maximum duration
+} flash_op_timing_t;
 
 /******************************************************************************/
 /*               P R I V A T E  G L O B A L  V A R I A B L E S                */
@@ -84,15 +112,50 @@ static mibspi_tg_t flash_20bytes_tg = {.reg = FLASH_MIBSPI_REG, .transfer_group
 
 static mibspi_tg_t flash_69bytes_tg = {.reg = FLASH_MIBSPI_REG, .transfer_group = FLASH_69_BYTE_GROUP, .cs_port = FLASH_CS0_PORT, .cs_pin = FLASH_CS0_PIN};
 
+/**
+ * @brief Transfer groups used to stream data while the chip select is held, ordered from
+ * largest to smallest. Any length can be composed from these (the smallest is 1 byte).
+ */
+static const mibspi_stream_tg_t flash_stream_tgs[] = {
+    {&flash_69bytes_tg, 69},
+    {&flash_20bytes_tg, 20},
+    {&flash_5bytes_tg,  5},
+    {&flash_2bytes_tg,  2},
+    {&flash_1byte_tg,   1},
+};
+
+#define FLASH_NUM_STREAM_TGS (sizeof(flash_stream_tgs) / sizeof(flash_stream_tgs[0]))
+
+static const flash_op_timing_t flash_op_timing[FLASH_OP_COUNT] = {
+    [FLASH_OP_PAGE_PROGRAM] = { .typ_us = 120U,       .max_us = 1800U },
+    [FLASH_OP_ERASE_4K]     = { .typ_us = 50000U,     .max_us = 400000U },
+    [FLASH_OP_ERASE_32K]    = { .typ_us = 100000U,    .max_us = 1000000U },
+    [FLASH_OP_ERASE_64K]    = { .typ_us = 150000U,    .max_us = 1000000U },
+    [FLASH_OP_ERASE_CHIP]   = { .typ_us = 153000000U, .max_us = 231000000U },
+};
+
+/**
+ * @brief Busy-time statistics and calibrated expected durations for each operation.
+ */
+static flash_latency_stats_t flash_stats[FLASH_OP_COUNT];
+
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
 /******************************************************************************/
 
 static flash_err_t mt25ql_is_busy(bool *busy);
-static flash_err_t mt25ql_write_enable(bool enable);
+static flash_err_t mt25ql_wait_ready(flash_op_t op);
+static uint32_t mt25ql_elapsed_us(TickType_t start_ticks, uint32_t start_us);
+static void mt25ql_record_latency(flash_op_t op, uint32_t elapsed_us, bool timed_out);
 static flash_err_t mt25ql_read_register(uint8_t reg, uint8_t *reg_data);
 static flash_err_t mt25ql_write_register(uint8_t reg, const uint8_t *reg_data);
 static flash_err_t mt25ql_enable_4byte_addressing(bool enable);
+static flash_err_t mt25ql_program_page(uint32_t addr, uint32_t size_bytes, const uint8_t *data);
+static flash_err_t mt25ql_read_chunk(uint32_t addr, uint32_t size_bytes, uint8_t *data);
+static mibspi_err_t mt25ql_xfer(const mibspi_tg_t *tg, uint32_t len, const uint8_t *tx_data, uint8_t *rx_data);
+static mibspi_err_t mt25ql_xfer_write_enabled(const mibspi_seg_t *segs, uint8_t num_segs);
+static uint8_t mt25ql_cmd_addr_segs(mibspi_seg_t *segs, uint8_t *cmd_addr, uint8_t cmd, uint32_t addr,
+                                    const uint8_t *tx_data, uint8_t *rx_data, uint32_t size_bytes);
 
 /******************************************************************************/
 /*                       P U B L I C  F U N C T I O N S                       */
@@ -111,6 +174,15 @@ void mt25ql_init(void) {
     mibspiEnableGroupNotification(FLASH_MIBSPI_REG, FLASH_20_BYTE_GROUP, 0U);
     mibspiEnableGroupNotification(FLASH_MIBSPI_REG, FLASH_69_BYTE_GROUP, 0U);
 
+    /*
+     * Start calibration of expected busy times from the typical datasheet values
+     */
+    for (uint8_t op = 0; op < FLASH_OP_COUNT; op++) {
+        flash_stats[op].expected_us = flash_op_timing[op].typ_us;
+    }
+
+    mt25ql_reset_latency_stats();
+
     /*
      * Enable 4 byte addressing mode (this is currently only needed for 32KB sector erases)
      */
@@ -125,16 +197,13 @@ void mt25ql_init(void) {
  * @return FLASH_OK if no error, error code otherwise
  */
 flash_err_t mt25ql_read_id(uint8_t *device_data) {
-    mibspi_err_t err = MIBSPI_NO_ERR;
-    uint16_t tx_buffer[20] = {FLASH_RDID, [1 ... 19] = 0xFF};
-    uint16_t rx_buffer[20] = { 0x00 };
+    const uint8_t tx_buffer[20] = {FLASH_RDID, [1 ... 19] = 0xFF};
+    uint8_t rx_buffer[20] = { 0x00 };
 
-    err = tms_mibspi_tx_rx(&flash_20bytes_tg, tx_buffer, rx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+    mibspi_err_t err = mt25ql_xfer(&flash_20bytes_tg, sizeof(tx_buffer), tx_buffer, rx_buffer);
 
     // Copy data from rx buffer to device data buf, ignoring the first byte (dummy data)
-    for (uint8_t i = 0; i < (sizeof(rx_buffer) / sizeof(uint16_t) - 1); i++) {
-        device_data[i] = (uint8_t) rx_buffer[i + 1];
-    }
+    memcpy(device_data, &rx_buffer[1], sizeof(rx_buffer) - 1U);
 
     return (err != MIBSPI_NO_ERR) ? FLASH_MIBSPI_ERR : FLASH_OK;
 }
@@ -179,6 +248,7 @@ flash_err_t mt25ql_write_status_register(const uint8_t *reg_data) {
 flash_err_t mt25ql_erase(uint32_t addr, flash_erase_sz_t erase_size) {
     /* Note: there is no 4-byte version of sector_erase_32kb. However, we enable 4 byte addressing mode during init */
     static const uint8_t erase_cmds[] = {BULK_ERASE, SECTOR_ERASE_4B_ADDR, SECTOR_ERASE_32KB, SECTOR_ERASE_4KB_4B_ADDR};
+    static const flash_op_t erase_ops[] = {FLASH_OP_ERASE_CHIP, FLASH_OP_ERASE_64K, FLASH_OP_ERASE_32K, FLASH_OP_ERASE_4K};
 
     mibspi_err_t err = MIBSPI_NO_ERR;
 
@@ -187,146 +257,138 @@ flash_err_t mt25ql_erase(uint32_t addr, flash_erase_sz_t erase_size) {
         return FLASH_ADDR_OR_SIZE_TOO_LARGE_ERR;
     }
 
-    // Set write enable
-    if (mt25ql_write_enable(TRUE) != FLASH_OK) {
-        return FLASH_MIBSPI_ERR;
-    }
+    uint8_t tx_buffer[CMD_ADDR_LEN] = {erase_cmds[erase_size], (addr >> 24) & 0xFF, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, addr & 0xFF};
 
-    uint16_t tx_buffer[5] = {(uint16_t)erase_cmds[erase_size], (addr >> 24) & 0xFF, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, addr & 0xFF};
+    // Set write enable and erase (the full chip erase command has no address)
+    mibspi_seg_t seg = {.tg = &flash_5bytes_tg, .tx_data = tx_buffer, .rx_data = NULL, .len = CMD_ADDR_LEN};
 
-    // Erase
     if (erase_size == FULL_CHIP) {
-        err = tms_mibspi_tx(&flash_1byte_tg, tx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
-    } else {
-        err = tms_mibspi_tx(&flash_5bytes_tg, tx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+        seg.tg  = &flash_1byte_tg;
+        seg.len = 1;
     }
 
+    err = mt25ql_xfer_write_enabled(&seg, 1);
+
     if (err != MIBSPI_NO_ERR) {
         return FLASH_MIBSPI_ERR;
     }
 
-    // Poll until the erase has been completed
-    bool busy              = TRUE;
-    flash_err_t err_flash  = FLASH_OK;
-    uint8_t timeout_ctr_ms = 0;
-
-    do {
-        if (timeout_ctr_ms == MAX_ERASE_TIMEOUT_MS) {
-            return FLASH_ERASE_TIMEOUT_ERR;
-        }
-
-        timeout_ctr_ms += FLASH_ERASE_INCREMENT_MS;
-        vTaskDelay(pdMS_TO_TICKS(FLASH_ERASE_INCREMENT_MS));
-        err_flash = mt25ql_is_busy(&busy);
-    } while ((busy == TRUE) && (err_flash == FLASH_OK));
-
-    return err_flash;
+    // Wait until the erase has been completed
+    return mt25ql_wait_ready(erase_ops[erase_size]);
 }
 
 /**
- * @brief Program the flash with a 64 byte chunk of data (1/4 of a 256 byte page)
+ * @brief Program the flash with an arbitrary amount of data.
+ *
+ * The data is split at page boundaries and each (partial) page is programmed with a single
+ * page program command, so a page-aligned 256 byte write costs one command and one busy-wait.
  *
- * @param addr: Address to write to, must be 64 byte aligned
+ * @param addr: Address to write to
+ * @param size_bytes: Number of bytes to write
  * @param data: Buffer storing the data to write
  * @return: FLASH_OK if no error, error code otherwise
  */
-flash_err_t mt25ql_write_64(uint32_t addr, const uint8_t *data) {
-    mibspi_err_t err = MIBSPI_NO_ERR;
-
+flash_err_t mt25ql_write(uint32_t addr, uint32_t size_bytes, const uint8_t *data) {
     // Validate no data will be written outside address bounds
-    if ((addr + READ_WRITE_DATA_LEN) > FLASH_ADDR_MAX + 1) {
+    if ((size_bytes > (FLASH_ADDR_MAX + 1)) || (addr > ((FLASH_ADDR_MAX + 1) - size_bytes))) {
         return FLASH_ADDR_OR_SIZE_TOO_LARGE_ERR;
     }
 
-    // Validate address alignment
-    if ((addr % READ_WRITE_DATA_LEN) != 0) {
-        return FLASH_ADDR_UNALIGNED_ERR;
-    }
-
-    // Set write enable
-    if (mt25ql_write_enable(TRUE) != FLASH_OK) {
-        return FLASH_MIBSPI_ERR;
-    }
-
-    /* Transmit write command is structured as follows:
-     *    command byte | 32-bit address | N-byte data buffer
-     */
-    uint16_t tx_buffer[READ_WRITE_DATA_LEN + 5] = {FLASH_WRITE_4B_ADDR, (addr >> 24) & 0xFF, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, addr & 0xFF, [5 ... READ_WRITE_DATA_LEN + 4] = 0xFF};
-
-    for (uint32_t i = 0; i < READ_WRITE_DATA_LEN; i++) {
-        tx_buffer[5 + i] = data[i];
-    }
-
-    err = tms_mibspi_tx(&flash_69bytes_tg, tx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
-
-    if (err != MIBSPI_NO_ERR) {
-        return FLASH_MIBSPI_ERR;
-    }
+    while (size_bytes > 0) {
+        // Never cross a page boundary within one page program command
+        uint32_t page_remaining = FLASH_PAGE_SIZE_BYTES - (addr % FLASH_PAGE_SIZE_BYTES);
+        uint32_t chunk_size     = (size_bytes < page_remaining) ? size_bytes : page_remaining;
 
-    // Poll until the write has been completed
-    bool busy              = TRUE;
-    flash_err_t err_flash  = FLASH_OK;
-    uint8_t timeout_ctr_ms = 0;
+        flash_err_t err = mt25ql_program_page(addr, chunk_size, data);
 
-    do {
-        if (timeout_ctr_ms == MAX_WRITE_TIMEOUT_MS) {
-            return FLASH_WRITE_TIMEOUT_ERR;
+        if (err != FLASH_OK) {
+            return err;
         }
 
-        timeout_ctr_ms += FLASH_WRITE_INCREMENT_MS;
-        vTaskDelay(pdMS_TO_TICKS(FLASH_WRITE_INCREMENT_MS));
-        err_flash = mt25ql_is_busy(&busy);
-    } while ((busy == TRUE) && (err_flash == FLASH_OK));
+        addr       += chunk_size;
+        data       += chunk_size;
+        size_bytes -= chunk_size;
+    }
 
-    return err_flash;
+    return FLASH_OK;
 }
 
 /**
- * @brief Read a 64 byte chunk from the hash (1/4 of a 256 byte page)
+ * @brief Read an arbitrary amount of data from the flash.
  *
- * @param addr: Address to read from, must be 64 byte aligned
+ * Reads are not restricted by page boundaries. Long reads are split into chunks of at most
+ * FLASH_MAX_READ_CHUNK_BYTES so the MIBSPI port is periodically released.
+ *
+ * @param addr: Address to read from
+ * @param size_bytes: Number of bytes to read
  * @param data: Buffer where read data will be stored
  * @return: FLASH_OK if no error, error code otherwise
  */
-flash_err_t mt25ql_read_64(uint32_t addr, uint8_t *data) {
-    mibspi_err_t err = MIBSPI_NO_ERR;
-
+flash_err_t mt25ql_read(uint32_t addr, uint32_t size_bytes, uint8_t *data) {
     // Validate no data will be read outside address bounds
-    if ((addr + READ_WRITE_DATA_LEN) > FLASH_ADDR_MAX + 1) {
+    if ((size_bytes > (FLASH_ADDR_MAX + 1)) || (addr > ((FLASH_ADDR_MAX + 1) - size_bytes))) {
         return FLASH_ADDR_OR_SIZE_TOO_LARGE_ERR;
     }
 
-    // Validate address alignment
-    if ((addr % READ_WRITE_DATA_LEN) != 0) {
-        return FLASH_ADDR_UNALIGNED_ERR;
-    }
+    while (size_bytes > 0) {
+        uint32_t chunk_size = (size_bytes < FLASH_MAX_READ_CHUNK_BYTES) ? size_bytes : FLASH_MAX_READ_CHUNK_BYTES;
 
-    /* Transmit read command is structured as follows:
-     *    command byte | 32-bit address | N-byte meaningless data (to clock in read bytes)
-     */
-    uint16_t tx_buffer[READ_WRITE_DATA_LEN + 5] = {FLASH_READ_4B_ADDR, (addr >> 24) & 0xFF, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, addr & 0xFF, [5 ...(READ_WRITE_DATA_LEN + 4)] = 0xFF};
-    uint16_t rx_buffer[READ_WRITE_DATA_LEN + 5] = {0};
+        flash_err_t err = mt25ql_read_chunk(addr, chunk_size, data);
 
-    err = tms_mibspi_tx_rx(&flash_69bytes_tg, tx_buffer, rx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+        if (err != FLASH_OK) {
+            return err;
+        }
 
-    if (err != MIBSPI_NO_ERR) {
-        return FLASH_MIBSPI_ERR;
+        addr       += chunk_size;
+        data       += chunk_size;
+        size_bytes -= chunk_size;
     }
 
-    // Copy the read data into the receive buffer
-    for (uint32_t i = 0; i < READ_WRITE_DATA_LEN; i++) {
-        data[i] = rx_buffer[5 + i];
+    return FLASH_OK;
+}
+
+/**
+ * @brief Get a copy of the busy-time statistics for an operation.
+ *
+ * @param op: Operation to get statistics for
+ * @param[out] stats: Statistics output
+ * @return FLASH_OK if no error, error code otherwise
+ */
+flash_err_t mt25ql_get_latency_stats(flash_op_t op, flash_latency_stats_t *stats) {
+    if ((op >= FLASH_OP_COUNT) || (stats == NULL)) {
+        return FLASH_INVALID_SIZE_ERR;
     }
 
+    taskENTER_CRITICAL();
+    *stats = flash_stats[op];
+    taskEXIT_CRITICAL();
+
     return FLASH_OK;
 }
 
+/**
+ * @brief Clear the busy-time statistics of all operations. The calibrated expected busy
+ * times are kept.
+ */
+void mt25ql_reset_latency_stats(void) {
+    taskENTER_CRITICAL();
+
+    for (uint8_t op = 0; op < FLASH_OP_COUNT; op++) {
+        uint32_t expected_us = flash_stats[op].expected_us;
+        memset(&flash_stats[op], 0, sizeof(flash_stats[op]));
+        flash_stats[op].min_us      = UINT32_MAX;
+        flash_stats[op].expected_us = expected_us;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
 /**
  * @brief Do deep power-down.
  */
 flash_err_t mt25ql_enter_deep_sleep(void) {
-    uint16_t tx_buffer[1] = {ENTER_DEEP_SLEEP};
-    mibspi_err_t err = tms_mibspi_tx(&flash_1byte_tg, tx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+    const uint8_t cmd = ENTER_DEEP_SLEEP;
+    mibspi_err_t err = mt25ql_xfer(&flash_1byte_tg, 1, &cmd, NULL);
 
     if (err != MIBSPI_NO_ERR) {
         return FLASH_MIBSPI_ERR;
@@ -339,8 +401,8 @@ flash_err_t mt25ql_enter_deep_sleep(void) {
  * @brief Release from deep power-down.
  */
 flash_err_t mt25ql_exit_deep_sleep(void) {
-    uint16_t tx_buffer[1] = {EXIT_DEEP_SLEEP};
-    mibspi_err_t err = tms_mibspi_tx(&flash_1byte_tg, tx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+    const uint8_t cmd = EXIT_DEEP_SLEEP;
+    mibspi_err_t err = mt25ql_xfer(&flash_1byte_tg, 1, &cmd, NULL);
 
     if (err != MIBSPI_NO_ERR) {
         return FLASH_MIBSPI_ERR;
@@ -363,16 +425,16 @@ static flash_err_t mt25ql_is_busy(bool *busy) {
     mibspi_err_t err;
 
     do {
-        uint16_t tx_buffer[2] = {READ_FLAG_STATUS_REG, 0xFF};
-        uint16_t rx_buffer[2] = {0};
+        const uint8_t tx_buffer[2] = {READ_FLAG_STATUS_REG, 0xFF};
+        uint8_t rx_buffer[2] = {0};
 
-        err = tms_mibspi_tx_rx(&flash_2bytes_tg, tx_buffer, rx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+        err = mt25ql_xfer(&flash_2bytes_tg, 2, tx_buffer, rx_buffer);
 
         if (err != MIBSPI_NO_ERR) {
             break;
         }
 
-        if (((uint8_t)rx_buffer[1] & 0x80) == 0) {
+        if ((rx_buffer[1] & 0x80) == 0) {
             *busy = TRUE;
         } else {
             *busy = FALSE;
@@ -383,21 +445,118 @@ static flash_err_t mt25ql_is_busy(bool *busy) {
 }
 
 /**
- * @brief Enables or disables writes to the flash.
+ * @brief Waits for a program or erase operation to complete.
  *
- * @warning Must be enabled before any writes are performed
- * or any erase is performed.
+ * The wait adapts to the calibrated expected duration of the operation:
+ *  1. If the expected duration is more than two RTOS ticks, the task sleeps for all but the
+ *     last tick of it.
+ *  2. Until FLASH_SPIN_BUDGET_US has elapsed since the operation started, the status register
+ *     is polled back-to-back, so typical page programs complete without waiting for a tick.
+ *     Only tasks of the same priority can run between these polls.
+ *  3. After that the status register is polled once per tick until the operation completes or
+ *     the datasheet maximum (plus a margin) is exceeded.
  *
- * @param enable: 1 if write enable, 0 if write disable
- * @return: FLASH_OK if no error, error code otherwise
+ * The measured busy time is added to the latency statistics, and is used to refine the expected
+ * duration of future operations if the operation completed.
+ *
+ * @param op: The operation that was started
+ * @return FLASH_OK if the operation completed, error code otherwise
  */
-static flash_err_t mt25ql_write_enable(bool enable) {
-    uint16_t tx_buffer[1];
-    tx_buffer[0] = (enable ? WRITE_ENABLE : WRITE_DISABLE);
+static flash_err_t mt25ql_wait_ready(flash_op_t op) {
+    const uint32_t start_us       = SYSTEM_TIME_US();
+    const TickType_t start_ticks  = xTaskGetTickCount();
+    const uint32_t timeout_us     = flash_op_timing[op].max_us + FLASH_TIMEOUT_MARGIN_US;
+    const uint32_t tick_period_us = portTICK_PERIOD_MS * 1000U;
+    const uint32_t expected_us    = flash_stats[op].expected_us;
+
+    // Sleep through the part of the operation that is certain to still be running
+    if (expected_us > (2U * tick_period_us)) {
+        vTaskDelay((TickType_t)((expected_us / tick_period_us) - 1U));
+    }
 
-    mibspi_err_t err = tms_mibspi_tx(&flash_1byte_tg, tx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+    bool busy          = TRUE;
+    flash_err_t err    = FLASH_OK;
+    uint32_t elapsed_us = 0;
 
-    return (err != MIBSPI_NO_ERR) ? FLASH_MIBSPI_ERR : FLASH_OK;
+    while (1) {
+        err        = mt25ql_is_busy(&busy);
+        elapsed_us = mt25ql_elapsed_us(start_ticks, start_us);
+
+        if ((err != FLASH_OK) || (busy == FALSE)) {
+            break;
+        }
+
+        if (elapsed_us > timeout_us) {
+            mt25ql_record_latency(op, elapsed_us, true);
+            return (op == FLASH_OP_PAGE_PROGRAM) ? FLASH_WRITE_TIMEOUT_ERR : FLASH_ERASE_TIMEOUT_ERR;
+        }
+
+        if (elapsed_us < FLASH_SPIN_BUDGET_US) {
+            taskYIELD();
+        } else {
+            vTaskDelay(1);
+        }
+    }
+
+    if (err == FLASH_OK) {
+        mt25ql_record_latency(op, elapsed_us, false);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Computes the time elapsed since the start of an operation.
+ *
+ * @param start_ticks: Tick count at the start of the operation
+ * @param start_us: Microsecond counter at the start of the operation
+ * @return Elapsed time in microseconds
+ */
+static uint32_t mt25ql_elapsed_us(TickType_t start_ticks, uint32_t start_us) {
+    TickType_t elapsed_ticks = xTaskGetTickCount() - start_ticks;
+
+    if (elapsed_ticks > FLASH_FINE_TIMING_MAX_TICKS) {
+        return (uint32_t)elapsed_ticks * portTICK_PERIOD_MS * 1000U;
+    }
+
+    return SYSTEM_TIME_US() - start_us;
+}
+
+/**
+ * @brief Records the busy time of an operation in its statistics and updates the calibrated
+ * expected busy time.
+ *
+ * @param op: The operation
+ * @param elapsed_us: Measured busy time
+ * @param timed_out: True if the operation timed out
+ */
+static void mt25ql_record_latency(flash_op_t op, uint32_t elapsed_us, bool timed_out) {
+    flash_latency_stats_t *stats = &flash_stats[op];
+
+    uint8_t bin = 0;
+
+    while ((bin < (FLASH_LATENCY_HIST_BINS - 1U)) && (elapsed_us >= ((uint32_t)FLASH_LATENCY_HIST_BASE_US << bin))) {
+        bin++;
+    }
+
+    taskENTER_CRITICAL();
+
+    stats->count++;
+    stats->min_us   = MIN(stats->min_us, elapsed_us);
+    stats->max_us   = MAX(stats->max_us, elapsed_us);
+    stats->total_us = ((UINT32_MAX - stats->total_us) < elapsed_us) ? UINT32_MAX : (stats->total_us + elapsed_us);
+
+    if (timed_out) {
+        stats->timeouts++;
+    } else {
+        // Exponentially weighted moving average, of completed operations only
+        int32_t delta = (int32_t)elapsed_us - (int32_t)stats->expected_us;
+        stats->expected_us = (uint32_t)((int32_t)stats->expected_us + (delta / (1 << FLASH_CALIBRATION_SHIFT)));
+    }
+
+    stats->hist[bin]++;
+
+    taskEXIT_CRITICAL();
 }
 
 /**
@@ -408,16 +567,16 @@ static flash_err_t mt25ql_write_enable(bool enable) {
  * @return: FLASH_OK if no error, error code otherwise
  */
 static flash_err_t mt25ql_read_register(uint8_t reg, uint8_t *reg_data) {
-    mibspi_err_t err      = MIBSPI_NO_ERR;
-    uint16_t tx_buffer[2] = {(uint16_t)reg, 0xFF};
-    uint16_t rx_buffer[2] = {0};
+    mibspi_err_t err           = MIBSPI_NO_ERR;
+    const uint8_t tx_buffer[2] = {reg, 0xFF};
+    uint8_t rx_buffer[2]       = {0};
 
     // Transmit the read status register command, and receive data
-    err = tms_mibspi_tx_rx(&flash_2bytes_tg, tx_buffer, rx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+    err = mt25ql_xfer(&flash_2bytes_tg, 2, tx_buffer, rx_buffer);
 
     if (err == MIBSPI_NO_ERR) {
         // Set received data
-        *reg_data = (uint8_t)rx_buffer[1];
+        *reg_data = rx_buffer[1];
     }
 
     return (err != MIBSPI_NO_ERR) ? FLASH_MIBSPI_ERR : FLASH_OK;
@@ -431,10 +590,10 @@ static flash_err_t mt25ql_read_register(uint8_t reg, uint8_t *reg_data) {
  * @return: FLASH_OK if no error, error code otherwise
  */
 static flash_err_t mt25ql_write_register(uint8_t reg, const uint8_t *reg_data) {
-    uint16_t tx_buffer[2] = {(uint16_t)reg, (uint16_t)reg_data[0]};
+    const uint8_t tx_buffer[2] = {reg, reg_data[0]};
 
     // Transmit the write register command and data to write
-    mibspi_err_t err = tms_mibspi_tx(&flash_2bytes_tg, tx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+    mibspi_err_t err = mt25ql_xfer(&flash_2bytes_tg, 2, tx_buffer, NULL);
 
     return (err != MIBSPI_NO_ERR) ? FLASH_MIBSPI_ERR : FLASH_OK;
 }
@@ -446,9 +605,144 @@ static flash_err_t mt25ql_write_register(uint8_t reg, const uint8_t *reg_data) {
  * @return: FLASH_OK if no error, error code otherwise
  */
 static flash_err_t mt25ql_enable_4byte_addressing(bool enable) {
-    uint16_t tx_buffer[1] = {enable ? FLASH_ENTER_4BYTE_ADDR_MODE : FLASH_EXIT_4BYTE_ADDR_MODE};
+    const uint8_t cmd = (enable ? FLASH_ENTER_4BYTE_ADDR_MODE : FLASH_EXIT_4BYTE_ADDR_MODE);
 
-    mibspi_err_t err = tms_mibspi_tx(&flash_1byte_tg, tx_buffer, FLASH_MIBSPI_TIMEOUT_MS);
+    mibspi_err_t err = mt25ql_xfer(&flash_1byte_tg, 1, &cmd, NULL);
     return (err != MIBSPI_NO_ERR) ? FLASH_MIBSPI_ERR : FLASH_OK;
 }
 
+/**
+ * @brief Program up to one page of the flash with a single page program command.
+ *
+ * @param addr: Address to write to
+ * @param size_bytes: Number of bytes to write, must not cross a page boundary
+ * @param data: Buffer storing the data to write
+ * @return: FLASH_OK if no error, error code otherwise
+ */
+static flash_err_t mt25ql_program_page(uint32_t addr, uint32_t size_bytes, const uint8_t *data) {
+    /* Transmit write command is structured as follows:
+     *    command byte | 32-bit address | N-byte data buffer
+     */
+    uint8_t cmd_addr[CMD_ADDR_LEN];
+    mibspi_seg_t segs[FLASH_MAX_SEGS];
+    uint8_t num_segs = mt25ql_cmd_addr_segs(segs, cmd_addr, FLASH_WRITE_4B_ADDR, addr, data, NULL, size_bytes);
+
+    // The write enable and the page program are queued together
+    mibspi_err_t err = mt25ql_xfer_write_enabled(segs, num_segs);
+
+    if (err != MIBSPI_NO_ERR) {
+        return FLASH_MIBSPI_ERR;
+    }
+
+    // Wait until the write has been completed
+    return mt25ql_wait_ready(FLASH_OP_PAGE_PROGRAM);
+}
+
+/**
+ * @brief Read a chunk of data from the flash with a single read command.
+ *
+ * @param addr: Address to read from
+ * @param size_bytes: Number of bytes to read
+ * @param data: Buffer where read data will be stored
+ * @return: FLASH_OK if no error, error code otherwise
+ */
+static flash_err_t mt25ql_read_chunk(uint32_t addr, uint32_t size_bytes, uint8_t *data) {
+    /* Transmit read command is structured as follows:
+     *    command byte | 32-bit address | N-byte meaningless data (to clock in read bytes)
+     */
+    uint8_t cmd_addr[CMD_ADDR_LEN];
+    mibspi_seg_t segs[FLASH_MAX_SEGS];
+
+    mibspi_async_req_t req = {
+        .segs     = segs,
+        .num_segs = mt25ql_cmd_addr_segs(segs, cmd_addr, FLASH_READ_4B_ADDR, addr, NULL, data, size_bytes),
+        .timeout  = FLASH_MIBSPI_TIMEOUT_MS,
+    };
+
+    mibspi_err_t err = tms_mibspi_async_transfer(&req, FLASH_MIBSPI_TIMEOUT_MS);
+
+    return (err != MIBSPI_NO_ERR) ? FLASH_MIBSPI_ERR : FLASH_OK;
+}
+
+/**
+ * @brief Run a single transfer group on the flash chip select.
+ *
+ * @param tg: Transfer group
+ * @param len: Length of the transfer group
+ * @param tx_data: Bytes to transmit, or NULL to transmit zeros
+ * @param rx_data: Buffer for received bytes, or NULL to discard them
+ * @return: MIBSPI_NO_ERR if no error, error code otherwise
+ */
+static mibspi_err_t mt25ql_xfer(const mibspi_tg_t *tg, uint32_t len, const uint8_t *tx_data, uint8_t *rx_data) {
+    const mibspi_seg_t seg = {.tg = tg, .tx_data = tx_data, .rx_data = rx_data, .len = len};
+    mibspi_async_req_t req = {.segs = &seg, .num_segs = 1, .timeout = FLASH_MIBSPI_TIMEOUT_MS};
+
+    return tms_mibspi_async_transfer(&req, FLASH_MIBSPI_TIMEOUT_MS);
+}
+
+/**
+ * @brief Queue a write enable command followed by a request, and wait for both to complete.
+ *
+ * Requests are executed in the order they were queued, so the write enable always precedes
+ * the request without a round trip through the calling task.
+ *
+ * @param segs: Segments of the request (a program or erase command)
+ * @param num_segs: Number of segments
+ * @return: MIBSPI_NO_ERR if no error, error code otherwise
+ */
+static mibspi_err_t mt25ql_xfer_write_enabled(const mibspi_seg_t *segs, uint8_t num_segs) {
+    const uint8_t wren_cmd = WRITE_ENABLE;
+    const mibspi_seg_t wren_seg = {.tg = &flash_1byte_tg, .tx_data = &wren_cmd, .rx_data = NULL, .len = 1};
+    TaskHandle_t current_task = xTaskGetCurrentTaskHandle();
+
+    mibspi_async_req_t wren_req = {.segs = &wren_seg, .num_segs = 1, .timeout = FLASH_MIBSPI_TIMEOUT_MS, .notify_task = current_task};
+    mibspi_async_req_t req      = {.segs = segs, .num_segs = num_segs, .timeout = FLASH_MIBSPI_TIMEOUT_MS, .notify_task = current_task};
+
+    mibspi_err_t err = tms_mibspi_async_submit(&wren_req, FLASH_MIBSPI_TIMEOUT_MS);
+
+    if (err != MIBSPI_NO_ERR) {
+        return err;
+    }
+
+    mibspi_err_t req_err = tms_mibspi_async_submit(&req, FLASH_MIBSPI_TIMEOUT_MS);
+
+    // The write enable request must complete before it goes out of scope, even if the request
+    // could not be queued
+    err = tms_mibspi_async_wait(&wren_req);
+
+    if (req_err == MIBSPI_NO_ERR) {
+        req_err = tms_mibspi_async_wait(&req);
+    }
+
+    return (err != MIBSPI_NO_ERR) ? err : req_err;
+}
+
+/**
+ * @brief Build the segments of a command followed by a 32-bit address and a data stream.
+ *
+ * @param[out] segs: Segments to fill in (FLASH_MAX_SEGS entries)
+ * @param[out] cmd_addr: Buffer for the command and address bytes (CMD_ADDR_LEN bytes), which must
+ * remain valid until the request completes
+ * @param cmd: Command byte
+ * @param addr: 32-bit address
+ * @param tx_data: Data to transmit after the address, or NULL to transmit zeros
+ * @param rx_data: Buffer for the data received after the address, or NULL to discard it
+ * @param size_bytes: Number of data bytes
+ * @return: Number of segments
+ */
+static uint8_t mt25ql_cmd_addr_segs(mibspi_seg_t *segs, uint8_t *cmd_addr, uint8_t cmd, uint32_t addr,
+                                    const uint8_t *tx_data, uint8_t *rx_data, uint32_t size_bytes) {
+    cmd_addr[0] = cmd;
+    cmd_addr[1] = (addr >> 24) & 0xFF;
+    cmd_addr[2] = (addr >> 16) & 0xFF;
+    cmd_addr[3] = (addr >> 8) & 0xFF;
+    cmd_addr[4] = addr & 0xFF;
+
+    segs[0].tg      = &flash_5bytes_tg;
+    segs[0].tx_data = cmd_addr;
+    segs[0].rx_data = NULL;
+    segs[0].len     = CMD_ADDR_LEN;
+
+    // The smallest stream transfer group is 1 byte, so any length fits in the remaining segments
+    return 1U + tms_mibspi_async_stream_segs(&segs[1], FLASH_MAX_SEGS - 1U, flash_stream_tgs, FLASH_NUM_STREAM_TGS, tx_data, rx_data, size_bytes);
+}
@@ -61,9 +61,11 @@ flash_err_t mt25ql_read_status_register(uint8_t *reg_data);
 flash_err_t mt25ql_read_flag_status_register(uint8_t *reg_data);
 flash_err_t mt25ql_write_status_register(const uint8_t *reg_data);
 flash_err_t mt25ql_erase(uint32_t addr, flash_erase_sz_t erase_size);
-flash_err_t mt25ql_write_64(uint32_t addr, const uint8_t *data);
-flash_err_t mt25ql_read_64(uint32_t addr, uint8_t *data);
+flash_err_t mt25ql_write(uint32_t addr, uint32_t size_bytes, const uint8_t *data);
+flash_err_t mt25ql_read(uint32_t addr, uint32_t size_bytes, uint8_t *data);
 flash_err_t mt25ql_enter_deep_sleep(void);
 flash_err_t mt25ql_exit_deep_sleep(void);
+flash_err_t mt25ql_get_latency_stats(flash_op_t op, flash_latency_stats_t *stats);
+void mt25ql_reset_latency_stats(void);
 
 #endif // FLASH_MT25QL_H_
@@ -76,6 +76,9 @@ flash_err_t flash_erase(uint32_t addr, flash_erase_sz_t erase_size) {
 /**
  * @brief Program the flash with data to store.
  *
+ * Writes of any length are supported. Data is programmed one page at a time and is split
+ * at page boundaries by the driver.
+ *
  * @param addr: Address to write to, must be byte-aligned
  * @param size: Amount of data to write in bytes
  * @param data: Buffer storing the data to write
@@ -83,14 +86,7 @@ flash_err_t flash_erase(uint32_t addr, flash_erase_sz_t erase_size) {
  */
 flash_err_t flash_write(uint32_t addr, uint32_t size_bytes, const uint8_t *data) {
 #if FEATURE_FLASH_FS
-
-    if (size_bytes == 64) {
-        return mt25ql_write_64(addr, data);
-    } else {
-        // Unhandled case: can only do 64 byte writes
-        return FLASH_INVALID_SIZE_ERR;
-    }
-
+    return mt25ql_write(addr, size_bytes, data);
 #else
     LOG_FLASH__FLASH_FS_NOT_ENABLED();
     return FLASH_FS_DISABLED_ERR;
@@ -100,6 +96,8 @@ flash_err_t flash_write(uint32_t addr, uint32_t size_bytes, const uint8_t *data)
 /**
  * @brief Read data from the flash.
  *
+ * Reads of any length are supported.
+ *
  * @param addr: Address to read from, must be byte-aligned
  * @param size: Amount of data to read in bytes
  * @param data: Buffer where read data will be stored
@@ -107,14 +105,7 @@ flash_err_t flash_write(uint32_t addr, uint32_t size_bytes, const uint8_t *data)
  */
 flash_err_t flash_read(uint32_t addr, uint32_t size_bytes, uint8_t *data) {
 #if FEATURE_FLASH_FS
-
-    if (size_bytes == 64) {
-        return mt25ql_read_64(addr, data);
-    } else {
-        // Unhandled case: can only do 64 byte reads
-        return FLASH_INVALID_SIZE_ERR;
-    }
-
+    return mt25ql_read(addr, size_bytes, data);
 #else
     LOG_FLASH__FLASH_FS_NOT_ENABLED();
     return FLASH_FS_DISABLED_ERR;
@@ -144,3 +135,28 @@ flash_err_t flash_wake(void) {
     return FLASH_FS_DISABLED_ERR;
 #endif
 }
+
+/**
+ * @brief Get a copy of the busy-time statistics for a flash operation.
+ *
+ * @param op: Operation to get statistics for
+ * @param[out] stats: Statistics output
+ * @return FLASH_OK if no error, error code otherwise
+ */
+flash_err_t flash_get_latency_stats(flash_op_t op, flash_latency_stats_t *stats) {
+#if FEATURE_FLASH_FS
+    return mt25ql_get_latency_stats(op, stats);
+#else
+    return FLASH_FS_DISABLED_ERR;
+#endif
+}
+
+/**
+ * @brief Clear the busy-time statistics of all flash operations. Calibrated expected busy
+ * times are kept.
+ */
+void flash_reset_latency_stats(void) {
+#if FEATURE_FLASH_FS
+    mt25ql_reset_latency_stats();
+#endif
+}
@@ -53,6 +53,45 @@ typedef enum flash_erase_sz {
 #endif
 } flash_erase_sz_t;
 
+/**
+ * @brief Flash operations that leave the device busy and are timed by the driver.
+ */
+typedef enum flash_op {
+    FLASH_OP_PAGE_PROGRAM = 0,
+    FLASH_OP_ERASE_4K     = 1,
+    FLASH_OP_ERASE_32K    = 2,
+    FLASH_OP_ERASE_64K    = 3,
+    FLASH_OP_ERASE_CHIP   = 4,
+
+    FLASH_OP_COUNT
+} flash_op_t;
+
+/**
+ * @brief Number of buckets in each flash latency histogram.
+ *
+ * Bucket 0 counts operations that took less than FLASH_LATENCY_HIST_BASE_US. Bucket i (i > 0)
+ * counts operations that took [BASE << (i - 1), BASE << i) us. The last bucket also counts
+ * everything longer than that.
+ */
+#define FLASH_LATENCY_HIST_BINS    16U
+#define FLASH_LATENCY_HIST_BASE_US 64U
+
+/**
+ * @brief Busy-time statistics for a single flash operation type.
+ *
+ * Every operation, including those that timed out, is counted in count, min_us, max_us,
+ * total_us and hist. Only completed operations refine expected_us.
+ */
+typedef struct {
+    uint32_t count;       // Number of operations, including those that timed out
+    uint32_t timeouts;    // Number of operations that timed out
+    uint32_t min_us;      // Shortest observed busy time
+    uint32_t max_us;      // Longest observed busy time
+    uint32_t total_us;    // Sum of all observed busy times (saturating)
+    uint32_t expected_us; // Current calibrated expected busy time
+    uint32_t hist[FLASH_LATENCY_HIST_BINS];
+} flash_latency_stats_t;
+
 /******************************************************************************/
 /*                             F U N C T I O N S                              */
 /******************************************************************************/
@@ -64,5 +103,7 @@ flash_err_t flash_write(uint32_t addr, uint32_t size_bytes, const uint8_t *data)
 flash_err_t flash_read(uint32_t addr, uint32_t size_bytes, uint8_t *data);
 flash_err_t flash_sleep(void);
 flash_err_t flash_wake(void);
+flash_err_t flash_get_latency_stats(flash_op_t op, flash_latency_stats_t *stats);
+void flash_reset_latency_stats(void);
 
 #endif // OBC_FLASH_H_
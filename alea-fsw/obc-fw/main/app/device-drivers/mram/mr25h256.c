@@ -11,7 +11,7 @@
 /******************************************************************************/
 
 #include "mr25h256.h"
-#include "tms_mibspi.h"
+#include "tms_mibspi_async.h"
 #include "gio.h"
 // #include "obc_hardwaredefs.h"
 #include "launchpad_1224_hardwaredefs.h"
@@ -19,7 +19,9 @@
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
 /******************************************************************************/
-static mibspi_err_t mram_mr25h256_write_enable(bool enable);
+static mibspi_err_t mram_mr25h256_xfer_write_enabled(const mibspi_seg_t *segs, uint8_t num_segs);
+static uint8_t mram_mr25h256_cmd_addr_segs(mibspi_seg_t *segs, uint8_t *cmd_addr, uint8_t cmd, uint16_t addr,
+                                           const uint8_t *tx_data, uint8_t *rx_data, uint16_t size_bytes);
 
 /******************************************************************************/
 /*               P R I V A T E  G L O B A L  V A R I A B L E S                */
@@ -32,6 +34,12 @@ static mibspi_err_t mram_mr25h256_write_enable(bool enable);
 #define MRAM_READ  0x03
 #define MRAM_WRITE 0x02
 
+// Command byte followed by a 16-bit address
+#define MRAM_CMD_ADDR_LEN 3U
+
+// Command/address segments (1 and 2 byte transfer groups) followed by one segment per stream transfer group
+#define MRAM_MAX_SEGS 6U
+
 /**
  * @brief Transfer groups.
  */
@@ -40,6 +48,19 @@ static mibspi_tg_t mram_2bytes_tg  = {.reg = MRAM_MIBSPI_REG, .transfer_group =
 static mibspi_tg_t mram_4bytes_tg  = {.reg = MRAM_MIBSPI_REG, .transfer_group = MRAM_4_BYTE_GROUP, .cs_port = MRAM_CS_PORT, .cs_pin = MRAM_CS_PIN};
 static mibspi_tg_t mram_11bytes_tg = {.reg = MRAM_MIBSPI_REG, .transfer_group = MRAM_11_BYTE_GROUP, .cs_port = MRAM_CS_PORT, .cs_pin = MRAM_CS_PIN};
 
+/**
+ * @brief Transfer groups used to stream data while the chip select is held, ordered from
+ * largest to smallest.
+ */
+static const mibspi_stream_tg_t mram_stream_tgs[] = {
+    {&mram_11bytes_tg, 11},
+    {&mram_4bytes_tg,  4},
+    {&mram_2bytes_tg,  2},
+    {&mram_1byte_tg,   1},
+};
+
+#define MRAM_NUM_STREAM_TGS (sizeof(mram_stream_tgs) / sizeof(mram_stream_tgs[0]))
+
 /******************************************************************************/
 /*                       P U B L I C  F U N C T I O N S                       */
 /******************************************************************************/
@@ -60,6 +81,8 @@ mram_err_t mram_mr25h256_init(void) {
 /**
  * @brief Program the MRAM with data to store.
  *
+ * The whole buffer is written with a single write command.
+ *
  * @pre @ref mram_init from @ref device-drivers/obc_mram.h has been called.
  *
  * @param addr:         Address to write to, must be byte-aligned
@@ -74,58 +97,27 @@ mram_err_t mram_mr25h256_write(uint16_t addr, uint16_t size_bytes, const uint8_t
         return MRAM_INDEX_OUT_OF_BOUND;
     }
 
-    // set write enable
-    mibspi_err_t err = mram_mr25h256_write_enable(true);
-
-    if (err != MIBSPI_NO_ERR) {
-        mram_mr25h256_write_enable(false);
-        return MRAM_MIBSPI_ERR;
+    if (size_bytes == 0) {
+        return MRAM_OK;
     }
 
-    uint16_t index = 0;
-
-    while (size_bytes > 0) {
-        /* Transmit write command is structured as follows:
-         *    command byte | 16-bit address | byte data buffer
-         *
-         * Transfer 8 bytes at a time, until there are less than 8 bytes, then switch to 1 byte
-         */
-        uint8_t write_size = 8;
-
-        if (size_bytes >= 8) {
-            uint16_t tx_buffer[11];
-            tx_buffer[0] = MRAM_WRITE;
-            tx_buffer[1] = (addr >> 8) & 0xFF;
-            tx_buffer[2] = (addr & 0xFF);
-
-            for (uint8_t i = 0; i < 8; i++) {
-                tx_buffer[i + 3] = data[index + i];
-            }
-
-            err = tms_mibspi_tx(&mram_11bytes_tg, tx_buffer, MRAM_MIBSPI_TIMEOUT_MS);
-        } else {
-            uint16_t tx_buffer[4] = {MRAM_WRITE, (addr >> 8) & 0xFF, addr & 0xFF, data[index]};
-            err                   = tms_mibspi_tx(&mram_4bytes_tg, tx_buffer, MRAM_MIBSPI_TIMEOUT_MS);
-            write_size            = 1;
-        }
+    /* Transmit write command is structured as follows:
+     *    command byte | 16-bit address | byte data buffer
+     */
+    uint8_t cmd_addr[MRAM_CMD_ADDR_LEN];
+    mibspi_seg_t segs[MRAM_MAX_SEGS];
+    uint8_t num_segs = mram_mr25h256_cmd_addr_segs(segs, cmd_addr, MRAM_WRITE, addr, data, NULL, size_bytes);
 
-        // stop if something went wrong
-        if (err != MIBSPI_NO_ERR) {
-            break;
-        }
-
-        addr += write_size;
-        index += write_size;
-        size_bytes -= write_size;
-    }
+    mibspi_err_t err = mram_mr25h256_xfer_write_enabled(segs, num_segs);
 
-    mram_mr25h256_write_enable(false);
     return (err != MIBSPI_NO_ERR) ? MRAM_MIBSPI_ERR : MRAM_OK;
 }
 
 /**
  * @brief Read data from the mram.
  *
+ * The whole buffer is read with a single read command.
+ *
  * @pre @ref mram_init from @ref device-drivers/obc_mram.h has been called.
  * @details If an error is returned, it is not guaranteed that all data in the read buffer is valid
  *
@@ -135,36 +127,29 @@ mram_err_t mram_mr25h256_write(uint16_t addr, uint16_t size_bytes, const uint8_t
  * @return: MRAM_OK if no error, error code otherwise
  */
 mram_err_t mram_mr25h256_read(uint16_t addr, uint16_t size_bytes, uint8_t *data) {
-    mibspi_err_t err = MIBSPI_NO_ERR;
-
     if ((addr + size_bytes) > MR25H256_MRAM_MAX_ADDRESS) {
         return MRAM_INDEX_OUT_OF_BOUND;
     }
 
-    uint16_t index = 0;
+    if (size_bytes == 0) {
+        return MRAM_OK;
+    }
 
-    while (index < size_bytes) {
-        /* Transmit read command is structured as follows:
-         *    command byte | 16-bit address
-         *
-         * Note: reads continue as long as memory is clocked
-         */
-        uint16_t tx_buffer[4] = {MRAM_READ, (addr >> 8) & 0xFF, addr & 0xFF, 0xFF}; // last val is dummy due to mibspi tx rx
-        uint16_t rx_buffer[4] = {0};
-        // Read the address in mram
-        err = tms_mibspi_tx_rx(&mram_4bytes_tg, tx_buffer, rx_buffer, MRAM_MIBSPI_TIMEOUT_MS);
+    /* Transmit read command is structured as follows:
+     *    command byte | 16-bit address
+     *
+     * Note: reads continue as long as memory is clocked
+     */
+    uint8_t cmd_addr[MRAM_CMD_ADDR_LEN];
+    mibspi_seg_t segs[MRAM_MAX_SEGS];
 
-        if (err != MIBSPI_NO_ERR) {
-            break;
-        }
+    mibspi_async_req_t req = {
+        .segs     = segs,
+        .num_segs = mram_mr25h256_cmd_addr_segs(segs, cmd_addr, MRAM_READ, addr, NULL, data, size_bytes),
+        .timeout  = MRAM_MIBSPI_TIMEOUT_MS,
+    };
 
-        // copy rx buffer into our data buffer
-        data[index] = (uint8_t)rx_buffer[3];
-
-        // Increment to next read address and index
-        addr++;
-        index++;
-    }
+    mibspi_err_t err = tms_mibspi_async_transfer(&req, MRAM_MIBSPI_TIMEOUT_MS);
 
     return (err != MIBSPI_NO_ERR) ? MRAM_MIBSPI_ERR : MRAM_OK;
 }
@@ -176,15 +161,17 @@ mram_err_t mram_mr25h256_read(uint16_t addr, uint16_t size_bytes, uint8_t *data)
  * @return: MRAM_OK if no error, error code otherwise
  */
 mram_err_t mram_mr25h256_read_status(uint8_t *reg_data) {
-    mibspi_err_t err      = MIBSPI_NO_ERR;
-    uint16_t tx_buffer[2] = {MRAM_RDSR, 0xFF}; // Dummy transmit value
-    uint16_t rx_buffer[2] = {0};
+    const uint8_t tx_buffer[2] = {MRAM_RDSR, 0xFF}; // Dummy transmit value
+    uint8_t rx_buffer[2]       = {0};
+
+    const mibspi_seg_t seg = {.tg = &mram_2bytes_tg, .tx_data = tx_buffer, .rx_data = rx_buffer, .len = 2};
+    mibspi_async_req_t req = {.segs = &seg, .num_segs = 1, .timeout = MRAM_MIBSPI_TIMEOUT_MS};
 
     // Transmit the read status register command, and receive data
-    err = tms_mibspi_tx_rx(&mram_2bytes_tg, tx_buffer, rx_buffer, MRAM_MIBSPI_TIMEOUT_MS);
+    mibspi_err_t err = tms_mibspi_async_transfer(&req, MRAM_MIBSPI_TIMEOUT_MS);
 
     // Set received data
-    *reg_data = (uint8_t)rx_buffer[1];
+    *reg_data = rx_buffer[1];
 
     return (err != MIBSPI_NO_ERR) ? MRAM_MIBSPI_ERR : MRAM_OK;
 }
@@ -198,19 +185,11 @@ mram_err_t mram_mr25h256_read_status(uint8_t *reg_data) {
  * @return: MRAM_OK if no error, error code otherwise
  */
 mram_err_t mram_mr25h256_write_status(const uint8_t reg_data) {
-    mibspi_err_t err      = MIBSPI_NO_ERR;
-    uint16_t tx_buffer[2] = {MRAM_WRSR, reg_data};
-
-    // set write enable
-    if (mram_mr25h256_write_enable(true) != MIBSPI_NO_ERR) {
-        mram_mr25h256_write_enable(false);
-        return MRAM_MIBSPI_ERR;
-    }
+    const uint8_t tx_buffer[2] = {MRAM_WRSR, reg_data};
+    const mibspi_seg_t seg     = {.tg = &mram_2bytes_tg, .tx_data = tx_buffer, .rx_data = NULL, .len = 2};
 
     // Transmit the write status register command and data to write
-    err = tms_mibspi_tx(&mram_2bytes_tg, tx_buffer, MRAM_MIBSPI_TIMEOUT_MS);
-
-    mram_mr25h256_write_enable(false);
+    mibspi_err_t err = mram_mr25h256_xfer_write_enabled(&seg, 1);
 
     return (err != MIBSPI_NO_ERR) ? MRAM_MIBSPI_ERR : MRAM_OK;
 }
@@ -220,14 +199,83 @@ mram_err_t mram_mr25h256_write_status(const uint8_t reg_data) {
 /******************************************************************************/
 
 /**
- * @brief Enables or disables writes to MRAM
+ * @brief Execute a request between a write enable and a write disable command.
  *
- * @warning Must be enabled before any writes are performed
+ * The three requests are queued together and executed in order, then waited for.
  *
- * @param enable: 1 if write enable, 0 if write disable
- * @return: MRAM_OK if no error, error code otherwise
+ * @param segs: Segments of the request (a write command)
+ * @param num_segs: Number of segments
+ * @return: MIBSPI_NO_ERR if no error, error code otherwise
+ */
+static mibspi_err_t mram_mr25h256_xfer_write_enabled(const mibspi_seg_t *segs, uint8_t num_segs) {
+    static const uint8_t wren_cmd = MRAM_WREN;
+    static const uint8_t wrdi_cmd = MRAM_WRDI;
+
+    const mibspi_seg_t wren_seg = {.tg = &mram_1byte_tg, .tx_data = &wren_cmd, .rx_data = NULL, .len = 1};
+    const mibspi_seg_t wrdi_seg = {.tg = &mram_1byte_tg, .tx_data = &wrdi_cmd, .rx_data = NULL, .len = 1};
+    TaskHandle_t current_task   = xTaskGetCurrentTaskHandle();
+
+    mibspi_async_req_t reqs[3] = {
+        {.segs = &wren_seg, .num_segs = 1,        .timeout = MRAM_MIBSPI_TIMEOUT_MS, .notify_task = current_task},
+        {.segs = segs,      .num_segs = num_segs, .timeout = MRAM_MIBSPI_TIMEOUT_MS, .notify_task = current_task},
+        {.segs = &wrdi_seg, .num_segs = 1,        .timeout = MRAM_MIBSPI_TIMEOUT_MS, .notify_task = current_task},
+    };
+
+    mibspi_err_t err  = MIBSPI_NO_ERR;
+    uint8_t submitted = 0;
+
+    // Stop queueing at the first failure, but always queue the write disable once the write
+    // enable was queued
+    while ((submitted < 3U) && ((err == MIBSPI_NO_ERR) || (submitted == 2U))) {
+        mibspi_err_t submit_err = tms_mibspi_async_submit(&reqs[submitted], MRAM_MIBSPI_TIMEOUT_MS);
+
+        if (submit_err != MIBSPI_NO_ERR) {
+            err = (err != MIBSPI_NO_ERR) ? err : submit_err;
+            break;
+        }
+
+        submitted++;
+    }
+
+    // The requests must complete before they go out of scope
+    for (uint8_t i = 0; i < submitted; i++) {
+        mibspi_err_t req_err = tms_mibspi_async_wait(&reqs[i]);
+        err = (err != MIBSPI_NO_ERR) ? err : req_err;
+    }
+
+    return err;
+}
+
+/**
+ * @brief Build the segments of a command followed by a 16-bit address and a data stream.
+ *
+ * @param[out] segs: Segments to fill in (MRAM_MAX_SEGS entries)
+ * @param[out] cmd_addr: Buffer for the command and address bytes (MRAM_CMD_ADDR_LEN bytes), which
+ * must remain valid until the request completes
+ * @param cmd: Command byte
+ * @param addr: 16-bit address
+ * @param tx_data: Data to transmit after the address, or NULL to transmit zeros
+ * @param rx_data: Buffer for the data received after the address, or NULL to discard it
+ * @param size_bytes: Number of data bytes
+ * @return: Number of segments
  */
-static mibspi_err_t mram_mr25h256_write_enable(bool enable) {
-    uint16_t tx_buffer[1] = {enable ? MRAM_WREN : MRAM_WRDI};
-    return tms_mibspi_tx(&mram_1byte_tg, tx_buffer, MRAM_MIBSPI_TIMEOUT_MS);
+static uint8_t mram_mr25h256_cmd_addr_segs(mibspi_seg_t *segs, uint8_t *cmd_addr, uint8_t cmd, uint16_t addr,
+                                           const uint8_t *tx_data, uint8_t *rx_data, uint16_t size_bytes) {
+    cmd_addr[0] = cmd;
+    cmd_addr[1] = (addr >> 8) & 0xFF;
+    cmd_addr[2] = addr & 0xFF;
+
+    // There is no 3 byte transfer group, so the command and address are sent as 1 + 2 bytes
+    segs[0].tg      = &mram_1byte_tg;
+    segs[0].tx_data = &cmd_addr[0];
+    segs[0].rx_data = NULL;
+    segs[0].len     = 1;
+
+    segs[1].tg      = &mram_2bytes_tg;
+    segs[1].tx_data = &cmd_addr[1];
+    segs[1].rx_data = NULL;
+    segs[1].len     = 2;
+
+    // The smallest stream transfer group is 1 byte, so any length fits in the remaining segments
+    return 2U + tms_mibspi_async_stream_segs(&segs[2], MRAM_MAX_SEGS - 2U, mram_stream_tgs, MRAM_NUM_STREAM_TGS, tx_data, rx_data, size_bytes);
 }
@@ -7,6 +7,9 @@
 #define OBC_MRAM_H_
 
 #define MRAM_RESET_COUNTER_ADDR  0x1000
+#define MRAM_LOG_RING_ADDR       0x4000 // See log_mram.h, uses LOG_MRAM_REGION_SIZE bytes
+#define MRAM_TELEM_INDEX_ADDR    0x6100 // See telem_index.h, uses TELEM_INDEX_MRAM_SIZE bytes
+#define MRAM_TELEM_SPOOL_ADDR    0x7000 // See telem.c, uses TELEM_SPOOL_MRAM_SIZE bytes
 
 /**
  * @brief Return value for mram functions, indicating any errors.
@@ -79,6 +79,8 @@ endforeach()
 
 add_custom_command(
     OUTPUT              generated/logger.h
+                        generated/log_filter_gen.h
+                        generated/log_filter_gen.c
     WORKING_DIRECTORY   ${CMAKE_CURRENT_SOURCE_DIR}
     COMMAND             ./python/alea-obcfw/scripts/obcfw_codegen.py
                             log
@@ -87,6 +89,8 @@ add_custom_command(
 )
 list(APPEND SRC_FILES
     generated/logger.h
+    generated/log_filter_gen.h
+    generated/log_filter_gen.c
 )
 
 # Generate Command System Files
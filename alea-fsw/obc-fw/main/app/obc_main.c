@@ -20,6 +20,7 @@
 #include "system/logging/log_sys.h"
 #include "system/telem/telem.h"
 #include "tms_mibspi.h"
+#include "tms_mibspi_async.h"
 #include "obc_startup.h"
 #include "obc_flash.h"
 #include "obc_watchdog.h"
@@ -30,10 +31,13 @@
 #include "log_sys.h"
 #include "logger.h"
 #include "obc_filesystem.h"
+#include "fs_upload.h"
 #include "obc_settings.h"
 #include "obc_mram.h"
 #include "telem.h"
 #include "telem_exec.h"
+#include "telem_index.h"
+#include "telem_store.h"
 
 #include "comms_api.h"
 #include "comms_defs.h"
@@ -50,6 +54,7 @@
 #include "tms_i2c.h"
 #include "cmd_sys_imm.h"
 #include "cmd_sys_sched.h"
+#include "cmd_sys_results.h"
 #include "cmd_sys_exec.h"
 #include "gndstn_link.h"
 #include "gps_serial_rx.h"
@@ -169,18 +174,24 @@ void obc_main(void) {
     gpio_pre_init();
     rtc_pre_init();
     filesystem_pre_init();
+    fs_upload_pre_init();
+    telem_pre_init();
     telem_exec_pre_init();
+    telem_index_pre_init();
+    telem_store_pre_init();
     gps_pre_init();
     rtc_scheduler_pre_init();
 
     cmd_sys_exec_pre_init();
     cmd_sys_imm_pre_init();
     cmd_sys_sched_pre_init();
+    cmd_sys_results_pre_init();
 
     gndstn_link_pre_init();
     comms_service_pre_init();
 
     tms_mibspi_pre_init();
+    tms_mibspi_async_pre_init();
     tms_i2c_pre_init();
     tms_spi_pre_init();
     tms_adc_pre_init();
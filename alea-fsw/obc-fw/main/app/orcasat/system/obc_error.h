@@ -81,9 +81,14 @@ typedef enum flash_err {
  */
 typedef enum {
     /* OBC filesystem errors */
+    FS_UPLOAD_CRC_ERR           =   13,            // Uploaded file doesn't match the expected CRC
+    FS_UPLOAD_INCOMPLETE_ERR    =   12,            // Not all blocks of the upload have been received
+    FS_UPLOAD_INACTIVE_ERR      =   11,            // No upload in progress
+    FS_HANDLES_FULL_ERR         =   10,            // No free slots in the write ring handle table
+    FS_INVALID_HANDLE_ERR       =    9,
     FS_FLUSH_FAILED             =    8,
-    FS_ENQUEUE_ERR              =    7,
-    FS_WRITE_TOO_BIG_ERR        =    6,            // Write operation exceeds WRITE_CACHE_SIZE
+    FS_ENQUEUE_ERR              =    7,            // Write ring is full
+    FS_WRITE_TOO_BIG_ERR        =    6,            // Write operation exceeds FS_WRITE_MAX_SIZE
     FS_READ_FAILURE_ERR         =    5,
     FS_WRITE_FAILURE_ERR        =    4,
     FS_TEST_SEEK_ERR            =    3,
@@ -140,6 +140,28 @@ TaskHandle_t obc_rtos_get_task_handle(obc_task_id_t id) {
     }
 }
 
+/**
+ * @brief Retrieve the ID of the task that is currently running
+ *
+ * @return ID of the current task, or OBC_TASK_COUNT if called before the scheduler was started
+ * or from a task that was not created through obc_rtos (e.g. the FreeRTOS timer task)
+ */
+obc_task_id_t obc_rtos_get_current_task_id(void) {
+    if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) {
+        return OBC_TASK_COUNT;
+    }
+
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+
+    for (uint8_t task_id = 0; task_id < OBC_TASK_COUNT; task_id++) {
+        if (task_handles[task_id] == current) {
+            return (obc_task_id_t)task_id;
+        }
+    }
+
+    return OBC_TASK_COUNT;
+}
+
 /**
  * @brief Retrieve pointers to the memory allocated for the IDLE task.
  *
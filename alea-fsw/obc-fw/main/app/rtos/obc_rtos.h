@@ -47,6 +47,7 @@ TaskHandle_t obc_rtos_create_task_privileged(obc_task_id_t id, TaskFunction_t ta
 BaseType_t obc_rtos_task_hook(obc_task_id_t id, void *arg);
 
 TaskHandle_t obc_rtos_get_task_handle(obc_task_id_t id);
+obc_task_id_t obc_rtos_get_current_task_id(void);
 
 void obc_rtos_get_idle_task_memory(StaticTask_t **task_buffer, StackType_t **stack, uint32_t *stack_size);
 
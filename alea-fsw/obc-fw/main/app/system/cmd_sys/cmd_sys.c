@@ -104,9 +104,13 @@ cmd_sys_err_t cmd_sys_recv_header(cmd_sys_cmd_t *cmd, uint8_t *buf, uint32_t pol
 /**
  * @brief Schedule a command for execution later.
  *
- * @param[in] cmd Pointer to the command struct. The header should already be parsed and populated.
- * @param[in] buf Pointer to a buffer containing the header raw bytes and enough remaining space
- *                to store the data bytes (for a total of up to CMD_SYS_SCHED_MAX_DATA_SIZE bytes)
+ * Commands whose data doesn't fit in buf are spooled to a file as they are received
+ * (see cmd_sys_sched_push_spooled_cmd), up to CMD_SYS_SCHED_MAX_SPOOLED_DATA_SIZE bytes of data.
+ *
+ * @param[in] cmd           Pointer to the command struct. The header should already be parsed and populated.
+ * @param[in] buf           Pointer to a buffer containing the header raw bytes and enough remaining space
+ *                          to store the data bytes (for a total of up to CMD_SYS_SCHED_MAX_DATA_SIZE bytes)
+ * @param[in] wait_callback Optional callback function that will be called while spooling a large command
  *
  * @return Status code:
  *            - CMD_SYS_ERR_INVALID_ARGS if cmd, cmd->input or cmd->output is NULL
@@ -114,33 +118,42 @@ cmd_sys_err_t cmd_sys_recv_header(cmd_sys_cmd_t *cmd, uint8_t *buf, uint32_t pol
  *            - CMD_SYS_ERR_READ_TIMEOUT if an error occurs reading the remaining command data
  *            - otherwise the status from cmd_sys_begin_response or cmd_sys_finish_response is returned
  */
-cmd_sys_err_t cmd_sys_schedule_cmd(const cmd_sys_cmd_t *cmd, uint8_t *buf) {
+cmd_sys_err_t cmd_sys_schedule_cmd(const cmd_sys_cmd_t *cmd, uint8_t *buf, cmd_sys_exec_wait_cb_t wait_callback) {
     if ((cmd == NULL) || (cmd->input == NULL) || (cmd->output == NULL)) {
         return CMD_SYS_ERR_INVALID_ARGS;
     }
 
     // Scheduled command - check data_len
-    if (cmd->header.data_len > (CMD_SYS_SCHED_MAX_DATA_SIZE - CMD_SYS_MSG_HEADER_LEN)) {
-        // TODO: ALEA-863 stream the data to a file or something if it's too big
+    if (cmd->header.data_len > CMD_SYS_SCHED_MAX_SPOOLED_DATA_SIZE) {
         return CMD_SYS_ERR_ARGS_TOO_LARGE;
     }
 
-    // Read the rest of the data into the buf
     uint32_t data_len = cmd->header.data_len;
+    cmd_sys_err_t err = CMD_SYS_SUCCESS;
+
+    if (data_len > (CMD_SYS_SCHED_MAX_DATA_SIZE - CMD_SYS_MSG_HEADER_LEN)) {
+        // Too large to be stored in the schedule, the data is streamed to a file instead
+        err = cmd_sys_sched_push_spooled_cmd(&(cmd->header), buf, CMD_SYS_MSG_HEADER_LEN, cmd->input, wait_callback);
+    } else {
+        // Read the rest of the data into the buf
+        if (data_len > 0) {
+            uint32_t bytes_read = io_stream_read(cmd->input, &(buf[CMD_SYS_MSG_HEADER_LEN]), data_len, portMAX_DELAY, NULL);
+
+            if (bytes_read != data_len) {
+                return CMD_SYS_ERR_READ_TIMEOUT;
+            }
+        }
 
-    if (data_len > 0) {
-        uint32_t bytes_read = io_stream_read(cmd->input, &(buf[CMD_SYS_MSG_HEADER_LEN]), data_len, portMAX_DELAY, NULL);
+        // Schedule the command
+        err = cmd_sys_sched_push_cmd(&(cmd->header), buf, (CMD_SYS_MSG_HEADER_LEN + data_len));
+    }
 
-        if (bytes_read != data_len) {
-            return CMD_SYS_ERR_READ_TIMEOUT;
-        }
+    if (err == CMD_SYS_ERR_READ_TIMEOUT) {
+        return err;
     }
 
     cmd_sys_resp_code_t resp_code = CMD_SYS_RESP_CODE_ERROR;
 
-    // Schedule the command
-    cmd_sys_err_t err = cmd_sys_sched_push_cmd(&(cmd->header), buf, (CMD_SYS_MSG_HEADER_LEN + data_len));
-
     if (err == CMD_SYS_SUCCESS) {
         resp_code = CMD_SYS_RESP_CODE_SUCCESS_SCHED;
     }
@@ -158,37 +171,44 @@ cmd_sys_err_t cmd_sys_schedule_cmd(const cmd_sys_cmd_t *cmd, uint8_t *buf) {
 }
 
 /**
- * @brief Send a command to the cmd_sys_exec task for execution and wait for it to complete.
+ * @brief Send a command to the cmd_sys_exec workers for execution and wait for it to complete.
+ *
+ * The maximum time to wait depends on the duration class of the command (see cmd_sys_duration_t).
+ * If it elapses, the command is cancelled (see cmd_sys_exec_cancel) and this waits for it to stop using
+ * the streams of cmd, for up to CMD_SYS_EXEC_STOP_TIMEOUT_MS. Either way, cmd can be reused once this returns.
  *
  * @param[in] cmd               Pointer to the command struct. The header should already be parsed and populated
  * @param[in] poll_period_ticks Polling period when checking if the command execution has completed
- * @param[in] timeout_ticks     Maximum total amount of time to wait for the command to finish executing
  * @param[in] wait_callback     Optional callback function that will be called every time poll_period_ticks elapses
  *
  * @return Status code:
  *            - CMD_SYS_ERR_INVALID_ARGS if cmd, cmd->input or cmd->output is NULL
  *            - CMD_SYS_ERR_EXEC_Q_TIMEOUT if there is not enough space in the exec queue
+ *            - CMD_SYS_ERR_EXEC_TIMEOUT if the command did not finish executing in time
  *            - otherwise the status returned from the execution of the command
  */
-cmd_sys_err_t cmd_sys_execute(cmd_sys_cmd_t *cmd, uint32_t poll_period_ticks, uint32_t timeout_ticks, cmd_sys_exec_wait_cb_t wait_callback) {
+cmd_sys_err_t cmd_sys_execute(cmd_sys_cmd_t *cmd, uint32_t poll_period_ticks, cmd_sys_exec_wait_cb_t wait_callback) {
     if ((cmd == NULL) || (cmd->input == NULL) || (cmd->output == NULL)) {
         return CMD_SYS_ERR_INVALID_ARGS;
     }
 
-    // Send command to cmd_sys_exec task
+    const cmd_sys_cmd_spec_t *cmd_spec = cmd_sys_get_spec(cmd->header.cmd_id);
+    bool is_long = (cmd_spec != NULL) && (cmd_spec->duration == CMD_SYS_DURATION_LONG);
+    uint32_t timeout_left_ticks = pdMS_TO_TICKS(is_long ? CMD_SYS_EXEC_LONG_TIMEOUT_MS : CMD_SYS_EXEC_SHORT_TIMEOUT_MS);
+
+    // Send command to cmd_sys_exec workers
     TaskHandle_t task_handle = xTaskGetCurrentTaskHandle();
-    cmd_sys_err_t err = cmd_sys_exec_enqueue(cmd, &cmd_sys_exec_callback, task_handle, 0);
+    xTaskNotifyStateClearIndexed(task_handle, NOTIFICATION_INDEX);
+
+    cmd_sys_err_t err = cmd_sys_exec_enqueue(cmd, &cmd_sys_exec_callback, task_handle);
 
     if (err != CMD_SYS_SUCCESS) {
         return err;
     }
 
-    // Wait for a notification from the cmd_sys_exec task
-    uint32_t timeout_left_ticks = timeout_ticks;
+    // Wait for a notification from the cmd_sys_exec worker
     uint32_t notification_value = 0;
 
-    err = CMD_SYS_ERR_EXEC_TIMEOUT;
-
     while (timeout_left_ticks > 0) {
         if (wait_callback != NULL) {
             wait_callback();
@@ -198,15 +218,57 @@ cmd_sys_err_t cmd_sys_execute(cmd_sys_cmd_t *cmd, uint32_t poll_period_ticks, ui
 
         if (xTaskNotifyWaitIndexed(NOTIFICATION_INDEX, 0U, 0xFFFFFFFFU, &notification_value, loop_timeout_ticks) == pdTRUE) {
             // Notification received --> command execution complete
-            err = (cmd_sys_err_t)notification_value;
-            break;
+            return (cmd_sys_err_t)notification_value;
         } else {
             // No notification --> update timeout
             timeout_left_ticks -= loop_timeout_ticks;
         }
     }
 
-    return err;
+    if (cmd_sys_exec_cancel(cmd)) {
+        // The command never started
+        return CMD_SYS_ERR_EXEC_TIMEOUT;
+    }
+
+    // The worker is done with cmd once it notifies (with the status of the command if it finished just in time)
+    timeout_left_ticks = pdMS_TO_TICKS(CMD_SYS_EXEC_STOP_TIMEOUT_MS);
+
+    while (timeout_left_ticks > 0) {
+        if (wait_callback != NULL) {
+            wait_callback();
+        }
+
+        uint32_t loop_timeout_ticks = MIN(timeout_left_ticks, poll_period_ticks);
+
+        if (xTaskNotifyWaitIndexed(NOTIFICATION_INDEX, 0U, 0xFFFFFFFFU, &notification_value, loop_timeout_ticks) == pdTRUE) {
+            err = (cmd_sys_err_t)notification_value;
+            return (err == CMD_SYS_ERR_EXEC_CANCELLED) ? CMD_SYS_ERR_EXEC_TIMEOUT : err;
+        }
+
+        timeout_left_ticks -= loop_timeout_ticks;
+    }
+
+    if (!cmd_sys_exec_detach(cmd)) {
+        // The command stopped just in time, so the notification is on its way
+        xTaskNotifyWaitIndexed(NOTIFICATION_INDEX, 0U, 0xFFFFFFFFU, &notification_value, poll_period_ticks);
+    }
+
+    return CMD_SYS_ERR_EXEC_TIMEOUT;
+}
+
+/**
+ * @brief Get the specification of a command
+ *
+ * @param[in] cmd_id Command ID
+ *
+ * @return Pointer to the specification, or NULL if there is no command with this ID
+ */
+const cmd_sys_cmd_spec_t *cmd_sys_get_spec(uint8_t cmd_id) {
+    if ((cmd_id >= LEN(CMD_SPEC_TABLE)) || (CMD_SPEC_TABLE[cmd_id].invoke == NULL)) {
+        return NULL;
+    }
+
+    return &CMD_SPEC_TABLE[cmd_id];
 }
 
 /**
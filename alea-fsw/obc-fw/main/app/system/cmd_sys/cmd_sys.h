@@ -32,6 +32,17 @@
 
 #define CMD_SYS_EXEC_TIMEOUT_MS          60000U
 
+/**
+ * @brief Maximum time to wait for a command to finish executing, by duration class (see cmd_sys_duration_t)
+ */
+#define CMD_SYS_EXEC_SHORT_TIMEOUT_MS    10000U
+#define CMD_SYS_EXEC_LONG_TIMEOUT_MS     CMD_SYS_EXEC_TIMEOUT_MS
+
+/**
+ * @brief Maximum time to wait for a cancelled command to stop, long enough for an I/O call already in progress to time out
+ */
+#define CMD_SYS_EXEC_STOP_TIMEOUT_MS     (2U * CMD_SYS_INPUT_READ_TIMEOUT_MS)
+
 /******************************************************************************/
 /*                              T Y P E D E F S                               */
 /******************************************************************************/
@@ -55,6 +66,7 @@ typedef enum {
     CMD_SYS_ERR_EXEC_TIMEOUT   = 12, ///< A timeout occurred waiting for a command to finish executing
     CMD_SYS_ERR_NO_HEADER      = 13, ///< No header was received
     CMD_SYS_ERR_INVALID_STATE  = 14, ///< OBC cannot perform the request in the current state
+    CMD_SYS_ERR_EXEC_CANCELLED = 15, ///< The command was cancelled before it finished executing
 } cmd_sys_err_t;
 
 /**
@@ -88,6 +100,7 @@ typedef struct {
     const io_ostream_t *output;
     cmd_sys_msg_header_t header;
     uint32_t exec_timestamp;
+    volatile bool cancelled; ///< Set when the command should stop executing (see cmd_sys_exec_cancel)
 } cmd_sys_cmd_t;
 
 /**
@@ -95,6 +108,22 @@ typedef struct {
  */
 typedef cmd_sys_err_t (*cmd_invoke_t)(const cmd_sys_cmd_t *cmd, const data_fmt_desc_t *args_desc, const data_fmt_desc_t *resp_desc);
 
+/**
+ * @brief Expected duration class of a command, which selects the executor it runs on
+ */
+typedef enum {
+    CMD_SYS_DURATION_SHORT = 0, ///< Completes quickly (no long I/O), so it doesn't hold up other short commands
+    CMD_SYS_DURATION_LONG  = 1, ///< May take several seconds (e.g. streaming files or waiting on a peripheral)
+} cmd_sys_duration_t;
+
+/**
+ * @brief Priority of a command among the commands waiting for the same executor
+ */
+typedef enum {
+    CMD_SYS_PRIORITY_NORMAL = 0, ///< Executed in the order it was received
+    CMD_SYS_PRIORITY_HIGH   = 1, ///< Executed before the normal priority commands already waiting
+} cmd_sys_priority_t;
+
 /**
  * @brief Specification for a command to serialize / deserialize arguments and response data
  */
@@ -102,6 +131,8 @@ typedef struct {
     cmd_invoke_t invoke;
     const data_fmt_desc_t *args;
     const data_fmt_desc_t *resp;
+    cmd_sys_duration_t duration;
+    cmd_sys_priority_t priority;
 } cmd_sys_cmd_spec_t;
 
 typedef void (*cmd_sys_exec_wait_cb_t)(void);
@@ -111,9 +142,10 @@ typedef void (*cmd_sys_exec_wait_cb_t)(void);
 /******************************************************************************/
 
 cmd_sys_err_t cmd_sys_recv_header(cmd_sys_cmd_t *cmd, uint8_t *buf, uint32_t poll_period_ticks);
-cmd_sys_err_t cmd_sys_schedule_cmd(const cmd_sys_cmd_t *cmd, uint8_t *buf);
-cmd_sys_err_t cmd_sys_execute(cmd_sys_cmd_t *cmd, uint32_t poll_period_ticks, uint32_t timeout_ticks, cmd_sys_exec_wait_cb_t wait_callback);
+cmd_sys_err_t cmd_sys_schedule_cmd(const cmd_sys_cmd_t *cmd, uint8_t *buf, cmd_sys_exec_wait_cb_t wait_callback);
+cmd_sys_err_t cmd_sys_execute(cmd_sys_cmd_t *cmd, uint32_t poll_period_ticks, cmd_sys_exec_wait_cb_t wait_callback);
 
+const cmd_sys_cmd_spec_t *cmd_sys_get_spec(uint8_t cmd_id);
 cmd_sys_err_t cmd_sys_invoke_cmd(const cmd_sys_cmd_t *cmd);
 
 cmd_sys_err_t cmd_sys_begin_response(const cmd_sys_cmd_t *cmd, cmd_sys_resp_code_t resp_code, uint32_t resp_data_len);
@@ -1,6 +1,13 @@
 /**
- * @file cmd_sys_exe.c
+ * @file cmd_sys_exec.c
  * @brief Command system executor
+ *
+ * Commands are executed by a pool of worker tasks. Each worker executes the commands of one duration class
+ * (see cmd_sys_duration_t) so that long commands (e.g. streaming files or waiting on the GPS) never delay
+ * short ones (e.g. PING). The commands of a class wait in a queue ordered by priority, then by arrival.
+ *
+ * A command that is cancelled while executing is switched over to streams that read and write nothing, so
+ * it can't take the input or interleave with the output of the commands that follow it.
  */
 
 /******************************************************************************/
@@ -17,18 +24,27 @@
 #include "obc_watchdog.h"
 #include "obc_rtos.h"
 
+// Utils
+#include "obc_utils.h"
+
 // FreeRTOS
 #include "rtos.h"
 
+// Standard Library
+#include <string.h>
+
 /******************************************************************************/
 /*                               D E F I N E S                                */
 /******************************************************************************/
 
-#define CMD_QUEUE_LENGTH     2U
-#define CMD_QUEUE_ITEM_SIZE  sizeof(cmd_sys_exec_queue_item_t)
+#define CMD_QUEUE_LENGTH     8U
+#define CMD_DURATION_COUNT   2U
 
 #define CMD_SYS_EXEC_POLL_PERIOD_MS 1000U
 
+#define NOTIFICATION_INDEX 1U // index 0 is used by stream/message buffers
+// see https://www.freertos.org/RTOS-task-notifications.html
+
 /******************************************************************************/
 /*                              T Y P E D E F S                               */
 /******************************************************************************/
@@ -37,87 +53,328 @@ typedef struct {
     cmd_sys_cmd_t *cmd;
     cmd_sys_exec_callback_t callback;
     void *arg;
+    cmd_sys_priority_t priority;
 } cmd_sys_exec_queue_item_t;
 
+/**
+ * @brief Commands of a duration class waiting to be executed, highest priority first
+ */
+typedef struct {
+    cmd_sys_exec_queue_item_t items[CMD_QUEUE_LENGTH];
+    uint8_t count;
+} cmd_sys_exec_queue_t;
+
+typedef struct {
+    obc_task_id_t task_id;
+    cmd_sys_duration_t duration;        // Class of the commands executed by this worker
+    TaskHandle_t handle;
+
+    cmd_sys_exec_queue_item_t current;  // Command being executed (current.cmd is NULL when idle or detached)
+    cmd_sys_cmd_t cmd;                  // Copy of the command being executed, which the implementation runs on
+} cmd_sys_exec_worker_t;
+
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
 /******************************************************************************/
 
 static void cmd_sys_exec_task(void *pvParameters);
+static void queue_remove(cmd_sys_exec_queue_t *queue, uint8_t index);
+
+static uint32_t cancelled_read(void *handle, uint8_t *buf, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
+static uint32_t cancelled_write(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
 
 /******************************************************************************/
 /*               P R I V A T E  G L O B A L  V A R I A B L E S                */
 /******************************************************************************/
 
-static QueueHandle_t cmd_queue = NULL;
-static uint8_t cmd_queue_storage[CMD_QUEUE_LENGTH * CMD_QUEUE_ITEM_SIZE] = { 0 };
-static StaticQueue_t cmd_queue_buf = { 0 };
+static cmd_sys_exec_queue_t cmd_queues[CMD_DURATION_COUNT] = { 0 };
+
+static cmd_sys_exec_worker_t workers[] = {
+    { .task_id = OBC_TASK_ID_CMD_SYS_EXEC,      .duration = CMD_SYS_DURATION_SHORT },
+    { .task_id = OBC_TASK_ID_CMD_SYS_EXEC_LONG, .duration = CMD_SYS_DURATION_LONG  },
+};
+
+// Streams of a command once it's cancelled
+static const io_istream_t cancelled_input = {
+    .handle = NULL,
+    .read   = &cancelled_read,
+};
+
+static const io_ostream_t cancelled_output = {
+    .handle = NULL,
+    .write  = &cancelled_write,
+    .flush  = NULL,
+};
 
 /******************************************************************************/
 /*                       P U B L I C  F U N C T I O N S                       */
 /******************************************************************************/
 
 /**
- * @brief Initialize FreeRTOS data structures for the command system executor
+ * @brief Start the worker tasks of the command system executor
  */
 void cmd_sys_exec_pre_init(void) {
-    cmd_queue = xQueueCreateStatic(CMD_QUEUE_LENGTH, CMD_QUEUE_ITEM_SIZE, cmd_queue_storage, &cmd_queue_buf);
-    obc_rtos_create_task(OBC_TASK_ID_CMD_SYS_EXEC, &cmd_sys_exec_task, NULL, OBC_WATCHDOG_ACTION_ALLOW);
+    for (uint8_t i = 0; i < LEN(workers); i++) {
+        workers[i].handle = obc_rtos_create_task(workers[i].task_id, &cmd_sys_exec_task, &workers[i], OBC_WATCHDOG_ACTION_ALLOW);
+    }
 }
 
 /**
  * @brief Added a command to the queue for execution
  *
+ * The command is executed by a worker of its duration class. High priority commands are executed before the
+ * normal priority commands already waiting.
+ *
  * @param[in] cmd           Pointer to command struct to add to the queue. The pointer itself will be stored in the queue
- *                          so the object pointed to must remain valid and unmodified until the callback is invoked.
+ *                          so the object pointed to must remain valid and unmodified until the callback is invoked
+ *                          (or the command is cancelled).
  * @param[in] callback      Optional function that is called after the command is executed and passed the return value of the call
  *                          to cmd_sys_invoke_cmd
  * @param[in] arg           Argument that will be passed to the callback
- * @param[in] timeout_ticks Timeout (ticks) to wait for space in the queue
  *
  * @return Status code:
  *            - CMD_SYS_SUCCESS if the command was added to the queue successfully
- *            - CMD_SYS_ERR_EXEC_TIMEOUT if a timeout occurred waiting for space in the queue
+ *            - CMD_SYS_ERR_INVALID_ARGS if cmd is NULL
+ *            - CMD_SYS_ERR_EXEC_Q_TIMEOUT if the queue of the duration class of the command is full
  */
-cmd_sys_err_t cmd_sys_exec_enqueue(cmd_sys_cmd_t *cmd, cmd_sys_exec_callback_t callback, void *arg, uint32_t timeout_ticks) {
+cmd_sys_err_t cmd_sys_exec_enqueue(cmd_sys_cmd_t *cmd, cmd_sys_exec_callback_t callback, void *arg) {
+    if (cmd == NULL) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    }
+
+    // Unknown commands are short, they only respond with CMD_SYS_RESP_CODE_CMD_DNE
+    const cmd_sys_cmd_spec_t *spec = cmd_sys_get_spec(cmd->header.cmd_id);
+    cmd_sys_duration_t duration = (spec != NULL) ? spec->duration : CMD_SYS_DURATION_SHORT;
+    cmd_sys_priority_t priority = (spec != NULL) ? spec->priority : CMD_SYS_PRIORITY_NORMAL;
+
     cmd_sys_exec_queue_item_t queue_item = {
         .cmd      = cmd,
         .callback = callback,
-        .arg      = arg
+        .arg      = arg,
+        .priority = priority
     };
 
+    cmd_sys_exec_queue_t *queue = &cmd_queues[duration];
     cmd_sys_err_t err = CMD_SYS_ERR_EXEC_Q_TIMEOUT;
 
-    if (xQueueSend(cmd_queue, &queue_item, timeout_ticks) == pdTRUE) {
+    cmd->cancelled = false;
+
+    taskENTER_CRITICAL();
+
+    if (queue->count < CMD_QUEUE_LENGTH) {
+        uint8_t pos = queue->count;
+
+        if (priority == CMD_SYS_PRIORITY_HIGH) {
+            // After the high priority commands already waiting
+            pos = 0;
+
+            while ((pos < queue->count) && (queue->items[pos].priority == CMD_SYS_PRIORITY_HIGH)) {
+                pos++;
+            }
+
+            memmove(&queue->items[pos + 1U], &queue->items[pos], (queue->count - pos) * sizeof(queue->items[0]));
+        }
+
+        queue->items[pos] = queue_item;
+        queue->count++;
         err = CMD_SYS_SUCCESS;
     }
 
+    taskEXIT_CRITICAL();
+
+    if (err == CMD_SYS_SUCCESS) {
+        // Each worker of the class counts the commands it may have to execute
+        for (uint8_t i = 0; i < LEN(workers); i++) {
+            if (workers[i].duration == duration) {
+                xTaskNotifyGiveIndexed(workers[i].handle, NOTIFICATION_INDEX);
+            }
+        }
+    }
+
     return err;
 }
 
+/**
+ * @brief Cancel a command added with cmd_sys_exec_enqueue
+ *
+ * A command that is still waiting is removed from its queue, and its callback will not be called.
+ *
+ * A command that is executing is asked to stop (see cmd_sys_exec_cancelled). Its input and output are
+ * replaced by streams that read and write nothing, so it no longer uses the streams of the command struct.
+ * Its callback is still called once it stops (with CMD_SYS_ERR_EXEC_CANCELLED), after which the command struct
+ * can be reused. If it doesn't stop in time, use cmd_sys_exec_detach.
+ *
+ * @param[in] cmd Pointer to the command struct passed to cmd_sys_exec_enqueue
+ *
+ * @return true if the command was removed from its queue, false if its callback has been or will be called
+ */
+bool cmd_sys_exec_cancel(const cmd_sys_cmd_t *cmd) {
+    bool removed = false;
+
+    taskENTER_CRITICAL();
+
+    for (uint8_t d = 0; d < CMD_DURATION_COUNT; d++) {
+        for (uint8_t i = 0; i < cmd_queues[d].count; i++) {
+            if (cmd_queues[d].items[i].cmd == cmd) {
+                queue_remove(&cmd_queues[d], i);
+                removed = true;
+                break;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < LEN(workers); i++) {
+        if (workers[i].current.cmd == cmd) {
+            workers[i].cmd.cancelled = true;
+            workers[i].cmd.input = &cancelled_input;
+            workers[i].cmd.output = &cancelled_output;
+        }
+    }
+
+    taskEXIT_CRITICAL();
+
+    return removed;
+}
+
+/**
+ * @brief Stop waiting for a cancelled command that didn't stop in time
+ *
+ * The command keeps running on the streams it was switched to by cmd_sys_exec_cancel, but its callback
+ * will not be called and the command struct can be reused once this returns.
+ *
+ * @param[in] cmd Pointer to the command struct passed to cmd_sys_exec_enqueue
+ *
+ * @return true if the command was still executing, false if it had already stopped (its callback has been or is being called)
+ */
+bool cmd_sys_exec_detach(const cmd_sys_cmd_t *cmd) {
+    bool found = false;
+
+    taskENTER_CRITICAL();
+
+    for (uint8_t i = 0; i < LEN(workers); i++) {
+        if (workers[i].current.cmd == cmd) {
+            workers[i].current.cmd = NULL;
+            workers[i].current.callback = NULL;
+            found = true;
+        }
+    }
+
+    taskEXIT_CRITICAL();
+
+    return found;
+}
+
+/**
+ * @brief Check if the command being executed was cancelled
+ *
+ * Commands that can run for a long time should check this regularly and stop with CMD_SYS_ERR_EXEC_CANCELLED
+ * when it returns true. Their response may be left incomplete since nobody is waiting for it anymore.
+ *
+ * @param[in] cmd Pointer to the command struct passed to the command implementation
+ *
+ * @return true if the command should stop executing
+ */
+bool cmd_sys_exec_cancelled(const cmd_sys_cmd_t *cmd) {
+    return cmd->cancelled;
+}
+
+/**
+ * @brief Pet the watchdog on behalf of the executor worker running the current command.
+ *
+ * Command implementations call this instead of obc_watchdog_pet since they don't know which worker runs them.
+ */
+void cmd_sys_exec_pet(void) {
+    obc_task_id_t task_id = obc_rtos_get_current_task_id();
+
+    if (task_id < OBC_TASK_COUNT) {
+        obc_watchdog_pet(task_id);
+    }
+}
+
 /******************************************************************************/
 /*                      P R I V A T E  F U N C T I O N S                      */
 /******************************************************************************/
 
 static void cmd_sys_exec_task(void *pvParameters) {
-    cmd_sys_exec_queue_item_t queue_item;
+    cmd_sys_exec_worker_t *worker = (cmd_sys_exec_worker_t *)pvParameters;
+    cmd_sys_exec_queue_t *queue = &cmd_queues[worker->duration];
 
     vPortTaskUsesFPU();
 
     while (1) {
 
-        obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_EXEC);
+        obc_watchdog_pet(worker->task_id);
 
-        if (xQueueReceive(cmd_queue, &queue_item, pdMS_TO_TICKS(CMD_SYS_EXEC_POLL_PERIOD_MS)) == pdTRUE) {
-            // Set exec_timestamp field of command
-            uint32_t exec_timestamp = rtc_get_epoch_time();
-            queue_item.cmd->exec_timestamp = exec_timestamp;
+        if (ulTaskNotifyTakeIndexed(NOTIFICATION_INDEX, pdFALSE, pdMS_TO_TICKS(CMD_SYS_EXEC_POLL_PERIOD_MS)) == 0) {
+            continue;
+        }
 
-            cmd_sys_err_t err = cmd_sys_invoke_cmd(queue_item.cmd);
+        bool found = false;
 
-            if (queue_item.callback != NULL) {
-                queue_item.callback(err, queue_item.arg);
-            }
+        taskENTER_CRITICAL();
+
+        // The command may have been cancelled or taken by another worker of the class
+        if (queue->count > 0) {
+            worker->current = queue->items[0];
+            worker->cmd = *(worker->current.cmd);
+            queue_remove(queue, 0);
+            found = true;
+        }
+
+        taskEXIT_CRITICAL();
+
+        if (!found) {
+            continue;
         }
+
+        // Set exec_timestamp field of command
+        uint32_t exec_timestamp = rtc_get_epoch_time();
+        worker->cmd.exec_timestamp = exec_timestamp;
+
+        cmd_sys_err_t err = cmd_sys_invoke_cmd(&worker->cmd);
+
+        taskENTER_CRITICAL();
+
+        // A cancelled command may have failed on its replaced streams rather than stopped
+        if (worker->cmd.cancelled) {
+            err = CMD_SYS_ERR_EXEC_CANCELLED;
+        }
+
+        cmd_sys_exec_callback_t callback = worker->current.callback;
+        void *arg = worker->current.arg;
+        worker->current.cmd = NULL;
+        worker->current.callback = NULL;
+        taskEXIT_CRITICAL();
+
+        if (callback != NULL) {
+            callback(err, arg);
+        }
+    }
+}
+
+static void queue_remove(cmd_sys_exec_queue_t *queue, uint8_t index) {
+    queue->count--;
+    memmove(&queue->items[index], &queue->items[index + 1U], (queue->count - index) * sizeof(queue->items[0]));
+}
+
+/**
+ * @brief io_istream_t compatible API for the input of a cancelled command, nothing is ever read
+ */
+static uint32_t cancelled_read(void *handle, uint8_t *buf, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
+    if (timeout_left != NULL) {
+        *timeout_left = 0;
     }
+
+    return 0;
+}
+
+/**
+ * @brief io_ostream_t compatible API for the output of a cancelled command, nothing is ever written
+ */
+static uint32_t cancelled_write(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
+    if (timeout_left != NULL) {
+        *timeout_left = 0;
+    }
+
+    return 0;
 }
@@ -32,6 +32,11 @@ typedef void (*cmd_sys_exec_callback_t)(cmd_sys_err_t status, void *arg);
 
 void cmd_sys_exec_pre_init(void);
 
-cmd_sys_err_t cmd_sys_exec_enqueue(cmd_sys_cmd_t *cmd, cmd_sys_exec_callback_t callback, void *arg, uint32_t timeout_ticks);
+cmd_sys_err_t cmd_sys_exec_enqueue(cmd_sys_cmd_t *cmd, cmd_sys_exec_callback_t callback, void *arg);
+bool cmd_sys_exec_cancel(const cmd_sys_cmd_t *cmd);
+bool cmd_sys_exec_detach(const cmd_sys_cmd_t *cmd);
+
+bool cmd_sys_exec_cancelled(const cmd_sys_cmd_t *cmd);
+void cmd_sys_exec_pet(void);
 
 #endif // CMD_SYS_EXEC_H_
@@ -32,7 +32,6 @@
 // see https://www.freertos.org/RTOS-task-notifications.html
 
 #define CMD_SYS_IMM_POLL_PERIOD_MS  1000U
-#define CMD_SYS_IMM_EXEC_TIMEOUT_MS 60000U
 
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
@@ -75,9 +74,9 @@ static void cmd_sys_imm_task(void *pvParameters) {
 
         if (err == CMD_SYS_SUCCESS) {
             if (cmd.header.timestamp == CMD_SYS_TIMESTAMP_IMMEDIATE) {
-                err = cmd_sys_execute(&cmd, pdMS_TO_TICKS(CMD_SYS_IMM_POLL_PERIOD_MS), pdMS_TO_TICKS(CMD_SYS_IMM_EXEC_TIMEOUT_MS), &exec_wait_callback);
+                err = cmd_sys_execute(&cmd, pdMS_TO_TICKS(CMD_SYS_IMM_POLL_PERIOD_MS), &exec_wait_callback);
             } else {
-                err = cmd_sys_schedule_cmd(&cmd, buf);
+                err = cmd_sys_schedule_cmd(&cmd, buf, &exec_wait_callback);
             }
 
             // TODO: ALEA-857 do something with err
@@ -86,6 +85,6 @@ static void cmd_sys_imm_task(void *pvParameters) {
 }
 
 static void exec_wait_callback(void) {
-    // Pet the watchdog while we're waiting for the command to finish executing
+    // Pet the watchdog while we're waiting for the command to finish executing (or being spooled)
     obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_IMM);
 }
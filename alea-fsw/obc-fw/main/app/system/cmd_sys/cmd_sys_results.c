@@ -0,0 +1,563 @@
+/**
+ * @file cmd_sys_results.c
+ * @brief Store of the responses to scheduled commands
+ *
+ * Each response is written to its own record file as the command executes, so responses of any
+ * size (up to CMD_SYS_RESULTS_MAX_RECORD_SIZE) are kept complete. Results are numbered by a sequence
+ * number that keeps increasing across resets.
+ *
+ * An index file holds one fixed-size entry per result in a ring of CMD_SYS_RESULTS_MAX_RECORDS slots,
+ * the result with sequence number seq being in slot (seq % CMD_SYS_RESULTS_MAX_RECORDS). A result is
+ * therefore found from its sequence number with a single read, and a search by time reads the whole
+ * index once. When a slot is reused, the record file of the result it held is removed.
+ *
+ * Entries are encoded as:
+ *
+ *     [seq: u32][item_id: u32][epoch: u32][size: u32][cmd_id: u8][err: u8][flags: u8][reserved: u8][crc32: u32]
+ *
+ * The entry of a result is written when the command starts (without CMD_SYS_RESULTS_FLAG_FINISHED) and
+ * again with the size of the response once it finishes, so a reset during a command leaves the start of
+ * its response accessible.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "cmd_sys_results.h"
+
+// Filesystem
+#include "obc_filesystem.h"
+#include "fs_stream.h"
+
+// Utils
+#include "io_stream.h"
+#include "rtos_stream.h"
+#include "data_fmt.h"
+#include "obc_crc.h"
+#include "obc_utils.h"
+#include "printf.h"
+
+// FreeRTOS
+#include "rtos.h"
+
+// Third-Party
+#include "lfs.h"
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define RESULTS_FS_TIMEOUT_MS      1000U
+
+#define INDEX_FILENAME             "sched.rdx"
+#define RECORD_FILENAME_PREFIX     "res_"
+#define RECORD_NAME_SIZE           (sizeof(RECORD_FILENAME_PREFIX) + 8U) // Prefix + 8 hex digits + terminator
+
+#define ENTRY_SIZE                 24U
+#define ENTRY_CRC_OFFSET           20U
+
+// Number of index entries read at once
+#define INDEX_BATCH_ENTRIES        16U
+
+#define SEQ_SLOT(seq)              ((uint16_t)((seq) % CMD_SYS_RESULTS_MAX_RECORDS))
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static cmd_sys_results_err_t load(void);
+static cmd_sys_results_err_t read_slot(uint16_t slot, cmd_sys_results_entry_t *entry, bool *valid);
+static cmd_sys_results_err_t write_slot(const cmd_sys_results_entry_t *entry);
+static cmd_sys_results_err_t get_entry(uint32_t seq, cmd_sys_results_entry_t *entry);
+
+static void record_filename(uint32_t seq, char *filename);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static SemaphoreHandle_t results_mutex = NULL;
+
+/* Everything below is only used with results_mutex held */
+
+static bool loaded = false;
+static uint32_t next_seq = 1;
+
+// Result being recorded
+static bool recording = false;
+static cmd_sys_results_entry_t current = { 0 };
+static char current_filename[RECORD_NAME_SIZE] = { 0 };
+
+static fs_ostream_t record_fs_ostream = {
+    .filename = current_filename,
+    .size     = 0,
+};
+
+static io_ostream_t record_output = {
+    .handle = &record_fs_ostream,
+    .write  = &fs_stream_write,
+    .flush  = NULL,
+};
+
+// Cache of the index entries of slots [batch_start, batch_start + INDEX_BATCH_ENTRIES)
+static uint8_t index_batch[INDEX_BATCH_ENTRIES * ENTRY_SIZE] = { 0 };
+static uint16_t batch_start = 0;
+static uint32_t batch_bytes = 0;
+static bool batch_valid = false;
+
+CASSERT((CMD_SYS_RESULTS_MAX_RECORDS % INDEX_BATCH_ENTRIES) == 0, cmd_sys_results_c);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Create FreeRTOS infrastructure needed by this module
+ */
+void cmd_sys_results_pre_init(void) {
+    static StaticSemaphore_t results_mutex_buf = { 0 };
+    results_mutex = xSemaphoreCreateMutexStatic(&results_mutex_buf);
+}
+
+/**
+ * @brief Start storing the response to a command
+ *
+ * The response is then written with cmd_sys_results_write, and the result is completed with
+ * cmd_sys_results_finish. The oldest result is removed if the store is full.
+ *
+ * @param[in]  item_id       ID of the scheduled item the command is run from
+ * @param[in]  cmd_id        ID of the command
+ * @param[in]  epoch         Time the command is run
+ * @param[out] seq           Sequence number of the result, to write the response with
+ * @param[in]  timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - CMD_SYS_RESULTS_SUCCESS if the result is started
+ *            - CMD_SYS_RESULTS_ERR_INVALID_ARGS if seq is NULL
+ *            - CMD_SYS_RESULTS_ERR_FS if the index could not be read or written
+ *            - CMD_SYS_RESULTS_MUTEX_TIMEOUT if a timeout occurs waiting for the results mutex
+ */
+cmd_sys_results_err_t cmd_sys_results_begin(uint32_t item_id, uint8_t cmd_id, uint32_t epoch, uint32_t *seq, uint32_t timeout_ticks) {
+    if (seq == NULL) {
+        return CMD_SYS_RESULTS_ERR_INVALID_ARGS;
+    }
+
+    if (xSemaphoreTake(results_mutex, timeout_ticks) == pdFALSE) {
+        return CMD_SYS_RESULTS_MUTEX_TIMEOUT;
+    }
+
+    // A result that was never finished keeps the entry written when it was started
+    recording = false;
+
+    cmd_sys_results_err_t err = load();
+    cmd_sys_results_entry_t old;
+    bool old_valid = false;
+
+    if (err == CMD_SYS_RESULTS_SUCCESS) {
+        err = read_slot(SEQ_SLOT(next_seq), &old, &old_valid);
+    }
+
+    if (err == CMD_SYS_RESULTS_SUCCESS) {
+        if (old_valid) {
+            char filename[RECORD_NAME_SIZE];
+            record_filename(old.seq, filename);
+
+            // The record may not exist if the response was empty
+            fs_remove(filename, RESULTS_FS_TIMEOUT_MS);
+        }
+
+        current.seq     = next_seq;
+        current.item_id = item_id;
+        current.epoch   = epoch;
+        current.size    = 0;
+        current.cmd_id  = cmd_id;
+        current.err     = 0;
+        current.flags   = 0;
+
+        err = write_slot(&current);
+    }
+
+    if (err == CMD_SYS_RESULTS_SUCCESS) {
+        record_filename(current.seq, current_filename);
+        record_fs_ostream.size = 0;
+
+        *seq = current.seq;
+        next_seq++;
+        recording = true;
+    }
+
+    xSemaphoreGive(results_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Append to the response being stored
+ *
+ * Data is dropped unless the result with sequence number seq is being recorded, so a late write from a
+ * command that was given up on never ends up in the result of the next one. Once part of the response
+ * can't be stored, the rest of it is dropped too and the result is flagged as truncated.
+ *
+ * @param[in]  seq          Sequence number of the result, from cmd_sys_results_begin
+ * @param[in]  data         Pointer to data to write
+ * @param[in]  num_bytes    Number of bytes to write
+ * @param[in]  timeout      Timeout for mutex (ticks)
+ * @param[out] timeout_left Remaining timeout after the write, can be NULL
+ *
+ * @return Number of bytes written
+ */
+uint32_t cmd_sys_results_write(uint32_t seq, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
+    uint32_t start = xTaskGetTickCount();
+    uint32_t bytes_written = 0;
+
+    if (xSemaphoreTake(results_mutex, timeout) == pdTRUE) {
+        if (recording && (current.seq == seq) && ((current.flags & CMD_SYS_RESULTS_FLAG_TRUNCATED) == 0)) {
+            uint32_t len = MIN(num_bytes, (CMD_SYS_RESULTS_MAX_RECORD_SIZE - record_fs_ostream.size));
+
+            if (len > 0) {
+                bytes_written = io_stream_write(&record_output, data, len, pdMS_TO_TICKS(RESULTS_FS_TIMEOUT_MS), NULL);
+            }
+
+            if (bytes_written != num_bytes) {
+                current.flags |= CMD_SYS_RESULTS_FLAG_TRUNCATED;
+            }
+        }
+
+        xSemaphoreGive(results_mutex);
+    }
+
+    rtos_stream_handle_timeout(start, timeout, timeout_left);
+
+    return bytes_written;
+}
+
+/**
+ * @brief Complete the result being stored
+ *
+ * @param[in] err           cmd_sys_err_t returned by the execution of the command
+ * @param[in] timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - CMD_SYS_RESULTS_SUCCESS if the result is completed
+ *            - CMD_SYS_RESULTS_ERR_NOT_RECORDING if no result is being stored
+ *            - CMD_SYS_RESULTS_ERR_FS if the index could not be written
+ *            - CMD_SYS_RESULTS_MUTEX_TIMEOUT if a timeout occurs waiting for the results mutex
+ */
+cmd_sys_results_err_t cmd_sys_results_finish(uint8_t err, uint32_t timeout_ticks) {
+    if (xSemaphoreTake(results_mutex, timeout_ticks) == pdFALSE) {
+        return CMD_SYS_RESULTS_MUTEX_TIMEOUT;
+    }
+
+    cmd_sys_results_err_t results_err = CMD_SYS_RESULTS_ERR_NOT_RECORDING;
+
+    if (recording) {
+        current.size   = record_fs_ostream.size;
+        current.err    = err;
+        current.flags |= CMD_SYS_RESULTS_FLAG_FINISHED;
+
+        results_err = write_slot(&current);
+        recording   = false;
+    }
+
+    xSemaphoreGive(results_mutex);
+
+    return results_err;
+}
+
+/**
+ * @brief Search the stored results by time
+ *
+ * Results are returned in sequence order, starting from min_seq. If count is max_entries, the search
+ * is continued by calling again with min_seq set to next_seq.
+ *
+ * @param[in]  start_epoch   Only results of commands run at or after this time are returned
+ * @param[in]  end_epoch     Only results of commands run at or before this time are returned
+ * @param[in]  min_seq       Sequence number to start searching from
+ * @param[out] entries       Array of max_entries entries
+ * @param[in]  max_entries   Maximum number of results to return
+ * @param[out] count         Number of results returned
+ * @param[out] next_seq      Sequence number to continue the search from
+ *                           (the sequence number of the next result to be stored once the search is complete)
+ * @param[in]  timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - CMD_SYS_RESULTS_SUCCESS if the search succeeds
+ *            - CMD_SYS_RESULTS_ERR_INVALID_ARGS if a pointer is NULL
+ *            - CMD_SYS_RESULTS_ERR_FS if the index could not be read
+ *            - CMD_SYS_RESULTS_MUTEX_TIMEOUT if a timeout occurs waiting for the results mutex
+ */
+cmd_sys_results_err_t cmd_sys_results_find(uint32_t start_epoch, uint32_t end_epoch, uint32_t min_seq, cmd_sys_results_entry_t *entries,
+        uint8_t max_entries, uint8_t *count, uint32_t *next_seq_out, uint32_t timeout_ticks) {
+    if ((entries == NULL) || (count == NULL) || (next_seq_out == NULL)) {
+        return CMD_SYS_RESULTS_ERR_INVALID_ARGS;
+    }
+
+    if (xSemaphoreTake(results_mutex, timeout_ticks) == pdFALSE) {
+        return CMD_SYS_RESULTS_MUTEX_TIMEOUT;
+    }
+
+    *count = 0;
+
+    cmd_sys_results_err_t err = load();
+
+    // Sequence numbers are consecutive, so the slots are visited in order and each batch is read once
+    uint32_t oldest = (next_seq > CMD_SYS_RESULTS_MAX_RECORDS) ? (next_seq - CMD_SYS_RESULTS_MAX_RECORDS) : 1U;
+    uint32_t seq = MAX(min_seq, oldest);
+
+    while ((err == CMD_SYS_RESULTS_SUCCESS) && (seq < next_seq) && (*count < max_entries)) {
+        cmd_sys_results_entry_t *entry = &entries[*count];
+
+        err = get_entry(seq, entry);
+
+        if (err == CMD_SYS_RESULTS_SUCCESS) {
+            if ((entry->epoch >= start_epoch) && (entry->epoch <= end_epoch)) {
+                (*count)++;
+            }
+        } else if (err == CMD_SYS_RESULTS_ERR_SEQ_DNE) {
+            // The result could not be started
+            err = CMD_SYS_RESULTS_SUCCESS;
+        }
+
+        seq++;
+    }
+
+    *next_seq_out = seq;
+
+    xSemaphoreGive(results_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Get the description of a stored result
+ *
+ * @param[in]  seq           Sequence number of the result
+ * @param[out] entry         Description of the result
+ * @param[in]  timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - CMD_SYS_RESULTS_SUCCESS if entry is set
+ *            - CMD_SYS_RESULTS_ERR_INVALID_ARGS if entry is NULL
+ *            - CMD_SYS_RESULTS_ERR_SEQ_DNE if there is no result with this sequence number
+ *            - CMD_SYS_RESULTS_ERR_FS if the index could not be read
+ *            - CMD_SYS_RESULTS_MUTEX_TIMEOUT if a timeout occurs waiting for the results mutex
+ */
+cmd_sys_results_err_t cmd_sys_results_get(uint32_t seq, cmd_sys_results_entry_t *entry, uint32_t timeout_ticks) {
+    if (entry == NULL) {
+        return CMD_SYS_RESULTS_ERR_INVALID_ARGS;
+    }
+
+    if (xSemaphoreTake(results_mutex, timeout_ticks) == pdFALSE) {
+        return CMD_SYS_RESULTS_MUTEX_TIMEOUT;
+    }
+
+    cmd_sys_results_err_t err = load();
+
+    if (err == CMD_SYS_RESULTS_SUCCESS) {
+        err = get_entry(seq, entry);
+    }
+
+    xSemaphoreGive(results_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Read part of a stored response
+ *
+ * @param[in]  seq           Sequence number of the result
+ * @param[in]  offset        Position in the response to start reading from
+ * @param[out] buf           Buffer of at least len bytes
+ * @param[in]  len           Number of bytes to read
+ * @param[out] bytes_read    Number of bytes read (less than len at the end of the response)
+ * @param[in]  timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - CMD_SYS_RESULTS_SUCCESS if the data is read
+ *            - CMD_SYS_RESULTS_ERR_INVALID_ARGS if a pointer is NULL
+ *            - CMD_SYS_RESULTS_ERR_SEQ_DNE if there is no result with this sequence number
+ *            - CMD_SYS_RESULTS_ERR_FS if the index or the record could not be read
+ *            - CMD_SYS_RESULTS_MUTEX_TIMEOUT if a timeout occurs waiting for the results mutex
+ */
+cmd_sys_results_err_t cmd_sys_results_read(uint32_t seq, uint32_t offset, uint8_t *buf, uint32_t len, uint32_t *bytes_read, uint32_t timeout_ticks) {
+    if ((buf == NULL) || (bytes_read == NULL)) {
+        return CMD_SYS_RESULTS_ERR_INVALID_ARGS;
+    }
+
+    if (xSemaphoreTake(results_mutex, timeout_ticks) == pdFALSE) {
+        return CMD_SYS_RESULTS_MUTEX_TIMEOUT;
+    }
+
+    *bytes_read = 0;
+
+    cmd_sys_results_entry_t entry;
+    cmd_sys_results_err_t err = load();
+
+    if (err == CMD_SYS_RESULTS_SUCCESS) {
+        err = get_entry(seq, &entry);
+    }
+
+    if ((err == CMD_SYS_RESULTS_SUCCESS) && (offset < entry.size)) {
+        char filename[RECORD_NAME_SIZE];
+        record_filename(seq, filename);
+
+        if (fs_read_at(filename, offset, buf, MIN(len, (entry.size - offset)), bytes_read, RESULTS_FS_TIMEOUT_MS) != FS_OK) {
+            err = CMD_SYS_RESULTS_ERR_FS;
+        }
+    }
+
+    xSemaphoreGive(results_mutex);
+
+    return err;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Find the next sequence number from the index, the first time the store is used
+ */
+static cmd_sys_results_err_t load(void) {
+    if (loaded) {
+        return CMD_SYS_RESULTS_SUCCESS;
+    }
+
+    uint32_t max_seq = 0;
+
+    for (uint16_t slot = 0; slot < CMD_SYS_RESULTS_MAX_RECORDS; slot++) {
+        cmd_sys_results_entry_t entry;
+        bool valid = false;
+
+        cmd_sys_results_err_t err = read_slot(slot, &entry, &valid);
+
+        if (err != CMD_SYS_RESULTS_SUCCESS) {
+            return err;
+        }
+
+        if (valid) {
+            max_seq = MAX(max_seq, entry.seq);
+        }
+    }
+
+    next_seq = max_seq + 1U;
+    loaded = true;
+
+    return CMD_SYS_RESULTS_SUCCESS;
+}
+
+/**
+ * @brief Read and decode the index entry in a slot
+ *
+ * @param[in]  slot  Slot of the entry
+ * @param[out] entry Decoded entry
+ * @param[out] valid Set to false if the slot has never been written or fails its CRC check
+ */
+static cmd_sys_results_err_t read_slot(uint16_t slot, cmd_sys_results_entry_t *entry, bool *valid) {
+    if (!batch_valid || (slot < batch_start) || (slot >= (batch_start + INDEX_BATCH_ENTRIES))) {
+        batch_start = slot - (slot % INDEX_BATCH_ENTRIES);
+        batch_bytes = 0;
+
+        fs_err_t fs_err = fs_read_at(INDEX_FILENAME, ((uint32_t)batch_start * ENTRY_SIZE), index_batch, sizeof(index_batch), &batch_bytes,
+                                     RESULTS_FS_TIMEOUT_MS);
+
+        // The index doesn't exist until the first result is stored
+        if ((fs_err != FS_OK) && (fs_err != FS_NOENT_ERR)) {
+            return CMD_SYS_RESULTS_ERR_FS;
+        }
+
+        batch_valid = true;
+    }
+
+    uint32_t offset = (uint32_t)(slot - batch_start) * ENTRY_SIZE;
+    const uint8_t *buf = &index_batch[offset];
+
+    *valid = false;
+
+    if ((offset + ENTRY_SIZE) > batch_bytes) {
+        return CMD_SYS_RESULTS_SUCCESS;
+    }
+
+    if (crc_32_buf(CRC32_SEED, buf, ENTRY_CRC_OFFSET) != data_fmt_arr_be_to_u32(&buf[ENTRY_CRC_OFFSET])) {
+        return CMD_SYS_RESULTS_SUCCESS;
+    }
+
+    entry->seq     = data_fmt_arr_be_to_u32(&buf[0]);
+    entry->item_id = data_fmt_arr_be_to_u32(&buf[4]);
+    entry->epoch   = data_fmt_arr_be_to_u32(&buf[8]);
+    entry->size    = data_fmt_arr_be_to_u32(&buf[12]);
+    entry->cmd_id  = buf[16];
+    entry->err     = buf[17];
+    entry->flags   = buf[18];
+
+    *valid = (entry->seq != 0) && (SEQ_SLOT(entry->seq) == slot);
+
+    return CMD_SYS_RESULTS_SUCCESS;
+}
+
+/**
+ * @brief Encode and write an entry to its slot in the index
+ */
+static cmd_sys_results_err_t write_slot(const cmd_sys_results_entry_t *entry) {
+    uint8_t buf[ENTRY_SIZE] = { 0 };
+    lfs_file_t file;
+
+    data_fmt_u32_to_arr_be(entry->seq, &buf[0]);
+    data_fmt_u32_to_arr_be(entry->item_id, &buf[4]);
+    data_fmt_u32_to_arr_be(entry->epoch, &buf[8]);
+    data_fmt_u32_to_arr_be(entry->size, &buf[12]);
+    buf[16] = entry->cmd_id;
+    buf[17] = entry->err;
+    buf[18] = entry->flags;
+    data_fmt_u32_to_arr_be(crc_32_buf(CRC32_SEED, buf, ENTRY_CRC_OFFSET), &buf[ENTRY_CRC_OFFSET]);
+
+    // The cached batch may hold the old entry
+    batch_valid = false;
+
+    // fs_seek and fs_write close the file if they fail. Seeking past the end of a new index is
+    // fine, LFS fills the gap with zeros which are read back as invalid entries.
+    fs_err_t fs_err = fs_open(&file, INDEX_FILENAME, RESULTS_FS_TIMEOUT_MS);
+
+    if (fs_err == FS_OK) {
+        fs_err = fs_seek(&file, (int32_t)(SEQ_SLOT(entry->seq) * ENTRY_SIZE), FS_SEEK_START);
+    }
+
+    if (fs_err == FS_OK) {
+        fs_err = fs_write(&file, buf, sizeof(buf));
+    }
+
+    if (fs_err == FS_OK) {
+        fs_err = fs_close(&file);
+    }
+
+    return (fs_err == FS_OK) ? CMD_SYS_RESULTS_SUCCESS : CMD_SYS_RESULTS_ERR_FS;
+}
+
+/**
+ * @brief Get the entry of a result, with the size written so far if it is being recorded
+ */
+static cmd_sys_results_err_t get_entry(uint32_t seq, cmd_sys_results_entry_t *entry) {
+    if ((seq == 0) || (seq >= next_seq) || ((next_seq - seq) > CMD_SYS_RESULTS_MAX_RECORDS)) {
+        return CMD_SYS_RESULTS_ERR_SEQ_DNE;
+    }
+
+    if (recording && (seq == current.seq)) {
+        *entry = current;
+        entry->size = record_fs_ostream.size;
+        return CMD_SYS_RESULTS_SUCCESS;
+    }
+
+    bool valid = false;
+    cmd_sys_results_err_t err = read_slot(SEQ_SLOT(seq), entry, &valid);
+
+    if ((err == CMD_SYS_RESULTS_SUCCESS) && (!valid || (entry->seq != seq))) {
+        err = CMD_SYS_RESULTS_ERR_SEQ_DNE;
+    }
+
+    return err;
+}
+
+static void record_filename(uint32_t seq, char *filename) {
+    snprintf(filename, RECORD_NAME_SIZE, RECORD_FILENAME_PREFIX "%08lx", (unsigned long)seq);
+}
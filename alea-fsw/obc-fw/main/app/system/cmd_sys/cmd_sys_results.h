@@ -0,0 +1,78 @@
+/**
+ * @file cmd_sys_results.h
+ * @brief Store of the responses to scheduled commands
+ */
+
+#ifndef CMD_SYS_RESULTS_H_
+#define CMD_SYS_RESULTS_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/**
+ * @brief Number of results kept, the oldest result is removed when a new one is started
+ */
+#define CMD_SYS_RESULTS_MAX_RECORDS      64U
+
+/**
+ * @brief Largest response stored, the rest of a larger response is dropped (see CMD_SYS_RESULTS_FLAG_TRUNCATED)
+ */
+#define CMD_SYS_RESULTS_MAX_RECORD_SIZE  (32U * 1024U)
+
+/**
+ * @brief Flags of a result
+ */
+#define CMD_SYS_RESULTS_FLAG_FINISHED    0x01U ///< The command finished executing (otherwise the OBC reset while it was running)
+#define CMD_SYS_RESULTS_FLAG_TRUNCATED   0x02U ///< Only the start of the response is stored (too large or a write failed)
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef enum {
+    CMD_SYS_RESULTS_SUCCESS           = 0,
+    CMD_SYS_RESULTS_ERR_INVALID_ARGS  = 1,
+    CMD_SYS_RESULTS_MUTEX_TIMEOUT     = 2,
+    CMD_SYS_RESULTS_ERR_FS            = 3, ///< The index or a record could not be read or written
+    CMD_SYS_RESULTS_ERR_SEQ_DNE       = 4, ///< There is no result with this sequence number (it may have been removed)
+    CMD_SYS_RESULTS_ERR_NOT_RECORDING = 5, ///< cmd_sys_results_begin wasn't called
+} cmd_sys_results_err_t;
+
+/**
+ * @brief Description of a stored result
+ */
+typedef struct {
+    uint32_t seq;       // Sequence number, incremented for each result (starting at 1)
+    uint32_t item_id;   // ID of the scheduled item the command was run from (see rtc_scheduler_list)
+    uint32_t epoch;     // Time the command was run
+    uint32_t size;      // Size of the response in bytes
+    uint8_t cmd_id;
+    uint8_t err;        // cmd_sys_err_t returned by the execution of the command
+    uint8_t flags;      // See CMD_SYS_RESULTS_FLAG_*
+} cmd_sys_results_entry_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void cmd_sys_results_pre_init(void);
+
+cmd_sys_results_err_t cmd_sys_results_begin(uint32_t item_id, uint8_t cmd_id, uint32_t epoch, uint32_t *seq, uint32_t timeout_ticks);
+uint32_t cmd_sys_results_write(uint32_t seq, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
+cmd_sys_results_err_t cmd_sys_results_finish(uint8_t err, uint32_t timeout_ticks);
+
+cmd_sys_results_err_t cmd_sys_results_find(uint32_t start_epoch, uint32_t end_epoch, uint32_t min_seq, cmd_sys_results_entry_t *entries,
+        uint8_t max_entries, uint8_t *count, uint32_t *next_seq, uint32_t timeout_ticks);
+cmd_sys_results_err_t cmd_sys_results_get(uint32_t seq, cmd_sys_results_entry_t *entry, uint32_t timeout_ticks);
+cmd_sys_results_err_t cmd_sys_results_read(uint32_t seq, uint32_t offset, uint8_t *buf, uint32_t len, uint32_t *bytes_read, uint32_t timeout_ticks);
+
+#endif // CMD_SYS_RESULTS_H_
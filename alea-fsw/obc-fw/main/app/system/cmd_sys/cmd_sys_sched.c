@@ -11,14 +11,20 @@
 
 // Command System
 #include "cmd_sys.h"
+#include "cmd_sys_results.h"
 
 // RTC Scheduler
 #include "rtc_scheduler.h"
 
 // OBC
 #include "obc_rtos.h"
+#include "obc_rtc.h"
 #include "obc_watchdog.h"
 
+// Filesystem
+#include "obc_filesystem.h"
+#include "fs_stream.h"
+
 // Logger
 #include "logger.h"
 
@@ -26,29 +32,66 @@
 #include "buffered_io.h"
 #include "rtos_stream.h"
 #include "io_stream.h"
+#include "obc_utils.h"
+#include "printf.h"
 
 // FreeRTOS
 #include "rtos.h"
 
+// Standard Library
+#include <string.h>
+
 /******************************************************************************/
 /*                               D E F I N E S                                */
 /******************************************************************************/
 
 #define STREAM_BUF_DEF_TRIG_LVL  1U
-#define CMD_SYS_SCHED_TIMEOUT_MS 100U
+
+// The scheduler may be busy reading or compacting its journal
+#define CMD_SYS_SCHED_TIMEOUT_MS 1000U
 
 #define NOTIFICATION_INDEX 1U // index 0 is used by stream/message buffers
 // see https://www.freertos.org/RTOS-task-notifications.html
 
 #define CMD_SYS_SCHED_POLL_PERIOD_MS  1000U
-#define CMD_SYS_SCHED_EXEC_TIMEOUT_MS 60000U
+
+#define CMD_SYS_SCHED_FS_TIMEOUT_MS   1000U
+
+/**
+ * @brief The data of a large command is spooled to SPOOL_TMP_FILENAME as it is received, then renamed
+ * to SPOOL_FILENAME_PREFIX followed by the ID of the scheduled item (8 hex digits) once it is scheduled.
+ */
+#define SPOOL_TMP_FILENAME            "sched.spl"
+#define SPOOL_FILENAME_PREFIX         "sched_"
+#define SPOOL_FILENAME_PREFIX_LEN     (sizeof(SPOOL_FILENAME_PREFIX) - 1U)
+#define SPOOL_FILENAME_ID_LEN         8U
+#define SPOOL_FILENAME_SIZE           (SPOOL_FILENAME_PREFIX_LEN + SPOOL_FILENAME_ID_LEN + 1U)
+
+// Each chunk is a separate LFS append, so this is matched to the LFS cache size
+#define SPOOL_CHUNK_SIZE              512U
+#define SPOOL_LIST_BATCH_SIZE         4U
+
+#define OUTPUT_BUF_SIZE               512U
+
+#define STREAM_RELEASE_POLL_MS        100U
 
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
 /******************************************************************************/
 
-static void scheduler_callback(uint8_t *data, uint32_t data_len);
-static uint32_t write_log(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
+static void init_item(rtc_scheduler_item_t *item, const cmd_sys_msg_header_t *header, const uint8_t *data, uint32_t data_len);
+
+static void run_due_item(void);
+static void release_spool(void);
+static bool wait_streams_released(void);
+static void stream_call_begin(void);
+static void stream_call_end(void);
+static void clean_spool_files(void);
+static void spool_filename(uint32_t id, char *filename);
+static bool parse_spool_filename(const char *filename, uint32_t *id);
+
+static uint32_t read_input(void *handle, uint8_t *buf, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
+static uint32_t write_output(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
 
 static void cmd_sys_sched_task(void *pvParameters);
 static void exec_wait_callback(void);
@@ -69,21 +112,54 @@ static rtos_stream_istream_t input_rtos_stream = {
 
 static io_istream_t input_stream = {
     .handle = &input_rtos_stream,
-    .read = &rtos_stream_read_stream,
+    .read = &read_input,
 };
 
+// Spooling of large commands
+static SemaphoreHandle_t spool_mutex = NULL; // Held while an item is added or removed together with its spool file
+
+static uint8_t spool_buf[SPOOL_CHUNK_SIZE] = { 0 };
+static fs_ostream_t spool_fs_ostream = {
+    .filename = SPOOL_TMP_FILENAME,
+    .size     = 0,
+};
+
+static io_ostream_t spool_output = {
+    .handle = &spool_fs_ostream,
+    .write  = &fs_stream_write,
+    .flush  = NULL,
+};
+
+// Spool file of the command being run (end is 0 if the command wasn't spooled)
+static char running_spool_filename[SPOOL_FILENAME_SIZE] = { 0 };
+static fs_istream_t running_spool = {
+    .filename = running_spool_filename,
+    .offset   = 0,
+    .end      = 0,
+};
+
+// ID of the scheduled item of the command being run
+static uint32_t running_item_id = 0;
+
+// Sequence number of the result of the command being run (0 if it isn't stored)
+static uint32_t running_result_seq = 0;
+
+// Number of calls to read_input and write_output in progress
+static volatile uint8_t stream_calls = 0;
+
 // Output Streams
-static io_ostream_t log_output_stream = {
+static io_ostream_t results_output_stream = {
     .handle = NULL,
-    .write = &write_log,
+    .write = &write_output,
     .flush = NULL,
 };
 
-static uint8_t output_buf[MAX_PAYLOAD_SIZE] = { 0 };
+// Each flush is a separate LFS append to the result record, so this is matched to the LFS cache size
+static uint8_t output_buf[OUTPUT_BUF_SIZE] = { 0 };
 static buffered_output_t output_buffered_stream = {
     .size   = sizeof(output_buf),
     .buf    = output_buf,
-    .output = &log_output_stream,
+    .output = &results_output_stream,
 
     .offset = 0,
 };
@@ -102,6 +178,9 @@ static io_ostream_t output_stream = {
  * @brief Create FreeRTOS infrastructure needed by this module
  */
 void cmd_sys_sched_pre_init(void) {
+    static StaticSemaphore_t spool_mutex_buf = { 0 };
+    spool_mutex = xSemaphoreCreateMutexStatic(&spool_mutex_buf);
+
     cmd_sched_buffer = xStreamBufferCreateStatic(CMD_SYS_SCHED_MAX_DATA_SIZE, STREAM_BUF_DEF_TRIG_LVL, cmd_sched_buffer_storage, &cmd_sched_buffer_buf);
     input_rtos_stream.stream_buf = cmd_sched_buffer;
 }
@@ -116,6 +195,9 @@ void cmd_sys_sched_post_init(void) {
 /**
  * @brief Push a command to the scheduler to be executed later
  *
+ * The command is stored in the journal of the RTC scheduler, so it is still run if the OBC resets before
+ * its scheduled time. Commands whose time has already passed are run right away.
+ *
  * @param[in] header              Struct resulting from parsing the command header
  * @param[in] header_and_data     Pointer to a buffer containing all the command bytes (header + data)
  * @param[in] header_and_data_len Length of the buffer (header + data)
@@ -137,15 +219,10 @@ cmd_sys_err_t cmd_sys_sched_push_cmd(const cmd_sys_msg_header_t *header, uint8_t
 
     cmd_sys_err_t err = CMD_SYS_ERR_SCHED;
 
-    rtc_scheduler_item_t item = {
-        .timestamp = header->timestamp,
-        .priority = 0, // Unused feature for now
-        .cb = &scheduler_callback,
-        .data_len = header_and_data_len,
-        .data = header_and_data,
-    };
+    rtc_scheduler_item_t item;
+    init_item(&item, header, header_and_data, header_and_data_len);
 
-    rtc_scheduler_err_t rtc_sched_err = rtc_scheduler_add_item(&item, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS));
+    rtc_scheduler_err_t rtc_sched_err = rtc_scheduler_add_item(&item, NULL, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS));
 
     if (rtc_sched_err == RTC_SCHEDULER_SUCCESS) {
         err = CMD_SYS_SUCCESS;
@@ -154,42 +231,389 @@ cmd_sys_err_t cmd_sys_sched_push_cmd(const cmd_sys_msg_header_t *header, uint8_t
     return err;
 }
 
+/**
+ * @brief Push a command whose data is too large for the scheduler to be executed later
+ *
+ * The data is read from input and written to a spool file in chunks, so it is never held in RAM.
+ * Only the header is stored in the schedule. When the command runs, it reads its data back from
+ * the spool file, which is then removed.
+ *
+ * @param[in] header        Struct resulting from parsing the command header
+ * @param[in] header_bytes  Pointer to a buffer containing the command header bytes
+ * @param[in] header_len    Length of the header bytes
+ * @param[in] input         Stream to read the header->data_len data bytes of the command from
+ * @param[in] wait_callback Optional callback function that will be called after each chunk is spooled
+ *
+ * @return Status code:
+ *            - CMD_SYS_SUCCESS if the command is successfully scheduled
+ *            - CMD_SYS_ERR_INVALID_ARGS if header, header_bytes or input are NULL
+ *            - CMD_SYS_ERR_ARGS_TOO_LARGE if the data is larger than CMD_SYS_SCHED_MAX_SPOOLED_DATA_SIZE
+ *            - CMD_SYS_ERR_READ_TIMEOUT if the data could not be read from input
+ *            - CMD_SYS_ERR_SCHED if the data cannot be spooled or the command cannot be scheduled
+ */
+cmd_sys_err_t cmd_sys_sched_push_spooled_cmd(const cmd_sys_msg_header_t *header, uint8_t *header_bytes, uint32_t header_len, const io_istream_t *input,
+        cmd_sys_exec_wait_cb_t wait_callback) {
+    if ((header == NULL) || (header_bytes == NULL) || (input == NULL)) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    }
+
+    if (header->data_len > CMD_SYS_SCHED_MAX_SPOOLED_DATA_SIZE) {
+        return CMD_SYS_ERR_ARGS_TOO_LARGE;
+    }
+
+    // The temporary file may be left over from a command that couldn't be scheduled
+    fs_err_t fs_err = fs_remove(SPOOL_TMP_FILENAME, CMD_SYS_SCHED_FS_TIMEOUT_MS);
+
+    if (fs_err == FS_NOENT_ERR) {
+        fs_err = FS_OK;
+    }
+
+    spool_fs_ostream.size = 0;
+
+    uint32_t data_left = header->data_len;
+
+    while (data_left > 0) {
+        uint32_t len = MIN(data_left, SPOOL_CHUNK_SIZE);
+        uint32_t bytes_read = io_stream_read(input, spool_buf, len, pdMS_TO_TICKS(CMD_SYS_INPUT_READ_TIMEOUT_MS), NULL);
+
+        if (bytes_read != len) {
+            return CMD_SYS_ERR_READ_TIMEOUT;
+        }
+
+        // Keep reading the data after a failure so the whole command is consumed
+        if ((fs_err == FS_OK) && (io_stream_write(&spool_output, spool_buf, len, pdMS_TO_TICKS(CMD_SYS_SCHED_FS_TIMEOUT_MS), NULL) != len)) {
+            fs_err = FS_WRITE_FAILURE_ERR;
+        }
+
+        data_left -= len;
+
+        if (wait_callback != NULL) {
+            wait_callback();
+        }
+    }
+
+    if (fs_err != FS_OK) {
+        LOG_RTC_SCHEDULER__SPOOL_FAILED((int8_t)fs_err);
+        return CMD_SYS_ERR_SCHED;
+    }
+
+    rtc_scheduler_item_t item;
+    init_item(&item, header, header_bytes, header_len);
+
+    // The item must not be run before its spool file is renamed
+    if (xSemaphoreTake(spool_mutex, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS)) == pdFALSE) {
+        return CMD_SYS_ERR_SCHED;
+    }
+
+    cmd_sys_err_t err = CMD_SYS_ERR_SCHED;
+    uint32_t id = 0;
+
+    if (rtc_scheduler_add_item(&item, &id, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS)) == RTC_SCHEDULER_SUCCESS) {
+        char filename[SPOOL_FILENAME_SIZE];
+        spool_filename(id, filename);
+
+        fs_err = fs_rename(SPOOL_TMP_FILENAME, filename, CMD_SYS_SCHED_FS_TIMEOUT_MS);
+
+        if (fs_err == FS_OK) {
+            err = CMD_SYS_SUCCESS;
+        } else {
+            LOG_RTC_SCHEDULER__SPOOL_FAILED((int8_t)fs_err);
+            rtc_scheduler_cancel(id, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS));
+        }
+    }
+
+    xSemaphoreGive(spool_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Remove a command from the schedule before it runs, along with its spool file if it has one
+ *
+ * @param[in] id ID of the scheduled item (see rtc_scheduler_list)
+ *
+ * @return Status code:
+ *            - CMD_SYS_SUCCESS if the command is removed
+ *            - CMD_SYS_ERR_SCHED if no command with this ID is waiting or it cannot be removed
+ */
+cmd_sys_err_t cmd_sys_sched_cancel(uint32_t id) {
+    if (xSemaphoreTake(spool_mutex, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS)) == pdFALSE) {
+        return CMD_SYS_ERR_SCHED;
+    }
+
+    rtc_scheduler_err_t rtc_sched_err = rtc_scheduler_cancel(id, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS));
+
+    if (rtc_sched_err == RTC_SCHEDULER_SUCCESS) {
+        char filename[SPOOL_FILENAME_SIZE];
+        spool_filename(id, filename);
+
+        // Most commands aren't spooled, a file left behind is removed by clean_spool_files after a reset
+        fs_remove(filename, CMD_SYS_SCHED_FS_TIMEOUT_MS);
+    }
+
+    xSemaphoreGive(spool_mutex);
+
+    return (rtc_sched_err == RTC_SCHEDULER_SUCCESS) ? CMD_SYS_SUCCESS : CMD_SYS_ERR_SCHED;
+}
+
 /******************************************************************************/
 /*                      P R I V A T E  F U N C T I O N S                      */
 /******************************************************************************/
 
+static void init_item(rtc_scheduler_item_t *item, const cmd_sys_msg_header_t *header, const uint8_t *data, uint32_t data_len) {
+    // High priority commands run first when several are scheduled at the same time
+    const cmd_sys_cmd_spec_t *spec = cmd_sys_get_spec(header->cmd_id);
+
+    item->timestamp = header->timestamp;
+    item->priority  = ((spec != NULL) && (spec->priority == CMD_SYS_PRIORITY_HIGH)) ? 1U : 0U;
+    item->tag       = header->cmd_id;
+    item->data_len  = data_len;
+    item->data      = data;
+}
+
+/**
+ * @brief Pass the next scheduled command that is due (if any) to cmd_sys_sched_task
+ */
+static void run_due_item(void) {
+    static uint8_t data[RTC_SCHEDULER_MAX_DATA_SIZE] = { 0 };
+
+    static fs_entry_info_t spool_info = { 0 };
+
+    // Items are popped with spool_mutex held so a spooled command is never popped before its spool file is renamed
+    if (xSemaphoreTake(spool_mutex, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS)) == pdFALSE) {
+        return;
+    }
+
+    rtc_scheduler_entry_t entry;
+    rtc_scheduler_err_t err = rtc_scheduler_pop_due(rtc_get_epoch_time(), &entry, data, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS));
+
+    xSemaphoreGive(spool_mutex);
+
+    if (err == RTC_SCHEDULER_SUCCESS) {
+        LOG_RTC_SCHEDULER__ITEM_DUE(entry.id, entry.tag);
+
+        running_item_id = entry.id;
+
+        // If the data of the command was spooled, read_input streams it from the spool file after the header
+        spool_filename(entry.id, running_spool_filename);
+        fs_err_t fs_err = fs_stat(running_spool_filename, &spool_info, CMD_SYS_SCHED_FS_TIMEOUT_MS);
+
+        running_spool.offset = 0;
+        running_spool.end    = (fs_err == FS_OK) ? spool_info.size : 0U;
+
+        if ((fs_err != FS_OK) && (fs_err != FS_NOENT_ERR)) {
+            LOG_RTC_SCHEDULER__SPOOL_FAILED((int8_t)fs_err);
+        }
+
+        // Drop anything left over by the previous command, then write the command to the stream buffer
+        // to wake up cmd_sys_recv_header
+        xStreamBufferReset(cmd_sched_buffer);
+        xStreamBufferSend(cmd_sched_buffer, data, entry.data_len, 0);
+    } else if (err != RTC_SCHEDULER_NONE_DUE) {
+        LOG_RTC_SCHEDULER__POP_FAILED(err);
+    }
+}
+
 /**
- * @brief Callback that will be invoked by the RTC scheduler when a command's
- * scheduled time has arrived.
+ * @brief Remove the spool file of the command that was run (if it was spooled)
+ */
+static void release_spool(void) {
+    if (running_spool.end > 0) {
+        // A file that can't be removed is removed by clean_spool_files after a reset
+        fs_remove(running_spool_filename, CMD_SYS_SCHED_FS_TIMEOUT_MS);
+
+        running_spool.offset = 0;
+        running_spool.end    = 0;
+    }
+}
+
+/**
+ * @brief Wait for the calls to read_input and write_output to return
+ *
+ * A command that timed out keeps running until it stops (see cmd_sys_exec_cancel), and may still be in
+ * the middle of reading its spool file or writing its result.
  *
- * @param[in] data     Raw command header + data
- * @param[in] data_len Number of bytes in data
+ * @return true if no call is in progress, false if they're still in progress after CMD_SYS_EXEC_TIMEOUT_MS
  */
-static void scheduler_callback(uint8_t *data, uint32_t data_len) {
-    if ((data != NULL) && (data_len > 0)) {
-        // Write the command to the stream buffer to wake up cmd_sys_sched_task
-        xStreamBufferSend(cmd_sched_buffer, data, data_len, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS)); // TODO ALEA-857 handle timeout
+static bool wait_streams_released(void) {
+    uint32_t waited_ms = 0;
+
+    while (stream_calls > 0) {
+        if (waited_ms >= CMD_SYS_EXEC_TIMEOUT_MS) {
+            return false;
+        }
+
+        obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_SCHED);
+        vTaskDelay(pdMS_TO_TICKS(STREAM_RELEASE_POLL_MS));
+        waited_ms += STREAM_RELEASE_POLL_MS;
     }
+
+    return true;
+}
+
+static void stream_call_begin(void) {
+    taskENTER_CRITICAL();
+    stream_calls++;
+    taskEXIT_CRITICAL();
+}
+
+static void stream_call_end(void) {
+    taskENTER_CRITICAL();
+    stream_calls--;
+    taskEXIT_CRITICAL();
 }
 
 /**
- * @brief io_ostream_t compatible API to write data to the logs.
+ * @brief Remove the spool files whose command is no longer waiting in the schedule
  *
- * The handle is ignored.
+ * These are left behind if the OBC resets while a spooled command is running or being cancelled.
+ */
+static void clean_spool_files(void) {
+    static fs_entry_info_t entries[SPOOL_LIST_BATCH_SIZE] = { 0 };
+
+    uint16_t start = 0;
+    uint16_t count = 0;
+    uint16_t total = 0;
+    uint16_t removed = 0;
+
+    do {
+        if (fs_list("/", start, entries, SPOOL_LIST_BATCH_SIZE, &count, &total, CMD_SYS_SCHED_FS_TIMEOUT_MS) != FS_OK) {
+            break;
+        }
+
+        uint16_t batch_removed = 0;
+
+        for (uint16_t i = 0; i < count; i++) {
+            uint32_t id = 0;
+            bool waiting = true;
+
+            if ((entries[i].type != FS_TYPE_FILE) || !parse_spool_filename(entries[i].name, &id)) {
+                continue;
+            }
+
+            if (xSemaphoreTake(spool_mutex, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS)) == pdFALSE) {
+                continue;
+            }
+
+            if ((rtc_scheduler_is_waiting(id, &waiting, pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS)) == RTC_SCHEDULER_SUCCESS) && !waiting &&
+                    (fs_remove(entries[i].name, CMD_SYS_SCHED_FS_TIMEOUT_MS) == FS_OK)) {
+                batch_removed++;
+            }
+
+            xSemaphoreGive(spool_mutex);
+        }
+
+        // The entries after the removed ones have moved down
+        start   += count - batch_removed;
+        total   -= batch_removed;
+        removed += batch_removed;
+    } while ((count > 0) && (start < total));
+
+    if (removed > 0) {
+        LOG_RTC_SCHEDULER__SPOOL_CLEANED(removed);
+    }
+}
+
+static void spool_filename(uint32_t id, char *filename) {
+    snprintf(filename, SPOOL_FILENAME_SIZE, SPOOL_FILENAME_PREFIX "%08lx", (unsigned long)id);
+}
+
+/**
+ * @brief Get the ID of the scheduled item from the name of its spool file
+ *
+ * @return true if filename is the name of a spool file, otherwise false
+ */
+static bool parse_spool_filename(const char *filename, uint32_t *id) {
+    if (strncmp(filename, SPOOL_FILENAME_PREFIX, SPOOL_FILENAME_PREFIX_LEN) != 0) {
+        return false;
+    }
+
+    const char *digits = &filename[SPOOL_FILENAME_PREFIX_LEN];
+    uint32_t value = 0;
+
+    for (uint8_t i = 0; i < SPOOL_FILENAME_ID_LEN; i++) {
+        char c = digits[i];
+
+        if ((c >= '0') && (c <= '9')) {
+            value = (value << 4) | (uint32_t)(c - '0');
+        } else if ((c >= 'a') && (c <= 'f')) {
+            value = (value << 4) | (uint32_t)(c - 'a' + 10);
+        } else {
+            return false;
+        }
+    }
+
+    if (digits[SPOOL_FILENAME_ID_LEN] != '\0') {
+        return false;
+    }
+
+    *id = value;
+    return true;
+}
+
+/**
+ * @brief io_istream_t compatible API to read the command being run.
+ *
+ * The handle must be of type rtos_stream_istream_t. The command header (and its data if it wasn't spooled)
+ * is read from the stream buffer, followed by the data in the spool file if there is one.
+ *
+ * See io_istream_t in io_stream.h for details.
+ */
+static uint32_t read_input(void *handle, uint8_t *buf, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
+    stream_call_begin();
+
+    uint32_t bytes_read = 0;
+
+    if (running_spool.offset >= running_spool.end) {
+        bytes_read = rtos_stream_read_stream(handle, buf, num_bytes, timeout, &timeout);
+    } else {
+        uint32_t buffered = xStreamBufferBytesAvailable(cmd_sched_buffer);
+
+        if (buffered > 0) {
+            bytes_read = rtos_stream_read_stream(handle, buf, MIN(num_bytes, buffered), timeout, &timeout);
+        }
+
+        if (bytes_read < num_bytes) {
+            bytes_read += fs_stream_read(&running_spool, &buf[bytes_read], (num_bytes - bytes_read), timeout, &timeout);
+        }
+    }
+
+    if (timeout_left != NULL) {
+        *timeout_left = timeout;
+    }
+
+    stream_call_end();
+
+    return bytes_read;
+}
+
+/**
+ * @brief io_ostream_t compatible API to write the response to the command being run.
+ *
+ * The handle is ignored. The response is stored in the result store, and is also sent in the logs
+ * so it can be received live while in contact. A failure to store the response doesn't stop the
+ * command (the result is flagged as truncated instead).
  *
  * See io_ostream_t in io_stream.h for details.
  */
-static uint32_t write_log(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
-    // This is a temporary way to send scheduled command responses.
-    // In reality the responses should be stored to the filesystem.
-    // See ALEA-858
-    // TODO ALEA-572 Write this to filesystem
-    LOG_CMD_SYS_SCHED_RESP(num_bytes, data);
+static uint32_t write_output(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
+    stream_call_begin();
+
+    // The write goes to the result of the command that was running when it started, even if it's given up on meanwhile
+    uint32_t seq = running_result_seq;
+
+    cmd_sys_results_write(seq, data, num_bytes, timeout, &timeout);
+
+    for (uint32_t offset = 0; offset < num_bytes; offset += MAX_PAYLOAD_SIZE) {
+        LOG_CMD_SYS_SCHED_RESP(MIN((num_bytes - offset), MAX_PAYLOAD_SIZE), &data[offset]);
+    }
 
     if (timeout_left != NULL) {
         *timeout_left = timeout;
     }
 
+    stream_call_end();
+
     return num_bytes;
 }
 
@@ -205,15 +629,75 @@ static void cmd_sys_sched_task(void *pvParameters) {
     cmd.input = &input_stream;
     cmd.output = &output_stream;
 
+    // The schedule is loaded here rather than in cmd_sys_sched_post_init because replaying a long journal takes a while
+    rtc_scheduler_err_t sched_err = rtc_scheduler_load(pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS));
+
+    if (sched_err == RTC_SCHEDULER_SUCCESS) {
+        clean_spool_files();
+    } else {
+        LOG_RTC_SCHEDULER__LOAD_FAILED(sched_err);
+    }
+
+    bool released = true;
+
     while (1) {
         obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_SCHED);
 
+        // A command that timed out may still be reading the stream buffer and the spool file of its item, so
+        // the next item isn't run (which would reset them) until the command is out of its streams
+        if (!released) {
+            released = wait_streams_released();
+
+            if (released) {
+                release_spool();
+            }
+
+            continue;
+        }
+
+        if (sched_err != RTC_SCHEDULER_SUCCESS) {
+            sched_err = rtc_scheduler_load(pdMS_TO_TICKS(CMD_SYS_SCHED_TIMEOUT_MS));
+
+            if (sched_err == RTC_SCHEDULER_SUCCESS) {
+                clean_spool_files();
+            }
+        } else {
+            run_due_item();
+        }
+
+        // Scheduled times have a resolution of 1 s, so polling the schedule once per poll period is enough
         cmd_sys_err_t err = cmd_sys_recv_header(&cmd, buf, pdMS_TO_TICKS(CMD_SYS_SCHED_POLL_PERIOD_MS));
 
         if (err == CMD_SYS_SUCCESS) {
-            err = cmd_sys_execute(&cmd, pdMS_TO_TICKS(CMD_SYS_SCHED_POLL_PERIOD_MS), pdMS_TO_TICKS(CMD_SYS_SCHED_EXEC_TIMEOUT_MS), &exec_wait_callback);
+            // Drop anything left in the output buffer by a command that timed out
+            output_buffered_stream.offset = 0;
+
+            cmd_sys_results_err_t results_err = cmd_sys_results_begin(running_item_id, cmd.header.cmd_id, rtc_get_epoch_time(),
+                                                                      &running_result_seq, pdMS_TO_TICKS(CMD_SYS_SCHED_FS_TIMEOUT_MS));
+
+            if (results_err != CMD_SYS_RESULTS_SUCCESS) {
+                running_result_seq = 0;
+                LOG_RTC_SCHEDULER__RESULT_STORE_FAILED(results_err);
+            }
+
+            err = cmd_sys_execute(&cmd, pdMS_TO_TICKS(CMD_SYS_SCHED_POLL_PERIOD_MS), &exec_wait_callback);
+
+            // The result and the spool file are still in use until a command that timed out is out of its streams
+            released = wait_streams_released();
+
+            // The error is kept in the result of the command (see SCHED_RESULTS)
+            results_err = cmd_sys_results_finish((uint8_t)err, pdMS_TO_TICKS(CMD_SYS_SCHED_FS_TIMEOUT_MS));
+            running_result_seq = 0;
+
+            if ((results_err != CMD_SYS_RESULTS_SUCCESS) && (results_err != CMD_SYS_RESULTS_ERR_NOT_RECORDING)) {
+                LOG_RTC_SCHEDULER__RESULT_STORE_FAILED(results_err);
+            }
+        }
 
-            // TODO: ALEA-857 do something with err
+        // A spool file still being read is removed once the command is out of its streams, or by
+        // clean_spool_files after a reset
+        if (released) {
+            release_spool();
         }
     }
 }
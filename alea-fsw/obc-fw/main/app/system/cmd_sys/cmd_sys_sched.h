@@ -27,6 +27,12 @@
  */
 #define CMD_SYS_SCHED_MAX_DATA_SIZE RTC_SCHEDULER_MAX_DATA_SIZE
 
+/**
+ * @brief Larger data payloads are spooled to a file when the command is scheduled
+ * and streamed back from it when the command runs, up to this size.
+ */
+#define CMD_SYS_SCHED_MAX_SPOOLED_DATA_SIZE (16U * 1024U)
+
 /******************************************************************************/
 /*                             F U N C T I O N S                              */
 /******************************************************************************/
@@ -35,5 +41,8 @@ void cmd_sys_sched_pre_init(void);
 void cmd_sys_sched_post_init(void);
 
 cmd_sys_err_t cmd_sys_sched_push_cmd(const cmd_sys_msg_header_t *header, uint8_t *header_and_data, uint32_t header_and_data_len);
+cmd_sys_err_t cmd_sys_sched_push_spooled_cmd(const cmd_sys_msg_header_t *header, uint8_t *header_bytes, uint32_t header_len, const io_istream_t *input,
+        cmd_sys_exec_wait_cb_t wait_callback);
+cmd_sys_err_t cmd_sys_sched_cancel(uint32_t id);
 
 #endif // CMD_SYS_SCHED_H_
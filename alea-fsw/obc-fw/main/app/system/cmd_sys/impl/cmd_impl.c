@@ -157,6 +157,33 @@ cmd_sys_resp_code_t cmd_impl_FLASH_SLEEP(const cmd_sys_cmd_t *cmd, cmd_FLASH_SLE
     return CMD_SYS_RESP_CODE_SUCCESS;
 }
 
+/**
+ * @brief Retrieve the busy-time statistics of a flash operation (see flash_op_t).
+ *
+ * The statistics of all operations are cleared after being read if reset is set.
+ */
+cmd_sys_resp_code_t cmd_impl_FLASH_LATENCY_STATS(const cmd_sys_cmd_t *cmd, cmd_FLASH_LATENCY_STATS_args_t *args, cmd_FLASH_LATENCY_STATS_resp_t *resp) {
+    flash_latency_stats_t stats;
+
+    if (flash_get_latency_stats((flash_op_t)args->op, &stats) != FLASH_OK) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    resp->count       = stats.count;
+    resp->timeouts    = stats.timeouts;
+    resp->min_us      = (stats.count > 0) ? stats.min_us : 0;
+    resp->max_us      = stats.max_us;
+    resp->mean_us     = (stats.count > 0) ? (stats.total_us / stats.count) : 0;
+    resp->expected_us = stats.expected_us;
+    memcpy(resp->hist, stats.hist, sizeof(resp->hist));
+
+    if (args->reset) {
+        flash_reset_latency_stats();
+    }
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
 /**
  * @brief Retrieve the current value of the reboot counter.
  *
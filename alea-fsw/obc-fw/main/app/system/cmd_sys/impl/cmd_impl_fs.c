@@ -0,0 +1,542 @@
+/**
+ * @file cmd_impl_fs.c
+ * @brief Implementation of filesystem-related commands
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "cmd_sys_gen.h"
+#include "cmd_sys.h"
+#include "cmd_sys_exec.h"
+
+// OBC
+#include "obc_filesystem.h"
+#include "fs_upload.h"
+#include "obc_crc.h"
+#include "obc_utils.h"
+
+// Utils
+#include "io_stream.h"
+#include "data_fmt.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define FS_CMD_MUTEX_TIMEOUT_MS     1000U
+
+/* Each FILE_READ chunk is framed as [offset: u32][len: u16][data: len bytes][crc32: u32] */
+#define FILE_READ_CHUNK_HDR_SIZE    6U
+#define FILE_READ_CHUNK_CRC_SIZE    4U
+#define FILE_READ_MAX_CHUNK_SIZE    512U
+
+/* Each FILE_LIST entry is encoded as [type: u8][size: u32][name_len: u8][name: name_len bytes] */
+#define FILE_LIST_ENTRY_HDR_SIZE    6U
+#define FILE_LIST_MAX_ENTRIES       16U
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static uint32_t latency_mean_us(const fs_latency_stats_t *stats);
+static cmd_sys_err_t read_path_arg(const cmd_sys_cmd_t *cmd, uint32_t args_len, char *path);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Retrieve the write ring and block device statistics of the filesystem.
+ *
+ * The statistics are cleared after being read if reset is set. Write amplification is
+ * prog_bytes / flushed_bytes.
+ */
+cmd_sys_resp_code_t cmd_impl_FS_STATS(const cmd_sys_cmd_t *cmd, cmd_FS_STATS_args_t *args, cmd_FS_STATS_resp_t *resp) {
+    fs_write_stats_t write_stats;
+    fs_io_stats_t io_stats;
+
+    fs_get_write_stats(&write_stats);
+    fs_get_io_stats(&io_stats);
+
+    resp->enqueued       = write_stats.enqueued;
+    resp->enqueued_bytes = write_stats.enqueued_bytes;
+    resp->dropped        = write_stats.dropped;
+    resp->dropped_bytes  = write_stats.dropped_bytes;
+    resp->high_water     = write_stats.high_water;
+    resp->flushes        = write_stats.flushes;
+    resp->flush_errors   = write_stats.flush_errors;
+    resp->flushed_bytes  = write_stats.flushed_bytes;
+
+    resp->reads          = io_stats.reads;
+    resp->read_bytes     = io_stats.read_bytes;
+    resp->progs          = io_stats.progs;
+    resp->prog_bytes     = io_stats.prog_bytes;
+    resp->erases         = io_stats.erases;
+    resp->erases_skipped = io_stats.erases_skipped;
+    resp->scrub_erases   = io_stats.scrub_erases;
+    resp->scrub_blocks   = io_stats.scrub_blocks;
+    resp->errors         = io_stats.errors;
+    resp->blocks_used    = io_stats.blocks_used;
+
+    resp->flush_count    = io_stats.flush.count;
+    resp->flush_max_us   = io_stats.flush.max_us;
+    resp->flush_mean_us  = latency_mean_us(&io_stats.flush);
+    memcpy(resp->flush_hist, io_stats.flush.hist, sizeof(resp->flush_hist));
+
+    resp->sync_count     = io_stats.sync.count;
+    resp->sync_max_us    = io_stats.sync.max_us;
+    resp->sync_mean_us   = latency_mean_us(&io_stats.sync);
+    memcpy(resp->sync_hist, io_stats.sync.hist, sizeof(resp->sync_hist));
+
+    if (args->reset) {
+        fs_reset_write_stats();
+
+        if (fs_reset_io_stats(FS_CMD_MUTEX_TIMEOUT_MS) != FS_OK) {
+            return CMD_SYS_RESP_CODE_ERROR;
+        }
+    }
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+/**
+ * @brief Retrieve the statistics and filename of a file written through the write ring.
+ *
+ * Handles are numbered from 0 in the order the files were first written.
+ */
+cmd_sys_err_t cmd_impl_FS_FILE_STATS(const cmd_sys_cmd_t *cmd, cmd_FS_FILE_STATS_args_t *args, cmd_FS_FILE_STATS_resp_t *resp,
+                                     const data_fmt_desc_t *resp_desc, uint32_t resp_len, uint8_t *buf) {
+    fs_file_stats_t stats;
+
+    if (fs_get_file_stats(args->handle, &stats) != FS_OK) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    }
+
+    resp->enqueued_bytes = stats.enqueued_bytes;
+    resp->dropped_bytes  = stats.dropped_bytes;
+    resp->flushed_bytes  = stats.flushed_bytes;
+
+    uint32_t name_len = strlen(stats.name);
+
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (resp_len + name_len));
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    err = cmd_sys_handle_resp_fields(cmd, resp, resp_desc, resp_len, buf);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    uint32_t bytes_written = io_stream_write(cmd->output, (uint8_t *) stats.name, name_len, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+    if (bytes_written != name_len) {
+        return CMD_SYS_ERR_WRITE_TIMEOUT;
+    }
+
+    return cmd_sys_finish_response(cmd);
+}
+
+/**
+ * @brief Retrieve the type and size of a file or directory.
+ *
+ * fs_err is set to the filesystem error if the path can't be found (FS_NOENT_ERR) or read.
+ */
+cmd_sys_resp_code_t cmd_impl_FILE_STAT(const cmd_sys_cmd_t *cmd, cmd_FILE_STAT_resp_t *resp) {
+    static char path[FS_PATH_MAX_SIZE] = { 0 };
+    fs_entry_info_t info;
+
+    if (read_path_arg(cmd, 0, path) != CMD_SYS_SUCCESS) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    fs_err_t err = fs_stat(path, &info, FS_CMD_MUTEX_TIMEOUT_MS);
+
+    resp->fs_err = err;
+
+    if (err != FS_OK) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    resp->type = info.type;
+    resp->size = info.size;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+/**
+ * @brief List the entries of a directory ("/" if path is empty).
+ *
+ * Returns up to FILE_LIST_MAX_ENTRIES entries starting from entry number start. If count is less
+ * than total - start, the rest of the listing is retrieved by calling again with start + count.
+ * Each entry is encoded as [type: u8][size: u32][name_len: u8][name].
+ */
+cmd_sys_err_t cmd_impl_FILE_LIST(const cmd_sys_cmd_t *cmd, cmd_FILE_LIST_args_t *args, uint32_t args_len, cmd_FILE_LIST_resp_t *resp,
+                                 const data_fmt_desc_t *resp_desc, uint32_t resp_len, uint8_t *buf) {
+    static char path[FS_PATH_MAX_SIZE] = { 0 };
+    static fs_entry_info_t entries[FILE_LIST_MAX_ENTRIES] = { 0 };
+
+    cmd_sys_err_t err = read_path_arg(cmd, args_len, path);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    if (path[0] == '\0') {
+        strcpy(path, "/");
+    }
+
+    uint16_t count = 0;
+    uint16_t total = 0;
+
+    if (fs_list(path, args->start, entries, FILE_LIST_MAX_ENTRIES, &count, &total, FS_CMD_MUTEX_TIMEOUT_MS) != FS_OK) {
+        return CMD_SYS_ERR_INVALID_STATE;
+    }
+
+    resp->total = total;
+    resp->count = (uint8_t) count;
+
+    // The response length must be known before anything is sent
+    uint32_t entries_len = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        entries_len += FILE_LIST_ENTRY_HDR_SIZE + strlen(entries[i].name);
+    }
+
+    err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (resp_len + entries_len));
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    err = cmd_sys_handle_resp_fields(cmd, resp, resp_desc, resp_len, buf);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        uint8_t entry_hdr[FILE_LIST_ENTRY_HDR_SIZE];
+        uint32_t name_len = strlen(entries[i].name);
+
+        entry_hdr[0] = entries[i].type;
+        data_fmt_u32_to_arr_be(entries[i].size, &entry_hdr[1]);
+        entry_hdr[5] = (uint8_t) name_len;
+
+        uint32_t bytes_written = io_stream_write(cmd->output, entry_hdr, sizeof(entry_hdr), pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+        bytes_written += io_stream_write(cmd->output, (uint8_t *) entries[i].name, name_len, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+        if (bytes_written != (sizeof(entry_hdr) + name_len)) {
+            return CMD_SYS_ERR_WRITE_TIMEOUT;
+        }
+    }
+
+    return cmd_sys_finish_response(cmd);
+}
+
+/**
+ * @brief Download part of a file.
+ *
+ * Reads length bytes (or up to the end of the file if length is 0 or goes past it) starting at
+ * offset, and sends them in chunks of chunk_size bytes framed as:
+ *
+ *     [offset: u32][len: u16][data: len bytes][crc32: u32]
+ *
+ * where offset is the position of the chunk in the file and the CRC covers the offset, len and
+ * data. An interrupted download is resumed by reading again from the end of the last chunk that
+ * was received with a valid CRC, and a corrupted chunk can be re-read on its own. file_size is the
+ * size of the whole file.
+ *
+ * The file is opened and closed for every chunk so the filesystem isn't locked while the response
+ * is sent.
+ */
+cmd_sys_err_t cmd_impl_FILE_READ(const cmd_sys_cmd_t *cmd, cmd_FILE_READ_args_t *args, uint32_t args_len, cmd_FILE_READ_resp_t *resp,
+                                 const data_fmt_desc_t *resp_desc, uint32_t resp_len, uint8_t *buf) {
+    static char path[FS_PATH_MAX_SIZE] = { 0 };
+    static uint8_t chunk[FILE_READ_CHUNK_HDR_SIZE + FILE_READ_MAX_CHUNK_SIZE + FILE_READ_CHUNK_CRC_SIZE] = { 0 };
+
+    cmd_sys_err_t err = read_path_arg(cmd, args_len, path);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    if ((args->chunk_size == 0) || (args->chunk_size > FILE_READ_MAX_CHUNK_SIZE)) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    }
+
+    fs_entry_info_t info;
+    fs_err_t fs_err = fs_stat(path, &info, FS_CMD_MUTEX_TIMEOUT_MS);
+
+    if ((fs_err == FS_NOENT_ERR) || ((fs_err == FS_OK) && (info.type != FS_TYPE_FILE))) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    } else if (fs_err != FS_OK) {
+        return CMD_SYS_ERR_INVALID_STATE;
+    }
+
+    if (args->offset > info.size) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    }
+
+    uint32_t bytes_left = info.size - args->offset;
+
+    if ((args->length > 0) && (args->length < bytes_left)) {
+        bytes_left = args->length;
+    }
+
+    uint32_t num_chunks = (bytes_left + args->chunk_size - 1U) / args->chunk_size;
+    uint32_t data_len   = bytes_left + (num_chunks * (FILE_READ_CHUNK_HDR_SIZE + FILE_READ_CHUNK_CRC_SIZE));
+
+    resp->file_size = info.size;
+
+    err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (resp_len + data_len));
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    err = cmd_sys_handle_resp_fields(cmd, resp, resp_desc, resp_len, buf);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    uint32_t offset = args->offset;
+
+    while (bytes_left > 0) {
+        uint32_t chunk_len = MIN(bytes_left, args->chunk_size);
+        uint32_t bytes_read = 0;
+
+        fs_err = fs_read_at(path, offset, &chunk[FILE_READ_CHUNK_HDR_SIZE], chunk_len, &bytes_read, FS_CMD_MUTEX_TIMEOUT_MS);
+
+        // The file may have been truncated or removed since it was stat'd
+        if ((fs_err != FS_OK) || (bytes_read != chunk_len)) {
+            return CMD_SYS_ERR_INVALID_STATE;
+        }
+
+        data_fmt_u32_to_arr_be(offset, &chunk[0]);
+        data_fmt_u16_to_arr_be((uint16_t) chunk_len, &chunk[4]);
+
+        uint32_t frame_len = FILE_READ_CHUNK_HDR_SIZE + chunk_len;
+        data_fmt_u32_to_arr_be(crc_32_buf(CRC32_SEED, chunk, frame_len), &chunk[frame_len]);
+        frame_len += FILE_READ_CHUNK_CRC_SIZE;
+
+        // cmd->output is buffered, so chunks are packed together in the downlink
+        uint32_t bytes_written = io_stream_write(cmd->output, chunk, frame_len, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+        if (bytes_written != frame_len) {
+            return CMD_SYS_ERR_WRITE_TIMEOUT;
+        }
+
+        offset     += chunk_len;
+        bytes_left -= chunk_len;
+
+        cmd_sys_exec_pet();
+
+        if (cmd_sys_exec_cancelled(cmd)) {
+            return CMD_SYS_ERR_EXEC_CANCELLED;
+        }
+    }
+
+    return cmd_sys_finish_response(cmd);
+}
+
+/**
+ * @brief Start uploading a file of the given size and CRC32 to path, or resume the upload in progress.
+ *
+ * The upload is resumed if it has the same path, size and CRC, in which case resumed is set and
+ * blocks_received tells how much has already been written (see UPLOAD_STATUS for which blocks).
+ */
+cmd_sys_resp_code_t cmd_impl_UPLOAD_BEGIN(const cmd_sys_cmd_t *cmd, cmd_UPLOAD_BEGIN_args_t *args, uint32_t args_len, cmd_UPLOAD_BEGIN_resp_t *resp) {
+    static char path[FS_PATH_MAX_SIZE] = { 0 };
+    fs_upload_status_t status;
+    bool resumed = false;
+
+    if (read_path_arg(cmd, args_len, path) != CMD_SYS_SUCCESS) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    fs_err_t err = fs_upload_begin(path, args->size, args->crc, &resumed);
+
+    if (err == FS_OK) {
+        err = fs_upload_get_status(&status, NULL, 0);
+    }
+
+    resp->fs_err = err;
+
+    if (err != FS_OK) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    resp->resumed         = resumed;
+    resp->block_size      = FS_UPLOAD_BLOCK_SIZE;
+    resp->blocks_total    = status.blocks_total;
+    resp->blocks_received = status.blocks_received;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+/**
+ * @brief Write data of the file being uploaded at offset.
+ *
+ * offset must be a multiple of the block size, and so must the length of the data unless it ends
+ * at the end of the file. The data is written as it is received, one block at a time.
+ */
+cmd_sys_resp_code_t cmd_impl_UPLOAD_WRITE(const cmd_sys_cmd_t *cmd, cmd_UPLOAD_WRITE_args_t *args, uint32_t args_len, cmd_UPLOAD_WRITE_resp_t *resp) {
+    static uint8_t data[FS_UPLOAD_BLOCK_SIZE] = { 0 };
+    fs_upload_status_t status;
+
+    uint32_t data_len = cmd->header.data_len - args_len;
+    uint32_t offset   = args->offset;
+    fs_err_t err      = (data_len > 0) ? FS_OK : FS_INVAL_ERR;
+
+    while (data_len > 0) {
+        uint32_t len = MIN(data_len, FS_UPLOAD_BLOCK_SIZE);
+        uint32_t bytes_read = io_stream_read(cmd->input, data, len, pdMS_TO_TICKS(CMD_SYS_INPUT_READ_TIMEOUT_MS), NULL);
+
+        if (bytes_read != len) {
+            return CMD_SYS_RESP_CODE_ERROR;
+        }
+
+        // Keep reading the data after a failure so the whole command is consumed
+        if (err == FS_OK) {
+            err = fs_upload_write(offset, data, len);
+        }
+
+        offset   += len;
+        data_len -= len;
+
+        cmd_sys_exec_pet();
+    }
+
+    if (fs_upload_get_status(&status, NULL, 0) == FS_OK) {
+        resp->blocks_received = status.blocks_received;
+    }
+
+    resp->fs_err = err;
+
+    return (err == FS_OK) ? CMD_SYS_RESP_CODE_SUCCESS : CMD_SYS_RESP_CODE_ERROR;
+}
+
+/**
+ * @brief Retrieve the state of the upload in progress.
+ *
+ * bitmap has one bit per block, set once the block has been written: bit (i % 8) of byte (i / 8)
+ * for block i. Blocks whose bit is clear must be written before UPLOAD_FINISH.
+ */
+cmd_sys_err_t cmd_impl_UPLOAD_STATUS(const cmd_sys_cmd_t *cmd, cmd_UPLOAD_STATUS_resp_t *resp, const data_fmt_desc_t *resp_desc, uint32_t resp_len,
+                                     uint8_t *buf) {
+    static uint8_t bitmap[FS_UPLOAD_BITMAP_SIZE] = { 0 };
+    fs_upload_status_t status;
+
+    if (fs_upload_get_status(&status, bitmap, sizeof(bitmap)) != FS_OK) {
+        return CMD_SYS_ERR_INVALID_STATE;
+    }
+
+    resp->active          = status.active;
+    resp->size            = status.size;
+    resp->crc             = status.crc;
+    resp->blocks_total    = status.blocks_total;
+    resp->blocks_received = status.blocks_received;
+
+    uint32_t bitmap_len = (status.blocks_total + 7U) / 8U;
+
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (resp_len + bitmap_len));
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    err = cmd_sys_handle_resp_fields(cmd, resp, resp_desc, resp_len, buf);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    uint32_t bytes_written = io_stream_write(cmd->output, bitmap, bitmap_len, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+    if (bytes_written != bitmap_len) {
+        return CMD_SYS_ERR_WRITE_TIMEOUT;
+    }
+
+    return cmd_sys_finish_response(cmd);
+}
+
+/**
+ * @brief Check the CRC of the uploaded file and move it to its destination.
+ *
+ * Fails with FS_UPLOAD_INCOMPLETE_ERR if blocks are missing. If the CRC doesn't match
+ * (FS_UPLOAD_CRC_ERR), the upload is kept and crc is the CRC of the data received.
+ */
+cmd_sys_resp_code_t cmd_impl_UPLOAD_FINISH(const cmd_sys_cmd_t *cmd, cmd_UPLOAD_FINISH_resp_t *resp) {
+    uint32_t crc = 0;
+    bool done = false;
+    fs_err_t err = FS_OK;
+
+    do {
+        err = fs_upload_finish_step(&crc, &done);
+        cmd_sys_exec_pet();
+    } while ((err == FS_OK) && !done);
+
+    resp->fs_err = err;
+    resp->crc    = crc;
+
+    return (err == FS_OK) ? CMD_SYS_RESP_CODE_SUCCESS : CMD_SYS_RESP_CODE_ERROR;
+}
+
+/**
+ * @brief Cancel the upload in progress and delete the data received so far.
+ */
+cmd_sys_resp_code_t cmd_impl_UPLOAD_ABORT(const cmd_sys_cmd_t *cmd, cmd_UPLOAD_ABORT_resp_t *resp) {
+    fs_err_t err = fs_upload_abort();
+
+    resp->fs_err = err;
+
+    return (err == FS_OK) ? CMD_SYS_RESP_CODE_SUCCESS : CMD_SYS_RESP_CODE_ERROR;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Mean duration of an operation
+ */
+static uint32_t latency_mean_us(const fs_latency_stats_t *stats) {
+    return (stats->count > 0) ? (stats->total_us / stats->count) : 0;
+}
+
+/**
+ * @brief Read the path that follows the fixed arguments of a command and NULL terminate it
+ *
+ * @param[in]  cmd      Pointer to command struct (with input stream)
+ * @param[in]  args_len Number of bytes of fixed arguments before the path
+ * @param[out] path     Buffer of FS_PATH_MAX_SIZE bytes to store the path
+ *
+ * @return CMD_SYS_ERR_ARGS_TOO_LARGE if the path doesn't fit in the buffer, CMD_SYS_ERR_READ_TIMEOUT if
+ *         the path couldn't be read, CMD_SYS_SUCCESS otherwise
+ */
+static cmd_sys_err_t read_path_arg(const cmd_sys_cmd_t *cmd, uint32_t args_len, char *path) {
+    uint32_t path_len = cmd->header.data_len - args_len;
+
+    if (path_len >= FS_PATH_MAX_SIZE) { // >= to keep NULL terminator
+        return CMD_SYS_ERR_ARGS_TOO_LARGE;
+    }
+
+    uint32_t bytes_read = io_stream_read(cmd->input, (uint8_t *) path, path_len, pdMS_TO_TICKS(CMD_SYS_INPUT_READ_TIMEOUT_MS), NULL);
+
+    if (bytes_read != path_len) {
+        return CMD_SYS_ERR_READ_TIMEOUT;
+    }
+
+    path[path_len] = '\0';
+
+    return CMD_SYS_SUCCESS;
+}
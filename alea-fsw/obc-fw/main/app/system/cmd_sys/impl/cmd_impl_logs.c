@@ -9,6 +9,7 @@
 
 #include "cmd_sys_gen.h"
 #include "cmd_sys.h"
+#include "cmd_sys_exec.h"
 
 // OBC
 #include "obc_filesystem.h"
@@ -16,8 +17,8 @@
 // Logger
 #include "logger.h"
 #include "log_sys.h"
+#include "log_filter.h"
 
-#include "obc_watchdog.h"
 
 /******************************************************************************/
 /*                               D E F I N E S                                */
@@ -25,6 +26,8 @@
 
 #define CHUNK_SIZE 800
 
+#define LOG_FILTER_GET_MAX_SIGNALS 255U
+
 /******************************************************************************/
 /*                       P U B L I C  F U N C T I O N S                       */
 /******************************************************************************/
@@ -44,15 +47,14 @@ cmd_sys_err_t cmd_impl_GET_LOGS(const cmd_sys_cmd_t *cmd, cmd_GET_LOGS_args_t *a
     cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (uint32_t)bytes_left);
 
     if (err != CMD_SYS_SUCCESS) {
+        logs_read_end();
         return err;
     }
 
     while (bytes_left > 0) {
         int32_t bytes_read = logs_read(); // Reads into read_buf
 
-        if (bytes_read < 0) { // FS error
-            return CMD_SYS_ERR_INVALID_STATE;
-        } else if (bytes_read == 0) {
+        if (bytes_read <= 0) { // FS error or logs exhausted early
             logs_read_end();
             return CMD_SYS_ERR_INVALID_STATE;
         }
@@ -66,7 +68,12 @@ cmd_sys_err_t cmd_impl_GET_LOGS(const cmd_sys_cmd_t *cmd, cmd_GET_LOGS_args_t *a
 
         bytes_left -= bytes_written;
 
-        obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_EXEC);
+        cmd_sys_exec_pet();
+
+        if (cmd_sys_exec_cancelled(cmd)) {
+            logs_read_end();
+            return CMD_SYS_ERR_EXEC_CANCELLED;
+        }
     }
 
     logs_read_end();
@@ -74,6 +81,56 @@ cmd_sys_err_t cmd_impl_GET_LOGS(const cmd_sys_cmd_t *cmd, cmd_GET_LOGS_args_t *a
     return cmd_sys_finish_response(cmd);
 }
 
+cmd_sys_err_t cmd_impl_GET_LOGS_RANGE(const cmd_sys_cmd_t *cmd, cmd_GET_LOGS_RANGE_args_t *args) {
+    if ((args->size > FS_LOGGING_PARTITION_SIZE) || (args->epoch_start > args->epoch_end)) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    }
+
+    int32_t bytes_left = logs_query_begin(args->epoch_start, args->epoch_end, args->log_id, args->size);
+
+    if (bytes_left < 0) {
+        return CMD_SYS_ERR_INVALID_STATE;
+    }
+
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (uint32_t)bytes_left);
+
+    if (err != CMD_SYS_SUCCESS) {
+        logs_query_end();
+        return err;
+    }
+
+    uint8_t read_buf[CHUNK_SIZE];
+
+    while (bytes_left > 0) {
+        int32_t bytes_read = logs_query_read(read_buf, sizeof(read_buf));
+
+        if (bytes_read <= 0) {
+            logs_query_end();
+            return CMD_SYS_ERR_INVALID_STATE;
+        }
+
+        uint32_t bytes_written = io_stream_write(cmd->output, read_buf, (uint32_t)bytes_read, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+        if (bytes_written != (uint32_t)bytes_read) {
+            logs_query_end();
+            return CMD_SYS_ERR_WRITE_TIMEOUT;
+        }
+
+        bytes_left -= bytes_written;
+
+        cmd_sys_exec_pet();
+
+        if (cmd_sys_exec_cancelled(cmd)) {
+            logs_query_end();
+            return CMD_SYS_ERR_EXEC_CANCELLED;
+        }
+    }
+
+    logs_query_end();
+
+    return cmd_sys_finish_response(cmd);
+}
+
 cmd_sys_resp_code_t cmd_impl_GET_LOGFILE_INFO(const cmd_sys_cmd_t *cmd, cmd_GET_LOGFILE_INFO_resp_t *resp) {
     struct logfile_info_t info;
 
@@ -90,3 +147,57 @@ cmd_sys_resp_code_t cmd_impl_GET_LOGFILE_INFO(const cmd_sys_cmd_t *cmd, cmd_GET_
     return CMD_SYS_RESP_CODE_SUCCESS;
 }
 
+
+cmd_sys_resp_code_t cmd_impl_LOG_FILTER_SET(const cmd_sys_cmd_t *cmd, cmd_LOG_FILTER_SET_args_t *args) {
+    if (!log_filter_set_signal(args->log_id, args->sig_id, args->sinks)) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+cmd_sys_resp_code_t cmd_impl_LOG_LEVEL_FILTER_SET(const cmd_sys_cmd_t *cmd, cmd_LOG_LEVEL_FILTER_SET_args_t *args) {
+    if (!log_filter_set_level(args->level, args->sinks)) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+cmd_sys_err_t cmd_impl_LOG_FILTER_GET(const cmd_sys_cmd_t *cmd, cmd_LOG_FILTER_GET_args_t *args, cmd_LOG_FILTER_GET_resp_t *resp,
+                                      const data_fmt_desc_t *resp_desc, uint32_t resp_len, uint8_t *buf) {
+    uint8_t sinks[LOG_FILTER_GET_MAX_SIGNALS];
+    uint8_t count = 0;
+
+    if (!log_filter_get_group(args->log_id, sinks, sizeof(sinks), &count)) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    }
+
+    log_filter_get_levels(resp->level_sinks);
+
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (resp_len + count));
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    err = cmd_sys_handle_resp_fields(cmd, resp, resp_desc, resp_len, buf);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    uint32_t bytes_written = io_stream_write(cmd->output, sinks, count, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+    if (bytes_written != count) {
+        return CMD_SYS_ERR_WRITE_TIMEOUT;
+    }
+
+    return cmd_sys_finish_response(cmd);
+}
+
+cmd_sys_resp_code_t cmd_impl_LOG_FILTER_RESET(const cmd_sys_cmd_t *cmd) {
+    log_filter_reset();
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
@@ -0,0 +1,254 @@
+/**
+ * @file cmd_impl_sched.c
+ * @brief Implementation of commands to inspect and manage the schedule
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "cmd_sys_gen.h"
+#include "cmd_sys.h"
+#include "cmd_sys_sched.h"
+#include "cmd_sys_results.h"
+#include "cmd_sys_exec.h"
+
+// RTC Scheduler
+#include "rtc_scheduler.h"
+
+// Utils
+#include "io_stream.h"
+#include "data_fmt.h"
+#include "obc_utils.h"
+
+// FreeRTOS
+#include "rtos.h"
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define SCHED_CMD_TIMEOUT_MS        1000U
+
+/* Each SCHED_LIST entry is encoded as [item_id: u32][timestamp: u32][priority: u8][cmd_id: u8][data_len: u8] */
+#define SCHED_LIST_ENTRY_SIZE       11U
+#define SCHED_LIST_MAX_ENTRIES      16U
+
+/* Each SCHED_RESULTS entry is encoded as [seq: u32][item_id: u32][epoch: u32][size: u32][cmd_id: u8][err: u8][flags: u8] */
+#define SCHED_RESULTS_ENTRY_SIZE    19U
+#define SCHED_RESULTS_MAX_ENTRIES   16U
+
+#define SCHED_RESULT_READ_CHUNK_SIZE 256U
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+cmd_sys_resp_code_t cmd_impl_SCHED_INFO(const cmd_sys_cmd_t *cmd, cmd_SCHED_INFO_resp_t *resp) {
+    rtc_scheduler_info_t info;
+
+    if (rtc_scheduler_get_info(&info, pdMS_TO_TICKS(SCHED_CMD_TIMEOUT_MS)) != RTC_SCHEDULER_SUCCESS) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    resp->count          = info.count;
+    resp->capacity       = info.capacity;
+    resp->next_timestamp = info.next_timestamp;
+    resp->journal_size   = info.journal_size;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+/**
+ * @brief List the scheduled commands, in the order they were scheduled.
+ *
+ * Start with cursor 0 and send the returned next_cursor until it is 0. The listing must be started over
+ * if the cursor is rejected, which happens when the schedule journal was compacted in between.
+ */
+cmd_sys_err_t cmd_impl_SCHED_LIST(const cmd_sys_cmd_t *cmd, cmd_SCHED_LIST_args_t *args, cmd_SCHED_LIST_resp_t *resp,
+                                  const data_fmt_desc_t *resp_desc, uint32_t resp_len, uint8_t *buf) {
+    static rtc_scheduler_entry_t entries[SCHED_LIST_MAX_ENTRIES] = { 0 };
+
+    uint32_t cursor = args->cursor;
+    uint8_t count = 0;
+
+    rtc_scheduler_err_t sched_err = rtc_scheduler_list(&cursor, entries, SCHED_LIST_MAX_ENTRIES, &count, pdMS_TO_TICKS(SCHED_CMD_TIMEOUT_MS));
+
+    if (sched_err == RTC_SCHEDULER_ERR_INVALID_ARGS) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    } else if (sched_err != RTC_SCHEDULER_SUCCESS) {
+        return CMD_SYS_ERR_INVALID_STATE;
+    }
+
+    resp->next_cursor = cursor;
+    resp->count = count;
+
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (resp_len + (count * SCHED_LIST_ENTRY_SIZE)));
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    err = cmd_sys_handle_resp_fields(cmd, resp, resp_desc, resp_len, buf);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t entry[SCHED_LIST_ENTRY_SIZE];
+
+        data_fmt_u32_to_arr_be(entries[i].id, &entry[0]);
+        data_fmt_u32_to_arr_be(entries[i].timestamp, &entry[4]);
+        entry[8]  = entries[i].priority;
+        entry[9]  = entries[i].tag;
+        entry[10] = entries[i].data_len;
+
+        uint32_t bytes_written = io_stream_write(cmd->output, entry, sizeof(entry), pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+        if (bytes_written != sizeof(entry)) {
+            return CMD_SYS_ERR_WRITE_TIMEOUT;
+        }
+    }
+
+    return cmd_sys_finish_response(cmd);
+}
+
+cmd_sys_resp_code_t cmd_impl_SCHED_CANCEL(const cmd_sys_cmd_t *cmd, cmd_SCHED_CANCEL_args_t *args) {
+    if (cmd_sys_sched_cancel(args->item_id) != CMD_SYS_SUCCESS) {
+        return CMD_SYS_RESP_CODE_ERROR;
+    }
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+/**
+ * @brief List the stored results of scheduled commands run between start_epoch and end_epoch (inclusive).
+ *
+ * Start with min_seq 0 and send the returned next_seq while count is SCHED_RESULTS_MAX_ENTRIES.
+ * The response to a command is then read with SCHED_RESULT_READ.
+ */
+cmd_sys_err_t cmd_impl_SCHED_RESULTS(const cmd_sys_cmd_t *cmd, cmd_SCHED_RESULTS_args_t *args, cmd_SCHED_RESULTS_resp_t *resp,
+                                     const data_fmt_desc_t *resp_desc, uint32_t resp_len, uint8_t *buf) {
+    static cmd_sys_results_entry_t entries[SCHED_RESULTS_MAX_ENTRIES] = { 0 };
+
+    uint8_t count = 0;
+    uint32_t next_seq = 0;
+
+    cmd_sys_results_err_t results_err = cmd_sys_results_find(args->start_epoch, args->end_epoch, args->min_seq, entries, SCHED_RESULTS_MAX_ENTRIES,
+                                                             &count, &next_seq, pdMS_TO_TICKS(SCHED_CMD_TIMEOUT_MS));
+
+    if (results_err != CMD_SYS_RESULTS_SUCCESS) {
+        return CMD_SYS_ERR_INVALID_STATE;
+    }
+
+    resp->next_seq = next_seq;
+    resp->count = count;
+
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (resp_len + (count * SCHED_RESULTS_ENTRY_SIZE)));
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    err = cmd_sys_handle_resp_fields(cmd, resp, resp_desc, resp_len, buf);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t entry[SCHED_RESULTS_ENTRY_SIZE];
+
+        data_fmt_u32_to_arr_be(entries[i].seq, &entry[0]);
+        data_fmt_u32_to_arr_be(entries[i].item_id, &entry[4]);
+        data_fmt_u32_to_arr_be(entries[i].epoch, &entry[8]);
+        data_fmt_u32_to_arr_be(entries[i].size, &entry[12]);
+        entry[16] = entries[i].cmd_id;
+        entry[17] = entries[i].err;
+        entry[18] = entries[i].flags;
+
+        uint32_t bytes_written = io_stream_write(cmd->output, entry, sizeof(entry), pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+        if (bytes_written != sizeof(entry)) {
+            return CMD_SYS_ERR_WRITE_TIMEOUT;
+        }
+    }
+
+    return cmd_sys_finish_response(cmd);
+}
+
+/**
+ * @brief Read the stored response to a scheduled command, from offset and up to length bytes (0 to read until the end).
+ *
+ * The data is the response exactly as the command wrote it (header included).
+ */
+cmd_sys_err_t cmd_impl_SCHED_RESULT_READ(const cmd_sys_cmd_t *cmd, cmd_SCHED_RESULT_READ_args_t *args, cmd_SCHED_RESULT_READ_resp_t *resp,
+                                         const data_fmt_desc_t *resp_desc, uint32_t resp_len, uint8_t *buf) {
+    static uint8_t chunk[SCHED_RESULT_READ_CHUNK_SIZE] = { 0 };
+
+    cmd_sys_results_entry_t entry;
+    cmd_sys_results_err_t results_err = cmd_sys_results_get(args->seq, &entry, pdMS_TO_TICKS(SCHED_CMD_TIMEOUT_MS));
+
+    if (results_err == CMD_SYS_RESULTS_ERR_SEQ_DNE) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    } else if (results_err != CMD_SYS_RESULTS_SUCCESS) {
+        return CMD_SYS_ERR_INVALID_STATE;
+    }
+
+    if (args->offset > entry.size) {
+        return CMD_SYS_ERR_INVALID_ARGS;
+    }
+
+    uint32_t bytes_left = entry.size - args->offset;
+
+    if ((args->length > 0) && (args->length < bytes_left)) {
+        bytes_left = args->length;
+    }
+
+    resp->size  = entry.size;
+    resp->flags = entry.flags;
+
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, (resp_len + bytes_left));
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    err = cmd_sys_handle_resp_fields(cmd, resp, resp_desc, resp_len, buf);
+
+    if (err != CMD_SYS_SUCCESS) {
+        return err;
+    }
+
+    uint32_t offset = args->offset;
+
+    while (bytes_left > 0) {
+        uint32_t chunk_len = MIN(bytes_left, sizeof(chunk));
+        uint32_t bytes_read = 0;
+
+        results_err = cmd_sys_results_read(args->seq, offset, chunk, chunk_len, &bytes_read, pdMS_TO_TICKS(SCHED_CMD_TIMEOUT_MS));
+
+        // The result may have been replaced by a newer one since it was looked up
+        if ((results_err != CMD_SYS_RESULTS_SUCCESS) || (bytes_read != chunk_len)) {
+            return CMD_SYS_ERR_INVALID_STATE;
+        }
+
+        uint32_t bytes_written = io_stream_write(cmd->output, chunk, chunk_len, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+
+        if (bytes_written != chunk_len) {
+            return CMD_SYS_ERR_WRITE_TIMEOUT;
+        }
+
+        offset     += chunk_len;
+        bytes_left -= chunk_len;
+
+        cmd_sys_exec_pet();
+
+        if (cmd_sys_exec_cancelled(cmd)) {
+            return CMD_SYS_ERR_EXEC_CANCELLED;
+        }
+    }
+
+    return cmd_sys_finish_response(cmd);
+}
@@ -10,12 +10,14 @@
 
 #include "cmd_sys_gen.h"
 #include "cmd_sys.h"
+#include "cmd_sys_exec.h"
 
 // OBC
 #include "obc_featuredefs.h"
 #include "telem.h"
 #include "telem_gen.h"
 #include "telem_error.h"
+#include "telem_store.h"
 #include "lfs.h"
 #include "obc_filesystem.h"
 
@@ -24,11 +26,34 @@
 
 // Utils
 #include "obc_utils.h"
-#include "obc_watchdog.h"
+#include "buffered_io.h"
+#include "io_stream.h"
 
 // FreeRTOS
 #include "rtos.h"
 
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define TELEM_RANGE_OUTPUT_BUF_SIZE     256U
+
+/**
+ * @brief Size of the chunks GET_TELEMETRY sends the data in, newest chunk first
+ */
+#define TELEM_READ_CHUNK_SIZE           800U
+
+/**
+ * @brief Time allowed for each of the two runs of a GET_TELEMETRY_RANGE query
+ */
+#define TELEM_RANGE_QUERY_TIMEOUT_MS    20000U
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static uint32_t cmd_output_write(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
+
 /******************************************************************************/
 /*                       P U B L I C  F U N C T I O N S                       */
 /******************************************************************************/
@@ -37,72 +62,207 @@ cmd_sys_err_t cmd_impl_GET_TELEMETRY(const cmd_sys_cmd_t *cmd, cmd_GET_TELEMETRY
     // Telemetry collection is disabled during downlink to prevent file read/write conflicts
     telem_collect_disable();
 
-    char filename[17] = "";
-    convert_priority_to_filename(filename, args->priority);
+    uint8_t priority = MIN(args->priority, TELEM_NUM_PRIORITIES - 1U);
+    uint32_t tail;
+    uint32_t head;
+    uint32_t total_size = 0;
 
-    lfs_file_t file = { 0 };
+    // Write the frames that haven't been written as a telem block yet (frames that can't be written are dropped)
+    telem_err_t telem_err = telem_flush(priority, 1000);
 
-    if (fs_open(&file, filename, 1000) != FS_OK) {
+    if (telem_err != TELEM_SUCCESS) {
+        LOG_TELEM__EXECUTION_FAILURE(telem_err);
+    }
+
+    // The sizes of the segments only include what has been flushed
+    if ((fs_flush(1000) != FS_OK) || (telem_store_get_range(priority, &tail, &head, 1000) != TELEM_SUCCESS) ||
+            (telem_store_get_size(priority, &total_size, 1000) != TELEM_SUCCESS)) {
         telem_collect_enable();
         return CMD_SYS_ERR_INVALID_ARGS;
     }
 
-    int32_t file_size = fs_size(&file);
+    uint32_t read_size = MIN(args->size, total_size);
+    uint32_t bytes_left = read_size;
+    uint8_t read_buf[TELEM_READ_CHUNK_SIZE];
 
-    uint16_t chunk_size = 800;
-    int32_t bytes_left = MIN(args->size, file_size);
-    uint8_t read_buf[800];
-
-    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, bytes_left);
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, read_size);
 
     if (err != CMD_SYS_SUCCESS) {
-        fs_close(&file);
         telem_collect_enable();
         return err;
     }
 
-    if (fs_seek(&file, 0, FS_SEEK_END) != FS_OK) {
-        telem_collect_enable();
-        return CMD_SYS_ERR_INVALID_ARGS;
-    }
+    /*
+     * The newest data is sent first, in chunks of TELEM_READ_CHUNK_SIZE counted back from the end of the head
+     * segment, as if the segments were a single file. Each chunk is in file order and only the last (oldest) one
+     * can be partial, so the ground reverses the order of the chunks to get the data in file order. A chunk that
+     * spans segments is filled backwards, from the end of the newer segment then from the end of the older one.
+     */
+    uint32_t seq = head;
+    uint32_t seg_end = 0;
+    bool seg_loaded = false;
+    char filename[TELEM_STORE_NAME_MAX_SIZE];
 
     while (bytes_left > 0) {
-        int32_t bytes_to_read = MIN(chunk_size, bytes_left);
+        uint32_t chunk_len = MIN(TELEM_READ_CHUNK_SIZE, bytes_left);
+        uint32_t chunk_left = chunk_len;
 
-        if (fs_seek(&file, -bytes_to_read, FS_SEEK_CUR) != FS_OK) {
-            telem_collect_enable();
-            return CMD_SYS_ERR_INVALID_ARGS;
-        }
+        while (chunk_left > 0) {
+            if (!seg_loaded) {
+                fs_entry_info_t info;
 
-        if (fs_read(&file, read_buf, bytes_to_read) != FS_OK) {
-            telem_collect_enable();
-            return CMD_SYS_ERR_INVALID_ARGS;
+                telem_store_segment_name(priority, seq, head, filename);
+                fs_err_t fs_err = fs_stat(filename, &info, 1000);
+
+                if ((fs_err != FS_OK) && (fs_err != FS_NOENT_ERR)) {
+                    telem_collect_enable();
+                    return CMD_SYS_ERR_INVALID_ARGS;
+                }
+
+                seg_end = (fs_err == FS_OK) ? info.size : 0U;
+                seg_loaded = true;
+            }
+
+            if (seg_end == 0) {
+                // The sizes add up to read_size, so the data can't run out before the tail segment
+                if (seq == tail) {
+                    telem_collect_enable();
+                    return CMD_SYS_ERR_INVALID_ARGS;
+                }
+
+                seq--;
+                seg_loaded = false;
+                continue;
+            }
+
+            uint32_t bytes_to_read = MIN(chunk_left, seg_end);
+            uint32_t bytes_read = 0;
+
+            if ((fs_read_at(filename, seg_end - bytes_to_read, &read_buf[chunk_left - bytes_to_read], bytes_to_read, &bytes_read, 1000) != FS_OK) ||
+                    (bytes_read != bytes_to_read)) {
+                telem_collect_enable();
+                return CMD_SYS_ERR_INVALID_ARGS;
+            }
+
+            seg_end    -= bytes_to_read;
+            chunk_left -= bytes_to_read;
         }
 
-        uint32_t bytes_written = io_stream_write(cmd->output, read_buf, bytes_to_read, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
+        uint32_t bytes_written = io_stream_write(cmd->output, read_buf, chunk_len, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL);
 
-        if (bytes_written != bytes_to_read) {
-            fs_close(&file);
+        if (bytes_written != chunk_len) {
             telem_collect_enable();
             return CMD_SYS_ERR_WRITE_TIMEOUT;
         }
 
-        if (fs_seek(&file, -bytes_to_read, FS_SEEK_CUR) != FS_OK) {
+        bytes_left -= chunk_len;
+
+        cmd_sys_exec_pet();
+
+        // Nothing is dropped, the data will be read again
+        if (cmd_sys_exec_cancelled(cmd)) {
             telem_collect_enable();
-            return CMD_SYS_ERR_INVALID_ARGS;
+            return CMD_SYS_ERR_EXEC_CANCELLED;
         }
+    }
+
+    // Truncate what was read
+    if (telem_drop_newest(priority, read_size, 1000) != TELEM_SUCCESS) {
+        LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_FLASH_WRITE);
+    }
 
-        bytes_left -= bytes_to_read;
+    telem_collect_enable();
+
+    return cmd_sys_finish_response(cmd);
+}
+
+cmd_sys_err_t cmd_impl_GET_TELEMETRY_RANGE(const cmd_sys_cmd_t *cmd, cmd_GET_TELEMETRY_RANGE_args_t *args) {
+    telem_query_t query = {
+        .epoch_start = (epoch_t) args->epoch_start,
+        .epoch_end   = (epoch_t) args->epoch_end,
+        .mode        = (telem_query_mode_t) args->mode,
+        .step        = args->step,
+        .num_units   = args->num_units,
+    };
 
-        obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_EXEC);
+    if ((args->num_units > TELEM_QUERY_MAX_UNITS) || (args->mode > TELEM_QUERY_MODE_WINDOW)) {
+        return CMD_SYS_ERR_INVALID_ARGS;
     }
 
-    // Truncate what was read
-    int32_t new_file_size = file_size - MIN(args->size, file_size);
-    fs_truncate(&file, new_file_size);
+    for (uint8_t u = 0; u < args->num_units; u++) {
+        query.telem_ids[u] = (telem_id_t) args->telem_ids[u];
+    }
+
+    // Telemetry collection is disabled so that the telem files don't change between the two runs of the query
+    telem_collect_disable();
+
+    telem_err_t telem_err = telem_query_begin(&query, args->size, TELEM_RANGE_QUERY_TIMEOUT_MS);
+
+    if (telem_err != TELEM_SUCCESS) {
+        telem_collect_enable();
+        return ((telem_err == TELEM_ERR_DNE) || (telem_err == TELEM_ERR_DATA_FMT)) ? CMD_SYS_ERR_INVALID_ARGS : CMD_SYS_ERR_INVALID_STATE;
+    }
+
+    cmd_sys_exec_pet();
+
+    cmd_sys_err_t err = cmd_sys_begin_response(cmd, CMD_SYS_RESP_CODE_SUCCESS, query.size);
+
+    if (err != CMD_SYS_SUCCESS) {
+        telem_collect_enable();
+        return err;
+    }
+
+    // The query writes one record at a time, buffer them into larger writes
+    io_ostream_t cmd_output = {
+        .handle = (void *)cmd,
+        .write  = &cmd_output_write,
+        .flush  = NULL,
+    };
+    uint8_t output_buf[TELEM_RANGE_OUTPUT_BUF_SIZE];
+    buffered_output_t buffered_output = {
+        .size   = sizeof(output_buf),
+        .buf    = output_buf,
+        .output = &cmd_output,
+
+        .offset = 0,
+    };
+    io_ostream_t output = {
+        .handle = &buffered_output,
+        .write  = &buffered_io_write,
+        .flush  = &buffered_io_flush,
+    };
+
+    // Always writes query.size bytes unless the output times out, the end is padded if the result came out shorter
+    telem_err = telem_query_read(&query, &output, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), TELEM_RANGE_QUERY_TIMEOUT_MS);
 
-    fs_close(&file);
     telem_collect_enable();
 
+    if (telem_err != TELEM_SUCCESS) {
+        return CMD_SYS_ERR_WRITE_TIMEOUT;
+    }
+
+    if (!io_stream_flush(&output, pdMS_TO_TICKS(CMD_SYS_OUTPUT_WRITE_TIMEOUT_MS), NULL)) {
+        return CMD_SYS_ERR_WRITE_TIMEOUT;
+    }
+
+    cmd_sys_exec_pet();
+
     return cmd_sys_finish_response(cmd);
 }
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief io_ostream_t compatible API to write to the output of a command.
+ *
+ * The handle is the command. Its output is looked up on every write since it's replaced when the command
+ * is cancelled (see cmd_sys_exec_cancel).
+ *
+ * See io_ostream_t in io_stream.h for details.
+ */
+static uint32_t cmd_output_write(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
+    const cmd_sys_cmd_t *cmd = (const cmd_sys_cmd_t *)handle;
+    return io_stream_write(cmd->output, data, num_bytes, timeout, timeout_left);
+}
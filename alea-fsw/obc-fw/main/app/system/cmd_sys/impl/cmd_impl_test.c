@@ -9,6 +9,7 @@
 
 #include "cmd_sys_gen.h"
 #include "cmd_sys.h"
+#include "cmd_sys_exec.h"
 
 // OBC
 #include "obc_filesystem.h"
@@ -26,7 +27,6 @@
 #include "io_stream.h"
 #include "obc_utils.h"
 #include "obc_rtos.h"
-#include "obc_watchdog.h"
 
 // TMS570
 #include "tms_can.h"
@@ -102,7 +102,7 @@ cmd_sys_resp_code_t cmd_impl_TEST_LARGE_PAYLOAD_SPLIT(const cmd_sys_cmd_t *cmd,
     uint32_t total_sum = 0;
 
     while (bytes_read != data_len) {
-        obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_EXEC);
+        cmd_sys_exec_pet();
         uint32_t bytes_read_now = io_stream_read(cmd->input, data, chunk_size, pdMS_TO_TICKS(CMD_SYS_INPUT_READ_TIMEOUT_MS), NULL);
 
         bytes_read += bytes_read_now;
@@ -139,7 +139,7 @@ cmd_sys_resp_code_t cmd_impl_TEST_LOG_2_FLASH(const cmd_sys_cmd_t *cmd, cmd_TEST
     for (uint32_t x = 0; x < num_logs; x++) {
         LOG_LOG_SYS__DUMMY(log_num++);
         vTaskDelay(pdMS_TO_TICKS(200));
-        obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_EXEC);
+        cmd_sys_exec_pet();
     }
 
     return CMD_SYS_RESP_CODE_SUCCESS;
@@ -331,7 +331,7 @@ cmd_sys_err_t cmd_impl_TEST_MRAM_READ(const cmd_sys_cmd_t *cmd, cmd_TEST_MRAM_RE
         bool done = false;
 
         while (!done) {
-            obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_EXEC);
+            cmd_sys_exec_pet();
 
             // Read buffer of image data from ArduCAM
             if (args->len > 0) {
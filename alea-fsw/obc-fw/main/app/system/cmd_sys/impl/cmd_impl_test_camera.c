@@ -9,6 +9,7 @@
 
 #include "cmd_sys_gen.h"
 #include "cmd_sys.h"
+#include "cmd_sys_exec.h"
 
 // Logger
 #include "logger.h"
@@ -17,9 +18,6 @@
 #include "cam_arducam.h"
 #include "cam_ov5642.h"
 
-// OBC
-#include "obc_watchdog.h"
-
 // Utils
 #include "io_stream.h"
 #include "data_fmt.h"
@@ -88,7 +86,11 @@ cmd_sys_err_t cmd_impl_TEST_CAM_CAPTURE(const cmd_sys_cmd_t *cmd, cmd_TEST_CAM_C
         bool done = false;
 
         while (!done) {
-            obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_EXEC);
+            cmd_sys_exec_pet();
+
+            if (cmd_sys_exec_cancelled(cmd)) {
+                break;
+            }
 
             // Read buffer of image data from ArduCAM
             uint32_t data_len = 0;
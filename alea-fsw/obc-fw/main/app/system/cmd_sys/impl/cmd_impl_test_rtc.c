@@ -9,12 +9,12 @@
 
 #include "cmd_sys_gen.h"
 #include "cmd_sys.h"
+#include "cmd_sys_exec.h"
 
 // OBC
 #include "pca2129_rtc.h"
 #include "obc_rtc.h"
 #include "logger.h"
-#include "obc_watchdog.h"
 
 // TMS570
 #include "tms_mibspi.h"
@@ -203,6 +203,6 @@ static void alarm_isr(void *args) {
 static void delay_seconds_watchdog_friendly(uint8_t n) {
     for (uint8_t i = 0; i < n; i++) {
         vTaskDelay(pdMS_TO_TICKS(1000));
-        obc_watchdog_pet(OBC_TASK_ID_CMD_SYS_EXEC);
+        cmd_sys_exec_pet();
     }
 }
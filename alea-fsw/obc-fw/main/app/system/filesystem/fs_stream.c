@@ -0,0 +1,119 @@
+/**
+ * @file fs_stream.c
+ * @brief io_stream wrappers to read and write files
+ *
+ * The file is opened and closed around every read or write, so the filesystem mutex is never held
+ * while the other end of the stream is waited on (e.g. a command still being received). This makes
+ * each write an LFS append, so writes should be as large as the caller's buffer allows.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "fs_stream.h"
+
+// OBC
+#include "obc_filesystem.h"
+#include "obc_error.h"
+#include "obc_utils.h"
+
+// Utils
+#include "rtos_stream.h"
+
+// FreeRTOS
+#include "rtos.h"
+
+// Third-Party
+#include "lfs.h"
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static uint16_t mutex_timeout_ms(uint32_t timeout);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief io_istream_t compatible API to read from a file.
+ *
+ * The handle must be of type fs_istream_t. Fewer bytes than requested are returned at the end of the
+ * data or if the file cannot be read.
+ *
+ * See io_istream_t in io_stream.h for details.
+ */
+uint32_t fs_stream_read(void *handle, uint8_t *buf, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
+    fs_istream_t *stream = (fs_istream_t *)handle;
+    uint32_t start = xTaskGetTickCount();
+    uint32_t bytes_read = 0;
+
+    uint32_t len = (stream->offset < stream->end) ? MIN(num_bytes, (stream->end - stream->offset)) : 0U;
+
+    if (len > 0) {
+        if (fs_read_at(stream->filename, stream->offset, buf, len, &bytes_read, mutex_timeout_ms(timeout)) != FS_OK) {
+            bytes_read = 0;
+        }
+
+        stream->offset += bytes_read;
+    }
+
+    rtos_stream_handle_timeout(start, timeout, timeout_left);
+
+    return bytes_read;
+}
+
+/**
+ * @brief io_ostream_t compatible API to append to a file.
+ *
+ * The handle must be of type fs_ostream_t. The file is created if it doesn't exist.
+ *
+ * See io_ostream_t in io_stream.h for details.
+ */
+uint32_t fs_stream_write(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left) {
+    fs_ostream_t *stream = (fs_ostream_t *)handle;
+    uint32_t start = xTaskGetTickCount();
+    lfs_file_t file;
+
+    // fs_seek and fs_write close the file if they fail
+    fs_err_t err = fs_open(&file, stream->filename, mutex_timeout_ms(timeout));
+
+    if (err == FS_OK) {
+        err = fs_seek(&file, 0, FS_SEEK_END);
+    }
+
+    if (err == FS_OK) {
+        err = fs_write(&file, data, num_bytes);
+    }
+
+    if (err == FS_OK) {
+        err = fs_close(&file);
+    }
+
+    rtos_stream_handle_timeout(start, timeout, timeout_left);
+
+    if (err != FS_OK) {
+        return 0;
+    }
+
+    stream->size += num_bytes;
+
+    return num_bytes;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Convert a stream timeout (ticks) to a filesystem mutex timeout (ms), saturating at the largest timeout
+ */
+static uint16_t mutex_timeout_ms(uint32_t timeout) {
+    if (timeout >= (UINT16_MAX / portTICK_PERIOD_MS)) {
+        return UINT16_MAX;
+    }
+
+    return (uint16_t)(timeout * portTICK_PERIOD_MS);
+}
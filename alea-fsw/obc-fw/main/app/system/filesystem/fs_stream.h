@@ -0,0 +1,44 @@
+/**
+ * @file fs_stream.h
+ * @brief io_stream wrappers to read and write files
+ */
+
+#ifndef FS_STREAM_H_
+#define FS_STREAM_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// Standard Library
+#include <stdint.h>
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Handle of an io_istream_t reading a file from offset until end
+ */
+typedef struct {
+    const char *filename;
+    uint32_t offset;        // Position of the next byte to read, advanced by each read
+    uint32_t end;           // Reads stop at this position (e.g. the size of the file)
+} fs_istream_t;
+
+/**
+ * @brief Handle of an io_ostream_t appending to a file
+ */
+typedef struct {
+    const char *filename;
+    uint32_t size;          // Number of bytes appended so far
+} fs_ostream_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+uint32_t fs_stream_read(void *handle, uint8_t *buf, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
+uint32_t fs_stream_write(void *handle, const uint8_t *data, uint32_t num_bytes, uint32_t timeout, uint32_t *timeout_left);
+
+#endif // FS_STREAM_H_
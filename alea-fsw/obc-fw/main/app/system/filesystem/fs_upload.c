@@ -0,0 +1,332 @@
+/**
+ * @file fs_upload.c
+ * @brief Upload of large files to the filesystem over multiple commands
+ *
+ * An upload session is started with the destination path, the size and the CRC32 of the file. The
+ * data is then written in any order, possibly over many passes, directly to a temporary file so it
+ * never has to be held in RAM. Received data is tracked per FS_UPLOAD_BLOCK_SIZE block in a bitmap
+ * that the ground can retrieve to find what is still missing. Once every block has been received,
+ * the temporary file is checked against the CRC and renamed to the destination, which atomically
+ * replaces any existing file.
+ *
+ * Only one upload can be in progress at a time. The session is kept in RAM, so an upload must be
+ * restarted after a reset.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "fs_upload.h"
+
+// OBC
+#include "obc_filesystem.h"
+#include "obc_error.h"
+#include "obc_crc.h"
+#include "obc_utils.h"
+
+// FreeRTOS
+#include "rtos.h"
+
+// Third-Party
+#include "lfs.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define FS_UPLOAD_MUTEX_TIMEOUT_MS  1000U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef struct {
+    fs_upload_status_t status;
+    uint8_t bitmap[FS_UPLOAD_BITMAP_SIZE];  // Bit (i % 8) of byte (i / 8) is set once block i has been written
+
+    uint32_t verify_offset;                 // Amount of the temporary file checked by fs_upload_finish_step
+    uint32_t verify_crc;                    // CRC32 of the data checked so far (not yet inverted)
+} fs_upload_session_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static void session_reset(void);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static fs_upload_session_t session = { 0 };
+
+static uint8_t verify_buf[FS_UPLOAD_BLOCK_SIZE];
+
+/* Mutex is taken by every public function, before the filesystem mutex */
+static SemaphoreHandle_t xUploadMutex;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Create FreeRTOS infrastructure needed by this module
+ */
+void fs_upload_pre_init(void) {
+    static StaticSemaphore_t xUploadMutexBuffer;
+
+    xUploadMutex = xSemaphoreCreateMutexStatic(&xUploadMutexBuffer);
+}
+
+/**
+ * @brief Start an upload session, or resume the current one
+ *
+ * If an upload of the same path, size and CRC is already in progress it is kept, so the ground can
+ * safely repeat this at the start of every pass. Otherwise the current upload (if any) is discarded.
+ *
+ * @param[in]  path     Where the file will be stored once it has been verified
+ * @param[in]  size     Size of the file in bytes
+ * @param[in]  crc      CRC32 of the whole file
+ * @param[out] resumed  Set if the upload in progress was kept
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_upload_begin(const char *path, uint32_t size, uint32_t crc, bool *resumed) {
+    uint32_t path_len = strlen(path);
+
+    *resumed = false;
+
+    if (path_len >= FS_PATH_MAX_SIZE) {
+        return FS_NAMETOOLONG_ERR;
+    }
+
+    if ((path_len == 0) || (strcmp(path, FS_UPLOAD_TMP_FILENAME) == 0) || (size == 0)) {
+        return FS_INVAL_ERR;
+    }
+
+    if (size > FS_UPLOAD_MAX_SIZE) {
+        return FS_FBIG_ERR;
+    }
+
+    if (xSemaphoreTake(xUploadMutex, pdMS_TO_TICKS(FS_UPLOAD_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return FS_MUTEX_TIMEOUT;
+    }
+
+    fs_err_t err = FS_OK;
+
+    if (session.status.active && (session.status.size == size) && (session.status.crc == crc) && (strcmp(session.status.path, path) == 0)) {
+        session.verify_offset = 0;
+        *resumed = true;
+    } else {
+        session_reset();
+
+        // Discard the data of a previous upload (possibly from before a reset)
+        err = fs_remove(FS_UPLOAD_TMP_FILENAME, FS_UPLOAD_MUTEX_TIMEOUT_MS);
+
+        if ((err == FS_OK) || (err == FS_NOENT_ERR)) {
+            err = FS_OK;
+
+            session.status.active       = true;
+            session.status.size         = size;
+            session.status.crc          = crc;
+            session.status.blocks_total = (uint16_t) ((size + FS_UPLOAD_BLOCK_SIZE - 1U) / FS_UPLOAD_BLOCK_SIZE);
+            strcpy(session.status.path, path);
+        }
+    }
+
+    xSemaphoreGive(xUploadMutex);
+    return err;
+}
+
+/**
+ * @brief Write data of the file being uploaded
+ *
+ * Blocks may be written in any order and more than once. Writing past the end of the data received
+ * so far is cheapest, filling in a gap costs LFS a copy of the rest of the file.
+ *
+ * @param[in] offset    Position of the data in the file. Must be a multiple of FS_UPLOAD_BLOCK_SIZE.
+ * @param[in] data      Pointer to the data
+ * @param[in] len       Size of the data. Must be a multiple of FS_UPLOAD_BLOCK_SIZE unless the data
+ *                      ends at the end of the file.
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_upload_write(uint32_t offset, const uint8_t *data, uint32_t len) {
+    lfs_file_t file;
+
+    if (xSemaphoreTake(xUploadMutex, pdMS_TO_TICKS(FS_UPLOAD_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return FS_MUTEX_TIMEOUT;
+    }
+
+    fs_err_t err = FS_OK;
+    uint32_t end = offset + len;
+
+    if (!session.status.active) {
+        err = FS_UPLOAD_INACTIVE_ERR;
+    } else if ((len == 0) || ((offset % FS_UPLOAD_BLOCK_SIZE) != 0) || (offset > session.status.size) ||
+               (len > (session.status.size - offset)) || (((end % FS_UPLOAD_BLOCK_SIZE) != 0) && (end != session.status.size))) {
+        err = FS_INVAL_ERR;
+    } else {
+        // fs_seek and fs_write close the file if they fail
+        err = fs_open(&file, FS_UPLOAD_TMP_FILENAME, FS_UPLOAD_MUTEX_TIMEOUT_MS);
+
+        if (err == FS_OK) {
+            err = fs_seek(&file, (int32_t) offset, FS_SEEK_START);
+        }
+
+        if (err == FS_OK) {
+            err = fs_write(&file, data, len);
+        }
+
+        if (err == FS_OK) {
+            err = fs_close(&file);
+        }
+    }
+
+    if (err == FS_OK) {
+        for (uint32_t block = offset / FS_UPLOAD_BLOCK_SIZE; block < ((end + FS_UPLOAD_BLOCK_SIZE - 1U) / FS_UPLOAD_BLOCK_SIZE); block++) {
+            uint8_t mask = (uint8_t) (1U << (block % 8U));
+
+            if ((session.bitmap[block / 8U] & mask) == 0) {
+                session.bitmap[block / 8U] |= mask;
+                session.status.blocks_received++;
+            }
+        }
+
+        // The data already checked by fs_upload_finish_step may have changed
+        session.verify_offset = 0;
+    }
+
+    xSemaphoreGive(xUploadMutex);
+    return err;
+}
+
+/**
+ * @brief Check the next block of the uploaded file and commit it once it has all been checked
+ *
+ * Must be called repeatedly until done is set or an error is returned. Checking the file in steps
+ * lets the caller pet its watchdog, reading a large file can take longer than the watchdog period.
+ *
+ * When the CRC of the whole file matches, the file is renamed to its destination and the session
+ * ends. If it doesn't match, FS_UPLOAD_CRC_ERR is returned and the session is kept so the corrupt
+ * blocks can be found (e.g. by reading the temporary file back) and written again.
+ *
+ * @param[out] crc  CRC32 of the uploaded file (only valid once done is set)
+ * @param[out] done Set once the whole file has been checked
+ *
+ * @return FS_OK if successful, FS_UPLOAD_INCOMPLETE_ERR if blocks are missing,
+ *         FS_UPLOAD_CRC_ERR if the CRC doesn't match, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_upload_finish_step(uint32_t *crc, bool *done) {
+    *done = false;
+
+    if (xSemaphoreTake(xUploadMutex, pdMS_TO_TICKS(FS_UPLOAD_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return FS_MUTEX_TIMEOUT;
+    }
+
+    fs_err_t err = FS_OK;
+
+    if (!session.status.active) {
+        err = FS_UPLOAD_INACTIVE_ERR;
+    } else if (session.status.blocks_received != session.status.blocks_total) {
+        err = FS_UPLOAD_INCOMPLETE_ERR;
+    } else {
+        if (session.verify_offset == 0) {
+            session.verify_crc = CRC32_SEED;
+        }
+
+        uint32_t len = MIN(FS_UPLOAD_BLOCK_SIZE, (session.status.size - session.verify_offset));
+        uint32_t bytes_read = 0;
+
+        err = fs_read_at(FS_UPLOAD_TMP_FILENAME, session.verify_offset, verify_buf, len, &bytes_read, FS_UPLOAD_MUTEX_TIMEOUT_MS);
+
+        if ((err == FS_OK) && (bytes_read != len)) {
+            err = FS_READ_FAILURE_ERR;
+        }
+
+        if (err == FS_OK) {
+            // crc_32_buf returns the inverted CRC, invert it back to continue it with the next block
+            session.verify_crc = ~crc_32_buf(session.verify_crc, verify_buf, len);
+            session.verify_offset += len;
+
+            if (session.verify_offset == session.status.size) {
+                *crc = ~session.verify_crc;
+                *done = true;
+                session.verify_offset = 0;
+
+                if (*crc != session.status.crc) {
+                    err = FS_UPLOAD_CRC_ERR;
+                } else {
+                    err = fs_rename(FS_UPLOAD_TMP_FILENAME, session.status.path, FS_UPLOAD_MUTEX_TIMEOUT_MS);
+
+                    if (err == FS_OK) {
+                        session_reset();
+                    }
+                }
+            }
+        } else {
+            session.verify_offset = 0;
+        }
+    }
+
+    xSemaphoreGive(xUploadMutex);
+    return err;
+}
+
+/**
+ * @brief End the upload session and delete the data received so far
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_upload_abort(void) {
+    if (xSemaphoreTake(xUploadMutex, pdMS_TO_TICKS(FS_UPLOAD_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return FS_MUTEX_TIMEOUT;
+    }
+
+    session_reset();
+
+    fs_err_t err = fs_remove(FS_UPLOAD_TMP_FILENAME, FS_UPLOAD_MUTEX_TIMEOUT_MS);
+
+    xSemaphoreGive(xUploadMutex);
+    return (err == FS_NOENT_ERR) ? FS_OK : err;
+}
+
+/**
+ * @brief Get the state of the upload session and the bitmap of received blocks
+ *
+ * @param[out] status       State of the session
+ * @param[out] bitmap       Buffer to copy the bitmap of received blocks to (see fs_upload_session_t).
+ *                          Can be NULL. Only the first (blocks_total + 7) / 8 bytes are meaningful.
+ * @param[in]  bitmap_size  Size of the bitmap buffer
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_upload_get_status(fs_upload_status_t *status, uint8_t *bitmap, uint32_t bitmap_size) {
+    if (xSemaphoreTake(xUploadMutex, pdMS_TO_TICKS(FS_UPLOAD_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return FS_MUTEX_TIMEOUT;
+    }
+
+    *status = session.status;
+
+    if (bitmap != NULL) {
+        memcpy(bitmap, session.bitmap, MIN(bitmap_size, sizeof(session.bitmap)));
+    }
+
+    xSemaphoreGive(xUploadMutex);
+    return FS_OK;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Clears the session. Must be called with xUploadMutex held.
+ */
+static void session_reset(void) {
+    memset(&session, 0, sizeof(session));
+}
@@ -0,0 +1,73 @@
+/**
+ * @file fs_upload.h
+ * @brief Upload of large files to the filesystem over multiple commands
+ */
+
+#ifndef FS_UPLOAD_H_
+#define FS_UPLOAD_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// OBC
+#include "obc_error.h"
+#include "obc_filesystem.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/**
+ * @brief Granularity at which received data is tracked. Writes must start on a block boundary and
+ * cover whole blocks, except for the last block of the file.
+ */
+#define FS_UPLOAD_BLOCK_SIZE        1024U
+
+/**
+ * @brief Largest file that can be uploaded
+ */
+#define FS_UPLOAD_MAX_SIZE          (4U * 1024U * 1024U)
+
+#define FS_UPLOAD_MAX_BLOCKS        (FS_UPLOAD_MAX_SIZE / FS_UPLOAD_BLOCK_SIZE)
+#define FS_UPLOAD_BITMAP_SIZE       (FS_UPLOAD_MAX_BLOCKS / 8U)
+
+/**
+ * @brief File the upload is written to until it is verified and renamed to its destination
+ */
+#define FS_UPLOAD_TMP_FILENAME      "upload.tmp"
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief State of the upload session
+ */
+typedef struct {
+    bool active;                // An upload is in progress
+    uint32_t size;              // Size of the file being uploaded
+    uint32_t crc;               // Expected CRC32 of the whole file
+    uint16_t blocks_total;      // Number of FS_UPLOAD_BLOCK_SIZE blocks in the file
+    uint16_t blocks_received;   // Number of blocks written so far
+    char path[FS_PATH_MAX_SIZE];
+} fs_upload_status_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void fs_upload_pre_init(void);
+
+fs_err_t fs_upload_begin(const char *path, uint32_t size, uint32_t crc, bool *resumed);
+fs_err_t fs_upload_write(uint32_t offset, const uint8_t *data, uint32_t len);
+fs_err_t fs_upload_finish_step(uint32_t *crc, bool *done);
+fs_err_t fs_upload_abort(void);
+
+fs_err_t fs_upload_get_status(fs_upload_status_t *status, uint8_t *bitmap, uint32_t bitmap_size);
+
+#endif /* FS_UPLOAD_H_ */
@@ -15,6 +15,7 @@
 #include "obc_flash.h"
 #include "obc_rtos.h"
 #include "obc_watchdog.h"
+#include "obc_utils.h"
 #include "logger.h"
 
 // FreeRTOS
@@ -30,11 +31,15 @@
 /*                               D E F I N E S                                */
 /******************************************************************************/
 
-/* Size of read/program operations handed to our flash driver by LFS */
-#define READ_PROG_SIZE  64
+/* Size of read operations handed to our flash driver by LFS */
+#define READ_SIZE       256
 
-/* Size of the static cache used by LFS */
-#define CACHE_SIZE      64
+/* Size of program operations handed to our flash driver by LFS (one MT25QL page) */
+#define PROG_SIZE       256
+
+/* Size of the static cache used by LFS. Must be a multiple of READ_SIZE and PROG_SIZE
+   and a factor of the block size */
+#define CACHE_SIZE      512
 
 /* Number of erase cycles performed before LFS moves metadata pairs for wear leveling
 
@@ -53,38 +58,150 @@
 #define MAX_FILE_SIZE_BYTES 8*1024*1024
 
 /* Max filename size in chars */
-#define FILENAME_MAX_SIZE   20U
+#define FILENAME_MAX_SIZE   FS_HANDLE_NAME_MAX_SIZE
+
+/* Masks used to index the write ring with its free-running positions */
+#define WRITE_RING_DATA_MASK    (FS_WRITE_RING_SIZE - 1U)
+#define WRITE_RING_REC_MASK     (FS_WRITE_RING_RECORDS - 1U)
+
+/* A flush is requested once this much of the write ring is in use */
+#define WRITE_RING_FLUSH_BYTES      (FS_WRITE_RING_SIZE / 2U)
+#define WRITE_RING_FLUSH_RECORDS    (FS_WRITE_RING_RECORDS / 2U)
+
+/* Marks the end of a chain of extents */
+#define WRITE_RING_NO_REC       0xFFU
 
-/* Size of the write cache buffer */
-#define WRITE_CACHE_SIZE    1024
+/* Number of files kept open by the flush between flushes */
+#define FILE_CACHE_SLOTS    4U
 
-/* Size of the write operations queue */
-#define WRITE_QUEUE_SIZE    15U
+/* How often files kept open by the flush are synced to flash
+ * Must be a multiple of FS_POLL_PERIOD_MS */
+#define FS_SYNC_PERIOD_MS   60000U
 
 /* How often task checks for flush conditions */
 #define FS_POLL_PERIOD_MS   2000U
 
-/* Max number of seconds to wait for write_cache to meet threshold before triggering a flush anyway
+/* Max number of ms to wait for the write ring to meet its threshold before triggering a flush anyway
  * Must be a multiple of FS_POLL_PERIOD_MS */
 #define FS_MAX_FLUSH_WAIT   600000U
 
+/* How long the scrubber waits after finishing a pass over the flash before starting the next one
+ * Must be a multiple of FS_POLL_PERIOD_MS */
+#define FS_SCRUB_PERIOD_MS  600000U
+
+/* Max number of erases issued by one step of the scrubber (one step runs per poll period) */
+#define SCRUB_ERASES_PER_STEP   4U
+
+/* Number of LFS blocks in the larger erase sizes of the flash */
+#define SCRUB_BLOCKS_32K    (32768U / EXT_FLASH_BLOCK_SIZE)
+#define SCRUB_BLOCKS_64K    (65536U / EXT_FLASH_BLOCK_SIZE)
+
+/* Microsecond clock used to time flushes and syncs. Can be overridden with a compile definition (e.g. by host builds) */
+#ifndef FS_TIME_US
+#define FS_TIME_US()        SYSTEM_TIME_US()
+#endif
+
+/* Once an operation has run for more than this many ticks, its duration is measured in ticks
+ * rather than with the microsecond clock (which wraps) */
+#define FS_FINE_TIMING_MAX_TICKS    2U
+
+/* Number of words in a bitmap with one bit per LFS block */
+#define BLOCK_BITMAP_WORDS  ((EXT_FLASH_BLOCK_COUNT + 31U) / 32U)
+
 /******************************************************************************/
 /*                              T Y P E D E F S                               */
 /******************************************************************************/
 
+typedef enum {
+    WRITE_REC_RESERVED = 0, // Space is reserved and the producer is copying in the data
+    WRITE_REC_READY    = 1, // Data is ready to be flushed
+    WRITE_REC_FLUSHED  = 2, // Data has been written to flash and the space can be released
+} write_rec_state_t;
+
+/**
+ * @brief One write waiting in the write ring.
+ *
+ * The data of a record is stored contiguously in the ring's data buffer. The extent
+ * fields are only used by the flush.
+ */
+typedef struct {
+    uint32_t            start;          // Free-running position of the data in the data buffer
+    uint16_t            size;           // Size of the data in bytes
+    fs_handle_t         handle;         // File to append the data to
+    volatile uint8_t    state;          // See write_rec_state_t
+    uint16_t            extent_size;    // Size of the extent starting at this record (0 if merged into a previous extent)
+    uint8_t             next;           // Next extent of the same file
+} fs_write_rec_t;
+
+/**
+ * @brief Multi-producer, single-consumer append ring.
+ *
+ * Producers reserve space for a record in a short critical section and then copy their
+ * data in outside of it, so they never wait for each other or for a flush. The flush
+ * (the only consumer) runs with xFileSystemMutex held.
+ *
+ * All positions are free-running counters, masked to index the buffers.
+ */
+typedef struct {
+    uint8_t         data[FS_WRITE_RING_SIZE];
+    fs_write_rec_t  recs[FS_WRITE_RING_RECORDS];
+
+    uint32_t        data_head;  // Next free position in data
+    uint32_t        data_tail;  // Oldest position in data that has not been released
+    uint32_t        rec_head;   // Next free record
+    uint32_t        rec_tail;   // Oldest record that has not been released
+
+    bool            flush_requested;
+} fs_write_ring_t;
+
+/**
+ * @brief How far the data written to a write ring handle has made it to flash.
+ *
+ * Free-running byte counts of the handle, never reset. Flushed bytes are only counted once the
+ * records they belong to have been fully written to the file, so records retried after a failed
+ * flush are counted once.
+ */
+typedef struct {
+    uint32_t enqueued;      // Accepted by the write ring
+    uint32_t flushed;       // Written to the file by flushes
+    uint32_t committed;     // Flushed bytes committed to flash by a sync or close of the file
+} fs_commit_progress_t;
+
+/**
+ * @brief A file kept open by the flush.
+ *
+ * Keeping the hot append-only files open avoids a directory lookup on every flush and lets LFS
+ * commit their metadata only at sync points instead of on every close.
+ */
 typedef struct {
-    size_t      size; // Size of write request in bytes
-    uint16_t    offset; // Offset of data relative to write_cache->buf
-    char        filename[FILENAME_MAX_SIZE];
-    bool        flushed; // True if contents have been writted to flash
-} fs_write_request_t;
+    lfs_file_t          file;
+    struct lfs_file_config cfg;     // Points to this slot's cache buffer
+    uint32_t            last_used;  // Value of file_cache_clock when last used
+    fs_handle_t         handle;     // Write ring handle of the file
+    bool                open;
+    bool                dirty;      // Written since the last sync
+} fs_cached_file_t;
 
+/**
+ * @brief State of the scrubber, which pre-erases free blocks so that bd_erase rarely has to.
+ *
+ * Invariants (both bitmaps are only modified with xFileSystemMutex held):
+ *  - A block marked in erased has been erased and not programmed since.
+ *  - While used_valid is set, used contains every block LFS is using: it is filled by a traversal
+ *    of the filesystem and every block LFS erases or programs afterwards is added to it (LFS always
+ *    erases a block before it starts using it). Blocks freed since the traversal stay marked, so
+ *    the scrubber never erases a block that may hold data.
+ */
 typedef struct {
-    uint8_t             buf[WRITE_CACHE_SIZE];
-    fs_write_request_t  queue[WRITE_QUEUE_SIZE];
-    uint8_t             *head; // Pointer to head of buf
-    uint8_t             q_next_index; // Index of empty slot in queue
-} fs_write_cache_t;
+    uint32_t    erased[BLOCK_BITMAP_WORDS]; // Blocks known to be erased
+    uint32_t    used[BLOCK_BITMAP_WORDS];   // Blocks that may be in use by LFS
+    uint32_t    cursor;                     // Next block to look at in the current pass
+    bool        used_valid;                 // Cleared to start a new pass with a new traversal
+    bool        mounted;                    // The filesystem is mounted, so it can be traversed
+} fs_scrub_t;
+
+CASSERT(((FS_WRITE_RING_SIZE & (FS_WRITE_RING_SIZE - 1U)) == 0) && (FS_WRITE_RING_SIZE <= 32768U), fs_write_ring_size);
+CASSERT(((FS_WRITE_RING_RECORDS & (FS_WRITE_RING_RECORDS - 1U)) == 0) && (FS_WRITE_RING_RECORDS < WRITE_RING_NO_REC), fs_write_ring_records);
 
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
@@ -95,6 +212,29 @@ static void filesystem_task(void *pvParameters);
 // This guard is here to stop the compiler complaining about unused declarations
 #if FEATURE_FLASH_FS
 static fs_err_t fs_flush_all(void);
+static fs_err_t fs_flush_file(fs_handle_t handle, uint8_t first_rec);
+
+static fs_err_t file_cache_get(fs_handle_t handle, fs_cached_file_t **cached);
+static fs_err_t file_cache_close(fs_cached_file_t *cached);
+static fs_err_t file_cache_close_all(void);
+static fs_err_t file_cache_evict(const char *filename);
+static fs_cached_file_t *file_cache_find(const char *filename);
+static fs_err_t file_cache_sync_all(void);
+
+static void entry_info_copy(fs_entry_info_t *info, const struct lfs_info *lfs_info);
+static int32_t fs_read_file_at(lfs_file_t *file, uint32_t offset, uint8_t *buf, uint32_t size, uint32_t *bytes_read);
+
+static bool scrub_step(void);
+static int scrub_mark_used(void *data, lfs_block_t block);
+static uint32_t scrub_run_blocks(uint32_t block);
+static void scrub_reset(bool mounted);
+
+static uint32_t fs_elapsed_us(TickType_t start_ticks, uint32_t start_us);
+static void fs_record_latency(fs_latency_stats_t *stats, TickType_t start_ticks, uint32_t start_us);
+
+static bool block_bitmap_get(const uint32_t *bitmap, uint32_t block);
+static void block_bitmap_set(uint32_t *bitmap, uint32_t block, uint32_t count);
+static void block_bitmap_clear(uint32_t *bitmap, uint32_t block, uint32_t count);
 
 static int32_t bd_read(const struct lfs_config *cnfg, lfs_block_t block, lfs_off_t off_bytes, void *buffer, lfs_size_t size_bytes);
 static int32_t bd_prog(const struct lfs_config *cnfg, lfs_block_t block, lfs_off_t off_bytes, const void *buffer, lfs_size_t size_bytes);
@@ -122,8 +262,8 @@ static const struct lfs_config cfg = {
     .sync = &bd_sync,
 
     // block device configuration
-    .read_size = READ_PROG_SIZE,
-    .prog_size = READ_PROG_SIZE,
+    .read_size = READ_SIZE,
+    .prog_size = PROG_SIZE,
     .block_size = EXT_FLASH_BLOCK_SIZE,
     .block_count = EXT_FLASH_BLOCK_COUNT,
     .cache_size = CACHE_SIZE,
@@ -144,27 +284,33 @@ static const struct lfs_file_config obc_file_cfg = {
     .buffer = lfs_file_buffer
 };
 
-// Double buffering system where if one buffer is full, we swap to the other one and trigger a flush
-static fs_write_cache_t write_cache0 = {
-    .head = write_cache0.buf,
-    .q_next_index = 0,
-};
+static fs_write_ring_t write_ring = { 0 };
 
-static fs_write_cache_t write_cache1 = {
-    .head = write_cache1.buf,
-    .q_next_index = 0,
-};
+static fs_write_stats_t write_stats = { 0 };
+
+/* Only updated with xFileSystemMutex held, except for the per-file enqueued and dropped counts */
+static fs_io_stats_t io_stats = { 0 };
+static fs_file_stats_t file_stats[FS_MAX_HANDLES] = { 0 };
+
+/* Only updated with xFileSystemMutex held (in a critical section), except for the enqueued counts */
+static fs_commit_progress_t commit_progress[FS_MAX_HANDLES] = { 0 };
 
-static bool flushing = false;
+/* Files kept open by the flush, replaced in least recently used order */
+static fs_cached_file_t file_cache[FILE_CACHE_SLOTS] = { 0 };
+static uint8_t file_cache_buffers[FILE_CACHE_SLOTS][CACHE_SIZE];
+static uint32_t file_cache_clock = 0;
 
-// The write_cache currently in use
-static fs_write_cache_t *active_write_cache = &write_cache0;
+static fs_scrub_t scrub = { 0 };
+
+/* Filenames of the write ring handles. Entries are only ever added. */
+static char handle_names[FS_MAX_HANDLES][FILENAME_MAX_SIZE];
+static volatile uint8_t handle_count = 0;
 
 /* Mutex is taken in fs_write(), fs_read() and when trying to flush */
 static SemaphoreHandle_t xFileSystemMutex;
 
-/* Mutex is taken in fs_write_enqueue() and fs_flush_all() */
-static SemaphoreHandle_t xWriteQueueMutex;
+/* Mutex is taken in fs_get_handle() when adding to the handle table */
+static SemaphoreHandle_t xHandleTableMutex;
 
 static TaskHandle_t fs_task_handle = NULL;
 #endif
@@ -179,9 +325,13 @@ static TaskHandle_t fs_task_handle = NULL;
 void filesystem_pre_init(void) {
 #if FEATURE_FLASH_FS
     static StaticSemaphore_t xFileSystemMutexBuffer;
-    static StaticSemaphore_t xWriteQueueMutexBuffer;
+    static StaticSemaphore_t xHandleTableMutexBuffer;
     xFileSystemMutex = xSemaphoreCreateMutexStatic(&xFileSystemMutexBuffer);
-    xWriteQueueMutex = xSemaphoreCreateMutexStatic(&xWriteQueueMutexBuffer);
+    xHandleTableMutex = xSemaphoreCreateMutexStatic(&xHandleTableMutexBuffer);
+
+    for (uint8_t i = 0; i < FILE_CACHE_SLOTS; i++) {
+        file_cache[i].cfg.buffer = file_cache_buffers[i];
+    }
 #endif
 }
 
@@ -198,6 +348,12 @@ void filesystem_post_init(void) {
 /*
  * @brief Public API to open a file
  *
+ * If the flush is keeping the file open, it is synced and closed first so that the caller sees all
+ * flushed data and the flush picks up any changes made by the caller.
+ *
+ * The filesystem is locked until the file is closed with fs_close(). If the file can't be opened,
+ * the lock is released before returning.
+ *
  * @param[in]  file             File handle address
  * @param[in]  filename         String
  * @param[in]  mutex_timeout    Timeout waiting for mutex access
@@ -208,7 +364,17 @@ fs_err_t fs_open(lfs_file_t *file, const char *filename, uint16_t mutex_timeout)
 #if FEATURE_FLASH_FS
 
     if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
-        return (fs_err_t) lfs_file_opencfg(&obc_lfs, file, filename, LFS_O_RDWR | LFS_O_CREAT, &obc_file_cfg);
+        // Sync failures are counted in the write ring statistics, the file is closed either way
+        file_cache_evict(filename);
+
+        fs_err_t err = (fs_err_t) lfs_file_opencfg(&obc_lfs, file, filename, LFS_O_RDWR | LFS_O_CREAT, &obc_file_cfg);
+
+        // Callers only close the file if it was opened
+        if (err != FS_OK) {
+            xSemaphoreGive(xFileSystemMutex);
+        }
+
+        return err;
     }
 
     return FS_MUTEX_TIMEOUT;
@@ -263,85 +429,140 @@ fs_err_t fs_write(lfs_file_t *file, const uint8_t *buf, size_t size) {
 }
 
 /*
- * @brief Public API to append to a file in flash by joining write queue
+ * @brief Public API to get the write ring handle of a file
  *
- * Data is copied into active_write_cache, after which function returns and caller is free to deallocate data. The data will be flushed to flash
- * whenever the filesystem task chooses (up till FS_MAX_FLUSH_WAIT seconds). There are 2 internal write cache buffers. When one is full, the other
- * is used and a flush is triggered.
+ * Filenames are interned the first time they are seen, so producers should get the handle of each
+ * file once and keep it rather than calling this before every write.
  *
- * @param[in]  buf              Pointer to the data
- * @param[in]  size             Size of the data
- * @param[in]  filename         Filename (string) to save to
- * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ * @param[in]  filename         Filename (string) to get the handle of
+ * @param[out] handle           Handle of the file
+ * @param[in]  mutex_timeout    Timeout to wait for the handle table mutex
  *
  * @return FS_OK if successful, error code otherwise (see obc_error.h)
  */
-fs_err_t fs_write_enqueue(const uint8_t *buf, size_t size, const char *filename, uint16_t mutex_timeout) {
+fs_err_t fs_get_handle(const char *filename, fs_handle_t *handle, uint16_t mutex_timeout) {
 #if FEATURE_FLASH_FS
 
-    if (size > WRITE_CACHE_SIZE) {
-        return FS_WRITE_TOO_BIG_ERR;
+    if (strlen(filename) >= FILENAME_MAX_SIZE) {
+        return FS_NAMETOOLONG_ERR;
     }
 
-    TickType_t total_ticks = pdMS_TO_TICKS(mutex_timeout);
-    TickType_t start_ticks = xTaskGetTickCount();
-
-    if (xSemaphoreTake(xWriteQueueMutex, total_ticks) == pdTRUE) {
-
-        bool flush_required = false;
-
-        // Check if we need to swap buffers
-        if (active_write_cache->head - active_write_cache->buf >= WRITE_CACHE_SIZE || active_write_cache->q_next_index >= WRITE_QUEUE_SIZE) {
-            // Check that we are not in the middle of flushing the non-active cache
-            while (flushing) {
-                vTaskDelay(10); // Check every 100ms that the flushing is done
+    if (xSemaphoreTake(xHandleTableMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        fs_err_t err = FS_OK;
+        uint8_t i;
 
-                if (xTaskGetTickCount() - start_ticks > total_ticks) {
-                    return FS_WRITE_FAILURE_ERR;
-                }
+        for (i = 0; i < handle_count; i++) {
+            if (strcmp(handle_names[i], filename) == 0) {
+                break;
             }
+        }
 
-            active_write_cache = (active_write_cache == &write_cache0) ? &write_cache1 : &write_cache0;
-
-            // Check if both buffers are full
-            if (active_write_cache->head - active_write_cache->buf >= WRITE_CACHE_SIZE || active_write_cache->q_next_index >= WRITE_QUEUE_SIZE) {
-                return FS_ENQUEUE_ERR;
+        if (i == handle_count) {
+            if (handle_count < FS_MAX_HANDLES) {
+                strcpy(handle_names[i], filename);
+                handle_count++;
+            } else {
+                err = FS_HANDLES_FULL_ERR;
             }
-
-            flush_required = true;
         }
 
+        *handle = (fs_handle_t) i;
 
-        // Copy into cache
-        memcpy(active_write_cache->head, buf, size);
+        xSemaphoreGive(xHandleTableMutex);
+        return err;
+    }
 
-        fs_write_request_t *write_request = &active_write_cache->queue[active_write_cache->q_next_index];
+    return FS_MUTEX_TIMEOUT;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
 
-        strcpy(write_request->filename, filename);
-        write_request->size = size;
-        write_request->offset = active_write_cache->head - active_write_cache->buf;
-        write_request->flushed = false;
+/*
+ * @brief Public API to append to a file in flash by joining the write ring
+ *
+ * Data is copied into the write ring, after which function returns and caller is free to deallocate data. The data will be flushed
+ * to flash whenever the filesystem task chooses (up till FS_MAX_FLUSH_WAIT ms). A flush is requested once half of the ring is in use.
+ *
+ * This never blocks: if the ring is full the write is dropped, counted in the write ring statistics and FS_ENQUEUE_ERR is returned.
+ *
+ * @param[in]  handle           Handle of the file to append to (see fs_get_handle())
+ * @param[in]  buf              Pointer to the data
+ * @param[in]  size             Size of the data
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_write_enqueue(fs_handle_t handle, const uint8_t *buf, size_t size) {
+#if FEATURE_FLASH_FS
 
-        active_write_cache->q_next_index++;
-        active_write_cache->head += size;
+    if (size > FS_WRITE_MAX_SIZE) {
+        return FS_WRITE_TOO_BIG_ERR;
+    }
 
-        xSemaphoreGive(xWriteQueueMutex);
+    if (handle >= handle_count) {
+        return FS_INVALID_HANDLE_ERR;
+    }
 
-        /*
-         * We trigger a flush by notifying the filesystem task
-         * This will cause a context switch if the current task is lower priority than the filesystem task
-         * and may block the calling task. However this is unlikely since the priority of the filesystem task
-         * is the same as many app level tasks. The xWriteQueueMutex is freed before this to allow other tasks
-         * to call fs_write_enqueue while the calling task may be blocked
-         */
-        if (flush_required) {
-            xTaskNotifyGive(fs_task_handle);
+    fs_write_rec_t *rec = NULL;
+    bool notify = false;
+
+    taskENTER_CRITICAL();
+    {
+        // Data is never split across the end of the buffer, skip to the start instead
+        uint32_t data_idx = write_ring.data_head & WRITE_RING_DATA_MASK;
+        uint32_t gap = ((data_idx + size) > FS_WRITE_RING_SIZE) ? (FS_WRITE_RING_SIZE - data_idx) : 0;
+        uint32_t data_used = (write_ring.data_head + gap + size) - write_ring.data_tail;
+        uint32_t recs_used = (write_ring.rec_head + 1U) - write_ring.rec_tail;
+
+        if ((data_used <= FS_WRITE_RING_SIZE) && (recs_used <= FS_WRITE_RING_RECORDS)) {
+            rec = &write_ring.recs[write_ring.rec_head & WRITE_RING_REC_MASK];
+            rec->start  = write_ring.data_head + gap;
+            rec->size   = (uint16_t) size;
+            rec->handle = handle;
+            rec->state  = WRITE_REC_RESERVED;
+
+            write_ring.rec_head++;
+            write_ring.data_head = rec->start + size;
+
+            write_stats.enqueued++;
+            write_stats.enqueued_bytes += size;
+            file_stats[handle].enqueued_bytes += size;
+            commit_progress[handle].enqueued += size;
+            write_stats.high_water = MAX(write_stats.high_water, data_used);
+
+            notify = (data_used >= WRITE_RING_FLUSH_BYTES) || (recs_used >= WRITE_RING_FLUSH_RECORDS);
+        } else {
+            write_stats.dropped++;
+            write_stats.dropped_bytes += size;
+            file_stats[handle].dropped_bytes += size;
+
+            notify = true;
         }
 
-        return FS_OK;
+        // Only notify the filesystem task once per flush
+        notify = notify && !write_ring.flush_requested;
+        write_ring.flush_requested |= notify;
     }
+    taskEXIT_CRITICAL();
 
-    return FS_MUTEX_TIMEOUT;
+    /*
+     * We trigger a flush by notifying the filesystem task
+     * This will cause a context switch if the current task is lower priority than the filesystem task.
+     * Other tasks can keep writing to the ring while the flush is running.
+     */
+    if (notify) {
+        xTaskNotifyGive(fs_task_handle);
+    }
+
+    if (rec == NULL) {
+        return FS_ENQUEUE_ERR;
+    }
+
+    // The reserved space belongs to this task until the record is marked as ready
+    memcpy(&write_ring.data[rec->start & WRITE_RING_DATA_MASK], buf, size);
+    rec->state = WRITE_REC_READY;
+
+    return FS_OK;
 #else
     return FS_FLASH_DISABLED_ERR;
 #endif
@@ -443,6 +664,8 @@ fs_err_t fs_remove(const char *filename, uint16_t mutex_timeout) {
 #if FEATURE_FLASH_FS
 
     if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        file_cache_evict(filename);
+
         fs_err_t err  = (fs_err_t) lfs_remove(&obc_lfs, filename);
 
         xSemaphoreGive(xFileSystemMutex);
@@ -456,75 +679,119 @@ fs_err_t fs_remove(const char *filename, uint16_t mutex_timeout) {
 }
 
 /*
- * @brief Public API to find current position in a file
+ * @brief Public API to rename a file or directory
  *
- * @param[in]  file             File handle
+ * If newpath already exists it is replaced atomically, i.e. after a reset newpath holds either the
+ * old or the new file.
  *
- * @return Returns current position in file, or a negative error code on failure (see obc_error.h).
+ * @param[in]  oldpath          Current path
+ * @param[in]  newpath          New path
+ * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
  */
-int32_t fs_tell(lfs_file_t *file) {
+fs_err_t fs_rename(const char *oldpath, const char *newpath, uint16_t mutex_timeout) {
 #if FEATURE_FLASH_FS
-    lfs_soff_t pos = lfs_file_tell(&obc_lfs, file);
 
-    if (pos < 0) {
-        fs_close(file);
-        return (fs_err_t) pos;
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        file_cache_evict(oldpath);
+        file_cache_evict(newpath);
+
+        fs_err_t err = (fs_err_t) lfs_rename(&obc_lfs, oldpath, newpath);
+
+        xSemaphoreGive(xFileSystemMutex);
+        return err;
     }
 
-    return (int32_t) pos;
+    return FS_MUTEX_TIMEOUT;
 #else
-    return (int32_t) FS_FLASH_DISABLED_ERR;
+    return FS_FLASH_DISABLED_ERR;
 #endif
 }
 
 /*
- * @brief Public API to find size of a file
+ * @brief Public API to get the type and size of a file or directory
  *
- * @param[in]  file             File handle
+ * Does not create the file if it doesn't exist. If the flush is keeping the file open, it is
+ * synced and closed first so that the size includes all flushed data.
  *
- * @return Returns size of file, or a negative error code on failure (see obc_error.h).
+ * @param[in]  path             Path of the file or directory
+ * @param[out] info             Type, size and name of the entry
+ * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return FS_OK if successful, FS_NOENT_ERR if the path doesn't exist, error code otherwise (see obc_error.h)
  */
-int32_t fs_size(lfs_file_t *file) {
+fs_err_t fs_stat(const char *path, fs_entry_info_t *info, uint16_t mutex_timeout) {
 #if FEATURE_FLASH_FS
-    return (int32_t) lfs_file_size(&obc_lfs, file);
+    struct lfs_info lfs_info;
+
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        file_cache_evict(path);
+
+        fs_err_t err = (fs_err_t) lfs_stat(&obc_lfs, path, &lfs_info);
+
+        xSemaphoreGive(xFileSystemMutex);
+
+        if (err == FS_OK) {
+            entry_info_copy(info, &lfs_info);
+        }
+
+        return err;
+    }
+
+    return FS_MUTEX_TIMEOUT;
 #else
-    return (int32_t) FS_FLASH_DISABLED_ERR;
+    return FS_FLASH_DISABLED_ERR;
 #endif
 }
 
 /*
- * @brief Public API to force a flush of both write caches. Runs in the calling task, NOT the filesystem task
+ * @brief Public API to read part of a file without keeping it open
+ *
+ * The file is opened read-only, read and closed within a single hold of the mutex, so callers
+ * reading a large file piece by piece (e.g. to downlink it) don't block the flush in between.
+ * Does not create the file if it doesn't exist. If the flush is keeping the file open, it is read
+ * through the cached handle instead, which includes flushed data that hasn't been synced yet.
  *
+ * @param[in]  filename         String
+ * @param[in]  offset           Position in the file to read from
+ * @param[out] buf              Pointer to where data should be stored
+ * @param[in]  size             Max number of bytes to read
+ * @param[out] bytes_read       Number of bytes read. Less than size if the end of the file was reached.
  * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
  *
- * @return returns FS_OK on successful flush
-*/
-fs_err_t fs_force_flush(uint16_t mutex_timeout) {
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_read_at(const char *filename, uint32_t offset, uint8_t *buf, uint32_t size, uint32_t *bytes_read, uint16_t mutex_timeout) {
 #if FEATURE_FLASH_FS
+    lfs_file_t file;
 
-    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
-        if (xSemaphoreTake(xWriteQueueMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+    *bytes_read = 0;
 
-            if (fs_flush_all() != FS_OK) {
-                xSemaphoreGive(xWriteQueueMutex);
-                xSemaphoreGive(xFileSystemMutex);
-                return FS_FLUSH_FAILED;
-            }
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        fs_cached_file_t *cached = file_cache_find(filename);
+        int32_t err = LFS_ERR_OK;
 
-            // Swap to other cache
-            active_write_cache = (active_write_cache == &write_cache0) ? &write_cache1 : &write_cache0;
+        if (cached != NULL) {
+            err = fs_read_file_at(&cached->file, offset, buf, size, bytes_read);
 
-            if (fs_flush_all() != FS_OK) {
-                xSemaphoreGive(xWriteQueueMutex);
-                xSemaphoreGive(xFileSystemMutex);
-                return FS_FLUSH_FAILED;
+            if (err != LFS_ERR_OK) {
+                // Re-opened from its last good state by the next flush
+                file_cache_close(cached);
             }
+        } else {
+            err = lfs_file_opencfg(&obc_lfs, &file, filename, LFS_O_RDONLY, &obc_file_cfg);
 
-            xSemaphoreGive(xWriteQueueMutex);
-            xSemaphoreGive(xFileSystemMutex);
-            return FS_OK;
+            if (err == LFS_ERR_OK) {
+                err = fs_read_file_at(&file, offset, buf, size, bytes_read);
 
+                // Nothing to write back for a read-only file
+                lfs_file_close(&obc_lfs, &file);
+            }
         }
+
+        xSemaphoreGive(xFileSystemMutex);
+        return (fs_err_t) err;
     }
 
     return FS_MUTEX_TIMEOUT;
@@ -533,95 +800,439 @@ fs_err_t fs_force_flush(uint16_t mutex_timeout) {
 #endif
 }
 
-/******************************************************************************/
-/* NOTE: Although the following functions are public, they should only be     *
- *       called during the filesystem init/deinit phases and are not guarded  *
- *       with a mutex.                                                        */
-/******************************************************************************/
-
-/**
- * @brief Erases the filesystem
+/*
+ * @brief Public API to list part of a directory
  *
- * @return FS_OK if successful, error code otherwise
+ * Entries are numbered from 0 in the order LFS stores them (the "." and ".." entries are skipped),
+ * so a listing can be continued by calling again with start set to the number of entries already
+ * received. Sizes of files kept open by the flush don't include data that hasn't been synced yet.
+ *
+ * @param[in]  path             Path of the directory ("/" for the root)
+ * @param[in]  start            Index of the first entry to return
+ * @param[out] entries          Array to store the entries in
+ * @param[in]  max_entries      Size of the entries array
+ * @param[out] count            Number of entries stored in the entries array
+ * @param[out] total            Total number of entries in the directory
+ * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
  */
-fs_err_t fs_erase(void) {
+fs_err_t fs_list(const char *path, uint16_t start, fs_entry_info_t *entries, uint16_t max_entries, uint16_t *count, uint16_t *total,
+                 uint16_t mutex_timeout) {
 #if FEATURE_FLASH_FS
-    fs_err_t err = FS_OK;
+    lfs_dir_t dir;
+    struct lfs_info lfs_info;
 
-    err = fs_deinit();
+    *count = 0;
+    *total = 0;
 
-    if (err != FS_OK) {
-        return err;
-    }
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        int32_t err = lfs_dir_open(&obc_lfs, &dir, path);
 
-    err = (fs_err_t) lfs_format(&obc_lfs, &cfg);
+        if (err == LFS_ERR_OK) {
+            while ((err = lfs_dir_read(&obc_lfs, &dir, &lfs_info)) > 0) {
+                if ((strcmp(lfs_info.name, ".") == 0) || (strcmp(lfs_info.name, "..") == 0)) {
+                    continue;
+                }
 
-    if (err != FS_OK) {
-        return err;
-    }
+                if ((*total >= start) && (*count < max_entries)) {
+                    entry_info_copy(&entries[*count], &lfs_info);
+                    (*count)++;
+                }
 
-    err = (fs_err_t) lfs_mount(&obc_lfs, &cfg);
+                (*total)++;
+            }
 
-    return err;
+            lfs_dir_close(&obc_lfs, &dir);
+        }
+
+        xSemaphoreGive(xFileSystemMutex);
+        return (err < 0) ? (fs_err_t) err : FS_OK;
+    }
+
+    return FS_MUTEX_TIMEOUT;
 #else
     return FS_FLASH_DISABLED_ERR;
 #endif
 }
 
-/**
- * @brief Initializes the filesystem. Must be called before any other FS functions.
+/*
+ * @brief Public API to find current position in a file
  *
- * @return FS_OK if successful, error code otherwise
+ * @param[in]  file             File handle
+ *
+ * @return Returns current position in file, or a negative error code on failure (see obc_error.h).
  */
-fs_err_t fs_init(void) {
+int32_t fs_tell(lfs_file_t *file) {
 #if FEATURE_FLASH_FS
-    fs_err_t err = FS_OK;
-
-    // Mount fs
-    err = (fs_err_t) lfs_mount(&obc_lfs, &cfg);
-
-    if (err == FS_CORRUPT_ERR) {
-        // FS is either yet to be initialized, or irrepairably corrupted
-        err = (fs_err_t) lfs_format(&obc_lfs, &cfg);
-
-        if (err != FS_OK) {
-            return err;
-        }
+    lfs_soff_t pos = lfs_file_tell(&obc_lfs, file);
 
-        // Try again with formatted FS
-        err = (fs_err_t) lfs_mount(&obc_lfs, &cfg);
+    if (pos < 0) {
+        fs_close(file);
+        return (fs_err_t) pos;
     }
 
-    return err;
+    return (int32_t) pos;
 #else
-    return FS_FLASH_DISABLED_ERR;
+    return (int32_t) FS_FLASH_DISABLED_ERR;
 #endif
 }
 
-/**
- * @brief De-initializes the filesystem.
+/*
+ * @brief Public API to find size of a file
  *
- * @return FS_OK if successful, error code otherwise
+ * @param[in]  file             File handle
+ *
+ * @return Returns size of file, or a negative error code on failure (see obc_error.h).
  */
-fs_err_t fs_deinit(void) {
+int32_t fs_size(lfs_file_t *file) {
 #if FEATURE_FLASH_FS
-    return (fs_err_t) lfs_unmount(&obc_lfs);
+    return (int32_t) lfs_file_size(&obc_lfs, file);
 #else
-    return FS_FLASH_DISABLED_ERR;
+    return (int32_t) FS_FLASH_DISABLED_ERR;
 #endif
 }
 
-/**
- * @brief Performs a comprehensive test of the file system capabilities
+/*
+ * @brief Public API to flush the write ring. Runs in the calling task, NOT the filesystem task
  *
- * @warning Re-formats FS, erasing all old data
+ * Flushed files are kept open and are only synced to flash at the next sync point (see fs_sync()).
  *
- * @return FS_OK if all tests passed, error code otherwise
- */
-fs_err_t fs_self_test(void) {
+ * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return returns FS_OK on successful flush
+*/
+fs_err_t fs_flush(uint16_t mutex_timeout) {
+#if FEATURE_FLASH_FS
+
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        fs_err_t err = fs_flush_all();
+
+        xSemaphoreGive(xFileSystemMutex);
+        return (err == FS_OK) ? FS_OK : FS_FLUSH_FAILED;
+    }
+
+    return FS_MUTEX_TIMEOUT;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/*
+ * @brief Public API to force a flush of the write ring and sync all flushed files to flash. Runs in the calling task,
+ *        NOT the filesystem task
+ *
+ * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return returns FS_OK on successful flush
+*/
+fs_err_t fs_force_flush(uint16_t mutex_timeout) {
+#if FEATURE_FLASH_FS
+
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        fs_err_t err = fs_flush_all();
+        fs_err_t sync_err = file_cache_sync_all();
+
+        xSemaphoreGive(xFileSystemMutex);
+        return ((err == FS_OK) && (sync_err == FS_OK)) ? FS_OK : FS_FLUSH_FAILED;
+    }
+
+    return FS_MUTEX_TIMEOUT;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/*
+ * @brief Public API to sync the files kept open by the flush to flash
+ *
+ * Flushed data is only guaranteed to survive a reset once it has been synced. This happens every
+ * FS_SYNC_PERIOD_MS, when the file is opened with fs_open() and when it is evicted by another file.
+ *
+ * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+*/
+fs_err_t fs_sync(uint16_t mutex_timeout) {
+#if FEATURE_FLASH_FS
+
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        fs_err_t err = file_cache_sync_all();
+
+        xSemaphoreGive(xFileSystemMutex);
+        return err;
+    }
+
+    return FS_MUTEX_TIMEOUT;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/*
+ * @brief Public API to run one step of the scrubber. Runs in the calling task, NOT the filesystem task
+ *
+ * The scrubber pre-erases free blocks so that LFS finds them already erased when it allocates them,
+ * which takes the erase time off the write path. Contiguous runs of free blocks are erased with 32K
+ * or 64K erases. A step issues at most SCRUB_ERASES_PER_STEP erases and stops early if a flush is
+ * requested. A pass over the flash starts with a traversal of the filesystem, which is done as a
+ * step on its own.
+ *
+ * The filesystem task runs a step every poll period while a pass is in progress.
+ *
+ * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+*/
+fs_err_t fs_scrub(uint16_t mutex_timeout) {
+#if FEATURE_FLASH_FS
+
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        scrub_step();
+
+        xSemaphoreGive(xFileSystemMutex);
+        return FS_OK;
+    }
+
+    return FS_MUTEX_TIMEOUT;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/*
+ * @brief Public API to get the write ring statistics
+ *
+ * @param[out] stats            Copy of the statistics
+ */
+void fs_get_write_stats(fs_write_stats_t *stats) {
+#if FEATURE_FLASH_FS
+    taskENTER_CRITICAL();
+    *stats = write_stats;
+    taskEXIT_CRITICAL();
+#else
+    memset(stats, 0, sizeof(fs_write_stats_t));
+#endif
+}
+
+/*
+ * @brief Public API to reset the write ring statistics
+ */
+void fs_reset_write_stats(void) {
+#if FEATURE_FLASH_FS
+    taskENTER_CRITICAL();
+    memset(&write_stats, 0, sizeof(write_stats));
+    taskEXIT_CRITICAL();
+#endif
+}
+
+/*
+ * @brief Public API to get the block device statistics and flush durations
+ *
+ * @param[out] stats            Copy of the statistics
+ */
+void fs_get_io_stats(fs_io_stats_t *stats) {
+#if FEATURE_FLASH_FS
+    taskENTER_CRITICAL();
+    *stats = io_stats;
+    taskEXIT_CRITICAL();
+#else
+    memset(stats, 0, sizeof(fs_io_stats_t));
+#endif
+}
+
+/*
+ * @brief Public API to get the statistics of a file written through the write ring
+ *
+ * @param[in]  handle           Handle of the file (see fs_get_handle())
+ * @param[out] stats            Copy of the statistics, including the filename
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_get_file_stats(fs_handle_t handle, fs_file_stats_t *stats) {
+#if FEATURE_FLASH_FS
+
+    if (handle >= handle_count) {
+        return FS_INVALID_HANDLE_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    *stats = file_stats[handle];
+    taskEXIT_CRITICAL();
+
+    // Entries of the handle table are never modified once added
+    memcpy(stats->name, handle_names[handle], sizeof(stats->name));
+
+    return FS_OK;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/*
+ * @brief Public API to get how much of the data written to a file through the write ring is committed to flash
+ *
+ * Data enqueued before the committed count reaches the enqueued count returned now survives a reset.
+ * Both counts are free-running and never reset, compare them with wrap-around. Data lost to a failed
+ * commit is counted by the next successful commit of the file, so the committed count can't get stuck.
+ *
+ * @param[in]  handle           Handle of the file (see fs_get_handle())
+ * @param[out] enqueued         Number of bytes accepted by the write ring
+ * @param[out] committed        Number of those bytes committed to flash
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_get_commit_progress(fs_handle_t handle, uint32_t *enqueued, uint32_t *committed) {
+#if FEATURE_FLASH_FS
+
+    if (handle >= handle_count) {
+        return FS_INVALID_HANDLE_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    *enqueued  = commit_progress[handle].enqueued;
+    *committed = commit_progress[handle].committed;
+    taskEXIT_CRITICAL();
+
+    return FS_OK;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/*
+ * @brief Public API to reset the block device and per-file statistics
+ *
+ * The number of blocks in use is kept, as it is only updated by the scrubber. The block device
+ * callbacks update the statistics with xFileSystemMutex held, so it is taken to not lose the reset
+ * to an update in progress.
+ *
+ * @param[in]  mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return FS_OK if successful, error code otherwise (see obc_error.h)
+ */
+fs_err_t fs_reset_io_stats(uint16_t mutex_timeout) {
+#if FEATURE_FLASH_FS
+
+    if (xSemaphoreTake(xFileSystemMutex, pdMS_TO_TICKS(mutex_timeout)) == pdTRUE) {
+        // The per-file enqueued and dropped counts are updated without the mutex
+        taskENTER_CRITICAL();
+        uint32_t blocks_used = io_stats.blocks_used;
+        memset(&io_stats, 0, sizeof(io_stats));
+        io_stats.blocks_used = blocks_used;
+        memset(file_stats, 0, sizeof(file_stats));
+        taskEXIT_CRITICAL();
+
+        xSemaphoreGive(xFileSystemMutex);
+        return FS_OK;
+    }
+
+    return FS_MUTEX_TIMEOUT;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/******************************************************************************/
+/* NOTE: Although the following functions are public, they should only be     *
+ *       called during the filesystem init/deinit phases and are not guarded  *
+ *       with a mutex.                                                        */
+/******************************************************************************/
+
+/**
+ * @brief Erases the filesystem
+ *
+ * @return FS_OK if successful, error code otherwise
+ */
+fs_err_t fs_erase(void) {
+#if FEATURE_FLASH_FS
+    fs_err_t err = FS_OK;
+
+    err = fs_deinit();
+
+    if (err != FS_OK) {
+        return err;
+    }
+
+    err = (fs_err_t) lfs_format(&obc_lfs, &cfg);
+
+    if (err != FS_OK) {
+        return err;
+    }
+
+    err = (fs_err_t) lfs_mount(&obc_lfs, &cfg);
+    scrub_reset(err == FS_OK);
+
+    return err;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/**
+ * @brief Initializes the filesystem. Must be called before any other FS functions.
+ *
+ * @return FS_OK if successful, error code otherwise
+ */
+fs_err_t fs_init(void) {
 #if FEATURE_FLASH_FS
     fs_err_t err = FS_OK;
 
+    // Mount fs
+    err = (fs_err_t) lfs_mount(&obc_lfs, &cfg);
+
+    if (err == FS_CORRUPT_ERR) {
+        // FS is either yet to be initialized, or irrepairably corrupted
+        err = (fs_err_t) lfs_format(&obc_lfs, &cfg);
+
+        if (err != FS_OK) {
+            return err;
+        }
+
+        // Try again with formatted FS
+        err = (fs_err_t) lfs_mount(&obc_lfs, &cfg);
+    }
+
+    scrub_reset(err == FS_OK);
+
+    return err;
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/**
+ * @brief De-initializes the filesystem.
+ *
+ * @return FS_OK if successful, error code otherwise
+ */
+fs_err_t fs_deinit(void) {
+#if FEATURE_FLASH_FS
+    file_cache_close_all();
+    scrub_reset(false);
+
+    return (fs_err_t) lfs_unmount(&obc_lfs);
+#else
+    return FS_FLASH_DISABLED_ERR;
+#endif
+}
+
+/**
+ * @brief Performs a comprehensive test of the file system capabilities
+ *
+ * @warning Re-formats FS, erasing all old data
+ *
+ * @return FS_OK if all tests passed, error code otherwise
+ */
+fs_err_t fs_self_test(void) {
+#if FEATURE_FLASH_FS
+    fs_err_t err = FS_OK;
+
+    file_cache_close_all();
+
+    // The filesystem is left formatted but not mounted, so it can't be scrubbed until fs_init()
+    scrub_reset(false);
+
     err = (fs_err_t) lfs_format(&obc_lfs, &cfg);
 
     if (err != FS_OK) {
@@ -745,7 +1356,9 @@ static void filesystem_task(void *pvParameters) {
     TickType_t last_wake_time = xTaskGetTickCount();
 
 #if FEATURE_FLASH_FS
-    uint16_t elapsed_period = 0;
+    uint32_t elapsed_period = 0;
+    uint32_t sync_elapsed_period = 0;
+    uint32_t scrub_elapsed_period = FS_SCRUB_PERIOD_MS;
 #endif
 
     while (1) {
@@ -753,21 +1366,18 @@ static void filesystem_task(void *pvParameters) {
 
 #if FEATURE_FLASH_FS
         /*
-         * The two conditions that can trigger a flush of write_cache into flash are
-         * (1) It's been FS_MAX_FLUSH_WAIT seconds since the last flush
+         * The two conditions that can trigger a flush of the write ring into flash are
+         * (1) It's been FS_MAX_FLUSH_WAIT ms since the last flush
          * (2) The task has a notification pending
          */
 
         if (elapsed_period >= FS_MAX_FLUSH_WAIT || ulTaskNotifyTake(pdFALSE, 0) == pdTRUE) {
             if (xSemaphoreTake(xFileSystemMutex, 0) == pdTRUE) {
-                flushing = true;
-
                 if (fs_flush_all() != FS_OK) {
                     // Notify self to attempt to flush again the next time the task wakes up
                     xTaskNotifyGive(fs_task_handle);
                 }
 
-                flushing = false;
                 xSemaphoreGive(xFileSystemMutex);
             } else {
                 // Notify self to attempt to flush again the next time the task wakes up
@@ -777,7 +1387,31 @@ static void filesystem_task(void *pvParameters) {
             elapsed_period = 0;
         }
 
+        // Commit the metadata of the files kept open by the flush
+        if (sync_elapsed_period >= FS_SYNC_PERIOD_MS) {
+            if (xSemaphoreTake(xFileSystemMutex, 0) == pdTRUE) {
+                file_cache_sync_all();
+                xSemaphoreGive(xFileSystemMutex);
+
+                sync_elapsed_period = 0;
+            }
+        }
+
+        // Pre-erase free blocks while there is nothing to flush
+        if ((scrub_elapsed_period >= FS_SCRUB_PERIOD_MS) && !write_ring.flush_requested) {
+            if (xSemaphoreTake(xFileSystemMutex, 0) == pdTRUE) {
+                if (scrub_step()) {
+                    // Pass complete, wait before starting the next one
+                    scrub_elapsed_period = 0;
+                }
+
+                xSemaphoreGive(xFileSystemMutex);
+            }
+        }
+
         elapsed_period += FS_POLL_PERIOD_MS;
+        sync_elapsed_period += FS_POLL_PERIOD_MS;
+        scrub_elapsed_period = MIN(scrub_elapsed_period + FS_POLL_PERIOD_MS, FS_SCRUB_PERIOD_MS);
         vTaskDelayUntil(&last_wake_time, fs_poll_period_ticks);
 #else
         vTaskDelayUntil(&last_wake_time, fs_poll_period_ticks);
@@ -787,83 +1421,373 @@ static void filesystem_task(void *pvParameters) {
 
 #if FEATURE_FLASH_FS
 /**
- * @brief Flushes all items in write_queue to flash
+ * @brief Flushes all ready records in the write ring to flash
+ *
+ * The records are gathered into one chain of extents per file in a single pass, where each extent is a
+ * run of records of the same file that are contiguous in the ring. Each file is then taken from the file
+ * cache (opened at most once) and each extent is written with a single call to LFS.
+ *
+ * Must be called with xFileSystemMutex held.
+ *
+ * @return FS_OK if all files were written, error code of the last failure otherwise
 */
 static fs_err_t fs_flush_all(void) {
-    // Choose the non-active write cache
-    fs_write_cache_t *write_cache = (active_write_cache == &write_cache0) ? &write_cache1 : &write_cache0;
-    uint8_t *write_cache_start = write_cache->buf;
+    uint8_t first[FS_MAX_HANDLES];
+    uint8_t last[FS_MAX_HANDLES];
+    fs_err_t file_err[FS_MAX_HANDLES];
 
-    // Return immediately if theres' nothing to write
-    if (write_cache->q_next_index == 0) {
-        return FS_OK;
+    TickType_t start_ticks = xTaskGetTickCount();
+    uint32_t start_us = FS_TIME_US();
+
+    memset(first, WRITE_RING_NO_REC, sizeof(first));
+
+    // Producers that fill the ring from here on need to request another flush
+    write_ring.flush_requested = false;
+
+    uint32_t rec_tail = write_ring.rec_tail;
+    uint32_t rec_head = write_ring.rec_head;
+    uint32_t rec_end;
+    uint32_t bytes = 0;
+
+    // Gather the extents of each file, stopping at the first record still being written
+    for (rec_end = rec_tail; rec_end != rec_head; rec_end++) {
+        uint8_t i = (uint8_t)(rec_end & WRITE_RING_REC_MASK);
+        fs_write_rec_t *rec = &write_ring.recs[i];
+
+        if (rec->state == WRITE_REC_RESERVED) {
+            break;
+        }
+
+        if (rec->state != WRITE_REC_READY) {
+            continue; // Already written by a previous flush
+        }
+
+        fs_handle_t h = rec->handle;
+        fs_write_rec_t *ext = (first[h] != WRITE_RING_NO_REC) ? &write_ring.recs[last[h]] : NULL;
+
+        if ((ext != NULL) && (((ext->start & WRITE_RING_DATA_MASK) + ext->extent_size) == (rec->start & WRITE_RING_DATA_MASK))) {
+            // Contiguous with the last extent of this file
+            ext->extent_size += rec->size;
+            rec->extent_size = 0;
+        } else {
+            rec->extent_size = rec->size;
+            rec->next = WRITE_RING_NO_REC;
+
+            if (ext == NULL) {
+                first[h] = i;
+            } else {
+                ext->next = i;
+            }
+
+            last[h] = i;
+        }
+
+        bytes += rec->size;
     }
 
-    /*
-     * Opening and closing the file is by a large margin the most costly operation
-     * Thus, we try and batch writes to the same file by searching through all the
-     * write requests for the same file.
-     */
+    if (rec_end == rec_tail) {
+        return FS_OK; // Nothing to write
+    }
 
-    for (uint8_t i = 0; i < write_cache->q_next_index; i++) {
+    fs_err_t err = FS_OK;
+
+    for (fs_handle_t h = 0; h < FS_MAX_HANDLES; h++) {
+        file_err[h] = FS_OK;
 
-        fs_write_request_t *outer_req = &write_cache->queue[i];
+        if (first[h] != WRITE_RING_NO_REC) {
+            file_err[h] = fs_flush_file(h, first[h]);
 
-        if (outer_req->flushed) {
-            continue; // Write request already flushed, continue to next one
+            if (file_err[h] != FS_OK) { // TODO: ALEA-3038 what to do with repeated filesystem errors?
+                err = file_err[h];
+            }
         }
+    }
 
-        lfs_file_t file = { 0 };
-        fs_err_t err = (fs_err_t) lfs_file_opencfg(&obc_lfs, &file, outer_req->filename, LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND, &obc_file_cfg);
+    // Mark the written records. Records of files that failed are kept and retried by the next flush.
+    for (uint32_t r = rec_tail; r != rec_end; r++) {
+        fs_write_rec_t *rec = &write_ring.recs[r & WRITE_RING_REC_MASK];
 
-        if (err != FS_OK) { // TODO: ALEA-3038 what to do with repeated filesystem errors?
-            return err;
+        if ((rec->state == WRITE_REC_READY) && (file_err[rec->handle] == FS_OK)) {
+            rec->state = WRITE_REC_FLUSHED;
         }
+    }
+
+    // Release the space of all written records at the tail of the ring
+    uint32_t data_tail = write_ring.data_tail;
+
+    while ((rec_tail != rec_end) && (write_ring.recs[rec_tail & WRITE_RING_REC_MASK].state == WRITE_REC_FLUSHED)) {
+        const fs_write_rec_t *rec = &write_ring.recs[rec_tail & WRITE_RING_REC_MASK];
+        data_tail = rec->start + rec->size;
+        rec_tail++;
+    }
+
+    taskENTER_CRITICAL();
+    write_ring.data_tail = data_tail;
+    write_ring.rec_tail = rec_tail;
+
+    if (err == FS_OK) {
+        write_stats.flushes++;
+        write_stats.flushed_bytes += bytes;
+    } else {
+        write_stats.flush_errors++;
+    }
 
-        lfs_ssize_t bytes_written = lfs_file_write(&obc_lfs, &file, write_cache_start + outer_req->offset, outer_req->size);
+    taskEXIT_CRITICAL();
 
-        if (bytes_written != outer_req->size) { // TODO: ALEA-3038 what to do with repeated filesystem errors?
-            lfs_file_close(&obc_lfs, &file);
+    fs_record_latency(&io_stats.flush, start_ticks, start_us);
+
+    return err;
+}
+
+/**
+ * @brief Appends a chain of extents to a file
+ *
+ * The file is left open in the file cache and is synced to flash later.
+ *
+ * @param handle: File to write to
+ * @param first_rec: Index of the record of the first extent
+ * @return FS_OK if successful, error code otherwise
+ */
+static fs_err_t fs_flush_file(fs_handle_t handle, uint8_t first_rec) {
+    fs_cached_file_t *cached = NULL;
+    fs_err_t err = file_cache_get(handle, &cached);
+
+    if (err != FS_OK) {
+        return err;
+    }
+
+    uint32_t flushed = 0;
+
+    for (uint8_t i = first_rec; i != WRITE_RING_NO_REC; i = write_ring.recs[i].next) {
+        const fs_write_rec_t *ext = &write_ring.recs[i];
+        lfs_ssize_t bytes_written = lfs_file_write(&obc_lfs, &cached->file, &write_ring.data[ext->start & WRITE_RING_DATA_MASK], ext->extent_size);
+
+        cached->dirty = true;
+
+        if (bytes_written > 0) {
+            taskENTER_CRITICAL();
+            file_stats[handle].flushed_bytes += (uint32_t) bytes_written;
+            taskEXIT_CRITICAL();
+        }
+
+        if (bytes_written != ext->extent_size) {
+            file_cache_close(cached);
             return (bytes_written < 0) ? (fs_err_t) bytes_written : FS_WRITE_FAILURE_ERR;
         }
 
-        // Search for all other write requests that have the same filename
-        for (uint8_t j = i + 1; j < write_cache->q_next_index; j++) {
+        flushed += ext->extent_size;
+    }
 
-            fs_write_request_t *inner_req = &write_cache->queue[j];
+    taskENTER_CRITICAL();
+    commit_progress[handle].flushed += flushed;
+    taskEXIT_CRITICAL();
 
-            if (inner_req->flushed) {
-                continue;
-            }
+    return FS_OK;
+}
 
-            if (strcmp(inner_req->filename, outer_req->filename) == 0) {
-                bytes_written = lfs_file_write(&obc_lfs, &file, write_cache_start + inner_req->offset, inner_req->size);
+/**
+ * @brief Gets the open file of a write ring handle from the file cache, opening it if necessary
+ *
+ * When all slots are in use, the least recently used file is closed.
+ *
+ * @param handle: Write ring handle of the file
+ * @param[out] cached: The cached file
+ * @return FS_OK if successful, error code otherwise
+ */
+static fs_err_t file_cache_get(fs_handle_t handle, fs_cached_file_t **cached) {
+    fs_cached_file_t *slot = NULL;
 
-                if (bytes_written != inner_req->size) { // TODO: ALEA-3038 what to do with repeated filesystem errors?
-                    lfs_file_close(&obc_lfs, &file);
-                    return (bytes_written < 0) ? (fs_err_t) bytes_written : FS_WRITE_FAILURE_ERR;
-                }
+    for (uint8_t i = 0; i < FILE_CACHE_SLOTS; i++) {
+        fs_cached_file_t *entry = &file_cache[i];
 
-                inner_req->flushed = true;
-            }
+        if (entry->open && (entry->handle == handle)) {
+            slot = entry;
+            break;
+        }
+
+        // Prefer a free slot, otherwise the least recently used one
+        if ((slot == NULL) || (slot->open && (!entry->open || (entry->last_used < slot->last_used)))) {
+            slot = entry;
         }
+    }
 
-        outer_req->flushed = true;
+    if (!slot->open || (slot->handle != handle)) {
+        if (slot->open) {
+            file_cache_close(slot);
+        }
 
-        err = (fs_err_t) lfs_file_close(&obc_lfs, &file);
+        fs_err_t err = (fs_err_t) lfs_file_opencfg(&obc_lfs, &slot->file, handle_names[handle], LFS_O_RDWR | LFS_O_CREAT | LFS_O_APPEND, &slot->cfg);
 
         if (err != FS_OK) {
             return err;
         }
+
+        slot->handle = handle;
+        slot->open = true;
+        slot->dirty = false;
     }
 
-    // Reset cache to empty state
-    write_cache->q_next_index = 0;
-    write_cache->head = write_cache->buf;
+    slot->last_used = ++file_cache_clock;
+    *cached = slot;
 
     return FS_OK;
 }
 
+/**
+ * @brief Closes a file in the file cache, committing any changes to flash
+ *
+ * @param cached: The cached file
+ * @return FS_OK if successful, error code otherwise. The file is closed either way.
+ */
+static fs_err_t file_cache_close(fs_cached_file_t *cached) {
+    fs_err_t err = (fs_err_t) lfs_file_close(&obc_lfs, &cached->file);
+
+    cached->open = false;
+    cached->dirty = false;
+
+    taskENTER_CRITICAL();
+
+    if (err == FS_OK) {
+        commit_progress[cached->handle].committed = commit_progress[cached->handle].flushed;
+    } else {
+        write_stats.flush_errors++;
+    }
+
+    taskEXIT_CRITICAL();
+
+    return err;
+}
+
+/**
+ * @brief Closes all files in the file cache
+ *
+ * @return FS_OK if successful, error code of the last failure otherwise
+ */
+static fs_err_t file_cache_close_all(void) {
+    fs_err_t err = FS_OK;
+
+    for (uint8_t i = 0; i < FILE_CACHE_SLOTS; i++) {
+        if (file_cache[i].open) {
+            fs_err_t close_err = file_cache_close(&file_cache[i]);
+            err = (close_err != FS_OK) ? close_err : err;
+        }
+    }
+
+    return err;
+}
+
+/**
+ * @brief Closes a file if it is in the file cache
+ *
+ * @param filename: Name of the file
+ * @return FS_OK if successful or the file was not cached, error code otherwise
+ */
+static fs_err_t file_cache_evict(const char *filename) {
+    fs_cached_file_t *cached = file_cache_find(filename);
+
+    return (cached != NULL) ? file_cache_close(cached) : FS_OK;
+}
+
+/**
+ * @brief Finds a file in the file cache
+ *
+ * @param filename: Name of the file
+ * @return The cached file, or NULL if the file is not open in the cache
+ */
+static fs_cached_file_t *file_cache_find(const char *filename) {
+    for (uint8_t i = 0; i < FILE_CACHE_SLOTS; i++) {
+        if (file_cache[i].open && (strcmp(handle_names[file_cache[i].handle], filename) == 0)) {
+            return &file_cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Syncs all files in the file cache that have been written since the last sync
+ *
+ * A file that fails to sync is closed so that it is re-opened from its last good state.
+ *
+ * @return FS_OK if successful, error code of the last failure otherwise
+ */
+static fs_err_t file_cache_sync_all(void) {
+    fs_err_t err = FS_OK;
+    bool synced = false;
+
+    TickType_t start_ticks = xTaskGetTickCount();
+    uint32_t start_us = FS_TIME_US();
+
+    for (uint8_t i = 0; i < FILE_CACHE_SLOTS; i++) {
+        fs_cached_file_t *cached = &file_cache[i];
+
+        if (cached->open && cached->dirty) {
+            synced = true;
+
+            fs_err_t sync_err = (fs_err_t) lfs_file_sync(&obc_lfs, &cached->file);
+
+            if (sync_err == FS_OK) {
+                cached->dirty = false;
+
+                taskENTER_CRITICAL();
+                commit_progress[cached->handle].committed = commit_progress[cached->handle].flushed;
+                taskEXIT_CRITICAL();
+            } else {
+                file_cache_close(cached);
+                err = sync_err;
+            }
+        }
+    }
+
+    if (synced) {
+        fs_record_latency(&io_stats.sync, start_ticks, start_us);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Converts an LFS directory entry. Names too long for fs_entry_info_t are truncated.
+ *
+ * @param info: Converted entry
+ * @param lfs_info: LFS entry
+ */
+static void entry_info_copy(fs_entry_info_t *info, const struct lfs_info *lfs_info) {
+    info->type = lfs_info->type;
+    info->size = (lfs_info->type == LFS_TYPE_REG) ? lfs_info->size : 0;
+
+    strncpy(info->name, lfs_info->name, (FS_PATH_MAX_SIZE - 1U));
+    info->name[FS_PATH_MAX_SIZE - 1U] = '\0';
+}
+
+/**
+ * @brief Reads part of an open file. xFileSystemMutex must be held.
+ *
+ * @param file: The open file
+ * @param offset: Position in the file to read from
+ * @param[out] buf: Where the data is stored
+ * @param size: Max number of bytes to read
+ * @param[out] bytes_read: Number of bytes read
+ * @return LFS_ERR_OK if successful, negative LFS error code otherwise
+ */
+static int32_t fs_read_file_at(lfs_file_t *file, uint32_t offset, uint8_t *buf, uint32_t size, uint32_t *bytes_read) {
+    lfs_soff_t pos = lfs_file_seek(&obc_lfs, file, (lfs_soff_t) offset, LFS_SEEK_SET);
+
+    if (pos < 0) {
+        return pos;
+    }
+
+    lfs_ssize_t n = lfs_file_read(&obc_lfs, file, buf, size);
+
+    if (n < 0) {
+        return n;
+    }
+
+    *bytes_read = (uint32_t) n;
+
+    return LFS_ERR_OK;
+}
+
 /**
  * @brief Read from a particular block in the flash.
  *
@@ -875,7 +1799,13 @@ static fs_err_t fs_flush_all(void) {
  * @return Negative error code if unsuccessful
  */
 static int32_t bd_read(const struct lfs_config *cnfg, lfs_block_t block, lfs_off_t off_bytes, void *buffer, lfs_size_t size_bytes) {
-    return (int32_t) flash_read((block * cnfg->block_size) + off_bytes, size_bytes, (uint8_t *) buffer);
+    flash_err_t err = flash_read((block * cnfg->block_size) + off_bytes, size_bytes, (uint8_t *) buffer);
+
+    io_stats.reads++;
+    io_stats.read_bytes += size_bytes;
+    io_stats.errors += (err != FLASH_OK) ? 1U : 0U;
+
+    return (int32_t) err;
 }
 
 /**
@@ -889,18 +1819,43 @@ static int32_t bd_read(const struct lfs_config *cnfg, lfs_block_t block, lfs_off
  * @return Negative error code if unsuccessful
  */
 static int32_t bd_prog(const struct lfs_config *cnfg, lfs_block_t block, lfs_off_t off_bytes, const void *buffer, lfs_size_t size_bytes) {
-    return (int32_t) flash_write((block * cnfg->block_size) + off_bytes, size_bytes, (const uint8_t *) buffer);
+    block_bitmap_set(scrub.used, block, 1);
+    block_bitmap_clear(scrub.erased, block, 1);
+
+    flash_err_t err = flash_write((block * cnfg->block_size) + off_bytes, size_bytes, (const uint8_t *) buffer);
+
+    io_stats.progs++;
+    io_stats.prog_bytes += size_bytes;
+    io_stats.errors += (err != FLASH_OK) ? 1U : 0U;
+
+    return (int32_t) err;
 }
 
 /**
  * @brief Erase a particular block in the flash.
  *
+ * Returns immediately if the block was pre-erased by the scrubber.
+ *
  * @param cnfg: configuration structure used to initialize the filesystem
  * @param block: block number to erase (blocks are 4KiB size)
  * @return Negative error code if unsuccessful
  */
 static int32_t bd_erase(const struct lfs_config *cnfg, lfs_block_t block) {
-    return (int32_t) flash_erase(block * cnfg->block_size, SECTOR_4K);
+    // LFS is about to use the block, so the scrubber must leave it alone until the next traversal
+    block_bitmap_set(scrub.used, block, 1);
+
+    if (block_bitmap_get(scrub.erased, block)) {
+        block_bitmap_clear(scrub.erased, block, 1);
+        io_stats.erases_skipped++;
+        return 0;
+    }
+
+    flash_err_t err = flash_erase(block * cnfg->block_size, SECTOR_4K);
+
+    io_stats.erases++;
+    io_stats.errors += (err != FLASH_OK) ? 1U : 0U;
+
+    return (int32_t) err;
 }
 
 /**
@@ -914,4 +1869,195 @@ static int32_t bd_erase(const struct lfs_config *cnfg, lfs_block_t block) {
 static int32_t bd_sync(const struct lfs_config *cnfg) {
     return 0;
 }
+
+/**
+ * @brief Runs one step of the scrubber (see fs_scrub()).
+ *
+ * Must be called with xFileSystemMutex held.
+ *
+ * @return true if the step completed a pass over the flash, false otherwise
+ */
+static bool scrub_step(void) {
+    if (!scrub.mounted) {
+        return true;
+    }
+
+    if (!scrub.used_valid) {
+        uint32_t blocks_used = 0;
+
+        memset(scrub.used, 0, sizeof(scrub.used));
+
+        // Blocks erased or programmed during the traversal are added by bd_erase/bd_prog as usual
+        if (lfs_fs_traverse(&obc_lfs, &scrub_mark_used, &blocks_used) < 0) {
+            return true;
+        }
+
+        io_stats.blocks_used = blocks_used;
+        scrub.used_valid = true;
+        scrub.cursor = 0;
+        return false;
+    }
+
+    uint32_t erases = 0;
+
+    while ((erases < SCRUB_ERASES_PER_STEP) && !write_ring.flush_requested) {
+        if (scrub.cursor >= EXT_FLASH_BLOCK_COUNT) {
+            // The next pass needs a new traversal to find the blocks freed during this one
+            scrub.used_valid = false;
+            return true;
+        }
+
+        uint32_t block = scrub.cursor;
+        uint32_t count = scrub_run_blocks(block);
+
+        if (count == 0) {
+            scrub.cursor++;
+            continue;
+        }
+
+        flash_erase_sz_t erase_size = (count == SCRUB_BLOCKS_64K) ? SECTOR_64K : ((count == SCRUB_BLOCKS_32K) ? SECTOR_32K : SECTOR_4K);
+
+        if (flash_erase(block * EXT_FLASH_BLOCK_SIZE, erase_size) == FLASH_OK) {
+            block_bitmap_set(scrub.erased, block, count);
+            io_stats.scrub_blocks += count;
+        } else {
+            io_stats.errors++;
+        }
+
+        io_stats.scrub_erases++;
+
+        scrub.cursor += count;
+        erases++;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Called by lfs_fs_traverse for each block in use by the filesystem.
+ *
+ * @param data: Number of blocks in use (uint32_t), counted by the traversal
+ */
+static int scrub_mark_used(void *data, lfs_block_t block) {
+    // Blocks of metadata pairs may be visited more than once
+    if (!block_bitmap_get(scrub.used, block)) {
+        block_bitmap_set(scrub.used, block, 1);
+        (*(uint32_t *) data)++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Finds the largest erase the scrubber can do starting at a block.
+ *
+ * A 32K or 64K erase is only used if it is aligned and all of its blocks are free and not yet erased,
+ * so no block is erased more than once per pass.
+ *
+ * @param block: First block of the erase
+ * @return Number of blocks to erase: SCRUB_BLOCKS_64K, SCRUB_BLOCKS_32K, 1, or 0 if the block doesn't need scrubbing
+ */
+static uint32_t scrub_run_blocks(uint32_t block) {
+    static const uint32_t run_sizes[] = { SCRUB_BLOCKS_64K, SCRUB_BLOCKS_32K, 1U };
+
+    for (uint8_t i = 0; i < (sizeof(run_sizes) / sizeof(run_sizes[0])); i++) {
+        uint32_t count = run_sizes[i];
+
+        if (((block % count) != 0) || ((block + count) > EXT_FLASH_BLOCK_COUNT)) {
+            continue;
+        }
+
+        uint32_t free = 0;
+
+        while ((free < count) && !block_bitmap_get(scrub.used, block + free) && !block_bitmap_get(scrub.erased, block + free)) {
+            free++;
+        }
+
+        if (free == count) {
+            return count;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Abandons the current pass of the scrubber and forgets which blocks are erased and in use.
+ *
+ * @param mounted: Whether the filesystem is mounted and can be scrubbed
+ */
+static void scrub_reset(bool mounted) {
+    memset(scrub.erased, 0, sizeof(scrub.erased));
+    io_stats.blocks_used = 0;
+    scrub.used_valid = false;
+    scrub.cursor = 0;
+    scrub.mounted = mounted;
+}
+
+/**
+ * @brief Computes the time elapsed since the start of an operation.
+ *
+ * @param start_ticks: Tick count at the start of the operation
+ * @param start_us: Value of FS_TIME_US() at the start of the operation
+ * @return Elapsed time in microseconds
+ */
+static uint32_t fs_elapsed_us(TickType_t start_ticks, uint32_t start_us) {
+    TickType_t elapsed_ticks = xTaskGetTickCount() - start_ticks;
+
+    if (elapsed_ticks > FS_FINE_TIMING_MAX_TICKS) {
+        return (uint32_t) elapsed_ticks * portTICK_PERIOD_MS * 1000U;
+    }
+
+    return FS_TIME_US() - start_us;
+}
+
+/**
+ * @brief Records the duration of an operation in its statistics.
+ *
+ * @param stats: Statistics of the operation
+ * @param start_ticks: Tick count at the start of the operation
+ * @param start_us: Value of FS_TIME_US() at the start of the operation
+ */
+static void fs_record_latency(fs_latency_stats_t *stats, TickType_t start_ticks, uint32_t start_us) {
+    uint32_t elapsed_us = fs_elapsed_us(start_ticks, start_us);
+    uint8_t bin = 0;
+
+    while ((bin < (FS_LATENCY_HIST_BINS - 1U)) && (elapsed_us >= ((uint32_t) FS_LATENCY_HIST_BASE_US << bin))) {
+        bin++;
+    }
+
+    taskENTER_CRITICAL();
+
+    stats->count++;
+    stats->max_us   = MAX(stats->max_us, elapsed_us);
+    stats->total_us = ((UINT32_MAX - stats->total_us) < elapsed_us) ? UINT32_MAX : (stats->total_us + elapsed_us);
+    stats->hist[bin]++;
+
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Checks the bit of a block in a block bitmap.
+ */
+static bool block_bitmap_get(const uint32_t *bitmap, uint32_t block) {
+    return (block < EXT_FLASH_BLOCK_COUNT) && ((bitmap[block / 32U] & (1UL << (block % 32U))) != 0);
+}
+
+/**
+ * @brief Sets the bits of a run of blocks in a block bitmap.
+ */
+static void block_bitmap_set(uint32_t *bitmap, uint32_t block, uint32_t count) {
+    for (uint32_t b = block; (b < (block + count)) && (b < EXT_FLASH_BLOCK_COUNT); b++) {
+        bitmap[b / 32U] |= (1UL << (b % 32U));
+    }
+}
+
+/**
+ * @brief Clears the bits of a run of blocks in a block bitmap.
+ */
+static void block_bitmap_clear(uint32_t *bitmap, uint32_t block, uint32_t count) {
+    for (uint32_t b = block; (b < (block + count)) && (b < EXT_FLASH_BLOCK_COUNT); b++) {
+        bitmap[b / 32U] &= ~(1UL << (b % 32U));
+    }
+}
 #endif
@@ -13,6 +13,58 @@
 // OBC
 #include "obc_error.h"
 
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/**
+ * @brief Size in bytes of the write ring used by @ref fs_write_enqueue. Must be a power of 2.
+ *
+ * Can be overridden with a compile definition.
+ */
+#ifndef FS_WRITE_RING_SIZE
+#define FS_WRITE_RING_SIZE      4096U
+#endif
+
+/**
+ * @brief Max number of writes that can be waiting in the write ring. Must be a power of 2.
+ *
+ * Can be overridden with a compile definition.
+ */
+#ifndef FS_WRITE_RING_RECORDS
+#define FS_WRITE_RING_RECORDS   64U
+#endif
+
+/**
+ * @brief Largest write accepted by @ref fs_write_enqueue
+ */
+#define FS_WRITE_MAX_SIZE       (FS_WRITE_RING_SIZE / 2U)
+
+/**
+ * @brief Max number of distinct files that can be written with @ref fs_write_enqueue
+ */
+#define FS_MAX_HANDLES          16U
+
+/**
+ * @brief Max length of the filename of a write ring handle, including the terminator
+ */
+#define FS_HANDLE_NAME_MAX_SIZE 20U
+
+/**
+ * @brief Max length of a path passed to or returned by @ref fs_stat and @ref fs_list, including the terminator
+ */
+#define FS_PATH_MAX_SIZE        64U
+
+/**
+ * @brief Number of buckets in each filesystem latency histogram.
+ *
+ * Bucket 0 counts operations that took less than FS_LATENCY_HIST_BASE_US. Bucket i (i > 0)
+ * counts operations that took [BASE << (i - 1), BASE << i) us. The last bucket also counts
+ * everything longer than that.
+ */
+#define FS_LATENCY_HIST_BINS    16U
+#define FS_LATENCY_HIST_BASE_US 1024U
+
 /******************************************************************************/
 /*                              T Y P E D E F S                               */
 /******************************************************************************/
@@ -23,6 +75,80 @@ typedef enum {
     FS_SEEK_END     = 2,   // Seek relative to the end of the file
 } fs_whence_flags;
 
+/**
+ * @brief Type of a directory entry (same values as the LFS types)
+ */
+typedef enum {
+    FS_TYPE_FILE    = 1,
+    FS_TYPE_DIR     = 2,
+} fs_entry_type_t;
+
+/**
+ * @brief Type, size and name of a file or directory
+ */
+typedef struct {
+    uint8_t type;               // See fs_entry_type_t
+    uint32_t size;              // Size in bytes (0 for directories)
+    char name[FS_PATH_MAX_SIZE];
+} fs_entry_info_t;
+
+/**
+ * @brief Handle of a file written through the write ring (see @ref fs_get_handle)
+ */
+typedef uint8_t fs_handle_t;
+
+/**
+ * @brief Write ring statistics
+ */
+typedef struct {
+    uint32_t enqueued;          // Number of writes accepted
+    uint32_t enqueued_bytes;    // Number of bytes accepted
+    uint32_t dropped;           // Number of writes rejected because the ring was full
+    uint32_t dropped_bytes;     // Number of bytes rejected because the ring was full
+    uint32_t high_water;        // Max number of bytes waiting in the ring
+    uint32_t flushes;           // Number of flushes that wrote data to flash
+    uint32_t flush_errors;      // Number of flushes that failed
+    uint32_t flushed_bytes;     // Number of bytes written to flash by flushes
+} fs_write_stats_t;
+
+/**
+ * @brief Duration statistics of a filesystem operation
+ */
+typedef struct {
+    uint32_t count;             // Number of operations
+    uint32_t max_us;            // Longest duration
+    uint32_t total_us;          // Sum of all durations (saturating)
+    uint32_t hist[FS_LATENCY_HIST_BINS];
+} fs_latency_stats_t;
+
+/**
+ * @brief Block device statistics (the flash operations performed by LFS) and flush durations
+ */
+typedef struct {
+    uint32_t reads;             // Number of reads
+    uint32_t read_bytes;        // Number of bytes read
+    uint32_t progs;             // Number of programs
+    uint32_t prog_bytes;        // Number of bytes programmed
+    uint32_t erases;            // Number of blocks erased on demand by LFS
+    uint32_t erases_skipped;    // Number of blocks LFS asked to erase that were already pre-erased
+    uint32_t scrub_erases;      // Number of erases issued by the scrubber
+    uint32_t scrub_blocks;      // Number of blocks erased by the scrubber
+    uint32_t errors;            // Number of failed block device operations
+    uint32_t blocks_used;       // Number of blocks in use at the last traversal of the filesystem
+    fs_latency_stats_t flush;   // Flushes of the write ring that wrote data
+    fs_latency_stats_t sync;    // Syncs of the files kept open by the flush
+} fs_io_stats_t;
+
+/**
+ * @brief Statistics of a file written through the write ring
+ */
+typedef struct {
+    char name[FS_HANDLE_NAME_MAX_SIZE];
+    uint32_t enqueued_bytes;    // Number of bytes accepted by the write ring
+    uint32_t dropped_bytes;     // Number of bytes rejected because the ring was full
+    uint32_t flushed_bytes;     // Number of bytes written to the file by flushes
+} fs_file_stats_t;
+
 /******************************************************************************/
 /*                             F U N C T I O N S                              */
 /******************************************************************************/
@@ -33,16 +159,31 @@ void filesystem_post_init(void);
 fs_err_t fs_open(lfs_file_t *file, const char *filename, uint16_t mutex_timeout);
 fs_err_t fs_close(lfs_file_t *file);
 
-fs_err_t fs_write_enqueue(const uint8_t *buf, size_t size, const char *filename, uint16_t mutex_timeout);
+fs_err_t fs_get_handle(const char *filename, fs_handle_t *handle, uint16_t mutex_timeout);
+fs_err_t fs_write_enqueue(fs_handle_t handle, const uint8_t *buf, size_t size);
 fs_err_t fs_write(lfs_file_t *file, const uint8_t *buf, size_t size);
 fs_err_t fs_read(lfs_file_t *file, uint8_t *buf, size_t size);
 
+fs_err_t fs_flush(uint16_t mutex_timeout);
 fs_err_t fs_force_flush(uint16_t mutex_timeout);
+fs_err_t fs_sync(uint16_t mutex_timeout);
+fs_err_t fs_scrub(uint16_t mutex_timeout);
+void fs_get_write_stats(fs_write_stats_t *stats);
+void fs_reset_write_stats(void);
+void fs_get_io_stats(fs_io_stats_t *stats);
+fs_err_t fs_get_file_stats(fs_handle_t handle, fs_file_stats_t *stats);
+fs_err_t fs_get_commit_progress(fs_handle_t handle, uint32_t *enqueued, uint32_t *committed);
+fs_err_t fs_reset_io_stats(uint16_t mutex_timeout);
 
 fs_err_t fs_seek(lfs_file_t *file, int32_t offset, fs_whence_flags whence);
 fs_err_t fs_zero(lfs_file_t *file);
 fs_err_t fs_truncate(lfs_file_t *file, int32_t size);
 fs_err_t fs_remove(const char *filename, uint16_t mutex_timeout);
+fs_err_t fs_rename(const char *oldpath, const char *newpath, uint16_t mutex_timeout);
+fs_err_t fs_stat(const char *path, fs_entry_info_t *info, uint16_t mutex_timeout);
+fs_err_t fs_read_at(const char *filename, uint32_t offset, uint8_t *buf, uint32_t size, uint32_t *bytes_read, uint16_t mutex_timeout);
+fs_err_t fs_list(const char *path, uint16_t start, fs_entry_info_t *entries, uint16_t max_entries, uint16_t *count, uint16_t *total,
+                 uint16_t mutex_timeout);
 int32_t fs_tell(lfs_file_t *file);
 int32_t fs_size(lfs_file_t *file);
 
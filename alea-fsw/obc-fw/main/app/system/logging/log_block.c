@@ -0,0 +1,164 @@
+/**
+ * @file log_block.c
+ * @brief Block-framed compact encoding of logs saved to the filesystem
+ *
+ * Replaces the fixed 7-byte header and 4-byte delimiter of every log with one sync marker and CRC per
+ * block. Logs are typically a few bytes apart in time with small IDs and payloads, so most records
+ * only need 4 bytes on top of their payload.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "log_block.h"
+
+// Utils
+#include "obc_crc.h"
+#include "data_fmt.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define LEN_OFFSET      LOG_BLOCK_SYNC_SIZE
+#define EPOCH_OFFSET    (LOG_BLOCK_SYNC_SIZE + 2U)
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Start a new, empty block
+ */
+void log_block_init(log_block_t *block) {
+    block->len          = LOG_BLOCK_HEADER_SIZE;
+    block->record_count = 0;
+    block->epoch_prev   = 0;
+    block->epoch_min    = 0;
+    block->epoch_max    = 0;
+    block->log_id_mask  = 0;
+
+    data_fmt_u32_to_arr_be(LOG_BLOCK_SYNC, block->buf);
+}
+
+/**
+ * @brief Append a record to a block
+ *
+ * @param[in,out] block       Block to add to
+ * @param[in]     epoch       Timestamp of the log
+ * @param[in]     log_id      Log ID
+ * @param[in]     sig_id      Signal ID
+ * @param[in]     payload     Payload of the log
+ * @param[in]     payload_len Size of the payload
+ *
+ * @return true if the record was added, false if it doesn't fit (the block is unchanged)
+ */
+bool log_block_add(log_block_t *block, uint32_t epoch, uint8_t log_id, uint8_t sig_id, const uint8_t *payload, uint8_t payload_len) {
+    uint8_t header[LOG_BLOCK_VARINT_MAX_SIZE + 6U];
+    uint32_t header_len = 0;
+
+    if (block->record_count == 0) {
+        data_fmt_u32_to_arr_be(epoch, &block->buf[EPOCH_OFFSET]);
+        block->epoch_prev = epoch;
+        block->epoch_min  = epoch;
+        block->epoch_max  = epoch;
+    }
+
+    // Zigzag encoding keeps small negative deltas (e.g. the RTC being set back) small
+    int32_t delta = (int32_t)(epoch - block->epoch_prev);
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+
+    header_len += log_block_varint_encode(zigzag, &header[header_len]);
+    header_len += log_block_varint_encode(log_id, &header[header_len]);
+    header_len += log_block_varint_encode(sig_id, &header[header_len]);
+    header_len += log_block_varint_encode(payload_len, &header[header_len]);
+
+    if ((header_len + payload_len) > (LOG_BLOCK_MAX_SIZE - LOG_BLOCK_CRC_SIZE - block->len)) {
+        return false;
+    }
+
+    memcpy(&block->buf[block->len], header, header_len);
+    block->len += header_len;
+
+    if (payload_len > 0) {
+        memcpy(&block->buf[block->len], payload, payload_len);
+        block->len += payload_len;
+    }
+
+    block->record_count++;
+    block->epoch_prev   = epoch;
+    block->epoch_min    = (epoch < block->epoch_min) ? epoch : block->epoch_min;
+    block->epoch_max    = (epoch > block->epoch_max) ? epoch : block->epoch_max;
+    block->log_id_mask |= (1UL << (log_id % 32U));
+
+    return true;
+}
+
+/**
+ * @brief Fill in the length and CRC of a block
+ *
+ * @return Size of the block, or 0 if it has no records
+ */
+uint32_t log_block_finish(log_block_t *block) {
+    if (block->record_count == 0) {
+        return 0;
+    }
+
+    uint16_t data_len = block->len - LOG_BLOCK_HEADER_SIZE;
+    block->buf[LEN_OFFSET]      = (uint8_t)(data_len >> 8);
+    block->buf[LEN_OFFSET + 1U] = (uint8_t)(data_len);
+
+    uint32_t crc = crc_32_buf(CRC32_SEED, &block->buf[LEN_OFFSET], block->len - LEN_OFFSET);
+    data_fmt_u32_to_arr_be(crc, &block->buf[block->len]);
+
+    return block->len + LOG_BLOCK_CRC_SIZE;
+}
+
+/**
+ * @brief Encode an unsigned LEB128 varint
+ *
+ * @param[in]  value Value to encode
+ * @param[out] buf   Buffer of at least LOG_BLOCK_VARINT_MAX_SIZE bytes
+ *
+ * @return Number of bytes written
+ */
+uint32_t log_block_varint_encode(uint32_t value, uint8_t *buf) {
+    uint32_t len = 0;
+
+    while (value >= 0x80U) {
+        buf[len++] = (uint8_t)(value | 0x80U);
+        value >>= 7;
+    }
+
+    buf[len++] = (uint8_t)value;
+
+    return len;
+}
+
+/**
+ * @brief Decode an unsigned LEB128 varint
+ *
+ * @param[in]  buf   Buffer to decode from
+ * @param[in]  len   Number of bytes available in buf
+ * @param[out] value Decoded value
+ *
+ * @return Number of bytes used, or 0 if the varint is truncated or too long
+ */
+uint32_t log_block_varint_decode(const uint8_t *buf, uint32_t len, uint32_t *value) {
+    uint32_t result = 0;
+
+    for (uint32_t i = 0; (i < len) && (i < LOG_BLOCK_VARINT_MAX_SIZE); i++) {
+        result |= (uint32_t)(buf[i] & 0x7FU) << (7U * i);
+
+        if ((buf[i] & 0x80U) == 0) {
+            *value = result;
+            return i + 1U;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file log_block.h
+ * @brief Block-framed compact encoding of logs saved to the filesystem
+ *
+ * Block layout (multi-byte fields are big-endian):
+ *
+ *  | sync (4) | len (2) | epoch (4) | records (len) | crc32 (4) |
+ *
+ * - sync:  LOG_BLOCK_SYNC, used to find blocks when reading from an arbitrary offset
+ * - len:   number of bytes of records
+ * - epoch: timestamp the first record's delta is relative to
+ * - crc32: CRC32 (seeded with CRC32_SEED) of len, epoch and records
+ *
+ * Each record is a sequence of unsigned LEB128 varints followed by the payload:
+ *
+ *  | epoch delta (zigzag) | log_id | sig_id | payload size | payload |
+ *
+ * The epoch delta of a record is relative to the previous record in the block (the block epoch for the first one).
+ */
+
+#ifndef LOG_BLOCK_H_
+#define LOG_BLOCK_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define LOG_BLOCK_SYNC              0xBEEEEEEFUL
+#define LOG_BLOCK_SYNC_SIZE         4U
+#define LOG_BLOCK_HEADER_SIZE       (LOG_BLOCK_SYNC_SIZE + 2U + 4U)
+#define LOG_BLOCK_CRC_SIZE          4U
+
+/**
+ * @brief Maximum size of a block, including the header and CRC
+ */
+#define LOG_BLOCK_MAX_SIZE          512U
+#define LOG_BLOCK_MAX_DATA_SIZE     (LOG_BLOCK_MAX_SIZE - LOG_BLOCK_HEADER_SIZE - LOG_BLOCK_CRC_SIZE)
+
+/**
+ * @brief Maximum size of a varint encoding a uint32_t
+ */
+#define LOG_BLOCK_VARINT_MAX_SIZE   5U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Block being encoded
+ */
+typedef struct {
+    uint8_t buf[LOG_BLOCK_MAX_SIZE];
+    uint16_t len;               // Bytes of buf used, including the header
+    uint16_t record_count;
+    uint32_t epoch_prev;        // Timestamp of the last record added
+    uint32_t epoch_min;
+    uint32_t epoch_max;
+    uint32_t log_id_mask;       // Bit (log_id % 32) is set for every log ID in the block
+} log_block_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void log_block_init(log_block_t *block);
+bool log_block_add(log_block_t *block, uint32_t epoch, uint8_t log_id, uint8_t sig_id, const uint8_t *payload, uint8_t payload_len);
+uint32_t log_block_finish(log_block_t *block);
+
+uint32_t log_block_varint_encode(uint32_t value, uint8_t *buf);
+uint32_t log_block_varint_decode(const uint8_t *buf, uint32_t len, uint32_t *value);
+
+#endif /* LOG_BLOCK_H_ */
@@ -0,0 +1,202 @@
+/**
+ * @file log_filter.c
+ * @brief Runtime filtering of logs by signal and severity
+ *
+ * Every signal in log_specs.json has a slot in the generated filter tables (log_filter_gen.c) holding
+ * its severity and default destinations. The ground can change the destinations of each signal and
+ * of each severity. Both are combined into a table of active destinations so checking whether a log
+ * is enabled is a single lookup.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "log_filter.h"
+#include "log_filter_gen.h"
+
+// FreeRTOS
+#include "rtos.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static void update_active_sinks(void);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+/* Destinations of each signal, set from the ground */
+static uint8_t signal_sinks[LOG_SIGNAL_COUNT];
+
+/* Destinations of each severity, set from the ground */
+static uint8_t level_sinks[LOG_LEVEL_COUNT];
+
+/* signal_sinks masked by level_sinks, read on every log */
+static uint8_t active_sinks[LOG_SIGNAL_COUNT];
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Load the default destinations from the log specifications
+ *
+ * Logs are suppressed until this is called.
+ */
+void log_filter_init(void) {
+    log_filter_reset();
+}
+
+/**
+ * @brief Check if a signal is written to any destination
+ *
+ * @param signal_idx Slot of the signal in the generated filter tables
+ */
+bool log_filter_enabled(uint16_t signal_idx) {
+    return (signal_idx < LOG_SIGNAL_COUNT) && (active_sinks[signal_idx] != 0);
+}
+
+/**
+ * @brief Get the destinations of a signal
+ *
+ * @return Bitmap of log_sink_t, 0 if the signal is suppressed or does not exist
+ */
+uint8_t log_filter_get_sinks(uint8_t log_id, uint8_t sig_id) {
+    if ((log_id >= LOG_ID_COUNT) || (sig_id >= LOG_SIGNAL_NUM[log_id])) {
+        return 0;
+    }
+
+    return active_sinks[LOG_SIGNAL_BASE[log_id] + sig_id];
+}
+
+/**
+ * @brief Get the severity of a signal
+ *
+ * @return log_level_t of the signal, 0 (DEBUG) if the signal does not exist
+ */
+uint8_t log_filter_get_level(uint8_t log_id, uint8_t sig_id) {
+    if ((log_id >= LOG_ID_COUNT) || (sig_id >= LOG_SIGNAL_NUM[log_id])) {
+        return 0;
+    }
+
+    return LOG_SIGNAL_LEVEL[LOG_SIGNAL_BASE[log_id] + sig_id];
+}
+
+/**
+ * @brief Set the destinations of a signal
+ *
+ * @param log_id Log ID of the signal
+ * @param sig_id Signal ID, or LOG_FILTER_ALL_SIGNALS for every signal of the log ID
+ * @param sinks  Bitmap of log_sink_t
+ *
+ * @return true if successful, false if the signal does not exist
+ */
+bool log_filter_set_signal(uint8_t log_id, uint8_t sig_id, uint8_t sinks) {
+    if ((log_id >= LOG_ID_COUNT) || ((sig_id != LOG_FILTER_ALL_SIGNALS) && (sig_id >= LOG_SIGNAL_NUM[log_id]))) {
+        return false;
+    }
+
+    uint16_t first = LOG_SIGNAL_BASE[log_id] + ((sig_id == LOG_FILTER_ALL_SIGNALS) ? 0 : sig_id);
+    uint16_t count = (sig_id == LOG_FILTER_ALL_SIGNALS) ? LOG_SIGNAL_NUM[log_id] : 1U;
+
+    taskENTER_CRITICAL();
+
+    for (uint16_t i = first; i < (first + count); i++) {
+        signal_sinks[i] = sinks & LOG_SINK_ALL;
+    }
+
+    update_active_sinks();
+
+    taskEXIT_CRITICAL();
+
+    return true;
+}
+
+/**
+ * @brief Set the destinations of every signal of a severity
+ *
+ * A signal is only written to the destinations enabled for both the signal and its severity.
+ *
+ * @param level Severity (log_level_t)
+ * @param sinks Bitmap of log_sink_t
+ *
+ * @return true if successful, false if the severity is invalid
+ */
+bool log_filter_set_level(uint8_t level, uint8_t sinks) {
+    if (level >= LOG_LEVEL_COUNT) {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+
+    level_sinks[level] = sinks & LOG_SINK_ALL;
+    update_active_sinks();
+
+    taskEXIT_CRITICAL();
+
+    return true;
+}
+
+/**
+ * @brief Restore the destinations from the log specifications and enable every severity
+ */
+void log_filter_reset(void) {
+    taskENTER_CRITICAL();
+
+    memcpy(signal_sinks, LOG_SIGNAL_SINKS, sizeof(signal_sinks));
+    memset(level_sinks, LOG_SINK_ALL, sizeof(level_sinks));
+    update_active_sinks();
+
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Get the destinations set for each signal of a log ID (not masked by severity)
+ *
+ * @param[in]  log_id    Log ID
+ * @param[out] sinks     Destinations of each signal, indexed by signal ID
+ * @param[in]  max_sinks Size of sinks
+ * @param[out] count     Number of signals written to sinks
+ *
+ * @return true if successful, false if the log ID does not exist
+ */
+bool log_filter_get_group(uint8_t log_id, uint8_t *sinks, uint8_t max_sinks, uint8_t *count) {
+    if (log_id >= LOG_ID_COUNT) {
+        return false;
+    }
+
+    uint8_t n = (LOG_SIGNAL_NUM[log_id] < max_sinks) ? LOG_SIGNAL_NUM[log_id] : max_sinks;
+
+    memcpy(sinks, &signal_sinks[LOG_SIGNAL_BASE[log_id]], n);
+    *count = n;
+
+    return true;
+}
+
+/**
+ * @brief Get the destinations set for each severity
+ */
+void log_filter_get_levels(uint8_t levels[LOG_LEVEL_COUNT]) {
+    memcpy(levels, level_sinks, LOG_LEVEL_COUNT);
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Recompute the active destinations of every signal
+ *
+ * Must be called from a critical section.
+ */
+static void update_active_sinks(void) {
+    for (uint16_t i = 0; i < LOG_SIGNAL_COUNT; i++) {
+        active_sinks[i] = signal_sinks[i] & level_sinks[LOG_SIGNAL_LEVEL[i]];
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ * @file log_filter.h
+ * @brief Runtime filtering of logs by signal and severity
+ */
+
+#ifndef LOG_FILTER_H_
+#define LOG_FILTER_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define LOG_SINK_ALL            (LOG_SINK_SERIAL | LOG_SINK_FS)
+
+/**
+ * @brief Passed as the signal ID to apply a setting to every signal of a log ID
+ */
+#define LOG_FILTER_ALL_SIGNALS  0xFFU
+
+#define LOG_LEVEL_COUNT         4U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Destinations a log can be written to (bitmap)
+ */
+typedef enum {
+    LOG_SINK_SERIAL = 0x01U, ///< OBC serial port
+    LOG_SINK_FS     = 0x02U, ///< Log files (downlinked with GET_LOGS)
+} log_sink_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void log_filter_init(void);
+
+bool log_filter_enabled(uint16_t signal_idx);
+uint8_t log_filter_get_sinks(uint8_t log_id, uint8_t sig_id);
+uint8_t log_filter_get_level(uint8_t log_id, uint8_t sig_id);
+
+bool log_filter_set_signal(uint8_t log_id, uint8_t sig_id, uint8_t sinks);
+bool log_filter_set_level(uint8_t level, uint8_t sinks);
+void log_filter_reset(void);
+
+bool log_filter_get_group(uint8_t log_id, uint8_t *sinks, uint8_t max_sinks, uint8_t *count);
+void log_filter_get_levels(uint8_t levels[LOG_LEVEL_COUNT]);
+
+#endif // LOG_FILTER_H_
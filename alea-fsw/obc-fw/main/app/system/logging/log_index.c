@@ -0,0 +1,343 @@
+/**
+ * @file log_index.c
+ * @brief Sparse time/log ID index of the log files
+ *
+ * Each log file has an index file next to it (log_N.idx) holding one entry per ~LOG_INDEX_BLOCK_SIZE
+ * bytes of logs, with the time range and log IDs of the records in that block. Entries are appended
+ * through the write ring as the log writer saves logs, so the index costs one small write per block.
+ * The entry of the block being filled is kept in RAM until the block is complete.
+ *
+ * All functions except log_index_entry_matches must be called with logSysMutex held.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "log_index.h"
+#include "log_sys.h"
+
+// OBC
+#include "obc_filesystem.h"
+#include "obc_featuredefs.h"
+
+// Utils
+#include "data_fmt.h"
+#include "obc_utils.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define ITER_STAGE_STORED   0U  // Entries in the index file
+#define ITER_STAGE_RAM      1U  // Entry of the block being filled
+#define ITER_STAGE_TAIL     2U  // Rest of the log file
+#define ITER_STAGE_DONE     3U
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static fs_err_t iter_peek(log_index_iter_t *iter, log_index_entry_t *entry, bool *found, uint16_t mutex_timeout);
+static void iter_consume(log_index_iter_t *iter);
+static bool entry_valid(const log_index_iter_t *iter, const log_index_entry_t *entry);
+static void entry_unindexed(log_index_entry_t *entry, uint32_t offset, uint32_t size);
+static void entry_encode(const log_index_entry_t *entry, uint8_t buf[LOG_INDEX_ENTRY_SIZE]);
+static void entry_decode(log_index_entry_t *entry, const uint8_t buf[LOG_INDEX_ENTRY_SIZE]);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static const char *LOG_INDEX_FILE_NAMES[] = {"log_0.idx", "log_1.idx", "log_2.idx", "log_3.idx"};
+static fs_handle_t index_file_handles[FS_LOGGING_FILES_NUM];
+
+/* Entry of the block being filled in each log file */
+static log_index_entry_t current_entries[FS_LOGGING_FILES_NUM] = { 0 };
+
+static lfs_file_t index_file = { 0 };
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Get the write ring handles of the index files
+ *
+ * The entries of the blocks that were being filled before a reset are lost, those parts of the log
+ * files are returned as unindexed entries.
+ */
+fs_err_t log_index_init(uint16_t mutex_timeout) {
+    for (uint8_t i = 0; i < FS_LOGGING_FILES_NUM; i++) {
+        fs_err_t err = fs_get_handle(LOG_INDEX_FILE_NAMES[i], &index_file_handles[i], mutex_timeout);
+
+        if (err != FS_OK) {
+            return err;
+        }
+    }
+
+    memset(current_entries, 0, sizeof(current_entries));
+
+    return FS_OK;
+}
+
+/**
+ * @brief Add a block of logs saved to a log file to the index
+ *
+ * @param[in] file_idx    Log file the block was saved to
+ * @param[in] offset      Offset of the block in the log file
+ * @param[in] size        Size of the block
+ * @param[in] epoch_min   Earliest timestamp in the block
+ * @param[in] epoch_max   Latest timestamp in the block
+ * @param[in] log_id_mask Log IDs in the block (bit log_id % 32)
+ *
+ * @return FS_OK if successful, error code if a completed entry couldn't be queued for writing
+ */
+fs_err_t log_index_add(uint8_t file_idx, uint32_t offset, uint32_t size, uint32_t epoch_min, uint32_t epoch_max, uint32_t log_id_mask) {
+    if (file_idx >= FS_LOGGING_FILES_NUM) {
+        return FS_INVAL_ERR;
+    }
+
+    log_index_entry_t *entry = &current_entries[file_idx];
+    fs_err_t err = FS_OK;
+
+    // Complete the entry once the block is full, or if records went missing from the file
+    if ((entry->size > 0) && ((entry->size >= LOG_INDEX_BLOCK_SIZE) || (offset != (entry->offset + entry->size)))) {
+        uint8_t buf[LOG_INDEX_ENTRY_SIZE];
+        entry_encode(entry, buf);
+
+        err = fs_write_enqueue(index_file_handles[file_idx], buf, sizeof(buf));
+        entry->size = 0;
+    }
+
+    if (entry->size == 0) {
+        entry->offset      = offset;
+        entry->epoch_min   = epoch_min;
+        entry->epoch_max   = epoch_max;
+        entry->log_id_mask = 0;
+    }
+
+    entry->size        += size;
+    entry->epoch_min    = MIN(entry->epoch_min, epoch_min);
+    entry->epoch_max    = MAX(entry->epoch_max, epoch_max);
+    entry->log_id_mask |= log_id_mask;
+
+    return err;
+}
+
+/**
+ * @brief Clear the index of a log file when the log file is zeroed
+ */
+fs_err_t log_index_reset(uint8_t file_idx, uint16_t mutex_timeout) {
+    if (file_idx >= FS_LOGGING_FILES_NUM) {
+        return FS_INVAL_ERR;
+    }
+
+    memset(&current_entries[file_idx], 0, sizeof(current_entries[file_idx]));
+
+    fs_err_t err = fs_open(&index_file, LOG_INDEX_FILE_NAMES[file_idx], mutex_timeout);
+
+    if (err != FS_OK) {
+        return err;
+    }
+
+    err = fs_zero(&index_file);
+    fs_err_t close_err = fs_close(&index_file);
+
+    return (err != FS_OK) ? err : close_err;
+}
+
+/**
+ * @brief Start iterating over the entries of a log file, in file order
+ *
+ * @param[out] iter       Iteration state
+ * @param[in]  file_idx   Log file
+ * @param[in]  log_size   Size of the log file. Entries past the end of the file are ignored.
+ */
+void log_index_iter_begin(log_index_iter_t *iter, uint8_t file_idx, uint32_t log_size) {
+    memset(iter, 0, sizeof(*iter));
+
+    iter->file_idx = file_idx;
+    iter->log_size = log_size;
+    iter->stage    = (file_idx < FS_LOGGING_FILES_NUM) ? ITER_STAGE_STORED : ITER_STAGE_DONE;
+}
+
+/**
+ * @brief Get the next entry of a log file
+ *
+ * The entries returned cover the whole log file without gaps or overlaps.
+ *
+ * @param[in,out] iter          Iteration state
+ * @param[out]    entry         Next entry
+ * @param[out]    found         false once the end of the log file is reached
+ * @param[in]     mutex_timeout Timeout to wait for mutex to access flash
+ *
+ * @return FS_OK if successful, error code otherwise
+ */
+fs_err_t log_index_iter_next(log_index_iter_t *iter, log_index_entry_t *entry, bool *found, uint16_t mutex_timeout) {
+    log_index_entry_t next;
+
+    fs_err_t err = iter_peek(iter, &next, found, mutex_timeout);
+
+    if ((err != FS_OK) || !(*found)) {
+        return err;
+    }
+
+    if (next.offset > iter->expected) {
+        // Part of the file that isn't indexed, the next entry is returned by the following call
+        entry_unindexed(entry, iter->expected, next.offset - iter->expected);
+    } else {
+        iter_consume(iter);
+        *entry = next;
+    }
+
+    iter->expected = entry->offset + entry->size;
+
+    return FS_OK;
+}
+
+/**
+ * @brief Check if an entry may contain records in a time range with a log ID
+ *
+ * @param[in] entry        Entry to check
+ * @param[in] epoch_start  Start of the time range (inclusive)
+ * @param[in] epoch_end    End of the time range (inclusive)
+ * @param[in] log_id       Log ID, or LOG_INDEX_ALL_IDS
+ */
+bool log_index_entry_matches(const log_index_entry_t *entry, uint32_t epoch_start, uint32_t epoch_end, uint8_t log_id) {
+    if ((entry->epoch_max < epoch_start) || (entry->epoch_min > epoch_end)) {
+        return false;
+    }
+
+    return (log_id == LOG_INDEX_ALL_IDS) || ((entry->log_id_mask & (1UL << (log_id % 32U))) != 0);
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Get the next entry from the index file, the RAM entry or the rest of the file, without consuming it
+ */
+static fs_err_t iter_peek(log_index_iter_t *iter, log_index_entry_t *entry, bool *found, uint16_t mutex_timeout) {
+    *found = false;
+
+    while (iter->stage != ITER_STAGE_DONE) {
+        switch (iter->stage) {
+        case ITER_STAGE_STORED:
+            if (iter->buf_pos == iter->buf_count) {
+                uint32_t bytes_read = 0;
+                fs_err_t err = fs_read_at(LOG_INDEX_FILE_NAMES[iter->file_idx], iter->stored_next * LOG_INDEX_ENTRY_SIZE, iter->buf,
+                                          sizeof(iter->buf), &bytes_read, mutex_timeout);
+
+                if ((err != FS_OK) && (err != FS_NOENT_ERR)) {
+                    return err;
+                }
+
+                iter->buf_pos   = 0;
+                iter->buf_count = (uint8_t)(bytes_read / LOG_INDEX_ENTRY_SIZE);
+
+                if (iter->buf_count == 0) {
+                    iter->stage = ITER_STAGE_RAM;
+                    break;
+                }
+            }
+
+            entry_decode(entry, &iter->buf[iter->buf_pos * LOG_INDEX_ENTRY_SIZE]);
+
+            // The rest of the index is out of step with the log file (e.g. entries lost to a full write ring)
+            if (!entry_valid(iter, entry)) {
+                iter->stage = ITER_STAGE_RAM;
+                break;
+            }
+
+            *found = true;
+            return FS_OK;
+
+        case ITER_STAGE_RAM:
+            *entry = current_entries[iter->file_idx];
+
+            if (entry_valid(iter, entry)) {
+                *found = true;
+                return FS_OK;
+            }
+
+            iter->stage = ITER_STAGE_TAIL;
+            break;
+
+        case ITER_STAGE_TAIL:
+            if (iter->expected < iter->log_size) {
+                entry_unindexed(entry, iter->expected, iter->log_size - iter->expected);
+                *found = true;
+                return FS_OK;
+            }
+
+            iter->stage = ITER_STAGE_DONE;
+            break;
+
+        default:
+            iter->stage = ITER_STAGE_DONE;
+            break;
+        }
+    }
+
+    return FS_OK;
+}
+
+/**
+ * @brief Move past the entry returned by iter_peek
+ */
+static void iter_consume(log_index_iter_t *iter) {
+    switch (iter->stage) {
+    case ITER_STAGE_STORED:
+        iter->buf_pos++;
+        iter->stored_next++;
+        break;
+
+    case ITER_STAGE_RAM:
+        iter->stage = ITER_STAGE_TAIL;
+        break;
+
+    default:
+        iter->stage = ITER_STAGE_DONE;
+        break;
+    }
+}
+
+/**
+ * @brief Check that an entry follows the previous one and is within the log file
+ */
+static bool entry_valid(const log_index_iter_t *iter, const log_index_entry_t *entry) {
+    return (entry->size > 0) && (entry->offset >= iter->expected) && (entry->offset < iter->log_size) &&
+           (entry->size <= (iter->log_size - entry->offset));
+}
+
+/**
+ * @brief Fill an entry for part of a log file that isn't indexed, matching every time and log ID
+ */
+static void entry_unindexed(log_index_entry_t *entry, uint32_t offset, uint32_t size) {
+    entry->offset      = offset;
+    entry->size        = size;
+    entry->epoch_min   = 0;
+    entry->epoch_max   = UINT32_MAX;
+    entry->log_id_mask = UINT32_MAX;
+}
+
+static void entry_encode(const log_index_entry_t *entry, uint8_t buf[LOG_INDEX_ENTRY_SIZE]) {
+    data_fmt_u32_to_arr_be(entry->offset, &buf[0]);
+    data_fmt_u32_to_arr_be(entry->size, &buf[4]);
+    data_fmt_u32_to_arr_be(entry->epoch_min, &buf[8]);
+    data_fmt_u32_to_arr_be(entry->epoch_max, &buf[12]);
+    data_fmt_u32_to_arr_be(entry->log_id_mask, &buf[16]);
+}
+
+static void entry_decode(log_index_entry_t *entry, const uint8_t buf[LOG_INDEX_ENTRY_SIZE]) {
+    entry->offset      = data_fmt_arr_be_to_u32(&buf[0]);
+    entry->size        = data_fmt_arr_be_to_u32(&buf[4]);
+    entry->epoch_min   = data_fmt_arr_be_to_u32(&buf[8]);
+    entry->epoch_max   = data_fmt_arr_be_to_u32(&buf[12]);
+    entry->log_id_mask = data_fmt_arr_be_to_u32(&buf[16]);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file log_index.h
+ * @brief Sparse time/log ID index of the log files
+ */
+
+#ifndef LOG_INDEX_H_
+#define LOG_INDEX_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// OBC
+#include "obc_error.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/**
+ * @brief A new index entry is started once the current one covers at least this many bytes of logs
+ */
+#define LOG_INDEX_BLOCK_SIZE    4096U
+
+/**
+ * @brief Size of a serialized index entry
+ */
+#define LOG_INDEX_ENTRY_SIZE    20U
+
+/**
+ * @brief Number of entries read from the index file at a time
+ */
+#define LOG_INDEX_ITER_BATCH    8U
+
+/**
+ * @brief Passed as the log ID to match records of any log ID
+ */
+#define LOG_INDEX_ALL_IDS       0xFFU
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Range of a log file and the logs it contains
+ *
+ * Parts of a log file that are not covered by the index (e.g. the block that was being indexed
+ * when the OBC reset) are returned as entries that match every time and log ID.
+ */
+typedef struct {
+    uint32_t offset;        // Offset of the first record in the log file
+    uint32_t size;          // Number of bytes of records
+    uint32_t epoch_min;     // Earliest timestamp of the records
+    uint32_t epoch_max;     // Latest timestamp of the records
+    uint32_t log_id_mask;   // Bit (log_id % 32) is set if a record has that log ID
+} log_index_entry_t;
+
+/**
+ * @brief State of an iteration over the entries of a log file
+ */
+typedef struct {
+    uint8_t file_idx;
+    uint8_t stage;
+    uint8_t buf_count;
+    uint8_t buf_pos;
+    uint32_t stored_next;   // Index of the next entry to read from the index file
+    uint32_t log_size;      // Size of the log file
+    uint32_t expected;      // Offset the next entry should start at
+    uint8_t buf[LOG_INDEX_ITER_BATCH * LOG_INDEX_ENTRY_SIZE];
+} log_index_iter_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+fs_err_t log_index_init(uint16_t mutex_timeout);
+
+fs_err_t log_index_add(uint8_t file_idx, uint32_t offset, uint32_t size, uint32_t epoch_min, uint32_t epoch_max, uint32_t log_id_mask);
+fs_err_t log_index_reset(uint8_t file_idx, uint16_t mutex_timeout);
+
+void log_index_iter_begin(log_index_iter_t *iter, uint8_t file_idx, uint32_t log_size);
+fs_err_t log_index_iter_next(log_index_iter_t *iter, log_index_entry_t *entry, bool *found, uint16_t mutex_timeout);
+
+bool log_index_entry_matches(const log_index_entry_t *entry, uint32_t epoch_start, uint32_t epoch_end, uint8_t log_id);
+
+#endif // LOG_INDEX_H_
@@ -0,0 +1,415 @@
+/**
+ * @file log_mram.c
+ * @brief Crash-persistent ring of recent logs in MRAM
+ *
+ * Logs reach flash only once the log writer has saved them and the filesystem has flushed its write
+ * ring, so the logs leading up to a crash or watchdog reset are usually lost. Logs of at least
+ * LOG_MRAM_MIN_LEVEL are also written synchronously by the logging task to a ring in MRAM, which
+ * survives resets. After a reset, the logs that hadn't been committed to flash yet are saved to the
+ * filesystem logs by the log writer task.
+ *
+ * MRAM layout (at MRAM_LOG_RING_ADDR, multi-byte fields are big-endian):
+ *
+ *  | magic (4) | head (4) | tail (4) | synced (4) | crc32 (4) | data (LOG_MRAM_DATA_SIZE) |
+ *
+ * head, tail and synced are free-running offsets into the data area. Records in the data area are
+ * a length byte, the record (log header and payload) and a CRC16 of the length and record. Records
+ * are never split across the end of the data area, a length of 0 marks the rest of the data area
+ * as unused. synced is the offset up to which logs are known to be in the filesystem logs, either
+ * recovered after a reset or committed to flash by the log writer (see log_mram_set_synced). Logs
+ * written after the last update of synced are recovered again, so the filesystem logs may contain
+ * a few duplicates after a reset.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "log_mram.h"
+
+// OBC
+#include "obc_mram.h"
+
+// Utils
+#include "obc_crc.h"
+#include "data_fmt.h"
+
+// FreeRTOS
+#include "rtos.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define LOG_MRAM_MAGIC              0x4C4F4752UL // "LOGR"
+
+#define LOG_MRAM_DATA_ADDR          (MRAM_LOG_RING_ADDR + LOG_MRAM_HEADER_SIZE)
+#define LOG_MRAM_DATA_MASK          (LOG_MRAM_DATA_SIZE - 1U)
+
+#define LOG_MRAM_WRAP               0U
+#define LOG_MRAM_CRC_SIZE           2U
+#define LOG_MRAM_MAX_RECORD_SIZE    (1U + UINT8_MAX + LOG_MRAM_CRC_SIZE)
+
+#define LOG_MRAM_MUTEX_TIMEOUT_MS   50U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t synced;
+} log_mram_state_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static bool read_header(void);
+static bool write_header(void);
+static bool make_space(uint32_t size);
+static bool read_record(uint32_t pos, uint8_t *buf, uint32_t *size);
+static bool offset_before(uint32_t a, uint32_t b);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static SemaphoreHandle_t log_mram_mutex = NULL;
+
+static log_mram_state_t state = { 0 };
+static bool initialized = false;
+
+// End of the logs written before this boot
+static uint32_t boot_head = 0;
+
+static uint32_t write_errors = 0;
+
+// Only used with log_mram_mutex held
+static uint8_t write_buf[LOG_MRAM_MAX_RECORD_SIZE];
+
+// Only used by log_mram_recover (the log writer task)
+static uint8_t recover_buf[LOG_MRAM_MAX_RECORD_SIZE];
+
+CASSERT((LOG_MRAM_DATA_SIZE & LOG_MRAM_DATA_MASK) == 0, log_mram_data_size);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+void log_mram_pre_init(void) {
+    static StaticSemaphore_t log_mram_mutex_buf;
+    log_mram_mutex = xSemaphoreCreateMutexStatic(&log_mram_mutex_buf);
+}
+
+/**
+ * @brief Load the state of the ring from MRAM, or start a new ring if it isn't valid
+ *
+ * @pre MRAM is initialized
+ */
+void log_mram_init(void) {
+    if (xSemaphoreTake(log_mram_mutex, pdMS_TO_TICKS(LOG_MRAM_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return;
+    }
+
+    if (!read_header()) {
+        memset(&state, 0, sizeof(state));
+
+        // Writes fail if the region doesn't exist (e.g. the mock MRAM), the ring stays disabled
+        if (!write_header()) {
+            xSemaphoreGive(log_mram_mutex);
+            return;
+        }
+    }
+
+    boot_head = state.head;
+    initialized = true;
+
+    xSemaphoreGive(log_mram_mutex);
+}
+
+/**
+ * @brief Append a log to the ring, dropping the oldest logs to make space
+ *
+ * Blocks on the MRAM, so it must be called from a task, outside of critical sections.
+ *
+ * @param[in] record Log header followed by the payload
+ * @param[in] len    Size of the record
+ *
+ * @return true if the log was written
+ */
+bool log_mram_write(const uint8_t *record, uint8_t len) {
+    if (!initialized || (len == 0)) {
+        return false;
+    }
+
+    if (xSemaphoreTake(log_mram_mutex, pdMS_TO_TICKS(LOG_MRAM_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        write_errors++;
+        return false;
+    }
+
+    uint32_t size = 1U + len + LOG_MRAM_CRC_SIZE;
+    uint32_t idx  = state.head & LOG_MRAM_DATA_MASK;
+    uint32_t gap  = ((idx + size) > LOG_MRAM_DATA_SIZE) ? (LOG_MRAM_DATA_SIZE - idx) : 0;
+    bool ok = make_space(gap + size);
+
+    // Records are never split, mark the rest of the data area as unused and start again at the beginning
+    if (ok && (gap > 0)) {
+        const uint8_t wrap = LOG_MRAM_WRAP;
+        ok = (mram_write(LOG_MRAM_DATA_ADDR + idx, 1U, &wrap) == MRAM_OK);
+
+        if (ok) {
+            state.head += gap;
+            idx = 0;
+        }
+    }
+
+    if (ok) {
+        write_buf[0] = len;
+        memcpy(&write_buf[1], record, len);
+
+        uint16_t crc = crc_16_buf(CRC16_SEED, write_buf, 1U + len);
+        write_buf[1U + len]      = (uint8_t)(crc >> 8);
+        write_buf[1U + len + 1U] = (uint8_t)crc;
+
+        ok = (mram_write(LOG_MRAM_DATA_ADDR + idx, size, write_buf) == MRAM_OK);
+    }
+
+    // The header is only updated once the record is complete, a reset in between loses just this record
+    if (ok) {
+        state.head += size;
+        ok = write_header();
+    }
+
+    if (!ok) {
+        write_errors++;
+    }
+
+    xSemaphoreGive(log_mram_mutex);
+
+    return ok;
+}
+
+/**
+ * @brief Pass the logs written to the ring before this boot, and not recovered yet, to a callback
+ *
+ * Logging can continue during the recovery. Logs that get overwritten before they are recovered are
+ * skipped. Must be called from the log writer task.
+ *
+ * @param[in] cb Called for each log, oldest first. Called without the ring locked, so it may log.
+ *
+ * @return Number of logs recovered
+ */
+uint32_t log_mram_recover(log_mram_recover_cb_t cb) {
+    uint32_t count = 0;
+    uint32_t pos;
+
+    if (!initialized) {
+        return 0;
+    }
+
+    if (xSemaphoreTake(log_mram_mutex, pdMS_TO_TICKS(LOG_MRAM_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return 0;
+    }
+
+    pos = offset_before(state.synced, state.tail) ? state.tail : state.synced;
+
+    while (offset_before(pos, boot_head)) {
+        uint32_t size = 0;
+
+        // Logs made during the recovery may have pushed the oldest logs out
+        if (offset_before(pos, state.tail)) {
+            pos = state.tail;
+            continue;
+        }
+
+        if (!read_record(pos, recover_buf, &size)) {
+            break;
+        }
+
+        pos += size;
+
+        if (recover_buf[0] != LOG_MRAM_WRAP) {
+            xSemaphoreGive(log_mram_mutex);
+
+            cb(&recover_buf[1], recover_buf[0]);
+            count++;
+
+            if (xSemaphoreTake(log_mram_mutex, pdMS_TO_TICKS(LOG_MRAM_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+                return count;
+            }
+        }
+    }
+
+    // Also covers logs that couldn't be read, they would fail again on the next boot
+    if (offset_before(state.synced, boot_head)) {
+        state.synced = boot_head;
+        (void)write_header();
+    }
+
+    xSemaphoreGive(log_mram_mutex);
+
+    return count;
+}
+
+/**
+ * @brief Offset just past the last log written to the ring
+ *
+ * Logs are written to the ring after they are staged, so all logs before this offset have been
+ * staged for the log writer.
+ */
+uint32_t log_mram_get_head(void) {
+    return state.head;
+}
+
+/**
+ * @brief Mark the logs written to the ring before an offset as committed to the filesystem logs, so
+ * they aren't recovered again after a reset
+ *
+ * Called by the log writer task once the log files are committed to flash, so the header is only
+ * written to MRAM at most once per FS sync rather than for every saved block. Must not be called before
+ * log_mram_recover, the logs from before this boot would be skipped.
+ *
+ * @param[in] pos Offset returned by log_mram_get_head
+ */
+void log_mram_set_synced(uint32_t pos) {
+    if (!initialized) {
+        return;
+    }
+
+    if (xSemaphoreTake(log_mram_mutex, pdMS_TO_TICKS(LOG_MRAM_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return;
+    }
+
+    // Logs dropped to make space have already moved synced past pos
+    if (offset_before(state.synced, pos) && !offset_before(state.head, pos)) {
+        state.synced = pos;
+
+        // Written again with the next log if this fails
+        (void)write_header();
+    }
+
+    xSemaphoreGive(log_mram_mutex);
+}
+
+/**
+ * @brief Number of logs that couldn't be written to MRAM since boot
+ */
+uint32_t log_mram_get_errors(void) {
+    return write_errors;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Load the state from the header in MRAM
+ *
+ * @return true if the header is valid
+ */
+static bool read_header(void) {
+    uint8_t header[LOG_MRAM_HEADER_SIZE];
+
+    if (mram_read(MRAM_LOG_RING_ADDR, sizeof(header), header) != MRAM_OK) {
+        return false;
+    }
+
+    if ((data_fmt_arr_be_to_u32(&header[0]) != LOG_MRAM_MAGIC) ||
+        (data_fmt_arr_be_to_u32(&header[16]) != crc_32_buf(CRC32_SEED, header, 16U))) {
+        return false;
+    }
+
+    state.head   = data_fmt_arr_be_to_u32(&header[4]);
+    state.tail   = data_fmt_arr_be_to_u32(&header[8]);
+    state.synced = data_fmt_arr_be_to_u32(&header[12]);
+
+    // Reject offsets that can't come from a valid ring
+    if (((state.head - state.tail) > LOG_MRAM_DATA_SIZE) || offset_before(state.head, state.synced)) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool write_header(void) {
+    uint8_t header[LOG_MRAM_HEADER_SIZE];
+
+    data_fmt_u32_to_arr_be(LOG_MRAM_MAGIC, &header[0]);
+    data_fmt_u32_to_arr_be(state.head, &header[4]);
+    data_fmt_u32_to_arr_be(state.tail, &header[8]);
+    data_fmt_u32_to_arr_be(state.synced, &header[12]);
+    data_fmt_u32_to_arr_be(crc_32_buf(CRC32_SEED, header, 16U), &header[16]);
+
+    return (mram_write(MRAM_LOG_RING_ADDR, sizeof(header), header) == MRAM_OK);
+}
+
+/**
+ * @brief Drop the oldest records until there are at least size free bytes
+ */
+static bool make_space(uint32_t size) {
+    while ((LOG_MRAM_DATA_SIZE - (state.head - state.tail)) < size) {
+        uint32_t idx = state.tail & LOG_MRAM_DATA_MASK;
+        uint8_t len = 0;
+
+        if (mram_read(LOG_MRAM_DATA_ADDR + idx, 1U, &len) != MRAM_OK) {
+            return false;
+        }
+
+        uint32_t step = (len == LOG_MRAM_WRAP) ? (LOG_MRAM_DATA_SIZE - idx) : (1U + len + LOG_MRAM_CRC_SIZE);
+
+        // A corrupted length can't be walked past, drop everything
+        state.tail = (step <= (state.head - state.tail)) ? (state.tail + step) : state.head;
+
+        if (offset_before(state.synced, state.tail)) {
+            state.synced = state.tail;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Read the record at an offset into buf and check its CRC
+ *
+ * @param[out] size Space used by the record in the data area
+ */
+static bool read_record(uint32_t pos, uint8_t *buf, uint32_t *size) {
+    uint32_t idx = pos & LOG_MRAM_DATA_MASK;
+
+    if (mram_read(LOG_MRAM_DATA_ADDR + idx, 1U, buf) != MRAM_OK) {
+        return false;
+    }
+
+    if (buf[0] == LOG_MRAM_WRAP) {
+        *size = LOG_MRAM_DATA_SIZE - idx;
+        return true;
+    }
+
+    *size = 1U + buf[0] + LOG_MRAM_CRC_SIZE;
+
+    if ((idx + *size) > LOG_MRAM_DATA_SIZE) {
+        return false;
+    }
+
+    if (mram_read(LOG_MRAM_DATA_ADDR + idx + 1U, *size - 1U, &buf[1]) != MRAM_OK) {
+        return false;
+    }
+
+    uint16_t crc = crc_16_buf(CRC16_SEED, buf, 1U + buf[0]);
+
+    return (buf[*size - 2U] == (uint8_t)(crc >> 8)) && (buf[*size - 1U] == (uint8_t)crc);
+}
+
+/**
+ * @brief Compare free-running offsets
+ *
+ * @return true if a is before b
+ */
+static bool offset_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
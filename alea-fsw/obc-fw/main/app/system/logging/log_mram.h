@@ -0,0 +1,61 @@
+/**
+ * @file log_mram.h
+ * @brief Crash-persistent ring of recent logs in MRAM
+ */
+
+#ifndef LOG_MRAM_H_
+#define LOG_MRAM_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "log_sys.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/**
+ * @brief Logs of at least this severity are written to MRAM as they are logged
+ */
+#define LOG_MRAM_MIN_LEVEL      WARNING
+
+/**
+ * @brief Size of the ring data area. Must be a power of 2.
+ */
+#define LOG_MRAM_DATA_SIZE      8192U
+
+#define LOG_MRAM_HEADER_SIZE    20U
+#define LOG_MRAM_REGION_SIZE    (LOG_MRAM_HEADER_SIZE + LOG_MRAM_DATA_SIZE)
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Called for each log recovered from MRAM
+ *
+ * @param record Log header followed by the payload (same format as sent over serial)
+ * @param len    Size of the record
+ */
+typedef void (*log_mram_recover_cb_t)(const uint8_t *record, uint8_t len);
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void log_mram_pre_init(void);
+void log_mram_init(void);
+
+bool log_mram_write(const uint8_t *record, uint8_t len);
+uint32_t log_mram_recover(log_mram_recover_cb_t cb);
+uint32_t log_mram_get_head(void);
+void log_mram_set_synced(uint32_t pos);
+uint32_t log_mram_get_errors(void);
+
+#endif /* LOG_MRAM_H_ */
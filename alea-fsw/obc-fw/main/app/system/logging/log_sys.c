@@ -9,6 +9,10 @@
 
 #include "log_sys.h"
 #include "log_sys_serial.h"
+#include "log_filter.h"
+#include "log_index.h"
+#include "log_block.h"
+#include "log_mram.h"
 #include "logger.h"
 
 // OBC
@@ -18,6 +22,9 @@
 #include "obc_utils.h"
 #include "obc_mram.h"
 #include "obc_filesystem.h"
+#include "obc_rtos.h"
+#include "obc_watchdog.h"
+#include "obc_tasks_ids_gen.h"
 
 // Utils
 #include "data_fmt.h"
@@ -49,32 +56,99 @@
 
 #define LOG_SYS_MUTEX_TIMEOUT_MS 2000
 
-#define LOG_DELIMITER_SIZE  4
+/**
+ * @brief Size of the staging ring of each task. Must be a power of 2 and hold at least one record of
+ * the largest size (length byte, header and MAX_PAYLOAD_SIZE bytes of payload).
+ */
+#define LOG_STAGING_RING_SIZE   512U
+#define LOG_STAGING_RING_MASK   (LOG_STAGING_RING_SIZE - 1U)
+
+/**
+ * @brief Ring used by code that is not running in an OBC task (before the scheduler starts, timer callbacks, etc.)
+ */
+#define LOG_STAGING_SHARED_RING OBC_TASK_COUNT
+#define LOG_STAGING_RING_COUNT  (OBC_TASK_COUNT + 1U)
+
+/**
+ * @brief Value of the length byte that marks the rest of the ring as unused (records never wrap)
+ */
+#define LOG_STAGING_WRAP        0U
 
+/**
+ * @brief The log writer wakes up at least this often to pet the watchdog and report dropped logs
+ */
+#define LOG_WRITER_PERIOD_MS    1000U
+
+/**
+ * @brief Maximum number of contiguous parts of the log files a query can return
+ */
+#define LOG_QUERY_MAX_RANGES    64U
+
+/**
+ * @brief Size of the buffer holding logs that can't be saved while a read pins the logfile they would rotate into
+ */
+#define LOG_SPILL_BUF_SIZE      4096U
+
+/**
+ * @brief A partially filled block is saved to FS once its first log is this old
+ */
+#define LOG_BLOCK_MAX_AGE_MS    5000U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Staging ring that logs are encoded into before being written to serial and the filesystem
+ *
+ * Each task owns the ring at the index of its task ID, so there is a single producer (the task) and a
+ * single consumer (the log writer task) and no lock is needed. Records are stored as a length byte
+ * followed by the header and payload, and are never split across the end of the buffer.
+ */
 typedef struct {
-    uint8_t log_id;
-    uint8_t sig_id;
-} log_sig_pair_t;
-
-static const log_sig_pair_t log_sig_pairs[] = {
-    {  0, 0 }, // PRINTF
-    { 74, 0 }, // SYS_WRITE_ENQUEUE_FAIL
-    { 74, 1 }, // SYS_FS_FAIL
-    { 39, 1 }, // WATCHDOG_PET
-    { 39, 2 }, // WATCHDOG_HAPPY
-};
-static const size_t n_pairs = sizeof(log_sig_pairs) / sizeof(log_sig_pairs[0]);
+    uint8_t data[LOG_STAGING_RING_SIZE];
+    volatile uint32_t head;     // Only written by the producer, once a record is complete
+    volatile uint32_t tail;     // Only written by the log writer task
+    volatile uint32_t dropped;  // Only written by the producer
+    uint32_t dropped_reported;  // Only used by the log writer task
+    uint32_t gap;               // Bytes skipped at the end of the buffer by the current reservation
+} log_staging_ring_t;
+
+/* Block of logs being saved to FS, as needed by the log index */
+typedef struct {
+    uint32_t size;
+    uint32_t log_count;
+    uint32_t epoch_min;
+    uint32_t epoch_max;
+    uint32_t log_id_mask;
+} log_block_info_t;
 
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
 /******************************************************************************/
 
 static void log_signal_internal(uint8_t log_id, uint8_t sig_id, size_t raw_payload_len, const void *payload_ptr, bool use_rtc);
-static void encode_header(uint8_t log_id, uint8_t sig_id, uint8_t size, uint8_t header_ptr[HEADER_SIZE], bool use_rtc);
+static void encode_header(uint8_t log_id, uint8_t sig_id, uint8_t size, uint8_t header_ptr[HEADER_SIZE], epoch_t epoch);
+static epoch_t log_timestamp(bool use_rtc);
+static log_staging_ring_t *staging_begin(void);
+static uint8_t *staging_reserve(log_staging_ring_t *ring, uint8_t log_id, uint8_t sig_id, uint8_t payload_len, epoch_t epoch);
+static void staging_commit(log_staging_ring_t *ring, uint8_t payload_len);
+static void staging_end(log_staging_ring_t *ring);
+static bool staging_drain(log_staging_ring_t *ring);
+static void log_writer_task(void *pvParameters);
 static bool get_actual_file_sizes(uint32_t *arr);
-static void fs_log_save(uint8_t *buffer, size_t buffer_len);
-static inline bool saveable_log(uint8_t log_id, uint8_t sig_id);
+static bool log_query_add_range(uint8_t file_idx, uint32_t offset, uint32_t size);
+static void log_block_append(uint32_t epoch, uint8_t log_id, uint8_t sig_id, const uint8_t *payload, uint8_t payload_len);
+static void log_block_save(void);
+static void fs_log_save(const uint8_t *buffer, const log_block_info_t *info);
+static fs_err_t log_file_append(const uint8_t *buffer, const log_block_info_t *info, bool *pinned);
+static void log_spill_add(const uint8_t *buffer, const log_block_info_t *info);
+static void log_spill_drain(void);
+static void log_spill_flush(void);
 static void log_2_fs_init(void);
+static void log_mram_capture(const log_staging_ring_t *ring, const uint8_t *payload, uint8_t log_id, uint8_t sig_id, uint8_t payload_len);
+static void log_mram_recovered(const uint8_t *record, uint8_t len);
+static void log_mram_sync_step(void);
 
 /******************************************************************************/
 /*               P R I V A T E  G L O B A L  V A R I A B L E S                */
@@ -83,6 +157,7 @@ static void log_2_fs_init(void);
 static lfs_file_t file = { 0 };
 
 static const char *LOG_FILE_NAMES[] = {"log_0", "log_1", "log_2", "log_3"};
+static fs_handle_t log_file_handles[FS_LOGGING_FILES_NUM];
 static uint8_t log_file_current;
 
 // This doesn't reflect the actual size of the current logfile in flash, since it is updated on calls to
@@ -90,8 +165,6 @@ static uint8_t log_file_current;
 // the actual file size between FS flush cycles
 static uint32_t log_file_current_size;
 
-static const uint8_t LOG_DELIMITER[] = {0xBE, 0xEE, 0xEE, 0xEF};
-
 static SemaphoreHandle_t logSysMutex;
 
 static bool log_2_flash_initialized = false;
@@ -105,51 +178,136 @@ typedef struct {
     uint8_t readfile_index;
     uint32_t readfile_bytes_remaining;
     uint32_t file_sizes[FS_LOGGING_FILES_NUM];
-    lfs_file_t readfile;
+    uint8_t pinned_mask; // Logfiles with unread data, they can't be zeroed by a rotation until the read moves past them
 } log_read_state_t;
 
 static log_read_state_t log_read = { 0 };
 
+/* Part of a log file returned by a log query */
+typedef struct {
+    uint8_t file_idx;
+    uint32_t offset;
+    uint32_t size;
+} log_query_range_t;
+
+/* log_sys internal variables to keep track of query state for cmd_impl_GET_LOGS_RANGE() */
+typedef struct {
+    uint8_t range_count;
+    uint8_t range_idx;
+    uint32_t range_pos;
+    uint32_t total_bytes_remaining;
+    log_query_range_t ranges[LOG_QUERY_MAX_RANGES];
+    log_index_iter_t iter;
+} log_query_state_t;
+
+static log_query_state_t log_query = { 0 };
+
+/* Blocks waiting to be saved to FS because the next logfile is pinned by a read, each prefixed by its
+ * log_block_info_t. Used by the log writer task only */
+typedef struct {
+    uint8_t data[LOG_SPILL_BUF_SIZE];
+    uint32_t head;
+    uint32_t len;
+    uint32_t dropped;
+    uint32_t dropped_reported;
+} log_spill_t;
+
+static log_spill_t log_spill = { 0 };
+
+/* Progress of the logs written to MRAM towards the log files in flash, as offsets of the MRAM ring
+ * (see log_mram_get_head). Used by the log writer task only */
+typedef struct {
+    bool drained_valid;
+    bool saved_valid;
+    bool waiting;
+    uint32_t drained;   // Logs before this have been added to log_block
+    uint32_t saved;     // Logs before this have been queued to the log files or spilled
+    uint32_t pending;   // Logs before this are committed once the log files reach targets
+    uint32_t targets[FS_LOGGING_FILES_NUM];
+} log_mram_sync_t;
+
+static log_mram_sync_t log_mram_sync = { 0 };
+
+static log_staging_ring_t staging_rings[LOG_STAGING_RING_COUNT] = { 0 };
+static TaskHandle_t log_writer_task_handle = NULL;
+
+// Used by the log writer task only
+static uint8_t log_writer_buf[HEADER_SIZE + MAX_PAYLOAD_SIZE];
+
+// Block of logs being encoded for FS, used by the log writer task only
+static log_block_t log_block;
+static TickType_t log_block_start_ticks;
+
+// Used by the log writer task only
+static bool log_mram_recovery_done = false;
+static uint32_t log_mram_errors_reported = 0;
+
+CASSERT(((LOG_STAGING_RING_SIZE & LOG_STAGING_RING_MASK) == 0) && (LOG_STAGING_RING_SIZE >= (1U + HEADER_SIZE + MAX_PAYLOAD_SIZE)), log_staging_ring_size);
+
 /******************************************************************************/
 /*                       P U B L I C  F U N C T I O N S                       */
 /******************************************************************************/
 
 /* This is a special LOG_ function used as a debug printf */
 void LOG_PRINTF(char *format, ...) {
-    log_LOG_PRINTF__reserved_data_t log_data = { 0 };
+    const uint8_t message_len = sizeof(((log_LOG_PRINTF__reserved_data_t *)0)->message);
 
-    va_list args_ptr;
-    va_start(args_ptr, format);
-    vsnprintf((char *)log_data.message, sizeof(log_data.message), format, args_ptr);
-    va_end(args_ptr);
+    // Skip formatting if the message would be discarded anyway
+    if (log_filter_get_sinks(LOG_PRINTF_LOG_ID, LOG_PRINTF_SIG_ID) == 0) {
+        return;
+    }
 
-    const data_fmt_field_desc_t data_field_descs[1] = {
-        { .type = DATA_FMT_FIELD_TYPE_U8, .struct_offset = offsetof(log_LOG_PRINTF__reserved_data_t, message), .array_len = sizeof(log_data.message) },
-    };
+    epoch_t epoch = log_timestamp(true);
+
+    // The message is a u8 array, so it is formatted straight into the staging ring
+    log_staging_ring_t *ring = staging_begin();
+    uint8_t *message = staging_reserve(ring, LOG_PRINTF_LOG_ID, LOG_PRINTF_SIG_ID, message_len, epoch);
+
+    if (message != NULL) {
+        va_list args_ptr;
+        va_start(args_ptr, format);
+        int len = vsnprintf((char *)message, message_len, format, args_ptr);
+        va_end(args_ptr);
+
+        len = (len < 0) ? 0 : MIN(len, message_len);
+        memset(&message[len], 0, message_len - len);
 
-    const data_fmt_desc_t data_desc = { .fields = data_field_descs, .count = 1 };
+        staging_commit(ring, message_len);
+    }
 
-    log_sys_log_signal_with_data(LOG_PRINTF_LOG_ID, LOG_PRINTF_SIG_ID, sizeof(log_data.message), (const void *)&log_data, &data_desc);
+    staging_end(ring);
 }
 
 /* This is a special LOG_ function used for cmd system schedule responses */
 void LOG_CMD_SYS_SCHED_RESP(uint32_t num_bytes, const uint8_t *data) {
+    if (log_filter_get_sinks(LOG_CMD_SYS_SCHED_RESP_LOG_ID, LOG_CMD_SYS_SCHED_RESP_SIG_ID) == 0) {
+        return;
+    }
+
     log_signal_internal(LOG_CMD_SYS_SCHED_RESP_LOG_ID, LOG_CMD_SYS_SCHED_RESP_SIG_ID, num_bytes, data, true);
 }
 
 void log_sys_pre_init(void) {
+    log_filter_init();
+    log_mram_pre_init();
+
     log_sys_serial_create_infra();
     log_sys_serial_create_task();
+
+    log_writer_task_handle = obc_rtos_create_task(OBC_TASK_ID_LOG_WRITER, &log_writer_task, NULL, OBC_WATCHDOG_ACTION_ALLOW);
 }
 
 void log_sys_post_init(void) {
+    log_mram_init();
     log_2_fs_init();
 }
 
 /**
  * @brief Public API to initialize a log read session. To be used by cmd_impl_GET_LOGS
  *
- * The sizes of all logfiles are retrieved and cached, @ref log_read is initialized
+ * The sizes of all logfiles are retrieved and cached, @ref log_read is initialized. The read returns the logs
+ * that were in the logfiles at this point. Logging to FS continues during the read: logs are appended after the
+ * cached size of the current logfile, and logfiles with unread data are pinned so they aren't zeroed by a rotation
  *
  * @param[in]   buf              External buffer to save to @ref log_read, written to in @ref logs_read()
  * @param[in]   bytes_to_read    Number of bytes being requested
@@ -166,35 +324,32 @@ int32_t logs_read_begin(uint8_t *buf, uint32_t bytes_to_read, uint16_t chunk_siz
             return -1;
         }
 
+        // In this case, we actually open and retrieve the size of the current logfile, since log_file_current_size
+        // doesn't reflect the size of the actual file in flash. log_file_current_size reflects the current size of
+        // that file PLUS the number of bytes currently waiting to be written to the file via fs_write_enqueue
         if (!get_actual_file_sizes(log_read.file_sizes)) {
             xSemaphoreGive(logSysMutex);
             return -1;
         }
 
-        int32_t total_size = 0;
-
-        // In this case, we actually open and retrieve the size of the current logfile, since log_file_current_size
-        // doesn't reflect the size of the actual file in flash. log_file_current_size reflects the current size of
-        // that file PLUS the number of bytes currently waiting to be written to the file via fs_write_enqueue
-        for (int x = 0; x < FS_LOGGING_FILES_NUM; x++) {
-            total_size += log_read.file_sizes[x];
-        }
+        uint32_t total_size = 0;
+        uint8_t filenum = log_file_current;
 
-        log_read.readfile_index = log_file_current;
-        const char *filename = LOG_FILE_NAMES[log_file_current];
+        // Pin the logfiles the read will reach, walking backwards from the current logfile
+        log_read.pinned_mask = 0;
 
-        if (fs_open(&log_read.readfile, filename, LOG_SYS_MUTEX_TIMEOUT_MS) != FS_OK) {
-            xSemaphoreGive(logSysMutex);
-            return -1;
-        }
+        for (int x = 0; (x < FS_LOGGING_FILES_NUM) && (total_size < bytes_to_read); x++) {
+            if (log_read.file_sizes[filenum] > 0) {
+                log_read.pinned_mask |= (uint8_t)(1U << filenum);
+                total_size += log_read.file_sizes[filenum];
+            }
 
-        if (fs_seek(&log_read.readfile, 0, FS_SEEK_END) != FS_OK) {
-            xSemaphoreGive(logSysMutex);
-            return -1;
+            filenum = (filenum == 0) ? (FS_LOGGING_FILES_NUM - 1) : (filenum - 1);
         }
 
         log_read.buf = buf;
-        log_read.total_bytes_remaining = bytes_to_read;
+        log_read.total_bytes_remaining = MIN(total_size, bytes_to_read);
+        log_read.readfile_index = log_file_current;
         log_read.readfile_bytes_remaining = log_read.file_sizes[log_file_current];
         log_read.chunk_size = chunk_size;
 
@@ -202,7 +357,7 @@ int32_t logs_read_begin(uint8_t *buf, uint32_t bytes_to_read, uint16_t chunk_siz
 
         xSemaphoreGive(logSysMutex);
 
-        return MIN((uint32_t)total_size, bytes_to_read);
+        return (int32_t)log_read.total_bytes_remaining;
     }
 
     return -1;
@@ -213,21 +368,13 @@ int32_t logs_read_begin(uint8_t *buf, uint32_t bytes_to_read, uint16_t chunk_siz
  */
 void logs_read_end() {
     if (xSemaphoreTake(logSysMutex, pdMS_TO_TICKS(LOG_SYS_MUTEX_TIMEOUT_MS)) == pdTRUE) {
-        if (!log_read.reading) {
-            xSemaphoreGive(logSysMutex);
-            return;
-        }
-
         log_read.reading = false;
-
-        fs_err_t err;
-        err = fs_close(&log_read.readfile);
-
-        if (err != FS_OK) {
-            LOG_LOG_SYS__FS_FAIL((int8_t)err);
-        }
+        log_read.pinned_mask = 0;
 
         xSemaphoreGive(logSysMutex);
+
+        // Save the logs that were held back by the read
+        xTaskNotifyGive(log_writer_task_handle);
     }
 }
 
@@ -243,71 +390,207 @@ void logs_read_end() {
  */
 int32_t logs_read() {
     if (xSemaphoreTake(logSysMutex, pdMS_TO_TICKS(LOG_SYS_MUTEX_TIMEOUT_MS)) == pdTRUE) {
-        // If we have reached the beginning of the current logfile
-        if (log_read.readfile_bytes_remaining == 0) {
-            if (fs_close(&log_read.readfile) != FS_OK) {
-                log_read.reading = false;
-                xSemaphoreGive(logSysMutex);
-                return -1;
-            }
+        // If we have reached the beginning of the current logfile, move on to the previous non-empty logfile
+        for (int x = 0; (x < FS_LOGGING_FILES_NUM) && (log_read.readfile_bytes_remaining == 0); x++) {
+            log_read.pinned_mask &= (uint8_t)~(1U << log_read.readfile_index);
 
-            // Move on to the previous logfile before the current one we're reading from
             log_read.readfile_index = (log_read.readfile_index == 0) ? (FS_LOGGING_FILES_NUM - 1) : (log_read.readfile_index - 1);
-            const char *filename = LOG_FILE_NAMES[log_read.readfile_index];
+            log_read.readfile_bytes_remaining = log_read.file_sizes[log_read.readfile_index];
+        }
 
-            if (fs_open(&log_read.readfile, filename, LOG_SYS_MUTEX_TIMEOUT_MS) != FS_OK) {
-                log_read.reading = false;
-                xSemaphoreGive(logSysMutex);
-                return -1;
-            }
+        // Number of bytes to read to the buffer is the minimum of the total bytes that still need to be read, buffer chunk size, and
+        // bytes left in current file
+        uint32_t bytes_to_read = MIN(MIN(log_read.chunk_size, log_read.readfile_bytes_remaining), log_read.total_bytes_remaining);
+        uint32_t bytes_read = 0;
 
-            if (fs_seek(&log_read.readfile, 0, FS_SEEK_END) != FS_OK) {
-                log_read.reading = false;
-                xSemaphoreGive(logSysMutex);
-                return -1;
-            }
+        if (bytes_to_read == 0) {
+            xSemaphoreGive(logSysMutex);
+            return 0;
+        }
 
-            uint32_t file_size = log_read.file_sizes[log_read.readfile_index];
+        // Read at an offset rather than from the end of the file, the current logfile keeps growing during the read
+        fs_err_t err = fs_read_at(LOG_FILE_NAMES[log_read.readfile_index], log_read.readfile_bytes_remaining - bytes_to_read, log_read.buf,
+                                  bytes_to_read, &bytes_read, LOG_SYS_MUTEX_TIMEOUT_MS);
 
-            if (file_size == 0) {
-                xSemaphoreGive(logSysMutex);
-                return 0;
-            }
+        if ((err != FS_OK) || (bytes_read != bytes_to_read)) {
+            log_read.reading = false;
+            log_read.pinned_mask = 0;
+            xSemaphoreGive(logSysMutex);
+            return -1;
+        }
 
-            log_read.readfile_bytes_remaining = file_size;
+        log_read.readfile_bytes_remaining -= bytes_to_read;
+        log_read.total_bytes_remaining -= bytes_to_read;
+
+        if (log_read.total_bytes_remaining == 0) {
+            log_read.pinned_mask = 0;
         }
 
-        // Number of bytes to read to the buffer is the minimum of the total bytes that still need to be read, buffer chunk size, and
-        // bytes left in current file
-        uint32_t bytes_to_read = MIN(MIN(log_read.chunk_size, log_read.readfile_bytes_remaining), log_read.total_bytes_remaining);
+        xSemaphoreGive(logSysMutex);
 
-        if (fs_seek(&log_read.readfile, -(int32_t)bytes_to_read, FS_SEEK_CUR) != FS_OK) {
-            log_read.reading = false;
+        return (int32_t)bytes_to_read;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Public API to initialize a log query session. To be used by cmd_impl_GET_LOGS_RANGE
+ *
+ * Uses the log index to find the blocks of the logfiles that may contain logs in the time range with
+ * the log ID. Only those blocks are read by @ref logs_query_read(), oldest first. Blocks start and end
+ * on log boundaries but may contain other logs, which must be filtered out by the reader.
+ *
+ * Like @ref logs_read_begin(), logging to FS continues during the query and the logfiles it returns are pinned
+ * until it has read them.
+ *
+ * @param[in]   epoch_start     Start of the time range (inclusive)
+ * @param[in]   epoch_end       End of the time range (inclusive)
+ * @param[in]   log_id          Log ID to retrieve, or LOG_INDEX_ALL_IDS for all logs
+ * @param[in]   max_bytes       Maximum number of bytes to read
+ *
+ * @return Number of bytes the query will return if successful, -1 otherwise
+ */
+int32_t logs_query_begin(uint32_t epoch_start, uint32_t epoch_end, uint8_t log_id, uint32_t max_bytes) {
+    if (!log_2_flash_initialized) {
+        return -1;
+    }
+
+    if (xSemaphoreTake(logSysMutex, pdMS_TO_TICKS(LOG_SYS_MUTEX_TIMEOUT_MS)) == pdTRUE) {
+        if (log_read.reading) {
             xSemaphoreGive(logSysMutex);
             return -1;
         }
 
-        if (fs_read(&log_read.readfile, log_read.buf, bytes_to_read) != FS_OK) {
-            log_read.reading = false;
+        // Write out queued logs so that the index and the logfiles match what's in flash
+        if ((fs_flush(LOG_SYS_MUTEX_TIMEOUT_MS) != FS_OK) || !get_actual_file_sizes(log_read.file_sizes)) {
             xSemaphoreGive(logSysMutex);
             return -1;
         }
 
-        if (fs_seek(&log_read.readfile, -(int32_t)bytes_to_read, FS_SEEK_CUR) != FS_OK) {
-            log_read.reading = false;
+        log_query.range_count = 0;
+        log_query.range_idx = 0;
+        log_query.range_pos = 0;
+
+        uint32_t total_size = 0;
+        bool full = false;
+
+        // Oldest logfile is the one after the current logfile
+        for (uint8_t x = 1; (x <= FS_LOGGING_FILES_NUM) && !full; x++) {
+            uint8_t file_idx = (log_file_current + x) % FS_LOGGING_FILES_NUM;
+            log_index_iter_begin(&log_query.iter, file_idx, log_read.file_sizes[file_idx]);
+
+            while (!full) {
+                log_index_entry_t entry;
+                bool found = false;
+
+                if (log_index_iter_next(&log_query.iter, &entry, &found, LOG_SYS_MUTEX_TIMEOUT_MS) != FS_OK) {
+                    xSemaphoreGive(logSysMutex);
+                    return -1;
+                }
+
+                if (!found) {
+                    break;
+                }
+
+                if (!log_index_entry_matches(&entry, epoch_start, epoch_end, log_id)) {
+                    continue;
+                }
+
+                if (!log_query_add_range(file_idx, entry.offset, entry.size)) {
+                    full = true;
+                    break;
+                }
+
+                total_size += entry.size;
+                full = (total_size >= max_bytes);
+            }
+        }
+
+        log_query.total_bytes_remaining = MIN(total_size, max_bytes);
+        log_read.pinned_mask = 0;
+
+        for (uint8_t x = 0; x < log_query.range_count; x++) {
+            log_read.pinned_mask |= (uint8_t)(1U << log_query.ranges[x].file_idx);
+        }
+
+        log_read.reading = true;
+
+        xSemaphoreGive(logSysMutex);
+
+        return (int32_t)log_query.total_bytes_remaining;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Public API to de-initialize a log query session. To be used by cmd_impl_GET_LOGS_RANGE after @ref logs_query_begin()
+ */
+void logs_query_end(void) {
+    if (xSemaphoreTake(logSysMutex, pdMS_TO_TICKS(LOG_SYS_MUTEX_TIMEOUT_MS)) == pdTRUE) {
+        log_query.range_count = 0;
+        log_query.total_bytes_remaining = 0;
+        log_read.reading = false;
+        log_read.pinned_mask = 0;
+
+        xSemaphoreGive(logSysMutex);
+
+        // Save the logs that were held back by the query
+        xTaskNotifyGive(log_writer_task_handle);
+    }
+}
+
+/**
+ * @brief Public API to retrieve the next bytes of a log query started with @ref logs_query_begin()
+ *
+ * @param[out]  buf     Buffer to read into
+ * @param[in]   size    Size of the buffer
+ *
+ * @return Number of bytes written to buf if successful (0 once the query is complete), -1 otherwise
+ */
+int32_t logs_query_read(uint8_t *buf, uint32_t size) {
+    if (xSemaphoreTake(logSysMutex, pdMS_TO_TICKS(LOG_SYS_MUTEX_TIMEOUT_MS)) == pdTRUE) {
+        if (!log_read.reading || (log_query.total_bytes_remaining == 0) || (log_query.range_idx >= log_query.range_count)) {
+            xSemaphoreGive(logSysMutex);
+            return 0;
+        }
+
+        const log_query_range_t *range = &log_query.ranges[log_query.range_idx];
+        uint32_t bytes_to_read = MIN(MIN(size, range->size - log_query.range_pos), log_query.total_bytes_remaining);
+        uint32_t bytes_read = 0;
+
+        fs_err_t err = fs_read_at(LOG_FILE_NAMES[range->file_idx], range->offset + log_query.range_pos, buf, bytes_to_read, &bytes_read,
+                                  LOG_SYS_MUTEX_TIMEOUT_MS);
+
+        if ((err != FS_OK) || (bytes_read != bytes_to_read)) {
             xSemaphoreGive(logSysMutex);
             return -1;
         }
 
-        log_read.readfile_bytes_remaining -= bytes_to_read;
-        log_read.total_bytes_remaining -= bytes_to_read;
+        log_query.range_pos += bytes_read;
+        log_query.total_bytes_remaining -= bytes_read;
+
+        if (log_query.range_pos == range->size) {
+            log_query.range_idx++;
+            log_query.range_pos = 0;
+
+            // Ranges are in file order, unpin the logfile once its last range is read
+            if ((log_query.range_idx == log_query.range_count) || (log_query.ranges[log_query.range_idx].file_idx != range->file_idx)) {
+                log_read.pinned_mask &= (uint8_t)~(1U << range->file_idx);
+            }
+        }
+
+        if (log_query.total_bytes_remaining == 0) {
+            log_read.pinned_mask = 0;
+        }
 
         xSemaphoreGive(logSysMutex);
 
-        return (int32_t)bytes_to_read;
+        return (int32_t)bytes_read;
     }
 
-    return 0;
+    return -1;
 }
 
 /**
@@ -342,22 +625,41 @@ void log_sys_log_signal(uint8_t log_id, uint8_t sig_id) {
 }
 
 void log_sys_log_signal_with_data(uint8_t log_id, uint8_t sig_id, uint32_t data_len, const void *data_struct, const data_fmt_desc_t *data_desc) {
-    static uint8_t buf[512]; // TODO(ALEA-3185): This buffer is not thread safe
-
     if ((data_struct == NULL) || (data_desc == NULL)) {
         LOG_LOGGING_SYS__ATTEMPTED_TO_LOG_DATA_NULL();
         return;
     }
 
-    // Serialize the response
-    uint32_t written_bytes = data_fmt_serialize_struct(data_struct, data_desc, buf, sizeof(buf));
+    if (data_len > MAX_PAYLOAD_SIZE) {
+        LOG_LOGGER__PAYLOAD_TOO_LARGE();
+        return;
+    }
+
+    epoch_t epoch = log_timestamp(true);
+    uint32_t written_bytes = data_len;
+
+    // Serialize the data straight into the staging ring
+    log_staging_ring_t *ring = staging_begin();
+    uint8_t *payload = staging_reserve(ring, log_id, sig_id, (uint8_t)data_len, epoch);
+
+    if (payload != NULL) {
+        written_bytes = data_fmt_serialize_struct(data_struct, data_desc, payload, data_len);
+
+        if (written_bytes == data_len) {
+            staging_commit(ring, (uint8_t)data_len);
+        }
+    }
+
+    staging_end(ring);
 
+    if (written_bytes == data_len) {
+        log_mram_capture(ring, payload, log_id, sig_id, (uint8_t)data_len);
+    }
+
+    // Logged once the reservation is released, it would otherwise be written over the discarded record
     if (written_bytes != data_len) {
         LOG_LOGGING_SYS__DATA_FMT_WRONG_DATA_LEN();
-        return;
     }
-
-    log_signal_internal(log_id, sig_id, written_bytes, buf, true);
 }
 
 /******************************************************************************/
@@ -383,7 +685,15 @@ static void log_2_fs_init(void) {
 
     for (int filenum = 0; filenum < FS_LOGGING_FILES_NUM; filenum++) {
         filename = LOG_FILE_NAMES[filenum];
-        fs_open(&file, filename, 1000);
+
+        if (fs_get_handle(filename, &log_file_handles[filenum], 1000) != FS_OK) {
+            return;
+        }
+
+        if (fs_open(&file, filename, 1000) != FS_OK) {
+            continue;
+        }
+
         int32_t size = fs_size(&file);
 
         if (size > 0 && size < smallest) {
@@ -395,6 +705,10 @@ static void log_2_fs_init(void) {
         fs_close(&file);
     }
 
+    if (log_index_init(1000) != FS_OK) {
+        return;
+    }
+
     log_read.reading = false;
     log_2_flash_initialized = true;
 #endif
@@ -436,88 +750,247 @@ static bool get_actual_file_sizes(uint32_t *arr) {
 }
 
 /**
- * @brief Queue log messages to be saved to FS
+ * @brief Append a part of a logfile to the query, merging it with the previous part if they are contiguous
  *
- * Determines if the current logfile has the capacity for the incoming logfile. If the current logfile is
- * at capacity, moves on to the next logfile and zeroes the file
+ * @return true on success, false if the query has no space left
+ */
+static bool log_query_add_range(uint8_t file_idx, uint32_t offset, uint32_t size) {
+    if (log_query.range_count > 0) {
+        log_query_range_t *last = &log_query.ranges[log_query.range_count - 1];
+
+        if ((last->file_idx == file_idx) && ((last->offset + last->size) == offset)) {
+            last->size += size;
+            return true;
+        }
+    }
+
+    if (log_query.range_count == LOG_QUERY_MAX_RANGES) {
+        return false;
+    }
+
+    log_query.ranges[log_query.range_count].file_idx = file_idx;
+    log_query.ranges[log_query.range_count].offset = offset;
+    log_query.ranges[log_query.range_count].size = size;
+    log_query.range_count++;
+
+    return true;
+}
+
+/**
+ * @brief Add a log to the block being encoded for FS, saving the block first if the log doesn't fit
  *
- * @param[in]   buffer          Pointer to a buffer containing a log message
- * @param[in]   buffer_len      Size of the incoming log message
+ * Must only be called from the log writer task.
  */
-static void fs_log_save(uint8_t *buffer, size_t buffer_len) {
-    const char *filename = NULL;
-    fs_err_t err;
+static void log_block_append(uint32_t epoch, uint8_t log_id, uint8_t sig_id, const uint8_t *payload, uint8_t payload_len) {
+    if (log_block.record_count == 0) {
+        log_block_start_ticks = xTaskGetTickCount();
+    }
+
+    if (!log_block_add(&log_block, epoch, log_id, sig_id, payload, payload_len)) {
+        log_block_save();
+
+        log_block_start_ticks = xTaskGetTickCount();
+        (void)log_block_add(&log_block, epoch, log_id, sig_id, payload, payload_len);
+    }
+}
+
+/**
+ * @brief Save the block being encoded to FS and start a new one
+ *
+ * Must only be called from the log writer task.
+ */
+static void log_block_save(void) {
+    log_block_info_t info = {
+        .size        = log_block_finish(&log_block),
+        .log_count   = log_block.record_count,
+        .epoch_min   = log_block.epoch_min,
+        .epoch_max   = log_block.epoch_max,
+        .log_id_mask = log_block.log_id_mask,
+    };
 
+    if (info.size > 0) {
+        fs_log_save(log_block.buf, &info);
+    }
+
+    log_block_init(&log_block);
+
+    // Everything drained so far was in this block or an earlier one
+    if (log_mram_sync.drained_valid) {
+        log_mram_sync.saved = log_mram_sync.drained;
+        log_mram_sync.saved_valid = true;
+    }
+}
+
+/**
+ * @brief Queue a block of logs to be saved to FS
+ *
+ * Blocks are held in @ref log_spill while the logfile they would rotate into is pinned by a read, and saved in
+ * order once the read moves past it
+ *
+ * @param[in]   buffer          Pointer to the encoded block
+ * @param[in]   info            Size and contents of the block
+ */
+static void fs_log_save(const uint8_t *buffer, const log_block_info_t *info) {
     if (xSemaphoreTake(logSysMutex, pdMS_TO_TICKS(LOG_SYS_MUTEX_TIMEOUT_MS)) == pdTRUE) {
-        // Saving logs to FS is disabled during downlink
-        if (log_read.reading) {
-            xSemaphoreGive(logSysMutex);
-            return;
+        log_spill_drain();
+
+        bool pinned = (log_spill.head != log_spill.len);
+
+        if (!pinned) {
+            (void)log_file_append(buffer, info, &pinned);
         }
 
-        // If size of the log message is greater than the remaining capacity of the current logfile
-        if (buffer_len > (FS_LOGGING_MAX_FILE_SIZE - log_file_current_size)) {
-            log_file_current = (log_file_current == FS_LOGGING_FILES_NUM - 1) ? 0 : log_file_current + 1;
-            log_file_current_size = buffer_len;
+        if (pinned) {
+            log_spill_add(buffer, info);
+        }
 
-            filename = LOG_FILE_NAMES[log_file_current];
+        xSemaphoreGive(logSysMutex);
+    }
+}
 
-            err = fs_open(&file, filename, LOG_SYS_MUTEX_TIMEOUT_MS);
+/**
+ * @brief Queue a block of logs to be written to the current logfile
+ *
+ * Determines if the current logfile has the capacity for the incoming block. If the current logfile is
+ * at capacity, moves on to the next logfile and zeroes the file
+ *
+ * This function assumes that the caller already holds @ref logSysMutex
+ *
+ * @param[in]   buffer          Pointer to the encoded block
+ * @param[in]   info            Size and contents of the block
+ * @param[out]  pinned          Set if the next logfile is pinned by a read, the block was not queued
+ *
+ * @return FS_OK if the block was queued or the next logfile is pinned, error code otherwise
+ */
+static fs_err_t log_file_append(const uint8_t *buffer, const log_block_info_t *info, bool *pinned) {
+    const uint32_t buffer_len = info->size;
+    uint32_t offset;
+    fs_err_t err;
 
-            if (err) {
-                LOG_LOG_SYS__FS_FAIL((int8_t)err);
-                xSemaphoreGive(logSysMutex);
-                return;
-            }
+    *pinned = false;
 
-            err = fs_zero(&file);
+    // If size of the log message is greater than the remaining capacity of the current logfile
+    if (buffer_len > (FS_LOGGING_MAX_FILE_SIZE - log_file_current_size)) {
+        uint8_t next = (log_file_current == FS_LOGGING_FILES_NUM - 1) ? 0 : log_file_current + 1;
 
-            if (err != FS_OK) {
-                LOG_LOG_SYS__FS_FAIL((int8_t)err);
-                xSemaphoreGive(logSysMutex);
-                return;
-            }
+        if ((log_read.pinned_mask & (1U << next)) != 0) {
+            *pinned = true;
+            return FS_OK;
+        }
 
-            err = fs_close(&file);
+        log_file_current = next;
+        log_file_current_size = 0;
 
-            if (err != FS_OK) {
-                LOG_LOG_SYS__FS_FAIL((int8_t)err);
-                xSemaphoreGive(logSysMutex);
-                return;
-            }
-        } else {
-            filename = LOG_FILE_NAMES[log_file_current];
-            log_file_current_size += buffer_len;
+        err = fs_open(&file, LOG_FILE_NAMES[log_file_current], LOG_SYS_MUTEX_TIMEOUT_MS);
+
+        if (err) {
+            LOG_LOG_SYS__FS_FAIL((int8_t)err);
+            return err;
         }
 
-        xSemaphoreGive(logSysMutex);
+        err = fs_zero(&file);
 
-        err = fs_write_enqueue(buffer, buffer_len, filename, LOG_SYS_MUTEX_TIMEOUT_MS);
+        if (err != FS_OK) {
+            LOG_LOG_SYS__FS_FAIL((int8_t)err);
+            return err;
+        }
+
+        err = fs_close(&file);
 
         if (err != FS_OK) {
-            LOG_LOG_SYS__WRITE_ENQUEUE_FAIL((int8_t)err);
+            LOG_LOG_SYS__FS_FAIL((int8_t)err);
+            return err;
+        }
+
+        err = log_index_reset(log_file_current, LOG_SYS_MUTEX_TIMEOUT_MS);
+
+        if (err != FS_OK) {
+            LOG_LOG_SYS__FS_FAIL((int8_t)err);
         }
     }
+
+    offset = log_file_current_size;
+
+    // The mutex is held across the enqueue so that the index sees logs in the order they are written
+    err = fs_write_enqueue(log_file_handles[log_file_current], buffer, buffer_len);
+
+    if (err != FS_OK) {
+        LOG_LOG_SYS__WRITE_ENQUEUE_FAIL((int8_t)err);
+        return err;
+    }
+
+    log_file_current_size += buffer_len;
+
+    err = log_index_add(log_file_current, offset, buffer_len, info->epoch_min, info->epoch_max, info->log_id_mask);
+
+    if (err != FS_OK) {
+        LOG_LOG_SYS__WRITE_ENQUEUE_FAIL((int8_t)err);
+    }
+
+    return FS_OK;
 }
 
 /**
- * @brief Check if a log is in the save blacklist (log_sig_pairs)
+ * @brief Hold a block in @ref log_spill until it can be saved. The logs in the block are dropped if there isn't space
  *
- * @param[in]   log_id      The log ID to check
- * @param[in]   sig_id      The sig ID of the incoming log
+ * This function assumes that the caller already holds @ref logSysMutex
+ */
+static void log_spill_add(const uint8_t *buffer, const log_block_info_t *info) {
+    if ((sizeof(*info) + info->size) > (LOG_SPILL_BUF_SIZE - log_spill.len)) {
+        log_spill.dropped += info->log_count;
+        return;
+    }
+
+    memcpy(&log_spill.data[log_spill.len], info, sizeof(*info));
+    memcpy(&log_spill.data[log_spill.len + sizeof(*info)], buffer, info->size);
+    log_spill.len += sizeof(*info) + info->size;
+}
+
+/**
+ * @brief Save the blocks held in @ref log_spill, oldest first, until the next logfile is pinned again
+ * or the write ring is full
  *
- * @return true if the log is saveable, false if not
+ * This function assumes that the caller already holds @ref logSysMutex
  */
-static inline bool saveable_log(uint8_t log_id, uint8_t sig_id) {
-    for (size_t x = 0; x < n_pairs; x++) {
-        if ((log_id == log_sig_pairs[x].log_id) && (sig_id == log_sig_pairs[x].sig_id)) {
-            return false;
+static void log_spill_drain(void) {
+    while (log_spill.head != log_spill.len) {
+        log_block_info_t info;
+        bool pinned = false;
+
+        memcpy(&info, &log_spill.data[log_spill.head], sizeof(info));
+
+        if ((log_file_append(&log_spill.data[log_spill.head + sizeof(info)], &info, &pinned) != FS_OK) || pinned) {
+            break;
         }
+
+        log_spill.head += sizeof(info) + info.size;
     }
 
-    return true;
+    if (log_spill.head == log_spill.len) {
+        log_spill.head = 0;
+        log_spill.len = 0;
+    }
 }
 
+/**
+ * @brief Save the log messages held in @ref log_spill when no new logs are coming in
+ */
+static void log_spill_flush(void) {
+    if (!log_2_flash_initialized || (log_spill.head == log_spill.len)) {
+        return;
+    }
+
+    if (xSemaphoreTake(logSysMutex, pdMS_TO_TICKS(LOG_SYS_MUTEX_TIMEOUT_MS)) == pdTRUE) {
+        log_spill_drain();
+        xSemaphoreGive(logSysMutex);
+    }
+}
+
+/**
+ * @brief Logs a signal with a raw payload
+ *
+ * The payload is truncated to MAX_PAYLOAD_SIZE bytes
+ */
 static void log_signal_internal(uint8_t log_id, uint8_t sig_id, size_t raw_payload_len, const void *payload_ptr, bool use_rtc) {
     // Determine payload len -> if too large, cap at MAX_PAYLOAD_SIZE
     uint8_t payload_len;
@@ -529,50 +1002,335 @@ static void log_signal_internal(uint8_t log_id, uint8_t sig_id, size_t raw_paylo
         LOG_LOGGER__PAYLOAD_TOO_LARGE();
     }
 
-    uint8_t message_buf[LOG_DELIMITER_SIZE + HEADER_SIZE + MAX_PAYLOAD_SIZE] = {0}; // TODO(ALEA-3185): This buffer can cause some tasks to overflow
+    if (payload_ptr == NULL) {
+        payload_len = 0;
+    }
+
+    epoch_t epoch = log_timestamp(use_rtc);
+
+    log_staging_ring_t *ring = staging_begin();
+    uint8_t *payload = staging_reserve(ring, log_id, sig_id, payload_len, epoch);
+
+    if (payload != NULL) {
+        if (payload_len > 0) {
+            memcpy(payload, payload_ptr, payload_len);
+        }
+
+        staging_commit(ring, payload_len);
+    }
+
+    staging_end(ring);
+
+    log_mram_capture(ring, payload, log_id, sig_id, payload_len);
+}
+
+/**
+ * @brief Get the timestamp for a log
+ *
+ * Must be called before reserving space in the staging ring, since reading the RTC can log errors itself.
+ */
+static epoch_t log_timestamp(bool use_rtc) {
+    // Grab a timestamp if the logger is configured to read from the RTC.
+    // TODO ALEA-357 Handle RTC errors in the RTC module (shouldn't need this switch)
+    if (use_rtc) {
+        return rtc_get_epoch_time();
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the staging ring of the calling task
+ *
+ * Code that is not running in an OBC task shares a ring, which is protected by a critical section until
+ * @ref staging_end is called. Nothing between the two calls may log or block.
+ */
+static log_staging_ring_t *staging_begin(void) {
+    obc_task_id_t task_id = obc_rtos_get_current_task_id();
+
+    if (task_id >= OBC_TASK_COUNT) {
+        taskENTER_CRITICAL();
+        return &staging_rings[LOG_STAGING_SHARED_RING];
+    }
+
+    return &staging_rings[task_id];
+}
+
+/**
+ * @brief Reserve space for a log in a staging ring and encode its header
+ *
+ * The log is dropped (and counted) if the ring is full. The reserved space is only visible to the log
+ * writer task once @ref staging_commit is called.
+ *
+ * @param[in] ring        Ring returned by @ref staging_begin
+ * @param[in] log_id      The log group ID
+ * @param[in] sig_id      The signal ID
+ * @param[in] payload_len Size of the payload (bytes)
+ * @param[in] epoch       Timestamp of the log
+ *
+ * @return Pointer to where the payload must be written, NULL if the log was dropped
+ */
+static uint8_t *staging_reserve(log_staging_ring_t *ring, uint8_t log_id, uint8_t sig_id, uint8_t payload_len, epoch_t epoch) {
+    uint32_t rec_size = 1U + HEADER_SIZE + payload_len;
+    uint32_t head = ring->head;
+
+    // Records are never split across the end of the buffer, skip to the start instead
+    uint32_t idx = head & LOG_STAGING_RING_MASK;
+    uint32_t gap = ((idx + rec_size) > LOG_STAGING_RING_SIZE) ? (LOG_STAGING_RING_SIZE - idx) : 0;
+
+    if (((head + gap + rec_size) - ring->tail) > LOG_STAGING_RING_SIZE) {
+        ring->dropped++;
+        return NULL;
+    }
+
+    if (gap > 0) {
+        ring->data[idx] = LOG_STAGING_WRAP;
+        idx = 0;
+    }
+
+    ring->gap = gap;
+
+    uint8_t *rec = &ring->data[idx];
+    rec[0] = HEADER_SIZE + payload_len;
+    encode_header(log_id, sig_id, payload_len, &rec[1], epoch);
 
-    // Write the log delimiter to the beginning of the message buffer (for log2fs)
-    for (int x = 0; x < LOG_DELIMITER_SIZE; x++) {
-        message_buf[x] = LOG_DELIMITER[x];
+    return &rec[1 + HEADER_SIZE];
+}
+
+/**
+ * @brief Publish the log reserved with @ref staging_reserve to the log writer task
+ */
+static void staging_commit(log_staging_ring_t *ring, uint8_t payload_len) {
+    ring->head = ring->head + ring->gap + 1U + HEADER_SIZE + payload_len;
+}
+
+/**
+ * @brief Release the ring returned by @ref staging_begin and wake up the log writer task
+ */
+static void staging_end(log_staging_ring_t *ring) {
+    if (ring == &staging_rings[LOG_STAGING_SHARED_RING]) {
+        taskEXIT_CRITICAL();
+    }
+
+    if (log_writer_task_handle != NULL) {
+        xTaskNotifyGive(log_writer_task_handle);
     }
+}
 
-    // Populate the header in the output buffer
-    encode_header(log_id, sig_id, payload_len, &message_buf[LOG_DELIMITER_SIZE], use_rtc);
+/**
+ * @brief Write the logs in a staging ring to serial and the filesystem
+ *
+ * Must only be called from the log writer task.
+ *
+ * @return true if any logs were written
+ */
+static bool staging_drain(log_staging_ring_t *ring) {
+    uint32_t head = ring->head;
+    uint32_t tail = ring->tail;
 
-    // If this message has a payload...
-    if ((payload_len > 0) && (payload_ptr != NULL)) {
-        // Populate the payload data in the output buffer
-        memcpy(&message_buf[LOG_DELIMITER_SIZE + HEADER_SIZE], payload_ptr, payload_len);
+    if (tail == head) {
+        return false;
     }
 
-    const size_t message_size = HEADER_SIZE + payload_len;
-    log_sys_serial_write_log(&message_buf[LOG_DELIMITER_SIZE], message_size, pdMS_TO_TICKS(SERIAL_TIMEOUT_MS));
+    while (tail != head) {
+        uint32_t idx = tail & LOG_STAGING_RING_MASK;
+        uint8_t size = ring->data[idx];
+
+        if (size == LOG_STAGING_WRAP) {
+            tail += LOG_STAGING_RING_SIZE - idx;
+            continue;
+        }
+
+        // Copied out so the space can be given back to the producer before blocking on serial and the filesystem
+        memcpy(log_writer_buf, &ring->data[idx + 1U], size);
+        tail += 1U + size;
+        ring->tail = tail;
+
+        const uint8_t log_id = log_writer_buf[4];
+        const uint8_t sig_id = log_writer_buf[5];
+        const uint8_t sinks  = log_filter_get_sinks(log_id, sig_id);
+
+        if (sinks & LOG_SINK_SERIAL) {
+            log_sys_serial_write_log(log_writer_buf, size, pdMS_TO_TICKS(SERIAL_TIMEOUT_MS));
+        }
 
-    if (log_2_flash_initialized && saveable_log(log_id, sig_id) /* TODO: get severity level? */) {
-        fs_log_save(message_buf, LOG_DELIMITER_SIZE + message_size);
+        // Logs are saved to FS in the compact block encoding rather than with the serial header
+        if (log_2_flash_initialized && (sinks & LOG_SINK_FS)) {
+            log_block_append(data_fmt_arr_be_to_u32(log_writer_buf), log_id, sig_id, &log_writer_buf[HEADER_SIZE], log_writer_buf[6]);
+        }
     }
+
+    ring->tail = tail;
+
+    return true;
+}
+
+/**
+ * @brief Log writer task
+ *
+ * Single consumer of all the staging rings. Logs are written in the order they were made within each
+ * task, but not necessarily across tasks (the timestamp in the header gives the order).
+ */
+static void log_writer_task(void *pvParameters) {
+    log_block_init(&log_block);
+
+    while (1) {
+        obc_watchdog_pet(OBC_TASK_ID_LOG_WRITER);
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_WRITER_PERIOD_MS));
+
+        // Save the logs from before the reset first, they are older than anything in the staging rings
+        if (!log_mram_recovery_done && log_2_flash_initialized) {
+            uint32_t recovered = log_mram_recover(&log_mram_recovered);
+            log_mram_recovery_done = true;
+
+            if (recovered > 0) {
+                LOG_LOG_SYS__MRAM_RECOVERED(recovered);
+            }
+        }
+
+        // Logs are staged before they are written to MRAM, so the logs before this are drained below
+        uint32_t mram_head = log_mram_get_head();
+        bool drained = true;
+
+        while (drained) {
+            drained = false;
+
+            for (uint32_t i = 0; i < LOG_STAGING_RING_COUNT; i++) {
+                drained |= staging_drain(&staging_rings[i]);
+            }
+
+            obc_watchdog_pet(OBC_TASK_ID_LOG_WRITER);
+        }
+
+        if (log_mram_recovery_done) {
+            log_mram_sync.drained = mram_head;
+            log_mram_sync.drained_valid = true;
+        }
+
+        if ((log_block.record_count > 0) && ((xTaskGetTickCount() - log_block_start_ticks) >= pdMS_TO_TICKS(LOG_BLOCK_MAX_AGE_MS))) {
+            log_block_save();
+        }
+
+        log_spill_flush();
+
+        if (log_mram_recovery_done) {
+            log_mram_sync_step();
+        }
+
+        uint32_t mram_errors = log_mram_get_errors();
+
+        if (mram_errors != log_mram_errors_reported) {
+            LOG_LOG_SYS__MRAM_WRITE_FAILED(mram_errors - log_mram_errors_reported);
+            log_mram_errors_reported = mram_errors;
+        }
+
+        if (log_spill.dropped != log_spill.dropped_reported) {
+            LOG_LOG_SYS__SPILL_DROPPED(log_spill.dropped - log_spill.dropped_reported);
+            log_spill.dropped_reported = log_spill.dropped;
+        }
+
+        for (uint32_t i = 0; i < LOG_STAGING_RING_COUNT; i++) {
+            log_staging_ring_t *ring = &staging_rings[i];
+            uint32_t dropped = ring->dropped;
+
+            if (dropped != ring->dropped_reported) {
+                LOG_LOG_SYS__STAGING_DROPPED((uint8_t)i, dropped - ring->dropped_reported);
+                ring->dropped_reported = dropped;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Write a log that was just staged to the MRAM ring if it is severe enough
+ *
+ * Only logs from tasks are written, logs staged in the shared ring may come from a critical section or
+ * from before the scheduler started, where the MRAM can't be used. The log stays in the task's own ring
+ * until the task logs again, so it can be read back from there.
+ *
+ * @param[in] ring    Ring the log was staged in
+ * @param[in] payload Payload of the log in the ring, preceded by the header. NULL if the log was dropped.
+ */
+static void log_mram_capture(const log_staging_ring_t *ring, const uint8_t *payload, uint8_t log_id, uint8_t sig_id, uint8_t payload_len) {
+    if ((payload == NULL) || (ring == &staging_rings[LOG_STAGING_SHARED_RING])) {
+        return;
+    }
+
+    if (log_filter_get_level(log_id, sig_id) < LOG_MRAM_MIN_LEVEL) {
+        return;
+    }
+
+    (void)log_mram_write(payload - HEADER_SIZE, HEADER_SIZE + payload_len);
+}
+
+/**
+ * @brief Save a log recovered from the MRAM ring to FS
+ *
+ * Must only be called from the log writer task.
+ */
+static void log_mram_recovered(const uint8_t *record, uint8_t len) {
+    if ((len < HEADER_SIZE) || (record[6] != (len - HEADER_SIZE))) {
+        return;
+    }
+
+    log_block_append(data_fmt_arr_be_to_u32(record), record[4], record[5], &record[HEADER_SIZE], record[6]);
+}
+
+/**
+ * @brief Mark the logs in the MRAM ring as saved once the log files they were queued to are committed to flash
+ *
+ * Takes the position of the last saved block and the amount of data queued to each log file, then waits
+ * for the filesystem to commit that much of each file (at the latest at its next periodic sync). Only one
+ * position is waited for at a time, so logs written in the meantime are recovered again after a reset.
+ *
+ * Must only be called from the log writer task.
+ */
+static void log_mram_sync_step(void) {
+    uint32_t enqueued = 0;
+    uint32_t committed = 0;
+
+    if (!log_mram_sync.waiting) {
+        // Spilled blocks haven't been queued to the log files yet
+        if (!log_mram_sync.saved_valid || (log_mram_sync.saved == log_mram_sync.pending) || (log_spill.head != log_spill.len)) {
+            return;
+        }
+
+        for (uint8_t i = 0; i < FS_LOGGING_FILES_NUM; i++) {
+            if (fs_get_commit_progress(log_file_handles[i], &enqueued, &committed) != FS_OK) {
+                return;
+            }
+
+            log_mram_sync.targets[i] = enqueued;
+        }
+
+        log_mram_sync.pending = log_mram_sync.saved;
+        log_mram_sync.waiting = true;
+    }
+
+    for (uint8_t i = 0; i < FS_LOGGING_FILES_NUM; i++) {
+        if ((fs_get_commit_progress(log_file_handles[i], &enqueued, &committed) != FS_OK) ||
+            ((int32_t)(committed - log_mram_sync.targets[i]) < 0)) {
+            return;
+        }
+    }
+
+    log_mram_set_synced(log_mram_sync.pending);
+    log_mram_sync.waiting = false;
 }
 
 /**
  * @brief Encodes the message header.
  *
- * @param[in]  lvl The log level to use (DEBUG, WARNING, INFO, ERROR).
  * @param[in]  log_id The log group ID to use.
  * @param[in]  sig_id The signal ID to use.
  * @param[in]  size The size of the payload (bytes).
  * @param[out] header_ptr Pointer to the top of the message buffer. The header will be placed here.
+ * @param[in]  epoch Timestamp of the log.
  */
-static void encode_header(uint8_t log_id, uint8_t sig_id, uint8_t size, uint8_t header_ptr[HEADER_SIZE], bool use_rtc) {
-    epoch_t current_epoch = 0;
-
-    // Grab a timestamp if the logger is configured to read from the RTC.
-    // TODO ALEA-357 Handle RTC errors in the RTC module (shouldn't need this switch)
-    if (use_rtc) {
-        current_epoch = rtc_get_epoch_time();
-    }
-
+static void encode_header(uint8_t log_id, uint8_t sig_id, uint8_t size, uint8_t header_ptr[HEADER_SIZE], epoch_t epoch) {
     // byte 0-3: epoch (big-endian)
-    data_fmt_u32_to_arr_be((uint32_t) current_epoch, header_ptr);
+    data_fmt_u32_to_arr_be((uint32_t) epoch, header_ptr);
     // byte 4:  log_id
     header_ptr[4] = (uint8_t)log_id;
     // byte 5: sig_id
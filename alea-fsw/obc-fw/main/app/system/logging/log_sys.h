@@ -71,11 +71,19 @@ void logs_read_end();
 
 int32_t logs_read();
 
+int32_t logs_query_begin(uint32_t epoch_start, uint32_t epoch_end, uint8_t log_id, uint32_t max_bytes);
+int32_t logs_query_read(uint8_t *buf, uint32_t size);
+void logs_query_end(void);
+
 bool log_sys_get_info(struct logfile_info_t *info);
 
 /**
  * @brief Logs a signal
  *
+ * Logs are encoded into a staging ring owned by the calling task and written to serial and the
+ * filesystem by the log writer task, so logging never blocks on either. The log is dropped if the
+ * ring is full.
+ *
  * @param[in] log_id The message ID to use.
  * @param[in] sig_id The signal to log.
  */
@@ -1,6 +1,23 @@
 /**
  * @file rtc_scheduler.c
  * @brief RTC-based scheduler
+ *
+ * The schedule is persisted in a journal file so that it survives resets and can hold far more items
+ * than fit in RAM. Adding an item appends an ADD record holding the item and its data, and running or
+ * cancelling it appends a DONE record. Once the DONE records make up a large part of the journal, it is
+ * compacted by copying the items still waiting to a new journal which replaces the old one.
+ *
+ * Journal record layout (multi-byte fields are big-endian):
+ *
+ *  | type (1) | priority (1) | tag (1) | data_len (1) | id (4) | timestamp (4) | data_crc (2) | header_crc (2) | data (data_len) |
+ *
+ * Only a small state is kept in RAM for every slot (the low 16 bits of an item ID), which is enough to
+ * tell if an ADD record in the journal is still waiting. The RTC_SCHEDULER_HOT_ITEMS soonest items are
+ * kept in a min-heap, the others (the cold items) are all later than the items in the heap. When the
+ * heap runs out, it is refilled with the soonest items by scanning the journal.
+ *
+ * Items are run by polling rtc_scheduler_pop_due. An item is marked done before it is returned so that
+ * an item that resets the OBC runs at most once.
  */
 
 /******************************************************************************/
@@ -10,54 +27,126 @@
 #include "rtc_scheduler.h"
 
 // OBC
-#include "obc_rtc.h"
+#include "obc_filesystem.h"
 
 // Utils
-#include "sequence.h"
+#include "min_heap.h"
+#include "obc_crc.h"
 #include "obc_utils.h"
+#include "data_fmt.h"
+
+// FreeRTOS
+#include "rtos.h"
 
 // Standard Library
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 /******************************************************************************/
 /*                               D E F I N E S                                */
 /******************************************************************************/
 
-#define SCHEDULE_MAX_ITEMS 8U
+#define JOURNAL_FILENAME        "sched.jnl"
+#define JOURNAL_TMP_FILENAME    "sched.tmp"
+
+#define JOURNAL_FS_TIMEOUT_MS   1000U
+
+#define RECORD_TYPE_ADD         0x41U // 'A'
+#define RECORD_TYPE_DONE        0x44U // 'D'
+
+#define RECORD_HDR_SIZE         16U
+#define RECORD_DATA_CRC_OFFSET  12U
+#define RECORD_HDR_CRC_OFFSET   14U
+#define RECORD_MAX_SIZE         (RECORD_HDR_SIZE + RTC_SCHEDULER_MAX_DATA_SIZE)
+
+/* Reads of the journal go through a cache that is large enough for any record */
+#define JOURNAL_CACHE_SIZE      512U
+
+/* The journal is compacted once it has this many DONE records, or more DONE records than items waiting */
+#define COMPACT_MIN_DONE        64U
+
+#define ID_SLOT(id)             ((uint16_t)((id) & 0xFFFFU))
+#define ID_GEN(id)              ((uint8_t)((id) >> 16))
+#define MAKE_ID(gen, slot)      (((uint32_t)(gen) << 16) | (uint32_t)(slot))
+
+/* List cursors hold the journal offset and the number of compactions that changed the offsets */
+#define CURSOR_OFFSET_MASK      0x00FFFFFFUL
+#define MAKE_CURSOR(gen, off)   (((uint32_t)(gen) << 24) | ((off) & CURSOR_OFFSET_MASK))
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef struct {
+    uint8_t type;
+    rtc_scheduler_entry_t entry;
+    uint16_t data_crc;
+} record_t;
 
-#define ALARM_CALLBACK_MUTEX_TIMEOUT_MS 100
+typedef struct {
+    rtc_scheduler_entry_t entry;
+    uint32_t offset;                // Offset of the ADD record of the item in the journal
+} hot_item_t;
 
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
 /******************************************************************************/
 
-static void alarm_callback(void *arg);
-static void update_alarm(void);
+static rtc_scheduler_err_t refill(void);
+static rtc_scheduler_err_t compact(void);
+static void hot_insert(const hot_item_t *item, uint16_t cold_count);
+static bool hot_remove(uint32_t id);
+
+static rtc_scheduler_err_t journal_read(uint32_t offset, uint8_t *buf, uint32_t len);
+static rtc_scheduler_err_t journal_append(const char *filename, const uint8_t *buf, uint32_t len, const uint8_t *data, uint32_t data_len);
+static rtc_scheduler_err_t read_record(uint32_t offset, record_t *record);
+static rtc_scheduler_err_t append_done(uint32_t id);
+static void encode_record(const record_t *record, uint8_t *buf);
 
-static void store_item(const void *item, uint8_t storage_idx);
-static bool goes_before(uint8_t idx_a, uint8_t idx_b);
+static bool is_active(uint32_t id);
+static void set_active(uint16_t slot, bool active);
+static uint16_t find_free_slot(void);
+
+static bool goes_before(const void *a, const void *b);
 
 /******************************************************************************/
 /*               P R I V A T E  G L O B A L  V A R I A B L E S                */
 /******************************************************************************/
 
-static rtc_scheduler_item_t scheduler_storage[SCHEDULE_MAX_ITEMS] = { 0 };
-static uint8_t scheduler_data_storage[SCHEDULE_MAX_ITEMS][RTC_SCHEDULER_MAX_DATA_SIZE] = { 0 };
+static SemaphoreHandle_t schedule_mutex = NULL;
 
-static uint8_t sequence_links[SCHEDULE_MAX_ITEMS] = { 0 };
-static sequence_t scheduler_sequence = {
-    .size             = SCHEDULE_MAX_ITEMS,
+/* Everything below is only used with schedule_mutex held */
 
-    .store_item       = &store_item,
-    .goes_before      = &goes_before,
+static bool loaded = false;
 
-    .links            = sequence_links,
-    .active_list_head = 0,
-    .empty_list_head  = 0,
+static uint8_t slot_gens[RTC_SCHEDULER_MAX_ITEMS] = { 0 };            // Generation of the last item added to each slot
+static uint32_t active_slots[RTC_SCHEDULER_MAX_ITEMS / 32U] = { 0 };  // Bitmap of the slots holding a waiting item
+static uint16_t active_count = 0;
+static uint16_t next_slot = 0;
+
+static uint32_t journal_size = 0;
+static uint32_t done_count = 0;
+static uint8_t journal_gen = 0;
+
+static hot_item_t hot_storage[RTC_SCHEDULER_HOT_ITEMS] = { 0 };
+static min_heap_t hot_heap = {
+    .size        = RTC_SCHEDULER_HOT_ITEMS,
+    .item_size   = sizeof(hot_item_t),
+    .goes_before = &goes_before,
+    .items       = (uint8_t *)hot_storage,
+    .count       = 0,
 };
 
-static SemaphoreHandle_t schedule_mutex = NULL;
+static uint8_t cache[JOURNAL_CACHE_SIZE] = { 0 };
+static uint32_t cache_offset = 0;
+static uint32_t cache_len = 0;
+
+static uint8_t compact_buf[JOURNAL_CACHE_SIZE] = { 0 };
+
+CASSERT(JOURNAL_CACHE_SIZE >= RECORD_MAX_SIZE, rtc_scheduler_c);
+CASSERT(RTC_SCHEDULER_MAX_DATA_SIZE <= UINT8_MAX, rtc_scheduler_c);
+CASSERT((RTC_SCHEDULER_MAX_ITEMS % 32U) == 0, rtc_scheduler_c);
 
 /******************************************************************************/
 /*                       P U B L I C  F U N C T I O N S                       */
@@ -69,42 +158,140 @@ static SemaphoreHandle_t schedule_mutex = NULL;
 void rtc_scheduler_pre_init(void) {
     static StaticSemaphore_t schedule_mutex_buf = { 0 };
 
-    uint32_t i = 0;
+    min_heap_init(&hot_heap);
 
-    // Clear all the schedule data
-    memset(scheduler_storage, 0, sizeof(scheduler_storage));
-    memset(scheduler_data_storage, 0, sizeof(scheduler_data_storage));
+    schedule_mutex = xSemaphoreCreateMutexStatic(&schedule_mutex_buf);
+}
 
-    for (i = 0; i < LEN(scheduler_storage); i++) {
-        scheduler_storage[i].timestamp = 0;
-        scheduler_storage[i].priority = 0;
-        scheduler_storage[i].cb = NULL;
-        scheduler_storage[i].data_len = 0;
-        scheduler_storage[i].data = &(scheduler_data_storage[i][0]);
+/**
+ * @brief Load the schedule from the journal
+ *
+ * This must be called (once the filesystem is mounted) before any other operations on the schedule.
+ * A journal ending with a record that is incomplete or fails its CRC check is truncated before it.
+ *
+ * @param[in] timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - RTC_SCHEDULER_SUCCESS if the schedule is loaded
+ *            - RTC_SCHEDULER_ERR_FS if the journal could not be read
+ *            - RTC_SCHEDULER_MUTEX_TIMEOUT if a timeout occurs waiting for the schedule mutex
+ */
+rtc_scheduler_err_t rtc_scheduler_load(uint32_t timeout_ticks) {
+    if (xSemaphoreTake(schedule_mutex, timeout_ticks) == pdFALSE) {
+        return RTC_SCHEDULER_MUTEX_TIMEOUT;
     }
 
-    // Initialize sequence
-    sequence_init(&scheduler_sequence);
+    loaded = false;
+    memset(slot_gens, 0, sizeof(slot_gens));
+    memset(active_slots, 0, sizeof(active_slots));
+    active_count = 0;
+    next_slot = 0;
+    done_count = 0;
+    cache_len = 0;
+    min_heap_init(&hot_heap);
 
-    schedule_mutex = xSemaphoreCreateMutexStatic(&schedule_mutex_buf);
+    fs_entry_info_t info;
+    fs_err_t fs_err = fs_stat(JOURNAL_FILENAME, &info, JOURNAL_FS_TIMEOUT_MS);
+    uint32_t file_size = (fs_err == FS_OK) ? info.size : 0U;
+
+    if ((fs_err != FS_OK) && (fs_err != FS_NOENT_ERR)) {
+        xSemaphoreGive(schedule_mutex);
+        return RTC_SCHEDULER_ERR_FS;
+    }
+
+    // Replay the journal
+    uint32_t offset = 0;
+    journal_size = file_size;
+
+    while ((offset + RECORD_HDR_SIZE) <= file_size) {
+        record_t record;
+        rtc_scheduler_err_t err = read_record(offset, &record);
+
+        if (err == RTC_SCHEDULER_ERR_FS) {
+            xSemaphoreGive(schedule_mutex);
+            return err;
+        }
+
+        uint16_t slot = ID_SLOT(record.entry.id);
+        uint32_t size = RECORD_HDR_SIZE + record.entry.data_len;
+
+        if ((err != RTC_SCHEDULER_SUCCESS) || (slot >= RTC_SCHEDULER_MAX_ITEMS) || ((offset + size) > file_size)) {
+            break;
+        }
+
+        if (record.type == RECORD_TYPE_ADD) {
+            if (!is_active(MAKE_ID(slot_gens[slot], slot))) {
+                active_count++;
+            }
+
+            slot_gens[slot] = ID_GEN(record.entry.id);
+            set_active(slot, true);
+        } else if (record.type == RECORD_TYPE_DONE) {
+            if (is_active(record.entry.id)) {
+                set_active(slot, false);
+                active_count--;
+            }
+
+            done_count++;
+        } else {
+            break;
+        }
+
+        offset += size;
+    }
+
+    // Drop what follows the last valid record
+    if (offset < file_size) {
+        lfs_file_t file = { 0 };
+        fs_err = fs_open(&file, JOURNAL_FILENAME, JOURNAL_FS_TIMEOUT_MS);
+
+        if (fs_err == FS_OK) {
+            fs_err = fs_truncate(&file, (int32_t) offset);
+            fs_err_t close_err = fs_close(&file);
+            fs_err = (fs_err != FS_OK) ? fs_err : close_err;
+        }
+
+        if (fs_err != FS_OK) {
+            xSemaphoreGive(schedule_mutex);
+            return RTC_SCHEDULER_ERR_FS;
+        }
+
+        journal_size = offset;
+        cache_len = 0;
+    }
+
+    rtc_scheduler_err_t err = refill();
+
+    loaded = (err == RTC_SCHEDULER_SUCCESS);
+
+    xSemaphoreGive(schedule_mutex);
+
+    return err;
 }
 
 /**
- * @brief Add an item to the schedule and update the RTC alarm
+ * @brief Add an item to the schedule
  *
- * @param[in] item          Pointer to the item to schedule
- * @param[in] timeout_ticks Timeout for mutex (ticks)
+ * The item is written to the journal before this returns.
+ *
+ * This is a worst case O(log n) operation where n is RTC_SCHEDULER_HOT_ITEMS (plus the journal append).
+ *
+ * @param[in]  item          Pointer to the item to schedule (the data is copied)
+ * @param[out] id            Optional pointer where the ID of the item is stored
+ * @param[in]  timeout_ticks Timeout for mutex (ticks)
  *
  * @return Status code:
  *            - RTC_SCHEDULER_SUCCESS if the item is successfully scheduled
  *            - RTC_SCHEDULER_ERR_INVALID_ARGS if item is NULL
  *            - RTC_SCHEDULER_ERR_DATA_TOO_LONG if the item data_len is too long (see RTC_SCHEDULER_MAX_DATA_SIZE)
- *            - RTC_SCHEDULER_FULL if there is no more space left in the schedule memory
+ *            - RTC_SCHEDULER_FULL if there are already RTC_SCHEDULER_MAX_ITEMS items waiting
+ *            - RTC_SCHEDULER_ERR_FS if the item could not be written to the journal
+ *            - RTC_SCHEDULER_ERR_NOT_LOADED if the schedule isn't loaded
  *            - RTC_SCHEDULER_MUTEX_TIMEOUT if a timeout occurs waiting for the schedule mutex
  */
-rtc_scheduler_err_t rtc_scheduler_add_item(const rtc_scheduler_item_t *item, uint32_t timeout_ticks) {
+rtc_scheduler_err_t rtc_scheduler_add_item(const rtc_scheduler_item_t *item, uint32_t *id, uint32_t timeout_ticks) {
     // Check arguments
-    if (item == NULL) {
+    if ((item == NULL) || ((item->data == NULL) && (item->data_len > 0))) {
         return RTC_SCHEDULER_ERR_INVALID_ARGS;
     }
 
@@ -117,12 +304,53 @@ rtc_scheduler_err_t rtc_scheduler_add_item(const rtc_scheduler_item_t *item, uin
         return RTC_SCHEDULER_MUTEX_TIMEOUT;
     }
 
-    rtc_scheduler_err_t err = RTC_SCHEDULER_FULL;
+    if (!loaded) {
+        xSemaphoreGive(schedule_mutex);
+        return RTC_SCHEDULER_ERR_NOT_LOADED;
+    }
 
-    if (sequence_insert(&scheduler_sequence, item)) {
-        // Item successfully inserted into schedule
-        update_alarm();
-        err = RTC_SCHEDULER_SUCCESS;
+    if (active_count >= RTC_SCHEDULER_MAX_ITEMS) {
+        xSemaphoreGive(schedule_mutex);
+        return RTC_SCHEDULER_FULL;
+    }
+
+    uint16_t slot = find_free_slot();
+    uint8_t gen = slot_gens[slot] + 1U;
+
+    record_t record = {
+        .type = RECORD_TYPE_ADD,
+        .entry = {
+            .id        = MAKE_ID(gen, slot),
+            .timestamp = item->timestamp,
+            .priority  = item->priority,
+            .tag       = item->tag,
+            .data_len  = (uint8_t) item->data_len,
+        },
+        .data_crc = crc_16_buf(CRC16_SEED, item->data, item->data_len),
+    };
+
+    uint8_t hdr[RECORD_HDR_SIZE];
+    encode_record(&record, hdr);
+
+    rtc_scheduler_err_t err = journal_append(JOURNAL_FILENAME, hdr, sizeof(hdr), item->data, item->data_len);
+
+    if (err == RTC_SCHEDULER_SUCCESS) {
+        hot_item_t hot_item = {
+            .entry  = record.entry,
+            .offset = journal_size,
+        };
+
+        slot_gens[slot] = gen;
+        set_active(slot, true);
+        active_count++;
+        next_slot = (slot + 1U) % RTC_SCHEDULER_MAX_ITEMS;
+        journal_size += RECORD_HDR_SIZE + item->data_len;
+
+        hot_insert(&hot_item, active_count - 1U - hot_heap.count);
+
+        if (id != NULL) {
+            *id = record.entry.id;
+        }
     }
 
     // Release mutex
@@ -131,89 +359,579 @@ rtc_scheduler_err_t rtc_scheduler_add_item(const rtc_scheduler_item_t *item, uin
     return err;
 }
 
+/**
+ * @brief Remove an item from the schedule before it runs
+ *
+ * @param[in] id            ID of the item (see rtc_scheduler_add_item)
+ * @param[in] timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - RTC_SCHEDULER_SUCCESS if the item is removed
+ *            - RTC_SCHEDULER_ERR_ID_DNE if no item with this ID is waiting
+ *            - RTC_SCHEDULER_ERR_FS if the removal could not be written to the journal
+ *            - RTC_SCHEDULER_ERR_NOT_LOADED if the schedule isn't loaded
+ *            - RTC_SCHEDULER_MUTEX_TIMEOUT if a timeout occurs waiting for the schedule mutex
+ */
+rtc_scheduler_err_t rtc_scheduler_cancel(uint32_t id, uint32_t timeout_ticks) {
+    if (xSemaphoreTake(schedule_mutex, timeout_ticks) == pdFALSE) {
+        return RTC_SCHEDULER_MUTEX_TIMEOUT;
+    }
+
+    rtc_scheduler_err_t err = RTC_SCHEDULER_ERR_ID_DNE;
+
+    if (!loaded) {
+        err = RTC_SCHEDULER_ERR_NOT_LOADED;
+    } else if (is_active(id)) {
+        err = append_done(id);
+
+        if (err == RTC_SCHEDULER_SUCCESS) {
+            // Cold items are simply forgotten, they are skipped by the next refill
+            hot_remove(id);
+        }
+    }
+
+    xSemaphoreGive(schedule_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Check if an item is still waiting in the schedule
+ *
+ * @param[in]  id            ID of the item (see rtc_scheduler_add_item)
+ * @param[out] waiting       Set to true if the item is waiting, false if it has run, was cancelled or never existed
+ * @param[in]  timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - RTC_SCHEDULER_SUCCESS if waiting is set
+ *            - RTC_SCHEDULER_ERR_INVALID_ARGS if waiting is NULL
+ *            - RTC_SCHEDULER_ERR_NOT_LOADED if the schedule isn't loaded
+ *            - RTC_SCHEDULER_MUTEX_TIMEOUT if a timeout occurs waiting for the schedule mutex
+ */
+rtc_scheduler_err_t rtc_scheduler_is_waiting(uint32_t id, bool *waiting, uint32_t timeout_ticks) {
+    if (waiting == NULL) {
+        return RTC_SCHEDULER_ERR_INVALID_ARGS;
+    }
+
+    if (xSemaphoreTake(schedule_mutex, timeout_ticks) == pdFALSE) {
+        return RTC_SCHEDULER_MUTEX_TIMEOUT;
+    }
+
+    rtc_scheduler_err_t err = loaded ? RTC_SCHEDULER_SUCCESS : RTC_SCHEDULER_ERR_NOT_LOADED;
+
+    if (err == RTC_SCHEDULER_SUCCESS) {
+        *waiting = is_active(id);
+    }
+
+    xSemaphoreGive(schedule_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Remove the next item from the schedule if it is due
+ *
+ * This is meant to be polled regularly by the task that runs the items. Items whose timestamp has
+ * already passed when the schedule is loaded (e.g. because the OBC was off) are returned right away.
+ * The journal is also compacted from here when needed.
+ *
+ * @param[in]  now           Current epoch, items with a timestamp <= now are due
+ * @param[out] entry         Description of the item
+ * @param[out] data          Buffer of at least RTC_SCHEDULER_MAX_DATA_SIZE bytes where the data of the item is copied
+ * @param[in]  timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - RTC_SCHEDULER_SUCCESS if an item is returned
+ *            - RTC_SCHEDULER_NONE_DUE if no item is due
+ *            - RTC_SCHEDULER_ERR_INVALID_ARGS if entry or data is NULL
+ *            - RTC_SCHEDULER_ERR_CORRUPT if the data of the next item is corrupted (the item is removed and entry is set)
+ *            - RTC_SCHEDULER_ERR_FS if the journal could not be read or written
+ *            - RTC_SCHEDULER_ERR_NOT_LOADED if the schedule isn't loaded
+ *            - RTC_SCHEDULER_MUTEX_TIMEOUT if a timeout occurs waiting for the schedule mutex
+ */
+rtc_scheduler_err_t rtc_scheduler_pop_due(uint32_t now, rtc_scheduler_entry_t *entry, uint8_t *data, uint32_t timeout_ticks) {
+    if ((entry == NULL) || (data == NULL)) {
+        return RTC_SCHEDULER_ERR_INVALID_ARGS;
+    }
+
+    if (xSemaphoreTake(schedule_mutex, timeout_ticks) == pdFALSE) {
+        return RTC_SCHEDULER_MUTEX_TIMEOUT;
+    }
+
+    if (!loaded) {
+        xSemaphoreGive(schedule_mutex);
+        return RTC_SCHEDULER_ERR_NOT_LOADED;
+    }
+
+    if (done_count >= MAX(COMPACT_MIN_DONE, active_count)) {
+        // On failure, the old journal is still used and the compaction is tried again on the next call
+        compact();
+    }
+
+    rtc_scheduler_err_t err = RTC_SCHEDULER_SUCCESS;
+
+    if (min_heap_is_empty(&hot_heap) && (active_count > 0)) {
+        err = refill();
+    }
+
+    const hot_item_t *next = min_heap_peek(&hot_heap);
+
+    if ((err != RTC_SCHEDULER_SUCCESS) || (next == NULL) || (next->entry.timestamp > now)) {
+        xSemaphoreGive(schedule_mutex);
+        return (err != RTC_SCHEDULER_SUCCESS) ? err : RTC_SCHEDULER_NONE_DUE;
+    }
+
+    hot_item_t item = *next;
+    err = journal_read(item.offset + RECORD_HDR_SIZE, data, item.entry.data_len);
+
+    if (err == RTC_SCHEDULER_SUCCESS) {
+        record_t record;
+        err = read_record(item.offset, &record);
+
+        if ((err == RTC_SCHEDULER_SUCCESS) && (record.data_crc != crc_16_buf(CRC16_SEED, data, item.entry.data_len))) {
+            err = RTC_SCHEDULER_ERR_CORRUPT;
+        }
+    }
+
+    // The item stays in the schedule if the journal can't be read, otherwise it is done (even if it is corrupted)
+    if (err != RTC_SCHEDULER_ERR_FS) {
+        rtc_scheduler_err_t done_err = append_done(item.entry.id);
+
+        if (done_err == RTC_SCHEDULER_SUCCESS) {
+            min_heap_pop(&hot_heap, NULL);
+            *entry = item.entry;
+        } else {
+            err = done_err;
+        }
+    }
+
+    xSemaphoreGive(schedule_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Get the number of items waiting and the timestamp of the next one
+ *
+ * The journal isn't read, so the timestamp of the next item is RTC_SCHEDULER_TIMESTAMP_UNKNOWN while
+ * the soonest items are waiting to be read back from the journal (by the next rtc_scheduler_pop_due).
+ *
+ * @param[out] info          Schedule information
+ * @param[in]  timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - RTC_SCHEDULER_SUCCESS if info is set
+ *            - RTC_SCHEDULER_ERR_INVALID_ARGS if info is NULL
+ *            - RTC_SCHEDULER_ERR_NOT_LOADED if the schedule isn't loaded
+ *            - RTC_SCHEDULER_MUTEX_TIMEOUT if a timeout occurs waiting for the schedule mutex
+ */
+rtc_scheduler_err_t rtc_scheduler_get_info(rtc_scheduler_info_t *info, uint32_t timeout_ticks) {
+    if (info == NULL) {
+        return RTC_SCHEDULER_ERR_INVALID_ARGS;
+    }
+
+    if (xSemaphoreTake(schedule_mutex, timeout_ticks) == pdFALSE) {
+        return RTC_SCHEDULER_MUTEX_TIMEOUT;
+    }
+
+    rtc_scheduler_err_t err = loaded ? RTC_SCHEDULER_SUCCESS : RTC_SCHEDULER_ERR_NOT_LOADED;
+
+    if (err == RTC_SCHEDULER_SUCCESS) {
+        const hot_item_t *next = min_heap_peek(&hot_heap);
+
+        info->count          = active_count;
+        info->capacity       = RTC_SCHEDULER_MAX_ITEMS;
+        info->next_timestamp = (next != NULL) ? next->entry.timestamp : 0U;
+        info->journal_size   = journal_size;
+
+        // Refilling the heap scans the whole journal, which is left to rtc_scheduler_pop_due
+        if ((next == NULL) && (active_count > 0)) {
+            info->next_timestamp = RTC_SCHEDULER_TIMESTAMP_UNKNOWN;
+        }
+    }
+
+    xSemaphoreGive(schedule_mutex);
+
+    return err;
+}
+
+/**
+ * @brief List the items waiting in the schedule, in the order they were added
+ *
+ * Long schedules are listed over multiple calls: start with *cursor set to RTC_SCHEDULER_LIST_START
+ * and pass the updated cursor to the next call until it is set back to RTC_SCHEDULER_LIST_START.
+ * A cursor becomes invalid when the journal is compacted, the listing must then be started over.
+ *
+ * @param[in,out] cursor        Where to start listing, set to where the next call should start
+ * @param[out]    entries       Array of max_entries entries
+ * @param[in]     max_entries   Maximum number of entries to list
+ * @param[out]    count         Number of entries listed
+ * @param[in]     timeout_ticks Timeout for mutex (ticks)
+ *
+ * @return Status code:
+ *            - RTC_SCHEDULER_SUCCESS if entries are listed
+ *            - RTC_SCHEDULER_ERR_INVALID_ARGS if a pointer is NULL or the cursor is invalid
+ *            - RTC_SCHEDULER_ERR_FS if the journal could not be read
+ *            - RTC_SCHEDULER_ERR_NOT_LOADED if the schedule isn't loaded
+ *            - RTC_SCHEDULER_MUTEX_TIMEOUT if a timeout occurs waiting for the schedule mutex
+ */
+rtc_scheduler_err_t rtc_scheduler_list(uint32_t *cursor, rtc_scheduler_entry_t *entries, uint8_t max_entries, uint8_t *count,
+                                       uint32_t timeout_ticks) {
+    if ((cursor == NULL) || (entries == NULL) || (count == NULL)) {
+        return RTC_SCHEDULER_ERR_INVALID_ARGS;
+    }
+
+    if (xSemaphoreTake(schedule_mutex, timeout_ticks) == pdFALSE) {
+        return RTC_SCHEDULER_MUTEX_TIMEOUT;
+    }
+
+    uint32_t offset = *cursor & CURSOR_OFFSET_MASK;
+    rtc_scheduler_err_t err = RTC_SCHEDULER_SUCCESS;
+
+    if (!loaded) {
+        err = RTC_SCHEDULER_ERR_NOT_LOADED;
+    } else if ((*cursor != RTC_SCHEDULER_LIST_START) && ((MAKE_CURSOR(journal_gen, offset) != *cursor) || (offset >= journal_size))) {
+        err = RTC_SCHEDULER_ERR_INVALID_ARGS;
+    }
+
+    *count = 0;
+
+    while ((err == RTC_SCHEDULER_SUCCESS) && (offset < journal_size) && (*count < max_entries)) {
+        record_t record;
+        err = read_record(offset, &record);
+
+        if ((err == RTC_SCHEDULER_SUCCESS) && (record.type == RECORD_TYPE_ADD) && is_active(record.entry.id)) {
+            entries[*count] = record.entry;
+            (*count)++;
+        }
+
+        offset += RECORD_HDR_SIZE + record.entry.data_len;
+    }
+
+    if (err == RTC_SCHEDULER_SUCCESS) {
+        *cursor = (offset < journal_size) ? MAKE_CURSOR(journal_gen, offset) : RTC_SCHEDULER_LIST_START;
+    }
+
+    xSemaphoreGive(schedule_mutex);
+
+    return err;
+}
+
 /******************************************************************************/
 /*                      P R I V A T E  F U N C T I O N S                      */
 /******************************************************************************/
 
 /**
- * @brief Callback triggered by the RTC alarm
+ * @brief Rebuild the heap with the soonest items by scanning the journal
  *
- * @param[in] arg Index of the item that triggered the alarm
+ * On failure, the heap is left empty so that the refill is tried again later.
  */
-static void alarm_callback(void *arg) {
-    uint32_t idx = (uint32_t)arg;
+static rtc_scheduler_err_t refill(void) {
+    uint32_t offset = 0;
 
-    if (idx < SCHEDULE_MAX_ITEMS) {
-        if (xSemaphoreTake(schedule_mutex, pdMS_TO_TICKS(ALARM_CALLBACK_MUTEX_TIMEOUT_MS)) == pdFALSE) {
-            return;
+    min_heap_init(&hot_heap);
+
+    while (offset < journal_size) {
+        record_t record;
+        rtc_scheduler_err_t err = read_record(offset, &record);
+
+        if (err != RTC_SCHEDULER_SUCCESS) {
+            min_heap_init(&hot_heap);
+            return err;
         }
 
-        const rtc_scheduler_item_t *item = &scheduler_storage[idx];
+        if ((record.type == RECORD_TYPE_ADD) && is_active(record.entry.id)) {
+            hot_item_t item = {
+                .entry  = record.entry,
+                .offset = offset,
+            };
 
-        item->cb(item->data, item->data_len);
+            hot_insert(&item, 0);
+        }
 
-        sequence_pop_first(&scheduler_sequence);
-        update_alarm();
+        offset += RECORD_HDR_SIZE + record.entry.data_len;
+    }
 
-        xSemaphoreGive(schedule_mutex);
+    return RTC_SCHEDULER_SUCCESS;
+}
+
+/**
+ * @brief Copy the records of the items still waiting to a new journal which replaces the current one
+ */
+static rtc_scheduler_err_t compact(void) {
+    uint32_t offset = 0;
+    uint32_t new_size = 0;
+    uint32_t buf_len = 0;
+    rtc_scheduler_err_t err = RTC_SCHEDULER_SUCCESS;
+
+    fs_remove(JOURNAL_TMP_FILENAME, JOURNAL_FS_TIMEOUT_MS);
+
+    while ((err == RTC_SCHEDULER_SUCCESS) && (offset < journal_size)) {
+        record_t record;
+        err = read_record(offset, &record);
+
+        uint32_t size = RECORD_HDR_SIZE + record.entry.data_len;
+
+        if ((err == RTC_SCHEDULER_SUCCESS) && (record.type == RECORD_TYPE_ADD) && is_active(record.entry.id)) {
+            if ((buf_len + size) > sizeof(compact_buf)) {
+                err = journal_append(JOURNAL_TMP_FILENAME, compact_buf, buf_len, NULL, 0);
+                buf_len = 0;
+            }
+
+            if (err == RTC_SCHEDULER_SUCCESS) {
+                err = journal_read(offset, &compact_buf[buf_len], size);
+                buf_len += size;
+                new_size += size;
+            }
+        }
+
+        offset += size;
+    }
+
+    if ((err == RTC_SCHEDULER_SUCCESS) && (buf_len > 0)) {
+        err = journal_append(JOURNAL_TMP_FILENAME, compact_buf, buf_len, NULL, 0);
     }
+
+    if (err == RTC_SCHEDULER_SUCCESS) {
+        fs_err_t fs_err = (new_size > 0) ? fs_rename(JOURNAL_TMP_FILENAME, JOURNAL_FILENAME, JOURNAL_FS_TIMEOUT_MS)
+                                         : fs_remove(JOURNAL_FILENAME, JOURNAL_FS_TIMEOUT_MS);
+
+        err = ((fs_err == FS_OK) || (fs_err == FS_NOENT_ERR)) ? RTC_SCHEDULER_SUCCESS : RTC_SCHEDULER_ERR_FS;
+    }
+
+    if (err != RTC_SCHEDULER_SUCCESS) {
+        fs_remove(JOURNAL_TMP_FILENAME, JOURNAL_FS_TIMEOUT_MS);
+        return err;
+    }
+
+    journal_size = new_size;
+    done_count = 0;
+    journal_gen++;
+    cache_len = 0;
+
+    // The offsets of the items in the heap changed
+    return refill();
+}
+
+/**
+ * @brief Add an item to the heap, or leave it cold, keeping every cold item later than the items in the heap
+ *
+ * @param[in] item       Item to add
+ * @param[in] cold_count Number of cold items, not counting this one
+ */
+static void hot_insert(const hot_item_t *item, uint16_t cold_count) {
+    if (min_heap_is_full(&hot_heap)) {
+        uint16_t last = min_heap_find_last(&hot_heap);
+
+        if (goes_before(item, min_heap_get(&hot_heap, last))) {
+            // The last item becomes cold
+            min_heap_remove(&hot_heap, last, NULL);
+            min_heap_push(&hot_heap, item);
+        }
+    } else if (cold_count == 0) {
+        min_heap_push(&hot_heap, item);
+    } else if (!min_heap_is_empty(&hot_heap) &&
+               goes_before(item, min_heap_get(&hot_heap, min_heap_find_last(&hot_heap)))) {
+        min_heap_push(&hot_heap, item);
+    }
+
+    // Otherwise the item may be later than some cold items, it stays cold
+}
+
+/**
+ * @brief Remove an item from the heap if it is there
+ *
+ * @return true if the item was in the heap
+ */
+static bool hot_remove(uint32_t id) {
+    for (uint16_t pos = 0; pos < hot_heap.count; pos++) {
+        const hot_item_t *item = min_heap_get(&hot_heap, pos);
+
+        if (item->entry.id == id) {
+            return min_heap_remove(&hot_heap, pos, NULL);
+        }
+    }
+
+    return false;
 }
 
 /**
- * @brief Set the RTC alarm for the soonest scheduled item
+ * @brief Read bytes from the journal through the cache
+ *
+ * @param[in]  offset Offset in the journal
+ * @param[out] buf    Buffer of len bytes
+ * @param[in]  len    Number of bytes to read (<= JOURNAL_CACHE_SIZE)
  */
-static void update_alarm(void) {
-    if (sequence_is_empty(&scheduler_sequence)) {
-        return;
+static rtc_scheduler_err_t journal_read(uint32_t offset, uint8_t *buf, uint32_t len) {
+    if ((offset < cache_offset) || ((offset + len) > (cache_offset + cache_len))) {
+        cache_len = 0;
+
+        if (fs_read_at(JOURNAL_FILENAME, offset, cache, sizeof(cache), &cache_len, JOURNAL_FS_TIMEOUT_MS) != FS_OK) {
+            cache_len = 0;
+            return RTC_SCHEDULER_ERR_FS;
+        }
+
+        cache_offset = offset;
+
+        if (len > cache_len) {
+            return RTC_SCHEDULER_ERR_FS;
+        }
+    }
+
+    memcpy(buf, &cache[offset - cache_offset], len);
+
+    return RTC_SCHEDULER_SUCCESS;
+}
+
+/**
+ * @brief Append bytes followed by optional data to the end of a journal file (created if needed)
+ */
+static rtc_scheduler_err_t journal_append(const char *filename, const uint8_t *buf, uint32_t len, const uint8_t *data, uint32_t data_len) {
+    lfs_file_t file = { 0 };
+
+    if (fs_open(&file, filename, JOURNAL_FS_TIMEOUT_MS) != FS_OK) {
+        return RTC_SCHEDULER_ERR_FS;
+    }
+
+    // fs_seek and fs_write close the file on failure
+    fs_err_t err = fs_seek(&file, 0, FS_SEEK_END);
+
+    if (err == FS_OK) {
+        err = fs_write(&file, buf, len);
+    }
+
+    if ((err == FS_OK) && (data_len > 0)) {
+        err = fs_write(&file, data, data_len);
     }
 
-    uint8_t idx = sequence_peek_first(&scheduler_sequence);
-    const rtc_scheduler_item_t *next_item = &scheduler_storage[idx];
-    rtc_set_absolute_alarm(next_item->timestamp, &alarm_callback, (void *)idx);
+    if (err == FS_OK) {
+        err = fs_close(&file);
+    }
+
+    return (err == FS_OK) ? RTC_SCHEDULER_SUCCESS : RTC_SCHEDULER_ERR_FS;
 }
 
 /**
- * @brief Store an item at a particular index in the scheduler_storage
+ * @brief Read and decode the header of the record at an offset of the journal
  *
- * @param[in] item        Pointer to the item to store
- * @param[in] storage_idx Index where the item should be stored
+ * @return RTC_SCHEDULER_ERR_CORRUPT if the header fails its CRC check
  */
-static void store_item(const void *item, uint8_t storage_idx) {
-    const rtc_scheduler_item_t *src_item = (const rtc_scheduler_item_t *)item;
-    rtc_scheduler_item_t *dest_item = &scheduler_storage[storage_idx];
+static rtc_scheduler_err_t read_record(uint32_t offset, record_t *record) {
+    uint8_t hdr[RECORD_HDR_SIZE];
+
+    rtc_scheduler_err_t err = journal_read(offset, hdr, sizeof(hdr));
 
-    // Copy data into storage
-    dest_item->timestamp = src_item->timestamp;
-    dest_item->priority  = src_item->priority;
-    dest_item->cb        = src_item->cb;
-    dest_item->data_len  = src_item->data_len;
-    dest_item->data      = NULL;
+    memset(record, 0, sizeof(*record));
+
+    if (err != RTC_SCHEDULER_SUCCESS) {
+        return err;
+    }
 
-    if (src_item->data_len > 0) {
-        dest_item->data = &(scheduler_data_storage[storage_idx][0]);
-        memcpy(dest_item->data, src_item->data, src_item->data_len);
+    if (crc_16_buf(CRC16_SEED, hdr, RECORD_HDR_CRC_OFFSET) != data_fmt_arr_be_to_u16(&hdr[RECORD_HDR_CRC_OFFSET])) {
+        return RTC_SCHEDULER_ERR_CORRUPT;
     }
+
+    record->type               = hdr[0];
+    record->entry.priority     = hdr[1];
+    record->entry.tag          = hdr[2];
+    record->entry.data_len     = hdr[3];
+    record->entry.id           = data_fmt_arr_be_to_u32(&hdr[4]);
+    record->entry.timestamp    = data_fmt_arr_be_to_u32(&hdr[8]);
+    record->data_crc           = data_fmt_arr_be_to_u16(&hdr[RECORD_DATA_CRC_OFFSET]);
+
+    return (record->entry.data_len <= RTC_SCHEDULER_MAX_DATA_SIZE) ? RTC_SCHEDULER_SUCCESS : RTC_SCHEDULER_ERR_CORRUPT;
 }
 
 /**
- * @brief Evaluate if the item at idx_a should occur before the item at idx_b in the schedule.
+ * @brief Mark an item as done (run or cancelled) in the journal and in RAM
  *
- * If idx_a has an earlier timestamp OR they have the same timestamp but idx_a has a higher priority,
- * then idx_a will be placed earlier in the schedule.
+ * The item is not removed from the heap.
+ */
+static rtc_scheduler_err_t append_done(uint32_t id) {
+    record_t record = {
+        .type  = RECORD_TYPE_DONE,
+        .entry = { .id = id },
+    };
+
+    uint8_t hdr[RECORD_HDR_SIZE];
+    encode_record(&record, hdr);
+
+    rtc_scheduler_err_t err = journal_append(JOURNAL_FILENAME, hdr, sizeof(hdr), NULL, 0);
+
+    if (err == RTC_SCHEDULER_SUCCESS) {
+        set_active(ID_SLOT(id), false);
+        active_count--;
+        done_count++;
+        journal_size += RECORD_HDR_SIZE;
+    }
+
+    return err;
+}
+
+static void encode_record(const record_t *record, uint8_t *buf) {
+    buf[0] = record->type;
+    buf[1] = record->entry.priority;
+    buf[2] = record->entry.tag;
+    buf[3] = record->entry.data_len;
+    data_fmt_u32_to_arr_be(record->entry.id, &buf[4]);
+    data_fmt_u32_to_arr_be(record->entry.timestamp, &buf[8]);
+    data_fmt_u16_to_arr_be(record->data_crc, &buf[RECORD_DATA_CRC_OFFSET]);
+    data_fmt_u16_to_arr_be(crc_16_buf(CRC16_SEED, buf, RECORD_HDR_CRC_OFFSET), &buf[RECORD_HDR_CRC_OFFSET]);
+}
+
+/**
+ * @brief Check if the item with an ID is waiting (an ID whose slot was reused is not)
+ */
+static bool is_active(uint32_t id) {
+    uint16_t slot = ID_SLOT(id);
+
+    if ((slot >= RTC_SCHEDULER_MAX_ITEMS) || (slot_gens[slot] != ID_GEN(id))) {
+        return false;
+    }
+
+    return ((active_slots[slot / 32U] & (1UL << (slot % 32U))) != 0);
+}
+
+static void set_active(uint16_t slot, bool active) {
+    if (active) {
+        active_slots[slot / 32U] |= (1UL << (slot % 32U));
+    } else {
+        active_slots[slot / 32U] &= ~(1UL << (slot % 32U));
+    }
+}
+
+/**
+ * @brief Find a slot without a waiting item, starting after the last slot used so slots (and IDs) are reused as late as possible
  *
- * @param[in] idx_a Index of the item being placed
- * @param[in] idx_b Index of the item to compare to
+ * @pre active_count < RTC_SCHEDULER_MAX_ITEMS
+ */
+static uint16_t find_free_slot(void) {
+    uint16_t slot = next_slot;
+
+    while (is_active(MAKE_ID(slot_gens[slot], slot))) {
+        slot = (slot + 1U) % RTC_SCHEDULER_MAX_ITEMS;
+    }
+
+    return slot;
+}
+
+/**
+ * @brief Evaluate if the item a should run before the item b.
  *
- * @return true if the item at idx_a should occur before the item at idx_b, otherwise false
+ * Items run by timestamp, then highest priority first, then in the order they were added
+ * (which is the order of their records in the journal).
  */
-static bool goes_before(uint8_t idx_a, uint8_t idx_b) {
-    if (scheduler_storage[idx_a].timestamp < scheduler_storage[idx_b].timestamp) {
-        return true;
-    } else if (scheduler_storage[idx_a].timestamp == scheduler_storage[idx_b].timestamp) {
-        if (scheduler_storage[idx_a].priority > scheduler_storage[idx_b].priority) {
-            return true;
-        }
+static bool goes_before(const void *a, const void *b) {
+    const hot_item_t *item_a = (const hot_item_t *)a;
+    const hot_item_t *item_b = (const hot_item_t *)b;
+
+    if (item_a->entry.timestamp != item_b->entry.timestamp) {
+        return (item_a->entry.timestamp < item_b->entry.timestamp);
     }
 
-    return false;
+    if (item_a->entry.priority != item_b->entry.priority) {
+        return (item_a->entry.priority > item_b->entry.priority);
+    }
+
+    return (item_a->offset < item_b->offset);
 }
@@ -15,6 +15,7 @@
 
 // Standard Library
 #include <stdint.h>
+#include <stdbool.h>
 
 /******************************************************************************/
 /*                               D E F I N E S                                */
@@ -25,6 +26,26 @@
 // TODO: ALEA-858 choose an independent value for this that makes sense.
 #define RTC_SCHEDULER_MAX_DATA_SIZE  MAX_PAYLOAD_SIZE
 
+/**
+ * @brief Maximum number of items waiting in the schedule
+ */
+#define RTC_SCHEDULER_MAX_ITEMS      2048U
+
+/**
+ * @brief Number of items kept in RAM (the soonest ones), the others are read from the journal when needed
+ */
+#define RTC_SCHEDULER_HOT_ITEMS      32U
+
+/**
+ * @brief Cursor value to start listing the items, and the value returned once all the items are listed
+ */
+#define RTC_SCHEDULER_LIST_START     0U
+
+/**
+ * @brief Timestamp of the next item when it isn't known yet (see rtc_scheduler_get_info)
+ */
+#define RTC_SCHEDULER_TIMESTAMP_UNKNOWN  0xFFFFFFFFU
+
 /******************************************************************************/
 /*                              T Y P E D E F S                               */
 /******************************************************************************/
@@ -34,25 +55,54 @@ typedef enum {
     RTC_SCHEDULER_ERR_INVALID_ARGS  = 1,
     RTC_SCHEDULER_ERR_DATA_TOO_LONG = 2,
     RTC_SCHEDULER_FULL              = 3,
-    RTC_SCHEDULER_MUTEX_TIMEOUT     = 4
+    RTC_SCHEDULER_MUTEX_TIMEOUT     = 4,
+    RTC_SCHEDULER_ERR_FS            = 5, ///< The journal could not be read or written
+    RTC_SCHEDULER_ERR_ID_DNE        = 6, ///< There is no item with this ID in the schedule
+    RTC_SCHEDULER_ERR_CORRUPT       = 7, ///< The data of the item failed its CRC check (the item is removed)
+    RTC_SCHEDULER_NONE_DUE          = 8, ///< No item is due yet
+    RTC_SCHEDULER_ERR_NOT_LOADED    = 9, ///< rtc_scheduler_load hasn't completed successfully yet
 } rtc_scheduler_err_t;
 
-typedef void (*rtc_scheduler_cb_t)(uint8_t *data, uint32_t data_len);
-
 typedef struct {
-    uint32_t timestamp; // used as marker field to indicate valid data (!= 0)
-    uint8_t priority;
-    rtc_scheduler_cb_t cb;
+    uint32_t timestamp;
+    uint8_t priority;   // Items with the same timestamp are run highest priority first, then in the order they were added
+    uint8_t tag;        // Not used by the scheduler, returned by rtc_scheduler_list (e.g. the command ID)
     uint32_t data_len;
-    uint8_t *data;
+    const uint8_t *data;
 } rtc_scheduler_item_t;
 
+/**
+ * @brief Description of an item in the schedule
+ */
+typedef struct {
+    uint32_t id;        // Assigned by rtc_scheduler_add_item, used to cancel the item
+    uint32_t timestamp;
+    uint8_t priority;
+    uint8_t tag;
+    uint8_t data_len;
+} rtc_scheduler_entry_t;
+
+typedef struct {
+    uint16_t count;          // Number of items waiting
+    uint16_t capacity;       // Maximum number of items (RTC_SCHEDULER_MAX_ITEMS)
+    uint32_t next_timestamp; // Timestamp of the next item (0 if there are none, RTC_SCHEDULER_TIMESTAMP_UNKNOWN if not known yet)
+    uint32_t journal_size;   // Size of the journal file in bytes
+} rtc_scheduler_info_t;
+
 /******************************************************************************/
 /*                             F U N C T I O N S                              */
 /******************************************************************************/
 
 void rtc_scheduler_pre_init(void);
+rtc_scheduler_err_t rtc_scheduler_load(uint32_t timeout_ticks);
+
+rtc_scheduler_err_t rtc_scheduler_add_item(const rtc_scheduler_item_t *item, uint32_t *id, uint32_t timeout_ticks);
+rtc_scheduler_err_t rtc_scheduler_cancel(uint32_t id, uint32_t timeout_ticks);
+rtc_scheduler_err_t rtc_scheduler_is_waiting(uint32_t id, bool *waiting, uint32_t timeout_ticks);
+rtc_scheduler_err_t rtc_scheduler_pop_due(uint32_t now, rtc_scheduler_entry_t *entry, uint8_t *data, uint32_t timeout_ticks);
 
-rtc_scheduler_err_t rtc_scheduler_add_item(const rtc_scheduler_item_t *item, uint32_t timeout_ticks);
+rtc_scheduler_err_t rtc_scheduler_get_info(rtc_scheduler_info_t *info, uint32_t timeout_ticks);
+rtc_scheduler_err_t rtc_scheduler_list(uint32_t *cursor, rtc_scheduler_entry_t *entries, uint8_t max_entries, uint8_t *count,
+                                       uint32_t timeout_ticks);
 
 #endif // RTC_SCHEDULER_H_
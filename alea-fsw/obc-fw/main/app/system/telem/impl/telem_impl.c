@@ -14,6 +14,7 @@
 // OBC
 #include "obc_rtc.h"
 #include "obc_time.h"
+#include "obc_filesystem.h"
 #include "logger.h"
 
 /******************************************************************************/
@@ -24,3 +25,40 @@ telem_err_t telem_impl_TEST_GET_EPOCH(telem_TEST_GET_EPOCH_resp_t *resp) {
     resp->epoch = rtc_get_epoch_time();
     return TELEM_SUCCESS;
 }
+
+telem_err_t telem_impl_FS_WRITE_STATS(telem_FS_WRITE_STATS_resp_t *resp) {
+    fs_write_stats_t write_stats;
+    fs_io_stats_t io_stats;
+
+    fs_get_write_stats(&write_stats);
+    fs_get_io_stats(&io_stats);
+
+    resp->enqueued_bytes = write_stats.enqueued_bytes;
+    resp->dropped        = write_stats.dropped;
+    resp->dropped_bytes  = write_stats.dropped_bytes;
+    resp->high_water     = write_stats.high_water;
+    resp->flushes        = write_stats.flushes;
+    resp->flush_errors   = write_stats.flush_errors;
+    resp->flushed_bytes  = write_stats.flushed_bytes;
+    resp->flush_max_us   = io_stats.flush.max_us;
+    resp->flush_mean_us  = (io_stats.flush.count > 0) ? (io_stats.flush.total_us / io_stats.flush.count) : 0;
+
+    return TELEM_SUCCESS;
+}
+
+telem_err_t telem_impl_FS_IO_STATS(telem_FS_IO_STATS_resp_t *resp) {
+    fs_io_stats_t io_stats;
+
+    fs_get_io_stats(&io_stats);
+
+    resp->read_bytes     = io_stats.read_bytes;
+    resp->prog_bytes     = io_stats.prog_bytes;
+    resp->erases         = io_stats.erases;
+    resp->erases_skipped = io_stats.erases_skipped;
+    resp->scrub_blocks   = io_stats.scrub_blocks;
+    resp->errors         = io_stats.errors;
+    resp->blocks_used    = io_stats.blocks_used;
+    resp->sync_max_us    = io_stats.sync.max_us;
+
+    return TELEM_SUCCESS;
+}
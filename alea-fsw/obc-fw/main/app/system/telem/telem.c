@@ -13,6 +13,10 @@
 #include "telem_gen.h"
 #include "telem_exec.h"
 #include "telem_error.h"
+#include "telem_index.h"
+#include "telem_store.h"
+#include "telem_block.h"
+#include "telem_window.h"
 #include "data_fmt.h"
 #include "io_stream.h"
 #include "obc_utils.h"
@@ -31,6 +35,7 @@
 // Standard Library
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 // Logger
 #include "logger.h"
@@ -43,16 +48,70 @@
 
 #define TELEM_FS_MUTEX_TIMEOUT_MS           2000U
 
-/* @brief Max sizes of the telem files
- *
- * Constrained by the downlink capacity calculated in Data Budget V3
- * ~50KB downlink capacity per pass allocated to telemetry
- * Priority 0 is transmitted fully and maximum leftover amount of priority 1 is transmitted
- * Thus, max size of priority 0 = priority 1 = 50KB. Leftover (8MB - 100KB) is for priority 2
-*/
-#define TELEM_PRIORITY_0_MAX_FILE_SIZE      51200U
-#define TELEM_PRIORITY_1_MAX_FILE_SIZE      51200U
-#define TELEM_PRIORITY_2_MAX_FILE_SIZE      8286208U
+#define TELEM_BLOCK_MUTEX_TIMEOUT_MS        1000U
+
+/**
+ * @brief Size of the reads used to search a telem file backwards for a value. Must hold the largest
+ * telem block.
+ */
+#define TELEM_SCAN_WINDOW_SIZE              TELEM_BLOCK_MAX_SIZE
+
+/**
+ * @brief The frames collected for a priority are written as a telem block once the encoded block
+ * reaches this size, or once its oldest frame is TELEM_BLOCK_MAX_AGE_S old. Frames that haven't been
+ * written are saved in MRAM after each frame (see TELEM_SPOOL_SLOT_SIZE), so they survive a reset.
+ */
+#define TELEM_BLOCK_TARGET_SIZE             384U
+#define TELEM_BLOCK_MAX_AGE_S               600
+
+CASSERT(TELEM_BLOCK_MAX_SIZE <= TELEM_SCAN_WINDOW_SIZE, telem_scan_window_size);
+CASSERT(TELEM_MAX_RESP_SIZE <= TELEM_BLOCK_MAX_SAMPLE_SIZE, telem_block_sample_size);
+CASSERT(TELEM_BLOCK_TARGET_SIZE <= TELEM_BLOCK_MAX_SIZE, telem_block_target_size);
+
+/**
+ * @brief The frames of each priority that haven't been written are saved in MRAM as an encoded block,
+ * and written to the telem file after a reset. MRAM layout of each priority
+ * (at MRAM_TELEM_SPOOL_ADDR + priority * TELEM_SPOOL_SLOT_SIZE):
+ *      | size (2) | block (size) |
+ * A size of 0 means that there are no frames saved.
+ */
+#define TELEM_SPOOL_HEADER_SIZE             2U
+#define TELEM_SPOOL_SLOT_SIZE               (TELEM_SPOOL_HEADER_SIZE + TELEM_BLOCK_MAX_SIZE)
+#define TELEM_SPOOL_MRAM_SIZE               (TELEM_NUM_PRIORITIES * TELEM_SPOOL_SLOT_SIZE)
+
+CASSERT((MRAM_TELEM_SPOOL_ADDR + TELEM_SPOOL_MRAM_SIZE) <= 0x8000U, telem_spool_mram_size);
+
+/**
+ * @brief Size of the reads of a query. Every block that ends in a read is found, so each read moves
+ * forward by at least the size of the read minus the size of the largest block.
+ */
+#define TELEM_QUERY_READ_SIZE               (2U * TELEM_BLOCK_MAX_SIZE)
+
+#define TELEM_QUERY_RECORD_HEADER_SIZE      (2U + 4U + 2U)
+#define TELEM_QUERY_RECORD_MAX_SIZE         (TELEM_QUERY_RECORD_HEADER_SIZE + (3U * TELEM_MAX_RESP_SIZE))
+
+CASSERT(TELEM_MAX_RESP_SIZE <= TELEM_WINDOW_MAX_SIZE, telem_window_max_size);
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief State of the query being run. Only used with telem_query_mutex held.
+ */
+typedef struct {
+    const telem_query_t *query;
+    const io_ostream_t *output;                 // NULL if the result is only measured
+    uint32_t write_timeout;
+    uint32_t size;                              // Size of the records so far
+    uint32_t max_size;
+    bool full;                                  // A record didn't fit in max_size, the query is over
+    uint8_t priority;                           // Telem file being read
+    TickType_t start_ticks;
+    TickType_t total_ticks;
+    uint32_t counts[TELEM_QUERY_MAX_UNITS];     // Number of samples of each telem unit so far
+    telem_window_t windows[TELEM_QUERY_MAX_UNITS];
+} telem_query_run_t;
 
 /******************************************************************************/
 /*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
@@ -62,17 +121,27 @@ static void telem_collect_task(void *pvParameters);
 
 // The compiler complains about unused functions unless we use an #if here
 #if FEATURE_FLASH_FS
-static telem_err_t generate_outer_header(uint8_t *header_buf, uint16_t num_units);
-static void deserialize_outer_header(const uint8_t *header_buf, epoch_t *epoch, uint16_t *num_units);
-static telem_err_t read_outer_header(lfs_file_t *file, int32_t *offset, epoch_t *cur_epoch, uint16_t *num_units);
-
-static void generate_inner_header(uint8_t *header_buf, telem_id_t id, uint16_t resp_len);
-static void deserialize_inner_header(const uint8_t *header_buf, telem_id_t *id, uint16_t *resp_len);
-static telem_err_t read_inner_header(lfs_file_t *file, int32_t *offset, telem_id_t *cur_telem_id, uint16_t *resp_len);
-
-static telem_err_t search_for_stop_word(lfs_file_t *file, int32_t *offset, const int32_t *file_size, uint8_t *stop_word_buf);
-
-static telem_err_t check_file_sizes(void);
+static telem_err_t write_frames(uint8_t priority, uint8_t num_frames);
+static telem_err_t append_block(uint8_t priority, uint32_t size, uint8_t num_frames, epoch_t epoch_min, epoch_t epoch_max);
+static void spool_frames(uint8_t priority);
+static void recover_spooled_frames(void);
+
+static telem_err_t read_indexed_value(const telem_index_loc_t *loc, telem_id_t telem_id, uint8_t *buf, uint16_t mutex_timeout);
+static telem_err_t scan_for_value(const char *filename, uint32_t end, telem_id_t telem_id, epoch_t epoch, uint8_t *buf, epoch_t *exec_epoch,
+                                  TickType_t start_ticks, TickType_t total_ticks);
+static telem_err_t get_segment_size(uint8_t priority, uint32_t seq, uint32_t head, uint32_t *size, uint16_t mutex_timeout);
+
+static void rotate_segment(uint8_t priority);
+
+static fs_err_t get_file_handle(uint8_t priority, fs_handle_t *handle);
+
+static telem_err_t run_query(const telem_query_t *query, const io_ostream_t *output, uint32_t max_size, uint32_t write_timeout,
+                             uint32_t timeout_ms, uint32_t *size);
+static telem_err_t query_segment(const char *filename, uint32_t start, uint32_t end);
+static telem_err_t query_block(const uint8_t *buf, uint32_t size);
+static telem_err_t query_emit_window(uint8_t unit);
+static telem_err_t query_emit(const uint8_t *record, uint32_t len);
+static uint16_t query_time_left(void);
 #endif
 
 /******************************************************************************/
@@ -80,10 +149,33 @@ static telem_err_t check_file_sizes(void);
 /******************************************************************************/
 
 #if FEATURE_FLASH_FS
-static const uint8_t telem_stop_word[TELEM_STOP_WORD_SIZE] = { 0xA1, 0xEA, 0x50, 0xBC }; // "ALEA OBC"
-static uint32_t file_0_size = 0;
-static uint32_t file_1_size = 0;
-static uint32_t file_2_size = 0;
+static SemaphoreHandle_t telem_block_mutex = NULL;
+
+// Frames collected for each priority that haven't been written yet. Only used with telem_block_mutex held.
+static telem_block_t blocks[TELEM_NUM_PRIORITIES];
+
+// Encoded block being written. Only used with telem_block_mutex held.
+static uint8_t block_buf[TELEM_BLOCK_MAX_SIZE];
+
+// Whether the MRAM slot of each priority may hold frames. Only used with telem_block_mutex held.
+static bool spooled[TELEM_NUM_PRIORITIES] = { false };
+
+// Size of the head segments including the writes still in the write ring. Initialized when the handle is interned.
+static uint32_t file_sizes[TELEM_NUM_PRIORITIES] = { 0 };
+
+// Sequence numbers of the head segments. Initialized when the handle is interned.
+static uint32_t head_seqs[TELEM_NUM_PRIORITIES] = { 0 };
+
+// Write ring handles of the telem files, interned on first use
+static fs_handle_t file_handles[TELEM_NUM_PRIORITIES];
+static bool file_handles_valid[TELEM_NUM_PRIORITIES] = { false };
+
+static SemaphoreHandle_t telem_query_mutex = NULL;
+
+// Query being run and its buffers. Only used with telem_query_mutex held.
+static telem_query_run_t query_run;
+static telem_block_reader_t query_reader;
+static uint8_t query_buf[TELEM_QUERY_READ_SIZE];
 #endif
 
 static bool telem_collect_enabled = true;
@@ -103,11 +195,33 @@ struct telem_config_vars {
 /*                       P U B L I C  F U N C T I O N S                       */
 /******************************************************************************/
 
+/**
+ * @brief Initialize FreeRTOS data structures for telemetry
+ */
+void telem_pre_init(void) {
+#if FEATURE_FLASH_FS
+    static StaticSemaphore_t telem_block_mutex_buf;
+    telem_block_mutex = xSemaphoreCreateMutexStatic(&telem_block_mutex_buf);
+
+    static StaticSemaphore_t telem_query_mutex_buf;
+    telem_query_mutex = xSemaphoreCreateMutexStatic(&telem_query_mutex_buf);
+
+    for (uint8_t i = 0; i < TELEM_NUM_PRIORITIES; i++) {
+        telem_block_init(&blocks[i]);
+    }
+
+#endif
+}
+
 /**
  * @brief Starts the telemetry collection task.
 */
 void telem_collect_post_init(void) {
     telem_init_mram();
+    telem_index_init();
+#if FEATURE_FLASH_FS
+    recover_spooled_frames();
+#endif
     telem_exec_task_handle = xTaskGetHandle("TELEM_EXEC");
     obc_rtos_create_task(OBC_TASK_ID_TELEM_COLLECT, &telem_collect_task, NULL, OBC_WATCHDOG_ACTION_ALLOW);
 }
@@ -266,7 +380,7 @@ void telem_collect_disable(void) {
 }
 
 /**
- * @brief Serialize response and pass it to filesystem task
+ * @brief Serialize response and add it to the frame being collected for its priority
  *
  * @param[in] resp_struct Pointer struct containing response data
  * @param[in] resp_desc   Pointer to description of the response data struct for serialization using the data_fmt module
@@ -274,9 +388,11 @@ void telem_collect_disable(void) {
  * @param[in] buf         Buffer used to store serialized response data. Must be at least as large as resp_len.
  *
  * @return Status code:
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the frames of the priority are busy
  *            - TELEM_ERR_FS_TIMEOUT if writing to the filesystem task stream times out
  *            - TELEM_ERR_DATA_FMT if the response cannot be properly serialized
  *            - TELEM_ERR_FLASH_WRITE if filesystem returned an error
+ *            - TELEM_ERR_BLOCK_FULL if the frame doesn't fit in a telem block
  */
 telem_err_t telem_handle_resp(const telem_id_t id, const uint8_t priority, const void *resp_struct, const data_fmt_desc_t *resp_desc,
                               const uint16_t resp_len,
@@ -289,36 +405,41 @@ telem_err_t telem_handle_resp(const telem_id_t id, const uint8_t priority, const
         return TELEM_ERR_DATA_FMT;
     }
 
-    generate_inner_header(buf + resp_len, id, resp_len);
+    uint8_t idx = MIN(priority, TELEM_NUM_PRIORITIES - 1U);
 
-    char filename[17] = "";
-    convert_priority_to_filename(filename, priority);
+    if (xSemaphoreTake(telem_block_mutex, pdMS_TO_TICKS(TELEM_BLOCK_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
 
-    fs_err_t err = fs_write_enqueue(buf, resp_len + TELEM_INNER_HEADER_SIZE, filename, TELEM_FS_MUTEX_TIMEOUT_MS);
+    telem_block_t *block = &blocks[idx];
+    telem_err_t err = TELEM_SUCCESS;
+    bool added = telem_block_add(block, (uint16_t) id, buf, (uint8_t) resp_len);
 
-    if (err != FS_OK) {
-        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    // Make room by writing the frames collected so far (they are dropped even if the write fails)
+    if (!added) {
+        err = write_frames(idx, block->num_frames);
+        added = telem_block_add(block, (uint16_t) id, buf, (uint8_t) resp_len);
     }
 
-    switch (priority) {
-    case 0:
-        file_0_size += resp_len + TELEM_INNER_HEADER_SIZE;
-        break;
+    xSemaphoreGive(telem_block_mutex);
 
-    case 1:
-        file_1_size += resp_len + TELEM_INNER_HEADER_SIZE;
-        break;
-
-    default: // Also doubles as case 2
-        file_2_size += resp_len + TELEM_INNER_HEADER_SIZE;
+    if (added) {
+        telem_index_add_unit(id, idx, buf, resp_len);
+    } else if (err == TELEM_SUCCESS) {
+        err = TELEM_ERR_BLOCK_FULL;
     }
 
-#endif
+    return err;
+#else
     return TELEM_SUCCESS;
+#endif
 }
 
 /**
- * @brief Search for the last collected value of a telem unit
+ * @brief Get the last collected value of a telem unit
+ *
+ * The value is taken from the telem index, which only costs a read of the telem file after a reset.
+ * If the index doesn't have the value, the telem file is searched backwards from its end.
  *
  * @param[in] telem_id         ID of the telem unit
  * @param[in] buf              Pointer to buf to store value in (if found)
@@ -330,155 +451,412 @@ telem_err_t telem_handle_resp(const telem_id_t id, const uint8_t priority, const
  *            - TELEM_ERR_DNE if telem_id does not exist
  *            - TELEM_ERR_ENTRY_DNE if could not find last value of telem unit
  *            - TELEM_ERR_FS_TIMEOUT if could not compete for filesystem mutex
- *            - TELEM_ERR_MUTEX_TIMEOUT if didn't wait for executing units to finish in time
+ *            - TELEM_ERR_SEARCH_TIMEOUT if the search didn't finish in time
  */
 telem_err_t telem_get_last_value(const telem_id_t telem_id, uint8_t *buf, epoch_t *exec_epoch, uint16_t mutex_timeout) {
+    return telem_get_value_at(telem_id, INT32_MAX, buf, exec_epoch, mutex_timeout);
+}
+
+/**
+ * @brief Get the last value of a telem unit collected at or before an epoch
+ *
+ * The latest value is taken from the telem index. Older values are found in the frames that haven't
+ * been written yet, then by reading the telem block that covers the epoch, using the block indexes
+ * of the segments from newest to oldest.
+ *
+ * @param[in] telem_id         ID of the telem unit
+ * @param[in] epoch            Latest epoch of the value
+ * @param[in] buf              Pointer to buf to store value in (if found)
+ * @param[in] exec_epoch       The epoch at which value was collected (if found)
+ * @param[in] mutex_timeout    Timeout to wait for mutex to access flash
+ *
+ * @return Status code: see telem_get_last_value
+ */
+telem_err_t telem_get_value_at(const telem_id_t telem_id, const epoch_t epoch, uint8_t *buf, epoch_t *exec_epoch, uint16_t mutex_timeout) {
 #if FEATURE_FLASH_FS
 
     if (telem_id >= TELEM_COUNT) {
         return TELEM_ERR_DNE;
     }
 
+    TickType_t total_ticks = pdMS_TO_TICKS(mutex_timeout);
+    TickType_t start_ticks = xTaskGetTickCount();
+
+    telem_index_loc_t loc;
+    bool cached = false;
+
+    if ((telem_index_get_latest(telem_id, &loc, buf, &cached) == TELEM_SUCCESS) && (loc.epoch <= epoch)) {
+        if (cached || (read_indexed_value(&loc, telem_id, buf, mutex_timeout) == TELEM_SUCCESS)) {
+            *exec_epoch = loc.epoch;
+            return TELEM_SUCCESS;
+        }
+    }
+
     uint8_t prio;
-    telem_err_t perr = telem_get_priority(telem_id, &prio);
+    telem_err_t err = telem_get_priority(telem_id, &prio);
 
-    if (perr != TELEM_SUCCESS) {
+    if (err != TELEM_SUCCESS) {
         return TELEM_ERR_ENTRY_DNE;
     }
 
-    TickType_t total_ticks = pdMS_TO_TICKS(mutex_timeout);
-    TickType_t start_ticks = xTaskGetTickCount();
-    TickType_t cur_ticks;
+    prio = MIN(prio, TELEM_NUM_PRIORITIES - 1U);
 
-    char filename[17] = "";
-    convert_priority_to_filename(filename, prio);
+    if (xSemaphoreTake(telem_block_mutex, pdMS_TO_TICKS(mutex_timeout)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
 
-    lfs_file_t file = { 0 };
-    fs_err_t err = fs_open(&file, filename, pdTICKS_TO_MS(total_ticks));
+    int32_t sample_epoch = 0;
+    bool found = telem_block_find_sample(&blocks[prio], (uint16_t) telem_id, (int32_t) epoch, buf, TELEM_SPEC_TABLE[telem_id].resp_size,
+                                         &sample_epoch);
 
-    if (err != FS_OK) {
-        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
+    xSemaphoreGive(telem_block_mutex);
+
+    if (found) {
+        *exec_epoch = (epoch_t) sample_epoch;
+        return TELEM_SUCCESS;
     }
 
-    int32_t offset = 0;
-    const int32_t file_size = fs_size(&file);
+    uint32_t tail;
+    uint32_t head;
+    err = telem_store_get_range(prio, &tail, &head, mutex_timeout);
 
-    if (file_size <= 14) { // Min size of outer and inner headers and stop word
-        fs_close(&file);
-        return TELEM_ERR_ENTRY_DNE;
+    if (err != TELEM_SUCCESS) {
+        return err;
     }
 
-    // Searching backward as last value is closer to the end of the file
-    if (fs_seek(&file, 0, FS_SEEK_END) != FS_OK) {
-        return TELEM_ERR_FLASH_READ;
-    }
+    err = TELEM_ERR_ENTRY_DNE;
 
-    cur_ticks = xTaskGetTickCount();
+    // Search the segments from newest to oldest
+    for (uint32_t seq = head; err == TELEM_ERR_ENTRY_DNE; seq--) {
+        char filename[TELEM_STORE_NAME_MAX_SIZE];
+        telem_store_segment_name(prio, seq, head, filename);
 
-    if (cur_ticks - start_ticks >= total_ticks) {
-        fs_close(&file);
-        return TELEM_ERR_SEARCH_TIMEOUT;
-    }
+        uint32_t file_size = 0;
+        err = get_segment_size(prio, seq, head, &file_size, mutex_timeout);
 
-    uint8_t stop_word_buf[TELEM_STOP_WORD_SIZE];
+        if (err != TELEM_SUCCESS) {
+            return err;
+        }
 
-    // Loop will always terminate since offset increases at every iteration
-    while (offset < file_size) {
+        uint32_t end = file_size;
 
-        telem_err_t search_err = search_for_stop_word(&file, &offset, &file_size, stop_word_buf);
+        if (epoch != INT32_MAX) {
+            err = telem_index_find_block(prio, seq, head, epoch, file_size, &end, mutex_timeout);
 
-        if (search_err != TELEM_SUCCESS) {
-            return TELEM_ERR_FLASH_READ;
+            if (err != TELEM_SUCCESS) {
+                return err;
+            }
         }
 
-        epoch_t cur_epoch;
-        uint16_t num_units;
+        err = scan_for_value(filename, end, telem_id, epoch, buf, exec_epoch, start_ticks, total_ticks);
 
-        if (read_outer_header(&file, &offset, &cur_epoch, &num_units) != TELEM_SUCCESS) {
-            return TELEM_ERR_FLASH_READ;
+        if (seq == tail) {
+            break;
         }
+    }
 
-        while (num_units > 0 && offset < file_size) {
+    return err;
+#else
+    return TELEM_ERR_ENTRY_DNE;
+#endif
+}
 
-            telem_id_t cur_telem_id;
-            uint16_t resp_len;
+/**
+ * @brief Drop the newest bytes of the telem data of a priority after they were read out
+ *
+ * Segments are truncated from the head backwards. Segments that are emptied are kept so that
+ * sequence numbers stay monotonic, they are removed when they are evicted.
+ *
+ * @param[in] priority      Priority of the data
+ * @param[in] size          Number of bytes to drop
+ * @param[in] mutex_timeout Timeout to wait for mutex to access flash
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_FS_TIMEOUT if could not compete for filesystem mutex
+ *            - TELEM_ERR_FLASH_WRITE if a segment couldn't be truncated
+ */
+telem_err_t telem_drop_newest(uint8_t priority, uint32_t size, uint16_t mutex_timeout) {
+#if FEATURE_FLASH_FS
+    uint8_t idx = MIN(priority, TELEM_NUM_PRIORITIES - 1U);
+    uint32_t tail;
+    uint32_t head;
 
-            if (read_inner_header(&file, &offset, &cur_telem_id, &resp_len) != TELEM_SUCCESS) {
-                return TELEM_ERR_FLASH_READ;
-            }
+    telem_err_t err = telem_store_get_range(idx, &tail, &head, mutex_timeout);
 
-            // Found the unit we're looking for
-            if (cur_telem_id == telem_id) {
-                // Set return value of epoch
-                *exec_epoch = cur_epoch;
+    if (err != TELEM_SUCCESS) {
+        return err;
+    }
 
-                // Cast to int32_t to ensure we don't overflow when we take the negative value
-                if (fs_seek(&file, -((int32_t) resp_len), FS_SEEK_CUR) != FS_OK) {
-                    return TELEM_ERR_FLASH_READ;
-                }
+    // Writes still in the write ring would otherwise be appended after the truncation
+    fs_err_t fs_err = fs_flush(mutex_timeout);
 
-                if (fs_read(&file, buf, resp_len) != FS_OK) {
-                    return TELEM_ERR_FLASH_READ;
-                }
+    for (uint32_t seq = head; (fs_err == FS_OK) && (size > 0); seq--) {
+        char filename[TELEM_STORE_NAME_MAX_SIZE];
+        telem_store_segment_name(idx, seq, head, filename);
 
-                fs_close(&file);
+        lfs_file_t file = { 0 };
+        fs_err = fs_open(&file, filename, mutex_timeout);
 
-                return TELEM_SUCCESS;
-            }
+        if (fs_err != FS_OK) {
+            break;
+        }
 
-            if (fs_seek(&file, -((int32_t) resp_len), FS_SEEK_CUR) != FS_OK) {
-                return TELEM_ERR_FLASH_READ;
-            }
+        int32_t file_size = fs_size(&file);
+        uint32_t new_size = (file_size > 0) ? (uint32_t) file_size : 0U;
+        uint32_t dropped = MIN(size, new_size);
 
-            num_units--;
-            offset += resp_len;
+        new_size -= dropped;
+        size     -= dropped;
+
+        if (dropped > 0) {
+            fs_err = fs_truncate(&file, (int32_t) new_size);
         }
 
-        cur_ticks = xTaskGetTickCount();
+        fs_err_t close_err = fs_close(&file);
+        fs_err = (fs_err != FS_OK) ? fs_err : close_err;
 
-        if (cur_ticks - start_ticks >= total_ticks) {
-            fs_close(&file);
-            return TELEM_ERR_SEARCH_TIMEOUT;
+        if (seq == head) {
+            file_sizes[idx] = MIN(file_sizes[idx], new_size);
+        }
+
+        if ((dropped > 0) && (telem_index_truncate(idx, seq, head, new_size, mutex_timeout) != TELEM_SUCCESS)) {
+            LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_FLASH_WRITE);
+        }
+
+        if (seq == tail) {
+            break;
         }
     }
 
-    fs_close(&file);
+    if (fs_err != FS_OK) {
+        return (fs_err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    }
+
 #endif
-    return TELEM_ERR_ENTRY_DNE;
+    return TELEM_SUCCESS;
 }
 
 /**
- * @brief Adds outer header to flash write queue
-*/
-telem_err_t write_outer_header_and_stop_word(uint16_t num_units, char *filename, uint8_t priority) {
+ * @brief End the frame being collected for a priority
+ *
+ * The frames of the priority are written as a telem block once the block is large enough or old
+ * enough (see TELEM_BLOCK_TARGET_SIZE), or if the new frame doesn't fit in the block. The frames
+ * that remain are saved in MRAM, and are written after a reset.
+ *
+ * @param[in] priority  Priority of the frame
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_RTC_ERR if the epoch of the frame couldn't be read
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the frames of the priority are busy
+ *            - TELEM_ERR_FS_TIMEOUT, TELEM_ERR_FLASH_WRITE or TELEM_ERR_BLOCK_FULL if frames had to be
+ *              dropped because they couldn't be written
+ */
+telem_err_t telem_end_frame(uint8_t priority) {
 #if FEATURE_FLASH_FS
-    uint8_t header_buf[TELEM_OUTER_HEADER_SIZE + TELEM_STOP_WORD_SIZE];
+    epoch_t epoch = rtc_get_epoch_time();
 
-    if (generate_outer_header(header_buf, num_units) != TELEM_SUCCESS) {
-        return TELEM_ERR_GEN_HEADER;
+    if (epoch == RTC_EPOCH_ERR) {
+        return TELEM_ERR_RTC_ERR;
     }
 
-    memcpy(header_buf + TELEM_OUTER_HEADER_SIZE, &telem_stop_word, TELEM_STOP_WORD_SIZE);
+    uint8_t idx = MIN(priority, TELEM_NUM_PRIORITIES - 1U);
 
-    if (fs_write_enqueue(header_buf, TELEM_OUTER_HEADER_SIZE + TELEM_STOP_WORD_SIZE, filename, TELEM_FS_MUTEX_TIMEOUT_MS) != FS_OK) {
-        return TELEM_ERR_FLASH_WRITE;
+    if (xSemaphoreTake(telem_block_mutex, pdMS_TO_TICKS(TELEM_BLOCK_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
     }
 
-    switch (priority) {
-    case 0:
-        file_0_size += TELEM_OUTER_HEADER_SIZE + TELEM_STOP_WORD_SIZE;
-        break;
+    telem_block_t *block = &blocks[idx];
+    telem_err_t err = TELEM_SUCCESS;
 
-    case 1:
-        file_1_size += TELEM_OUTER_HEADER_SIZE + TELEM_STOP_WORD_SIZE;
-        break;
+    // Never fails, blocks are written (or dropped) once they have TELEM_BLOCK_MAX_FRAMES frames
+    telem_block_end_frame(block, (int32_t) epoch);
 
-    default: // Also doubles as case 2
-        file_2_size += TELEM_OUTER_HEADER_SIZE + TELEM_STOP_WORD_SIZE;
+    // A failure to index the frame only slows down searches for its values
+    if (telem_index_add_frame(idx, epoch) != TELEM_SUCCESS) {
+        LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_MUTEX_TIMEOUT);
     }
 
+    uint32_t size = telem_block_encode(block, block->num_frames, block_buf, sizeof(block_buf));
+
+    // The frames before the new one fit in a block, write them and start a new block with the new frame
+    if ((size == 0) && (block->num_frames > 1U)) {
+        err = write_frames(idx, block->num_frames - 1U);
+        size = telem_block_encode(block, block->num_frames, block_buf, sizeof(block_buf));
+    }
+
+    if ((size == 0) || (size >= TELEM_BLOCK_TARGET_SIZE) || (block->num_frames >= TELEM_BLOCK_MAX_FRAMES) ||
+            ((epoch - (epoch_t) block->epochs[0]) >= TELEM_BLOCK_MAX_AGE_S)) {
+        telem_err_t write_err = write_frames(idx, block->num_frames);
+        err = (err != TELEM_SUCCESS) ? err : write_err;
+    }
+
+    spool_frames(idx);
+
+    xSemaphoreGive(telem_block_mutex);
+
+    return err;
+#else
+    return TELEM_SUCCESS;
 #endif
+}
+
+/**
+ * @brief Write the frames collected for a priority that haven't been written yet (e.g. before the
+ * telem files are read out)
+ *
+ * @param[in] priority      Priority of the frames
+ * @param[in] mutex_timeout Timeout to wait for the frames of the priority
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the frames of the priority are busy
+ *            - TELEM_ERR_FS_TIMEOUT, TELEM_ERR_FLASH_WRITE or TELEM_ERR_BLOCK_FULL if frames had to be
+ *              dropped because they couldn't be written
+ */
+telem_err_t telem_flush(uint8_t priority, uint16_t mutex_timeout) {
+#if FEATURE_FLASH_FS
+    uint8_t idx = MIN(priority, TELEM_NUM_PRIORITIES - 1U);
+
+    if (xSemaphoreTake(telem_block_mutex, pdMS_TO_TICKS(mutex_timeout)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
+
+    telem_err_t err = write_frames(idx, blocks[idx].num_frames);
+
+    spool_frames(idx);
+
+    xSemaphoreGive(telem_block_mutex);
+
+    return err;
+#else
     return TELEM_SUCCESS;
+#endif
+}
+
+/**
+ * @brief Begin a query of the samples of telem units collected in a range of epochs
+ *
+ * The frames of the telem units that haven't been written yet are written, then the query is run
+ * once to measure its result, which is the records that fit in max_size. telem_query_read returns
+ * the same records as long as the telem files don't change in between (telem collection should be
+ * disabled), since the query only reads the segments that existed when it began.
+ *
+ * The segments of the telem files are read forward from the oldest, skipping the parts that the
+ * telem index shows are outside the range of epochs. A telem unit is only searched for in the telem
+ * file of its current priority.
+ *
+ * @param[in,out] query       Query, see telem_query_t for the fields set by the caller
+ * @param[in]     max_size    Maximum size of the result
+ * @param[in]     timeout_ms  Time allowed to run the query
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful, query->size is set
+ *            - TELEM_ERR_DNE if a telem unit doesn't exist or the query is invalid
+ *            - TELEM_ERR_DATA_FMT if the response of a telem unit can't be aggregated in windows
+ *            - TELEM_ERR_MUTEX_TIMEOUT if another query is running
+ *            - TELEM_ERR_FS_TIMEOUT if could not compete for filesystem mutex
+ *            - TELEM_ERR_FLASH_READ if filesystem returned an error
+ *            - TELEM_ERR_SEARCH_TIMEOUT if the query didn't finish in time
+ */
+telem_err_t telem_query_begin(telem_query_t *query, uint32_t max_size, uint32_t timeout_ms) {
+#if FEATURE_FLASH_FS
+    uint16_t mutex_timeout = (uint16_t) MIN(timeout_ms, UINT16_MAX);
+
+    if ((query->num_units == 0) || (query->num_units > TELEM_QUERY_MAX_UNITS) || (query->step == 0) ||
+            (query->epoch_start > query->epoch_end) || (query->mode > TELEM_QUERY_MODE_WINDOW)) {
+        return TELEM_ERR_DNE;
+    }
+
+    for (uint8_t u = 0; u < query->num_units; u++) {
+        telem_id_t telem_id = query->telem_ids[u];
+
+        if ((telem_id >= TELEM_COUNT) || (telem_get_priority(telem_id, &query->priorities[u]) != TELEM_SUCCESS)) {
+            return TELEM_ERR_DNE;
+        }
+
+        query->priorities[u] = MIN(query->priorities[u], TELEM_NUM_PRIORITIES - 1U);
+    }
+
+    for (uint8_t p = 0; p < TELEM_NUM_PRIORITIES; p++) {
+        // Frames that can't be written are dropped, the query goes on without them
+        telem_err_t err = telem_flush(p, mutex_timeout);
+
+        if (err != TELEM_SUCCESS) {
+            LOG_TELEM__EXECUTION_FAILURE(err);
+        }
+    }
+
+    // The sizes of the segments only include what has been flushed
+    fs_err_t fs_err = fs_flush(mutex_timeout);
+
+    if (fs_err != FS_OK) {
+        return (fs_err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    }
+
+    for (uint8_t p = 0; p < TELEM_NUM_PRIORITIES; p++) {
+        telem_err_t err = telem_store_get_range(p, &query->tails[p], &query->heads[p], mutex_timeout);
+
+        if (err == TELEM_SUCCESS) {
+            err = get_segment_size(p, query->heads[p], query->heads[p], &query->head_sizes[p], mutex_timeout);
+        }
+
+        if (err != TELEM_SUCCESS) {
+            return err;
+        }
+    }
+
+    return run_query(query, NULL, max_size, 0, timeout_ms, &query->size);
+#else
+    return TELEM_ERR_ENTRY_DNE;
+#endif
+}
+
+/**
+ * @brief Write the result of a query begun with telem_query_begin to an output stream
+ *
+ * Exactly query->size bytes are written, as promised to the reader of the output. The result can't
+ * grow, and if it came out shorter (the result changed since the query began or the query failed part
+ * way) the rest is filled with TELEM_QUERY_PADDING and the cause is logged.
+ *
+ * @param[in] query          Query
+ * @param[in] output         Output stream, written in records (wrap it with buffered_io to group them)
+ * @param[in] write_timeout  Timeout of each write to output
+ * @param[in] timeout_ms     Time allowed to run the query
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if query->size bytes were written
+ *            - TELEM_ERR_OUTPUT_WRITE if a write to output timed out
+ */
+telem_err_t telem_query_read(const telem_query_t *query, const io_ostream_t *output, uint32_t write_timeout, uint32_t timeout_ms) {
+#if FEATURE_FLASH_FS
+    static const uint8_t padding[16] = { [0 ... 15] = TELEM_QUERY_PADDING };
+    uint32_t size = 0;
+    telem_err_t err = run_query(query, output, query->size, write_timeout, timeout_ms, &size);
+
+    if (err == TELEM_ERR_OUTPUT_WRITE) {
+        return err;
+    }
+
+    if (size != query->size) {
+        LOG_TELEM__EXECUTION_FAILURE((err != TELEM_SUCCESS) ? err : TELEM_ERR_ENTRY_DNE);
+    }
+
+    while (size < query->size) {
+        uint32_t len = MIN(sizeof(padding), query->size - size);
+
+        if (io_stream_write(output, padding, len, write_timeout, NULL) != len) {
+            return TELEM_ERR_OUTPUT_WRITE;
+        }
+
+        size += len;
+    }
+
+    return TELEM_SUCCESS;
+#else
+    return TELEM_ERR_ENTRY_DNE;
+#endif
 }
 
 /******************************************************************************/
@@ -512,14 +890,6 @@ static void telem_collect_task(void *pvParameters) {
                 break;
             }
 
-#if FEATURE_FLASH_FS
-
-            if (check_file_sizes() != TELEM_SUCCESS) {
-                LOG_TELEM__COLLECTION_FAILURE(TELEM_ERR_FILE_SIZE);
-            }
-
-#endif
-
             uint16_t num_priority_0 = 0;
             uint16_t num_priority_1 = 0;
             uint16_t num_priority_2 = 0;
@@ -553,7 +923,7 @@ static void telem_collect_task(void *pvParameters) {
                 }
             }
 
-            // Add outer headers to queue and notify telem_exec task to wake up and read from queue
+            // Add the ends of the frames to queue and notify telem_exec task to wake up and read from queue
             if (num_priority_0 || num_priority_1 || num_priority_2) {
                 telem_exec_enqueue((uint16_t) TELEM_QUEUE_MAGIC_NUM);
                 telem_exec_enqueue(num_priority_0);
@@ -576,164 +946,677 @@ static void telem_collect_task(void *pvParameters) {
 
 #if FEATURE_FLASH_FS
 /**
- * @brief Generates the outer header for all telem units for a given timestamp
+ * @brief Encode the oldest frames collected for a priority and write them to the head segment as a
+ * telem block
  *
- * Format : { epoch_t cur_epoch, uint16_t num_units } serialized as uint8_t array
-*/
-static telem_err_t generate_outer_header(uint8_t *header_buf, uint16_t num_units) {
-    epoch_t cur_epoch = rtc_get_epoch_time();
+ * The frames are dropped even if they can't be written so that new frames can still be collected.
+ * Must be called with telem_block_mutex held.
+ *
+ * @param[in] priority    Priority of the frames
+ * @param[in] num_frames  Number of frames to write
+ */
+static telem_err_t write_frames(uint8_t priority, uint8_t num_frames) {
+    telem_block_t *block = &blocks[priority];
 
-    if (cur_epoch == RTC_EPOCH_ERR) {
-        return TELEM_ERR_RTC_ERR;
+    if (num_frames == 0) {
+        return TELEM_SUCCESS;
     }
 
-    // Serialize into byte array
-    // epoch_t is casted into its native type of int32_t
-    data_fmt_u32_to_arr_be((int32_t) cur_epoch, header_buf);
-    data_fmt_u16_to_arr_be(num_units, header_buf + sizeof(int32_t));
+    epoch_t epoch_min = (epoch_t) block->epochs[0];
+    epoch_t epoch_max = (epoch_t) block->epochs[0];
 
-    return TELEM_SUCCESS;
+    for (uint8_t f = 1; f < num_frames; f++) {
+        epoch_min = MIN(epoch_min, (epoch_t) block->epochs[f]);
+        epoch_max = MAX(epoch_max, (epoch_t) block->epochs[f]);
+    }
+
+    uint32_t size = telem_block_encode(block, num_frames, block_buf, sizeof(block_buf));
+
+    telem_block_drop_frames(block, num_frames);
+
+    telem_err_t err = (size > 0) ? append_block(priority, size, num_frames, epoch_min, epoch_max) : TELEM_ERR_BLOCK_FULL;
+
+    if (err != TELEM_SUCCESS) {
+        telem_index_drop_frames(priority, num_frames);
+    }
+
+    return err;
 }
 
 /**
- * @brief Generates the inner header associated with a singular telem unit
+ * @brief Write the block in block_buf to the head segment of a telem file and index it
  *
- * Format : { telem_id_t telem_id, uint16_t resp_len } serialized as uint8_t array
-*/
-static void generate_inner_header(uint8_t *header_buf, telem_id_t id, uint16_t resp_len) {
-    // Serialize into byte array
-    // telem_id_t is casted into its native type of uint16_t
-    data_fmt_u16_to_arr_be((uint16_t) id, header_buf);
-    data_fmt_u16_to_arr_be(resp_len, header_buf + sizeof(uint16_t));
-}
+ * Must be called with telem_block_mutex held.
+ *
+ * @param[in] priority    Priority of the block
+ * @param[in] size        Size of the block
+ * @param[in] num_frames  Number of frames of the block in the telem index (see telem_index_add_block)
+ * @param[in] epoch_min   Earliest epoch of the frames
+ * @param[in] epoch_max   Latest epoch of the frames
+ */
+static telem_err_t append_block(uint8_t priority, uint32_t size, uint8_t num_frames, epoch_t epoch_min, epoch_t epoch_max) {
+    fs_handle_t handle;
+    fs_err_t err = get_file_handle(priority, &handle);
 
-/**
- * @brief Deserializes outer header into constituent parts
-*/
-static void deserialize_outer_header(const uint8_t *header_buf, epoch_t *epoch, uint16_t *num_units) {
-    *epoch = (epoch_t) data_fmt_arr_be_to_u32(header_buf);
-    *num_units = data_fmt_arr_be_to_u16(header_buf + sizeof(int32_t));
+    if (err == FS_OK) {
+        err = fs_write_enqueue(handle, block_buf, size);
+    }
+
+    if (err != FS_OK) {
+        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    }
+
+    // A failure to index the block only slows down searches, the block itself was written
+    if (telem_index_add_block(priority, head_seqs[priority], file_sizes[priority], size, num_frames, epoch_min, epoch_max) != TELEM_SUCCESS) {
+        LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_FLASH_WRITE);
+    }
+
+    file_sizes[priority] += size;
+
+    if (file_sizes[priority] >= telem_store_segment_size(priority)) {
+        rotate_segment(priority);
+    }
+
+    return TELEM_SUCCESS;
 }
 
 /**
- * @brief Deserializes inner header into constituent parts
-*/
-static void deserialize_inner_header(const uint8_t *header_buf, telem_id_t *id, uint16_t *resp_len) {
-    *id = (telem_id_t) data_fmt_arr_be_to_u16(header_buf);
-    *resp_len = data_fmt_arr_be_to_u16(header_buf + sizeof(uint16_t));
+ * @brief Save the frames collected for a priority that haven't been written in MRAM, or clear the
+ * MRAM slot of the priority if there are none
+ *
+ * The block is written before its size, and is checked when it is recovered, so a reset during the
+ * update only loses the frames. If the frames can't be saved, the slot is cleared so that it doesn't
+ * hold frames that were written since. Must be called with telem_block_mutex held.
+ *
+ * @param[in] priority  Priority of the frames
+ */
+static void spool_frames(uint8_t priority) {
+    telem_block_t *block = &blocks[priority];
+    uint16_t addr = (uint16_t) (MRAM_TELEM_SPOOL_ADDR + (priority * TELEM_SPOOL_SLOT_SIZE));
+    uint32_t size = 0;
+    mram_err_t err = MRAM_OK;
+
+    if (block->num_frames > 0) {
+        size = telem_block_encode(block, block->num_frames, block_buf, sizeof(block_buf));
+    }
+
+    if ((size == 0) && !spooled[priority]) {
+        return;
+    }
+
+    if (size > 0) {
+        err = mram_write(addr + TELEM_SPOOL_HEADER_SIZE, (uint16_t) size, block_buf);
+        size = (err == MRAM_OK) ? size : 0U;
+    }
+
+    uint8_t header[TELEM_SPOOL_HEADER_SIZE];
+    data_fmt_u16_to_arr_be((uint16_t) size, header);
+
+    mram_err_t header_err = mram_write(addr, sizeof(header), header);
+
+    // Retried after the next frame until the slot is cleared
+    spooled[priority] = (size > 0) || (header_err != MRAM_OK);
+
+    if ((err != MRAM_OK) || (header_err != MRAM_OK)) {
+#if FEATURE_HW_MRAM
+        LOG_TELEM__MRAM_FAILURE();
+#endif
+    }
 }
 
-/*
- * @brief Reads the outer header and moves cursor back to the start of the header
+/**
+ * @brief Write the frames saved in MRAM before the reset to the telem files
  *
- * @return This function should call fs_close() before returning anything other than TELEM_SUCCESS
+ * The frames of each priority are written as one block. Their values aren't in the telem index of
+ * the latest values, so they are found by searching the telem files.
  */
-static telem_err_t read_outer_header(lfs_file_t *file, int32_t *offset, epoch_t *cur_epoch, uint16_t *num_units) {
-    if (fs_seek(file, -TELEM_OUTER_HEADER_SIZE, FS_SEEK_CUR) != FS_OK) {
-        return TELEM_ERR_FLASH_READ;
+static void recover_spooled_frames(void) {
+    if (xSemaphoreTake(telem_block_mutex, pdMS_TO_TICKS(TELEM_BLOCK_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return;
     }
 
-    uint8_t outer_header[TELEM_OUTER_HEADER_SIZE];
+    telem_block_reader_t reader;
 
-    if (fs_read(file, outer_header, TELEM_OUTER_HEADER_SIZE) != FS_OK) {
-        return TELEM_ERR_FLASH_READ;
-    }
+    for (uint8_t priority = 0; priority < TELEM_NUM_PRIORITIES; priority++) {
+        uint16_t addr = (uint16_t) (MRAM_TELEM_SPOOL_ADDR + (priority * TELEM_SPOOL_SLOT_SIZE));
+        uint8_t header[TELEM_SPOOL_HEADER_SIZE];
+
+        if (mram_read(addr, sizeof(header), header) != MRAM_OK) {
+#if FEATURE_HW_MRAM
+            LOG_TELEM__MRAM_FAILURE();
+#endif
+            continue;
+        }
 
-    deserialize_outer_header(outer_header, cur_epoch, num_units);
+        uint16_t size = data_fmt_arr_be_to_u16(header);
+
+        if (size == 0) {
+            continue;
+        }
+
+        if ((size >= TELEM_BLOCK_MIN_SIZE) && (size <= sizeof(block_buf)) &&
+                (mram_read(addr + TELEM_SPOOL_HEADER_SIZE, size, block_buf) == MRAM_OK) &&
+                (telem_block_check(block_buf, size) == size) && telem_block_reader_init(&reader, block_buf, size) && (reader.num_frames > 0)) {
+            epoch_t epoch_min = (epoch_t) reader.epochs[0];
+            epoch_t epoch_max = (epoch_t) reader.epochs[0];
+
+            for (uint8_t f = 1; f < reader.num_frames; f++) {
+                epoch_min = MIN(epoch_min, (epoch_t) reader.epochs[f]);
+                epoch_max = MAX(epoch_max, (epoch_t) reader.epochs[f]);
+            }
+
+            // The frames weren't added to the telem index since the reset
+            if (append_block(priority, size, 0, epoch_min, epoch_max) != TELEM_SUCCESS) {
+                LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_FLASH_WRITE);
+            }
+        }
 
-    if (fs_seek(file, -TELEM_OUTER_HEADER_SIZE, FS_SEEK_CUR) != FS_OK) {
-        return TELEM_ERR_FLASH_READ;
+        // No frames have been collected since the reset, so this clears the slot
+        spooled[priority] = true;
+        spool_frames(priority);
     }
 
-    *offset += TELEM_OUTER_HEADER_SIZE;
-    return TELEM_SUCCESS;
+    xSemaphoreGive(telem_block_mutex);
 }
 
-/*
- * @brief Reads the inner header and moves cursor back to the start of the header
+/**
+ * @brief Read a value at a location from the telem index
  *
- * @return This function should call fs_close() before returning anything other than TELEM_SUCCESS
+ * The whole telem block at the location is read and checked, so a location that no longer holds
+ * the value (e.g. the block was lost from a full write ring) is detected. The location holds the
+ * size of the block, so the block is read and checked once.
  */
-static telem_err_t read_inner_header(lfs_file_t *file, int32_t *offset, telem_id_t *cur_telem_id, uint16_t *resp_len) {
-    if (fs_seek(file, -TELEM_INNER_HEADER_SIZE, FS_SEEK_CUR) != FS_OK) {
-        return TELEM_ERR_FLASH_READ;
+static telem_err_t read_indexed_value(const telem_index_loc_t *loc, telem_id_t telem_id, uint8_t *buf, uint16_t mutex_timeout) {
+    uint8_t read_buf[TELEM_BLOCK_MAX_SIZE];
+
+    uint32_t tail;
+    uint32_t head;
+    telem_err_t telem_err = telem_store_get_range(loc->priority, &tail, &head, mutex_timeout);
+
+    if (telem_err != TELEM_SUCCESS) {
+        return telem_err;
+    }
+
+    // The segment was evicted
+    if ((loc->seq < tail) || (loc->seq > head)) {
+        return TELEM_ERR_ENTRY_DNE;
     }
 
-    uint8_t inner_header[TELEM_INNER_HEADER_SIZE];
+    char filename[TELEM_STORE_NAME_MAX_SIZE];
+    telem_store_segment_name(loc->priority, loc->seq, head, filename);
+
+    if ((loc->size < TELEM_BLOCK_MIN_SIZE) || (loc->size > sizeof(read_buf))) {
+        return TELEM_ERR_ENTRY_DNE;
+    }
 
-    if (fs_read(file, inner_header, TELEM_INNER_HEADER_SIZE) != FS_OK) {
-        return TELEM_ERR_FLASH_READ;
+    uint32_t bytes_read = 0;
+    fs_err_t err = fs_read_at(filename, loc->offset, read_buf, loc->size, &bytes_read, mutex_timeout);
+
+    if (err != FS_OK) {
+        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
     }
 
-    deserialize_inner_header(inner_header, cur_telem_id, resp_len);
+    int32_t sample_epoch = 0;
 
-    if (fs_seek(file, -TELEM_INNER_HEADER_SIZE, FS_SEEK_CUR) != FS_OK) {
-        return TELEM_ERR_FLASH_READ;
+    if ((bytes_read != loc->size) || (telem_block_check(read_buf, loc->size) != loc->size) ||
+            !telem_block_decode_sample(read_buf, loc->size, (uint16_t) telem_id, (int32_t) loc->epoch, buf, loc->len, &sample_epoch) ||
+            (sample_epoch != (int32_t) loc->epoch)) {
+        return TELEM_ERR_ENTRY_DNE;
     }
 
-    *offset += TELEM_INNER_HEADER_SIZE;
     return TELEM_SUCCESS;
 }
 
-/*
- * @brief Returns TELEM_SUCCESS if we meet a sequence of bytes in the file that matches the stop word
+/**
+ * @brief Search a telem file backwards for the last value of a telem unit collected at or before an epoch
  *
- * @return This function should call fs_close() before returning anything other than TELEM_SUCCESS
+ * The file is read in windows of TELEM_SCAN_WINDOW_SIZE bytes and parsed in RAM. Each telem block
+ * ends with its size, CRC and stop word, so blocks are parsed from their end. If the data before a
+ * position isn't a valid block (e.g. the file was truncated in the middle of a block), the search
+ * moves back to the previous stop word.
+ *
+ * @param[in]  filename     Telem file
+ * @param[in]  end          Offset to search backwards from, must be the end of a block to not skip it
+ * @param[in]  telem_id     ID of the telem unit
+ * @param[in]  epoch        Latest epoch of the value
+ * @param[out] buf          Value (if found)
+ * @param[out] exec_epoch   Epoch of the value (if found)
+ * @param[in]  start_ticks  Start of the search
+ * @param[in]  total_ticks  Time allowed for the search
  */
-static telem_err_t search_for_stop_word(lfs_file_t *file, int32_t *offset, const int32_t *file_size, uint8_t *stop_word_buf) {
-    while (*offset < *file_size) {
-        if (fs_seek(file, -TELEM_STOP_WORD_SIZE, FS_SEEK_CUR) != FS_OK) {
-            return TELEM_ERR_FLASH_READ;
+static telem_err_t scan_for_value(const char *filename, uint32_t end, telem_id_t telem_id, epoch_t epoch, uint8_t *buf, epoch_t *exec_epoch,
+                                  TickType_t start_ticks, TickType_t total_ticks) {
+    uint8_t window[TELEM_SCAN_WINDOW_SIZE];
+
+    while (end > 0) {
+        TickType_t elapsed_ticks = xTaskGetTickCount() - start_ticks;
+
+        if (elapsed_ticks >= total_ticks) {
+            return TELEM_ERR_SEARCH_TIMEOUT;
         }
 
-        if (fs_read(file, stop_word_buf, TELEM_STOP_WORD_SIZE) != FS_OK) {
-            return TELEM_ERR_FLASH_READ;
+        uint32_t start = (end > sizeof(window)) ? (end - sizeof(window)) : 0U;
+        uint32_t bytes_read = 0;
+
+        fs_err_t err = fs_read_at(filename, start, window, end - start, &bytes_read, pdTICKS_TO_MS(total_ticks - elapsed_ticks));
+
+        if (err != FS_OK) {
+            return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
         }
 
-        if (memcmp(telem_stop_word, stop_word_buf, TELEM_STOP_WORD_SIZE)) {
-            if (fs_seek(file, -1, FS_SEEK_CUR) != FS_OK) {
-                return TELEM_ERR_FLASH_READ;
+        // Blocks still in the write ring aren't in the file yet, search from the end of the file instead
+        if (bytes_read != (end - start)) {
+            end = start + bytes_read;
+            continue;
+        }
+
+        // End of the part of the window that hasn't been parsed yet
+        uint32_t pos = end - start;
+
+        while (pos >= TELEM_BLOCK_MIN_SIZE) {
+            uint32_t size = telem_block_check(window, pos);
+
+            if (size == 0) {
+                // Not the end of a block, keep looking for the previous stop word
+                pos--;
+                continue;
             }
 
-            *offset += 1;
-            continue; // Keep searching
+            int32_t sample_epoch = 0;
+
+            if (telem_block_decode_sample(&window[pos - size], size, (uint16_t) telem_id, (int32_t) epoch, buf,
+                                          TELEM_SPEC_TABLE[telem_id].resp_size, &sample_epoch)) {
+                *exec_epoch = (epoch_t) sample_epoch;
+                return TELEM_SUCCESS;
+            }
+
+            pos -= size;
         }
 
-        // Found the stop word
-        if (fs_seek(file, -TELEM_STOP_WORD_SIZE, FS_SEEK_CUR) != FS_OK) {
-            return TELEM_ERR_FLASH_READ;
+        if (start == 0) {
+            break;
         }
 
-        *offset += TELEM_STOP_WORD_SIZE;
-        return TELEM_SUCCESS;
+        // Continue with a window ending at the part that hasn't been parsed. A block ending there
+        // fits in the window since the window holds the largest block.
+        end = start + pos;
     }
 
-    fs_close(file);
     return TELEM_ERR_ENTRY_DNE;
 }
 
 /**
- * @brief Check file sizes and reset to 0 if necessary
+ * @brief Get the size of a segment, including the writes still in the write ring for the head segment
+ *
+ * A segment that doesn't exist (e.g. evicted during the search) has a size of 0.
+ */
+static telem_err_t get_segment_size(uint8_t priority, uint32_t seq, uint32_t head, uint32_t *size, uint16_t mutex_timeout) {
+    if ((seq == head) && file_handles_valid[priority] && (head_seqs[priority] == head)) {
+        *size = file_sizes[priority];
+        return TELEM_SUCCESS;
+    }
+
+    char filename[TELEM_STORE_NAME_MAX_SIZE];
+    telem_store_segment_name(priority, seq, head, filename);
+
+    fs_entry_info_t info;
+    fs_err_t err = fs_stat(filename, &info, mutex_timeout);
+
+    if (err == FS_NOENT_ERR) {
+        *size = 0;
+        return TELEM_SUCCESS;
+    }
+
+    if (err != FS_OK) {
+        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
+    }
+
+    *size = info.size;
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Seal the head segment of a priority once it is full and start writing a new one
+ *
+ * On failure the head segment keeps growing and the rotation is retried after the next block.
+ */
+static void rotate_segment(uint8_t priority) {
+    uint32_t tail;
+    uint32_t head;
+
+    if ((telem_store_rotate(priority, TELEM_FS_MUTEX_TIMEOUT_MS) != TELEM_SUCCESS) ||
+            (telem_store_get_range(priority, &tail, &head, TELEM_FS_MUTEX_TIMEOUT_MS) != TELEM_SUCCESS)) {
+        LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_FILE_SIZE);
+        return;
+    }
+
+    head_seqs[priority]  = head;
+    file_sizes[priority] = 0;
+}
+
+/**
+ * @brief Get the write ring handle of the telem file of a priority level
+ *
+ * The handle is for the head segment, whose name doesn't change when it is sealed. Its sequence
+ * number and size are read when the handle is interned so that locations of new writes are known.
+ *
+ * @param[in]  priority   Priority level of the file
+ * @param[out] handle     Handle of the file
+ *
+ * @return FS_OK if successful, error code otherwise
 */
-static telem_err_t check_file_sizes(void) {
-    if (file_0_size >= (int32_t) TELEM_PRIORITY_0_MAX_FILE_SIZE) {
-        if (fs_remove("telem_priority_0", TELEM_FS_MUTEX_TIMEOUT_MS) != FS_OK) {
-            return TELEM_ERR_FILE_SIZE;
+static fs_err_t get_file_handle(uint8_t priority, fs_handle_t *handle) {
+    uint8_t idx = MIN(priority, TELEM_NUM_PRIORITIES - 1U);
+
+    if (!file_handles_valid[idx]) {
+        uint32_t tail;
+        telem_err_t store_err = telem_store_get_range(idx, &tail, &head_seqs[idx], TELEM_FS_MUTEX_TIMEOUT_MS);
+
+        if (store_err != TELEM_SUCCESS) {
+            return ((store_err == TELEM_ERR_FS_TIMEOUT) || (store_err == TELEM_ERR_MUTEX_TIMEOUT)) ? FS_MUTEX_TIMEOUT : FS_READ_FAILURE_ERR;
+        }
+
+        char filename[TELEM_STORE_NAME_MAX_SIZE];
+        telem_store_segment_name(idx, head_seqs[idx], head_seqs[idx], filename);
+
+        fs_entry_info_t info;
+        fs_err_t err = fs_stat(filename, &info, TELEM_FS_MUTEX_TIMEOUT_MS);
+
+        if ((err != FS_OK) && (err != FS_NOENT_ERR)) {
+            return err;
         }
+
+        file_sizes[idx] = (err == FS_OK) ? info.size : 0U;
+
+        err = fs_get_handle(filename, &file_handles[idx], TELEM_FS_MUTEX_TIMEOUT_MS);
+
+        if (err != FS_OK) {
+            return err;
+        }
+
+        file_handles_valid[idx] = true;
     }
 
-    if (file_1_size >= (int32_t) TELEM_PRIORITY_1_MAX_FILE_SIZE) {
-        if (fs_remove("telem_priority_1", TELEM_FS_MUTEX_TIMEOUT_MS) != FS_OK) {
-            return TELEM_ERR_FILE_SIZE;
+    *handle = file_handles[idx];
+    return FS_OK;
+}
+/**
+ * @brief Run a query over the segments of the telem files that existed when it began
+ *
+ * The telem files are read one at a time. The windows of the telem units of a telem file are
+ * emitted once it has been read.
+ *
+ * @param[in]  query          Query
+ * @param[in]  output         Output stream for the records, or NULL to only measure them
+ * @param[in]  max_size       Maximum size of the records
+ * @param[in]  write_timeout  Timeout of each write to output
+ * @param[in]  timeout_ms     Time allowed to run the query
+ * @param[out] size           Size of the records
+ */
+static telem_err_t run_query(const telem_query_t *query, const io_ostream_t *output, uint32_t max_size, uint32_t write_timeout,
+                             uint32_t timeout_ms, uint32_t *size) {
+    TickType_t start_ticks = xTaskGetTickCount();
+
+    if (xSemaphoreTake(telem_query_mutex, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
+
+    telem_query_run_t *run = &query_run;
+    telem_err_t err = TELEM_SUCCESS;
+
+    run->query         = query;
+    run->output        = output;
+    run->write_timeout = write_timeout;
+    run->size          = 0;
+    run->max_size      = max_size;
+    run->full          = false;
+    run->start_ticks   = start_ticks;
+    run->total_ticks   = pdMS_TO_TICKS(timeout_ms);
+
+    for (uint8_t u = 0; u < query->num_units; u++) {
+        const telem_spec_t *spec = &TELEM_SPEC_TABLE[query->telem_ids[u]];
+
+        run->counts[u] = 0;
+
+        if ((query->mode == TELEM_QUERY_MODE_WINDOW) && !telem_window_init(&run->windows[u], spec->resp, (uint8_t) spec->resp_size)) {
+            err = TELEM_ERR_DATA_FMT;
         }
     }
 
-    if (file_2_size >= (int32_t) TELEM_PRIORITY_2_MAX_FILE_SIZE) {
-        if (fs_remove("telem_priority_2", TELEM_FS_MUTEX_TIMEOUT_MS) != FS_OK) {
-            return TELEM_ERR_FILE_SIZE;
+    for (uint8_t p = 0; (p < TELEM_NUM_PRIORITIES) && (err == TELEM_SUCCESS) && !run->full; p++) {
+        bool used = false;
+
+        for (uint8_t u = 0; u < query->num_units; u++) {
+            used = used || (query->priorities[u] == p);
+        }
+
+        if (!used) {
+            continue;
+        }
+
+        run->priority = p;
+
+        for (uint32_t seq = query->tails[p]; (err == TELEM_SUCCESS) && !run->full; seq++) {
+            char filename[TELEM_STORE_NAME_MAX_SIZE];
+            telem_store_segment_name(p, seq, query->heads[p], filename);
+
+            uint32_t file_size = query->head_sizes[p];
+            uint32_t start = 0;
+            uint32_t end = 0;
+
+            // A sealed segment doesn't change until it is evicted
+            if (seq != query->heads[p]) {
+                err = get_segment_size(p, seq, query->heads[p], &file_size, query_time_left());
+            }
+
+            if (err == TELEM_SUCCESS) {
+                err = telem_index_find_range(p, seq, query->heads[p], query->epoch_start, query->epoch_end, file_size, &start, &end,
+                                             query_time_left());
+            }
+
+            if (err == TELEM_SUCCESS) {
+                err = query_segment(filename, start, end);
+            }
+
+            if (seq == query->heads[p]) {
+                break;
+            }
+        }
+
+        for (uint8_t u = 0; (u < query->num_units) && (err == TELEM_SUCCESS); u++) {
+            if ((query->mode == TELEM_QUERY_MODE_WINDOW) && (query->priorities[u] == p) && (run->windows[u].count > 0)) {
+                err = query_emit_window(u);
+            }
         }
     }
 
+    *size = run->size;
+
+    xSemaphoreGive(telem_query_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Run a query over the blocks of a segment between two offsets
+ *
+ * Blocks are found by reading forward, checking every position of a read for the end of a block
+ * that starts after the previous one (see TELEM_QUERY_READ_SIZE). Corrupted data between blocks is
+ * skipped.
+ */
+static telem_err_t query_segment(const char *filename, uint32_t start, uint32_t end) {
+    uint32_t pos = start;
+
+    while ((pos < end) && !query_run.full) {
+        uint16_t time_left = query_time_left();
+
+        if (time_left == 0) {
+            return TELEM_ERR_SEARCH_TIMEOUT;
+        }
+
+        uint32_t len = MIN(sizeof(query_buf), end - pos);
+        uint32_t bytes_read = 0;
+        fs_err_t fs_err = fs_read_at(filename, pos, query_buf, len, &bytes_read, time_left);
+
+        if (fs_err != FS_OK) {
+            return (fs_err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
+        }
+
+        // Part of the read that has been parsed
+        uint32_t parsed = 0;
+
+        for (uint32_t block_end = TELEM_BLOCK_MIN_SIZE; (block_end <= bytes_read) && !query_run.full; block_end++) {
+            uint32_t size = telem_block_check(query_buf, block_end);
+
+            if ((size == 0) || (size > (block_end - parsed))) {
+                continue;
+            }
+
+            telem_err_t err = query_block(&query_buf[block_end - size], size);
+
+            if (err != TELEM_SUCCESS) {
+                return err;
+            }
+
+            parsed    = block_end;
+            block_end = parsed + TELEM_BLOCK_MIN_SIZE - 1U;
+        }
+
+        // The segment is shorter than expected (e.g. truncated by a downlink)
+        if (bytes_read < len) {
+            break;
+        }
+
+        if ((pos + bytes_read) >= end) {
+            break;
+        }
+
+        // A block that ends after the read starts after the read minus the largest block
+        pos += MAX(parsed, bytes_read - TELEM_BLOCK_MAX_SIZE + 1U);
+    }
+
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Run a query over the samples of a telem block
+ */
+static telem_err_t query_block(const uint8_t *buf, uint32_t size) {
+    telem_query_run_t *run = &query_run;
+    const telem_query_t *query = run->query;
+    uint8_t record[TELEM_QUERY_RECORD_MAX_SIZE];
+    int32_t epoch = 0;
+
+    if (!telem_block_reader_init(&query_reader, buf, size)) {
+        return TELEM_SUCCESS;
+    }
+
+    while (!run->full && telem_block_reader_next(&query_reader, &epoch)) {
+        uint8_t u = 0;
+
+        while ((u < query->num_units) &&
+                ((query->telem_ids[u] != (telem_id_t) query_reader.telem_id) || (query->priorities[u] != run->priority))) {
+            u++;
+        }
+
+        if ((u == query->num_units) || (query_reader.size != TELEM_SPEC_TABLE[query->telem_ids[u]].resp_size) ||
+                ((epoch_t) epoch < query->epoch_start) || ((epoch_t) epoch > query->epoch_end)) {
+            continue;
+        }
+
+        telem_err_t err = TELEM_SUCCESS;
+
+        if (query->mode == TELEM_QUERY_MODE_EVERY_NTH) {
+            if ((run->counts[u] % query->step) == 0) {
+                data_fmt_u16_to_arr_be(query_reader.telem_id, &record[0]);
+                data_fmt_u32_to_arr_be((uint32_t) epoch, &record[2]);
+                memcpy(&record[6], query_reader.sample, query_reader.size);
+
+                err = query_emit(record, 6U + query_reader.size);
+            }
+
+            run->counts[u]++;
+        } else {
+            telem_window_t *window = &run->windows[u];
+            uint32_t offset = (uint32_t)((int32_t) epoch - (int32_t) query->epoch_start);
+            int32_t window_start = (int32_t)((uint32_t) query->epoch_start + (offset - (offset % query->step)));
+
+            if ((window->count == 0) || (window->start != window_start)) {
+                if (window->count > 0) {
+                    err = query_emit_window(u);
+                }
+
+                telem_window_reset(window, window_start);
+            }
+
+            telem_window_add(window, query_reader.sample);
+        }
+
+        if (err != TELEM_SUCCESS) {
+            return err;
+        }
+    }
+
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Emit the record of the window of a telem unit
+ */
+static telem_err_t query_emit_window(uint8_t unit) {
+    const telem_query_t *query = query_run.query;
+    telem_window_t *window = &query_run.windows[unit];
+    uint8_t record[TELEM_QUERY_RECORD_MAX_SIZE];
+    uint32_t len = TELEM_QUERY_RECORD_HEADER_SIZE;
+
+    data_fmt_u16_to_arr_be((uint16_t) query->telem_ids[unit], &record[0]);
+    data_fmt_u32_to_arr_be((uint32_t) window->start, &record[2]);
+    data_fmt_u16_to_arr_be((uint16_t) MIN(window->count, UINT16_MAX), &record[6]);
+
+    memcpy(&record[len], window->min, window->size);
+    len += window->size;
+    memcpy(&record[len], window->max, window->size);
+    len += window->size;
+    telem_window_mean(window, &record[len]);
+    len += window->size;
+
+    telem_window_reset(window, 0);
+
+    return query_emit(record, len);
+}
+
+/**
+ * @brief Add a record to the result of the query being run
+ *
+ * Once a record doesn't fit, the query is over so that no smaller record after it is added instead.
+ */
+static telem_err_t query_emit(const uint8_t *record, uint32_t len) {
+    telem_query_run_t *run = &query_run;
+
+    if (run->full || (len > (run->max_size - run->size))) {
+        run->full = true;
+        return TELEM_SUCCESS;
+    }
+
+    if ((run->output != NULL) && (io_stream_write(run->output, record, len, run->write_timeout, NULL) != len)) {
+        return TELEM_ERR_OUTPUT_WRITE;
+    }
+
+    run->size += len;
+
     return TELEM_SUCCESS;
 }
+
+/**
+ * @brief Time left to run the query being run, in ms
+ */
+static uint16_t query_time_left(void) {
+    TickType_t elapsed_ticks = xTaskGetTickCount() - query_run.start_ticks;
+
+    if (elapsed_ticks >= query_run.total_ticks) {
+        return 0;
+    }
+
+    return (uint16_t) MIN(pdTICKS_TO_MS(query_run.total_ticks - elapsed_ticks), UINT16_MAX);
+}
 #endif
@@ -15,6 +15,7 @@
 #include "telem_error.h"
 #include "telem_gen.h"
 #include "data_fmt.h"
+#include "io_stream.h"
 
 // Standard Library
 #include <stdint.h>
@@ -24,12 +25,66 @@
 /******************************************************************************/
 
 #define TELEM_QUEUE_MAGIC_NUM   65535U
-#define TELEM_STOP_WORD         0xA1EA50BC // "ALEA OBC"
+
+#define TELEM_NUM_PRIORITIES    3U
+
+/**
+ * @brief Maximum number of telem units in a query
+ */
+#define TELEM_QUERY_MAX_UNITS   8U
+
+/**
+ * @brief Fills the end of the result of a query that came out shorter than measured (see telem_query_read).
+ * Records never start with telem ID 0xFFFF, so this marks the end of the records.
+ */
+#define TELEM_QUERY_PADDING     0xFFU
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief How the samples of a query are returned
+ *
+ * The result of a query is a sequence of records (multi-byte fields are big-endian):
+ *
+ * - TELEM_QUERY_MODE_EVERY_NTH: | telem_id (2) | epoch (4) | sample |
+ * - TELEM_QUERY_MODE_WINDOW:    | telem_id (2) | epoch of the start of the window (4) | count (2) | min | max | mean |
+ *
+ * Samples, min, max and mean are serialized responses of the telem unit (see telem_window.h), so they
+ * have the size of its response. Samples of another size (e.g. collected by a different version of the
+ * firmware) are skipped. The records of a telem unit are in order of epoch.
+ */
+typedef enum {
+    TELEM_QUERY_MODE_EVERY_NTH = 0, ///< Every step-th sample of each telem unit, starting with the first one
+    TELEM_QUERY_MODE_WINDOW    = 1, ///< Min / max / mean of the samples of each telem unit in windows of step seconds
+} telem_query_mode_t;
+
+/**
+ * @brief Query of the samples of telem units collected in a range of epochs
+ *
+ * The fields before size are set by the caller, the others by telem_query_begin.
+ */
+typedef struct {
+    epoch_t epoch_start;                        // Start of the range (inclusive), also the start of the first window
+    epoch_t epoch_end;                          // End of the range (inclusive)
+    telem_query_mode_t mode;
+    uint32_t step;
+    telem_id_t telem_ids[TELEM_QUERY_MAX_UNITS];
+    uint8_t num_units;
+
+    uint32_t size;                              // Size of the result
+    uint8_t priorities[TELEM_QUERY_MAX_UNITS];  // Telem file of each telem unit
+    uint32_t tails[TELEM_NUM_PRIORITIES];       // Segments of the telem files when the query began
+    uint32_t heads[TELEM_NUM_PRIORITIES];
+    uint32_t head_sizes[TELEM_NUM_PRIORITIES];
+} telem_query_t;
 
 /******************************************************************************/
 /*                             F U N C T I O N S                              */
 /******************************************************************************/
 
+void telem_pre_init(void);
 void telem_init_mram(void);
 void telem_collect_post_init(void);
 void telem_collect_enable(void);
@@ -45,25 +100,14 @@ telem_err_t telem_handle_resp(const telem_id_t id, const uint8_t priority, const
                               const uint16_t resp_len, uint8_t *buf);
 
 telem_err_t telem_get_last_value(const telem_id_t telem_id, uint8_t *buf, epoch_t *exec_epoch, uint16_t mutex_timeout);
+telem_err_t telem_get_value_at(const telem_id_t telem_id, const epoch_t epoch, uint8_t *buf, epoch_t *exec_epoch, uint16_t mutex_timeout);
 
-telem_err_t write_outer_header_and_stop_word(uint16_t num_units, char *filename, uint8_t priority);
+telem_err_t telem_flush(uint8_t priority, uint16_t mutex_timeout);
+telem_err_t telem_drop_newest(uint8_t priority, uint32_t size, uint16_t mutex_timeout);
 
-/*
- * @brief Converts the priority number (0,1,2) into the appropriate filename
- */
-static inline void convert_priority_to_filename(char *filename, uint8_t priority) {
-    switch (priority) {
-    case 0:
-        strcpy(filename, "telem_priority_0");
-        break;
-
-    case 1:
-        strcpy(filename, "telem_priority_1");
-        break;
-
-    default: // Also doubles as case 2
-        strcpy(filename, "telem_priority_2");
-    }
-}
+telem_err_t telem_end_frame(uint8_t priority);
+
+telem_err_t telem_query_begin(telem_query_t *query, uint32_t max_size, uint32_t timeout_ms);
+telem_err_t telem_query_read(const telem_query_t *query, const io_ostream_t *output, uint32_t write_timeout, uint32_t timeout_ms);
 
 #endif // TELEM_H_
@@ -0,0 +1,539 @@
+/**
+ * @file telem_block.c
+ * @brief Columnar, delta/XOR-encoded blocks of telem frames
+ *
+ * Consecutive samples of a telem unit are highly correlated: counters only change in their low
+ * bytes and most status fields don't change at all. Grouping the samples of a unit into a column
+ * and XORing each with the previous one leaves mostly zero bytes, which the change mask drops. The
+ * per-response inner header and per-frame outer header are replaced by one column header per unit
+ * and a varint epoch delta per frame.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "telem_block.h"
+
+// Utils
+#include "log_block.h"
+#include "obc_crc.h"
+#include "data_fmt.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define SAMPLE_HEADER_SIZE      3U
+#define COLUMN_HEADER_SIZE      3U
+
+#define MASK_SIZE(bits)         (((bits) + 7U) / 8U)
+#define MASK_BIT(mask, i)       (((mask)[(i) / 8U] & (0x80U >> ((i) % 8U))) != 0U)
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static const uint8_t *find_frame_sample(const telem_block_t *block, uint8_t frame, uint16_t telem_id, uint8_t *size);
+static bool is_first_sample(const telem_block_t *block, uint16_t pos, uint16_t telem_id);
+static uint32_t decode_header(const uint8_t *buf, uint32_t size, int32_t epochs[TELEM_BLOCK_MAX_FRAMES], uint8_t *num_frames);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Start a new, empty block
+ */
+void telem_block_init(telem_block_t *block) {
+    block->samples_len = 0;
+    block->num_frames  = 0;
+}
+
+/**
+ * @brief Add a sample to the frame being collected
+ *
+ * @param[in,out] block     Block to add to
+ * @param[in]     telem_id  ID of the telem unit
+ * @param[in]     sample    Serialized response
+ * @param[in]     size      Size of the serialized response
+ *
+ * @return true if the sample was added, false if it doesn't fit (the block is unchanged)
+ */
+bool telem_block_add(telem_block_t *block, uint16_t telem_id, const uint8_t *sample, uint8_t size) {
+    if ((SAMPLE_HEADER_SIZE + size) > (TELEM_BLOCK_SAMPLES_SIZE - block->samples_len)) {
+        return false;
+    }
+
+    uint8_t *entry = &block->samples[block->samples_len];
+
+    data_fmt_u16_to_arr_be(telem_id, entry);
+    entry[2] = size;
+    memcpy(&entry[SAMPLE_HEADER_SIZE], sample, size);
+
+    block->samples_len += SAMPLE_HEADER_SIZE + size;
+
+    return true;
+}
+
+/**
+ * @brief Commit the frame being collected
+ *
+ * @param[in,out] block  Block of the frame
+ * @param[in]     epoch  Epoch of the frame
+ *
+ * @return true if the frame was committed, false if the block already has TELEM_BLOCK_MAX_FRAMES frames
+ */
+bool telem_block_end_frame(telem_block_t *block, int32_t epoch) {
+    if (block->num_frames >= TELEM_BLOCK_MAX_FRAMES) {
+        return false;
+    }
+
+    block->frame_ends[block->num_frames] = block->samples_len;
+    block->epochs[block->num_frames]     = epoch;
+    block->num_frames++;
+
+    return true;
+}
+
+/**
+ * @brief Remove the oldest committed frames (e.g. once they have been encoded and written)
+ *
+ * @param[in,out] block  Block to remove from
+ * @param[in]     count  Number of frames to remove
+ */
+void telem_block_drop_frames(telem_block_t *block, uint8_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    if (count > block->num_frames) {
+        count = block->num_frames;
+    }
+
+    uint16_t dropped = block->frame_ends[count - 1U];
+
+    memmove(block->samples, &block->samples[dropped], block->samples_len - dropped);
+    block->samples_len -= dropped;
+
+    for (uint8_t f = count; f < block->num_frames; f++) {
+        block->frame_ends[f - count] = block->frame_ends[f] - dropped;
+        block->epochs[f - count]     = block->epochs[f];
+    }
+
+    block->num_frames -= count;
+}
+
+/**
+ * @brief Find the latest sample of a telem unit collected at or before an epoch in the committed frames
+ *
+ * @param[in]  block         Block to search
+ * @param[in]  telem_id      ID of the telem unit
+ * @param[in]  epoch         Latest epoch of the sample
+ * @param[out] sample        Buffer for the sample
+ * @param[in]  size          Size of sample
+ * @param[out] sample_epoch  Epoch of the frame of the sample
+ *
+ * @return true if a sample was found, false otherwise
+ */
+bool telem_block_find_sample(const telem_block_t *block, uint16_t telem_id, int32_t epoch, uint8_t *sample, uint32_t size,
+                             int32_t *sample_epoch) {
+    for (uint8_t f = block->num_frames; f > 0; f--) {
+        uint8_t sample_size = 0;
+        const uint8_t *found = find_frame_sample(block, f - 1U, telem_id, &sample_size);
+
+        if ((found != NULL) && (block->epochs[f - 1U] <= epoch) && (sample_size <= size)) {
+            memcpy(sample, found, sample_size);
+            *sample_epoch = block->epochs[f - 1U];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Encode the oldest committed frames of a block
+ *
+ * @param[in]  block       Block to encode
+ * @param[in]  num_frames  Number of frames to encode
+ * @param[out] buf         Buffer for the encoded block
+ * @param[in]  size        Size of buf
+ *
+ * @return Size of the encoded block, or 0 if there are no frames or the block doesn't fit in buf
+ */
+uint32_t telem_block_encode(const telem_block_t *block, uint8_t num_frames, uint8_t *buf, uint32_t size) {
+    if ((num_frames == 0) || (num_frames > block->num_frames) || (size < TELEM_BLOCK_MIN_SIZE)) {
+        return 0;
+    }
+
+    // Room left for the trailer
+    uint32_t limit = size - TELEM_BLOCK_TRAILER_SIZE;
+    uint32_t len = 0;
+
+    data_fmt_u32_to_arr_be((uint32_t) block->epochs[0], &buf[len]);
+    len += 4U;
+    buf[len++] = num_frames;
+
+    for (uint8_t f = 1; f < num_frames; f++) {
+        // Zigzag encoding keeps small negative deltas (e.g. the RTC being set back) small
+        int32_t delta = (int32_t)((uint32_t) block->epochs[f] - (uint32_t) block->epochs[f - 1U]);
+        uint32_t zigzag = ((uint32_t) delta << 1) ^ (uint32_t)(delta >> 31);
+
+        if ((limit - len) < LOG_BLOCK_VARINT_MAX_SIZE) {
+            return 0;
+        }
+
+        len += log_block_varint_encode(zigzag, &buf[len]);
+    }
+
+    if (len >= limit) {
+        return 0;
+    }
+
+    uint32_t num_columns_pos = len++;
+    uint8_t num_columns = 0;
+    uint16_t samples_end = block->frame_ends[num_frames - 1U];
+    uint16_t pos = 0;
+
+    // One column per telem unit, in the order of their first sample
+    while (pos < samples_end) {
+        uint16_t entry = pos;
+        uint16_t telem_id = data_fmt_arr_be_to_u16(&block->samples[entry]);
+        uint8_t column_size = block->samples[entry + 2U];
+
+        pos += SAMPLE_HEADER_SIZE + column_size;
+
+        if (!is_first_sample(block, entry, telem_id)) {
+            continue;
+        }
+
+        if ((num_columns == UINT8_MAX) || ((limit - len) < (COLUMN_HEADER_SIZE + MASK_SIZE(num_frames)))) {
+            return 0;
+        }
+
+        data_fmt_u16_to_arr_be(telem_id, &buf[len]);
+        buf[len + 2U] = column_size;
+        len += COLUMN_HEADER_SIZE;
+
+        uint8_t *frame_mask = &buf[len];
+        memset(frame_mask, 0, MASK_SIZE(num_frames));
+        len += MASK_SIZE(num_frames);
+
+        const uint8_t *prev = NULL;
+
+        for (uint8_t f = 0; f < num_frames; f++) {
+            uint8_t sample_size = 0;
+            const uint8_t *sample = find_frame_sample(block, f, telem_id, &sample_size);
+
+            // Samples of a different size can't be XORed, they are left out
+            if ((sample == NULL) || (sample_size != column_size)) {
+                continue;
+            }
+
+            frame_mask[f / 8U] |= (uint8_t)(0x80U >> (f % 8U));
+
+            if (prev == NULL) {
+                if ((limit - len) < column_size) {
+                    return 0;
+                }
+
+                memcpy(&buf[len], sample, column_size);
+                len += column_size;
+            } else {
+                if ((limit - len) < (MASK_SIZE(column_size) + column_size)) {
+                    return 0;
+                }
+
+                uint8_t *change_mask = &buf[len];
+                memset(change_mask, 0, MASK_SIZE(column_size));
+                len += MASK_SIZE(column_size);
+
+                for (uint8_t i = 0; i < column_size; i++) {
+                    uint8_t x = sample[i] ^ prev[i];
+
+                    if (x != 0) {
+                        change_mask[i / 8U] |= (uint8_t)(0x80U >> (i % 8U));
+                        buf[len++] = x;
+                    }
+                }
+            }
+
+            prev = sample;
+        }
+
+        num_columns++;
+    }
+
+    buf[num_columns_pos] = num_columns;
+
+    data_fmt_u16_to_arr_be((uint16_t) len, &buf[len]);
+    len += 2U;
+
+    data_fmt_u32_to_arr_be(crc_32_buf(CRC32_SEED, buf, len), &buf[len]);
+    len += 4U;
+
+    data_fmt_u32_to_arr_be(TELEM_BLOCK_STOP_WORD, &buf[len]);
+    len += 4U;
+
+    return len;
+}
+
+/**
+ * @brief Check whether a valid block ends at a position of a buffer
+ *
+ * @param[in] buf  Buffer
+ * @param[in] end  Position in buf
+ *
+ * @return Size of the block that ends at end (it starts at end - size), or 0 if there is none
+ */
+uint32_t telem_block_check(const uint8_t *buf, uint32_t end) {
+    if ((end < TELEM_BLOCK_MIN_SIZE) || (data_fmt_arr_be_to_u32(&buf[end - 4U]) != TELEM_BLOCK_STOP_WORD)) {
+        return 0;
+    }
+
+    uint32_t len = data_fmt_arr_be_to_u16(&buf[end - TELEM_BLOCK_TRAILER_SIZE]);
+    uint32_t size = len + TELEM_BLOCK_TRAILER_SIZE;
+
+    if ((size > end) || (size > TELEM_BLOCK_MAX_SIZE) || (size < TELEM_BLOCK_MIN_SIZE)) {
+        return 0;
+    }
+
+    const uint8_t *block = &buf[end - size];
+
+    if (crc_32_buf(CRC32_SEED, block, len + 2U) != data_fmt_arr_be_to_u32(&block[len + 2U])) {
+        return 0;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Find the latest sample of a telem unit collected at or before an epoch in an encoded block
+ *
+ * @param[in]  buf           Encoded block, checked with telem_block_check
+ * @param[in]  size          Size of the block
+ * @param[in]  telem_id      ID of the telem unit
+ * @param[in]  epoch         Latest epoch of the sample
+ * @param[out] sample        Buffer for the sample
+ * @param[in]  sample_size   Size of sample
+ * @param[out] sample_epoch  Epoch of the frame of the sample
+ *
+ * @return true if a sample was found, false otherwise (including if the block is malformed)
+ */
+bool telem_block_decode_sample(const uint8_t *buf, uint32_t size, uint16_t telem_id, int32_t epoch, uint8_t *sample, uint32_t sample_size,
+                               int32_t *sample_epoch) {
+    telem_block_reader_t reader;
+    int32_t frame_epoch = 0;
+    bool matched = false;
+    bool found = false;
+
+    if (!telem_block_reader_init(&reader, buf, size)) {
+        return false;
+    }
+
+    while (telem_block_reader_next(&reader, &frame_epoch)) {
+        if (reader.telem_id != telem_id) {
+            // A telem unit has a single column
+            if (matched) {
+                break;
+            }
+
+            continue;
+        }
+
+        matched = true;
+
+        // The last sample in frame order wins, like a search of the frames from the end of the block
+        if ((reader.size <= sample_size) && (frame_epoch <= epoch)) {
+            memcpy(sample, reader.sample, reader.size);
+            *sample_epoch = frame_epoch;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Start decoding the samples of an encoded block
+ *
+ * @param[out] reader  Decoding state
+ * @param[in]  buf     Encoded block, checked with telem_block_check. Must stay valid while it is decoded.
+ * @param[in]  size    Size of the block
+ *
+ * @return true if the header of the block was decoded, false if it is malformed
+ */
+bool telem_block_reader_init(telem_block_reader_t *reader, const uint8_t *buf, uint32_t size) {
+    if (size < TELEM_BLOCK_MIN_SIZE) {
+        return false;
+    }
+
+    reader->buf        = buf;
+    reader->end        = size - TELEM_BLOCK_TRAILER_SIZE;
+    reader->pos        = decode_header(buf, reader->end, reader->epochs, &reader->num_frames);
+    reader->frame_mask = NULL;
+    reader->telem_id   = 0;
+    reader->size       = 0;
+
+    if ((reader->pos == 0) || (reader->pos >= reader->end)) {
+        return false;
+    }
+
+    reader->columns_left = buf[reader->pos++];
+
+    return true;
+}
+
+/**
+ * @brief Decode the next sample of a block
+ *
+ * Samples are decoded column by column, so the samples of a telem unit are in frame order. The
+ * telem unit and size of the sample are those of the current column (reader->telem_id and
+ * reader->size), and the sample is in reader->sample.
+ *
+ * @param[in,out] reader  Decoding state
+ * @param[out]    epoch   Epoch of the frame of the sample
+ *
+ * @return true if a sample was decoded, false once all samples were decoded or if the block is malformed
+ */
+bool telem_block_reader_next(telem_block_reader_t *reader, int32_t *epoch) {
+    const uint8_t *buf = reader->buf;
+
+    // Move to the next column with a sample left
+    while ((reader->frame_mask == NULL) || (reader->frame >= reader->num_frames) || !MASK_BIT(reader->frame_mask, reader->frame)) {
+        if ((reader->frame_mask != NULL) && (reader->frame < reader->num_frames)) {
+            reader->frame++;
+            continue;
+        }
+
+        if ((reader->columns_left == 0) || ((reader->end - reader->pos) < (COLUMN_HEADER_SIZE + MASK_SIZE(reader->num_frames)))) {
+            return false;
+        }
+
+        reader->telem_id   = data_fmt_arr_be_to_u16(&buf[reader->pos]);
+        reader->size       = buf[reader->pos + 2U];
+        reader->frame_mask = &buf[reader->pos + COLUMN_HEADER_SIZE];
+        reader->frame      = 0;
+        reader->first      = true;
+        reader->columns_left--;
+        reader->pos += COLUMN_HEADER_SIZE + MASK_SIZE(reader->num_frames);
+    }
+
+    if (reader->first) {
+        if ((reader->end - reader->pos) < reader->size) {
+            return false;
+        }
+
+        memcpy(reader->sample, &buf[reader->pos], reader->size);
+        reader->pos += reader->size;
+        reader->first = false;
+    } else {
+        if ((reader->end - reader->pos) < MASK_SIZE(reader->size)) {
+            return false;
+        }
+
+        const uint8_t *change_mask = &buf[reader->pos];
+        reader->pos += MASK_SIZE(reader->size);
+
+        for (uint8_t i = 0; i < reader->size; i++) {
+            if (!MASK_BIT(change_mask, i)) {
+                continue;
+            }
+
+            if (reader->pos >= reader->end) {
+                return false;
+            }
+
+            reader->sample[i] ^= buf[reader->pos++];
+        }
+    }
+
+    *epoch = reader->epochs[reader->frame];
+    reader->frame++;
+
+    return true;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Find the sample of a telem unit in a committed frame (the last one if there are several)
+ */
+static const uint8_t *find_frame_sample(const telem_block_t *block, uint8_t frame, uint16_t telem_id, uint8_t *size) {
+    uint16_t pos = (frame == 0) ? 0U : block->frame_ends[frame - 1U];
+    uint16_t end = block->frame_ends[frame];
+    const uint8_t *found = NULL;
+
+    while (pos < end) {
+        uint8_t sample_size = block->samples[pos + 2U];
+
+        if (data_fmt_arr_be_to_u16(&block->samples[pos]) == telem_id) {
+            found = &block->samples[pos + SAMPLE_HEADER_SIZE];
+            *size = sample_size;
+        }
+
+        pos += SAMPLE_HEADER_SIZE + sample_size;
+    }
+
+    return found;
+}
+
+/**
+ * @brief Check that no sample before a position has the same telem unit
+ */
+static bool is_first_sample(const telem_block_t *block, uint16_t pos, uint16_t telem_id) {
+    uint16_t i = 0;
+
+    while (i < pos) {
+        if (data_fmt_arr_be_to_u16(&block->samples[i]) == telem_id) {
+            return false;
+        }
+
+        i += SAMPLE_HEADER_SIZE + block->samples[i + 2U];
+    }
+
+    return true;
+}
+
+/**
+ * @brief Decode the epochs of the frames of an encoded block
+ *
+ * @return Position of num_columns, or 0 if the header is malformed
+ */
+static uint32_t decode_header(const uint8_t *buf, uint32_t size, int32_t epochs[TELEM_BLOCK_MAX_FRAMES], uint8_t *num_frames) {
+    if (size < 5U) {
+        return 0;
+    }
+
+    uint32_t pos = 5U;
+
+    *num_frames = buf[4];
+
+    if ((*num_frames == 0) || (*num_frames > TELEM_BLOCK_MAX_FRAMES)) {
+        return 0;
+    }
+
+    epochs[0] = (int32_t) data_fmt_arr_be_to_u32(buf);
+
+    for (uint8_t f = 1; f < *num_frames; f++) {
+        uint32_t zigzag = 0;
+        uint32_t used = log_block_varint_decode(&buf[pos], size - pos, &zigzag);
+
+        if (used == 0) {
+            return 0;
+        }
+
+        pos += used;
+
+        int32_t delta = (int32_t)((zigzag >> 1) ^ (0U - (zigzag & 1U)));
+        epochs[f] = (int32_t)((uint32_t) epochs[f - 1U] + (uint32_t) delta);
+    }
+
+    return pos;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file telem_block.h
+ * @brief Columnar, delta/XOR-encoded blocks of telem frames
+ *
+ * Block layout (multi-byte fields are big-endian):
+ *
+ *  | epoch (4) | num_frames (1) | epoch deltas | num_columns (1) | columns | len (2) | crc32 (4) | stop word (4) |
+ *
+ * - epoch:        epoch of the first frame
+ * - epoch deltas: zigzag varints (see log_block_varint_encode), the epoch of each following frame
+ *                 relative to the previous one
+ * - len:          number of bytes before len
+ * - crc32:        CRC32 (seeded with CRC32_SEED) of everything before it
+ * - stop word:    TELEM_BLOCK_STOP_WORD, blocks are found by reading backwards from the end of a file
+ *
+ * Each column holds the samples of one telem unit:
+ *
+ *  | telem_id (2) | size (1) | frame mask (ceil(num_frames / 8)) | first sample (size) | XOR samples |
+ *
+ * Bit f of the frame mask (MSB first) is set if the unit has a sample in frame f. Every sample after
+ * the first is XORed with the previous one, and only the non-zero bytes are kept:
+ *
+ *  | change mask (ceil(size / 8)) | non-zero bytes of the XOR |
+ *
+ * Bit i of the change mask (MSB first) is set if byte i changed.
+ */
+
+#ifndef TELEM_BLOCK_H_
+#define TELEM_BLOCK_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define TELEM_BLOCK_STOP_WORD           0xA1EA50BCUL // "ALEA OBC"
+#define TELEM_BLOCK_TRAILER_SIZE        (2U + 4U + 4U)
+#define TELEM_BLOCK_MIN_SIZE            (4U + 1U + 1U + TELEM_BLOCK_TRAILER_SIZE)
+
+/**
+ * @brief Maximum size of an encoded block, including the trailer
+ */
+#define TELEM_BLOCK_MAX_SIZE            512U
+
+/**
+ * @brief Maximum number of frames in a block
+ */
+#define TELEM_BLOCK_MAX_FRAMES          32U
+
+/**
+ * @brief Size of the buffer holding the samples of a block before it is encoded
+ */
+#define TELEM_BLOCK_SAMPLES_SIZE        1024U
+
+/**
+ * @brief Maximum size of a sample
+ */
+#define TELEM_BLOCK_MAX_SAMPLE_SIZE     UINT8_MAX
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Frames of a block before it is encoded
+ *
+ * The samples of the committed frames are followed by the samples of the frame being collected.
+ */
+typedef struct {
+    uint8_t samples[TELEM_BLOCK_SAMPLES_SIZE];      // | telem_id (2) | size (1) | sample (size) | for each sample
+    uint16_t samples_len;
+    uint16_t frame_ends[TELEM_BLOCK_MAX_FRAMES];    // End of the samples of each committed frame
+    int32_t epochs[TELEM_BLOCK_MAX_FRAMES];         // Epoch of each committed frame
+    uint8_t num_frames;                             // Number of committed frames
+} telem_block_t;
+
+/**
+ * @brief Decoding of the samples of an encoded block, one column at a time
+ */
+typedef struct {
+    const uint8_t *buf;
+    uint32_t end;                                   // End of the columns
+    uint32_t pos;                                   // Position of the next encoded sample or column
+    int32_t epochs[TELEM_BLOCK_MAX_FRAMES];
+    uint8_t num_frames;
+    uint8_t columns_left;                           // Number of columns after the current one
+    uint16_t telem_id;                              // Telem unit of the current column
+    uint8_t size;                                   // Size of the samples of the current column
+    const uint8_t *frame_mask;                      // Frame mask of the current column, NULL before the first column
+    uint8_t frame;                                  // Next frame of the current column
+    bool first;                                     // The next sample is the first of the current column
+    uint8_t sample[TELEM_BLOCK_MAX_SAMPLE_SIZE];    // Last sample decoded
+} telem_block_reader_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void telem_block_init(telem_block_t *block);
+bool telem_block_add(telem_block_t *block, uint16_t telem_id, const uint8_t *sample, uint8_t size);
+bool telem_block_end_frame(telem_block_t *block, int32_t epoch);
+void telem_block_drop_frames(telem_block_t *block, uint8_t count);
+bool telem_block_find_sample(const telem_block_t *block, uint16_t telem_id, int32_t epoch, uint8_t *sample, uint32_t size,
+                             int32_t *sample_epoch);
+
+uint32_t telem_block_encode(const telem_block_t *block, uint8_t num_frames, uint8_t *buf, uint32_t size);
+uint32_t telem_block_check(const uint8_t *buf, uint32_t end);
+bool telem_block_decode_sample(const uint8_t *buf, uint32_t size, uint16_t telem_id, int32_t epoch, uint8_t *sample, uint32_t sample_size,
+                               int32_t *sample_epoch);
+
+bool telem_block_reader_init(telem_block_reader_t *reader, const uint8_t *buf, uint32_t size);
+bool telem_block_reader_next(telem_block_reader_t *reader, int32_t *epoch);
+
+#endif /* TELEM_BLOCK_H_ */
@@ -24,12 +24,15 @@ typedef enum {
     TELEM_ERR_FLASH_WRITE            = 7,  ///< FS operations returned an error
     TELEM_ERR_FLASH_READ             = 8,  ///< FS operations returned an error
     TELEM_ERR_RTC_ERR                = 9,  ///< An error occured when trying to get current epoch from RTC
-    TELEM_ERR_FILE_SIZE              = 10, ///< Could not reset overflowing telemetry files
+    TELEM_ERR_FILE_SIZE              = 10, ///< Could not rotate a full telemetry file segment
     TELEM_ERR_ENTRY_DNE              = 11, ///< The telemetry entry searched for does not exist
     TELEM_ERR_GEN_HEADER             = 12, ///< Could not generate/write telem header (most likely RTC call failed)
     TELEM_ERR_QUEUE_MAGIC_NUM        = 13, ///< Failed to add outer header information to queue
     TELEM_ERR_SEARCH_TIMEOUT         = 14, ///< Search timeout
     TELEM_ERR_MRAM                   = 15, ///< If the mram errors out when trying to interact with it
+    TELEM_ERR_MUTEX_TIMEOUT          = 16, ///< A timeout occurred waiting for the telem index or telem blocks
+    TELEM_ERR_BLOCK_FULL             = 17, ///< A frame doesn't fit in a telem block
+    TELEM_ERR_OUTPUT_WRITE           = 18, ///< A timeout occurred writing the result of a query
 } telem_err_t;
 
 #endif // TELEM_ERROR_H_
@@ -39,7 +39,7 @@
 static void telem_exec_task(void *pvParameters);
 
 static void get_num_units(uint16_t *num_units_0, uint16_t *num_units_1, uint16_t *num_units_2);
-static void write_outer_headers_and_stop_word(uint16_t num_units_0, uint16_t num_units_1, uint16_t num_units_2);
+static void end_frames(uint16_t num_units_0, uint16_t num_units_1, uint16_t num_units_2);
 
 /******************************************************************************/
 /*               P R I V A T E  G L O B A L  V A R I A B L E S                */
@@ -99,7 +99,7 @@ static void telem_exec_task(void *pvParameters) {
                     uint16_t num_units_1 = 0;
                     uint16_t num_units_2 = 0;
                     get_num_units(&num_units_0, &num_units_1, &num_units_2);
-                    write_outer_headers_and_stop_word(num_units_0, num_units_1, num_units_2);
+                    end_frames(num_units_0, num_units_1, num_units_2);
 
                 } else {
 
@@ -133,24 +133,30 @@ static void get_num_units(uint16_t *num_units_0, uint16_t *num_units_1, uint16_t
 }
 
 /*
- * @brief Add the outer headers to write queue
+ * @brief End the frames of the priorities that had units collected
 */
-static void write_outer_headers_and_stop_word(uint16_t num_units_0, uint16_t num_units_1, uint16_t num_units_2) {
+static void end_frames(uint16_t num_units_0, uint16_t num_units_1, uint16_t num_units_2) {
     if (num_units_0) {
-        if (write_outer_header_and_stop_word(num_units_0, "telem_priority_0", 0) != TELEM_SUCCESS) {
-            LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_GEN_HEADER);
+        telem_err_t err = telem_end_frame(0);
+
+        if (err != TELEM_SUCCESS) {
+            LOG_TELEM__EXECUTION_FAILURE(err);
         }
     }
 
     if (num_units_1) {
-        if (write_outer_header_and_stop_word(num_units_1, "telem_priority_1", 1) != TELEM_SUCCESS) {
-            LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_GEN_HEADER);
+        telem_err_t err = telem_end_frame(1);
+
+        if (err != TELEM_SUCCESS) {
+            LOG_TELEM__EXECUTION_FAILURE(err);
         }
     }
 
     if (num_units_2) {
-        if (write_outer_header_and_stop_word(num_units_2, "telem_priority_2", 2) != TELEM_SUCCESS) {
-            LOG_TELEM__EXECUTION_FAILURE(TELEM_ERR_GEN_HEADER);
+        telem_err_t err = telem_end_frame(2);
+
+        if (err != TELEM_SUCCESS) {
+            LOG_TELEM__EXECUTION_FAILURE(err);
         }
     }
 }
@@ -0,0 +1,737 @@
+/**
+ * @file telem_index.c
+ * @brief Index of the latest value of each telem unit and of the blocks in the telem files
+ *
+ * A frame is the responses collected in one collection period. Frames are collected into telem
+ * blocks (see telem_block.h) before they are written. Two indexes are kept:
+ *
+ *  - The location (segment, block offset, epoch) of the latest value of each telem unit, with a copy
+ *    of the value in RAM. The locations are persisted in MRAM once the block of the value is written
+ *    so that after a reset the latest value of a unit is still found with a single read of the telem file.
+ *    The location includes the size of the block, so the read covers exactly the block.
+ *  - For each telem file segment, an index file (telem_N.idx for the head segment, see telem_store.c)
+ *    with one entry per telem block, holding the range of the block and the epochs of its frames. A
+ *    value at a given time is then found by reading the block that covers it instead of scanning the segment.
+ *
+ * Responses are added when they are collected, but they are only indexed once their frame ends since
+ * that is when the epoch of the frame is known. Their location is known once their block is written.
+ *
+ * MRAM layout of the location of a unit (at MRAM_TELEM_INDEX_ADDR + telem_id * TELEM_INDEX_MRAM_ENTRY_SIZE):
+ *
+ *      | offset (4) | seq (4) | epoch (4) | size (2) | len (2) | priority (1) | valid (1) | crc16 (2) |
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "telem_index.h"
+#include "telem_store.h"
+
+// OBC
+#include "obc_filesystem.h"
+#include "obc_mram.h"
+#include "obc_crc.h"
+
+// Utils
+#include "data_fmt.h"
+#include "obc_utils.h"
+
+// RTOS
+#include "rtos.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define TELEM_INDEX_MUTEX_TIMEOUT_MS    1000U
+
+#define MRAM_ENTRY_CRC_OFFSET           (TELEM_INDEX_MRAM_ENTRY_SIZE - sizeof(uint16_t))
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Range of a telem file and the epochs of the frames it contains
+ */
+typedef struct {
+    uint32_t offset;    // Offset of the first frame in the telem file
+    uint32_t size;      // Number of bytes of frames
+    epoch_t epoch_min;  // Earliest epoch of the frames
+    epoch_t epoch_max;  // Latest epoch of the frames
+} telem_index_block_t;
+
+/**
+ * @brief Indexed value of a telem unit
+ */
+typedef struct {
+    telem_index_loc_t loc;
+    bool valid;
+    bool cached;        // value holds the serialized response
+    bool written;       // The block of the value was written, loc.seq and loc.offset are known
+    uint32_t frame;     // Number of the frame of the value, counted by frames_added
+    uint8_t value[TELEM_MAX_RESP_SIZE];
+} telem_index_value_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static void persist_latest(telem_id_t telem_id);
+static telem_err_t block_write(uint8_t priority, const telem_index_block_t *block);
+static fs_err_t count_blocks(const char *filename, uint32_t *count, uint16_t mutex_timeout);
+static fs_err_t search_blocks(const char *filename, uint32_t count, epoch_t epoch, telem_index_block_t *found_block, bool *found,
+                              uint16_t mutex_timeout);
+static fs_err_t find_end(const char *filename, uint32_t count, epoch_t epoch, uint32_t file_size, uint32_t *end, uint16_t mutex_timeout);
+static fs_err_t read_blocks(const char *filename, uint32_t idx, telem_index_block_t *blocks, uint32_t count, uint16_t mutex_timeout);
+static fs_err_t truncate_index_file(const char *filename, uint32_t size, uint16_t mutex_timeout);
+static void block_encode(const telem_index_block_t *block, uint8_t buf[TELEM_INDEX_ENTRY_SIZE]);
+static void block_decode(telem_index_block_t *block, const uint8_t buf[TELEM_INDEX_ENTRY_SIZE]);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static SemaphoreHandle_t telem_index_mutex = NULL;
+
+// All of the following are only used with telem_index_mutex held
+
+static telem_index_value_t latest[TELEM_COUNT] = { 0 };
+
+// Values collected in a frame that hasn't ended yet
+static telem_index_value_t pending[TELEM_COUNT] = { 0 };
+
+// Number of frames of each priority that ended and that were written to a telem file since the last reset
+static uint32_t frames_added[TELEM_NUM_PRIORITIES] = { 0 };
+static uint32_t frames_written[TELEM_NUM_PRIORITIES] = { 0 };
+
+// Write ring handles of the index files of the head segments, interned on first use by telem_index_add_block
+static fs_handle_t index_file_handles[TELEM_NUM_PRIORITIES];
+static bool index_file_handles_valid[TELEM_NUM_PRIORITIES] = { false };
+
+CASSERT((MRAM_TELEM_INDEX_ADDR + TELEM_INDEX_MRAM_SIZE) <= MRAM_TELEM_SPOOL_ADDR, telem_index_mram_size);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+void telem_index_pre_init(void) {
+    static StaticSemaphore_t telem_index_mutex_buf;
+    telem_index_mutex = xSemaphoreCreateMutexStatic(&telem_index_mutex_buf);
+}
+
+/**
+ * @brief Load the locations of the latest values from MRAM
+ *
+ * WARNING: This is assuming mram_init() has been called already
+ */
+void telem_index_init(void) {
+    if (xSemaphoreTake(telem_index_mutex, pdMS_TO_TICKS(TELEM_INDEX_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return;
+    }
+
+    // Frames that weren't written before a reset are lost
+    memset(pending, 0, sizeof(pending));
+    memset(frames_added, 0, sizeof(frames_added));
+    memset(frames_written, 0, sizeof(frames_written));
+
+    for (uint32_t i = 0; i < TELEM_COUNT; i++) {
+        uint8_t buf[TELEM_INDEX_MRAM_ENTRY_SIZE];
+        telem_index_value_t *value = &latest[i];
+
+        memset(value, 0, sizeof(*value));
+
+        if (mram_read(MRAM_TELEM_INDEX_ADDR + (i * TELEM_INDEX_MRAM_ENTRY_SIZE), sizeof(buf), buf) != MRAM_OK) {
+            continue;
+        }
+
+        if (crc_16_buf(CRC16_SEED, buf, MRAM_ENTRY_CRC_OFFSET) != data_fmt_arr_be_to_u16(&buf[MRAM_ENTRY_CRC_OFFSET])) {
+            continue;
+        }
+
+        value->loc.offset   = data_fmt_arr_be_to_u32(&buf[0]);
+        value->loc.seq      = data_fmt_arr_be_to_u32(&buf[4]);
+        value->loc.epoch    = (epoch_t) data_fmt_arr_be_to_u32(&buf[8]);
+        value->loc.size     = data_fmt_arr_be_to_u16(&buf[12]);
+        value->loc.len      = data_fmt_arr_be_to_u16(&buf[14]);
+        value->loc.priority = buf[16];
+        value->valid        = (buf[17] != 0) && (value->loc.len == TELEM_SPEC_TABLE[i].resp_size) &&
+                              (value->loc.priority < TELEM_NUM_PRIORITIES);
+        value->written      = true;
+    }
+
+    xSemaphoreGive(telem_index_mutex);
+}
+
+/**
+ * @brief Add a response collected in the current frame of a priority. It is indexed once its frame ends.
+ *
+ * @param[in] telem_id  ID of the telem unit
+ * @param[in] priority  Telem file the response is written to
+ * @param[in] data      Serialized response
+ * @param[in] len       Size of the serialized response
+ */
+void telem_index_add_unit(telem_id_t telem_id, uint8_t priority, const uint8_t *data, uint16_t len) {
+    if ((telem_id >= TELEM_COUNT) || (len > TELEM_MAX_RESP_SIZE)) {
+        return;
+    }
+
+    if (xSemaphoreTake(telem_index_mutex, pdMS_TO_TICKS(TELEM_INDEX_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return;
+    }
+
+    telem_index_value_t *value = &pending[telem_id];
+
+    value->loc.len      = len;
+    value->loc.priority = priority;
+    value->valid        = true;
+    value->cached       = true;
+    value->written      = false;
+    memcpy(value->value, data, len);
+
+    xSemaphoreGive(telem_index_mutex);
+}
+
+/**
+ * @brief Index the responses of a frame once it ends
+ *
+ * The responses become the latest values of their units. Their location is only known (and persisted)
+ * once the block of the frame is written, see telem_index_add_block.
+ *
+ * @param[in] priority  Telem file of the frame
+ * @param[in] epoch     Epoch of the frame
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the index is busy
+ */
+telem_err_t telem_index_add_frame(uint8_t priority, epoch_t epoch) {
+    if (priority >= TELEM_NUM_PRIORITIES) {
+        return TELEM_ERR_DNE;
+    }
+
+    if (xSemaphoreTake(telem_index_mutex, pdMS_TO_TICKS(TELEM_INDEX_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
+
+    for (uint32_t i = 0; i < TELEM_COUNT; i++) {
+        telem_index_value_t *value = &pending[i];
+
+        if (!value->valid || (value->loc.priority != priority)) {
+            continue;
+        }
+
+        value->valid     = false;
+        value->loc.epoch = epoch;
+        value->frame     = frames_added[priority];
+        latest[i]        = *value;
+        latest[i].valid  = true;
+    }
+
+    frames_added[priority]++;
+
+    xSemaphoreGive(telem_index_mutex);
+
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Index a telem block once it has been written to the head segment of a telem file
+ *
+ * Blocks must be added in the order of their frames, since the latest values of the frames are
+ * located by counting frames.
+ *
+ * @param[in] priority    Telem file the block was written to
+ * @param[in] seq         Sequence number of the segment the block was written to (the head segment)
+ * @param[in] offset      Offset of the block in the segment
+ * @param[in] size        Size of the block
+ * @param[in] num_frames  Number of frames in the block (the oldest frames that haven't been written)
+ * @param[in] epoch_min   Earliest epoch of the frames
+ * @param[in] epoch_max   Latest epoch of the frames
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the index is busy
+ *            - TELEM_ERR_FLASH_WRITE if the block entry couldn't be queued for writing
+ */
+telem_err_t telem_index_add_block(uint8_t priority, uint32_t seq, uint32_t offset, uint32_t size, uint8_t num_frames, epoch_t epoch_min,
+                                  epoch_t epoch_max) {
+    if (priority >= TELEM_NUM_PRIORITIES) {
+        return TELEM_ERR_DNE;
+    }
+
+    if (!index_file_handles_valid[priority]) {
+        char filename[TELEM_STORE_NAME_MAX_SIZE];
+        telem_store_index_name(priority, seq, seq, filename);
+
+        index_file_handles_valid[priority] = (fs_get_handle(filename, &index_file_handles[priority], TELEM_INDEX_MUTEX_TIMEOUT_MS) == FS_OK);
+    }
+
+    if (xSemaphoreTake(telem_index_mutex, pdMS_TO_TICKS(TELEM_INDEX_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
+
+    frames_written[priority] += num_frames;
+
+    // The values of the frames of the block now have a location
+    for (uint32_t i = 0; i < TELEM_COUNT; i++) {
+        telem_index_value_t *value = &latest[i];
+
+        if (!value->valid || value->written || (value->loc.priority != priority) ||
+                ((frames_written[priority] - value->frame - 1U) >= num_frames)) {
+            continue;
+        }
+
+        value->loc.seq    = seq;
+        value->loc.offset = offset;
+        value->loc.size   = (uint16_t) size;
+        value->written    = true;
+        persist_latest((telem_id_t) i);
+    }
+
+    xSemaphoreGive(telem_index_mutex);
+
+    telem_index_block_t block = {
+        .offset    = offset,
+        .size      = size,
+        .epoch_min = epoch_min,
+        .epoch_max = epoch_max,
+    };
+
+    return block_write(priority, &block);
+}
+
+/**
+ * @brief Skip the oldest frames of a priority that haven't been written, after they were dropped
+ *
+ * The values of the frames keep their copy in RAM but are never persisted.
+ *
+ * @param[in] priority    Telem file of the frames
+ * @param[in] num_frames  Number of frames dropped
+ */
+void telem_index_drop_frames(uint8_t priority, uint8_t num_frames) {
+    if (priority >= TELEM_NUM_PRIORITIES) {
+        return;
+    }
+
+    if (xSemaphoreTake(telem_index_mutex, pdMS_TO_TICKS(TELEM_INDEX_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return;
+    }
+
+    frames_written[priority] += num_frames;
+
+    xSemaphoreGive(telem_index_mutex);
+}
+
+/**
+ * @brief Drop everything past the end of a telem file segment that was truncated
+ *
+ * @param[in] priority      Telem file
+ * @param[in] seq           Sequence number of the segment
+ * @param[in] head          Sequence number of the head segment of the priority
+ * @param[in] size          New size of the segment
+ * @param[in] mutex_timeout Timeout to wait for mutex to access flash
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the index is busy
+ *            - TELEM_ERR_FS_TIMEOUT if could not compete for filesystem mutex
+ *            - TELEM_ERR_FLASH_WRITE if the index file couldn't be truncated
+ */
+telem_err_t telem_index_truncate(uint8_t priority, uint32_t seq, uint32_t head, uint32_t size, uint16_t mutex_timeout) {
+    if (priority >= TELEM_NUM_PRIORITIES) {
+        return TELEM_ERR_DNE;
+    }
+
+    if (xSemaphoreTake(telem_index_mutex, pdMS_TO_TICKS(mutex_timeout)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
+
+    for (uint32_t i = 0; i < TELEM_COUNT; i++) {
+        if (latest[i].valid && latest[i].written && (latest[i].loc.priority == priority) && (latest[i].loc.seq == seq) &&
+                (latest[i].loc.offset >= size)) {
+            latest[i].valid = false;
+            persist_latest((telem_id_t) i);
+        }
+    }
+
+    xSemaphoreGive(telem_index_mutex);
+
+    char filename[TELEM_STORE_NAME_MAX_SIZE];
+    telem_store_index_name(priority, seq, head, filename);
+
+    fs_err_t err = truncate_index_file(filename, size, mutex_timeout);
+
+    if (err != FS_OK) {
+        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    }
+
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Get the latest value of a telem unit
+ *
+ * @param[in]  telem_id   ID of the telem unit
+ * @param[out] loc        Location of the value in the telem files
+ * @param[out] value      Buffer for the serialized response, at least as large as the response
+ * @param[out] cached     true if the value was copied to value, false if it has to be read from loc
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if the location of the latest value is known
+ *            - TELEM_ERR_ENTRY_DNE if it isn't
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the index is busy
+ */
+telem_err_t telem_index_get_latest(telem_id_t telem_id, telem_index_loc_t *loc, uint8_t *value, bool *cached) {
+    if (telem_id >= TELEM_COUNT) {
+        return TELEM_ERR_DNE;
+    }
+
+    if (xSemaphoreTake(telem_index_mutex, pdMS_TO_TICKS(TELEM_INDEX_MUTEX_TIMEOUT_MS)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
+
+    const telem_index_value_t *entry = &latest[telem_id];
+    telem_err_t err = TELEM_ERR_ENTRY_DNE;
+
+    if (entry->valid) {
+        *loc    = entry->loc;
+        *cached = entry->cached;
+
+        if (entry->cached) {
+            memcpy(value, entry->value, entry->loc.len);
+        }
+
+        err = TELEM_SUCCESS;
+    }
+
+    xSemaphoreGive(telem_index_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Find where to start searching backwards for the values collected at or before an epoch
+ *
+ * Block entries are assumed to be in increasing order of epoch, which holds unless the RTC is set
+ * back. Only the index file of the segment is read, with a binary search over batches of its entries.
+ *
+ * @param[in]  priority       Telem file
+ * @param[in]  seq            Sequence number of the segment
+ * @param[in]  head           Sequence number of the head segment of the priority
+ * @param[in]  epoch          Epoch to search for
+ * @param[in]  file_size      Size of the segment
+ * @param[out] end            End of the last block that has frames at or before epoch. Frames
+ *                            before end may be at or before epoch, frames after it are not.
+ * @param[in]  mutex_timeout  Timeout to wait for mutex to access flash
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the index is busy
+ *            - TELEM_ERR_FS_TIMEOUT if could not compete for filesystem mutex
+ *            - TELEM_ERR_FLASH_READ if the index file couldn't be read
+ */
+telem_err_t telem_index_find_block(uint8_t priority, uint32_t seq, uint32_t head, epoch_t epoch, uint32_t file_size, uint32_t *end,
+                                   uint16_t mutex_timeout) {
+    if (priority >= TELEM_NUM_PRIORITIES) {
+        return TELEM_ERR_DNE;
+    }
+
+    char filename[TELEM_STORE_NAME_MAX_SIZE];
+    telem_store_index_name(priority, seq, head, filename);
+
+    uint32_t count = 0;
+    fs_err_t err = count_blocks(filename, &count, mutex_timeout);
+
+    if (err == FS_OK) {
+        err = find_end(filename, count, epoch, file_size, end, mutex_timeout);
+    }
+
+    if (err != FS_OK) {
+        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
+    }
+
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Find the part of a segment that holds the values collected in a range of epochs
+ *
+ * Like telem_index_find_block, block entries are assumed to be in increasing order of epoch.
+ *
+ * @param[in]  priority       Telem file
+ * @param[in]  seq            Sequence number of the segment
+ * @param[in]  head           Sequence number of the head segment of the priority
+ * @param[in]  epoch_start    Start of the range (inclusive)
+ * @param[in]  epoch_end      End of the range (inclusive)
+ * @param[in]  file_size      Size of the segment
+ * @param[out] start          Start of the first block that may have frames in the range
+ * @param[out] end            End of the last block that may have frames in the range (start if there
+ *                            are none)
+ * @param[in]  mutex_timeout  Timeout to wait for mutex to access flash
+ *
+ * @return Status code: see telem_index_find_block
+ */
+telem_err_t telem_index_find_range(uint8_t priority, uint32_t seq, uint32_t head, epoch_t epoch_start, epoch_t epoch_end, uint32_t file_size,
+                                   uint32_t *start, uint32_t *end, uint16_t mutex_timeout) {
+    if (priority >= TELEM_NUM_PRIORITIES) {
+        return TELEM_ERR_DNE;
+    }
+
+    char filename[TELEM_STORE_NAME_MAX_SIZE];
+    telem_store_index_name(priority, seq, head, filename);
+
+    uint32_t count = 0;
+    fs_err_t err = count_blocks(filename, &count, mutex_timeout);
+
+    if (err == FS_OK) {
+        err = find_end(filename, count, epoch_end, file_size, end, mutex_timeout);
+    }
+
+    *start = 0;
+
+    telem_index_block_t found_block = { 0 };
+    bool found = false;
+
+    // The blocks before the last one that starts at or before epoch_start end at or before it
+    if ((err == FS_OK) && (*end > 0)) {
+        err = search_blocks(filename, count, epoch_start, &found_block, &found, mutex_timeout);
+    }
+
+    if (err != FS_OK) {
+        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
+    }
+
+    if (found) {
+        *start = (found_block.epoch_max < epoch_start) ? (found_block.offset + found_block.size) : found_block.offset;
+        *start = MIN(*start, *end);
+    }
+
+    return TELEM_SUCCESS;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Write the location of the latest value of a telem unit to MRAM
+ *
+ * If the write fails, the location is still kept in RAM until the next reset.
+ */
+static void persist_latest(telem_id_t telem_id) {
+    const telem_index_value_t *value = &latest[telem_id];
+    uint8_t buf[TELEM_INDEX_MRAM_ENTRY_SIZE];
+
+    data_fmt_u32_to_arr_be(value->loc.offset, &buf[0]);
+    data_fmt_u32_to_arr_be(value->loc.seq, &buf[4]);
+    data_fmt_u32_to_arr_be((uint32_t) value->loc.epoch, &buf[8]);
+    data_fmt_u16_to_arr_be(value->loc.size, &buf[12]);
+    data_fmt_u16_to_arr_be(value->loc.len, &buf[14]);
+    buf[16] = value->loc.priority;
+    buf[17] = value->valid ? 1U : 0U;
+    data_fmt_u16_to_arr_be(crc_16_buf(CRC16_SEED, buf, MRAM_ENTRY_CRC_OFFSET), &buf[MRAM_ENTRY_CRC_OFFSET]);
+
+    mram_write(MRAM_TELEM_INDEX_ADDR + (telem_id * TELEM_INDEX_MRAM_ENTRY_SIZE), sizeof(buf), buf);
+}
+
+/**
+ * @brief Queue the entry of a block of the head segment of a priority for writing
+ */
+static telem_err_t block_write(uint8_t priority, const telem_index_block_t *block) {
+    uint8_t buf[TELEM_INDEX_ENTRY_SIZE];
+
+    block_encode(block, buf);
+
+    if (!index_file_handles_valid[priority] || (fs_write_enqueue(index_file_handles[priority], buf, sizeof(buf)) != FS_OK)) {
+        return TELEM_ERR_FLASH_WRITE;
+    }
+
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Get the number of entries of an index file (0 if it doesn't exist)
+ */
+static fs_err_t count_blocks(const char *filename, uint32_t *count, uint16_t mutex_timeout) {
+    fs_entry_info_t info;
+    fs_err_t err = fs_stat(filename, &info, mutex_timeout);
+
+    *count = 0;
+
+    if (err == FS_NOENT_ERR) {
+        return FS_OK;
+    }
+
+    if (err == FS_OK) {
+        *count = info.size / TELEM_INDEX_ENTRY_SIZE;
+    }
+
+    return err;
+}
+
+/**
+ * @brief Find the last entry of an index file whose first frame is at or before an epoch, reading a
+ * batch of entries per step of a binary search
+ */
+static fs_err_t search_blocks(const char *filename, uint32_t count, epoch_t epoch, telem_index_block_t *found_block, bool *found,
+                              uint16_t mutex_timeout) {
+    telem_index_block_t blocks[TELEM_INDEX_SEARCH_BATCH];
+    uint32_t lo = 0;
+    uint32_t hi = count;
+
+    *found = false;
+
+    while (lo < hi) {
+        uint32_t mid = lo + ((hi - lo) / 2U);
+        uint32_t n = MIN(TELEM_INDEX_SEARCH_BATCH, hi - mid);
+
+        fs_err_t err = read_blocks(filename, mid, blocks, n, mutex_timeout);
+
+        if (err != FS_OK) {
+            return err;
+        }
+
+        uint32_t i = 0;
+
+        while ((i < n) && (blocks[i].epoch_min <= epoch)) {
+            i++;
+        }
+
+        if (i == 0) {
+            hi = mid;
+            continue;
+        }
+
+        *found_block = blocks[i - 1U];
+        *found       = true;
+
+        if (i < n) {
+            break;
+        }
+
+        lo = mid + n;
+    }
+
+    return FS_OK;
+}
+
+/**
+ * @brief Find the end of the last block of a segment that has frames at or before an epoch
+ *
+ * Without entries (e.g. the index file was lost) the whole segment has to be searched.
+ */
+static fs_err_t find_end(const char *filename, uint32_t count, epoch_t epoch, uint32_t file_size, uint32_t *end, uint16_t mutex_timeout) {
+    telem_index_block_t found_block = { 0 };
+    bool found = false;
+    fs_err_t err = search_blocks(filename, count, epoch, &found_block, &found, mutex_timeout);
+
+    *end = file_size;
+
+    if ((err == FS_OK) && found) {
+        *end = MIN(found_block.offset + found_block.size, file_size);
+    } else if ((err == FS_OK) && (count > 0)) {
+        // Only blocks written before the index (if any) can be at or before epoch
+        err = read_blocks(filename, 0, &found_block, 1, mutex_timeout);
+
+        if (err == FS_OK) {
+            *end = MIN(found_block.offset, file_size);
+        }
+    }
+
+    return err;
+}
+
+/**
+ * @brief Read consecutive entries from an index file
+ */
+static fs_err_t read_blocks(const char *filename, uint32_t idx, telem_index_block_t *blocks, uint32_t count, uint16_t mutex_timeout) {
+    uint8_t buf[TELEM_INDEX_SEARCH_BATCH * TELEM_INDEX_ENTRY_SIZE];
+    uint32_t size = MIN(count, TELEM_INDEX_SEARCH_BATCH) * TELEM_INDEX_ENTRY_SIZE;
+    uint32_t bytes_read = 0;
+
+    fs_err_t err = fs_read_at(filename, idx * TELEM_INDEX_ENTRY_SIZE, buf, size, &bytes_read, mutex_timeout);
+
+    if ((err == FS_OK) && (bytes_read != size)) {
+        err = FS_INVAL_ERR;
+    }
+
+    for (uint32_t i = 0; (err == FS_OK) && (i < (size / TELEM_INDEX_ENTRY_SIZE)); i++) {
+        block_decode(&blocks[i], &buf[i * TELEM_INDEX_ENTRY_SIZE]);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Remove the entries of blocks that extend past the end of a truncated telem file segment
+ *
+ * Entries are in file order, so only the last few need to be looked at after a downlink.
+ */
+static fs_err_t truncate_index_file(const char *filename, uint32_t size, uint16_t mutex_timeout) {
+    // Entries still in the write ring would otherwise be appended after the truncation
+    fs_err_t err = fs_flush(mutex_timeout);
+
+    if (err != FS_OK) {
+        return err;
+    }
+
+    lfs_file_t file = { 0 };
+    err = fs_open(&file, filename, mutex_timeout);
+
+    if (err != FS_OK) {
+        return err;
+    }
+
+    int32_t file_size = fs_size(&file);
+    uint32_t count = (file_size > 0) ? ((uint32_t) file_size / TELEM_INDEX_ENTRY_SIZE) : 0U;
+
+    while ((err == FS_OK) && (count > 0)) {
+        uint8_t buf[TELEM_INDEX_ENTRY_SIZE];
+        telem_index_block_t block;
+
+        err = fs_seek(&file, (int32_t)((count - 1U) * TELEM_INDEX_ENTRY_SIZE), FS_SEEK_START);
+
+        if (err == FS_OK) {
+            err = fs_read(&file, buf, sizeof(buf));
+        }
+
+        if (err != FS_OK) {
+            break;
+        }
+
+        block_decode(&block, buf);
+
+        if ((block.offset + block.size) <= size) {
+            break;
+        }
+
+        count--;
+    }
+
+    if ((err == FS_OK) && ((count * TELEM_INDEX_ENTRY_SIZE) != (uint32_t) file_size)) {
+        err = fs_truncate(&file, (int32_t)(count * TELEM_INDEX_ENTRY_SIZE));
+    }
+
+    fs_err_t close_err = fs_close(&file);
+
+    return (err != FS_OK) ? err : close_err;
+}
+
+static void block_encode(const telem_index_block_t *block, uint8_t buf[TELEM_INDEX_ENTRY_SIZE]) {
+    data_fmt_u32_to_arr_be(block->offset, &buf[0]);
+    data_fmt_u32_to_arr_be(block->size, &buf[4]);
+    data_fmt_u32_to_arr_be((uint32_t) block->epoch_min, &buf[8]);
+    data_fmt_u32_to_arr_be((uint32_t) block->epoch_max, &buf[12]);
+}
+
+static void block_decode(telem_index_block_t *block, const uint8_t buf[TELEM_INDEX_ENTRY_SIZE]) {
+    block->offset    = data_fmt_arr_be_to_u32(&buf[0]);
+    block->size      = data_fmt_arr_be_to_u32(&buf[4]);
+    block->epoch_min = (epoch_t) data_fmt_arr_be_to_u32(&buf[8]);
+    block->epoch_max = (epoch_t) data_fmt_arr_be_to_u32(&buf[12]);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file telem_index.h
+ * @brief Index of the latest value of each telem unit and of the blocks in the telem files
+ */
+
+#ifndef TELEM_INDEX_H_
+#define TELEM_INDEX_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "telem.h"
+#include "telem_error.h"
+#include "telem_gen.h"
+
+// Utils
+#include "obc_time.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/**
+ * @brief Size of a serialized block entry in an index file
+ */
+#define TELEM_INDEX_ENTRY_SIZE          16U
+
+/**
+ * @brief Number of entries read from an index file at a time when searching it
+ */
+#define TELEM_INDEX_SEARCH_BATCH        8U
+
+/**
+ * @brief Size of the location of the latest value of a telem unit in MRAM
+ */
+#define TELEM_INDEX_MRAM_ENTRY_SIZE     20U
+#define TELEM_INDEX_MRAM_SIZE           (TELEM_COUNT * TELEM_INDEX_MRAM_ENTRY_SIZE)
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Location of a value in the telem files
+ */
+typedef struct {
+    uint32_t offset;    // Offset of the telem block holding the value in the telem file segment
+    uint32_t seq;       // Sequence number of the telem file segment (see telem_store.h)
+    epoch_t epoch;      // Epoch of the frame the value was collected in
+    uint16_t size;      // Size of the telem block holding the value
+    uint16_t len;       // Size of the serialized response
+    uint8_t priority;   // Telem file the value was written to
+} telem_index_loc_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void telem_index_pre_init(void);
+void telem_index_init(void);
+
+void telem_index_add_unit(telem_id_t telem_id, uint8_t priority, const uint8_t *data, uint16_t len);
+telem_err_t telem_index_add_frame(uint8_t priority, epoch_t epoch);
+telem_err_t telem_index_add_block(uint8_t priority, uint32_t seq, uint32_t offset, uint32_t size, uint8_t num_frames, epoch_t epoch_min,
+                                  epoch_t epoch_max);
+void telem_index_drop_frames(uint8_t priority, uint8_t num_frames);
+telem_err_t telem_index_truncate(uint8_t priority, uint32_t seq, uint32_t head, uint32_t size, uint16_t mutex_timeout);
+
+telem_err_t telem_index_get_latest(telem_id_t telem_id, telem_index_loc_t *loc, uint8_t *value, bool *cached);
+telem_err_t telem_index_find_block(uint8_t priority, uint32_t seq, uint32_t head, epoch_t epoch, uint32_t file_size, uint32_t *end,
+                                   uint16_t mutex_timeout);
+telem_err_t telem_index_find_range(uint8_t priority, uint32_t seq, uint32_t head, epoch_t epoch_start, epoch_t epoch_end, uint32_t file_size,
+                                   uint32_t *start, uint32_t *end, uint16_t mutex_timeout);
+
+#endif // TELEM_INDEX_H_
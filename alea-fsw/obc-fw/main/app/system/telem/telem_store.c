@@ -0,0 +1,522 @@
+/**
+ * @file telem_store.c
+ * @brief Segmented circular store of the telem files
+ *
+ * The telem data of each priority is split into segments of a fixed size, numbered with a sequence
+ * number that only ever increases. Only the newest segment (the head) is written to. Once it
+ * reaches the segment size at the end of a frame, it is sealed and a new head is started. When that
+ * makes the number of segments exceed the limit of the priority, the oldest segment (the tail) is
+ * removed. Retention then degrades one segment at a time instead of a whole file at once.
+ *
+ * The head keeps the name of the original telem file (telem_priority_N) and its index file
+ * (telem_N.idx), so that their write ring handles stay valid. Sealing renames them to
+ * telem_priority_N.<seq> and telem_N.<seq>.idx.
+ *
+ * The tail and head of each priority are persisted in a manifest file (multi-byte fields are
+ * big-endian):
+ *
+ *      | magic (4) | { tail (4) | head (4) } x TELEM_NUM_PRIORITIES | crc32 (4) |
+ *
+ * If the manifest can't be read, it is rebuilt from the names of the sealed segments. A reset in
+ * the middle of a rotation is completed when the manifest is loaded.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "telem_store.h"
+
+// OBC
+#include "obc_filesystem.h"
+#include "obc_crc.h"
+
+// Utils
+#include "data_fmt.h"
+#include "obc_utils.h"
+#include "printf.h"
+
+// RTOS
+#include "rtos.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define TELEM_STORE_MAGIC           0x544D414EUL // "TMAN"
+
+#define MANIFEST_CRC_OFFSET         (TELEM_STORE_MANIFEST_SIZE - sizeof(uint32_t))
+
+#define SEGMENT_NAME_PREFIX         "telem_priority_"
+
+#define LIST_BATCH_SIZE             4U
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static telem_err_t load(uint16_t mutex_timeout);
+static bool read_manifest(uint16_t mutex_timeout);
+static fs_err_t write_manifest(uint16_t mutex_timeout);
+static fs_err_t rebuild_from_segments(uint16_t mutex_timeout);
+static bool parse_segment_name(const char *name, uint8_t *priority, uint32_t *seq);
+static bool segment_exists(uint8_t priority, uint32_t seq, uint32_t head, uint16_t mutex_timeout);
+static void remove_segment(uint8_t priority, uint32_t seq, uint32_t head, uint16_t mutex_timeout);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static const uint32_t telem_max_sizes[TELEM_NUM_PRIORITIES] = {
+    TELEM_PRIORITY_0_MAX_FILE_SIZE,
+    TELEM_PRIORITY_1_MAX_FILE_SIZE,
+    TELEM_PRIORITY_2_MAX_FILE_SIZE,
+};
+
+static const uint32_t telem_num_segments[TELEM_NUM_PRIORITIES] = {
+    TELEM_PRIORITY_0_SEGMENTS,
+    TELEM_PRIORITY_1_SEGMENTS,
+    TELEM_PRIORITY_2_SEGMENTS,
+};
+
+static SemaphoreHandle_t telem_store_mutex = NULL;
+
+// All of the following are only used with telem_store_mutex held
+
+static bool loaded = false;
+
+// Sequence numbers of the oldest and newest segment of each priority
+static uint32_t tails[TELEM_NUM_PRIORITIES] = { 0 };
+static uint32_t heads[TELEM_NUM_PRIORITIES] = { 0 };
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+void telem_store_pre_init(void) {
+    static StaticSemaphore_t telem_store_mutex_buf;
+    telem_store_mutex = xSemaphoreCreateMutexStatic(&telem_store_mutex_buf);
+}
+
+/**
+ * @brief Get the sequence numbers of the oldest and newest segment of a priority
+ *
+ * The manifest is loaded on first use.
+ *
+ * @param[in]  priority       Priority level
+ * @param[out] tail           Sequence number of the oldest segment
+ * @param[out] head           Sequence number of the newest segment, the one being written to
+ * @param[in]  mutex_timeout  Timeout to wait for mutex to access flash
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the store is busy
+ *            - TELEM_ERR_FS_TIMEOUT if could not compete for filesystem mutex
+ *            - TELEM_ERR_FLASH_READ if the manifest couldn't be loaded or rebuilt
+ */
+telem_err_t telem_store_get_range(uint8_t priority, uint32_t *tail, uint32_t *head, uint16_t mutex_timeout) {
+    if (priority >= TELEM_NUM_PRIORITIES) {
+        return TELEM_ERR_DNE;
+    }
+
+    if (xSemaphoreTake(telem_store_mutex, pdMS_TO_TICKS(mutex_timeout)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
+
+    telem_err_t err = load(mutex_timeout);
+
+    *tail = tails[priority];
+    *head = heads[priority];
+
+    xSemaphoreGive(telem_store_mutex);
+
+    return err;
+}
+
+/**
+ * @brief Get the total size of the segments of a priority, as of the last flush
+ *
+ * @param[in]  priority       Priority level
+ * @param[out] size           Total size in bytes
+ * @param[in]  mutex_timeout  Timeout to wait for mutex to access flash
+ *
+ * @return Status code: see telem_store_get_range, or TELEM_ERR_FLASH_READ if a segment couldn't be read
+ */
+telem_err_t telem_store_get_size(uint8_t priority, uint32_t *size, uint16_t mutex_timeout) {
+    uint32_t tail;
+    uint32_t head;
+    telem_err_t err = telem_store_get_range(priority, &tail, &head, mutex_timeout);
+
+    if (err != TELEM_SUCCESS) {
+        return err;
+    }
+
+    *size = 0;
+
+    for (uint32_t seq = tail; seq <= head; seq++) {
+        char name[TELEM_STORE_NAME_MAX_SIZE];
+        telem_store_segment_name(priority, seq, head, name);
+
+        fs_entry_info_t info;
+        fs_err_t fs_err = fs_stat(name, &info, mutex_timeout);
+
+        if (fs_err == FS_OK) {
+            *size += info.size;
+        } else if (fs_err != FS_NOENT_ERR) {
+            return (fs_err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
+        }
+    }
+
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Get the size at which the head segment of a priority is sealed
+ */
+uint32_t telem_store_segment_size(uint8_t priority) {
+    uint8_t idx = MIN(priority, TELEM_NUM_PRIORITIES - 1U);
+    return telem_max_sizes[idx] / telem_num_segments[idx];
+}
+
+/**
+ * @brief Get the name of a segment
+ *
+ * @param[in]  priority   Priority level
+ * @param[in]  seq        Sequence number of the segment
+ * @param[in]  head       Sequence number of the head segment of the priority
+ * @param[out] name       Name of the segment
+ */
+void telem_store_segment_name(uint8_t priority, uint32_t seq, uint32_t head, char name[TELEM_STORE_NAME_MAX_SIZE]) {
+    if (seq == head) {
+        snprintf(name, TELEM_STORE_NAME_MAX_SIZE, SEGMENT_NAME_PREFIX "%u", (unsigned int) priority);
+    } else {
+        snprintf(name, TELEM_STORE_NAME_MAX_SIZE, SEGMENT_NAME_PREFIX "%u.%lu", (unsigned int) priority, (unsigned long) seq);
+    }
+}
+
+/**
+ * @brief Get the name of the index file of a segment (see telem_index.c)
+ *
+ * @param[in]  priority   Priority level
+ * @param[in]  seq        Sequence number of the segment
+ * @param[in]  head       Sequence number of the head segment of the priority
+ * @param[out] name       Name of the index file
+ */
+void telem_store_index_name(uint8_t priority, uint32_t seq, uint32_t head, char name[TELEM_STORE_NAME_MAX_SIZE]) {
+    if (seq == head) {
+        snprintf(name, TELEM_STORE_NAME_MAX_SIZE, "telem_%u.idx", (unsigned int) priority);
+    } else {
+        snprintf(name, TELEM_STORE_NAME_MAX_SIZE, "telem_%u.%lu.idx", (unsigned int) priority, (unsigned long) seq);
+    }
+}
+
+/**
+ * @brief Seal the head segment of a priority and start a new one, evicting the oldest segment if
+ * the priority is at its limit
+ *
+ * Must be called at the end of a frame, from the task that writes the telem files. The write ring
+ * is flushed first so that the sealed segment and its index file are complete.
+ *
+ * @param[in] priority       Priority level
+ * @param[in] mutex_timeout  Timeout to wait for mutex to access flash
+ *
+ * @return Status code:
+ *            - TELEM_SUCCESS if successful
+ *            - TELEM_ERR_MUTEX_TIMEOUT if the store is busy
+ *            - TELEM_ERR_FS_TIMEOUT if could not compete for filesystem mutex
+ *            - TELEM_ERR_FLASH_WRITE if the segment couldn't be sealed
+ */
+telem_err_t telem_store_rotate(uint8_t priority, uint16_t mutex_timeout) {
+    if (priority >= TELEM_NUM_PRIORITIES) {
+        return TELEM_ERR_DNE;
+    }
+
+    fs_err_t fs_err = fs_flush(mutex_timeout);
+
+    if (fs_err != FS_OK) {
+        return (fs_err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    }
+
+    if (xSemaphoreTake(telem_store_mutex, pdMS_TO_TICKS(mutex_timeout)) != pdTRUE) {
+        return TELEM_ERR_MUTEX_TIMEOUT;
+    }
+
+    telem_err_t err = load(mutex_timeout);
+
+    if (err != TELEM_SUCCESS) {
+        xSemaphoreGive(telem_store_mutex);
+        return err;
+    }
+
+    uint32_t seq = heads[priority];
+    char head_name[TELEM_STORE_NAME_MAX_SIZE];
+    char sealed_name[TELEM_STORE_NAME_MAX_SIZE];
+
+    // Seal the index file first: after a reset, a sealed segment without an index file is only
+    // slower to search, while an index file left at the head name would describe the wrong segment.
+    telem_store_index_name(priority, seq, seq, head_name);
+    telem_store_index_name(priority, seq, seq + 1U, sealed_name);
+    fs_err = fs_rename(head_name, sealed_name, mutex_timeout);
+
+    if ((fs_err == FS_OK) || (fs_err == FS_NOENT_ERR)) {
+        telem_store_segment_name(priority, seq, seq, head_name);
+        telem_store_segment_name(priority, seq, seq + 1U, sealed_name);
+        fs_err = fs_rename(head_name, sealed_name, mutex_timeout);
+    }
+
+    if (fs_err != FS_OK) {
+        xSemaphoreGive(telem_store_mutex);
+        return (fs_err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    }
+
+    heads[priority] = seq + 1U;
+
+    uint32_t evict_start = tails[priority];
+
+    if ((heads[priority] - tails[priority]) >= telem_num_segments[priority]) {
+        tails[priority] = heads[priority] - (telem_num_segments[priority] - 1U);
+    }
+
+    // The evicted segments are removed after the manifest is updated so that a reset in between
+    // leaves files before the tail, which are removed when the manifest is loaded
+    fs_err = write_manifest(mutex_timeout);
+
+    for (uint32_t evict = evict_start; evict < tails[priority]; evict++) {
+        remove_segment(priority, evict, heads[priority], mutex_timeout);
+    }
+
+    xSemaphoreGive(telem_store_mutex);
+
+    if (fs_err != FS_OK) {
+        return (fs_err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    }
+
+    return TELEM_SUCCESS;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Load the manifest if it hasn't been loaded yet, and finish a rotation interrupted by a reset
+ *
+ * Must be called with telem_store_mutex held.
+ */
+static telem_err_t load(uint16_t mutex_timeout) {
+    if (loaded) {
+        return TELEM_SUCCESS;
+    }
+
+    bool changed = false;
+    fs_err_t err = FS_OK;
+
+    if (!read_manifest(mutex_timeout)) {
+        err = rebuild_from_segments(mutex_timeout);
+
+        if (err != FS_OK) {
+            return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_READ;
+        }
+
+        changed = true;
+    }
+
+    for (uint8_t prio = 0; prio < TELEM_NUM_PRIORITIES; prio++) {
+        // The head was sealed but the manifest wasn't updated
+        while (segment_exists(prio, heads[prio], heads[prio] + 1U, mutex_timeout)) {
+            heads[prio]++;
+            changed = true;
+        }
+
+        if ((heads[prio] - tails[prio]) >= telem_num_segments[prio]) {
+            tails[prio] = heads[prio] - (telem_num_segments[prio] - 1U);
+            changed = true;
+        }
+
+        // Segments evicted from the manifest but not removed yet
+        for (uint32_t seq = tails[prio]; (seq > 0) && segment_exists(prio, seq - 1U, heads[prio], mutex_timeout); seq--) {
+            remove_segment(prio, seq - 1U, heads[prio], mutex_timeout);
+        }
+    }
+
+    if (changed) {
+        err = write_manifest(mutex_timeout);
+    }
+
+    if (err != FS_OK) {
+        return (err == FS_MUTEX_TIMEOUT) ? TELEM_ERR_FS_TIMEOUT : TELEM_ERR_FLASH_WRITE;
+    }
+
+    loaded = true;
+    return TELEM_SUCCESS;
+}
+
+/**
+ * @brief Read the manifest into tails and heads
+ *
+ * @return true if the manifest is valid, false otherwise
+ */
+static bool read_manifest(uint16_t mutex_timeout) {
+    uint8_t buf[TELEM_STORE_MANIFEST_SIZE];
+    uint32_t bytes_read = 0;
+
+    if (fs_read_at(TELEM_STORE_MANIFEST_FILENAME, 0, buf, sizeof(buf), &bytes_read, mutex_timeout) != FS_OK) {
+        return false;
+    }
+
+    if ((bytes_read != sizeof(buf)) || (data_fmt_arr_be_to_u32(&buf[0]) != TELEM_STORE_MAGIC) ||
+            (data_fmt_arr_be_to_u32(&buf[MANIFEST_CRC_OFFSET]) != crc_32_buf(CRC32_SEED, buf, MANIFEST_CRC_OFFSET))) {
+        return false;
+    }
+
+    for (uint8_t prio = 0; prio < TELEM_NUM_PRIORITIES; prio++) {
+        uint32_t tail = data_fmt_arr_be_to_u32(&buf[4U + (prio * 8U)]);
+        uint32_t head = data_fmt_arr_be_to_u32(&buf[8U + (prio * 8U)]);
+
+        if (tail > head) {
+            return false;
+        }
+
+        tails[prio] = tail;
+        heads[prio] = head;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Write tails and heads to the manifest
+ *
+ * The file is rewritten in a single open, which LFS commits atomically when it is closed.
+ */
+static fs_err_t write_manifest(uint16_t mutex_timeout) {
+    uint8_t buf[TELEM_STORE_MANIFEST_SIZE];
+
+    data_fmt_u32_to_arr_be(TELEM_STORE_MAGIC, &buf[0]);
+
+    for (uint8_t prio = 0; prio < TELEM_NUM_PRIORITIES; prio++) {
+        data_fmt_u32_to_arr_be(tails[prio], &buf[4U + (prio * 8U)]);
+        data_fmt_u32_to_arr_be(heads[prio], &buf[8U + (prio * 8U)]);
+    }
+
+    data_fmt_u32_to_arr_be(crc_32_buf(CRC32_SEED, buf, MANIFEST_CRC_OFFSET), &buf[MANIFEST_CRC_OFFSET]);
+
+    lfs_file_t file = { 0 };
+    fs_err_t err = fs_open(&file, TELEM_STORE_MANIFEST_FILENAME, mutex_timeout);
+
+    if (err != FS_OK) {
+        return err;
+    }
+
+    err = fs_zero(&file);
+
+    if (err == FS_OK) {
+        err = fs_write(&file, buf, sizeof(buf));
+    }
+
+    fs_err_t close_err = fs_close(&file);
+
+    return (err != FS_OK) ? err : close_err;
+}
+
+/**
+ * @brief Rebuild tails and heads from the names of the sealed segments in the root directory
+ *
+ * The head follows the newest sealed segment, so a priority without sealed segments starts at 0.
+ */
+static fs_err_t rebuild_from_segments(uint16_t mutex_timeout) {
+    bool found[TELEM_NUM_PRIORITIES] = { false };
+    fs_entry_info_t entries[LIST_BATCH_SIZE];
+    uint16_t start = 0;
+    uint16_t count = 0;
+    uint16_t total = 0;
+
+    memset(tails, 0, sizeof(tails));
+    memset(heads, 0, sizeof(heads));
+
+    do {
+        fs_err_t err = fs_list("/", start, entries, LIST_BATCH_SIZE, &count, &total, mutex_timeout);
+
+        if (err != FS_OK) {
+            return err;
+        }
+
+        for (uint16_t i = 0; i < count; i++) {
+            uint8_t prio;
+            uint32_t seq;
+
+            if ((entries[i].type != FS_TYPE_FILE) || !parse_segment_name(entries[i].name, &prio, &seq)) {
+                continue;
+            }
+
+            if (!found[prio] || (seq < tails[prio])) {
+                tails[prio] = seq;
+            }
+
+            if (!found[prio] || (seq >= heads[prio])) {
+                heads[prio] = seq + 1U;
+            }
+
+            found[prio] = true;
+        }
+
+        start += count;
+    } while ((count > 0) && (start < total));
+
+    return FS_OK;
+}
+
+/**
+ * @brief Parse the name of a sealed segment (telem_priority_<priority>.<seq>)
+ */
+static bool parse_segment_name(const char *name, uint8_t *priority, uint32_t *seq) {
+    const size_t prefix_len = sizeof(SEGMENT_NAME_PREFIX) - 1U;
+
+    if (strncmp(name, SEGMENT_NAME_PREFIX, prefix_len) != 0) {
+        return false;
+    }
+
+    name += prefix_len;
+
+    if ((name[0] < '0') || (name[0] >= ('0' + (char) TELEM_NUM_PRIORITIES)) || (name[1] != '.') || (name[2] == '\0')) {
+        return false;
+    }
+
+    *priority = (uint8_t)(name[0] - '0');
+    *seq = 0;
+
+    for (name += 2; *name != '\0'; name++) {
+        if ((*name < '0') || (*name > '9') || (*seq > ((UINT32_MAX - 9U) / 10U))) {
+            return false;
+        }
+
+        *seq = (*seq * 10U) + (uint32_t)(*name - '0');
+    }
+
+    return true;
+}
+
+static bool segment_exists(uint8_t priority, uint32_t seq, uint32_t head, uint16_t mutex_timeout) {
+    char name[TELEM_STORE_NAME_MAX_SIZE];
+    fs_entry_info_t info;
+
+    telem_store_segment_name(priority, seq, head, name);
+    return fs_stat(name, &info, mutex_timeout) == FS_OK;
+}
+
+/**
+ * @brief Remove a segment and its index file. Failures are ignored, a segment that couldn't be
+ * removed is retried the next time the manifest is loaded.
+ */
+static void remove_segment(uint8_t priority, uint32_t seq, uint32_t head, uint16_t mutex_timeout) {
+    char name[TELEM_STORE_NAME_MAX_SIZE];
+
+    telem_store_index_name(priority, seq, head, name);
+    fs_remove(name, mutex_timeout);
+
+    telem_store_segment_name(priority, seq, head, name);
+    fs_remove(name, mutex_timeout);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file telem_store.h
+ * @brief Segmented circular store of the telem files
+ */
+
+#ifndef TELEM_STORE_H_
+#define TELEM_STORE_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "telem.h"
+#include "telem_error.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/* @brief Max sizes of the telem data of each priority
+ *
+ * Constrained by the downlink capacity calculated in Data Budget V3
+ * ~50KB downlink capacity per pass allocated to telemetry
+ * Priority 0 is transmitted fully and maximum leftover amount of priority 1 is transmitted
+ * Thus, max size of priority 0 = priority 1 = 50KB. Leftover (8MB - 100KB) is for priority 2
+*/
+#define TELEM_PRIORITY_0_MAX_FILE_SIZE      51200U
+#define TELEM_PRIORITY_1_MAX_FILE_SIZE      51200U
+#define TELEM_PRIORITY_2_MAX_FILE_SIZE      8286208U
+
+/**
+ * @brief Number of segments the data of each priority is split into. The oldest segment is
+ * evicted when a new one is started, so this sets how much history is dropped at a time.
+ */
+#define TELEM_PRIORITY_0_SEGMENTS           8U
+#define TELEM_PRIORITY_1_SEGMENTS           8U
+#define TELEM_PRIORITY_2_SEGMENTS           64U
+
+#define TELEM_STORE_MANIFEST_FILENAME       "telem.man"
+#define TELEM_STORE_MANIFEST_SIZE           (4U + (TELEM_NUM_PRIORITIES * 8U) + 4U)
+
+/**
+ * @brief Max size of the name of a segment or segment index file, including the null terminator
+ */
+#define TELEM_STORE_NAME_MAX_SIZE           32U
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void telem_store_pre_init(void);
+
+telem_err_t telem_store_get_range(uint8_t priority, uint32_t *tail, uint32_t *head, uint16_t mutex_timeout);
+telem_err_t telem_store_get_size(uint8_t priority, uint32_t *size, uint16_t mutex_timeout);
+uint32_t telem_store_segment_size(uint8_t priority);
+
+void telem_store_segment_name(uint8_t priority, uint32_t seq, uint32_t head, char name[TELEM_STORE_NAME_MAX_SIZE]);
+void telem_store_index_name(uint8_t priority, uint32_t seq, uint32_t head, char name[TELEM_STORE_NAME_MAX_SIZE]);
+
+telem_err_t telem_store_rotate(uint8_t priority, uint16_t mutex_timeout);
+
+#endif // TELEM_STORE_H_
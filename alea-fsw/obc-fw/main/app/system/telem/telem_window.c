@@ -0,0 +1,257 @@
+/**
+ * @file telem_window.c
+ * @brief Per-field min / max / mean of the samples of a telem unit over a time window
+ *
+ * The samples are aggregated in their serialized form, field by field, so that no struct of the
+ * telem unit is needed and the results are serialized by construction.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "telem_window.h"
+
+// Utils
+#include "data_fmt.h"
+
+// Standard Library
+#include <string.h>
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static uint8_t field_size(data_fmt_field_type_t type);
+static bool is_float(data_fmt_field_type_t type);
+static uint64_t read_uint(data_fmt_field_type_t type, const uint8_t *buf);
+static void write_uint(data_fmt_field_type_t type, uint64_t value, uint8_t *buf);
+static float64 read_float(data_fmt_field_type_t type, const uint8_t *buf);
+static void write_float(data_fmt_field_type_t type, float64 value, uint8_t *buf);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Initialize a window for the samples of a telem unit
+ *
+ * @param[out] window  Window to initialize
+ * @param[in]  desc    Fields of the response of the telem unit
+ * @param[in]  size    Size of the serialized response
+ *
+ * @return true if successful, false if the samples are too large or don't match the fields
+ */
+bool telem_window_init(telem_window_t *window, const data_fmt_desc_t *desc, uint8_t size) {
+    uint32_t total = 0;
+
+    if ((desc == NULL) || (size > TELEM_WINDOW_MAX_SIZE)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < desc->count; i++) {
+        uint8_t value_size = field_size(desc->fields[i].type);
+
+        if (value_size == 0) {
+            return false;
+        }
+
+        total += (uint32_t) value_size * desc->fields[i].array_len;
+    }
+
+    if (total != size) {
+        return false;
+    }
+
+    window->desc = desc;
+    window->size = size;
+    telem_window_reset(window, 0);
+
+    return true;
+}
+
+/**
+ * @brief Start a new window, without samples
+ *
+ * @param[in,out] window  Window
+ * @param[in]     start   Epoch of the start of the window
+ */
+void telem_window_reset(telem_window_t *window, int32_t start) {
+    window->start = start;
+    window->count = 0;
+}
+
+/**
+ * @brief Add a sample to a window
+ *
+ * @param[in,out] window  Window
+ * @param[in]     sample  Serialized response, of the size the window was initialized with
+ */
+void telem_window_add(telem_window_t *window, const uint8_t *sample) {
+    const data_fmt_desc_t *desc = window->desc;
+    uint32_t offset = 0;
+    uint32_t value = 0;
+
+    if (window->count == 0) {
+        memcpy(window->min, sample, window->size);
+        memcpy(window->max, sample, window->size);
+    }
+
+    for (uint8_t i = 0; i < desc->count; i++) {
+        data_fmt_field_type_t type = desc->fields[i].type;
+        uint8_t size = field_size(type);
+
+        for (uint8_t j = 0; j < desc->fields[i].array_len; j++) {
+            const uint8_t *x = &sample[offset];
+
+            if (window->count == 0) {
+                window->sums[value] = 0;
+            }
+
+            if (is_float(type)) {
+                float64 f = read_float(type, x);
+
+                if (f < read_float(type, &window->min[offset])) {
+                    memcpy(&window->min[offset], x, size);
+                }
+
+                if (f > read_float(type, &window->max[offset])) {
+                    memcpy(&window->max[offset], x, size);
+                }
+
+                window->sums[value] += f;
+            } else {
+                uint64_t u = read_uint(type, x);
+
+                if (u < read_uint(type, &window->min[offset])) {
+                    memcpy(&window->min[offset], x, size);
+                }
+
+                if (u > read_uint(type, &window->max[offset])) {
+                    memcpy(&window->max[offset], x, size);
+                }
+
+                window->sums[value] += (float64) u;
+            }
+
+            offset += size;
+            value++;
+        }
+    }
+
+    window->count++;
+}
+
+/**
+ * @brief Get the mean of the samples of a window
+ *
+ * @param[in]  window  Window, with at least one sample
+ * @param[out] mean    Serialized mean, of the size the window was initialized with
+ */
+void telem_window_mean(const telem_window_t *window, uint8_t *mean) {
+    const data_fmt_desc_t *desc = window->desc;
+    uint32_t offset = 0;
+    uint32_t value = 0;
+
+    for (uint8_t i = 0; i < desc->count; i++) {
+        data_fmt_field_type_t type = desc->fields[i].type;
+
+        for (uint8_t j = 0; j < desc->fields[i].array_len; j++) {
+            float64 m = (window->count > 0) ? (window->sums[value] / (float64) window->count) : 0;
+
+            if (is_float(type)) {
+                write_float(type, m, &mean[offset]);
+            } else {
+                write_uint(type, (uint64_t)(m + 0.5), &mean[offset]);
+            }
+
+            offset += field_size(type);
+            value++;
+        }
+    }
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Size of a serialized value of a field, or 0 for an unknown type
+ */
+static uint8_t field_size(data_fmt_field_type_t type) {
+    switch (type) {
+    case DATA_FMT_FIELD_TYPE_U8:
+    case DATA_FMT_FIELD_TYPE_BOOL:
+        return 1U;
+
+    case DATA_FMT_FIELD_TYPE_U16:
+        return 2U;
+
+    case DATA_FMT_FIELD_TYPE_U32:
+    case DATA_FMT_FIELD_TYPE_F32:
+        return 4U;
+
+    case DATA_FMT_FIELD_TYPE_U64:
+    case DATA_FMT_FIELD_TYPE_F64:
+        return 8U;
+
+    default:
+        return 0;
+    }
+}
+
+static bool is_float(data_fmt_field_type_t type) {
+    return (type == DATA_FMT_FIELD_TYPE_F32) || (type == DATA_FMT_FIELD_TYPE_F64);
+}
+
+static uint64_t read_uint(data_fmt_field_type_t type, const uint8_t *buf) {
+    switch (type) {
+    case DATA_FMT_FIELD_TYPE_U16:
+        return data_fmt_arr_be_to_u16(buf);
+
+    case DATA_FMT_FIELD_TYPE_U32:
+        return data_fmt_arr_be_to_u32(buf);
+
+    case DATA_FMT_FIELD_TYPE_U64:
+        return data_fmt_arr_be_to_u64(buf);
+
+    default:
+        return buf[0];
+    }
+}
+
+static void write_uint(data_fmt_field_type_t type, uint64_t value, uint8_t *buf) {
+    switch (type) {
+    case DATA_FMT_FIELD_TYPE_U16:
+        data_fmt_u16_to_arr_be((uint16_t) value, buf);
+        break;
+
+    case DATA_FMT_FIELD_TYPE_U32:
+        data_fmt_u32_to_arr_be((uint32_t) value, buf);
+        break;
+
+    case DATA_FMT_FIELD_TYPE_U64:
+        data_fmt_u64_to_arr_be(value, buf);
+        break;
+
+    default:
+        buf[0] = (uint8_t) value;
+        break;
+    }
+}
+
+static float64 read_float(data_fmt_field_type_t type, const uint8_t *buf) {
+    if (type == DATA_FMT_FIELD_TYPE_F64) {
+        return data_fmt_arr_be_to_f64(buf);
+    }
+
+    return (float64) data_fmt_arr_be_to_f32(buf);
+}
+
+static void write_float(data_fmt_field_type_t type, float64 value, uint8_t *buf) {
+    if (type == DATA_FMT_FIELD_TYPE_F64) {
+        data_fmt_f64_to_arr_be(value, buf);
+    } else {
+        data_fmt_f32_to_arr_be((float32) value, buf);
+    }
+}
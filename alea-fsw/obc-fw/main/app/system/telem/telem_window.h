@@ -0,0 +1,58 @@
+/**
+ * @file telem_window.h
+ * @brief Per-field min / max / mean of the samples of a telem unit over a time window
+ *
+ * Samples are the serialized responses of a telem unit (see data_fmt.h). The min, max and mean are
+ * computed for each value of the response (each element of an array field) and serialized the same
+ * way, so they can be decoded like a sample. For bool values, the min is true if all samples are true,
+ * the max is true if any sample is true and the mean is true if at least half the samples are true.
+ * Integer means are rounded to the nearest integer.
+ */
+
+#ifndef TELEM_WINDOW_H_
+#define TELEM_WINDOW_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// Utils
+#include "data_fmt.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/**
+ * @brief Maximum size of the samples of a window
+ */
+#define TELEM_WINDOW_MAX_SIZE   64U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef struct {
+    const data_fmt_desc_t *desc;            // Fields of the samples
+    uint8_t size;                           // Size of the serialized samples
+    int32_t start;                          // Epoch of the start of the window
+    uint32_t count;                         // Number of samples added
+    uint8_t min[TELEM_WINDOW_MAX_SIZE];
+    uint8_t max[TELEM_WINDOW_MAX_SIZE];
+    float64 sums[TELEM_WINDOW_MAX_SIZE];    // Sum of each value, in the order of the values
+} telem_window_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+bool telem_window_init(telem_window_t *window, const data_fmt_desc_t *desc, uint8_t size);
+void telem_window_reset(telem_window_t *window, int32_t start);
+void telem_window_add(telem_window_t *window, const uint8_t *sample);
+void telem_window_mean(const telem_window_t *window, uint8_t *mean);
+
+#endif /* TELEM_WINDOW_H_ */
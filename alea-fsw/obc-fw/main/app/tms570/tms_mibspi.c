@@ -29,6 +29,7 @@
 
 // HAL
 #include "gio.h"
+#include "sys_dma.h"
 
 /******************************************************************************/
 /*                               D E F I N E S                                */
@@ -39,6 +40,40 @@
  */
 #define MUTEX_TIMEOUT_MS 200
 
+/**
+ * @brief DMA channels used to move bytes between caller buffers and the buffer RAM of each
+ * port. Transfers on a port are serialized by its mutex, so each port needs only one channel.
+ */
+#define MIBSPI1_DMA_CH DMA_CH0
+#define MIBSPI3_DMA_CH DMA_CH1
+#define MIBSPI5_DMA_CH DMA_CH2
+
+/**
+ * @brief DMA port assignment: read and write through port B (the only port on this device).
+ */
+#define MIBSPI_DMA_PORT_B 4U
+
+/**
+ * @brief Number of times the block transfer complete flag is polled before a DMA copy is
+ * considered failed. A copy of a full transfer group (128 bytes) completes in a few microseconds.
+ */
+#define MIBSPI_DMA_MAX_POLLS 10000U
+
+/**
+ * @brief Size of one entry of the transmit or receive buffer RAM.
+ */
+#define MIBSPI_RAM_ENTRY_SIZE 4U
+
+/**
+ * @brief Offset of the least significant byte of the data field in a buffer RAM entry. The
+ * transfer groups use 8-bit characters, so only this byte is written and read.
+ */
+#if ((__little_endian__ == 1) || (__LITTLE_ENDIAN__ == 1))
+#define MIBSPI_RAM_DATA_LSB_OFFSET 0U
+#else
+#define MIBSPI_RAM_DATA_LSB_OFFSET 3U
+#endif
+
 /******************************************************************************/
 /*               P R I V A T E  G L O B A L  V A R I A B L E S                */
 /******************************************************************************/
@@ -56,11 +91,18 @@ static SemaphoreHandle_t xMibspi5MutexHandle;
 /******************************************************************************/
 
 static mibspi_err_t mibspi_tx(const mibspi_tg_t *tg, EventGroupHandle_t eg_handle, uint16_t *tx_buffer, uint32_t timeout);
+static mibspi_err_t mibspi_transfer(const mibspi_tg_t *tg, EventGroupHandle_t eg_handle, uint16_t *tx_buffer, uint32_t timeout);
 static mibspi_err_t mibspi_rx(const mibspi_tg_t *tg, EventGroupHandle_t eg_handle, uint16_t *rx_buffer, uint32_t timeout);
 static mibspi_err_t mibspi_tx_rx(const mibspi_tg_t *tg, EventGroupHandle_t eg_handle, uint16_t *tx_buffer, uint16_t *rx_buffer, uint32_t timeout);
 static mibspi_err_t mibspi_tx_error_handler(uint32_t error_flags);
 static mibspi_err_t mibspi_rx_error_handler(uint32_t error_flags);
 static SemaphoreHandle_t get_mutex_handle(mibspiBASE_t *reg);
+static mibspiRAM_t *get_ram_handle(mibspiBASE_t *reg);
+static uint32_t get_dma_channel(mibspiBASE_t *reg);
+static void get_tg_bounds(const mibspi_tg_t *tg, uint32_t *start, uint32_t *end);
+static mibspi_err_t mibspi_dma_fill_tx(const mibspi_tg_t *tg, uint32_t start, uint32_t count, const uint8_t *tx_data);
+static mibspi_err_t mibspi_dma_drain_rx(const mibspi_tg_t *tg, uint32_t start, uint32_t count, uint8_t *rx_data);
+static mibspi_err_t mibspi_dma_copy(uint32_t channel, g_dmaCTRL *pkt);
 
 /******************************************************************************/
 /*                       P U B L I C  F U N C T I O N S                       */
@@ -91,10 +133,17 @@ void tms_mibspi_pre_init(void) {
 }
 
 /**
- * @brief Initializes MIBSPI hardware.
+ * @brief Initializes MIBSPI hardware, and the DMA controller used to fill and drain the buffer RAM.
  */
 void tms_mibspi_init_hw(void) {
     mibspiInit();
+    dmaEnable();
+
+    // The DMA interrupts are not enabled in the VIM, so this only makes the controller set the
+    // block transfer complete flags that are polled by mibspi_dma_copy
+    dmaEnableInterrupt(MIBSPI1_DMA_CH, BTC);
+    dmaEnableInterrupt(MIBSPI3_DMA_CH, BTC);
+    dmaEnableInterrupt(MIBSPI5_DMA_CH, BTC);
 }
 
 /**
@@ -219,6 +268,138 @@ mibspi_err_t tms_mibspi_tx_rx(const mibspi_tg_t *tg, uint16_t *tx_buffer, uint16
     return err;
 }
 
+/**
+ * @brief Start a transaction that spans multiple transfer groups on the same MibSPI port.
+ *
+ * Takes the port mutex and asserts the chip select of the given transfer group. The chip select
+ * stays asserted across every @ref tms_mibspi_selected_xfer_bytes call until
+ * @ref tms_mibspi_deselect is called. This allows a single device transaction (e.g. a flash
+ * page program) to be longer than any single transfer group.
+ *
+ * @pre tms_mibspi_create_infra
+ * @pre tms_mibspi_init_hw
+ *
+ * @param tg: Transfer group struct used to identify the port and chip select
+ * @return MIBSPI_NO_ERR if no error, error code otherwise
+ */
+mibspi_err_t tms_mibspi_select(const mibspi_tg_t *tg) {
+    SemaphoreHandle_t mutex = get_mutex_handle(tg->reg);
+
+    if (mutex == NULL) {
+        return MIBSPI_MUTEX_INVALID_ERR;
+    }
+
+    if (!xSemaphoreTake(mutex, pdMS_TO_TICKS(MUTEX_TIMEOUT_MS))) {
+        return MIBSPI_MUTEX_GRAB_ERR;
+    }
+
+    // Enable CS
+    gioSetBit(tg->cs_port, tg->cs_pin, 0);
+
+    return MIBSPI_NO_ERR;
+}
+
+/**
+ * @brief End a transaction started with @ref tms_mibspi_select.
+ *
+ * De-asserts the chip select and releases the port mutex.
+ *
+ * @param tg: Transfer group struct that was passed to @ref tms_mibspi_select
+ */
+void tms_mibspi_deselect(const mibspi_tg_t *tg) {
+    SemaphoreHandle_t mutex = get_mutex_handle(tg->reg);
+
+    // Disable CS
+    gioSetBit(tg->cs_port, tg->cs_pin, 1);
+
+    if (mutex != NULL) {
+        xSemaphoreGive(mutex);
+    }
+}
+
+/**
+ * @brief Transmit and receive byte buffers using a particular MibSPI transfer group without
+ * touching the chip select.
+ *
+ * The port's DMA channel copies the bytes into (and out of) the low byte of each buffer RAM
+ * entry of the transfer group, so callers do not need to widen their data into uint16_t buffers
+ * and the CPU does not copy the data.
+ *
+ * @pre tms_mibspi_select
+ * @pre Called from a privileged task (the DMA registers can only be written in privileged mode).
+ * The MIBSPI_ASYNC task is privileged for this reason.
+ *
+ * @param tg: Transfer group struct
+ * @param tx_data: Bytes to transmit (transfer group length), or NULL to transmit zeros
+ * @param rx_data: Buffer for received bytes (transfer group length), or NULL to discard them
+ * @param timeout: MIBSPI timeout in ms
+ * @return MIBSPI_NO_ERR if no error, error code otherwise
+ */
+mibspi_err_t tms_mibspi_selected_xfer_bytes(const mibspi_tg_t *tg, const uint8_t *tx_data, uint8_t *rx_data, uint32_t timeout) {
+    EventGroupHandle_t eventgroup = get_eventgroup_handle(tg->reg);
+
+    if (eventgroup == NULL) {
+        return MIBSPI_EVENTGROUP_INVALID_ERR;
+    }
+
+    uint32_t start = 0;
+    uint32_t end   = 0;
+    get_tg_bounds(tg, &start, &end);
+
+    // Set up data to be transferred
+    mibspi_err_t err = mibspi_dma_fill_tx(tg, start, end - start, tx_data);
+
+    if (err != MIBSPI_NO_ERR) {
+        return err;
+    }
+
+    // Transfer Data
+    mibspiTransfer(tg->reg, tg->transfer_group);
+
+    EventBits_t uxBits = xEventGroupWaitBits(
+                             eventgroup,
+                             ((uint8_t)((uint8_t)1U << tg->transfer_group)) | MIBSPI_ERR_NOTIF,
+                             pdTRUE,   /* The bits should be cleared before returning. */
+                             pdFALSE,  /* Wait for only one bit. */
+                             pdMS_TO_TICKS(timeout));
+
+    if (uxBits & MIBSPI_ERR_NOTIF) {
+        return mibspi_tx_error_handler(tg->reg->FLG);
+    } else if (uxBits == 0) {
+        return MIBSPI_TIMEOUT;
+    }
+
+    // Check the receive flags, then recv data
+    mibspiRAM_t *ram = get_ram_handle(tg->reg);
+    uint16_t flags   = 0;
+
+    for (uint32_t i = start; i < end; i++) {
+        flags |= ram->rx[i].flags;
+    }
+
+    err = mibspi_rx_error_handler(((uint32_t)flags >> 8U) & 0x5FU);
+
+    if ((err == MIBSPI_NO_ERR) && (rx_data != NULL)) {
+        err = mibspi_dma_drain_rx(tg, start, end - start, rx_data);
+    }
+
+    return err;
+}
+
+/**
+ * @brief Get the number of buffers (bytes) in a transfer group, as configured in HALCoGen.
+ *
+ * @param tg: Transfer group struct
+ * @return Length of the transfer group
+ */
+uint32_t tms_mibspi_tg_len(const mibspi_tg_t *tg) {
+    uint32_t start = 0;
+    uint32_t end   = 0;
+    get_tg_bounds(tg, &start, &end);
+
+    return end - start;
+}
+
 /**
  * @brief Get the event group for the corresponding transfer group
  *
@@ -270,15 +451,38 @@ EventGroupHandle_t get_eventgroup_handle(mibspiBASE_t *reg) {
  * @return MIBSPI_NO_ERR if no error, error code otherwise
  */
 static mibspi_err_t mibspi_tx(const mibspi_tg_t *tg, EventGroupHandle_t eg_handle, uint16_t *tx_buffer, uint32_t timeout) {
+    // Enable CS
+    gioSetBit(tg->cs_port, tg->cs_pin, 0);
+
+    mibspi_err_t err = mibspi_transfer(tg, eg_handle, tx_buffer, timeout);
+
+    // Disable CS
+    gioSetBit(tg->cs_port, tg->cs_pin, 1);
+
+    return err;
+}
+
+/**
+ * @brief Run a single transfer group and wait for it to complete. The chip select is
+ * not modified.
+ *
+ * @pre @ref tms_mibspi_init_hw
+ * @pre event group notification has been enabled
+ *
+ * @param tg: Transfer group struct
+ * @param eg_handle: Event group handle
+ * @param tx_buffer: Pointer to the data to transmit, length of data that is transmitted
+ * depends on the transfer group size
+ * @param timeout: Timeout in ms for the transaction.
+ * @return MIBSPI_NO_ERR if no error, error code otherwise
+ */
+static mibspi_err_t mibspi_transfer(const mibspi_tg_t *tg, EventGroupHandle_t eg_handle, uint16_t *tx_buffer, uint32_t timeout) {
     EventBits_t uxBits;
     const TickType_t xTicksToWait = pdMS_TO_TICKS(timeout);
 
     // Set up data to be transferred
     mibspiSetData(tg->reg, tg->transfer_group, tx_buffer);
 
-    // Enable CS
-    gioSetBit(tg->cs_port, tg->cs_pin, 0);
-
     // Transfer Data
     mibspiTransfer(tg->reg, tg->transfer_group);
 
@@ -292,9 +496,6 @@ static mibspi_err_t mibspi_tx(const mibspi_tg_t *tg, EventGroupHandle_t eg_handl
                  pdFALSE,  /* Wait for only one bit. */
                  xTicksToWait);
 
-    // Disable CS
-    gioSetBit(tg->cs_port, tg->cs_pin, 1);
-
     if (uxBits & MIBSPI_ERR_NOTIF) {
         // Read error flag register
         return mibspi_tx_error_handler(tg->reg->FLG);
@@ -453,3 +654,128 @@ static SemaphoreHandle_t get_mutex_handle(mibspiBASE_t *reg) {
 
     return handle;
 }
+
+/**
+ * @brief Get the buffer RAM for the corresponding MIBSPI port
+ *
+ * @param reg: the mibspi register
+ * @return mibspiRAM_t*: the buffer RAM of the port
+ */
+static mibspiRAM_t *get_ram_handle(mibspiBASE_t *reg) {
+    return (reg == mibspiREG1) ? mibspiRAM1 : ((reg == mibspiREG3) ? mibspiRAM3 : mibspiRAM5);
+}
+
+/**
+ * @brief Get the DMA channel used to fill and drain the buffer RAM of a MIBSPI port
+ *
+ * @param reg: the mibspi register
+ * @return The DMA channel of the port
+ */
+static uint32_t get_dma_channel(mibspiBASE_t *reg) {
+    return (reg == mibspiREG1) ? MIBSPI1_DMA_CH : ((reg == mibspiREG3) ? MIBSPI3_DMA_CH : MIBSPI5_DMA_CH);
+}
+
+/**
+ * @brief Get the range of buffers used by a transfer group (same computation as the HALCoGen
+ * mibspiSetData/mibspiGetData functions)
+ *
+ * @param tg: Transfer group struct
+ * @param[out] start: Index of the first buffer
+ * @param[out] end: Index one past the last buffer
+ */
+static void get_tg_bounds(const mibspi_tg_t *tg, uint32_t *start, uint32_t *end) {
+    uint32_t group = tg->transfer_group;
+
+    *start = (tg->reg->TGCTRL[group] >> 8U) & 0xFFU;
+    *end   = (group == 7U) ? (((tg->reg->LTGPEND & 0x00007F00U) >> 8U) + 1U) : ((tg->reg->TGCTRL[group + 1U] >> 8U) & 0xFFU);
+
+    if (*end == 0U) {
+        *end = 128U;
+    }
+}
+
+/**
+ * @brief Copy the bytes to transmit into the data field of each buffer of a transfer group.
+ *
+ * @param tg: Transfer group struct
+ * @param start: Index of the first buffer of the transfer group
+ * @param count: Number of buffers in the transfer group
+ * @param tx_data: Bytes to transmit, or NULL to transmit zeros
+ * @return MIBSPI_NO_ERR if no error, error code otherwise
+ */
+static mibspi_err_t mibspi_dma_fill_tx(const mibspi_tg_t *tg, uint32_t start, uint32_t count, const uint8_t *tx_data) {
+    static const uint8_t zero = 0U;
+    mibspiRAM_t *ram = get_ram_handle(tg->reg);
+
+    g_dmaCTRL pkt = {
+        .SADD      = (uint32_t)(uintptr_t)((tx_data != NULL) ? tx_data : &zero),
+        .DADD      = (uint32_t)(uintptr_t)&ram->tx[start] + MIBSPI_RAM_DATA_LSB_OFFSET,
+        .ELSOFFSET = 0U,
+        .ELDOFFSET = MIBSPI_RAM_ENTRY_SIZE,
+        .ELCNT     = count,
+        .ADDMODERD = (tx_data != NULL) ? ADDR_INC1 : ADDR_FIXED,
+        .ADDMODEWR = ADDR_OFFSET,
+    };
+
+    return mibspi_dma_copy(get_dma_channel(tg->reg), &pkt);
+}
+
+/**
+ * @brief Copy the received bytes out of the data field of each buffer of a transfer group.
+ *
+ * @param tg: Transfer group struct
+ * @param start: Index of the first buffer of the transfer group
+ * @param count: Number of buffers in the transfer group
+ * @param rx_data: Buffer for the received bytes
+ * @return MIBSPI_NO_ERR if no error, error code otherwise
+ */
+static mibspi_err_t mibspi_dma_drain_rx(const mibspi_tg_t *tg, uint32_t start, uint32_t count, uint8_t *rx_data) {
+    mibspiRAM_t *ram = get_ram_handle(tg->reg);
+
+    g_dmaCTRL pkt = {
+        .SADD      = (uint32_t)(uintptr_t)&ram->rx[start] + MIBSPI_RAM_DATA_LSB_OFFSET,
+        .DADD      = (uint32_t)(uintptr_t)rx_data,
+        .ELSOFFSET = MIBSPI_RAM_ENTRY_SIZE,
+        .ELDOFFSET = 0U,
+        .ELCNT     = count,
+        .ADDMODERD = ADDR_OFFSET,
+        .ADDMODEWR = ADDR_INC1,
+    };
+
+    return mibspi_dma_copy(get_dma_channel(tg->reg), &pkt);
+}
+
+/**
+ * @brief Run a software triggered byte copy on a DMA channel and wait for it to complete.
+ *
+ * @param channel: DMA channel
+ * @param pkt: Control packet with the addresses, element count and addressing modes set. The
+ * remaining fields are filled in for a single block of 8-bit elements.
+ * @return MIBSPI_NO_ERR if the copy completed, MIBSPI_DMA_TIMEOUT otherwise
+ */
+static mibspi_err_t mibspi_dma_copy(uint32_t channel, g_dmaCTRL *pkt) {
+    const uint32_t channel_bit = (uint32_t)1U << channel;
+
+    pkt->CHCTRL    = 0U; // No chained channel
+    pkt->FRCNT     = 1U;
+    pkt->FRDOFFSET = 0U;
+    pkt->FRSOFFSET = 0U;
+    pkt->PORTASGN  = MIBSPI_DMA_PORT_B;
+    pkt->RDSIZE    = ACCESS_8_BIT;
+    pkt->WRSIZE    = ACCESS_8_BIT;
+    pkt->TTYPE     = BLOCK_TRANSFER;
+    pkt->AUTOINIT  = AUTOINIT_OFF;
+
+    dmaREG->BTCFLAG = channel_bit;
+    dmaSetCtrlPacket(channel, *pkt);
+    dmaSetChEnable(channel, (uint32_t)DMA_SW);
+
+    for (uint32_t i = 0; i < MIBSPI_DMA_MAX_POLLS; i++) {
+        if ((dmaREG->BTCFLAG & channel_bit) != 0U) {
+            dmaREG->BTCFLAG = channel_bit;
+            return MIBSPI_NO_ERR;
+        }
+    }
+
+    return MIBSPI_DMA_TIMEOUT;
+}
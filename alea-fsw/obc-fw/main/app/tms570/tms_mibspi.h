@@ -97,6 +97,22 @@ typedef enum {
      * @brief Unknown RX error occurred.
      */
     MIBSPI_UNKNOWN_RX_ERR = -9,
+
+    /**
+     * @brief The asynchronous request queue is full.
+     */
+    MIBSPI_QUEUE_FULL_ERR = -10,
+
+    /**
+     * @brief An asynchronous request is malformed (no segments, mixed ports, or a segment
+     * length that is not a multiple of its transfer group length).
+     */
+    MIBSPI_INVALID_REQ_ERR = -11,
+
+    /**
+     * @brief A DMA copy to or from the transfer group buffer RAM did not complete.
+     */
+    MIBSPI_DMA_TIMEOUT = -12,
 } mibspi_err_t;
 
 /**
@@ -125,6 +141,12 @@ mibspi_err_t tms_mibspi_tx(const mibspi_tg_t *tg, uint16_t *tx_buffer, uint32_t
 mibspi_err_t tms_mibspi_rx(const mibspi_tg_t *tg, uint16_t *rx_buffer, uint32_t timeout);
 mibspi_err_t tms_mibspi_tx_rx(const mibspi_tg_t *tg, uint16_t *tx_buffer, uint16_t *rx_buffer, uint32_t timeout);
 
+/* Multi-transfer-group transactions (chip select held between transfers) */
+mibspi_err_t tms_mibspi_select(const mibspi_tg_t *tg);
+void tms_mibspi_deselect(const mibspi_tg_t *tg);
+mibspi_err_t tms_mibspi_selected_xfer_bytes(const mibspi_tg_t *tg, const uint8_t *tx_data, uint8_t *rx_data, uint32_t timeout);
+uint32_t tms_mibspi_tg_len(const mibspi_tg_t *tg);
+
 /* Public helper function */
 EventGroupHandle_t get_eventgroup_handle(mibspiBASE_t *reg);
 
@@ -0,0 +1,328 @@
+/**
+ * @file tms_mibspi_async.c
+ * @brief Queued asynchronous MIBSPI transfers.
+ *
+ * Requests are queued by the calling task and executed in order by the MIBSPI_ASYNC task,
+ * so the caller can continue with other work while the transfer is in progress. Completion
+ * is signalled through an optional callback and/or task notification. Requests queued together
+ * are executed in the order they were queued, so a device transaction made of several chip
+ * select cycles (e.g. write enable, write, write disable) can be queued at once.
+ *
+ * Each request is a chain of transfer group segments executed with the chip select held, which
+ * allows device transactions longer than any single transfer group. Byte buffers are moved
+ * into and out of the transfer group buffer RAM by DMA (no uint16_t staging buffers). The DMA
+ * registers can only be written in privileged mode, so the MIBSPI_ASYNC task is privileged.
+ *
+ * The port mutexes in tms_mibspi.c are used, so asynchronous requests can be freely mixed
+ * with the synchronous API.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "tms_mibspi_async.h"
+
+// OBC
+#include "obc_rtos.h"
+#include "obc_watchdog.h"
+
+// FreeRTOS
+#include "rtos.h"
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define MIBSPI_ASYNC_POLL_PERIOD_MS 1000U
+
+/**
+ * @brief Period at which a waiting task checks whether its request is done, for requests that
+ * don't notify it.
+ */
+#define MIBSPI_ASYNC_WAIT_POLL_MS 10U
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static void mibspi_async_task(void *pvParameters);
+static bool mibspi_async_req_valid(const mibspi_async_req_t *req);
+static void mibspi_async_complete(mibspi_async_req_t *req, mibspi_err_t err);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static const mibspi_async_backend_t hw_backend = {
+    .select   = &tms_mibspi_select,
+    .deselect = &tms_mibspi_deselect,
+    .xfer     = &tms_mibspi_selected_xfer_bytes,
+    .tg_len   = &tms_mibspi_tg_len,
+};
+
+static const mibspi_async_backend_t *backend = &hw_backend;
+
+static QueueHandle_t req_queue = NULL;
+static TaskHandle_t async_task_handle = NULL;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Create the request queue and the MIBSPI_ASYNC task.
+ */
+void tms_mibspi_async_pre_init(void) {
+    static StaticQueue_t req_queue_buf;
+    static uint8_t req_queue_storage[MIBSPI_ASYNC_QUEUE_DEPTH * sizeof(mibspi_async_req_t *)];
+
+    req_queue = xQueueCreateStatic(MIBSPI_ASYNC_QUEUE_DEPTH, sizeof(mibspi_async_req_t *), req_queue_storage, &req_queue_buf);
+
+    async_task_handle = obc_rtos_create_task_privileged(OBC_TASK_ID_MIBSPI_ASYNC, &mibspi_async_task, NULL, OBC_WATCHDOG_ACTION_ALLOW);
+}
+
+/**
+ * @brief Queue a request for asynchronous execution.
+ *
+ * @param req: Request to execute. Must remain valid until req->done is set.
+ * @param timeout: Time in ms to wait for space in the queue
+ * @return MIBSPI_NO_ERR if the request was queued, error code otherwise
+ */
+mibspi_err_t tms_mibspi_async_submit(mibspi_async_req_t *req, uint32_t timeout) {
+    if ((req == NULL) || (req->segs == NULL) || (req->num_segs == 0)) {
+        return MIBSPI_INVALID_REQ_ERR;
+    }
+
+    req->done = false;
+    req->err  = MIBSPI_NO_ERR;
+
+    if (xQueueSend(req_queue, &req, pdMS_TO_TICKS(timeout)) != pdTRUE) {
+        return MIBSPI_QUEUE_FULL_ERR;
+    }
+
+    return MIBSPI_NO_ERR;
+}
+
+/**
+ * @brief Wait for a queued request to complete.
+ *
+ * Every request completes in a bounded time (the port mutex timeout plus the timeout of each
+ * transfer group), so this does not time out. The calling task is woken by the completion
+ * notification if it is req->notify_task, otherwise it checks the request periodically.
+ *
+ * @pre tms_mibspi_async_submit returned MIBSPI_NO_ERR for the request
+ *
+ * @param req: Request to wait for
+ * @return Result of the request
+ */
+mibspi_err_t tms_mibspi_async_wait(mibspi_async_req_t *req) {
+    while (!req->done) {
+        // A notification left over from an earlier request only causes an extra check of done
+        (void)ulTaskNotifyTakeIndexed(MIBSPI_ASYNC_NOTIFICATION_INDEX, pdTRUE, pdMS_TO_TICKS(MIBSPI_ASYNC_WAIT_POLL_MS));
+    }
+
+    return req->err;
+}
+
+/**
+ * @brief Queue a request and wait for it to complete.
+ *
+ * The calling task is set as the task notified on completion. When called from the
+ * MIBSPI_ASYNC task itself (e.g. from a completion callback), the request is executed directly.
+ *
+ * @param req: Request to execute
+ * @param timeout: Time in ms to wait for space in the queue
+ * @return Result of the request, or an error code if it could not be queued
+ */
+mibspi_err_t tms_mibspi_async_transfer(mibspi_async_req_t *req, uint32_t timeout) {
+    TaskHandle_t current_task = xTaskGetCurrentTaskHandle();
+
+    if (current_task == async_task_handle) {
+        return tms_mibspi_async_run(req);
+    }
+
+    if (req != NULL) {
+        req->notify_task = current_task;
+    }
+
+    mibspi_err_t err = tms_mibspi_async_submit(req, timeout);
+
+    if (err != MIBSPI_NO_ERR) {
+        return err;
+    }
+
+    return tms_mibspi_async_wait(req);
+}
+
+/**
+ * @brief Split a buffer into segments that stream it with the largest transfer groups that fit.
+ *
+ * @param[out] segs: Segments to fill in
+ * @param max_segs: Number of entries in segs
+ * @param tgs: Transfer groups to use, ordered from largest to smallest (lengths must not be 0)
+ * @param num_tgs: Number of entries in tgs
+ * @param tx_data: Bytes to transmit, or NULL to transmit zeros
+ * @param rx_data: Buffer for received bytes, or NULL to discard them
+ * @param len: Number of bytes to transfer
+ * @return Number of segments used, or 0 if len is 0 or can't be composed from the transfer
+ * groups in at most max_segs segments
+ */
+uint8_t tms_mibspi_async_stream_segs(mibspi_seg_t *segs, uint8_t max_segs, const mibspi_stream_tg_t *tgs, uint8_t num_tgs,
+                                     const uint8_t *tx_data, uint8_t *rx_data, uint32_t len) {
+    uint8_t num_segs = 0;
+
+    for (uint8_t i = 0; (i < num_tgs) && (len > 0); i++) {
+        // As many whole transfer groups of this length as fit in what is left
+        uint32_t seg_len = len - (len % tgs[i].len);
+
+        if (seg_len == 0) {
+            continue;
+        }
+
+        if (num_segs == max_segs) {
+            return 0;
+        }
+
+        segs[num_segs].tg      = tgs[i].tg;
+        segs[num_segs].tx_data = tx_data;
+        segs[num_segs].rx_data = rx_data;
+        segs[num_segs].len     = seg_len;
+        num_segs++;
+
+        tx_data = (tx_data != NULL) ? &tx_data[seg_len] : NULL;
+        rx_data = (rx_data != NULL) ? &rx_data[seg_len] : NULL;
+        len -= seg_len;
+    }
+
+    return (len == 0) ? num_segs : 0;
+}
+
+/**
+ * @brief Execute a request in the calling task using the installed backend.
+ *
+ * This is what the MIBSPI_ASYNC task runs for each queued request. Completion is signalled
+ * in the same way as for queued requests.
+ *
+ * @warning With the hardware backend, the calling task must be privileged (see
+ * @ref tms_mibspi_selected_xfer_bytes). Drivers should use @ref tms_mibspi_async_transfer.
+ *
+ * @param req: Request to execute
+ * @return Result of the request
+ */
+mibspi_err_t tms_mibspi_async_run(mibspi_async_req_t *req) {
+    if ((req == NULL) || (req->segs == NULL) || (req->num_segs == 0)) {
+        return MIBSPI_INVALID_REQ_ERR;
+    }
+
+    req->done = false;
+    req->err  = MIBSPI_NO_ERR;
+
+    if (!mibspi_async_req_valid(req)) {
+        mibspi_async_complete(req, MIBSPI_INVALID_REQ_ERR);
+        return MIBSPI_INVALID_REQ_ERR;
+    }
+
+    const mibspi_tg_t *cs_tg = req->segs[0].tg;
+    mibspi_err_t err = backend->select(cs_tg);
+
+    if (err == MIBSPI_NO_ERR) {
+        for (uint8_t i = 0; (i < req->num_segs) && (err == MIBSPI_NO_ERR); i++) {
+            const mibspi_seg_t *seg = &req->segs[i];
+            const uint32_t tg_len   = backend->tg_len(seg->tg);
+
+            // Run the transfer group as many times as needed to cover the segment
+            for (uint32_t offset = 0; (offset < seg->len) && (err == MIBSPI_NO_ERR); offset += tg_len) {
+                const uint8_t *tx_data = (seg->tx_data != NULL) ? &seg->tx_data[offset] : NULL;
+                uint8_t *rx_data       = (seg->rx_data != NULL) ? &seg->rx_data[offset] : NULL;
+
+                err = backend->xfer(seg->tg, tx_data, rx_data, req->timeout);
+            }
+        }
+
+        backend->deselect(cs_tg);
+    }
+
+    mibspi_async_complete(req, err);
+
+    return err;
+}
+
+/**
+ * @brief Replace the backend used to execute requests.
+ *
+ * @param new_backend: Backend to use, or NULL to restore the MIBSPI hardware backend
+ */
+void tms_mibspi_async_set_backend(const mibspi_async_backend_t *new_backend) {
+    backend = (new_backend != NULL) ? new_backend : &hw_backend;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief MIBSPI_ASYNC task. Executes queued requests in order.
+ *
+ * @param pvParameters Task parameters (see obc_rtos)
+ */
+static void mibspi_async_task(void *pvParameters) {
+    while (1) {
+        obc_watchdog_pet(OBC_TASK_ID_MIBSPI_ASYNC);
+
+        mibspi_async_req_t *req = NULL;
+
+        if (xQueueReceive(req_queue, &req, pdMS_TO_TICKS(MIBSPI_ASYNC_POLL_PERIOD_MS)) == pdTRUE) {
+            tms_mibspi_async_run(req);
+        }
+    }
+}
+
+/**
+ * @brief Check that all segments of a request can be executed under one chip select.
+ *
+ * @param req: Request with at least one segment
+ * @return True if every segment uses the port and chip select of the first one, and has a
+ * length that is a non-zero multiple of its transfer group length
+ */
+static bool mibspi_async_req_valid(const mibspi_async_req_t *req) {
+    const mibspi_tg_t *cs_tg = req->segs[0].tg;
+
+    for (uint8_t i = 0; i < req->num_segs; i++) {
+        const mibspi_seg_t *seg = &req->segs[i];
+
+        if ((seg->tg->reg != cs_tg->reg) || (seg->tg->cs_port != cs_tg->cs_port) || (seg->tg->cs_pin != cs_tg->cs_pin)) {
+            return false;
+        }
+
+        const uint32_t tg_len = backend->tg_len(seg->tg);
+
+        if ((tg_len == 0) || (seg->len == 0) || ((seg->len % tg_len) != 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Record the result of a request and signal its completion.
+ *
+ * @param req: The completed request
+ * @param err: Result of the request
+ */
+static void mibspi_async_complete(mibspi_async_req_t *req, mibspi_err_t err) {
+    req->err = err;
+
+    if (req->cb != NULL) {
+        req->cb(req);
+    }
+
+    // The request may be reused by its owner as soon as done is set
+    TaskHandle_t notify_task = req->notify_task;
+    req->done = true;
+
+    if (notify_task != NULL) {
+        xTaskNotifyGiveIndexed(notify_task, MIBSPI_ASYNC_NOTIFICATION_INDEX);
+    }
+}
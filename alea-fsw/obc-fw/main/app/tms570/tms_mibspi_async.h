@@ -0,0 +1,124 @@
+/**
+ * @file tms_mibspi_async.h
+ * @brief Queued asynchronous MIBSPI transfers.
+ */
+
+#ifndef TMS_MIBSPI_ASYNC_H_
+#define TMS_MIBSPI_ASYNC_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// OBC
+#include "tms_mibspi.h"
+
+// FreeRtos
+#include "rtos.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/**
+ * @brief Maximum number of requests that can be waiting to be executed.
+ */
+#define MIBSPI_ASYNC_QUEUE_DEPTH 8U
+
+/**
+ * @brief Task notification index used to signal the completion of a request. Index 0 is used
+ * by stream/message buffers and the filesystem/logging tasks, and index 1 by the command system.
+ */
+#define MIBSPI_ASYNC_NOTIFICATION_INDEX 2U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef struct mibspi_async_req_struct mibspi_async_req_t;
+
+/**
+ * @brief Completion callback of an asynchronous request.
+ *
+ * @warning This runs in the context of the MIBSPI_ASYNC task. It must not block for long
+ * since it delays all other queued requests.
+ */
+typedef void (*mibspi_async_cb_t)(mibspi_async_req_t *req);
+
+/**
+ * @brief One transfer group in a chained request.
+ *
+ * The transfer group is run len / (transfer group length) times in a row, so a single segment
+ * can stream a buffer longer than the transfer group.
+ */
+typedef struct {
+    const mibspi_tg_t *tg;
+    const uint8_t *tx_data; // Bytes to transmit, or NULL to transmit zeros
+    uint8_t *rx_data;       // Buffer for received bytes, or NULL to discard them
+    uint32_t len;           // Number of bytes, a non-zero multiple of the transfer group length
+} mibspi_seg_t;
+
+/**
+ * @brief An asynchronous request. Its segments are executed in order with the chip select
+ * of the first segment held for the whole request, so all segments must use the same MIBSPI
+ * port and chip select.
+ *
+ * The request (and its segments and buffers) must remain valid until it completes.
+ */
+struct mibspi_async_req_struct {
+    const mibspi_seg_t *segs;
+    uint8_t num_segs;
+    uint32_t timeout;         // Timeout in ms for each transfer group
+
+    mibspi_async_cb_t cb;     // Called on completion (may be NULL)
+    TaskHandle_t notify_task; // Notified on MIBSPI_ASYNC_NOTIFICATION_INDEX on completion (may be NULL)
+    void *context;            // User data for the callback
+
+    volatile mibspi_err_t err; // Result of the request, valid once done is set
+    volatile bool done;
+};
+
+/**
+ * @brief A transfer group available to stream data, with its length in bytes.
+ */
+typedef struct {
+    const mibspi_tg_t *tg;
+    uint8_t len;
+} mibspi_stream_tg_t;
+
+/**
+ * @brief Hardware operations used to execute requests.
+ *
+ * The default backend drives the MIBSPI peripherals. A different backend can be installed
+ * (@ref tms_mibspi_async_set_backend) to emulate devices on the host.
+ */
+typedef struct {
+    mibspi_err_t (*select)(const mibspi_tg_t *tg);
+    void (*deselect)(const mibspi_tg_t *tg);
+    mibspi_err_t (*xfer)(const mibspi_tg_t *tg, const uint8_t *tx_data, uint8_t *rx_data, uint32_t timeout);
+    uint32_t (*tg_len)(const mibspi_tg_t *tg);
+} mibspi_async_backend_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+/* Startup steps */
+void tms_mibspi_async_pre_init(void);
+
+/* User API */
+mibspi_err_t tms_mibspi_async_submit(mibspi_async_req_t *req, uint32_t timeout);
+mibspi_err_t tms_mibspi_async_wait(mibspi_async_req_t *req);
+mibspi_err_t tms_mibspi_async_transfer(mibspi_async_req_t *req, uint32_t timeout);
+uint8_t tms_mibspi_async_stream_segs(mibspi_seg_t *segs, uint8_t max_segs, const mibspi_stream_tg_t *tgs, uint8_t num_tgs,
+                                     const uint8_t *tx_data, uint8_t *rx_data, uint32_t len);
+
+/* Execution */
+mibspi_err_t tms_mibspi_async_run(mibspi_async_req_t *req);
+void tms_mibspi_async_set_backend(const mibspi_async_backend_t *backend);
+
+#endif /* TMS_MIBSPI_ASYNC_H_ */
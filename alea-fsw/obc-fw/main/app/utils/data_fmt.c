@@ -24,6 +24,8 @@
 /**
  * @brief Serialize a data struct to a byte array according to the provided description
  *
+ * Uses the specialized serializer of the description if it has one.
+ *
  * @param[in]  data    Pointer to the data struct
  * @param[in]  desc    Pointer to the description of the data fields
  * @param[out] buf     Pointer to the buffer where the serialized data will be written
@@ -37,6 +39,10 @@ uint32_t data_fmt_serialize_struct(const void *data, const data_fmt_desc_t *desc
         return 0;
     }
 
+    if (desc->pack != NULL) {
+        return desc->pack(data, buf, buf_len);
+    }
+
     uint32_t bytes_written = 0;
 
     // Iterate over the fields
@@ -66,6 +72,8 @@ uint32_t data_fmt_serialize_struct(const void *data, const data_fmt_desc_t *desc
 /**
  * @brief Deerialize a byte array to a data struct according to the provided description
  *
+ * Uses the specialized deserializer of the description if it has one.
+ *
  * @param[out] data    Pointer to the data struct
  * @param[in]  desc    Pointer to the description of the data fields
  * @param[in]  buf     Pointer to the byte buffer
@@ -79,6 +87,10 @@ uint32_t data_fmt_deserialize_struct(void *data, const data_fmt_desc_t *desc, co
         return 0;
     }
 
+    if (desc->unpack != NULL) {
+        return desc->unpack(data, buf, buf_len);
+    }
+
     uint32_t bytes_read = 0;
 
     // Iterate over the fields
@@ -39,9 +39,32 @@ typedef struct {
     uint8_t array_len;
 } data_fmt_field_desc_t;
 
+/**
+ * @brief Serializer specialized for one struct (see data_fmt_desc_t)
+ *
+ * Same contract as data_fmt_serialize_struct, data and buf are never NULL.
+ */
+typedef uint32_t (*data_fmt_pack_func_t)(const void *data, uint8_t *buf, uint32_t buf_len);
+
+/**
+ * @brief Deserializer specialized for one struct (see data_fmt_desc_t)
+ *
+ * Same contract as data_fmt_deserialize_struct, data and buf are never NULL.
+ */
+typedef uint32_t (*data_fmt_unpack_func_t)(void *data, const uint8_t *buf, uint32_t buf_len);
+
+/**
+ * @brief Description of a struct for serialization / deserialization
+ *
+ * The fields are interpreted one by one unless a specialized function is provided (e.g. by the code
+ * generator), in which case it is used instead. The specialized functions must produce exactly the
+ * same bytes as the interpretation of the fields.
+ */
 typedef struct {
     const data_fmt_field_desc_t *fields;
     uint8_t count;
+    data_fmt_pack_func_t pack;      // Optional, NULL to interpret the fields
+    data_fmt_unpack_func_t unpack;  // Optional, NULL to interpret the fields
 } data_fmt_desc_t;
 
 /******************************************************************************/
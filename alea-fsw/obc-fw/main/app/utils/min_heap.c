@@ -0,0 +1,263 @@
+/**
+ * @file min_heap.c
+ * @brief Binary min-heap utils
+ *
+ * A min-heap keeps a set of items such that the first item (according to
+ * goes_before) can be found in O(1) and items can be inserted or removed in
+ * O(log n).
+ *
+ * The implementation is designed for statically allocated items, which are
+ * copied into a buffer provided by the owner of the heap.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "min_heap.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define ITEM(heap, pos) (&((heap)->items[(uint32_t)(pos) * (heap)->item_size]))
+
+#define PARENT(pos) (((pos) - 1U) / 2U)
+#define LEFT(pos)   ((2U * (pos)) + 1U)
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static void swap(min_heap_t *heap, uint16_t pos_a, uint16_t pos_b);
+static uint16_t sift_up(min_heap_t *heap, uint16_t pos);
+static void sift_down(min_heap_t *heap, uint16_t pos);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Initialize a heap
+ *
+ * This must be called before any other operations on the heap. It can also be
+ * called later to remove all the items.
+ *
+ * @param[in] heap Pointer to heap struct
+ */
+void min_heap_init(min_heap_t *heap) {
+    heap->count = 0;
+}
+
+/**
+ * @brief Checks if the heap is empty
+ *
+ * @param[in] heap Pointer to the heap struct
+ *
+ * @return true if the heap is empty, otherwise false
+ */
+bool min_heap_is_empty(const min_heap_t *heap) {
+    return (heap->count == 0);
+}
+
+/**
+ * @brief Checks if there is no space left to store one more item in the heap
+ *
+ * @param[in] heap Pointer to the heap struct
+ *
+ * @return true if the heap is full, otherwise false
+ */
+bool min_heap_is_full(const min_heap_t *heap) {
+    return (heap->count >= heap->size);
+}
+
+/**
+ * @brief Insert a copy of an item into the heap if there is space.
+ *
+ * This is a worst case O(log n) operation where n is the current number of items.
+ *
+ * @param[in] heap Pointer to the heap struct
+ * @param[in] item Pointer to the item to insert (item_size bytes)
+ *
+ * @return true if there was space to insert the item, otherwise false
+ */
+bool min_heap_push(min_heap_t *heap, const void *item) {
+    if (min_heap_is_full(heap)) {
+        return false;
+    }
+
+    memcpy(ITEM(heap, heap->count), item, heap->item_size);
+    heap->count++;
+
+    sift_up(heap, heap->count - 1U);
+
+    return true;
+}
+
+/**
+ * @brief Retrieves the item that goes before all the others, without removing it.
+ *
+ * This operation is O(1).
+ *
+ * @param[in] heap Pointer to the heap struct
+ *
+ * @return Pointer to the first item, or NULL if the heap is empty
+ */
+const void *min_heap_peek(const min_heap_t *heap) {
+    return min_heap_get(heap, 0);
+}
+
+/**
+ * @brief Remove the item that goes before all the others.
+ *
+ * This is a worst case O(log n) operation where n is the current number of items.
+ *
+ * @param[in]  heap Pointer to the heap struct
+ * @param[out] item Optional pointer to a buffer of item_size bytes where the removed item is copied
+ *
+ * @return true if an item was removed, false if the heap is empty
+ */
+bool min_heap_pop(min_heap_t *heap, void *item) {
+    return min_heap_remove(heap, 0, item);
+}
+
+/**
+ * @brief Retrieves the item at a position in the heap.
+ *
+ * Together with count, this allows iterating over all the items (in no particular order).
+ *
+ * @param[in] heap Pointer to the heap struct
+ * @param[in] pos  Position of the item (< count)
+ *
+ * @return Pointer to the item, or NULL if pos is out of range
+ */
+const void *min_heap_get(const min_heap_t *heap, uint16_t pos) {
+    if (pos >= heap->count) {
+        return NULL;
+    }
+
+    return ITEM(heap, pos);
+}
+
+/**
+ * @brief Remove the item at a position in the heap.
+ *
+ * This is a worst case O(log n) operation where n is the current number of items.
+ *
+ * @param[in]  heap Pointer to the heap struct
+ * @param[in]  pos  Position of the item (< count)
+ * @param[out] item Optional pointer to a buffer of item_size bytes where the removed item is copied
+ *
+ * @return true if the item was removed, false if pos is out of range
+ */
+bool min_heap_remove(min_heap_t *heap, uint16_t pos, void *item) {
+    if (pos >= heap->count) {
+        return false;
+    }
+
+    if (item != NULL) {
+        memcpy(item, ITEM(heap, pos), heap->item_size);
+    }
+
+    // Move the last item into the hole, then restore the order in whichever direction it is broken
+    heap->count--;
+
+    if (pos < heap->count) {
+        memcpy(ITEM(heap, pos), ITEM(heap, heap->count), heap->item_size);
+
+        if (sift_up(heap, pos) == pos) {
+            sift_down(heap, pos);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Find the item that goes after all the others.
+ *
+ * Only the leaves of the heap are searched, this is a worst case O(n) operation
+ * where n is the current number of items.
+ *
+ * @param[in] heap Pointer to the heap struct
+ *
+ * @return Position of the last item, or count if the heap is empty
+ */
+uint16_t min_heap_find_last(const min_heap_t *heap) {
+    if (min_heap_is_empty(heap)) {
+        return heap->count;
+    }
+
+    uint16_t last = heap->count / 2U;
+
+    for (uint16_t pos = last + 1U; pos < heap->count; pos++) {
+        if (heap->goes_before(ITEM(heap, last), ITEM(heap, pos))) {
+            last = pos;
+        }
+    }
+
+    return last;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Swap the items at two positions, one byte at a time so no temporary item is needed
+ */
+static void swap(min_heap_t *heap, uint16_t pos_a, uint16_t pos_b) {
+    uint8_t *a = ITEM(heap, pos_a);
+    uint8_t *b = ITEM(heap, pos_b);
+
+    for (uint16_t i = 0; i < heap->item_size; i++) {
+        uint8_t tmp = a[i];
+        a[i] = b[i];
+        b[i] = tmp;
+    }
+}
+
+/**
+ * @brief Move the item at pos towards the root until its parent goes before it
+ *
+ * @return Final position of the item
+ */
+static uint16_t sift_up(min_heap_t *heap, uint16_t pos) {
+    while (pos > 0) {
+        uint16_t parent = PARENT(pos);
+
+        if (!heap->goes_before(ITEM(heap, pos), ITEM(heap, parent))) {
+            break;
+        }
+
+        swap(heap, pos, parent);
+        pos = parent;
+    }
+
+    return pos;
+}
+
+/**
+ * @brief Move the item at pos towards the leaves until it goes before both of its children
+ */
+static void sift_down(min_heap_t *heap, uint16_t pos) {
+    while (LEFT(pos) < heap->count) {
+        uint16_t child = LEFT(pos);
+
+        if (((child + 1U) < heap->count) && heap->goes_before(ITEM(heap, child + 1U), ITEM(heap, child))) {
+            child++;
+        }
+
+        if (!heap->goes_before(ITEM(heap, child), ITEM(heap, pos))) {
+            break;
+        }
+
+        swap(heap, pos, child);
+        pos = child;
+    }
+}
@@ -0,0 +1,76 @@
+/**
+ * @file min_heap.h
+ * @brief Binary min-heap utils
+ */
+
+#ifndef MIN_HEAP_H_
+#define MIN_HEAP_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Data-structure for holding information about a min-heap.
+ *
+ * This structure must be initialized by min_heap_init before it can be used
+ * with any other operations.
+ *
+ * The items are copied into the items buffer, which is kept in heap order:
+ * the item at position 0 goes before every other item, and the item at
+ * position i goes before the items at positions 2i + 1 and 2i + 2.
+ */
+typedef struct {
+    /**
+     * @brief Maximum number of items in the heap. Must be > 0.
+     */
+    const uint16_t size;
+
+    /**
+     * @brief Size of each item in bytes. Must be > 0.
+     */
+    const uint16_t item_size;
+
+    /**
+     * @brief Function used to order the items.
+     *
+     * Return true if the item a goes before the item b. Otherwise return false.
+     */
+    bool (*goes_before)(const void *a, const void *b);
+
+    /**
+     * @brief Pointer to a buffer of at least size * item_size bytes.
+     */
+    uint8_t *items;
+
+    /**
+     * @brief Number of items in the heap.
+     */
+    uint16_t count;
+} min_heap_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void min_heap_init(min_heap_t *heap);
+bool min_heap_is_empty(const min_heap_t *heap);
+bool min_heap_is_full(const min_heap_t *heap);
+bool min_heap_push(min_heap_t *heap, const void *item);
+
+const void *min_heap_peek(const min_heap_t *heap);
+bool min_heap_pop(min_heap_t *heap, void *item);
+
+const void *min_heap_get(const min_heap_t *heap, uint16_t pos);
+bool min_heap_remove(min_heap_t *heap, uint16_t pos, void *item);
+uint16_t min_heap_find_last(const min_heap_t *heap);
+
+#endif // MIN_HEAP_H_
@@ -3,7 +3,7 @@ import pathlib
 from datetime import datetime
 
 from alea.obcfw.cmd_sys import cmd_sys_spec
-from alea.obcfw.util import codegen, spec_utils
+from alea.obcfw.util import codegen, spec_utils, data_fmt_codegen
 
 class CmdSysCodeGen(codegen.CodeGenerator):
     def __init__(self, output_dir: str | pathlib.Path):
@@ -32,6 +32,7 @@ class CmdSysCodeGen(codegen.CodeGenerator):
             timestamp          = now,
             cmd_sys_gen_header = header_path.name,
             cmd_specs          = cmd_specs,
+            data_fmt_codegen   = data_fmt_codegen,
         )
 
         return (header_path, source_path)
@@ -51,13 +51,29 @@ class OBCCmdSysSpec:
                          If the command sends a response with no data, pass an empty list.
                          If the command sends a response with raw data, pass `RAW_RESPONSE`.
                          If the command sends a response with fields, pass a list of `OBCCmdSysField` instances.
+        duration (readonly): Expected duration class of the command (one of `DURATIONS`).
+                             Long commands run on a separate executor so they don't delay short ones.
+        priority (readonly): Priority of the command (one of `PRIORITIES`).
+                             High priority commands are executed before the other commands already waiting.
     """
 
-    def __init__(self, name: str, id: int, args: data_field.DataFieldList, resp: data_field.DataFieldList):
+    DURATIONS = ("short", "long")
+    PRIORITIES = ("normal", "high")
+
+    def __init__(self, name: str, id: int, args: data_field.DataFieldList, resp: data_field.DataFieldList,
+                 duration: str = "short", priority: str = "normal"):
         self._name = name
         self._id = id
         self._args = args
         self._resp = resp
+        self._duration = duration
+        self._priority = priority
+
+        if duration not in self.DURATIONS:
+            raise OBCCmdSysSpecError(f"Invalid duration ({duration})", spec=self)
+
+        if priority not in self.PRIORITIES:
+            raise OBCCmdSysSpecError(f"Invalid priority ({priority})", spec=self)
 
     @property
     def name(self) -> str:
@@ -83,6 +99,14 @@ class OBCCmdSysSpec:
     def has_resp_fields(self) -> bool:
         return (self._resp and (self._resp.fixed_field_count > 0))
 
+    @property
+    def duration(self) -> str:
+        return self._duration
+
+    @property
+    def priority(self) -> str:
+        return self._priority
+
     def encode_args(self, *args) -> bytes:
         """Serializes the provided arguments to an array of bytes according to this command specification.
 
@@ -257,7 +281,9 @@ class OBCCmdSysSpecs:
                 "resp": null | [
                     {"<field name>": "<field type>"},
                     ...
-                ]
+                ],
+                "duration": "short" | "long",   (optional, defaults to "short")
+                "priority": "normal" | "high"   (optional, defaults to "normal")
             },
             ...
         }
@@ -311,6 +337,7 @@ class OBCCmdSysSpecs:
                 if isinstance(cmd_id, str):
                     cmd_id = int(cmd_id, 0)
 
-                specs.append(OBCCmdSysSpec(cmd_name, cmd_id, args, resp))
+                specs.append(OBCCmdSysSpec(cmd_name, cmd_id, args, resp,
+                                           duration=cmd.get("duration", "short"), priority=cmd.get("priority", "normal")))
 
         return OBCCmdSysSpecs(specs)
@@ -14,6 +14,14 @@ cmd_impl_{{ cmd_spec.name }}(const cmd_sys_cmd_t *cmd
 static cmd_sys_err_t cmd_invoke_{{ cmd_spec.name }}(const cmd_sys_cmd_t *cmd, const data_fmt_desc_t *args_desc, const data_fmt_desc_t *resp_desc)
 {%- endmacro %}
 
+{% macro args_unpack_sig(cmd_spec) -%}
+static uint32_t args_unpack_{{ cmd_spec.name }}(void *data, const uint8_t *buf, uint32_t buf_len)
+{%- endmacro %}
+
+{% macro resp_pack_sig(cmd_spec) -%}
+static uint32_t resp_pack_{{ cmd_spec.name }}(const void *data, uint8_t *buf, uint32_t buf_len)
+{%- endmacro %}
+
 {% macro field_to_str(field) -%}
 {{ field.name }}: {{ field.__class__.__name__|lower }}
 {%- endmacro %}
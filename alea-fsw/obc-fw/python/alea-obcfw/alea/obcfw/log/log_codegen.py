@@ -9,7 +9,7 @@ class LogCodeGen(codegen.CodeGenerator):
     def __init__(self, output_dir: str | pathlib.Path):
         super().__init__(pathlib.Path(__file__).parent / "templates", output_dir)
 
-    def generate(self, specs_paths: Iterable[str] | Iterable[pathlib.Path] = None) -> pathlib.Path:
+    def generate(self, specs_paths: Iterable[str] | Iterable[pathlib.Path] = None) -> tuple[pathlib.Path, pathlib.Path, pathlib.Path]:
         # Load log specs
         log_spec_data = None
         if specs_paths is not None:
@@ -19,11 +19,44 @@ class LogCodeGen(codegen.CodeGenerator):
 
         now = datetime.now()
 
+        # Lay out the filter tables: every log ID gets a contiguous range of signal slots
+        signal_base: dict[int, int] = {}
+        signal_slots: list[log_spec.OBCLogSignalSpec | None] = []
+
+        for group_id in range(log_specs.max_id + 1):
+            group = next((spec for spec in log_specs if spec.id == group_id), None)
+            signal_base[group_id] = len(signal_slots)
+
+            if group is not None:
+                signals_by_id = {signal.id: signal for signal in group.signals}
+                signal_slots.extend(signals_by_id.get(signal_id) for signal_id in range(group.signal_slots))
+
+        def signal_index(group: log_spec.OBCLogGroupSpec, signal: log_spec.OBCLogSignalSpec) -> int:
+            return signal_base[group.id] + signal.id
+
         # Generate header file
         header_path = self.generate_file(
             "logger.h",
-            timestamp = now,
-            log_specs = log_specs,
+            timestamp    = now,
+            log_specs    = log_specs,
+            signal_index = signal_index,
+        )
+
+        # Generate filter table files
+        filter_header_path = self.generate_file(
+            "log_filter_gen.h",
+            timestamp    = now,
+            log_specs    = log_specs,
+            signal_slots = signal_slots,
+        )
+
+        filter_source_path = self.generate_file(
+            "log_filter_gen.c",
+            timestamp             = now,
+            log_filter_gen_header = filter_header_path.name,
+            log_specs             = log_specs,
+            signal_base           = signal_base,
+            signal_slots          = signal_slots,
         )
 
-        return header_path
+        return (header_path, filter_header_path, filter_source_path)
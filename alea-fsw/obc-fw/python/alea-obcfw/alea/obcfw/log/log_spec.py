@@ -1,5 +1,5 @@
 from typing import Iterator, Any
-from enum import IntEnum
+from enum import IntEnum, IntFlag
 
 from alea.common.data_field import data_field
 from alea.common.data_field import data_field_impl
@@ -52,6 +52,14 @@ class OBCLogLevel(IntEnum):
     WARNING = 2
     ERROR   = 3
 
+class OBCLogSink(IntFlag):
+    """Destinations a log can be written to by the OBC (matches log_sink_t in log_filter.h)
+    """
+    SERIAL = 0x01
+    FS     = 0x02
+
+    ALL    = SERIAL | FS
+
 class OBCLogSignalSpec:
     """A logging system signal specification
 
@@ -59,19 +67,25 @@ class OBCLogSignalSpec:
         name (readonly): Name of the signal.
         id (readonly): ID of the signal.
         description (readonly): Descriptor string of the signal
+        sinks (readonly): Destinations the signal is written to by default
     """
 
-    def __init__(self, level: OBCLogLevel, name: str, id: int, desc: str, data: data_field.DataFieldList):
+    def __init__(self, level: OBCLogLevel, name: str, id: int, desc: str, data: data_field.DataFieldList, sinks: OBCLogSink = OBCLogSink.ALL):
         self._level = level
         self._name = name
         self._id = id
         self._desc = desc
         self._data = data
+        self._sinks = sinks
 
     @property
     def level(self) -> OBCLogLevel:
         return self._level
 
+    @property
+    def sinks(self) -> OBCLogSink:
+        return self._sinks
+
     @property
     def name(self) -> str:
         return self._name
@@ -214,6 +228,12 @@ class OBCLogGroupSpec:
     def signals(self) -> list[OBCLogSignalSpec]:
         return self._signals
 
+    @property
+    def signal_slots(self) -> int:
+        """Number of signal IDs reserved for this group in the OBC filter tables (largest signal ID + 1).
+        """
+        return max((signal.id for signal in self._signals), default=-1) + 1
+
     def __str__(self) -> str:
         return f"(ID={self.id}) {self.name}: {self.desc}. Signals=[{self.signals}]"
 
@@ -332,7 +352,8 @@ class OBCLogGroupSpecs:
                 "signals": {
                     "<signal name>": {
                         "id": "0x<ID hex>" | <ID int>,
-                        "description": "<description string>"
+                        "description": "<description string>",
+                        "sinks": ["serial", "fs"] (optional, defaults to all sinks)
                     },
                     ...
                 }
@@ -395,7 +416,18 @@ class OBCLogGroupSpecs:
 
                         signal_desc = signal["description"]
 
-                        log_signals.append(OBCLogSignalSpec(level, signal_name, signal_id, signal_desc, data))
+                        # Sinks
+                        if "sinks" in signal:
+                            sinks = OBCLogSink(0)
+                            for sink in signal["sinks"]:
+                                try:
+                                    sinks |= OBCLogSink[sink.upper()]
+                                except KeyError:
+                                    raise OBCLogSignalSpecError(f"Invalid sink \"{sink}\" in signal \"{signal_name}\"")
+                        else:
+                            sinks = OBCLogSink.ALL
+
+                        log_signals.append(OBCLogSignalSpec(level, signal_name, signal_id, signal_desc, data, sinks))
 
                 specs.append(OBCLogGroupSpec(log_name, log_id, log_desc, log_signals))
 
@@ -3,7 +3,7 @@ import pathlib
 from datetime import datetime
 
 from alea.obcfw.telem import telem_spec
-from alea.obcfw.util import codegen, spec_utils
+from alea.obcfw.util import codegen, spec_utils, data_fmt_codegen
 
 class TelemCodeGen(codegen.CodeGenerator):
     def __init__(self, output_dir: str | pathlib.Path):
@@ -32,6 +32,7 @@ class TelemCodeGen(codegen.CodeGenerator):
             timestamp          = now,
             telem_gen_header = header_path.name,
             telem_specs          = telem_specs,
+            data_fmt_codegen     = data_fmt_codegen,
         )
 
         return (header_path, source_path)
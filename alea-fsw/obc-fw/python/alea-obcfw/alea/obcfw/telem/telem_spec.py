@@ -149,6 +149,12 @@ class OBCTelemSpecs:
 
         return max
 
+    @property
+    def max_resp_size(self) -> int:
+        """Largest serialized response of any telem unit (at least 1)
+        """
+        return max([spec.resp.size for spec in self._specs if spec.has_resp], default=1)
+
     @property
     def max_id(self) -> int:
         """Largest ID any command has in this set of specs.
@@ -10,6 +10,10 @@ telem_err_t telem_impl_{{ telem_spec.name }}(
 static telem_err_t telem_invoke_{{ telem_spec.name }}(const telem_id_t telem_id, const uint8_t priority, const data_fmt_desc_t *resp_desc)
 {%- endmacro %}
 
+{% macro resp_pack_sig(telem_spec) -%}
+static uint32_t resp_pack_{{ telem_spec.name }}(const void *data, uint8_t *buf, uint32_t buf_len)
+{%- endmacro %}
+
 {% macro field_to_str(field) -%}
 {{ field.name }}: {{ field.__class__.__name__|lower }}
 {%- endmacro %}
@@ -0,0 +1,92 @@
+"""Generation of C serializers specialized for a DataFieldList (see data_fmt_pack_func_t in data_fmt.h).
+
+The generated statements read / write each field directly with its big-endian helper from data_fmt.h,
+at an offset known at generation time, instead of interpreting the field descriptors at runtime.
+They must produce exactly the same bytes as data_fmt_serialize_struct / data_fmt_deserialize_struct.
+"""
+
+import itertools
+
+from alea.common.data_field import data_field
+
+# Arrays with more elements than this are packed with a loop rather than one statement per element
+MAX_UNROLLED_ARRAY_LEN = 16
+
+# data_fmt_field_type_t -> (serialized size, name of the data_fmt.h helpers, unsigned C type)
+_TYPE_INFO: dict[str, tuple[int, str, str]] = {
+    "DATA_FMT_FIELD_TYPE_U8"   : (1, None,  "uint8_t"),
+    "DATA_FMT_FIELD_TYPE_U16"  : (2, "u16", "uint16_t"),
+    "DATA_FMT_FIELD_TYPE_U32"  : (4, "u32", "uint32_t"),
+    "DATA_FMT_FIELD_TYPE_U64"  : (8, "u64", "uint64_t"),
+    "DATA_FMT_FIELD_TYPE_F32"  : (4, "f32", "float32"),
+    "DATA_FMT_FIELD_TYPE_F64"  : (8, "f64", "float64"),
+    "DATA_FMT_FIELD_TYPE_BOOL" : (1, None,  "bool"),
+}
+
+def pack_statements(fields: data_field.DataFieldList, struct_var: str) -> list[str]:
+    """C statements serializing the fixed-size fields of struct_var (a pointer) to buf.
+
+    buf must already be checked to hold at least fields.size bytes.
+    """
+    return _statements(fields, struct_var, _pack_element)
+
+def unpack_statements(fields: data_field.DataFieldList, struct_var: str) -> list[str]:
+    """C statements deserializing the fixed-size fields of struct_var (a pointer) from buf.
+
+    buf must already be checked to hold at least fields.size bytes.
+    """
+    return _statements(fields, struct_var, _unpack_element)
+
+def _statements(fields: data_field.DataFieldList, struct_var: str, element_statement) -> list[str]:
+    lines: list[str] = []
+    offset = 0
+
+    for field in fields:
+        if field.size == 0:
+            # Variable size fields are handled by the command implementation
+            continue
+
+        type_enum = field.c_type.type_enum
+        type_name = field.c_type.type_name
+        elem_size = _TYPE_INFO[type_enum][0]
+        member = f"{struct_var}->{field.name}"
+
+        if not field.is_array:
+            lines.append(element_statement(type_enum, type_name, member, str(offset)))
+        elif field.array_len <= MAX_UNROLLED_ARRAY_LEN:
+            for i, index in enumerate(itertools.product(*map(range, field.array_shape))):
+                element = member + "".join(f"[{j}]" for j in index)
+                lines.append(element_statement(type_enum, type_name, element, str(offset + (i * elem_size))))
+        else:
+            # Multi-dimensional arrays are contiguous, so they are walked as a flat array
+            element = f"(({type_name} *)({member}))[i]"
+            lines.append(f"for (uint32_t i = 0; i < {field.array_len}U; i++) {{")
+            lines.append("    " + element_statement(type_enum, type_name, element, f"{offset}U + (i * {elem_size}U)"))
+            lines.append("}")
+
+        offset += field.size
+
+    return lines
+
+def _pack_element(type_enum: str, type_name: str, value: str, offset: str) -> str:
+    _, helper, unsigned_type = _TYPE_INFO[type_enum]
+    value = value.replace(f"(({type_name} *)", f"((const {type_name} *)")
+    cast = f"({unsigned_type})" if (type_name != unsigned_type) else ""
+
+    if type_enum == "DATA_FMT_FIELD_TYPE_BOOL":
+        return f"buf[{offset}] = (uint8_t)({value});"
+    elif helper is None:
+        return f"buf[{offset}] = {cast}{value};"
+    else:
+        return f"data_fmt_{helper}_to_arr_be({cast}{value}, &buf[{offset}]);"
+
+def _unpack_element(type_enum: str, type_name: str, value: str, offset: str) -> str:
+    _, helper, unsigned_type = _TYPE_INFO[type_enum]
+    cast = f"({type_name})" if (type_name != unsigned_type) else ""
+
+    if type_enum == "DATA_FMT_FIELD_TYPE_BOOL":
+        return f"{value} = (buf[{offset}] != 0U);"
+    elif helper is None:
+        return f"{value} = {cast}buf[{offset}];"
+    else:
+        return f"{value} = {cast}data_fmt_arr_be_to_{helper}(&buf[{offset}]);"
@@ -0,0 +1,9 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+FW_DIR="$(dirname "$SCRIPT_DIR")"
+BUILD_DIR="${FW_DIR}/build/bench"
+
+pushd "${FW_DIR}"
+cmake -S test/bench -B "${BUILD_DIR}" && cmake --build "${BUILD_DIR}" && "${BUILD_DIR}/obc_fs_bench" "$@"
+popd
@@ -0,0 +1,330 @@
+/**
+ * @file data_fmt_bench.c
+ * @brief Host benchmark of the generated data_fmt serializers against the descriptor interpreter.
+ *
+ * The command system code is generated from data_fmt_bench_cmds.json (a copy of the argument and
+ * response layouts of a few firmware commands, plus one struct with every field type) and the telemetry
+ * code from the firmware telem.json. For each generated descriptor, the benchmark:
+ *  - checks that the generated (de)serializer produces exactly the same result as the interpreter,
+ *    including rejecting buffers that are too small
+ *  - reports the time per struct and throughput of both, and the speedup
+ *
+ * Times are measured on the host, so only the ratios are meaningful for the OBC.
+ *
+ * Usage: data_fmt_bench [iterations]
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "cmd_sys_gen.h"
+#include "telem_gen.h"
+#include "cmd_sys.h"
+#include "telem.h"
+
+// Utils
+#include "data_fmt.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define BENCH_DEFAULT_ITERATIONS    1000000U
+
+// Larger than any struct / serialized size in the specs
+#define BENCH_MAX_SIZE              512U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef enum {
+    BENCH_DIR_UNPACK,
+    BENCH_DIR_PACK,
+} bench_dir_t;
+
+typedef struct {
+    double interp_ns;
+    double gen_ns;
+    uint32_t bytes;
+} bench_result_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static bool bench_desc(const char *name, const data_fmt_desc_t *desc, bench_dir_t dir, uint32_t iterations, bench_result_t *result);
+static uint32_t serialized_size(const data_fmt_desc_t *desc);
+static double now_ns(void);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+// Keeps the compiler from optimizing the benchmark loops away
+static volatile uint32_t sink = 0;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+int main(int argc, char **argv) {
+    uint32_t iterations = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_ITERATIONS;
+
+    bench_result_t total = { 0 };
+    bool ok = true;
+    char name[64];
+
+    printf("%-28s %6s %12s %12s %10s %10s %8s\n", "struct", "bytes", "interp ns", "gen ns", "interp MB/s", "gen MB/s", "speedup");
+
+    for (uint32_t id = 0; id < CMD_COUNT; id++) {
+        const cmd_sys_cmd_spec_t *spec = &CMD_SPEC_TABLE[id];
+        bench_result_t result;
+
+        if (spec->args != NULL) {
+            snprintf(name, sizeof(name), "cmd %u args (unpack)", (unsigned)id);
+            ok &= bench_desc(name, spec->args, BENCH_DIR_UNPACK, iterations, &result);
+            total.interp_ns += result.interp_ns;
+            total.gen_ns    += result.gen_ns;
+            total.bytes     += result.bytes;
+        }
+
+        if (spec->resp != NULL) {
+            snprintf(name, sizeof(name), "cmd %u resp (pack)", (unsigned)id);
+            ok &= bench_desc(name, spec->resp, BENCH_DIR_PACK, iterations, &result);
+            total.interp_ns += result.interp_ns;
+            total.gen_ns    += result.gen_ns;
+            total.bytes     += result.bytes;
+        }
+    }
+
+    for (uint32_t id = 0; id < TELEM_COUNT; id++) {
+        const telem_spec_t *spec = &TELEM_SPEC_TABLE[id];
+        bench_result_t result;
+
+        if (spec->resp != NULL) {
+            snprintf(name, sizeof(name), "telem %u resp (pack)", (unsigned)id);
+            ok &= bench_desc(name, spec->resp, BENCH_DIR_PACK, iterations, &result);
+            total.interp_ns += result.interp_ns;
+            total.gen_ns    += result.gen_ns;
+            total.bytes     += result.bytes;
+        }
+    }
+
+    printf("%-28s %6u %12.1f %12.1f %10.1f %10.1f %7.2fx\n", "all", (unsigned)total.bytes, total.interp_ns, total.gen_ns,
+           (total.bytes * 1000.0) / total.interp_ns, (total.bytes * 1000.0) / total.gen_ns, total.interp_ns / total.gen_ns);
+
+    if (!ok) {
+        printf("FAILED: the generated serializers don't match the interpreter\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Check and time the generated (de)serializer of desc against the interpreter
+ *
+ * @return true if the generated function matches the interpreter
+ */
+static bool bench_desc(const char *name, const data_fmt_desc_t *desc, bench_dir_t dir, uint32_t iterations, bench_result_t *result) {
+    static uint8_t bytes[BENCH_MAX_SIZE];
+    static uint8_t interp_out[BENCH_MAX_SIZE];
+    static uint8_t gen_out[BENCH_MAX_SIZE];
+    static uint8_t data[BENCH_MAX_SIZE];
+
+    // Same fields without the generated functions
+    data_fmt_desc_t interp_desc = { .fields = desc->fields, .count = desc->count };
+
+    uint32_t size = serialized_size(desc);
+    bool ok = true;
+
+    for (uint32_t i = 0; i < size; i++) {
+        bytes[i] = (uint8_t)rand();
+    }
+
+    memset(interp_out, 0, sizeof(interp_out));
+    memset(gen_out, 0, sizeof(gen_out));
+    memset(data, 0, sizeof(data));
+
+    if (dir == BENCH_DIR_UNPACK) {
+        ok &= (data_fmt_deserialize_struct(interp_out, &interp_desc, bytes, size) == size);
+        ok &= (data_fmt_deserialize_struct(gen_out, desc, bytes, size) == size);
+        ok &= (memcmp(interp_out, gen_out, sizeof(gen_out)) == 0);
+        ok &= (data_fmt_deserialize_struct(gen_out, desc, bytes, (size - 1U)) == 0);
+    } else {
+        // Random bytes aren't valid bools, so the struct is filled by the interpreter
+        ok &= (data_fmt_deserialize_struct(data, &interp_desc, bytes, size) == size);
+        ok &= (data_fmt_serialize_struct(data, &interp_desc, interp_out, size) == size);
+        ok &= (data_fmt_serialize_struct(data, desc, gen_out, size) == size);
+        ok &= (memcmp(interp_out, gen_out, size) == 0);
+        ok &= (data_fmt_serialize_struct(data, desc, gen_out, (size - 1U)) == 0);
+    }
+
+    double start = now_ns();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink += (dir == BENCH_DIR_UNPACK) ? data_fmt_deserialize_struct(interp_out, &interp_desc, bytes, size)
+                                          : data_fmt_serialize_struct(data, &interp_desc, interp_out, size);
+    }
+
+    double mid = now_ns();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink += (dir == BENCH_DIR_UNPACK) ? data_fmt_deserialize_struct(gen_out, desc, bytes, size)
+                                          : data_fmt_serialize_struct(data, desc, gen_out, size);
+    }
+
+    double end = now_ns();
+
+    result->interp_ns = (mid - start) / iterations;
+    result->gen_ns    = (end - mid) / iterations;
+    result->bytes     = size;
+
+    printf("%-28s %6u %12.1f %12.1f %10.1f %10.1f %7.2fx%s\n", name, (unsigned)size, result->interp_ns, result->gen_ns,
+           (size * 1000.0) / result->interp_ns, (size * 1000.0) / result->gen_ns, result->interp_ns / result->gen_ns, ok ? "" : "  MISMATCH");
+
+    return ok;
+}
+
+/**
+ * @brief Serialized size of the fields of desc
+ */
+static uint32_t serialized_size(const data_fmt_desc_t *desc) {
+    static const uint8_t FIELD_SIZES[DATA_FMT_FIELD_TYPE_COUNT] = {
+        [DATA_FMT_FIELD_TYPE_U8]   = 1,
+        [DATA_FMT_FIELD_TYPE_U16]  = 2,
+        [DATA_FMT_FIELD_TYPE_U32]  = 4,
+        [DATA_FMT_FIELD_TYPE_U64]  = 8,
+        [DATA_FMT_FIELD_TYPE_F32]  = 4,
+        [DATA_FMT_FIELD_TYPE_F64]  = 8,
+        [DATA_FMT_FIELD_TYPE_BOOL] = 1,
+    };
+
+    uint32_t size = 0;
+
+    for (uint8_t i = 0; i < desc->count; i++) {
+        size += FIELD_SIZES[desc->fields[i].type] * desc->fields[i].array_len;
+    }
+
+    return size;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+/* -------------- STAND-INS FOR THE FIRMWARE USED BY THE GENERATED CODE -------------- */
+
+cmd_sys_err_t cmd_sys_handle_args(const cmd_sys_cmd_t *cmd, void *args_struct, const data_fmt_desc_t *args_desc, uint32_t args_len, uint8_t *buf) {
+    (void) cmd;
+    (void) args_struct;
+    (void) args_desc;
+    (void) args_len;
+    (void) buf;
+
+    return CMD_SYS_SUCCESS;
+}
+
+cmd_sys_err_t cmd_sys_handle_resp(const cmd_sys_cmd_t *cmd, const void *resp_struct, const data_fmt_desc_t *resp_desc, uint32_t resp_len,
+                                  uint8_t *buf, cmd_sys_resp_code_t resp_code) {
+    (void) cmd;
+    (void) resp_struct;
+    (void) resp_desc;
+    (void) resp_len;
+    (void) buf;
+    (void) resp_code;
+
+    return CMD_SYS_SUCCESS;
+}
+
+cmd_sys_resp_code_t cmd_impl_FS_STATS(const cmd_sys_cmd_t *cmd, cmd_FS_STATS_args_t *args, cmd_FS_STATS_resp_t *resp) {
+    (void) cmd;
+    (void) args;
+    (void) resp;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+cmd_sys_resp_code_t cmd_impl_TEST_COMMS_GET_TELEM(const cmd_sys_cmd_t *cmd, cmd_TEST_COMMS_GET_TELEM_resp_t *resp) {
+    (void) cmd;
+    (void) resp;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+cmd_sys_resp_code_t cmd_impl_TEST_EPS_MEASURE_BUSES(const cmd_sys_cmd_t *cmd, cmd_TEST_EPS_MEASURE_BUSES_resp_t *resp) {
+    (void) cmd;
+    (void) resp;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+cmd_sys_resp_code_t cmd_impl_TEST_QUEST(const cmd_sys_cmd_t *cmd, cmd_TEST_QUEST_args_t *args, cmd_TEST_QUEST_resp_t *resp) {
+    (void) cmd;
+    (void) args;
+    (void) resp;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+cmd_sys_resp_code_t cmd_impl_TEST_ECHO(const cmd_sys_cmd_t *cmd, cmd_TEST_ECHO_args_t *args, cmd_TEST_ECHO_resp_t *resp) {
+    (void) cmd;
+    (void) args;
+    (void) resp;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+cmd_sys_resp_code_t cmd_impl_ALL_TYPES(const cmd_sys_cmd_t *cmd, cmd_ALL_TYPES_args_t *args, cmd_ALL_TYPES_resp_t *resp) {
+    (void) cmd;
+    (void) args;
+    (void) resp;
+
+    return CMD_SYS_RESP_CODE_SUCCESS;
+}
+
+telem_err_t telem_handle_resp(const telem_id_t id, const uint8_t priority, const void *resp_struct, const data_fmt_desc_t *resp_desc,
+                              const uint16_t resp_len, uint8_t *buf) {
+    (void) id;
+    (void) priority;
+    (void) resp_struct;
+    (void) resp_desc;
+    (void) resp_len;
+    (void) buf;
+
+    return TELEM_SUCCESS;
+}
+
+telem_err_t telem_impl_TEST_GET_EPOCH(telem_TEST_GET_EPOCH_resp_t *resp) {
+    (void) resp;
+
+    return TELEM_SUCCESS;
+}
+
+telem_err_t telem_impl_FS_WRITE_STATS(telem_FS_WRITE_STATS_resp_t *resp) {
+    (void) resp;
+
+    return TELEM_SUCCESS;
+}
+
+telem_err_t telem_impl_FS_IO_STATS(telem_FS_IO_STATS_resp_t *resp) {
+    (void) resp;
+
+    return TELEM_SUCCESS;
+}
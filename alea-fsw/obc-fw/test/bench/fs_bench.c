@@ -0,0 +1,584 @@
+/**
+ * @file fs_bench.c
+ * @brief Host benchmark of the OBC filesystem on an emulated MT25QL flash.
+ *
+ * Runs the real obc_filesystem.c and littlefs on top of mt25ql_emu.c. Each workload starts from
+ * a freshly formatted flash and reports, in simulated OBC time:
+ *  - throughput (bytes written per second of flash time) and flash duty cycle
+ *  - flush and sync latency percentiles
+ *  - erase counts and wear (max erases of any sector)
+ *
+ * The benchmark acts as the filesystem task: it flushes the write ring when notified, syncs
+ * the open files every BENCH_SYNC_PERIOD_US and runs a step of the scrubber every
+ * BENCH_POLL_PERIOD_US while there is nothing to flush. All written data is read back and checked, so the
+ * benchmark exits with an error if the filesystem loses or corrupts data.
+ *
+ * Usage: fs_bench [--worst-case] [--no-scrub]
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "mt25ql_emu.h"
+#include "rtos_host.h"
+
+// OBC
+#include "obc_filesystem.h"
+#include "obc_crc.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/* MIBSPI5 runs at VCLK / (prescale + 1) = 48 MHz / 48 */
+#define BENCH_SPI_CLOCK_HZ          1000000U
+
+/* Driver overhead per SPI transaction (mutex, chip select, transfer group trigger) */
+#define BENCH_XFER_OVERHEAD_US      20U
+
+/* Matches FS_SYNC_PERIOD_MS in obc_filesystem.c */
+#define BENCH_SYNC_PERIOD_US        60000000ULL
+
+/* Matches FS_POLL_PERIOD_MS in obc_filesystem.c */
+#define BENCH_POLL_PERIOD_US        2000000ULL
+
+#define BENCH_MAX_FILES             8U
+#define BENCH_MAX_SAMPLES           65536U
+
+#define LOG_FILE_COUNT              4U
+#define LOG_FILE_MAX_SIZE           (64U * 1024U)
+#define LOG_TOTAL_BYTES             (2U * 1024U * 1024U)
+#define LOG_PERIOD_US               20000U
+
+#define TELEM_FILE_COUNT            3U
+#define TELEM_TOTAL_BYTES           (2U * 1024U * 1024U)
+#define TELEM_UNITS_PER_PERIOD      24U
+#define TELEM_PERIOD_US             1000000U
+
+#define LARGE_FILE_BYTES            (4U * 1024U * 1024U)
+#define LARGE_CHUNK_BYTES           4096U
+
+#define MUTEX_TIMEOUT_MS            1000U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Expected contents of a file, tracked as a running CRC
+ *
+ * crc_32_buf returns the final (inverted) CRC, so it is chained by passing back ~crc.
+ */
+typedef struct {
+    char name[24];
+    fs_handle_t handle;
+    uint32_t size;
+    uint32_t crc;
+} bench_file_t;
+
+/**
+ * @brief Latency samples of one operation
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t samples[BENCH_MAX_SAMPLES];
+} bench_latency_t;
+
+typedef struct {
+    const char *name;
+    bool (*run)(void);
+} bench_workload_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static bool workload_log(void);
+static bool workload_telem(void);
+static bool workload_large_file(void);
+
+static bool bench_setup(void);
+static bool bench_add_file(const char *name);
+static bool bench_enqueue(bench_file_t *file, const uint8_t *data, uint32_t size);
+static void bench_service(void);
+static bool bench_verify(void);
+static void bench_report(const char *name);
+
+static void record_latency(bench_latency_t *lat, uint64_t start_us);
+static void print_latency(const char *name, bench_latency_t *lat);
+static int compare_u32(const void *a, const void *b);
+static void fill_random(uint8_t *buf, uint32_t size);
+static uint32_t rand_range(uint32_t min, uint32_t max);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static const bench_workload_t workloads[] = {
+    { "log",        &workload_log        },
+    { "telemetry",  &workload_telem      },
+    { "large file", &workload_large_file },
+};
+
+static mt25ql_emu_cfg_t emu_cfg = {
+    .spi_clock_hz     = BENCH_SPI_CLOCK_HZ,
+    .xfer_overhead_us = BENCH_XFER_OVERHEAD_US,
+    .worst_case       = false,
+};
+
+static bench_file_t files[BENCH_MAX_FILES];
+static uint32_t num_files;
+
+static uint64_t bytes_written;
+static uint64_t last_sync_us;
+static uint64_t last_poll_us;
+static bool scrub_enabled = true;
+static uint64_t read_back_us;
+
+static bench_latency_t flush_lat;
+static bench_latency_t sync_lat;
+static bench_latency_t write_lat;
+static bench_latency_t scrub_lat;
+
+static uint32_t rng_state;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+int main(int argc, char **argv) {
+    bool ok = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--worst-case") == 0) {
+            emu_cfg.worst_case = true;
+        } else if (strcmp(argv[i], "--no-scrub") == 0) {
+            scrub_enabled = false;
+        } else {
+            printf("Usage: %s [--worst-case] [--no-scrub]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("MT25QL emulation: %u Hz SPI, %u us/transaction, %s busy times, scrubber %s\n\n", BENCH_SPI_CLOCK_HZ, BENCH_XFER_OVERHEAD_US,
+           emu_cfg.worst_case ? "worst case" : "typical", scrub_enabled ? "on" : "off");
+
+    for (uint32_t i = 0; i < (sizeof(workloads) / sizeof(workloads[0])); i++) {
+        if (!bench_setup()) {
+            printf("%s: setup failed\n", workloads[i].name);
+            return 1;
+        }
+
+        bool passed = workloads[i].run() && bench_verify();
+        bench_report(workloads[i].name);
+
+        if (!passed) {
+            printf("  FAILED: data written does not match data read back\n");
+            ok = false;
+        }
+
+        printf("\n");
+    }
+
+    mt25ql_emu_deinit();
+
+    return ok ? 0 : 1;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Small log messages appended to rotating log files, like log_sys.
+ */
+static bool workload_log(void) {
+    uint8_t msg[128];
+    uint32_t current = 0;
+
+    for (uint32_t i = 0; i < LOG_FILE_COUNT; i++) {
+        char name[8];
+        snprintf(name, sizeof(name), "log_%u", i);
+
+        if (!bench_add_file(name)) {
+            return false;
+        }
+    }
+
+    while (bytes_written < LOG_TOTAL_BYTES) {
+        uint32_t size = rand_range(16, sizeof(msg));
+        fill_random(msg, size);
+
+        // Move on to the next file and zero it when the current one is full
+        if ((files[current].size + size) > LOG_FILE_MAX_SIZE) {
+            current = (current + 1U) % LOG_FILE_COUNT;
+
+            lfs_file_t file = { 0 };
+
+            if ((fs_open(&file, files[current].name, MUTEX_TIMEOUT_MS) != FS_OK) || (fs_zero(&file) != FS_OK) || (fs_close(&file) != FS_OK)) {
+                return false;
+            }
+
+            files[current].size = 0;
+            files[current].crc = 0;
+        }
+
+        if (!bench_enqueue(&files[current], msg, size)) {
+            return false;
+        }
+
+        mt25ql_emu_advance_us(LOG_PERIOD_US);
+        bench_service();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Telemetry units appended to the priority files once per collection period, like telem.
+ */
+static bool workload_telem(void) {
+    uint8_t unit[96];
+
+    for (uint32_t i = 0; i < TELEM_FILE_COUNT; i++) {
+        char name[24];
+        snprintf(name, sizeof(name), "telem_priority_%u", i);
+
+        if (!bench_add_file(name)) {
+            return false;
+        }
+    }
+
+    while (bytes_written < TELEM_TOTAL_BYTES) {
+        for (uint32_t i = 0; i < TELEM_UNITS_PER_PERIOD; i++) {
+            uint32_t size = rand_range(12, sizeof(unit));
+            fill_random(unit, size);
+
+            if (!bench_enqueue(&files[rand_range(0, TELEM_FILE_COUNT - 1U)], unit, size)) {
+                return false;
+            }
+        }
+
+        // Outer header and stop word of each file
+        for (uint32_t i = 0; i < TELEM_FILE_COUNT; i++) {
+            fill_random(unit, 14);
+
+            if (!bench_enqueue(&files[i], unit, 14)) {
+                return false;
+            }
+        }
+
+        mt25ql_emu_advance_us(TELEM_PERIOD_US);
+        bench_service();
+    }
+
+    return true;
+}
+
+/**
+ * @brief One large file written directly in chunks (e.g. a firmware image upload).
+ */
+static bool workload_large_file(void) {
+    static uint8_t chunk[LARGE_CHUNK_BYTES];
+    lfs_file_t file = { 0 };
+
+    if (!bench_add_file("large")) {
+        return false;
+    }
+
+    if (fs_open(&file, "large", MUTEX_TIMEOUT_MS) != FS_OK) {
+        return false;
+    }
+
+    while (bytes_written < LARGE_FILE_BYTES) {
+        fill_random(chunk, sizeof(chunk));
+
+        uint64_t start_us = mt25ql_emu_time_us();
+
+        if (fs_write(&file, chunk, sizeof(chunk)) != FS_OK) {
+            return false;
+        }
+
+        record_latency(&write_lat, start_us);
+
+        files[0].crc = crc_32_buf(~files[0].crc, chunk, sizeof(chunk));
+        files[0].size += sizeof(chunk);
+        bytes_written += sizeof(chunk);
+    }
+
+    uint64_t start_us = mt25ql_emu_time_us();
+
+    if (fs_close(&file) != FS_OK) {
+        return false;
+    }
+
+    record_latency(&sync_lat, start_us);
+
+    return true;
+}
+
+/**
+ * @brief Formats a fresh emulated flash and resets all counters.
+ */
+static bool bench_setup(void) {
+    if (!mt25ql_emu_init(&emu_cfg)) {
+        return false;
+    }
+
+    // Mounting the blank flash fails, so this formats it
+    if (fs_init() != FS_OK) {
+        return false;
+    }
+
+    filesystem_pre_init();
+    fs_reset_write_stats();
+    fs_reset_io_stats(0);
+    rtos_host_take_notifications();
+    mt25ql_emu_reset_stats();
+
+    num_files = 0;
+    bytes_written = 0;
+    read_back_us = 0;
+    last_sync_us = mt25ql_emu_time_us();
+    last_poll_us = last_sync_us;
+    flush_lat.count = 0;
+    sync_lat.count = 0;
+    write_lat.count = 0;
+    scrub_lat.count = 0;
+    rng_state = 0x12345678U;
+
+    return true;
+}
+
+/**
+ * @brief Adds a file to the workload.
+ */
+static bool bench_add_file(const char *name) {
+    bench_file_t *file = &files[num_files++];
+
+    snprintf(file->name, sizeof(file->name), "%s", name);
+    file->size = 0;
+    file->crc = 0;
+
+    return fs_get_handle(name, &file->handle, MUTEX_TIMEOUT_MS) == FS_OK;
+}
+
+/**
+ * @brief Appends to a file through the write ring, flushing first if the ring is full.
+ */
+static bool bench_enqueue(bench_file_t *file, const uint8_t *data, uint32_t size) {
+    fs_err_t err = fs_write_enqueue(file->handle, data, size);
+
+    if (err == FS_ENQUEUE_ERR) {
+        // The filesystem task would have been notified before the ring filled up
+        bench_service();
+        err = fs_write_enqueue(file->handle, data, size);
+    }
+
+    if (err != FS_OK) {
+        return false;
+    }
+
+    file->crc = crc_32_buf(~file->crc, data, size);
+    file->size += size;
+    bytes_written += size;
+
+    return true;
+}
+
+/**
+ * @brief Does what the filesystem task would do: flush when notified, sync periodically and scrub when idle.
+ */
+static void bench_service(void) {
+    bool notified = (rtos_host_take_notifications() > 0);
+
+    if (notified) {
+        uint64_t start_us = mt25ql_emu_time_us();
+        fs_flush(MUTEX_TIMEOUT_MS);
+        record_latency(&flush_lat, start_us);
+    }
+
+    if ((mt25ql_emu_time_us() - last_sync_us) >= BENCH_SYNC_PERIOD_US) {
+        uint64_t start_us = mt25ql_emu_time_us();
+        fs_sync(MUTEX_TIMEOUT_MS);
+        record_latency(&sync_lat, start_us);
+
+        last_sync_us = mt25ql_emu_time_us();
+    }
+
+    if (scrub_enabled && !notified && ((mt25ql_emu_time_us() - last_poll_us) >= BENCH_POLL_PERIOD_US)) {
+        uint64_t start_us = mt25ql_emu_time_us();
+        fs_scrub(MUTEX_TIMEOUT_MS);
+        record_latency(&scrub_lat, start_us);
+
+        last_poll_us = mt25ql_emu_time_us();
+    }
+}
+
+/**
+ * @brief Flushes everything and checks the contents of all files.
+ */
+static bool bench_verify(void) {
+    static uint8_t buf[LARGE_CHUNK_BYTES];
+    bool ok = true;
+
+    uint64_t start_us = mt25ql_emu_time_us();
+
+    if (fs_force_flush(MUTEX_TIMEOUT_MS) != FS_OK) {
+        return false;
+    }
+
+    record_latency(&flush_lat, start_us);
+    start_us = mt25ql_emu_time_us();
+
+    for (uint32_t i = 0; i < num_files; i++) {
+        lfs_file_t file = { 0 };
+
+        if (fs_open(&file, files[i].name, MUTEX_TIMEOUT_MS) != FS_OK) {
+            return false;
+        }
+
+        uint32_t size = (uint32_t) fs_size(&file);
+        uint32_t crc = 0;
+
+        for (uint32_t pos = 0; pos < size; pos += sizeof(buf)) {
+            uint32_t n = ((size - pos) < sizeof(buf)) ? (size - pos) : sizeof(buf);
+
+            if (fs_read(&file, buf, n) != FS_OK) {
+                return false;
+            }
+
+            crc = crc_32_buf(~crc, buf, n);
+        }
+
+        fs_close(&file);
+
+        if ((size != files[i].size) || (crc != files[i].crc)) {
+            printf("  %s: expected %u bytes (crc 0x%08X), read %u bytes (crc 0x%08X)\n", files[i].name, files[i].size, files[i].crc, size, crc);
+            ok = false;
+        }
+    }
+
+    read_back_us = mt25ql_emu_time_us() - start_us;
+
+    return ok;
+}
+
+/**
+ * @brief Prints the results of a workload.
+ */
+static void bench_report(const char *name) {
+    mt25ql_emu_stats_t stats;
+    fs_write_stats_t write_stats;
+
+    mt25ql_emu_get_stats(&stats);
+    fs_get_write_stats(&write_stats);
+
+    // Flash time excludes the time spent waiting for the producers
+    uint64_t flash_us = 0;
+    uint64_t total_us = stats.time_us;
+
+    for (uint32_t i = 0; i < flush_lat.count; i++) {
+        flash_us += flush_lat.samples[i];
+    }
+
+    for (uint32_t i = 0; i < sync_lat.count; i++) {
+        flash_us += sync_lat.samples[i];
+    }
+
+    for (uint32_t i = 0; i < write_lat.count; i++) {
+        flash_us += write_lat.samples[i];
+    }
+
+    printf("%s\n", name);
+    printf("  written:     %llu bytes in %u files, %.1f s simulated\n", (unsigned long long) bytes_written, num_files, total_us / 1e6);
+    // Scrubbing happens in idle time, so it only counts towards the duty cycle
+    uint64_t scrub_us = 0;
+
+    for (uint32_t i = 0; i < scrub_lat.count; i++) {
+        scrub_us += scrub_lat.samples[i];
+    }
+
+    printf("  throughput:  %.0f bytes/s of flash time, flash busy %.2f%% of the time\n", (flash_us > 0) ? (bytes_written * 1e6 / flash_us) : 0.0,
+           (total_us > 0) ? (100.0 * (flash_us + scrub_us) / total_us) : 0.0);
+    printf("  read back:   %.0f bytes/s\n", (read_back_us > 0) ? (bytes_written * 1e6 / read_back_us) : 0.0);
+    print_latency("flush", &flush_lat);
+    print_latency("sync", &sync_lat);
+    print_latency("fs_write", &write_lat);
+    print_latency("scrub step", &scrub_lat);
+    printf("  erases:      4K %u, 32K %u, 64K %u; %u sectors erased, max %u erases/sector\n", stats.erases[FLASH_OP_ERASE_4K],
+           stats.erases[FLASH_OP_ERASE_32K], stats.erases[FLASH_OP_ERASE_64K], stats.erased_sectors, stats.max_sector_erases);
+    printf("  programs:    %u pages, %llu bytes (%.2fx write amplification)\n", stats.page_programs, (unsigned long long) stats.prog_bytes,
+           (bytes_written > 0) ? ((double) stats.prog_bytes / bytes_written) : 0.0);
+    printf("  reads:       %u, %llu bytes\n", stats.reads, (unsigned long long) stats.read_bytes);
+
+    // As reported by the filesystem itself (see FS_STATS)
+    fs_io_stats_t io_stats;
+    fs_get_io_stats(&io_stats);
+
+    printf("  fs stats:    %u erases, %u pre-erased, %u scrubbed blocks, %u blocks used, flush max %u us mean %u us\n", io_stats.erases,
+           io_stats.erases_skipped, io_stats.scrub_blocks, io_stats.blocks_used, io_stats.flush.max_us,
+           (io_stats.flush.count > 0) ? (io_stats.flush.total_us / io_stats.flush.count) : 0);
+
+    if (write_stats.enqueued > 0) {
+        printf("  write ring:  %u writes, %u dropped, high water %u bytes, %u flush errors\n", write_stats.enqueued, write_stats.dropped,
+               write_stats.high_water, write_stats.flush_errors);
+    }
+
+    if (stats.violations > 0) {
+        printf("  WARNING: %u bytes programmed without an erase\n", stats.violations);
+    }
+}
+
+/**
+ * @brief Records the simulated time elapsed since start_us.
+ */
+static void record_latency(bench_latency_t *lat, uint64_t start_us) {
+    if (lat->count < BENCH_MAX_SAMPLES) {
+        lat->samples[lat->count++] = (uint32_t)(mt25ql_emu_time_us() - start_us);
+    }
+}
+
+/**
+ * @brief Prints the percentiles of a set of latency samples.
+ */
+static void print_latency(const char *name, bench_latency_t *lat) {
+    if (lat->count == 0) {
+        return;
+    }
+
+    qsort(lat->samples, lat->count, sizeof(uint32_t), &compare_u32);
+
+    printf("  %-12s %u samples, p50 %u us, p90 %u us, p99 %u us, max %u us\n", name, lat->count, lat->samples[(lat->count * 50U) / 100U],
+           lat->samples[(lat->count * 90U) / 100U], lat->samples[(lat->count * 99U) / 100U], lat->samples[lat->count - 1U]);
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Fills a buffer with pseudo-random bytes (xorshift32, so every run is the same).
+ */
+static void fill_random(uint8_t *buf, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t) rand_range(0, 255);
+    }
+}
+
+static uint32_t rand_range(uint32_t min, uint32_t max) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return min + (rng_state % (max - min + 1U));
+}
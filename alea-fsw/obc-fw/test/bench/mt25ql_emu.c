@@ -0,0 +1,308 @@
+/**
+ * @file mt25ql_emu.c
+ * @brief Host emulation of the MT25QL external flash.
+ *
+ * The emulator follows the transactions the flash_mt25ql.c driver performs for each call:
+ *  - reads are split into FLASH_MAX_READ_CHUNK_BYTES transactions
+ *  - writes are split at page boundaries, each page needing a write enable, the page program
+ *    and a status poll once the device is ready
+ *  - erases need a write enable, the erase command and a status poll once the device is ready
+ *
+ * Programs AND the data into the image like the real device, so programming without an erase
+ * corrupts data the same way it would on the OBC (and is counted as a violation).
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "mt25ql_emu.h"
+
+// OBC
+#include "obc_flashdefs.h"
+
+// Standard Library
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define FLASH_SIZE_BYTES            (EXT_FLASH_BLOCK_SIZE * EXT_FLASH_BLOCK_COUNT)
+#define FLASH_PAGE_SIZE_BYTES       256U
+#define FLASH_SECTOR_SIZE_BYTES     4096U
+#define FLASH_SECTOR_COUNT          (FLASH_SIZE_BYTES / FLASH_SECTOR_SIZE_BYTES)
+
+/* Same as the driver */
+#define FLASH_MAX_READ_CHUNK_BYTES  1024U
+#define CMD_ADDR_LEN                5U
+
+/* Command byte plus flag status register byte */
+#define STATUS_POLL_LEN             2U
+
+/* Write enable command */
+#define WRITE_ENABLE_LEN            1U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef struct {
+    uint32_t typical_us;
+    uint32_t max_us;
+} op_timing_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static void spi_xfer(uint32_t num_bytes);
+static void busy(flash_op_t op);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+/* Busy times from the MT25QL datasheet (same values as the driver's timing table) */
+static const op_timing_t op_timing[FLASH_OP_COUNT] = {
+    [FLASH_OP_PAGE_PROGRAM] = { 120U,        1800U       },
+    [FLASH_OP_ERASE_4K]     = { 50000U,      400000U     },
+    [FLASH_OP_ERASE_32K]    = { 100000U,     1000000U    },
+    [FLASH_OP_ERASE_64K]    = { 150000U,     1000000U    },
+    [FLASH_OP_ERASE_CHIP]   = { 153000000U,  231000000U  },
+};
+
+static mt25ql_emu_cfg_t emu_cfg;
+
+static uint8_t *image = NULL;
+static uint32_t *sector_erases = NULL;
+
+static uint64_t clock_us = 0;
+static uint64_t clock_frac_ns = 0;
+
+static mt25ql_emu_stats_t stats = { 0 };
+static uint64_t stats_start_us = 0;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Allocates an erased flash image.
+ *
+ * @param cfg: Emulator configuration
+ * @return true if successful, false if the image could not be allocated
+ */
+bool mt25ql_emu_init(const mt25ql_emu_cfg_t *cfg) {
+    mt25ql_emu_deinit();
+
+    image = malloc(FLASH_SIZE_BYTES);
+    sector_erases = calloc(FLASH_SECTOR_COUNT, sizeof(uint32_t));
+
+    if ((image == NULL) || (sector_erases == NULL)) {
+        mt25ql_emu_deinit();
+        return false;
+    }
+
+    memset(image, 0xFF, FLASH_SIZE_BYTES);
+
+    emu_cfg = *cfg;
+    clock_us = 0;
+    clock_frac_ns = 0;
+    mt25ql_emu_reset_stats();
+
+    return true;
+}
+
+/**
+ * @brief Frees the flash image.
+ */
+void mt25ql_emu_deinit(void) {
+    free(image);
+    free(sector_erases);
+
+    image = NULL;
+    sector_erases = NULL;
+}
+
+/**
+ * @brief Current value of the simulated clock.
+ */
+uint64_t mt25ql_emu_time_us(void) {
+    return clock_us;
+}
+
+/**
+ * @brief Advances the simulated clock (e.g. for time spent outside of the flash driver).
+ */
+void mt25ql_emu_advance_us(uint32_t us) {
+    clock_us += us;
+}
+
+/**
+ * @brief Gets the counters accumulated since the last reset.
+ *
+ * @param[out] out: Counters
+ */
+void mt25ql_emu_get_stats(mt25ql_emu_stats_t *out) {
+    *out = stats;
+    out->time_us = clock_us - stats_start_us;
+
+    for (uint32_t i = 0; i < FLASH_SECTOR_COUNT; i++) {
+        if (sector_erases[i] > 0) {
+            out->erased_sectors++;
+        }
+
+        if (sector_erases[i] > out->max_sector_erases) {
+            out->max_sector_erases = sector_erases[i];
+        }
+    }
+}
+
+/**
+ * @brief Resets all counters, including the per-sector erase counts. The flash image and the
+ * simulated clock are kept.
+ */
+void mt25ql_emu_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+    memset(sector_erases, 0, FLASH_SECTOR_COUNT * sizeof(uint32_t));
+    stats_start_us = clock_us;
+}
+
+/**
+ * @brief Number of times a 4 KiB sector was erased since the last reset.
+ */
+uint32_t mt25ql_emu_sector_erases(uint32_t sector) {
+    return (sector < FLASH_SECTOR_COUNT) ? sector_erases[sector] : 0;
+}
+
+/******************************************************************************/
+/*                         O B C _ F L A S H   A P I                          */
+/******************************************************************************/
+
+flash_err_t flash_erase(uint32_t addr, flash_erase_sz_t erase_size) {
+    uint32_t size;
+    flash_op_t op;
+
+    switch (erase_size) {
+    case FULL_CHIP:
+        size = FLASH_SIZE_BYTES;
+        op = FLASH_OP_ERASE_CHIP;
+        break;
+
+    case SECTOR_64K:
+        size = 64U * 1024U;
+        op = FLASH_OP_ERASE_64K;
+        break;
+
+    case SECTOR_32K:
+        size = 32U * 1024U;
+        op = FLASH_OP_ERASE_32K;
+        break;
+
+    case SECTOR_4K:
+        size = FLASH_SECTOR_SIZE_BYTES;
+        op = FLASH_OP_ERASE_4K;
+        break;
+
+    default:
+        return FLASH_INVALID_SIZE_ERR;
+    }
+
+    if (addr >= FLASH_SIZE_BYTES) {
+        return FLASH_ADDR_OR_SIZE_TOO_LARGE_ERR;
+    }
+
+    // The device erases the whole sector/block containing the address
+    addr &= ~(size - 1U);
+
+    memset(&image[addr], 0xFF, size);
+
+    for (uint32_t s = addr / FLASH_SECTOR_SIZE_BYTES; s < (addr + size) / FLASH_SECTOR_SIZE_BYTES; s++) {
+        sector_erases[s]++;
+    }
+
+    spi_xfer(WRITE_ENABLE_LEN);
+    spi_xfer((op == FLASH_OP_ERASE_CHIP) ? 1U : CMD_ADDR_LEN);
+    busy(op);
+
+    stats.erases[op]++;
+
+    return FLASH_OK;
+}
+
+flash_err_t flash_write(uint32_t addr, uint32_t size_bytes, const uint8_t *data) {
+    if ((addr >= FLASH_SIZE_BYTES) || (size_bytes > (FLASH_SIZE_BYTES - addr))) {
+        return FLASH_ADDR_OR_SIZE_TOO_LARGE_ERR;
+    }
+
+    while (size_bytes > 0) {
+        // Page programs wrap around within a page, so the driver splits writes at page boundaries
+        uint32_t page_bytes = FLASH_PAGE_SIZE_BYTES - (addr % FLASH_PAGE_SIZE_BYTES);
+        uint32_t n = (size_bytes < page_bytes) ? size_bytes : page_bytes;
+
+        for (uint32_t i = 0; i < n; i++) {
+            if ((~image[addr + i] & data[i]) != 0) {
+                stats.violations++;
+            }
+
+            image[addr + i] &= data[i];
+        }
+
+        spi_xfer(WRITE_ENABLE_LEN);
+        spi_xfer(CMD_ADDR_LEN + n);
+        busy(FLASH_OP_PAGE_PROGRAM);
+
+        stats.page_programs++;
+        stats.prog_bytes += n;
+
+        addr += n;
+        data += n;
+        size_bytes -= n;
+    }
+
+    return FLASH_OK;
+}
+
+flash_err_t flash_read(uint32_t addr, uint32_t size_bytes, uint8_t *data) {
+    if ((addr >= FLASH_SIZE_BYTES) || (size_bytes > (FLASH_SIZE_BYTES - addr))) {
+        return FLASH_ADDR_OR_SIZE_TOO_LARGE_ERR;
+    }
+
+    memcpy(data, &image[addr], size_bytes);
+
+    stats.reads++;
+    stats.read_bytes += size_bytes;
+
+    while (size_bytes > 0) {
+        uint32_t n = (size_bytes < FLASH_MAX_READ_CHUNK_BYTES) ? size_bytes : FLASH_MAX_READ_CHUNK_BYTES;
+        spi_xfer(CMD_ADDR_LEN + n);
+        size_bytes -= n;
+    }
+
+    return FLASH_OK;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Advances the clock by one SPI transaction.
+ *
+ * @param num_bytes: Number of bytes clocked in the transaction
+ */
+static void spi_xfer(uint32_t num_bytes) {
+    clock_frac_ns += ((uint64_t)num_bytes * 8U * 1000000000U) / emu_cfg.spi_clock_hz;
+    clock_us += emu_cfg.xfer_overhead_us + (clock_frac_ns / 1000U);
+    clock_frac_ns %= 1000U;
+}
+
+/**
+ * @brief Advances the clock by the busy time of an operation and the status poll that ends it.
+ */
+static void busy(flash_op_t op) {
+    clock_us += emu_cfg.worst_case ? op_timing[op].max_us : op_timing[op].typical_us;
+    spi_xfer(STATUS_POLL_LEN);
+}
@@ -0,0 +1,69 @@
+/**
+ * @file mt25ql_emu.h
+ * @brief Host emulation of the MT25QL external flash.
+ *
+ * Implements the obc_flash.h read/write/erase API on top of a RAM image of the flash, so the
+ * real filesystem (bd_read/bd_prog/bd_erase) can run on the host. The time each operation
+ * would take on the OBC is accumulated on a simulated clock and erases are counted per sector.
+ */
+
+#ifndef MT25QL_EMU_H_
+#define MT25QL_EMU_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// OBC
+#include "obc_flash.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Emulator configuration
+ */
+typedef struct {
+    uint32_t spi_clock_hz;      // MIBSPI5 bit clock
+    uint32_t xfer_overhead_us;  // Driver overhead per SPI transaction (chip select, mutex, transfer group setup)
+    bool worst_case;            // Use the datasheet max busy times instead of the typical ones
+} mt25ql_emu_cfg_t;
+
+/**
+ * @brief Emulator counters
+ */
+typedef struct {
+    uint64_t time_us;           // Simulated time spent in flash operations
+
+    uint32_t reads;             // Number of flash_read calls
+    uint64_t read_bytes;
+    uint32_t page_programs;
+    uint64_t prog_bytes;
+    uint32_t erases[FLASH_OP_COUNT]; // Indexed by flash_op_t (only the erase ops are used)
+
+    uint32_t max_sector_erases; // Highest erase count of any 4 KiB sector
+    uint32_t erased_sectors;    // Number of 4 KiB sectors erased at least once
+
+    uint32_t violations;        // Programs that tried to set bits to 1 (programming without an erase)
+} mt25ql_emu_stats_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+bool mt25ql_emu_init(const mt25ql_emu_cfg_t *cfg);
+void mt25ql_emu_deinit(void);
+
+uint64_t mt25ql_emu_time_us(void);
+void mt25ql_emu_advance_us(uint32_t us);
+
+void mt25ql_emu_get_stats(mt25ql_emu_stats_t *stats);
+void mt25ql_emu_reset_stats(void);
+uint32_t mt25ql_emu_sector_erases(uint32_t sector);
+
+#endif /* MT25QL_EMU_H_ */
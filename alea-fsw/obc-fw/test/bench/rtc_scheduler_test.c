@@ -0,0 +1,720 @@
+/**
+ * @file rtc_scheduler_test.c
+ * @brief Host test of the RTC scheduler journal on an emulated MT25QL flash.
+ *
+ * Runs the real rtc_scheduler.c, obc_filesystem.c and littlefs on top of mt25ql_emu.c. Every operation
+ * on the schedule is mirrored in a reference model (a plain array of the items waiting), and the items
+ * popped, listed and reported by the scheduler are checked against it. Reboots are simulated by
+ * unmounting the filesystem and loading the schedule back from its journal.
+ *
+ * The cases cover:
+ *  - the order items run in, with far more items than fit in the heap of hot items
+ *  - the heap staying ahead of the cold items as earlier and later items are added
+ *  - replaying the journal after a reboot, and truncating a torn or corrupt record at its end
+ *  - compaction of the journal, and the list cursors it invalidates
+ *  - reuse of the slots of a full schedule with a new generation in the item ID
+ *  - a long random sequence of adds, cancels, pops, lists and reboots
+ *
+ * Usage: rtc_scheduler_test [seed] [iterations]
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "mt25ql_emu.h"
+#include "rtos_host.h"
+
+// OBC
+#include "obc_filesystem.h"
+#include "rtc_scheduler.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+/* Matches JOURNAL_FILENAME, RECORD_HDR_SIZE and COMPACT_MIN_DONE in rtc_scheduler.c */
+#define JOURNAL_FILENAME            "sched.jnl"
+#define RECORD_HDR_SIZE             16U
+#define COMPACT_MIN_DONE            64U
+
+#define TEST_SPI_CLOCK_HZ           20000000U
+#define TEST_XFER_OVERHEAD_US       10U
+
+#define TEST_TIMEOUT_TICKS          1000U
+#define TEST_LIST_BATCH             16U
+
+#define RANDOM_DEFAULT_SEED         1U
+#define RANDOM_DEFAULT_ITERATIONS   5000U
+
+/* Items are spread over this many seconds after the current time, so many share a timestamp */
+#define RANDOM_TIMESTAMP_SPREAD     400U
+
+/**
+ * @brief Fails the current test case (with the line that failed) if the condition is false
+ */
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("  check failed at line %d: %s\n", __LINE__, #cond);     \
+            return false;                                                   \
+        }                                                                   \
+    } while (0)
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief Item waiting in the reference model of the schedule
+ */
+typedef struct {
+    rtc_scheduler_entry_t entry;
+    uint32_t order;     // Items with the same timestamp and priority run in the order they were added
+    uint8_t data[RTC_SCHEDULER_MAX_DATA_SIZE];
+} model_item_t;
+
+typedef struct {
+    const char *name;
+    bool (*run)(void);
+} test_case_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static bool test_order(void);
+static bool test_hot_cold(void);
+static bool test_replay(void);
+static bool test_compaction(void);
+static bool test_slot_reuse(void);
+static bool test_random(void);
+
+static bool test_setup(void);
+static bool reboot(void);
+static bool append_to_journal(const uint8_t *buf, uint32_t len);
+
+static bool add(uint32_t timestamp, uint8_t priority, uint32_t data_len, uint32_t *id);
+static bool cancel(uint32_t id);
+static bool pop_due(uint32_t now, uint32_t *popped);
+static bool pop_next(uint32_t now, bool *popped);
+static bool check_list(void);
+static bool check_info(void);
+
+static int32_t model_next(void);
+static int32_t model_find(uint32_t id);
+static void model_remove(int32_t index);
+
+static uint32_t rand_range(uint32_t min, uint32_t max);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static const test_case_t test_cases[] = {
+    { "order",       &test_order      },
+    { "hot/cold",    &test_hot_cold   },
+    { "replay",      &test_replay     },
+    { "compaction",  &test_compaction },
+    { "slot reuse",  &test_slot_reuse },
+    { "random",      &test_random     },
+};
+
+static const mt25ql_emu_cfg_t emu_cfg = {
+    .spi_clock_hz     = TEST_SPI_CLOCK_HZ,
+    .xfer_overhead_us = TEST_XFER_OVERHEAD_US,
+    .worst_case       = false,
+};
+
+static model_item_t model[RTC_SCHEDULER_MAX_ITEMS];
+static uint32_t model_count;
+static uint32_t model_order;
+
+static uint32_t random_seed = RANDOM_DEFAULT_SEED;
+static uint32_t random_iterations = RANDOM_DEFAULT_ITERATIONS;
+static uint32_t rng_state;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+int main(int argc, char **argv) {
+    bool ok = true;
+
+    if (argc > 1) {
+        random_seed = (uint32_t) strtoul(argv[1], NULL, 0);
+    }
+
+    if (argc > 2) {
+        random_iterations = (uint32_t) strtoul(argv[2], NULL, 0);
+    }
+
+    if ((argc > 3) || (random_seed == 0)) {
+        printf("Usage: %s [seed (non-zero)] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < (sizeof(test_cases) / sizeof(test_cases[0])); i++) {
+        bool passed = test_setup() && test_cases[i].run();
+
+        printf("%-12s %s\n", test_cases[i].name, passed ? "passed" : "FAILED");
+        ok = ok && passed;
+
+        fs_deinit();
+    }
+
+    mt25ql_emu_deinit();
+
+    return ok ? 0 : 1;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Items run by timestamp, then highest priority first, then in the order they were added.
+ */
+static bool test_order(void) {
+    uint32_t id;
+    uint32_t popped;
+
+    // Three items per timestamp, added lowest priority first
+    for (uint32_t i = 0; i < 90U; i++) {
+        CHECK(add(1000U + ((i * 7U) % 30U), (uint8_t)(i / 30U), 1U + (i % RTC_SCHEDULER_MAX_DATA_SIZE), &id));
+    }
+
+    CHECK(check_info());
+    CHECK(pop_due(999U, &popped) && (popped == 0));
+    CHECK(pop_due(1014U, &popped) && (popped == 45U));
+    CHECK(check_info());
+    CHECK(check_list());
+    CHECK(pop_due(2000U, &popped) && (popped == 45U));
+    CHECK(model_count == 0);
+
+    // An item scheduled in the past is due right away
+    CHECK(add(10U, 0, 1U, &id));
+    CHECK(pop_due(2000U, &popped) && (popped == 1U));
+
+    return check_info();
+}
+
+/**
+ * @brief The heap holds the RTC_SCHEDULER_HOT_ITEMS soonest items, the others are paged in from the journal.
+ *
+ * Items are added later and earlier than those in the heap (so the heap is full of items that must move
+ * to the cold items), and the items are popped in batches that empty the heap exactly.
+ */
+static bool test_hot_cold(void) {
+    uint32_t id;
+    uint32_t popped;
+    rtc_scheduler_info_t info;
+
+    // Later than everything, then earlier than everything, then in between
+    for (uint32_t i = 0; i < (2U * RTC_SCHEDULER_HOT_ITEMS); i++) {
+        CHECK(add(5000U + (i * 10U), 0, 4U, &id));
+    }
+
+    for (uint32_t i = 0; i < (2U * RTC_SCHEDULER_HOT_ITEMS); i++) {
+        CHECK(add(4000U - (i * 10U), 0, 4U, &id));
+    }
+
+    for (uint32_t i = 0; i < (2U * RTC_SCHEDULER_HOT_ITEMS); i++) {
+        CHECK(add(3365U + (i * 20U), 1, 4U, &id));
+    }
+
+    CHECK(model_count == (6U * RTC_SCHEDULER_HOT_ITEMS));
+    CHECK(check_info());
+
+    // Distinct timestamps, so popping up to the timestamp of the 32nd item takes exactly the items in the heap
+    uint32_t timestamps[6U * RTC_SCHEDULER_HOT_ITEMS];
+
+    for (uint32_t i = 0; i < model_count; i++) {
+        timestamps[i] = model[i].entry.timestamp;
+    }
+
+    for (uint32_t i = 1; i < model_count; i++) {
+        for (uint32_t j = i; (j > 0) && (timestamps[j - 1U] > timestamps[j]); j--) {
+            uint32_t t = timestamps[j];
+            timestamps[j] = timestamps[j - 1U];
+            timestamps[j - 1U] = t;
+        }
+    }
+
+    // Popping one more would refill the heap
+    for (uint32_t i = 0; i < RTC_SCHEDULER_HOT_ITEMS; i++) {
+        bool item_popped = false;
+        CHECK(pop_next(timestamps[RTC_SCHEDULER_HOT_ITEMS - 1U], &item_popped) && item_popped);
+    }
+
+    // The next item is only known once the heap is refilled, which get_info leaves to pop_due
+    CHECK(rtc_scheduler_get_info(&info, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK((info.count == model_count) && (info.next_timestamp == RTC_SCHEDULER_TIMESTAMP_UNKNOWN));
+
+    CHECK(pop_due(timestamps[RTC_SCHEDULER_HOT_ITEMS - 1U], &popped) && (popped == 0));
+    CHECK(check_info());
+
+    // An item earlier than the whole heap, and one later than the heap but earlier than some cold items
+    CHECK(add(1U, 0, 4U, &id));
+    CHECK(add(timestamps[(3U * RTC_SCHEDULER_HOT_ITEMS) - 1U] + 1U, 0, 4U, &id));
+    CHECK(check_info());
+
+    for (uint32_t i = 2U; i <= 6U; i++) {
+        CHECK(pop_due(timestamps[(i * RTC_SCHEDULER_HOT_ITEMS) - 1U], &popped));
+        CHECK(check_info());
+    }
+
+    CHECK(model_count == 0);
+
+    return check_info();
+}
+
+/**
+ * @brief The schedule is the same after a reboot, even if the journal ends with a torn or corrupt record.
+ */
+static bool test_replay(void) {
+    uint32_t id;
+    uint32_t popped;
+    rtc_scheduler_info_t before;
+    rtc_scheduler_info_t after;
+
+    for (uint32_t i = 0; i < 100U; i++) {
+        CHECK(add(rand_range(100U, 300U), (uint8_t) rand_range(0, 2U), rand_range(1U, RTC_SCHEDULER_MAX_DATA_SIZE), &id));
+    }
+
+    for (uint32_t i = 0; i < 20U; i++) {
+        CHECK(cancel(model[rand_range(0, model_count - 1U)].entry.id));
+    }
+
+    CHECK(pop_due(150U, &popped));
+    CHECK(reboot());
+    CHECK(check_list());
+    CHECK(check_info());
+
+    // An ADD record cut short by a reset in the middle of the append
+    uint8_t torn[RTC_SCHEDULER_MAX_DATA_SIZE];
+    memset(torn, 'A', sizeof(torn));
+
+    CHECK(rtc_scheduler_get_info(&before, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(append_to_journal(torn, 9U));
+    CHECK(reboot());
+    CHECK(rtc_scheduler_get_info(&after, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(after.journal_size == before.journal_size);
+    CHECK(check_list());
+
+    // A full header that fails its CRC check
+    CHECK(append_to_journal(torn, sizeof(torn)));
+    CHECK(reboot());
+    CHECK(rtc_scheduler_get_info(&after, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(after.journal_size == before.journal_size);
+    CHECK(check_list());
+
+    // The truncated journal is appended to as usual
+    CHECK(add(200U, 0, 8U, &id));
+    CHECK(cancel(model[0].entry.id));
+    CHECK(reboot());
+    CHECK(check_list());
+    CHECK(check_info());
+
+    CHECK(pop_due(1000U, &popped) && (model_count == 0));
+    CHECK(reboot());
+
+    return check_info();
+}
+
+/**
+ * @brief Compacting the journal keeps the items waiting and invalidates the cursors of rtc_scheduler_list.
+ */
+static bool test_compaction(void) {
+    uint32_t id;
+    uint32_t popped;
+    rtc_scheduler_info_t before;
+    rtc_scheduler_info_t after;
+
+    for (uint32_t i = 0; i < 100U; i++) {
+        CHECK(add(100U + i, 0, RTC_SCHEDULER_MAX_DATA_SIZE, &id));
+    }
+
+    CHECK(rtc_scheduler_get_info(&before, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(before.journal_size == (100U * (RECORD_HDR_SIZE + RTC_SCHEDULER_MAX_DATA_SIZE)));
+
+    // A listing in progress
+    uint32_t cursor = RTC_SCHEDULER_LIST_START;
+    rtc_scheduler_entry_t entries[TEST_LIST_BATCH];
+    uint8_t count = 0;
+
+    CHECK(rtc_scheduler_list(&cursor, entries, TEST_LIST_BATCH, &count, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK((count == TEST_LIST_BATCH) && (cursor != RTC_SCHEDULER_LIST_START));
+
+    // Once there are COMPACT_MIN_DONE DONE records (for 36 items waiting), the next pop compacts the journal
+    CHECK(pop_due(169U, &popped) && (popped == 70U));
+    CHECK(rtc_scheduler_get_info(&after, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(after.journal_size == ((36U * (RECORD_HDR_SIZE + RTC_SCHEDULER_MAX_DATA_SIZE)) + (6U * RECORD_HDR_SIZE)));
+
+    uint32_t stale_cursor = cursor;
+    CHECK(rtc_scheduler_list(&stale_cursor, entries, TEST_LIST_BATCH, &count, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_ERR_INVALID_ARGS);
+
+    CHECK(check_list());
+    CHECK(check_info());
+
+    // The compacted journal replays to the same schedule
+    CHECK(reboot());
+    CHECK(check_list());
+    CHECK(check_info());
+
+    // Once everything is cancelled, the journal is compacted down to nothing
+    while (model_count > 0) {
+        CHECK(cancel(model[0].entry.id));
+    }
+
+    for (uint32_t i = 0; i < COMPACT_MIN_DONE; i++) {
+        CHECK(add(1000U, 0, 1U, &id));
+        CHECK(cancel(id));
+    }
+
+    CHECK(pop_due(2000U, &popped) && (popped == 0));
+    CHECK(rtc_scheduler_get_info(&after, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(after.journal_size == 0);
+    CHECK(reboot());
+
+    return check_info();
+}
+
+/**
+ * @brief Once every slot has been used, a slot is reused with a new generation so the old ID stays unknown.
+ */
+static bool test_slot_reuse(void) {
+    uint32_t id;
+    uint32_t old_id;
+    uint32_t popped;
+    bool waiting;
+
+    for (uint32_t i = 0; i < RTC_SCHEDULER_MAX_ITEMS; i++) {
+        CHECK(add(100U + (i % 50U), 0, 1U, &id));
+    }
+
+    uint8_t data = 0;
+    rtc_scheduler_item_t item = { .timestamp = 100U, .priority = 0, .tag = 0, .data_len = 1U, .data = &data };
+    CHECK(rtc_scheduler_add_item(&item, &id, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_FULL);
+
+    old_id = model[RTC_SCHEDULER_MAX_ITEMS / 2U].entry.id;
+    CHECK(cancel(old_id));
+    CHECK(add(100U, 0, 1U, &id));
+
+    // The only free slot was the one just freed
+    CHECK(((id & 0xFFFFU) == (old_id & 0xFFFFU)) && (id != old_id));
+
+    CHECK(rtc_scheduler_is_waiting(old_id, &waiting, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(!waiting);
+    CHECK(rtc_scheduler_is_waiting(id, &waiting, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(waiting);
+    CHECK(rtc_scheduler_cancel(old_id, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_ERR_ID_DNE);
+
+    // The generations are replayed from the journal
+    CHECK(reboot());
+    CHECK(rtc_scheduler_is_waiting(old_id, &waiting, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(!waiting);
+    CHECK(rtc_scheduler_cancel(old_id, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_ERR_ID_DNE);
+    CHECK(check_list());
+
+    CHECK(pop_due(1000U, &popped) && (popped == RTC_SCHEDULER_MAX_ITEMS));
+    CHECK(rtc_scheduler_is_waiting(id, &waiting, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(!waiting);
+
+    return check_info();
+}
+
+/**
+ * @brief Random adds, cancels, pops, lists and reboots, checked against the model after every operation.
+ */
+static bool test_random(void) {
+    uint32_t now = 1000U;
+    uint32_t id;
+    uint32_t popped;
+    uint32_t reboots = 0;
+
+    rng_state = random_seed;
+
+    for (uint32_t i = 0; i < random_iterations; i++) {
+        uint32_t op = rand_range(0, 99U);
+
+        if (op < 45U) {
+            if (model_count < RTC_SCHEDULER_MAX_ITEMS) {
+                CHECK(add(now + rand_range(0, RANDOM_TIMESTAMP_SPREAD), (uint8_t) rand_range(0, 2U),
+                          rand_range(1U, RTC_SCHEDULER_MAX_DATA_SIZE), &id));
+            }
+        } else if (op < 55U) {
+            if (model_count > 0) {
+                CHECK(cancel(model[rand_range(0, model_count - 1U)].entry.id));
+            } else {
+                CHECK(rtc_scheduler_cancel(0x00FFFFFFU, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_ERR_ID_DNE);
+            }
+        } else if (op < 96U) {
+            now += rand_range(0, 2U);
+            CHECK(pop_due(now, &popped));
+        } else if (op < 97U) {
+            CHECK(reboot());
+            reboots++;
+        } else if (op < 98U) {
+            CHECK(check_list());
+        } else {
+            CHECK(check_info());
+        }
+    }
+
+    CHECK(reboot());
+    CHECK(check_list());
+    CHECK(pop_due(now + RANDOM_TIMESTAMP_SPREAD, &popped));
+    CHECK(model_count == 0);
+
+    printf("  seed %u, %u iterations, %u reboots\n", random_seed, random_iterations, reboots);
+
+    return check_info();
+}
+
+/**
+ * @brief Formats a fresh emulated flash and loads an empty schedule.
+ */
+static bool test_setup(void) {
+    if (!mt25ql_emu_init(&emu_cfg)) {
+        return false;
+    }
+
+    // Mounting the blank flash fails, so this formats it
+    if (fs_init() != FS_OK) {
+        return false;
+    }
+
+    filesystem_pre_init();
+    rtc_scheduler_pre_init();
+
+    model_count = 0;
+    model_order = 0;
+    rng_state = 0x12345678U;
+
+    return (rtc_scheduler_load(TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+}
+
+/**
+ * @brief Remounts the filesystem and loads the schedule from the journal, as after a reset.
+ */
+static bool reboot(void) {
+    if ((fs_deinit() != FS_OK) || (fs_init() != FS_OK)) {
+        return false;
+    }
+
+    filesystem_pre_init();
+    rtc_scheduler_pre_init();
+
+    return (rtc_scheduler_load(TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+}
+
+/**
+ * @brief Appends raw bytes to the journal, like a record whose append was interrupted.
+ */
+static bool append_to_journal(const uint8_t *buf, uint32_t len) {
+    lfs_file_t file;
+
+    if (fs_open(&file, JOURNAL_FILENAME, TEST_TIMEOUT_TICKS) != FS_OK) {
+        return false;
+    }
+
+    bool ok = (fs_seek(&file, 0, FS_SEEK_END) == FS_OK) && (fs_write(&file, buf, len) == FS_OK);
+
+    return (fs_close(&file) == FS_OK) && ok;
+}
+
+/**
+ * @brief Adds an item with random data to the schedule and the model.
+ */
+static bool add(uint32_t timestamp, uint8_t priority, uint32_t data_len, uint32_t *id) {
+    model_item_t *model_item = &model[model_count];
+
+    for (uint32_t i = 0; i < data_len; i++) {
+        model_item->data[i] = (uint8_t) rand_range(0, 255U);
+    }
+
+    rtc_scheduler_item_t item = {
+        .timestamp = timestamp,
+        .priority  = priority,
+        .tag       = (uint8_t) model_order,
+        .data_len  = data_len,
+        .data      = model_item->data,
+    };
+
+    CHECK(rtc_scheduler_add_item(&item, id, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(model_find(*id) < 0);
+
+    model_item->entry.id        = *id;
+    model_item->entry.timestamp = timestamp;
+    model_item->entry.priority  = priority;
+    model_item->entry.tag       = item.tag;
+    model_item->entry.data_len  = (uint8_t) data_len;
+    model_item->order           = model_order++;
+    model_count++;
+
+    return true;
+}
+
+static bool cancel(uint32_t id) {
+    int32_t index = model_find(id);
+
+    CHECK(index >= 0);
+    CHECK(rtc_scheduler_cancel(id, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(rtc_scheduler_cancel(id, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_ERR_ID_DNE);
+
+    model_remove(index);
+
+    return true;
+}
+
+/**
+ * @brief Pops all the items due at now, checking that they come out in the order of the model.
+ */
+static bool pop_due(uint32_t now, uint32_t *popped) {
+    bool item_popped = true;
+
+    *popped = 0;
+
+    while (item_popped) {
+        CHECK(pop_next(now, &item_popped));
+
+        if (item_popped) {
+            (*popped)++;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Pops the next item if it is due at now, checking that it is the next item of the model.
+ */
+static bool pop_next(uint32_t now, bool *popped) {
+    static uint8_t data[RTC_SCHEDULER_MAX_DATA_SIZE];
+
+    rtc_scheduler_entry_t entry;
+    rtc_scheduler_err_t err = rtc_scheduler_pop_due(now, &entry, data, TEST_TIMEOUT_TICKS);
+    int32_t next = model_next();
+
+    *popped = false;
+
+    if (err == RTC_SCHEDULER_NONE_DUE) {
+        CHECK((next < 0) || (model[next].entry.timestamp > now));
+        return true;
+    }
+
+    CHECK(err == RTC_SCHEDULER_SUCCESS);
+    CHECK(next >= 0);
+
+    const model_item_t *expected = &model[next];
+    CHECK(memcmp(&entry, &expected->entry, sizeof(entry)) == 0);
+    CHECK(memcmp(data, expected->data, entry.data_len) == 0);
+
+    model_remove(next);
+    *popped = true;
+
+    return true;
+}
+
+/**
+ * @brief Lists the schedule in batches and checks that it holds exactly the items of the model.
+ */
+static bool check_list(void) {
+    uint32_t cursor = RTC_SCHEDULER_LIST_START;
+    uint32_t listed = 0;
+    uint32_t last_order = 0;
+
+    do {
+        rtc_scheduler_entry_t entries[TEST_LIST_BATCH];
+        uint8_t count = 0;
+
+        CHECK(rtc_scheduler_list(&cursor, entries, TEST_LIST_BATCH, &count, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+
+        for (uint8_t i = 0; i < count; i++) {
+            int32_t index = model_find(entries[i].id);
+
+            // Items are listed in the order they were added
+            CHECK(index >= 0);
+            CHECK(memcmp(&entries[i], &model[index].entry, sizeof(entries[i])) == 0);
+            CHECK((listed == 0) || (model[index].order > last_order));
+
+            last_order = model[index].order;
+            listed++;
+        }
+    } while (cursor != RTC_SCHEDULER_LIST_START);
+
+    CHECK(listed == model_count);
+
+    return true;
+}
+
+static bool check_info(void) {
+    rtc_scheduler_info_t info;
+    int32_t next = model_next();
+
+    CHECK(rtc_scheduler_get_info(&info, TEST_TIMEOUT_TICKS) == RTC_SCHEDULER_SUCCESS);
+    CHECK(info.count == model_count);
+    CHECK(info.capacity == RTC_SCHEDULER_MAX_ITEMS);
+
+    if (next < 0) {
+        CHECK(info.next_timestamp == 0);
+    } else {
+        CHECK((info.next_timestamp == model[next].entry.timestamp) || (info.next_timestamp == RTC_SCHEDULER_TIMESTAMP_UNKNOWN));
+    }
+
+    return true;
+}
+
+/**
+ * @brief Index of the item of the model that runs next, or -1 if the model is empty.
+ */
+static int32_t model_next(void) {
+    int32_t best = -1;
+
+    for (uint32_t i = 0; i < model_count; i++) {
+        const model_item_t *item = &model[i];
+        const model_item_t *other = (best >= 0) ? &model[best] : NULL;
+
+        if ((other == NULL) || (item->entry.timestamp < other->entry.timestamp) ||
+                ((item->entry.timestamp == other->entry.timestamp) &&
+                 ((item->entry.priority > other->entry.priority) ||
+                  ((item->entry.priority == other->entry.priority) && (item->order < other->order))))) {
+            best = (int32_t) i;
+        }
+    }
+
+    return best;
+}
+
+static int32_t model_find(uint32_t id) {
+    for (uint32_t i = 0; i < model_count; i++) {
+        if (model[i].entry.id == id) {
+            return (int32_t) i;
+        }
+    }
+
+    return -1;
+}
+
+static void model_remove(int32_t index) {
+    model_count--;
+    model[index] = model[model_count];
+}
+
+/**
+ * @brief Pseudo-random number in [min, max] (xorshift32, so every run with the same seed is the same).
+ */
+static uint32_t rand_range(uint32_t min, uint32_t max) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return min + (rng_state % (max - min + 1U));
+}
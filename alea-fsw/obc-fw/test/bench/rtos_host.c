@@ -0,0 +1,128 @@
+/**
+ * @file rtos_host.c
+ * @brief Single-threaded stand-ins for the FreeRTOS and obc_rtos functions used by the filesystem.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "rtos_host.h"
+#include "mt25ql_emu.h"
+
+// OBC
+#include "obc_rtos.h"
+#include "obc_watchdog.h"
+
+// FreeRTOS
+#include "rtos.h"
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static uint32_t notifications = 0;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Returns and clears the number of task notifications given since the last call.
+ */
+uint32_t rtos_host_take_notifications(void) {
+    uint32_t n = notifications;
+    notifications = 0;
+    return n;
+}
+
+/**
+ * @brief Microsecond clock used by the filesystem to time flushes (see FS_TIME_US in CMakeLists.txt).
+ */
+uint32_t rtos_host_time_us(void) {
+    return (uint32_t) mt25ql_emu_time_us();
+}
+
+/******************************************************************************/
+/*                          F R E E R T O S   A P I                           */
+/******************************************************************************/
+
+QueueHandle_t MPU_xQueueCreateMutexStatic(const uint8_t ucQueueType, StaticQueue_t *pxStaticQueue) {
+    (void) ucQueueType;
+
+    return (QueueHandle_t) pxStaticQueue;
+}
+
+BaseType_t MPU_xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait) {
+    (void) xQueue;
+    (void) xTicksToWait;
+
+    return pdTRUE;
+}
+
+BaseType_t MPU_xQueueGenericSend(QueueHandle_t xQueue, const void *const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition) {
+    (void) xQueue;
+    (void) pvItemToQueue;
+    (void) xTicksToWait;
+    (void) xCopyPosition;
+
+    return pdTRUE;
+}
+
+BaseType_t MPU_xTaskGenericNotify(TaskHandle_t xTaskToNotify, UBaseType_t uxIndexToNotify, uint32_t ulValue, eNotifyAction eAction,
+                                  uint32_t *pulPreviousNotificationValue) {
+    (void) xTaskToNotify;
+    (void) uxIndexToNotify;
+    (void) ulValue;
+    (void) eAction;
+    (void) pulPreviousNotificationValue;
+
+    notifications++;
+    return pdTRUE;
+}
+
+uint32_t MPU_ulTaskGenericNotifyTake(UBaseType_t uxIndexToWaitOn, BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    (void) uxIndexToWaitOn;
+    (void) xClearCountOnExit;
+    (void) xTicksToWait;
+
+    return rtos_host_take_notifications();
+}
+
+TickType_t MPU_xTaskGetTickCount(void) {
+    return (TickType_t)(mt25ql_emu_time_us() / (1000000U / configTICK_RATE_HZ));
+}
+
+BaseType_t MPU_xTaskDelayUntil(TickType_t *const pxPreviousWakeTime, const TickType_t xTimeIncrement) {
+    *pxPreviousWakeTime += xTimeIncrement;
+    return pdTRUE;
+}
+
+TaskHandle_t MPU_xTaskGetHandle(const char *pcNameToQuery) {
+    (void) pcNameToQuery;
+
+    return NULL;
+}
+
+void vPortEnterCritical(void) {
+}
+
+void vPortExitCritical(void) {
+}
+
+/******************************************************************************/
+/*                          O B C _ R T O S   A P I                           */
+/******************************************************************************/
+
+TaskHandle_t obc_rtos_create_task(obc_task_id_t id, TaskFunction_t task_func, void *const params, obc_watchdog_action_t watchdog_action) {
+    (void) id;
+    (void) task_func;
+    (void) params;
+    (void) watchdog_action;
+
+    return NULL;
+}
+
+void obc_watchdog_pet(obc_task_id_t task_id) {
+    (void) task_id;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file rtos_host.h
+ * @brief Single-threaded stand-ins for the FreeRTOS and obc_rtos functions used by the filesystem.
+ *
+ * The tick count follows the simulated clock of the flash emulator. Mutexes are always available
+ * and task notifications are counted so the benchmark can act as the filesystem task.
+ */
+
+#ifndef RTOS_HOST_H_
+#define RTOS_HOST_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// Standard Library
+#include <stdint.h>
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+uint32_t rtos_host_take_notifications(void);
+uint32_t rtos_host_time_us(void);
+
+#endif /* RTOS_HOST_H_ */
@@ -0,0 +1,264 @@
+/**
+ * @file mibspi_emu.c
+ * @brief Host emulation of the MIBSPI ports for unit tests.
+ *
+ * Support files are linked into every test, so this only depends on headers.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "mibspi_emu.h"
+
+// Standard Library
+#include <stddef.h>
+#include <string.h>
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef struct {
+    const mibspi_tg_t *tg;
+    uint32_t len;
+} emu_tg_t;
+
+typedef struct {
+    gioPORT_t *cs_port;
+    uint32_t cs_pin;
+    mibspi_emu_device_t device;
+} emu_device_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static mibspi_err_t emu_select(const mibspi_tg_t *tg);
+static void emu_deselect(const mibspi_tg_t *tg);
+static mibspi_err_t emu_xfer(const mibspi_tg_t *tg, const uint8_t *tx_data, uint8_t *rx_data, uint32_t timeout);
+static uint32_t emu_tg_len(const mibspi_tg_t *tg);
+
+static const emu_device_t *find_device(const mibspi_tg_t *tg);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static const mibspi_async_backend_t emu_backend = {
+    .select   = &emu_select,
+    .deselect = &emu_deselect,
+    .xfer     = &emu_xfer,
+    .tg_len   = &emu_tg_len,
+};
+
+static emu_tg_t tgs[MIBSPI_EMU_MAX_TGS];
+static uint32_t num_tgs = 0;
+
+static emu_device_t devices[MIBSPI_EMU_MAX_DEVICES];
+static uint32_t num_devices = 0;
+
+// Chip select currently held (NULL if none)
+static const emu_device_t *selected = NULL;
+static bool cs_held = false;
+
+// Error injection
+static uint32_t fail_xfer_index = UINT32_MAX;
+static mibspi_err_t fail_xfer_err = MIBSPI_NO_ERR;
+static mibspi_err_t fail_select_err = MIBSPI_NO_ERR;
+
+static mibspi_emu_stats_t stats;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+/**
+ * @brief Remove all transfer groups and devices, and clear the counters and injected errors.
+ */
+void mibspi_emu_reset(void) {
+    num_tgs     = 0;
+    num_devices = 0;
+    selected    = NULL;
+    cs_held     = false;
+
+    fail_xfer_index = UINT32_MAX;
+    fail_xfer_err   = MIBSPI_NO_ERR;
+    fail_select_err = MIBSPI_NO_ERR;
+
+    memset(&stats, 0, sizeof(stats));
+}
+
+/**
+ * @brief Get the backend to install with @ref tms_mibspi_async_set_backend.
+ */
+const mibspi_async_backend_t *mibspi_emu_backend(void) {
+    return &emu_backend;
+}
+
+/**
+ * @brief Register the length of a transfer group. Unregistered transfer groups have length 0.
+ *
+ * @param tg: Transfer group
+ * @param len: Length in bytes
+ * @return True if registered, false if there is no space left
+ */
+bool mibspi_emu_add_tg(const mibspi_tg_t *tg, uint32_t len) {
+    if (num_tgs == MIBSPI_EMU_MAX_TGS) {
+        return false;
+    }
+
+    tgs[num_tgs].tg  = tg;
+    tgs[num_tgs].len = len;
+    num_tgs++;
+
+    return true;
+}
+
+/**
+ * @brief Attach a device to a chip select. Transfers on a chip select without a device
+ * receive 0xFF.
+ *
+ * @param cs_port: Chip select GIO port
+ * @param cs_pin: Chip select pin
+ * @param device: Device callbacks (copied)
+ * @return True if attached, false if there is no space left
+ */
+bool mibspi_emu_attach(gioPORT_t *cs_port, uint32_t cs_pin, const mibspi_emu_device_t *device) {
+    if (num_devices == MIBSPI_EMU_MAX_DEVICES) {
+        return false;
+    }
+
+    devices[num_devices].cs_port = cs_port;
+    devices[num_devices].cs_pin  = cs_pin;
+    devices[num_devices].device  = *device;
+    num_devices++;
+
+    return true;
+}
+
+/**
+ * @brief Make a transfer group execution fail.
+ *
+ * @param xfer_index: Index of the execution to fail, counted from the last reset
+ * @param err: Error to return
+ */
+void mibspi_emu_fail_xfer(uint32_t xfer_index, mibspi_err_t err) {
+    fail_xfer_index = xfer_index;
+    fail_xfer_err   = err;
+}
+
+/**
+ * @brief Make every chip select fail with err (MIBSPI_NO_ERR to stop failing).
+ */
+void mibspi_emu_fail_select(mibspi_err_t err) {
+    fail_select_err = err;
+}
+
+/**
+ * @brief Get the emulator counters.
+ */
+void mibspi_emu_get_stats(mibspi_emu_stats_t *out) {
+    *out = stats;
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+/**
+ * @brief Hold the chip select of a transfer group and select its device.
+ */
+static mibspi_err_t emu_select(const mibspi_tg_t *tg) {
+    if (fail_select_err != MIBSPI_NO_ERR) {
+        return fail_select_err;
+    }
+
+    stats.selects++;
+    selected = find_device(tg);
+    cs_held  = true;
+
+    if ((selected != NULL) && (selected->device.select != NULL)) {
+        selected->device.select(selected->device.context);
+    }
+
+    return MIBSPI_NO_ERR;
+}
+
+/**
+ * @brief Release the chip select and deselect the device.
+ */
+static void emu_deselect(const mibspi_tg_t *tg) {
+    stats.deselects++;
+
+    if (!cs_held || (find_device(tg) != selected)) {
+        stats.cs_errors++;
+    }
+
+    if ((selected != NULL) && (selected->device.deselect != NULL)) {
+        selected->device.deselect(selected->device.context);
+    }
+
+    selected = NULL;
+    cs_held  = false;
+}
+
+/**
+ * @brief Execute a transfer group, exchanging each byte with the selected device.
+ */
+static mibspi_err_t emu_xfer(const mibspi_tg_t *tg, const uint8_t *tx_data, uint8_t *rx_data, uint32_t timeout) {
+    (void)timeout;
+
+    if (stats.xfers++ == fail_xfer_index) {
+        return fail_xfer_err;
+    }
+
+    if (!cs_held || (find_device(tg) != selected)) {
+        stats.cs_errors++;
+    }
+
+    const uint32_t len = emu_tg_len(tg);
+
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t tx_byte = (tx_data != NULL) ? tx_data[i] : 0U;
+        uint8_t rx_byte = 0xFFU;
+
+        if ((selected != NULL) && (selected->device.exchange != NULL)) {
+            rx_byte = selected->device.exchange(selected->device.context, tx_byte);
+        }
+
+        if (rx_data != NULL) {
+            rx_data[i] = rx_byte;
+        }
+    }
+
+    stats.bytes += len;
+
+    return MIBSPI_NO_ERR;
+}
+
+/**
+ * @brief Length of a registered transfer group, 0 if it isn't registered.
+ */
+static uint32_t emu_tg_len(const mibspi_tg_t *tg) {
+    for (uint32_t i = 0; i < num_tgs; i++) {
+        if (tgs[i].tg == tg) {
+            return tgs[i].len;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Device attached to the chip select of a transfer group, NULL if there is none.
+ */
+static const emu_device_t *find_device(const mibspi_tg_t *tg) {
+    for (uint32_t i = 0; i < num_devices; i++) {
+        if ((devices[i].cs_port == tg->cs_port) && (devices[i].cs_pin == tg->cs_pin)) {
+            return &devices[i];
+        }
+    }
+
+    return NULL;
+}
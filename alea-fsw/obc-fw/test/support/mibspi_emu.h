@@ -0,0 +1,71 @@
+/**
+ * @file mibspi_emu.h
+ * @brief Host emulation of the MIBSPI ports for unit tests.
+ *
+ * Provides a @ref mibspi_async_backend_t that executes requests against emulated devices
+ * instead of the MIBSPI peripherals. Each device is attached to a chip select and exchanges
+ * one byte at a time, so device models can follow a transaction byte by byte.
+ */
+
+#ifndef MIBSPI_EMU_H_
+#define MIBSPI_EMU_H_
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+// OBC
+#include "tms_mibspi_async.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define MIBSPI_EMU_MAX_TGS     16U
+#define MIBSPI_EMU_MAX_DEVICES 4U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+/**
+ * @brief An emulated device. Any callback may be NULL.
+ */
+typedef struct {
+    void (*select)(void *context);
+    uint8_t (*exchange)(void *context, uint8_t tx_byte); // Returns the byte shifted out by the device
+    void (*deselect)(void *context);
+    void *context;
+} mibspi_emu_device_t;
+
+/**
+ * @brief Emulator counters
+ */
+typedef struct {
+    uint32_t selects;
+    uint32_t deselects;
+    uint32_t xfers;       // Transfer group executions
+    uint32_t bytes;
+    uint32_t cs_errors;   // Transfers or deselects without the chip select held
+} mibspi_emu_stats_t;
+
+/******************************************************************************/
+/*                             F U N C T I O N S                              */
+/******************************************************************************/
+
+void mibspi_emu_reset(void);
+const mibspi_async_backend_t *mibspi_emu_backend(void);
+
+bool mibspi_emu_add_tg(const mibspi_tg_t *tg, uint32_t len);
+bool mibspi_emu_attach(gioPORT_t *cs_port, uint32_t cs_pin, const mibspi_emu_device_t *device);
+
+void mibspi_emu_fail_xfer(uint32_t xfer_index, mibspi_err_t err);
+void mibspi_emu_fail_select(mibspi_err_t err);
+
+void mibspi_emu_get_stats(mibspi_emu_stats_t *stats);
+
+#endif /* MIBSPI_EMU_H_ */
@@ -541,3 +541,45 @@ void test_deserialize_struct_ok(void) {
     TEST_ASSERT_EQUAL(test_struct.b_2[0],   data.b_2[0]);
     TEST_ASSERT_EQUAL(test_struct.b_2[1],   data.b_2[1]);
 }
+
+// Specialized Struct Tests
+
+static uint32_t stub_pack(const void *data, uint8_t *buf, uint32_t buf_len) {
+    buf[0] = *(const uint8_t *)data;
+    return buf_len;
+}
+
+static uint32_t stub_unpack(void *data, const uint8_t *buf, uint32_t buf_len) {
+    *(uint8_t *)data = buf[0];
+    return buf_len;
+}
+
+void test_serialize_struct_specialized(void) {
+    const data_fmt_desc_t specialized_desc = { .fields = field_descs, .count = LEN(field_descs), .pack = &stub_pack };
+    uint8_t buf[4] = { 0 };
+
+    uint32_t len = data_fmt_serialize_struct(&test_struct, &specialized_desc, buf, sizeof(buf));
+
+    TEST_ASSERT_EQUAL(sizeof(buf), len);
+    TEST_ASSERT_EQUAL(test_struct.u8_1, buf[0]);
+}
+
+void test_deserialize_struct_specialized(void) {
+    const data_fmt_desc_t specialized_desc = { .fields = field_descs, .count = LEN(field_descs), .unpack = &stub_unpack };
+    test_struct_t data = { 0 };
+
+    uint32_t len = data_fmt_deserialize_struct(&data, &specialized_desc, expected_serialized, 4);
+
+    TEST_ASSERT_EQUAL(4, len);
+    TEST_ASSERT_EQUAL(expected_serialized[0], data.u8_1);
+    TEST_ASSERT_EQUAL(0, data.u16_1);
+}
+
+void test_serialize_struct_specialized_nullData(void) {
+    const data_fmt_desc_t specialized_desc = { .fields = field_descs, .count = LEN(field_descs), .pack = &stub_pack };
+    uint8_t buf[4] = { 0 };
+
+    uint32_t len = data_fmt_serialize_struct(NULL, &specialized_desc, buf, sizeof(buf));
+
+    TEST_ASSERT_EQUAL(0, len);
+}
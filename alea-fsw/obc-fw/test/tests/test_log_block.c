@@ -0,0 +1,112 @@
+/**
+ * @file test_log_block.c
+ * @brief Unit tests for log_block.c module
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "unity.h"
+
+#include "log_block.h"
+#include "obc_crc.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static log_block_t block;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+void setUp(void) {
+    log_block_init(&block);
+}
+
+void tearDown(void) {
+}
+
+// Varint Tests
+
+void test_varint_round_trip(void) {
+    const uint32_t values[] = { 0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF, 0x200000, 0x0FFFFFFF, 0x10000000, 0xFFFFFFFF };
+    const uint32_t sizes[]  = { 1, 1, 1,    2,    2,      3,      3,        4,        4,          5,          5          };
+
+    for (uint32_t i = 0; i < (sizeof(values) / sizeof(values[0])); i++) {
+        uint8_t buf[LOG_BLOCK_VARINT_MAX_SIZE];
+        uint32_t value = 0;
+
+        TEST_ASSERT_EQUAL(sizes[i], log_block_varint_encode(values[i], buf));
+        TEST_ASSERT_EQUAL(sizes[i], log_block_varint_decode(buf, sizes[i], &value));
+        TEST_ASSERT_EQUAL(values[i], value);
+    }
+}
+
+void test_varint_decode_truncated(void) {
+    const uint8_t buf[] = { 0x80, 0x80 };
+    uint32_t value = 0;
+
+    TEST_ASSERT_EQUAL(0, log_block_varint_decode(buf, sizeof(buf), &value));
+}
+
+// Block Tests
+
+void test_empty_block(void) {
+    TEST_ASSERT_EQUAL(0, log_block_finish(&block));
+}
+
+void test_block_encoding(void) {
+    const uint8_t payload[] = { 0xAA, 0xBB };
+
+    TEST_ASSERT_TRUE(log_block_add(&block, 1000, 74, 3, payload, sizeof(payload)));
+    TEST_ASSERT_TRUE(log_block_add(&block, 1002, 5, 0, NULL, 0));
+    TEST_ASSERT_TRUE(log_block_add(&block, 999, 5, 1, NULL, 0));
+
+    const uint8_t expected[] = {
+        0xBE, 0xEE, 0xEE, 0xEF,             // sync
+        0x00, 0x0E,                         // len
+        0x00, 0x00, 0x03, 0xE8,             // epoch 1000
+        0x00, 74, 3, 2, 0xAA, 0xBB,         // delta 0
+        0x04, 5, 0, 0,                      // delta +2
+        0x05, 5, 1, 0,                      // delta -3
+    };
+
+    uint32_t size = log_block_finish(&block);
+
+    TEST_ASSERT_EQUAL(sizeof(expected) + LOG_BLOCK_CRC_SIZE, size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, block.buf, sizeof(expected));
+
+    uint32_t crc = crc_32_buf(CRC32_SEED, &expected[LOG_BLOCK_SYNC_SIZE], sizeof(expected) - LOG_BLOCK_SYNC_SIZE);
+    const uint8_t crc_be[] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(crc_be, &block.buf[sizeof(expected)], LOG_BLOCK_CRC_SIZE);
+
+    TEST_ASSERT_EQUAL(3, block.record_count);
+    TEST_ASSERT_EQUAL(999, block.epoch_min);
+    TEST_ASSERT_EQUAL(1002, block.epoch_max);
+    TEST_ASSERT_EQUAL((1UL << (74 % 32)) | (1UL << 5), block.log_id_mask);
+}
+
+void test_block_full(void) {
+    uint8_t payload[119] = { 0 };
+
+    // Each record is 4 bytes of varints and the payload
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(log_block_add(&block, 0, 1, 1, payload, sizeof(payload)));
+    }
+
+    uint32_t remaining = LOG_BLOCK_MAX_DATA_SIZE - (4U * (4U + sizeof(payload)));
+
+    TEST_ASSERT_FALSE(log_block_add(&block, 0, 1, 1, payload, (uint8_t)(remaining - 4U + 1U)));
+    TEST_ASSERT_EQUAL(4, block.record_count);
+
+    TEST_ASSERT_TRUE(log_block_add(&block, 0, 1, 1, payload, (uint8_t)(remaining - 4U)));
+    TEST_ASSERT_EQUAL(LOG_BLOCK_MAX_SIZE, log_block_finish(&block));
+}
@@ -0,0 +1,388 @@
+/**
+ * @file test_mibspi_async.c
+ * @brief Unit tests for tms_mibspi_async.c module
+ *
+ * Requests are executed with @ref tms_mibspi_async_run on the emulated MIBSPI backend
+ * (test/support/mibspi_emu.c). The RTOS, watchdog and MIBSPI hardware functions are mocked
+ * and must not be called.
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "unity.h"
+
+#include "tms_mibspi_async.h"
+#include "mibspi_emu.h"
+
+// Mocks
+#include "mock_mpu_prototypes.h"
+#include "mock_obc_rtos.h"
+#include "mock_obc_watchdog.h"
+#include "mock_tms_mibspi.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define DEV_LOG_SIZE 64
+
+#define DEV_CS_PIN   7U
+#define OTHER_CS_PIN 8U
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static void dev_select(void *context);
+static uint8_t dev_exchange(void *context, uint8_t tx_byte);
+static void dev_deselect(void *context);
+
+static void count_callback(mibspi_async_req_t *req);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+// Transfer groups on the device chip select
+static const mibspi_tg_t tg_1byte  = {.reg = mibspiREG5, .transfer_group = 0, .cs_port = gioPORTA, .cs_pin = DEV_CS_PIN};
+static const mibspi_tg_t tg_2bytes = {.reg = mibspiREG5, .transfer_group = 1, .cs_port = gioPORTA, .cs_pin = DEV_CS_PIN};
+static const mibspi_tg_t tg_4bytes = {.reg = mibspiREG5, .transfer_group = 2, .cs_port = gioPORTA, .cs_pin = DEV_CS_PIN};
+
+// Same chip select on another port, and another chip select on the same port
+static const mibspi_tg_t tg_other_port = {.reg = mibspiREG3, .transfer_group = 0, .cs_port = gioPORTA, .cs_pin = DEV_CS_PIN};
+static const mibspi_tg_t tg_other_cs   = {.reg = mibspiREG5, .transfer_group = 3, .cs_port = gioPORTA, .cs_pin = OTHER_CS_PIN};
+
+static const mibspi_stream_tg_t stream_tgs[] = {
+    {&tg_4bytes, 4},
+    {&tg_2bytes, 2},
+    {&tg_1byte,  1},
+};
+
+// Emulated device: records the bytes it receives and returns its byte count XOR 0xA5
+static uint8_t dev_log[DEV_LOG_SIZE];
+static uint32_t dev_log_len = 0;
+static uint32_t dev_selects = 0;
+static uint32_t dev_deselects = 0;
+
+static const mibspi_emu_device_t dev = {
+    .select   = &dev_select,
+    .exchange = &dev_exchange,
+    .deselect = &dev_deselect,
+    .context  = NULL,
+};
+
+static uint32_t callbacks = 0;
+static bool done_in_callback = true;
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+void setUp(void) {
+    mibspi_emu_reset();
+    TEST_ASSERT_TRUE(mibspi_emu_add_tg(&tg_1byte, 1));
+    TEST_ASSERT_TRUE(mibspi_emu_add_tg(&tg_2bytes, 2));
+    TEST_ASSERT_TRUE(mibspi_emu_add_tg(&tg_4bytes, 4));
+    TEST_ASSERT_TRUE(mibspi_emu_add_tg(&tg_other_port, 1));
+    TEST_ASSERT_TRUE(mibspi_emu_add_tg(&tg_other_cs, 1));
+    TEST_ASSERT_TRUE(mibspi_emu_attach(gioPORTA, DEV_CS_PIN, &dev));
+    tms_mibspi_async_set_backend(mibspi_emu_backend());
+
+    memset(dev_log, 0, sizeof(dev_log));
+    dev_log_len   = 0;
+    dev_selects   = 0;
+    dev_deselects = 0;
+
+    callbacks        = 0;
+    done_in_callback = true;
+}
+
+void tearDown(void) {
+    tms_mibspi_async_set_backend(NULL);
+}
+
+// Execution tests
+
+void test_run_chainHoldsChipSelect(void) {
+    const uint8_t cmd[1]  = {0x03};
+    const uint8_t addr[2] = {0x12, 0x34};
+    uint8_t rx[4];
+
+    const mibspi_seg_t segs[] = {
+        {.tg = &tg_1byte,  .tx_data = cmd,  .rx_data = NULL, .len = 1},
+        {.tg = &tg_2bytes, .tx_data = addr, .rx_data = NULL, .len = 2},
+        {.tg = &tg_4bytes, .tx_data = NULL, .rx_data = rx,   .len = 4},
+    };
+    mibspi_async_req_t req = {.segs = segs, .num_segs = 3, .timeout = 10};
+
+    TEST_ASSERT_EQUAL(MIBSPI_NO_ERR, tms_mibspi_async_run(&req));
+    TEST_ASSERT_TRUE(req.done);
+    TEST_ASSERT_EQUAL(MIBSPI_NO_ERR, req.err);
+
+    // One chip select cycle for the whole chain
+    TEST_ASSERT_EQUAL(1, dev_selects);
+    TEST_ASSERT_EQUAL(1, dev_deselects);
+
+    const uint8_t expected_log[] = {0x03, 0x12, 0x34, 0x00, 0x00, 0x00, 0x00};
+    TEST_ASSERT_EQUAL(sizeof(expected_log), dev_log_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_log, dev_log, sizeof(expected_log));
+
+    const uint8_t expected_rx[] = {3 ^ 0xA5, 4 ^ 0xA5, 5 ^ 0xA5, 6 ^ 0xA5};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_rx, rx, sizeof(expected_rx));
+
+    mibspi_emu_stats_t stats;
+    mibspi_emu_get_stats(&stats);
+    TEST_ASSERT_EQUAL(3, stats.xfers);
+    TEST_ASSERT_EQUAL(0, stats.cs_errors);
+}
+
+void test_run_segmentRepeatsTransferGroup(void) {
+    uint8_t tx[12];
+    for (uint32_t i = 0; i < sizeof(tx); i++) {
+        tx[i] = (uint8_t)(i + 1);
+    }
+
+    const mibspi_seg_t seg = {.tg = &tg_4bytes, .tx_data = tx, .rx_data = NULL, .len = sizeof(tx)};
+    mibspi_async_req_t req = {.segs = &seg, .num_segs = 1, .timeout = 10};
+
+    TEST_ASSERT_EQUAL(MIBSPI_NO_ERR, tms_mibspi_async_run(&req));
+
+    TEST_ASSERT_EQUAL(1, dev_selects);
+    TEST_ASSERT_EQUAL(sizeof(tx), dev_log_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(tx, dev_log, sizeof(tx));
+
+    mibspi_emu_stats_t stats;
+    mibspi_emu_get_stats(&stats);
+    TEST_ASSERT_EQUAL(3, stats.xfers);
+}
+
+void test_run_errorStopsChain(void) {
+    uint8_t tx[8] = {0};
+
+    const mibspi_seg_t segs[] = {
+        {.tg = &tg_1byte,  .tx_data = tx, .rx_data = NULL, .len = 1},
+        {.tg = &tg_2bytes, .tx_data = tx, .rx_data = NULL, .len = 4},
+        {.tg = &tg_1byte,  .tx_data = tx, .rx_data = NULL, .len = 1},
+    };
+    mibspi_async_req_t req = {.segs = segs, .num_segs = 3, .timeout = 10, .cb = &count_callback};
+
+    // Fail the first execution of the 2 byte transfer group
+    mibspi_emu_fail_xfer(1, MIBSPI_TIMEOUT);
+
+    TEST_ASSERT_EQUAL(MIBSPI_TIMEOUT, tms_mibspi_async_run(&req));
+    TEST_ASSERT_TRUE(req.done);
+    TEST_ASSERT_EQUAL(MIBSPI_TIMEOUT, req.err);
+    TEST_ASSERT_EQUAL(1, callbacks);
+
+    // Only the first segment reached the device, and the chip select was released
+    TEST_ASSERT_EQUAL(1, dev_log_len);
+    TEST_ASSERT_EQUAL(1, dev_deselects);
+
+    mibspi_emu_stats_t stats;
+    mibspi_emu_get_stats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.xfers);
+}
+
+void test_run_selectError(void) {
+    const mibspi_seg_t seg = {.tg = &tg_1byte, .tx_data = NULL, .rx_data = NULL, .len = 1};
+    mibspi_async_req_t req = {.segs = &seg, .num_segs = 1, .timeout = 10, .cb = &count_callback};
+
+    mibspi_emu_fail_select(MIBSPI_MUTEX_GRAB_ERR);
+
+    TEST_ASSERT_EQUAL(MIBSPI_MUTEX_GRAB_ERR, tms_mibspi_async_run(&req));
+    TEST_ASSERT_TRUE(req.done);
+    TEST_ASSERT_EQUAL(1, callbacks);
+
+    // Nothing reached the device and the chip select was never taken
+    TEST_ASSERT_EQUAL(0, dev_selects);
+    TEST_ASSERT_EQUAL(0, dev_deselects);
+}
+
+void test_run_callbackBeforeDone(void) {
+    const mibspi_seg_t seg = {.tg = &tg_2bytes, .tx_data = NULL, .rx_data = NULL, .len = 2};
+    mibspi_async_req_t req = {.segs = &seg, .num_segs = 1, .timeout = 10, .cb = &count_callback};
+
+    TEST_ASSERT_EQUAL(MIBSPI_NO_ERR, tms_mibspi_async_run(&req));
+    TEST_ASSERT_EQUAL(1, callbacks);
+
+    // The request must not be marked done while its callback runs
+    TEST_ASSERT_FALSE(done_in_callback);
+    TEST_ASSERT_TRUE(req.done);
+}
+
+// Validation tests
+
+void test_run_nullRequest(void) {
+    TEST_ASSERT_EQUAL(MIBSPI_INVALID_REQ_ERR, tms_mibspi_async_run(NULL));
+}
+
+void test_run_noSegments(void) {
+    const mibspi_seg_t seg = {.tg = &tg_1byte, .tx_data = NULL, .rx_data = NULL, .len = 1};
+    mibspi_async_req_t req = {.segs = &seg, .num_segs = 0, .timeout = 10};
+
+    TEST_ASSERT_EQUAL(MIBSPI_INVALID_REQ_ERR, tms_mibspi_async_run(&req));
+    TEST_ASSERT_EQUAL(0, dev_selects);
+}
+
+void test_run_mixedPorts(void) {
+    const mibspi_seg_t segs[] = {
+        {.tg = &tg_1byte,      .tx_data = NULL, .rx_data = NULL, .len = 1},
+        {.tg = &tg_other_port, .tx_data = NULL, .rx_data = NULL, .len = 1},
+    };
+    mibspi_async_req_t req = {.segs = segs, .num_segs = 2, .timeout = 10, .cb = &count_callback};
+
+    TEST_ASSERT_EQUAL(MIBSPI_INVALID_REQ_ERR, tms_mibspi_async_run(&req));
+
+    // Invalid requests still complete, without touching the bus
+    TEST_ASSERT_TRUE(req.done);
+    TEST_ASSERT_EQUAL(MIBSPI_INVALID_REQ_ERR, req.err);
+    TEST_ASSERT_EQUAL(1, callbacks);
+    TEST_ASSERT_EQUAL(0, dev_selects);
+}
+
+void test_run_mixedChipSelects(void) {
+    const mibspi_seg_t segs[] = {
+        {.tg = &tg_1byte,    .tx_data = NULL, .rx_data = NULL, .len = 1},
+        {.tg = &tg_other_cs, .tx_data = NULL, .rx_data = NULL, .len = 1},
+    };
+    mibspi_async_req_t req = {.segs = segs, .num_segs = 2, .timeout = 10};
+
+    TEST_ASSERT_EQUAL(MIBSPI_INVALID_REQ_ERR, tms_mibspi_async_run(&req));
+    TEST_ASSERT_EQUAL(0, dev_selects);
+}
+
+void test_run_lengthNotMultiple(void) {
+    const mibspi_seg_t seg = {.tg = &tg_4bytes, .tx_data = NULL, .rx_data = NULL, .len = 6};
+    mibspi_async_req_t req = {.segs = &seg, .num_segs = 1, .timeout = 10};
+
+    TEST_ASSERT_EQUAL(MIBSPI_INVALID_REQ_ERR, tms_mibspi_async_run(&req));
+    TEST_ASSERT_EQUAL(0, dev_selects);
+}
+
+void test_run_zeroLength(void) {
+    const mibspi_seg_t seg = {.tg = &tg_4bytes, .tx_data = NULL, .rx_data = NULL, .len = 0};
+    mibspi_async_req_t req = {.segs = &seg, .num_segs = 1, .timeout = 10};
+
+    TEST_ASSERT_EQUAL(MIBSPI_INVALID_REQ_ERR, tms_mibspi_async_run(&req));
+    TEST_ASSERT_EQUAL(0, dev_selects);
+}
+
+// Stream segment tests
+
+void test_streamSegs_largestFirst(void) {
+    uint8_t tx[11] = {0};
+    mibspi_seg_t segs[3];
+
+    uint8_t num_segs = tms_mibspi_async_stream_segs(segs, 3, stream_tgs, 3, tx, NULL, sizeof(tx));
+    TEST_ASSERT_EQUAL(3, num_segs);
+
+    TEST_ASSERT_EQUAL_PTR(&tg_4bytes, segs[0].tg);
+    TEST_ASSERT_EQUAL(8, segs[0].len);
+    TEST_ASSERT_EQUAL_PTR(&tx[0], segs[0].tx_data);
+    TEST_ASSERT_NULL(segs[0].rx_data);
+
+    TEST_ASSERT_EQUAL_PTR(&tg_2bytes, segs[1].tg);
+    TEST_ASSERT_EQUAL(2, segs[1].len);
+    TEST_ASSERT_EQUAL_PTR(&tx[8], segs[1].tx_data);
+
+    TEST_ASSERT_EQUAL_PTR(&tg_1byte, segs[2].tg);
+    TEST_ASSERT_EQUAL(1, segs[2].len);
+    TEST_ASSERT_EQUAL_PTR(&tx[10], segs[2].tx_data);
+}
+
+void test_streamSegs_skipsUnusedGroups(void) {
+    uint8_t rx[5];
+    mibspi_seg_t segs[3];
+
+    uint8_t num_segs = tms_mibspi_async_stream_segs(segs, 3, stream_tgs, 3, NULL, rx, sizeof(rx));
+    TEST_ASSERT_EQUAL(2, num_segs);
+
+    TEST_ASSERT_EQUAL_PTR(&tg_4bytes, segs[0].tg);
+    TEST_ASSERT_EQUAL(4, segs[0].len);
+    TEST_ASSERT_EQUAL_PTR(&rx[0], segs[0].rx_data);
+    TEST_ASSERT_NULL(segs[0].tx_data);
+
+    TEST_ASSERT_EQUAL_PTR(&tg_1byte, segs[1].tg);
+    TEST_ASSERT_EQUAL(1, segs[1].len);
+    TEST_ASSERT_EQUAL_PTR(&rx[4], segs[1].rx_data);
+}
+
+void test_streamSegs_tooFewSegments(void) {
+    mibspi_seg_t segs[2];
+
+    TEST_ASSERT_EQUAL(0, tms_mibspi_async_stream_segs(segs, 2, stream_tgs, 3, NULL, NULL, 7));
+}
+
+void test_streamSegs_notComposable(void) {
+    mibspi_seg_t segs[2];
+
+    // Without the 1 byte transfer group, odd lengths can't be streamed
+    TEST_ASSERT_EQUAL(0, tms_mibspi_async_stream_segs(segs, 2, stream_tgs, 2, NULL, NULL, 7));
+}
+
+void test_streamSegs_zeroLength(void) {
+    mibspi_seg_t segs[3];
+
+    TEST_ASSERT_EQUAL(0, tms_mibspi_async_stream_segs(segs, 3, stream_tgs, 3, NULL, NULL, 0));
+}
+
+void test_streamSegs_runOnDevice(void) {
+    const uint8_t cmd[1] = {0x02};
+    uint8_t tx[7];
+    for (uint32_t i = 0; i < sizeof(tx); i++) {
+        tx[i] = (uint8_t)(0x10 + i);
+    }
+
+    mibspi_seg_t segs[4] = {
+        {.tg = &tg_1byte, .tx_data = cmd, .rx_data = NULL, .len = 1},
+    };
+    uint8_t num_segs = 1 + tms_mibspi_async_stream_segs(&segs[1], 3, stream_tgs, 3, tx, NULL, sizeof(tx));
+    TEST_ASSERT_EQUAL(4, num_segs);
+
+    mibspi_async_req_t req = {.segs = segs, .num_segs = num_segs, .timeout = 10};
+    TEST_ASSERT_EQUAL(MIBSPI_NO_ERR, tms_mibspi_async_run(&req));
+
+    TEST_ASSERT_EQUAL(1, dev_selects);
+    TEST_ASSERT_EQUAL(1 + sizeof(tx), dev_log_len);
+    TEST_ASSERT_EQUAL(0x02, dev_log[0]);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(tx, &dev_log[1], sizeof(tx));
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+static void dev_select(void *context) {
+    (void)context;
+    dev_selects++;
+}
+
+static uint8_t dev_exchange(void *context, uint8_t tx_byte) {
+    (void)context;
+
+    uint8_t rx_byte = (uint8_t)(dev_log_len ^ 0xA5);
+
+    if (dev_log_len < DEV_LOG_SIZE) {
+        dev_log[dev_log_len] = tx_byte;
+    }
+
+    dev_log_len++;
+    return rx_byte;
+}
+
+static void dev_deselect(void *context) {
+    (void)context;
+    dev_deselects++;
+}
+
+static void count_callback(mibspi_async_req_t *req) {
+    callbacks++;
+    done_in_callback = req->done;
+}
@@ -0,0 +1,229 @@
+/**
+ * @file test_min_heap.c
+ * @brief Unit tests for min_heap.c module
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "unity.h"
+#include "min_heap.h"
+
+// Standard Library
+#include <stdint.h>
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+#define HEAP_LEN 7U
+
+/******************************************************************************/
+/*                              T Y P E D E F S                               */
+/******************************************************************************/
+
+typedef struct {
+    uint32_t key;
+    uint32_t tag;
+} item_t;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static bool goes_before(const void *a, const void *b);
+static void push(uint32_t key, uint32_t tag);
+static uint32_t pop_key(void);
+static uint16_t find_tag(uint32_t tag);
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static item_t heap_storage[HEAP_LEN] = { 0 };
+
+min_heap_t heap = {
+    .size        = HEAP_LEN,
+    .item_size   = sizeof(item_t),
+    .goes_before = &goes_before,
+    .items       = (uint8_t *)heap_storage,
+    .count       = 0,
+};
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+void setUp(void) {
+    memset(heap_storage, 0, sizeof(heap_storage));
+    min_heap_init(&heap);
+}
+
+void tearDown(void) {
+}
+
+// isEmpty / isFull tests
+void test_isEmpty_empty() {
+    TEST_ASSERT_TRUE(min_heap_is_empty(&heap));
+    TEST_ASSERT_FALSE(min_heap_is_full(&heap));
+    TEST_ASSERT_NULL(min_heap_peek(&heap));
+}
+
+void test_isFull_full() {
+    for (uint32_t i = 0; i < HEAP_LEN; i++) {
+        TEST_ASSERT_TRUE(min_heap_push(&heap, &(item_t){ .key = i }));
+    }
+
+    TEST_ASSERT_TRUE(min_heap_is_full(&heap));
+    TEST_ASSERT_FALSE(min_heap_push(&heap, &(item_t){ .key = HEAP_LEN }));
+    TEST_ASSERT_EQUAL(HEAP_LEN, heap.count);
+}
+
+// Pop tests
+void test_pop_empty() {
+    item_t item;
+    TEST_ASSERT_FALSE(min_heap_pop(&heap, &item));
+}
+
+void test_pop_sorted() {
+    const uint32_t keys[HEAP_LEN] = { 40, 20, 10, 50, 30, 70, 60 };
+
+    for (uint32_t i = 0; i < HEAP_LEN; i++) {
+        push(keys[i], i);
+    }
+
+    for (uint32_t i = 1; i <= HEAP_LEN; i++) {
+        TEST_ASSERT_EQUAL(i * 10U, pop_key());
+    }
+
+    TEST_ASSERT_TRUE(min_heap_is_empty(&heap));
+}
+
+void test_pop_duplicates() {
+    push(5, 0);
+    push(3, 1);
+    push(5, 2);
+    push(3, 3);
+
+    TEST_ASSERT_EQUAL(3, pop_key());
+    TEST_ASSERT_EQUAL(3, pop_key());
+    TEST_ASSERT_EQUAL(5, pop_key());
+    TEST_ASSERT_EQUAL(5, pop_key());
+}
+
+void test_pop_interleaved() {
+    push(30, 0);
+    push(10, 1);
+    TEST_ASSERT_EQUAL(10, pop_key());
+
+    push(20, 2);
+    push(5, 3);
+    TEST_ASSERT_EQUAL(5, pop_key());
+    TEST_ASSERT_EQUAL(20, pop_key());
+    TEST_ASSERT_EQUAL(30, pop_key());
+}
+
+// Remove tests
+void test_remove_outOfRange() {
+    push(1, 0);
+    TEST_ASSERT_FALSE(min_heap_remove(&heap, 1, NULL));
+    TEST_ASSERT_NULL(min_heap_get(&heap, 1));
+}
+
+void test_remove_byTag() {
+    const uint32_t keys[HEAP_LEN] = { 40, 20, 10, 50, 30, 70, 60 };
+
+    for (uint32_t i = 0; i < HEAP_LEN; i++) {
+        push(keys[i], i);
+    }
+
+    // Remove the items with keys 20 and 60
+    item_t removed;
+    TEST_ASSERT_TRUE(min_heap_remove(&heap, find_tag(1), &removed));
+    TEST_ASSERT_EQUAL(20, removed.key);
+    TEST_ASSERT_TRUE(min_heap_remove(&heap, find_tag(6), &removed));
+    TEST_ASSERT_EQUAL(60, removed.key);
+
+    TEST_ASSERT_EQUAL(HEAP_LEN - 2U, heap.count);
+    TEST_ASSERT_EQUAL(10, pop_key());
+    TEST_ASSERT_EQUAL(30, pop_key());
+    TEST_ASSERT_EQUAL(40, pop_key());
+    TEST_ASSERT_EQUAL(50, pop_key());
+    TEST_ASSERT_EQUAL(70, pop_key());
+}
+
+void test_remove_movesLastUp() {
+    // The last item (50) replaces a leaf in the other subtree and has to move up
+    push(10, 0);
+    push(100, 1);
+    push(20, 2);
+    push(110, 3);
+    push(120, 4);
+    push(30, 5);
+    push(50, 6);
+
+    // Position 3 holds 110 (left subtree)
+    TEST_ASSERT_EQUAL(110, ((const item_t *)min_heap_get(&heap, 3))->key);
+    TEST_ASSERT_TRUE(min_heap_remove(&heap, 3, NULL));
+    TEST_ASSERT_EQUAL(50, ((const item_t *)min_heap_get(&heap, 1))->key);
+
+    TEST_ASSERT_EQUAL(10, pop_key());
+    TEST_ASSERT_EQUAL(20, pop_key());
+    TEST_ASSERT_EQUAL(30, pop_key());
+    TEST_ASSERT_EQUAL(50, pop_key());
+    TEST_ASSERT_EQUAL(100, pop_key());
+    TEST_ASSERT_EQUAL(120, pop_key());
+}
+
+// Find last tests
+void test_findLast_empty() {
+    TEST_ASSERT_EQUAL(0, min_heap_find_last(&heap));
+}
+
+void test_findLast() {
+    const uint32_t keys[HEAP_LEN] = { 40, 20, 10, 70, 30, 50, 60 };
+
+    for (uint32_t i = 0; i < HEAP_LEN; i++) {
+        push(keys[i], i);
+
+        uint16_t last = min_heap_find_last(&heap);
+        uint32_t max = 0;
+
+        for (uint32_t j = 0; j <= i; j++) {
+            max = (keys[j] > max) ? keys[j] : max;
+        }
+
+        TEST_ASSERT_EQUAL(max, ((const item_t *)min_heap_get(&heap, last))->key);
+    }
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+static bool goes_before(const void *a, const void *b) {
+    return ((const item_t *)a)->key < ((const item_t *)b)->key;
+}
+
+static void push(uint32_t key, uint32_t tag) {
+    item_t item = { .key = key, .tag = tag };
+    TEST_ASSERT_TRUE(min_heap_push(&heap, &item));
+}
+
+static uint32_t pop_key(void) {
+    item_t item = { 0 };
+    TEST_ASSERT_TRUE(min_heap_pop(&heap, &item));
+    return item.key;
+}
+
+static uint16_t find_tag(uint32_t tag) {
+    for (uint16_t pos = 0; pos < heap.count; pos++) {
+        if (((const item_t *)min_heap_get(&heap, pos))->tag == tag) {
+            return pos;
+        }
+    }
+
+    return heap.count;
+}
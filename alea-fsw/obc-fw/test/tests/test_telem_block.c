@@ -0,0 +1,218 @@
+/**
+ * @file test_telem_block.c
+ * @brief Unit tests for telem_block.c module
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "unity.h"
+
+#include "telem_block.h"
+#include "log_block.h"
+#include "obc_crc.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static telem_block_t block;
+static uint8_t buf[TELEM_BLOCK_MAX_SIZE];
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+void setUp(void) {
+    telem_block_init(&block);
+    memset(buf, 0, sizeof(buf));
+}
+
+void tearDown(void) {
+}
+
+void test_empty_block(void) {
+    TEST_ASSERT_EQUAL(0, telem_block_encode(&block, 0, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0, telem_block_encode(&block, 1, buf, sizeof(buf)));
+}
+
+void test_block_encoding(void) {
+    const uint8_t a0[] = { 0x00, 0x00, 0x01, 0x00 };
+    const uint8_t a1[] = { 0x00, 0x00, 0x01, 0x05 };
+    const uint8_t b0[] = { 0x12, 0x34 };
+
+    TEST_ASSERT_TRUE(telem_block_add(&block, 7, a0, sizeof(a0)));
+    TEST_ASSERT_TRUE(telem_block_add(&block, 300, b0, sizeof(b0)));
+    TEST_ASSERT_TRUE(telem_block_end_frame(&block, 1000));
+    TEST_ASSERT_TRUE(telem_block_add(&block, 7, a1, sizeof(a1)));
+    TEST_ASSERT_TRUE(telem_block_end_frame(&block, 998));
+
+    const uint8_t expected[] = {
+        0x00, 0x00, 0x03, 0xE8,             // epoch 1000
+        0x02,                               // num_frames
+        0x03,                               // delta -2
+        0x02,                               // num_columns
+        0x00, 0x07, 0x04, 0xC0,             // id 7, size 4, frames 0 and 1
+        0x00, 0x00, 0x01, 0x00,             // first sample
+        0x10, 0x05,                         // byte 3 changed
+        0x01, 0x2C, 0x02, 0x80,             // id 300, size 2, frame 0
+        0x12, 0x34,                         // first sample
+        0x00, 0x17,                         // len
+    };
+
+    uint32_t size = telem_block_encode(&block, 2, buf, sizeof(buf));
+
+    TEST_ASSERT_EQUAL(sizeof(expected) + 8U, size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buf, sizeof(expected));
+
+    uint32_t crc = crc_32_buf(CRC32_SEED, expected, sizeof(expected));
+    const uint8_t trailer[] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc, 0xA1, 0xEA, 0x50, 0xBC };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(trailer, &buf[sizeof(expected)], sizeof(trailer));
+}
+
+void test_block_check(void) {
+    const uint8_t sample[] = { 1, 2, 3 };
+
+    TEST_ASSERT_TRUE(telem_block_add(&block, 1, sample, sizeof(sample)));
+    TEST_ASSERT_TRUE(telem_block_end_frame(&block, 5));
+
+    uint32_t size = telem_block_encode(&block, 1, &buf[3], sizeof(buf) - 3U);
+
+    TEST_ASSERT_NOT_EQUAL(0, size);
+    TEST_ASSERT_EQUAL(size, telem_block_check(buf, size + 3U));
+    TEST_ASSERT_EQUAL(0, telem_block_check(buf, size + 2U));
+
+    buf[5] ^= 0x01;
+    TEST_ASSERT_EQUAL(0, telem_block_check(buf, size + 3U));
+}
+
+void test_block_decode_sample(void) {
+    uint8_t sample[8];
+
+    for (uint32_t i = 0; i < 10; i++) {
+        uint32_t counter = 0x00010000U + (i * 3U);
+        const uint8_t a[] = { (uint8_t)(counter >> 24), (uint8_t)(counter >> 16), (uint8_t)(counter >> 8), (uint8_t)counter, 0xEE };
+        const uint8_t b[] = { (uint8_t) i };
+
+        TEST_ASSERT_TRUE(telem_block_add(&block, 2, a, sizeof(a)));
+
+        if ((i % 2U) == 0) {
+            TEST_ASSERT_TRUE(telem_block_add(&block, 4, b, sizeof(b)));
+        }
+
+        TEST_ASSERT_TRUE(telem_block_end_frame(&block, (int32_t)(100U + (i * 60U))));
+    }
+
+    uint32_t size = telem_block_encode(&block, block.num_frames, buf, sizeof(buf));
+    TEST_ASSERT_NOT_EQUAL(0, size);
+
+    int32_t epoch = 0;
+
+    TEST_ASSERT_TRUE(telem_block_decode_sample(buf, size, 2, 100 + (7 * 60) + 30, sample, sizeof(sample), &epoch));
+    TEST_ASSERT_EQUAL(100 + (7 * 60), epoch);
+    const uint8_t a7[] = { 0x00, 0x01, 0x00, 21, 0xEE };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(a7, sample, sizeof(a7));
+
+    TEST_ASSERT_TRUE(telem_block_decode_sample(buf, size, 4, 100 + (7 * 60), sample, sizeof(sample), &epoch));
+    TEST_ASSERT_EQUAL(100 + (6 * 60), epoch);
+    TEST_ASSERT_EQUAL(6, sample[0]);
+
+    TEST_ASSERT_FALSE(telem_block_decode_sample(buf, size, 2, 99, sample, sizeof(sample), &epoch));
+    TEST_ASSERT_FALSE(telem_block_decode_sample(buf, size, 3, 1000, sample, sizeof(sample), &epoch));
+
+    // Same answers from the frames before they are encoded
+    TEST_ASSERT_TRUE(telem_block_find_sample(&block, 4, 100 + (7 * 60), sample, sizeof(sample), &epoch));
+    TEST_ASSERT_EQUAL(100 + (6 * 60), epoch);
+    TEST_ASSERT_EQUAL(6, sample[0]);
+}
+
+void test_block_reader(void) {
+    const uint8_t a0[] = { 0x01, 0x02 };
+    const uint8_t a1[] = { 0x01, 0x03 };
+    const uint8_t b1[] = { 0x7F };
+    telem_block_reader_t reader;
+    int32_t epoch = 0;
+
+    TEST_ASSERT_TRUE(telem_block_add(&block, 9, a0, sizeof(a0)));
+    TEST_ASSERT_TRUE(telem_block_end_frame(&block, 50));
+    TEST_ASSERT_TRUE(telem_block_add(&block, 5, b1, sizeof(b1)));
+    TEST_ASSERT_TRUE(telem_block_add(&block, 9, a1, sizeof(a1)));
+    TEST_ASSERT_TRUE(telem_block_end_frame(&block, 51));
+
+    uint32_t size = telem_block_encode(&block, 2, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(telem_block_reader_init(&reader, buf, size));
+
+    // Column by column, in the order of the first sample of each telem unit
+    TEST_ASSERT_TRUE(telem_block_reader_next(&reader, &epoch));
+    TEST_ASSERT_EQUAL(9, reader.telem_id);
+    TEST_ASSERT_EQUAL(50, epoch);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(a0, reader.sample, sizeof(a0));
+
+    TEST_ASSERT_TRUE(telem_block_reader_next(&reader, &epoch));
+    TEST_ASSERT_EQUAL(9, reader.telem_id);
+    TEST_ASSERT_EQUAL(51, epoch);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(a1, reader.sample, sizeof(a1));
+
+    TEST_ASSERT_TRUE(telem_block_reader_next(&reader, &epoch));
+    TEST_ASSERT_EQUAL(5, reader.telem_id);
+    TEST_ASSERT_EQUAL(1, reader.size);
+    TEST_ASSERT_EQUAL(51, epoch);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(b1, reader.sample, sizeof(b1));
+
+    TEST_ASSERT_FALSE(telem_block_reader_next(&reader, &epoch));
+
+    TEST_ASSERT_FALSE(telem_block_reader_init(&reader, buf, TELEM_BLOCK_MIN_SIZE - 1U));
+}
+
+void test_block_drop_frames(void) {
+    const uint8_t s0[] = { 0xAA };
+    const uint8_t s1[] = { 0xBB, 0xCC };
+    uint8_t sample[2];
+    int32_t epoch = 0;
+
+    TEST_ASSERT_TRUE(telem_block_add(&block, 1, s0, sizeof(s0)));
+    TEST_ASSERT_TRUE(telem_block_end_frame(&block, 10));
+    TEST_ASSERT_TRUE(telem_block_add(&block, 2, s1, sizeof(s1)));
+    TEST_ASSERT_TRUE(telem_block_end_frame(&block, 20));
+    TEST_ASSERT_TRUE(telem_block_add(&block, 1, s0, sizeof(s0)));
+
+    telem_block_drop_frames(&block, 1);
+
+    TEST_ASSERT_EQUAL(1, block.num_frames);
+    TEST_ASSERT_EQUAL(20, block.epochs[0]);
+    TEST_ASSERT_EQUAL(5, block.frame_ends[0]);
+    TEST_ASSERT_EQUAL(9, block.samples_len);
+    TEST_ASSERT_FALSE(telem_block_find_sample(&block, 1, 100, sample, sizeof(sample), &epoch));
+    TEST_ASSERT_TRUE(telem_block_find_sample(&block, 2, 100, sample, sizeof(sample), &epoch));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(s1, sample, sizeof(s1));
+}
+
+void test_block_limits(void) {
+    uint8_t sample[TELEM_BLOCK_MAX_SAMPLE_SIZE] = { 0 };
+
+    for (uint32_t i = 0; i < TELEM_BLOCK_MAX_FRAMES; i++) {
+        TEST_ASSERT_TRUE(telem_block_end_frame(&block, 0));
+    }
+
+    TEST_ASSERT_FALSE(telem_block_end_frame(&block, 0));
+
+    telem_block_init(&block);
+
+    // Samples of up to 255 bytes, each with a 3-byte header
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(telem_block_add(&block, (uint16_t) i, sample, 250));
+    }
+
+    TEST_ASSERT_FALSE(telem_block_add(&block, 5, sample, TELEM_BLOCK_SAMPLES_SIZE - (4U * 253U) - 2U));
+    TEST_ASSERT_TRUE(telem_block_add(&block, 5, sample, TELEM_BLOCK_SAMPLES_SIZE - (4U * 253U) - 3U));
+    TEST_ASSERT_TRUE(telem_block_end_frame(&block, 0));
+
+    // 4 columns of 250 bytes don't fit in an encoded block
+    TEST_ASSERT_EQUAL(0, telem_block_encode(&block, 1, buf, sizeof(buf)));
+}
@@ -0,0 +1,128 @@
+/**
+ * @file test_telem_window.c
+ * @brief Unit tests for telem_window.c module
+ */
+
+/******************************************************************************/
+/*                              I N C L U D E S                               */
+/******************************************************************************/
+
+#include "unity.h"
+
+#include "telem_window.h"
+#include "data_fmt.h"
+
+// Standard Library
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/******************************************************************************/
+/*                               D E F I N E S                                */
+/******************************************************************************/
+
+// Layout of the serialized samples: u16[2], f32, bool
+#define SAMPLE_SIZE 9U
+
+/******************************************************************************/
+/*               P R I V A T E  G L O B A L  V A R I A B L E S                */
+/******************************************************************************/
+
+static const data_fmt_field_desc_t fields[] = {
+    { .type = DATA_FMT_FIELD_TYPE_U16,  .struct_offset = 0, .array_len = 2 },
+    { .type = DATA_FMT_FIELD_TYPE_F32,  .struct_offset = 4, .array_len = 1 },
+    { .type = DATA_FMT_FIELD_TYPE_BOOL, .struct_offset = 8, .array_len = 1 },
+};
+
+static const data_fmt_desc_t desc = { .fields = fields, .count = 3 };
+
+static telem_window_t window;
+
+/******************************************************************************/
+/*            P R I V A T E  F U N C T I O N  P R O T O T Y P E S             */
+/******************************************************************************/
+
+static void make_sample(uint16_t a, uint16_t b, float32 f, bool flag, uint8_t sample[SAMPLE_SIZE]);
+
+/******************************************************************************/
+/*                       P U B L I C  F U N C T I O N S                       */
+/******************************************************************************/
+
+void setUp(void) {
+    memset(&window, 0, sizeof(window));
+}
+
+void tearDown(void) {
+}
+
+void test_window_init(void) {
+    TEST_ASSERT_TRUE(telem_window_init(&window, &desc, SAMPLE_SIZE));
+    TEST_ASSERT_EQUAL(0, window.count);
+
+    TEST_ASSERT_FALSE(telem_window_init(&window, &desc, SAMPLE_SIZE + 1U));
+    TEST_ASSERT_FALSE(telem_window_init(&window, NULL, SAMPLE_SIZE));
+}
+
+void test_window_min_max_mean(void) {
+    uint8_t sample[SAMPLE_SIZE];
+    uint8_t expected[SAMPLE_SIZE];
+    uint8_t mean[SAMPLE_SIZE];
+
+    TEST_ASSERT_TRUE(telem_window_init(&window, &desc, SAMPLE_SIZE));
+    telem_window_reset(&window, 60);
+
+    make_sample(10, 500, -1.5f, true, sample);
+    telem_window_add(&window, sample);
+    make_sample(3, 900, 2.5f, false, sample);
+    telem_window_add(&window, sample);
+    make_sample(20, 0, 0.5f, true, sample);
+    telem_window_add(&window, sample);
+
+    TEST_ASSERT_EQUAL(60, window.start);
+    TEST_ASSERT_EQUAL(3, window.count);
+
+    make_sample(3, 0, -1.5f, false, expected);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, window.min, SAMPLE_SIZE);
+
+    make_sample(20, 900, 2.5f, true, expected);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, window.max, SAMPLE_SIZE);
+
+    // 33 / 3 = 11, 1400 / 3 rounds to 467, 1.5 / 3 = 0.5, 2 of 3 flags are set
+    make_sample(11, 467, 0.5f, true, expected);
+    telem_window_mean(&window, mean);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, mean, SAMPLE_SIZE);
+}
+
+void test_window_reset(void) {
+    uint8_t sample[SAMPLE_SIZE];
+    uint8_t mean[SAMPLE_SIZE];
+
+    TEST_ASSERT_TRUE(telem_window_init(&window, &desc, SAMPLE_SIZE));
+
+    make_sample(100, 100, 100.0f, true, sample);
+    telem_window_add(&window, sample);
+
+    telem_window_reset(&window, 120);
+
+    make_sample(1, 2, 3.0f, false, sample);
+    telem_window_add(&window, sample);
+
+    // Nothing of the previous window is kept
+    TEST_ASSERT_EQUAL(1, window.count);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sample, window.min, SAMPLE_SIZE);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sample, window.max, SAMPLE_SIZE);
+
+    telem_window_mean(&window, mean);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sample, mean, SAMPLE_SIZE);
+}
+
+/******************************************************************************/
+/*                      P R I V A T E  F U N C T I O N S                      */
+/******************************************************************************/
+
+static void make_sample(uint16_t a, uint16_t b, float32 f, bool flag, uint8_t sample[SAMPLE_SIZE]) {
+    data_fmt_u16_to_arr_be(a, &sample[0]);
+    data_fmt_u16_to_arr_be(b, &sample[2]);
+    data_fmt_f32_to_arr_be(f, &sample[4]);
+    sample[8] = flag ? 1U : 0U;
+}
@@ -1,6 +1,7 @@
-from typing import Tuple, Dict, Any
+from typing import Tuple, Dict, Any, List
 from enum import IntEnum
 import logging
+import zlib
 
 from alea.common import alea_time
 
@@ -13,6 +14,11 @@ logger = logging.getLogger(__name__)
 
 LOG_CMD_SYS_SCHED_RESP_LOG_ID = 67
 
+# Block framing of logs saved to the OBC filesystem (see log_block.h)
+LOG_BLOCK_SYNC = b'\xBE\xEE\xEE\xEF'
+LOG_BLOCK_HEADER_SIZE = 10
+LOG_BLOCK_CRC_SIZE = 4
+
 class OBCLog(packet.Packet):
     def __init__(self, date_time: alea_time.ALEADateTime = None, log_id: int = None, signal_id: int = None, payload_len: int = None, group_name: str = None, group_desc: str = None, signal_level: log_spec.OBCLogLevel = None, signal_name: str = None, signal_desc: str = None, data: Dict[str, Any] = None):
         super().__init__()
@@ -151,3 +157,96 @@ class OBCAppLogRX(layer_impl.StreamToPacketProtocolLayer[OBCLog]):
             packet_complete = True
 
         return (next_state, bytes_used, packet_complete)
+
+def decode_log_blocks(data: bytes, log_specs: log_spec.OBCLogGroupSpecs) -> List[OBCLog]:
+    """Decode logs read from the OBC filesystem (e.g. with GET_LOGS or GET_LOGS_RANGE)
+
+    Blocks are found by their sync marker, so data can start and end anywhere. Blocks that are
+    truncated or fail their CRC check are skipped.
+
+    Args:
+        data: Bytes read from the log files
+        log_specs: Log specifications used to parse the logs
+
+    Returns:
+        Decoded logs, in the order they appear in data
+    """
+    logs = []
+    i = data.find(LOG_BLOCK_SYNC)
+
+    while (i >= 0) and (i + LOG_BLOCK_HEADER_SIZE + LOG_BLOCK_CRC_SIZE <= len(data)):
+        length = int.from_bytes(data[i + 4:i + 6], "big")
+        end = i + LOG_BLOCK_HEADER_SIZE + length
+
+        if (end + LOG_BLOCK_CRC_SIZE > len(data)) or (zlib.crc32(data[i + 4:end]) != int.from_bytes(data[end:end + LOG_BLOCK_CRC_SIZE], "big")):
+            i = data.find(LOG_BLOCK_SYNC, i + 1)
+            continue
+
+        epoch = int.from_bytes(data[i + 6:i + 10], "big")
+        logs.extend(_decode_log_block_records(data[i + LOG_BLOCK_HEADER_SIZE:end], epoch, log_specs))
+
+        i = data.find(LOG_BLOCK_SYNC, end + LOG_BLOCK_CRC_SIZE)
+
+    return logs
+
+def _decode_log_block_records(data: bytes, epoch: int, log_specs: log_spec.OBCLogGroupSpecs) -> List[OBCLog]:
+    logs = []
+    i = 0
+
+    while i < len(data):
+        zigzag, i = _decode_varint(data, i)
+        log_id, i = _decode_varint(data, i)
+        signal_id, i = _decode_varint(data, i)
+        payload_len, i = _decode_varint(data, i)
+
+        payload = data[i:i + payload_len]
+        i += payload_len
+
+        if len(payload) != payload_len:
+            raise ValueError("Truncated log record")
+
+        epoch = (epoch + ((zigzag >> 1) ^ -(zigzag & 1))) & 0xFFFFFFFF
+
+        try:
+            group_spec, signal_spec = log_specs.get(group_id=log_id, signal_id=signal_id)
+        except log_spec.OBCLogSpecNotFoundError as e:
+            logger.error(f"[OBCLogSpecNotFoundError] {str(e)}")
+            continue
+
+        if log_id == LOG_CMD_SYS_SCHED_RESP_LOG_ID:
+            data_field = { 'data': payload }
+        elif payload_len > 0:
+            data_field = signal_spec.decode_data(payload)
+        else:
+            data_field = None
+
+        logs.append(OBCLog(
+            date_time=alea_time.ALEADateTime.from_timestamp(epoch),
+            log_id=log_id,
+            signal_id=signal_id,
+            payload_len=payload_len,
+            group_name=group_spec.name,
+            group_desc=group_spec.desc,
+            signal_level=signal_spec.level,
+            signal_name=signal_spec.name,
+            signal_desc=signal_spec.desc,
+            data=data_field
+        ))
+
+    return logs
+
+def _decode_varint(data: bytes, i: int) -> Tuple[int, int]:
+    value = 0
+
+    for shift in range(0, 35, 7):
+        if i >= len(data):
+            break
+
+        byte = data[i]
+        i += 1
+        value |= (byte & 0x7F) << shift
+
+        if (byte & 0x80) == 0:
+            return (value, i)
+
+    raise ValueError("Truncated varint")
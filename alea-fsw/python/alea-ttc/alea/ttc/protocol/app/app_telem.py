@@ -0,0 +1,279 @@
+from typing import Tuple, Dict, Any, List
+import logging
+import zlib
+
+from alea.common import alea_time
+
+from alea.obcfw.telem import telem_spec
+
+logger = logging.getLogger(__name__)
+
+# Telem blocks saved to the OBC filesystem (see telem_block.h)
+TELEM_BLOCK_STOP_WORD = b'\xA1\xEA\x50\xBC'
+TELEM_BLOCK_TRAILER_SIZE = 10
+TELEM_BLOCK_MIN_SIZE = 16
+TELEM_BLOCK_MAX_SIZE = 512
+TELEM_BLOCK_MAX_FRAMES = 32
+
+# GET_TELEMETRY sends the newest chunk of this size first (see cmd_impl_GET_TELEMETRY)
+GET_TELEMETRY_CHUNK_SIZE = 800
+
+# Records returned by GET_TELEMETRY_RANGE (see telem_query_mode_t in telem.h)
+TELEM_QUERY_MODE_EVERY_NTH = 0
+TELEM_QUERY_MODE_WINDOW = 1
+
+# Telem ID of the padding at the end of a GET_TELEMETRY_RANGE response that came out shorter than measured
+# (see TELEM_QUERY_PADDING in telem.h)
+TELEM_QUERY_PADDING_ID = 0xFFFF
+
+class OBCTelemSample:
+    def __init__(self, date_time: alea_time.ALEADateTime = None, telem_id: int = None, name: str = None, raw: bytes = None, data: Dict[str, Any] = None):
+        self.date_time = date_time
+        self.telem_id  = telem_id
+        self.name      = name
+        self.raw       = raw
+        self.data      = data
+
+    def __str__(self) -> str:
+        line = "[TELEM] "
+        line += f"[{self.date_time.date_time.strftime('%Y-%m-%d %H:%M:%S')}] "
+        line += f"[ID: {self.telem_id:03d}, Name: {self.name}] "
+        line += f"{self.data if self.data is not None else self.raw.hex()}"
+        return line
+
+def reorder_get_telemetry(data: bytes, chunk_size: int = GET_TELEMETRY_CHUNK_SIZE) -> bytes:
+    """Put the data returned by GET_TELEMETRY back in file order
+
+    The OBC sends the newest chunk first. The chunks are counted back from the newest byte across
+    all the telem segments, so only the last (oldest) chunk can be partial and reversing the order
+    of the chunks is enough.
+
+    Args:
+        data: Data of the GET_TELEMETRY response
+        chunk_size: Size of the chunks the OBC sent the data in
+
+    Returns:
+        The same bytes in file order, oldest first
+    """
+    chunks = [data[i:i + chunk_size] for i in range(0, len(data), chunk_size)]
+    chunks.reverse()
+    return b''.join(chunks)
+
+def decode_telem_blocks(data: bytes, telem_specs: telem_spec.OBCTelemSpecs = None) -> List[OBCTelemSample]:
+    """Decode telemetry read from the OBC filesystem (e.g. with GET_TELEMETRY, see reorder_get_telemetry)
+
+    Blocks are found by their stop word, so data can start and end anywhere as long as it is in
+    file order. Blocks that are truncated or fail their CRC check are skipped.
+
+    Args:
+        data: Bytes read from the telem files
+        telem_specs: Telemetry specifications used to decode the samples (loaded from the package if None)
+
+    Returns:
+        Decoded samples, in the order of their blocks and then of their frames
+    """
+    if telem_specs is None:
+        telem_specs = telem_spec.OBCTelemSpecs.load()
+
+    samples = []
+    start = 0
+    end = data.find(TELEM_BLOCK_STOP_WORD, TELEM_BLOCK_MIN_SIZE - len(TELEM_BLOCK_STOP_WORD))
+
+    while end >= 0:
+        end += len(TELEM_BLOCK_STOP_WORD)
+        length = int.from_bytes(data[end - TELEM_BLOCK_TRAILER_SIZE:end - 8], "big")
+        block_start = end - TELEM_BLOCK_TRAILER_SIZE - length
+
+        if (block_start < start) or ((end - block_start) > TELEM_BLOCK_MAX_SIZE) or \
+                (zlib.crc32(data[block_start:end - 8]) != int.from_bytes(data[end - 8:end - 4], "big")):
+            # Not the end of a block after all
+            end = data.find(TELEM_BLOCK_STOP_WORD, end - len(TELEM_BLOCK_STOP_WORD) + 1)
+            continue
+
+        try:
+            samples.extend(_decode_telem_block(data[block_start:block_start + length], telem_specs))
+        except ValueError as e:
+            logger.error(f"Malformed telem block at {block_start}: {str(e)}")
+
+        start = end
+        end = data.find(TELEM_BLOCK_STOP_WORD, start + TELEM_BLOCK_MIN_SIZE - len(TELEM_BLOCK_STOP_WORD))
+
+    return samples
+
+class OBCTelemWindow:
+    def __init__(self, date_time: alea_time.ALEADateTime = None, telem_id: int = None, name: str = None, count: int = None,
+                 min: Dict[str, Any] = None, max: Dict[str, Any] = None, mean: Dict[str, Any] = None):
+        self.date_time = date_time
+        self.telem_id  = telem_id
+        self.name      = name
+        self.count     = count
+        self.min       = min
+        self.max       = max
+        self.mean      = mean
+
+    def __str__(self) -> str:
+        line = "[TELEM] "
+        line += f"[{self.date_time.date_time.strftime('%Y-%m-%d %H:%M:%S')}] "
+        line += f"[ID: {self.telem_id:03d}, Name: {self.name}, Count: {self.count}] "
+        line += f"min: {self.min} max: {self.max} mean: {self.mean}"
+        return line
+
+def decode_telem_range(data: bytes, mode: int, telem_specs: telem_spec.OBCTelemSpecs = None) -> List[Any]:
+    """Decode the records returned by GET_TELEMETRY_RANGE
+
+    The records end at the padding the OBC adds if the result came out shorter than the size it sent.
+
+    Args:
+        data: Response of the command
+        mode: Mode the command was sent with
+        telem_specs: Telemetry specifications used to decode the samples (loaded from the package if None)
+
+    Returns:
+        OBCTelemSample for each record if mode is TELEM_QUERY_MODE_EVERY_NTH,
+        OBCTelemWindow for each record if mode is TELEM_QUERY_MODE_WINDOW
+    """
+    if telem_specs is None:
+        telem_specs = telem_spec.OBCTelemSpecs.load()
+
+    records = []
+    i = 0
+
+    while i < len(data):
+        telem_id = int.from_bytes(data[i:i + 2], "big")
+
+        if telem_id == TELEM_QUERY_PADDING_ID:
+            break
+
+        epoch = int.from_bytes(data[i + 2:i + 6], "big")
+        spec = telem_specs.get(id=telem_id)
+        size = spec.resp.size if spec.has_resp else 0
+        date_time = alea_time.ALEADateTime.from_timestamp(epoch)
+
+        if mode == TELEM_QUERY_MODE_EVERY_NTH:
+            raw = data[i + 6:i + 6 + size]
+            i += 6 + size
+
+            if len(raw) != size:
+                raise ValueError(f"Truncated record of telem unit {telem_id}")
+
+            records.append(OBCTelemSample(date_time=date_time, telem_id=telem_id, name=spec.name, raw=raw,
+                                          data=_decode_resp(spec, raw) if spec.has_resp else None))
+        else:
+            count = int.from_bytes(data[i + 6:i + 8], "big")
+            raw = data[i + 8:i + 8 + (3 * size)]
+            i += 8 + (3 * size)
+
+            if len(raw) != (3 * size):
+                raise ValueError(f"Truncated record of telem unit {telem_id}")
+
+            records.append(OBCTelemWindow(date_time=date_time, telem_id=telem_id, name=spec.name, count=count,
+                                          min=_decode_resp(spec, raw[0:size]) if spec.has_resp else None,
+                                          max=_decode_resp(spec, raw[size:2 * size]) if spec.has_resp else None,
+                                          mean=_decode_resp(spec, raw[2 * size:]) if spec.has_resp else None))
+
+    return records
+
+def _decode_telem_block(data: bytes, telem_specs: telem_spec.OBCTelemSpecs) -> List[OBCTelemSample]:
+    if len(data) < 6:
+        raise ValueError("Truncated header")
+
+    epochs = [int.from_bytes(data[0:4], "big")]
+    num_frames = data[4]
+    i = 5
+
+    if (num_frames == 0) or (num_frames > TELEM_BLOCK_MAX_FRAMES):
+        raise ValueError(f"Invalid number of frames ({num_frames})")
+
+    for _ in range(1, num_frames):
+        zigzag, i = _decode_varint(data, i)
+        epochs.append((epochs[-1] + ((zigzag >> 1) ^ -(zigzag & 1))) & 0xFFFFFFFF)
+
+    num_columns = data[i]
+    i += 1
+
+    # (frame, telem_id, raw sample)
+    frame_samples: List[Tuple[int, int, bytes]] = []
+
+    for _ in range(num_columns):
+        telem_id = int.from_bytes(data[i:i + 2], "big")
+        size = data[i + 2]
+        frame_mask = data[i + 3:i + 3 + _mask_size(num_frames)]
+        i += 3 + _mask_size(num_frames)
+
+        current = None
+
+        for frame in range(num_frames):
+            if not _mask_bit(frame_mask, frame):
+                continue
+
+            if current is None:
+                current = bytearray(data[i:i + size])
+                i += size
+            else:
+                change_mask = data[i:i + _mask_size(size)]
+                i += _mask_size(size)
+
+                for byte in range(size):
+                    if _mask_bit(change_mask, byte):
+                        if i >= len(data):
+                            raise ValueError("Truncated column")
+
+                        current[byte] ^= data[i]
+                        i += 1
+
+            if (len(current) != size) or (i > len(data)):
+                raise ValueError("Truncated column")
+
+            frame_samples.append((frame, telem_id, bytes(current)))
+
+    frame_samples.sort(key=lambda sample: sample[0])
+
+    samples = []
+
+    for frame, telem_id, raw in frame_samples:
+        sample = OBCTelemSample(date_time=alea_time.ALEADateTime.from_timestamp(epochs[frame]), telem_id=telem_id, raw=raw)
+
+        try:
+            spec = telem_specs.get(id=telem_id)
+            sample.name = spec.name
+
+            if spec.has_resp and (spec.resp.size == len(raw)):
+                sample.data = _decode_resp(spec, raw)
+        except telem_spec.OBCTelemSpecNotFoundError as e:
+            logger.error(f"[OBCTelemSpecNotFoundError] {str(e)}")
+
+        samples.append(sample)
+
+    return samples
+
+def _decode_resp(spec: telem_spec.OBCTelemSpec, raw: bytes) -> Dict[str, Any]:
+    fields = {}
+    offset = 0
+
+    for field in spec.resp:
+        fields[field.name] = field.decode(raw[offset:offset + field.size])
+        offset += field.size
+
+    return fields
+
+def _mask_size(bits: int) -> int:
+    return (bits + 7) // 8
+
+def _mask_bit(mask: bytes, i: int) -> bool:
+    return (mask[i // 8] & (0x80 >> (i % 8))) != 0
+
+def _decode_varint(data: bytes, i: int) -> Tuple[int, int]:
+    value = 0
+
+    for shift in range(0, 35, 7):
+        if i >= len(data):
+            break
+
+        byte = data[i]
+        i += 1
+        value |= (byte & 0x7F) << shift
+
+        if (byte & 0x80) == 0:
+            return (value, i)
+
+    raise ValueError("Truncated varint")